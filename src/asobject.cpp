@@ -19,6 +19,7 @@
 
 #include "scripting/abc.h"
 #include "asobject.h"
+#include "scripting/toplevel/JSON.h"
 #include "scripting/class.h"
 #include <algorithm>
 #include "compat.h"
@@ -30,6 +31,8 @@
 #include "scripting/toplevel/XML.h"
 #include "scripting/toplevel/XMLList.h"
 #include "scripting/toplevel/Error.h"
+#include "cyclecollector.h"
+#include "sampler.h"
 #include <3rdparty/pugixml/src/pugixml.hpp>
 
 using namespace lightspark;
@@ -440,38 +443,6 @@ void ASObject::call_toString(asAtom &ret)
 	asAtomHandler::callFunction(o,ret,v,NULL,0,false);
 }
 
-tiny_string ASObject::call_toJSON(bool& ok,std::vector<ASObject *> &path, asAtom replacer, const tiny_string &spaces,const tiny_string& filter)
-{
-	tiny_string res;
-	ok = false;
-	multiname toJSONName(NULL);
-	toJSONName.name_type=multiname::NAME_STRING;
-	toJSONName.name_s_id=getSystemState()->getUniqueStringId("toJSON");
-	toJSONName.ns.emplace_back(getSystemState(),BUILTIN_STRINGS::EMPTY,NAMESPACE);
-	toJSONName.ns.emplace_back(getSystemState(),BUILTIN_STRINGS::STRING_AS3NS,NAMESPACE);
-	toJSONName.isAttribute = false;
-	if (!ASObject::hasPropertyByMultiname(toJSONName, true, true))
-		return res;
-
-	asAtom o=asAtomHandler::invalidAtom;
-	getVariableByMultiname(o,toJSONName,SKIP_IMPL);
-	if (!asAtomHandler::isFunction(o))
-		return res;
-	asAtom v=asAtomHandler::fromObject(this);
-	asAtom ret=asAtomHandler::invalidAtom;
-	asAtomHandler::callFunction(o,ret,v,NULL,0,false);
-	if (asAtomHandler::isString(ret))
-	{
-		res += "\"";
-		res += asAtomHandler::toString(ret,getSystemState());
-		res += "\"";
-	}
-	else 
-		res = asAtomHandler::toObject(ret,getSystemState())->toJSON(path,replacer,spaces,filter);
-	ok = true;
-	return res;
-}
-
 bool ASObject::isPrimitive() const
 {
 	// ECMA 3, section 4.3.2, T_INTEGER and T_UINTEGER are added
@@ -484,10 +455,59 @@ bool ASObject::isConstructed() const
 {
 	return traitsInitialized && constructIndicator;
 }
-variables_map::variables_map(MemoryAccount *m):slotcount(0),cloneable(true)
+Mutex VariableShape::transitionMutex;
+ATOMIC_INT32(VariableShape::shapeCount);
+
+VariableShape::VariableShape(VariableShape* p, const transitionKey& k):parent(p),key(k),count(p ? p->count+1 : 0),lastTransition(nullptr)
+{
+}
+
+VariableShape* VariableShape::getRoot()
+{
+	static VariableShape* root = new VariableShape(nullptr,transitionKey({UINT32_MAX,UINT32_MAX,NO_CREATE_TRAIT}));
+	return root;
+}
+
+VariableShape* VariableShape::addVariable(uint32_t nameId, uint32_t nsId, TRAIT_KIND kind)
+{
+	transitionKey k({nameId,nsId,kind});
+	// objects of the same class usually add their variables in the same order, so check the last transition first
+	VariableShape* last = lastTransition;
+	if (last && last->key == k)
+		return last;
+	if (count >= SHAPE_MAX_VARIABLES)
+		return nullptr;
+	Locker l(transitionMutex);
+	VariableShape* res;
+	auto it = transitions.find(k);
+	if (it != transitions.end())
+		res = it->second;
+	else
+	{
+		if (shapeCount >= SHAPE_MAX_COUNT)
+			return nullptr;
+		shapeCount++;
+		res = new VariableShape(this,k);
+		transitions.insert(make_pair(k,res));
+	}
+	lastTransition = res;
+	return res;
+}
+
+variables_map::variables_map(MemoryAccount *m):slotcount(0),cloneable(true),shape(VariableShape::getRoot())
 {
 }
 
+int32_t variables_map::getShapePosition(const variable* v) const
+{
+	for (uint32_t i = 0; i < shapeVars.size(); i++)
+	{
+		if (shapeVars[i]==v)
+			return i;
+	}
+	return -1;
+}
+
 variable* variables_map::findObjVar(uint32_t nameId, const nsNameAndKind& ns, TRAIT_KIND createKind, uint32_t traitKinds)
 {
 	var_iterator ret=Variables.find(nameId);
@@ -510,6 +530,7 @@ variable* variables_map::findObjVar(uint32_t nameId, const nsNameAndKind& ns, TR
 		return NULL;
 
 	var_iterator inserted=Variables.insert(Variables.cbegin(),make_pair(nameId, variable(createKind,ns)) );
+	addToShape(&inserted->second,nameId);
 	return &inserted->second;
 }
 
@@ -815,12 +836,16 @@ multiname *ASObject::setVariableByMultiname_intern(multiname& name, asAtom& o, C
 			variables_map::var_iterator inserted=Variables.Variables.insert(Variables.Variables.cbegin(),
 				make_pair(name.normalizedNameId(getSystemState()),variable(DYNAMIC_TRAIT,name.ns.size() == 1 ? name.ns[0] : nsNameAndKind())));
 			obj = &inserted->second;
+			Variables.addToShape(obj,inserted->first);
 		}
 	}
 	// it seems that instance traits are changed into declared traits if they are overwritten in class objects
 	// see tamarin test as3/Definitions/FunctionAccessors/GetSetStatic
 	if (this->is<Class_base>() && obj->kind == INSTANCE_TRAIT)
+	{
 		obj->kind =DECLARED_TRAIT;
+		Variables.dropShape();
+	}
 
 	if(asAtomHandler::isValid(obj->setter))
 	{
@@ -975,6 +1000,7 @@ void variables_map::killObjVar(SystemState* sys,const multiname& mname)
 		if(ns==*nsIt)
 		{
 			Variables.erase(ret);
+			dropShape();
 			return;
 		}
 		else
@@ -1032,11 +1058,13 @@ variable* variables_map::findObjVar(SystemState* sys,const multiname& mname, TRA
 	{
 		var_iterator inserted=Variables.insert(Variables.cbegin(),
 			make_pair(name,variable(createKind,nsNameAndKind())));
+		addToShape(&inserted->second,name);
 		return &inserted->second;
 	}
 	assert(mname.ns.size() == 1);
 	var_iterator inserted=Variables.insert(Variables.cbegin(),
 		make_pair(name,variable(createKind,mname.ns[0])));
+	addToShape(&inserted->second,name);
 	return &inserted->second;
 }
 
@@ -1102,6 +1130,7 @@ void variables_map::initializeVar(multiname& mname, asAtom& obj, multiname* type
 
 	uint32_t name=mname.normalizedNameId(mainObj->getSystemState());
 	auto it = Variables.insert(Variables.cbegin(),make_pair(name, variable(traitKind, value, typemname, type,mname.ns[0],isenumerable)));
+	addToShape(&(it->second),name);
 	if (slot_id)
 		initSlot(slot_id,&(it->second));
 }
@@ -1513,6 +1542,26 @@ GET_VARIABLE_RESULT ASObject::getVariableByMultinameIntern(asAtom &ret, const mu
 	return res;
 }
 
+void ASObject::updatePropertyCache(const multiname& name, PropertyCache* cache, bool forSetting)
+{
+	if (!Variables.shape || !hasDefaultPropertyAccess() || name.isEmpty() || !name.isStatic)
+		return;
+	uint32_t nameId=name.name_type == multiname::NAME_STRING ? name.name_s_id : name.normalizedNameId(getSystemState());
+	// the lookup only gives the same variable for all objects of a shape if the name is unique in the map
+	if (Variables.Variables.count(nameId) != 1)
+		return;
+	variable* v;
+	if (forSetting)
+		v = findSettable(name);
+	else
+		v = Variables.findObjVar(getSystemState(),name,(name.hasEmptyNS || name.hasBuiltinNS) ? DECLARED_TRAIT|DYNAMIC_TRAIT : DECLARED_TRAIT);
+	if (!v)
+		return;
+	int32_t pos = Variables.getShapePosition(v);
+	if (pos >= 0 && cache->find(Variables.shape) < 0)
+		cache->add(Variables.shape,pos);
+}
+
 void ASObject::getVariableByMultiname(asAtom& ret, const tiny_string& name, std::list<tiny_string> namespaces)
 {
 	multiname varName(NULL);
@@ -1667,6 +1716,24 @@ void variables_map::destroyContents()
 	}
 	slots_vars.clear();
 	slotcount=0;
+	// the map may be reused by an object from the freelist, so it starts again with the empty shape
+	shape=VariableShape::getRoot();
+	shapeVars.clear();
+}
+
+void variables_map::getReferencedObjects(std::vector<ASObject*>& refs) const
+{
+	for (auto it=Variables.cbegin();it!=Variables.cend();++it)
+	{
+		if (!it->second.isrefcounted)
+			continue;
+		if (asAtomHandler::isObject(it->second.var))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->second.var));
+		if (asAtomHandler::isObject(it->second.setter))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->second.setter));
+		if (asAtomHandler::isObject(it->second.getter))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->second.getter));
+	}
 }
 
 bool variables_map::cloneInstance(variables_map &map)
@@ -1681,6 +1748,21 @@ bool variables_map::cloneInstance(variables_map &map)
 			map.initSlot(it->second.slotid,&(it->second));
 		it++;
 	}
+	// the copied variables have the same shape, but shapeVars has to point to the new variables
+	map.shape=shape;
+	map.shapeVars.resize(shapeVars.size());
+	for (VariableShape* s = shape; s && s->getParent(); s = s->getParent())
+	{
+		auto range = map.Variables.equal_range(s->getNameId());
+		for (auto itv = range.first; itv != range.second; itv++)
+		{
+			if (itv->second.ns.nsId == s->getNsId())
+			{
+				map.shapeVars[s->getCount()-1]=&(itv->second);
+				break;
+			}
+		}
+	}
 	return true;
 }
 
@@ -1693,6 +1775,7 @@ void variables_map::removeAllDeclaredProperties()
 			|| asAtomHandler::isValid(it->second.setter))
 		{
 			it = Variables.erase(it);
+			dropShape();
 		}
 		else
 			it++;
@@ -1715,7 +1798,7 @@ void ASObject::dumpObjectCounters(uint32_t threshhold)
 	LOG(LOG_INFO,"countall:"<<c);
 }
 #endif
-ASObject::ASObject(Class_base* c,SWFOBJECT_TYPE t,CLASS_SUBTYPE st):objfreelist(c && c->getSystemState()->singleworker && c->isReusable ? c->freelist : nullptr),Variables((c)?c->memoryAccount:nullptr),classdef(c),proxyMultiName(nullptr),sys(c?c->sys:nullptr),
+ASObject::ASObject(Class_base* c,SWFOBJECT_TYPE t,CLASS_SUBTYPE st):objfreelist(c && c->getSystemState()->singleworker && c->isReusable ? c->freelist : nullptr),Variables((c)?c->memoryAccount:nullptr),classdef(c),cycleCandidateIndex(0),proxyMultiName(nullptr),sys(c?c->sys:nullptr),
 	stringId(UINT32_MAX),type(t),subtype(st),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),implEnable(true)
 {
 #ifndef NDEBUG
@@ -1728,15 +1811,19 @@ ASObject::ASObject(Class_base* c,SWFOBJECT_TYPE t,CLASS_SUBTYPE st):objfreelist(
 		objectcounter[c] = x;
 	}
 #endif
+	setCycleCollectable();
+	if (USUALLY_FALSE(sampleAllocations))
+		sampleAllocation(lastAllocationSize);
 }
 
-ASObject::ASObject(const ASObject& o):objfreelist(o.classdef && o.classdef->getSystemState()->singleworker && o.classdef->isReusable ? o.classdef->freelist : nullptr),Variables((o.classdef)?o.classdef->memoryAccount:nullptr),classdef(nullptr),proxyMultiName(nullptr),sys(o.classdef? o.classdef->sys : nullptr),
+ASObject::ASObject(const ASObject& o):objfreelist(o.classdef && o.classdef->getSystemState()->singleworker && o.classdef->isReusable ? o.classdef->freelist : nullptr),Variables((o.classdef)?o.classdef->memoryAccount:nullptr),classdef(nullptr),cycleCandidateIndex(0),proxyMultiName(nullptr),sys(o.classdef? o.classdef->sys : nullptr),
 	stringId(o.stringId),type(o.type),subtype(o.subtype),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),implEnable(true)
 {
 #ifndef NDEBUG
 	//Stuff only used in debugging
 	initialized=false;
 #endif
+	setCycleCollectable();
 	assert(o.Variables.size()==0);
 }
 
@@ -1754,6 +1841,60 @@ bool ASObject::destruct()
 	return destructIntern();
 }
 
+bool ASObject::removeFromCycleCollector(bool canDefer)
+{
+	if (sys->cycleCollector->removeCandidate(this))
+		return true;
+	//Only the vm thread may change the candidate buffer, let it release the last reference
+	ABCVm* vm = getVm(sys);
+	if (!canDefer || vm == nullptr)
+	{
+		LOG(LOG_ERROR,"CycleCollector: buffered object deleted outside of the vm thread");
+		return true;
+	}
+	vm->addDeletableObject(this);
+	return false;
+}
+
+bool ASObject::isCycleCollectable() const
+{
+	if (getConstant() || getCached() || getInDestruction() || getActivationCount()!=1)
+		return false;
+	return isCycleCollectableKind();
+}
+
+bool ASObject::isCycleCollectableKind() const
+{
+	if (type!=T_OBJECT && type!=T_FUNCTION && type!=T_ARRAY)
+		return false;
+	// display objects are also used by the render thread, the others have references
+	// (scope stacks, prototype chains) the collector doesn't know about and live long anyway
+	return !is<DisplayObject>() && !is<Global>() && !is<Activation_object>() && !is<ObjectPrototype>()
+			&& subtype!=SUBTYPE_WORKER && subtype!=SUBTYPE_WORKERDOMAIN;
+}
+
+void ASObject::sampleAllocation(uint32_t size)
+{
+	if (sys && sys->sampler)
+		sys->sampler->recordAllocation(this,size);
+}
+
+void ASObject::sampleDeletion()
+{
+	if (sys && sys->sampler)
+		sys->sampler->recordDeletion(this);
+}
+
+void ASObject::getReferencedObjects(std::vector<ASObject*>& refs)
+{
+	Variables.getReferencedObjects(refs);
+}
+
+void ASObject::unlinkReferencedObjects()
+{
+	destroyContents();
+}
+
 bool ASObject::AVM1HandleKeyboardEvent(KeyboardEvent *e) 
 { 
 	if (e->type =="keyDown")
@@ -2254,187 +2395,77 @@ ASObject *ASObject::describeType() const
 	return XML::createFromNode(root);
 }
 
-tiny_string ASObject::toJSON(std::vector<ASObject *> &path, asAtom replacer, const tiny_string &spaces,const tiny_string& filter)
+void ASObject::toJSON(JSONStringifier& s, const tiny_string& indent)
 {
-	bool ok;
-	tiny_string res = call_toJSON(ok,path,replacer,spaces,filter);
-	if (ok)
-		return res;
-
-	tiny_string newline = (spaces.empty() ? "" : "\n");
-	if (this->isPrimitive())
+	tiny_string inner = s.getGap().empty() ? indent : indent+s.getGap();
+	s.out += '{';
+	std::vector<uint32_t> tmp;
+	variables_map::var_iterator beginIt = Variables.Variables.begin();
+	variables_map::var_iterator endIt = Variables.Variables.end();
+	variables_map::var_iterator varIt = beginIt;
+	while (varIt != endIt)
 	{
-		switch(this->type)
-		{
-			case T_STRING:
-			{
-				res += "\"";
-				tiny_string sub = this->toString();
-				for (CharIterator it=sub.begin(); it!=sub.end(); it++)
-				{
-					switch (*it)
-					{
-						case '\b':
-							res += "\\b";
-							break;
-						case '\f':
-							res += "\\f";
-							break;
-						case '\n':
-							res += "\\n";
-							break;
-						case '\r':
-							res += "\\r";
-							break;
-						case '\t':
-							res += "\\t";
-							break;
-						case '\"':
-							res += "\\\"";
-							break;
-						case '\\':
-							res += "\\\\";
-							break;
-						default:
-							if (*it < 0x20 || *it > 0xff)
-							{
-								char hexstr[7];
-								sprintf(hexstr,"\\u%04x",*it);
-								res += hexstr;
-							}
-							else
-								res += *it;
-							break;
-					}
-				}
-				res += "\"";
-				break;
-			}
-			case T_UNDEFINED:
-				res += "null";
-				break;
-			case T_NUMBER:
-			case T_INTEGER:
-			case T_UINTEGER:
-			{
-				tiny_string s = this->toString();
-				if (s == "Infinity" || s == "-Infinity" || s == "NaN")
-					res += "null";
-				else
-					res += s;
-				break;
-			}
-			default:
-				res += this->toString();
-				break;
-		}
+		tmp.push_back(varIt->first);
+		varIt++;
 	}
-	else
+	std::sort(tmp.begin(),tmp.end());
+	bool bfirst = true;
+	bool bObjectVars = true;
+	auto tmpIt = tmp.begin();
+	while (tmpIt != tmp.end())
 	{
-		res += "{";
-		
-		// 
-		std::vector<uint32_t> tmp;
-		variables_map::var_iterator beginIt = Variables.Variables.begin();
-		variables_map::var_iterator endIt = Variables.Variables.end();
-		variables_map::var_iterator varIt = beginIt;
-		while (varIt != endIt)
-		{
-			tmp.push_back(varIt->first);
-			varIt++;
-		}
-		std::sort(tmp.begin(),tmp.end());
-		bool bfirst = true;
-		bool bObjectVars = true;
-		path.push_back(this);
-		auto tmpIt = tmp.begin();
-		while (tmpIt != tmp.end())
-		{
-			varIt = bObjectVars ? Variables.Variables.find(*tmpIt) : this->getClass()->borrowedVariables.Variables.find(*tmpIt);
-			tmpIt++;
-			if (tmpIt == tmp.end() && bObjectVars)
-			{
-				bObjectVars = false;
-				if (this->getClass())
-				{
-					variables_map::var_iterator varIt2 = this->getClass()->borrowedVariables.Variables.begin();
-					while (varIt2 != this->getClass()->borrowedVariables.Variables.end())
-					{
-						tmp.push_back(varIt2->first);
-						varIt2++;
-					}
-					std::sort(tmp.begin(),tmp.end());
-					tmpIt = tmp.begin();
-				}
-			}
-			if (varIt == endIt)
-				continue;
-			if(varIt->second.ns.hasEmptyName() && (asAtomHandler::isValid(varIt->second.getter) || asAtomHandler::isValid(varIt->second.var)))
+		varIt = bObjectVars ? Variables.Variables.find(*tmpIt) : this->getClass()->borrowedVariables.Variables.find(*tmpIt);
+		tmpIt++;
+		if (tmpIt == tmp.end() && bObjectVars)
+		{
+			bObjectVars = false;
+			if (this->getClass())
 			{
-				ASObject* v = asAtomHandler::isValid(varIt->second.var) ? asAtomHandler::toObject(varIt->second.var,getSystemState()) : nullptr;
-				if (asAtomHandler::isValid(varIt->second.getter))
-				{
-					asAtom t=asAtomHandler::fromObject(this);
-					asAtom res=asAtomHandler::invalidAtom;
-					asAtomHandler::callFunction(varIt->second.getter,res,t,NULL,0,false);
-					v=asAtomHandler::toObject(res,getSystemState());
-				}
-				if(v && v->getObjectType() != T_UNDEFINED && varIt->second.isenumerable)
+				variables_map::var_iterator varIt2 = this->getClass()->borrowedVariables.Variables.begin();
+				while (varIt2 != this->getClass()->borrowedVariables.Variables.end())
 				{
-					// check for cylic reference
-					if (v->getObjectType() != T_UNDEFINED &&
-						v->getObjectType() != T_NULL &&
-						v->getObjectType() != T_BOOLEAN &&
-						std::find(path.begin(),path.end(), v) != path.end())
-						throwError<TypeError>(kJSONCyclicStructure);
-		
-					if (asAtomHandler::isValid(replacer))
-					{
-						if (!bfirst)
-							res += ",";
-						res += newline+spaces;
-						res += "\"";
-						res += getSystemState()->getStringFromUniqueId(varIt->first);
-						res += "\"";
-						res += ":";
-						if (!spaces.empty())
-							res += " ";
-						asAtom params[2];
-						
-						params[0] = asAtomHandler::fromStringID(varIt->first);
-						params[1] = asAtomHandler::fromObject(v);
-						ASATOM_INCREF(params[1]);
-						asAtom funcret=asAtomHandler::invalidAtom;
-						asAtomHandler::callFunction(replacer,funcret,asAtomHandler::nullAtom, params, 2,true);
-						if (asAtomHandler::isValid(funcret))
-							res += asAtomHandler::toString(funcret,getSystemState());
-						else
-							res += v->toJSON(path,replacer,spaces+spaces,filter);
-						bfirst = false;
-					}
-					else if (filter.empty() || filter.find(tiny_string(" ")+getSystemState()->getStringFromUniqueId(varIt->first)+" ") != tiny_string::npos)
-					{
-						if (!bfirst)
-							res += ",";
-						res += newline+spaces;
-						res += "\"";
-						res += getSystemState()->getStringFromUniqueId(varIt->first);
-						res += "\"";
-						res += ":";
-						if (!spaces.empty())
-							res += " ";
-						res += v->toJSON(path,replacer,spaces+spaces,filter);
-						bfirst = false;
-					}
+					tmp.push_back(varIt2->first);
+					varIt2++;
 				}
-				if (!bfirst)
-					res += newline+spaces.substr_bytes(0,spaces.numBytes()/2);
+				std::sort(tmp.begin(),tmp.end());
+				tmpIt = tmp.begin();
 			}
 		}
-		res += "}";
-		path.pop_back();
+		if (varIt == endIt)
+			continue;
+		if(!varIt->second.ns.hasEmptyName() || !varIt->second.isenumerable || s.isFiltered(varIt->first))
+			continue;
+		asAtom v=asAtomHandler::invalidAtom;
+		bool ownsValue = false;
+		if (asAtomHandler::isValid(varIt->second.getter))
+		{
+			asAtom t=asAtomHandler::fromObject(this);
+			asAtomHandler::callFunction(varIt->second.getter,v,t,NULL,0,false);
+			ownsValue = true;
+		}
+		else
+			v = varIt->second.var;
+		if (asAtomHandler::isValid(v))
+		{
+			//The member is removed again if its value is not serializable
+			size_t mark = s.out.size();
+			if (!bfirst)
+				s.out += ',';
+			s.writeNewline(inner);
+			tiny_string name = getSystemState()->getStringFromUniqueId(varIt->first);
+			s.writeString(name.raw_buf(),name.numBytes());
+			s.out += s.getGap().empty() ? ":" : ": ";
+			if (s.writeProperty(this,asAtomHandler::fromStringID(varIt->first),v,inner))
+				bfirst = false;
+			else
+				s.out.resize(mark);
+		}
+		if (ownsValue)
+			ASATOM_DECREF(v);
 	}
-	return res;
+	if (!bfirst)
+		s.writeNewline(indent);
+	s.out += '}';
 }
 
 bool ASObject::hasprop_prototype()
@@ -2575,7 +2606,7 @@ void asAtomHandler::getVariableByMultiname(asAtom& a, asAtom& ret,SystemState* s
 {
 	// classes for primitives are final and sealed, so we only have to check the class for the variable
 	// no need to create ASObjects for the primitives
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 			Class<Integer>::getClass(sys)->getClassVariableByMultiname(ret,name);
@@ -2609,7 +2640,7 @@ Class_base *asAtomHandler::getClass(asAtom& a,SystemState* sys,bool followclass)
 {
 	// classes for primitives are final and sealed, so we only have to check the class for the variable
 	// no need to create ASObjects for the primitives
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 			return Class<Integer>::getRef(sys).getPtr()->as<Class_base>();
@@ -2639,7 +2670,7 @@ Class_base *asAtomHandler::getClass(asAtom& a,SystemState* sys,bool followclass)
 bool asAtomHandler::canCacheMethod(asAtom& a,const multiname* name)
 {
 	assert(name->isStatic);
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 		case ATOM_UINTEGER:
@@ -2672,11 +2703,11 @@ bool asAtomHandler::canCacheMethod(asAtom& a,const multiname* name)
 
 void asAtomHandler::fillMultiname(asAtom& a,SystemState* sys, multiname &name)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 			name.name_type = multiname::NAME_INT;
-			name.name_i = a.intval>>3;
+			name.name_i = getIntValue(a);
 			break;
 		case ATOM_UINTEGER:
 			name.name_type = multiname::NAME_UINT;
@@ -2708,20 +2739,22 @@ void asAtomHandler::replaceBool(asAtom& a, ASObject *obj)
 
 std::string asAtomHandler::toDebugString(asAtom& a)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
-			return Integer::toString(a.intval>>3)+"i";
+			return Integer::toString(getIntValue(a))+"i";
 		case ATOM_UINTEGER:
 			return UInteger::toString(a.uintval>>3)+"ui";
 		case ATOM_NUMBERPTR:
 		{
 			std::string ret = Number::toString(toNumber(a))+"d";
 #ifndef _NDEBUG
-			assert(getObject(a));
-			char buf[300];
-			sprintf(buf,"(%p / %d/%d)",getObject(a),getObject(a)->getRefCount(),getObject(a)->getConstant());
-			ret += buf;
+			if (isObject(a))
+			{
+				char buf[300];
+				sprintf(buf,"(%p / %d/%d)",getObject(a),getObject(a)->getRefCount(),getObject(a)->getConstant());
+				ret += buf;
+			}
 #endif
 			return ret;
 		}
@@ -2925,7 +2958,7 @@ bool asAtomHandler::isTypelate(asAtom& a,asAtom& t)
 
 tiny_string asAtomHandler::toString(const asAtom& a,SystemState* sys)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 		{
@@ -2944,7 +2977,7 @@ tiny_string asAtomHandler::toString(const asAtom& a,SystemState* sys)
 		case ATOM_NUMBERPTR:
 			return Number::toString(toNumber(a));
 		case ATOM_INTEGER:
-			return Integer::toString(a.intval>>3);
+			return Integer::toString(getIntValue(a));
 		case ATOM_UINTEGER:
 			return UInteger::toString(a.uintval>>3);
 		case ATOM_STRINGID:
@@ -2960,7 +2993,7 @@ tiny_string asAtomHandler::toString(const asAtom& a,SystemState* sys)
 }
 tiny_string asAtomHandler::toLocaleString(const asAtom& a)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 		{
@@ -2979,7 +3012,7 @@ tiny_string asAtomHandler::toLocaleString(const asAtom& a)
 		case ATOM_NUMBERPTR:
 			return Number::toString(toNumber(a));
 		case ATOM_INTEGER:
-			return Integer::toString(a.intval>>3);
+			return Integer::toString(getIntValue(a));
 		case ATOM_UINTEGER:
 			return UInteger::toString(a.uintval>>3);
 		case ATOM_STRINGID:
@@ -3011,7 +3044,7 @@ bool asAtomHandler::Boolean_concrete_string(asAtom &a)
 void asAtomHandler::convert_b(asAtom& a, bool refcounted)
 {
 	bool v = false;
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 		{
@@ -3029,7 +3062,7 @@ void asAtomHandler::convert_b(asAtom& a, bool refcounted)
 			break;
 		}
 		case ATOM_INTEGER:
-			v= a.intval>>3 != 0;
+			v= getIntValue(a) != 0;
 			break;
 		case ATOM_UINTEGER:
 			v= a.uintval>>3 != 0;
@@ -3037,6 +3070,9 @@ void asAtomHandler::convert_b(asAtom& a, bool refcounted)
 		case ATOM_STRINGID:
 			v = a.uintval>>3 != BUILTIN_STRINGS::EMPTY;
 			break;
+		case ATOM_NUMBERPTR:
+			v = toNumber(a) != 0.0 && !std::isnan(toNumber(a));
+			break;
 		default:
 			v= lightspark::Boolean_concrete(getObject(a));
 			break;
@@ -3076,6 +3112,13 @@ bool asAtomHandler::add(asAtom& a,asAtom &v2, SystemState* sys,bool forceint)
 		else
 			setNumber(a,sys,num1+num2);
 	}
+	else if(!forceint && isObject(a) && getObjectNoCheck(a)->is<ASString>())
+	{
+		//Don't copy the left string, it may be appended to in place
+		tiny_string sb = toString(v2,sys);
+		LOG_CALL("add " << toString(a,sys) << '+' << sb);
+		a.uintval = (LIGHTSPARK_ATOM_VALTYPE)(getObjectNoCheck(a)->as<ASString>()->concatString(sb))|ATOM_STRINGPTR;
+	}
 	else if(isString(a) || isString(v2))
 	{
 		tiny_string sa = toString(a,sys);
@@ -3188,6 +3231,16 @@ void asAtomHandler::addreplace(asAtom& ret, SystemState* sys,asAtom& v1, asAtom
 		else if (replaceNumber(ret,sys,num1+num2) && o)
 			o->decRef();
 	}
+	else if(!forceint && isObject(v1) && getObjectNoCheck(v1)->is<ASString>())
+	{
+		//Don't copy the left string, it may be appended to in place
+		tiny_string sb = toString(v2,sys);
+		LOG_CALL("add " << toString(v1,sys) << '+' << sb);
+		ASString* res = getObjectNoCheck(v1)->as<ASString>()->concatString(sb);
+		//ret may be the same atom as v1, so it is released only after the concatenation
+		ASATOM_DECREF(ret);
+		ret.uintval = (LIGHTSPARK_ATOM_VALTYPE)(res)|ATOM_STRINGPTR;
+	}
 	else if(isString(v1) || isString(v2))
 	{
 		tiny_string sa = toString(v1,sys);
@@ -3288,15 +3341,31 @@ bool asAtomHandler::Boolean_concrete_object(asAtom& a)
 	return lightspark::Boolean_concrete(getObject(a));
 }
 
+#ifdef LIGHTSPARK_NANBOXING
+int32_t asAtomHandler::inlineNumberToInt(const asAtom& a)
+{
+	return Number::toInt(getInlineNumber(a));
+}
+#endif
+
 void asAtomHandler::setNumber(asAtom& a, SystemState* sys, number_t val)
 {
+#ifdef LIGHTSPARK_NANBOXING
+	setInlineNumber(a,val);
+#else
 	if (std::isnan(val))
 		a.uintval = sys->nanAtom.uintval;
 	else
 		a.uintval = (LIGHTSPARK_ATOM_VALTYPE)(abstract_d(sys,val))|ATOM_NUMBERPTR;
+#endif
 }
 bool asAtomHandler::replaceNumber(asAtom& a, SystemState* sys, number_t val)
 {
+#ifdef LIGHTSPARK_NANBOXING
+	// the previous value (if it was an object) has to be decreffed by the caller
+	setInlineNumber(a,val);
+	return true;
+#else
 	if (isNumber(a) && getObject(a)->isLastRef())
 	{
 		as<Number>(a)->setNumber(val);
@@ -3307,6 +3376,7 @@ bool asAtomHandler::replaceNumber(asAtom& a, SystemState* sys, number_t val)
 	else
 		a.uintval = (LIGHTSPARK_ATOM_VALTYPE)(abstract_d(sys,val))|ATOM_NUMBERPTR;
 	return true;
+#endif
 }
 
 void asAtomHandler::replace(asAtom& a, ASObject *obj)
@@ -3344,45 +3414,45 @@ void asAtomHandler::replace(asAtom& a, ASObject *obj)
 
 TRISTATE asAtomHandler::isLessIntern(asAtom& a,SystemState *sys, asAtom &v2)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INTEGER:
-					return (a.intval < v2.intval)?TTRUE:TFALSE;
+					return (getIntValue(a) < getIntValue(v2))?TTRUE:TFALSE;
 				case ATOM_UINTEGER:
-					return ((a.intval>>3) < 0 || ((uint32_t)(a.intval>>3)) < (v2.uintval>>3))?TTRUE:TFALSE;
+					return ((getIntValue(a)) < 0 || ((uint32_t)(getIntValue(a))) < (v2.uintval>>3))?TTRUE:TFALSE;
 				case ATOM_NUMBERPTR:
 					if(std::isnan(toNumber(v2)))
 						return TUNDEFINED;
-					return ((a.intval>>3) < toNumber(v2))?TTRUE:TFALSE;
+					return ((getIntValue(a)) < toNumber(v2))?TTRUE:TFALSE;
 				case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 				{
 					switch (v2.uintval&0x70)
 					{
 						case ATOMTYPE_NULL_BIT:
-							return ((a.intval>>3) < 0)?TTRUE:TFALSE;
+							return ((getIntValue(a)) < 0)?TTRUE:TFALSE;
 						case ATOMTYPE_UNDEFINED_BIT:
 							return TUNDEFINED;
 						case ATOMTYPE_BOOL_BIT:
-							return ((a.intval>>3) < (int32_t)((v2.uintval&0x80)>>7))?TTRUE:TFALSE;
+							return ((getIntValue(a)) < (int32_t)((v2.uintval&0x80)>>7))?TTRUE:TFALSE;
 						default: // INVALID
 							return TUNDEFINED;
 					}
 				}
 				default:
-					return ((a.intval>>3) < toInt(v2))?TTRUE:TFALSE;
+					return ((getIntValue(a)) < toInt(v2))?TTRUE:TFALSE;
 			}
 			break;
 		}
 		case ATOM_UINTEGER:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INTEGER:
-					return ((v2.intval>>3) > 0 && ((a.uintval>>3) < (uint32_t)(v2.intval>>3)))?TTRUE:TFALSE;
+					return ((getIntValue(v2)) > 0 && ((a.uintval>>3) < (uint32_t)(getIntValue(v2))))?TTRUE:TFALSE;
 				case ATOM_UINTEGER:
 					return ((a.uintval>>3) < (v2.uintval>>3))?TTRUE:TFALSE;
 				case ATOM_NUMBERPTR:
@@ -3412,10 +3482,10 @@ TRISTATE asAtomHandler::isLessIntern(asAtom& a,SystemState *sys, asAtom &v2)
 		{
 			if(std::isnan(toNumber(a)))
 				return TUNDEFINED;
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INTEGER:
-					return (toNumber(a) < (v2.intval>>3))?TTRUE:TFALSE;
+					return (toNumber(a) < (getIntValue(v2)))?TTRUE:TFALSE;
 				case ATOM_UINTEGER:
 					return (toNumber(a) < (v2.uintval>>3))?TTRUE:TFALSE;
 				case ATOM_NUMBERPTR:
@@ -3449,10 +3519,10 @@ TRISTATE asAtomHandler::isLessIntern(asAtom& a,SystemState *sys, asAtom &v2)
 			{
 				case ATOMTYPE_NULL_BIT:
 				{
-					switch (v2.uintval&0x7)
+					switch(getAtomType(v2))
 					{
 						case ATOM_INTEGER:
-							return (0 < (v2.intval>>3))?TTRUE:TFALSE;
+							return (0 < (getIntValue(v2)))?TTRUE:TFALSE;
 						case ATOM_UINTEGER:
 							return (0 < (v2.uintval>>3))?TTRUE:TFALSE;
 						case ATOM_STRINGID:
@@ -3483,10 +3553,10 @@ TRISTATE asAtomHandler::isLessIntern(asAtom& a,SystemState *sys, asAtom &v2)
 					return TUNDEFINED;
 				case ATOMTYPE_BOOL_BIT:
 				{
-					switch (v2.uintval&0x7)
+					switch(getAtomType(v2))
 					{
 						case ATOM_INTEGER:
-							return ((int32_t)(a.uintval&0x80)>>7 < (v2.intval>>3))?TTRUE:TFALSE;
+							return ((int32_t)(a.uintval&0x80)>>7 < (getIntValue(v2)))?TTRUE:TFALSE;
 						case ATOM_UINTEGER:
 							return ((a.uintval&0x80)>>7 < (v2.uintval>>3))?TTRUE:TFALSE;
 						case ATOM_NUMBERPTR:
@@ -3519,7 +3589,7 @@ TRISTATE asAtomHandler::isLessIntern(asAtom& a,SystemState *sys, asAtom &v2)
 		}
 		case ATOM_STRINGID:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_STRINGID:
 					if (((a.uintval>>3) < BUILTIN_STRINGS_CHAR_MAX) && ((v2.uintval>>3) < BUILTIN_STRINGS_CHAR_MAX))
@@ -3545,7 +3615,7 @@ TRISTATE asAtomHandler::isLessIntern(asAtom& a,SystemState *sys, asAtom &v2)
 				}
 				default:
 				{
-					TRISTATE ret = getObject(v2)->isLessAtom(a);
+					TRISTATE ret = toObject(v2,sys)->isLessAtom(a);
 					switch (ret)
 					{
 						case TTRUE:
@@ -3561,7 +3631,7 @@ TRISTATE asAtomHandler::isLessIntern(asAtom& a,SystemState *sys, asAtom &v2)
 		}
 		case ATOM_STRINGPTR:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INTEGER:
 				case ATOM_UINTEGER:
@@ -3576,10 +3646,10 @@ TRISTATE asAtomHandler::isLessIntern(asAtom& a,SystemState *sys, asAtom &v2)
 		}
 		case ATOM_U_INTEGERPTR:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INTEGER:
-					return (toInt(a) < (v2.intval>>3))?TTRUE:TFALSE;
+					return (toInt(a) < (getIntValue(v2)))?TTRUE:TFALSE;
 				case ATOM_UINTEGER:
 					return (toUInt(a) < (v2.uintval>>3))?TTRUE:TFALSE;
 				case ATOM_NUMBERPTR:
@@ -3608,26 +3678,25 @@ TRISTATE asAtomHandler::isLessIntern(asAtom& a,SystemState *sys, asAtom &v2)
 		default:
 			break;
 	}
-	assert(getObject(a));
-	assert(getObject(v2));
-	return getObject(a)->isLess(getObject(v2));
+	// numbers may be stored inline, so we have to make sure we compare two objects
+	return toObject(a,sys)->isLess(toObject(v2,sys));
 }
 
 bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 {
-	switch (a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INTEGER:
 					return false;
 				case ATOM_UINTEGER:
-					return (a.intval>>3) >= 0 && (a.intval>>3)==toInt(v2);
+					return (getIntValue(a)) >= 0 && (getIntValue(a))==toInt(v2);
 				case ATOM_U_INTEGERPTR:
 				case ATOM_NUMBERPTR:
-					return (a.intval>>3)==toNumber(v2);
+					return (getIntValue(a))==toNumber(v2);
 				case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 				{
 					switch (v2.uintval&0x70)
@@ -3637,25 +3706,25 @@ bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 						case ATOMTYPE_UNDEFINED_BIT:
 							return false;
 						case ATOMTYPE_BOOL_BIT:
-							return (a.intval>>3)==toInt(v2);
+							return (getIntValue(a))==toInt(v2);
 						default: // INVALID
 							return false;
 					}
 				}
 				case ATOM_STRINGID:
 				case ATOM_STRINGPTR:
-					return (a.intval>>3)==toNumber(v2);
+					return (getIntValue(a))==toNumber(v2);
 				default:
-					return (a.intval>>3)==toInt(v2);
+					return (getIntValue(a))==toInt(v2);
 			}
 			break;
 		}
 		case ATOM_UINTEGER:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INTEGER:
-					return (v2.intval>>3) >= 0 && (a.uintval>>3)==toUInt(v2);
+					return (getIntValue(v2)) >= 0 && (a.uintval>>3)==toUInt(v2);
 				case ATOM_UINTEGER:
 					return false;
 				case ATOM_NUMBERPTR:
@@ -3685,7 +3754,7 @@ bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 		}
 		case ATOM_NUMBERPTR:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INTEGER:
 				case ATOM_UINTEGER:
@@ -3716,7 +3785,7 @@ bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 		}
 		case ATOM_U_INTEGERPTR:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INTEGER:
 				case ATOM_UINTEGER:
@@ -3753,7 +3822,7 @@ bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 				case ATOMTYPE_NULL_BIT:
 				case ATOMTYPE_UNDEFINED_BIT:
 				{
-					switch (v2.uintval&0x7)
+					switch(getAtomType(v2))
 					{
 						case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 						{
@@ -3777,7 +3846,7 @@ bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 					}
 				}
 				case ATOMTYPE_BOOL_BIT:
-					switch (v2.uintval&0x7)
+					switch(getAtomType(v2))
 					{
 						case ATOM_STRINGID:
 							return (bool)((a.uintval&0x80)>>7)==toNumber(v2);
@@ -3807,7 +3876,7 @@ bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 		}
 		case ATOM_STRINGID:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 				{
@@ -3835,7 +3904,7 @@ bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 		}
 		case ATOM_STRINGPTR:
 		{
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 				{
@@ -3870,7 +3939,7 @@ bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 				else
 					return false;
 			}
-			switch (v2.uintval&0x7)
+			switch(getAtomType(v2))
 			{
 				case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 					return getObject(a)->isEqual(toObject(v2,sys));
@@ -3891,9 +3960,8 @@ bool asAtomHandler::isEqualIntern(asAtom& a, SystemState *sys, asAtom &v2)
 		default:
 			break;
 	}
-	assert(getObject(a));
-	assert(getObject(v2));
-	return getObject(a)->isEqual(getObject(v2));
+	// numbers may be stored inline, so we have to make sure we compare two objects
+	return toObject(a,sys)->isEqual(toObject(v2,sys));
 }
 
 ASObject *asAtomHandler::toObject(asAtom& a, SystemState *sys, bool isconstant)
@@ -3903,11 +3971,11 @@ ASObject *asAtomHandler::toObject(asAtom& a, SystemState *sys, bool isconstant)
 		assert(getObjectNoCheck(a) && getObjectNoCheck(a)->getRefCount() >= 1);
 		return getObjectNoCheck(a);
 	}
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 			// ints are internally treated as numbers, so create a Number instance
-			a.uintval = ((LIGHTSPARK_ATOM_VALTYPE)abstract_di(sys,(a.intval>>3)))|ATOM_U_INTEGERPTR;
+			a.uintval = ((LIGHTSPARK_ATOM_VALTYPE)abstract_di(sys,(getIntValue(a))))|ATOM_U_INTEGERPTR;
 			break;
 		case ATOM_UINTEGER:
 			// uints are internally treated as numbers, so create a Number instance
@@ -3931,6 +3999,12 @@ ASObject *asAtomHandler::toObject(asAtom& a, SystemState *sys, bool isconstant)
 		case ATOM_STRINGID:
 			a.uintval = ((LIGHTSPARK_ATOM_VALTYPE)abstract_s(sys,(a.uintval>>3))) | ATOM_STRINGPTR ;
 			break;
+#ifdef LIGHTSPARK_NANBOXING
+		case ATOM_NUMBERPTR:
+			// number is stored inline, so create a Number instance
+			a.uintval = ((LIGHTSPARK_ATOM_VALTYPE)abstract_d(sys,getInlineNumber(a))) | ATOM_NUMBERPTR;
+			break;
+#endif
 		default:
 			throw RunTimeException("calling toObject on invalid asAtom, should not happen");
 			break;
@@ -271,6 +271,7 @@ class ABCContext;
 class SystemState;
 class SyntheticFunction;
 class SoundTransform;
+class JSONStringifier;
 class KeyboardEvent;
 class EventDispatcher;
 class MouseEvent;
@@ -327,6 +328,11 @@ union asAtom
 // dddd d011: int
 // dddd d111: (U)Integer
 // dddd d100: ASObject
+//
+// if LIGHTSPARK_NANBOXING is defined (64bit only), Numbers are stored inline:
+// all atoms described above use only the lower 48 bits (ints are limited to 45 bits, larger values are stored as Numbers),
+// so every value with one of the upper 16 bits set is a double whose bit pattern was shifted by ATOM_INLINENUMBER_OFFSET.
+// NaNs are canonicalized to make sure the shifted value can't overflow
 enum ATOM_TYPE 
 { 
 	ATOM_INVALID_UNDEFINED_NULL_BOOL=0x0, 
@@ -346,6 +352,11 @@ private:
 #define ATOMTYPE_UNDEFINED_BIT 0x20
 #define ATOMTYPE_BOOL_BIT 0x10
 #define ATOMTYPE_OBJECT_BIT 0x4
+#ifdef LIGHTSPARK_NANBOXING
+#define ATOM_INLINENUMBER_OFFSET 0x0001000000000000ULL
+#define ATOM_CANONICAL_NAN 0x7ff8000000000000ULL
+#define ATOM_MAX_INLINEINT 0x0000100000000000LL
+#endif
 	static void decRef(asAtom& a);
 	static void replaceBool(asAtom &a, ASObject* obj);
 	static bool Boolean_concrete_string(asAtom &a);
@@ -387,10 +398,55 @@ public:
 		}
 		return a;
 	}
+	static FORCE_INLINE bool isInlineNumber(const asAtom& a)
+	{
+#ifdef LIGHTSPARK_NANBOXING
+		return a.uintval >= ATOM_INLINENUMBER_OFFSET;
+#else
+		return false;
+#endif
+	}
+	// returns the ATOM_TYPE of the atom, inline Numbers are reported as ATOM_NUMBERPTR
+	static FORCE_INLINE LIGHTSPARK_ATOM_VALTYPE getAtomType(const asAtom& a)
+	{
+		return isInlineNumber(a) ? ATOM_NUMBERPTR : (a.uintval&0x7);
+	}
+	// returns the (sign extended) value of an ATOM_INTEGER atom
+	static FORCE_INLINE int64_t getIntValue(const asAtom& a)
+	{
+#ifdef LIGHTSPARK_NANBOXING
+		return ((int64_t)(a.uintval<<16))>>19;
+#else
+		return a.intval>>3;
+#endif
+	}
+#ifdef LIGHTSPARK_NANBOXING
+	static FORCE_INLINE number_t getInlineNumber(const asAtom& a)
+	{
+		assert(isInlineNumber(a));
+		uint64_t bits = a.uintval - ATOM_INLINENUMBER_OFFSET;
+		number_t res;
+		memcpy(&res,&bits,sizeof(number_t));
+		return res;
+	}
+	static FORCE_INLINE void setInlineNumber(asAtom& a, number_t val)
+	{
+		uint64_t bits;
+		if (std::isnan(val))
+			bits = ATOM_CANONICAL_NAN;
+		else
+			memcpy(&bits,&val,sizeof(number_t));
+		a.uintval = bits + ATOM_INLINENUMBER_OFFSET;
+	}
+	// ECMA-262 9.5 ToInt32 for inline Numbers
+	static int32_t inlineNumberToInt(const asAtom& a);
+#endif
 	static FORCE_INLINE asAtom fromInt(int32_t val)
 	{
 		asAtom a=asAtomHandler::invalidAtom;
-#ifdef LIGHTSPARK_64
+#ifdef LIGHTSPARK_NANBOXING
+		a.uintval = (((uint64_t)(((int64_t)val)<<3))|ATOM_INTEGER) & (ATOM_INLINENUMBER_OFFSET-1);
+#elif defined(LIGHTSPARK_64)
 		a.intval = ((((int64_t)val)<<3)|ATOM_INTEGER);
 #else
 		a.intval = ((val<<3)|ATOM_INTEGER);
@@ -414,7 +470,11 @@ public:
 	static FORCE_INLINE asAtom fromNumber(SystemState* sys, number_t val,bool constant)
 	{
 		asAtom a=asAtomHandler::invalidAtom;
+#ifdef LIGHTSPARK_NANBOXING
+		setInlineNumber(a,val);
+#else
 		a.uintval =((LIGHTSPARK_ATOM_VALTYPE)(constant ? abstract_d_constant(sys,val) : abstract_d(sys,val))|ATOM_NUMBERPTR);
+#endif
 		return a;
 	}
 	
@@ -485,15 +545,15 @@ public:
 	static FORCE_INLINE bool isNumber(const asAtom& a); 
 	static FORCE_INLINE bool isValid(const asAtom& a) { return a.uintval; }
 	static FORCE_INLINE bool isInvalid(const asAtom& a) { return !a.uintval; }
-	static FORCE_INLINE bool isNull(const asAtom& a) { return (a.uintval&0x7f) == ATOMTYPE_NULL_BIT; }
-	static FORCE_INLINE bool isUndefined(const asAtom& a) { return (a.uintval&0x7f) == ATOMTYPE_UNDEFINED_BIT; }
-	static FORCE_INLINE bool isBool(const asAtom& a) { return (a.uintval&0x7f) == ATOMTYPE_BOOL_BIT; }
+	static FORCE_INLINE bool isNull(const asAtom& a) { return !isInlineNumber(a) && (a.uintval&0x7f) == ATOMTYPE_NULL_BIT; }
+	static FORCE_INLINE bool isUndefined(const asAtom& a) { return !isInlineNumber(a) && (a.uintval&0x7f) == ATOMTYPE_UNDEFINED_BIT; }
+	static FORCE_INLINE bool isBool(const asAtom& a) { return !isInlineNumber(a) && (a.uintval&0x7f) == ATOMTYPE_BOOL_BIT; }
 	static FORCE_INLINE bool isInteger(const asAtom& a);
 	static FORCE_INLINE bool isUInteger(const asAtom& a);
-	static FORCE_INLINE bool isObject(const asAtom& a) { return a.uintval & ATOMTYPE_OBJECT_BIT; }
+	static FORCE_INLINE bool isObject(const asAtom& a) { return !isInlineNumber(a) && (a.uintval & ATOMTYPE_OBJECT_BIT); }
 	static FORCE_INLINE bool isFunction(const asAtom& a);
 	static FORCE_INLINE bool isString(const asAtom& a);
-	static FORCE_INLINE bool isStringID(const asAtom& a) { return (a.uintval&0x7) == ATOM_STRINGID; }
+	static FORCE_INLINE bool isStringID(const asAtom& a) { return getAtomType(a) == ATOM_STRINGID; }
 	static FORCE_INLINE bool isQName(const asAtom& a);
 	static FORCE_INLINE bool isNamespace(const asAtom& a);
 	static FORCE_INLINE bool isArray(const asAtom& a);
@@ -518,9 +578,9 @@ public:
 	static bool Boolean_concrete(asAtom& a);
 	static bool Boolean_concrete_object(asAtom& a);
 	static void convert_b(asAtom& a, bool refcounted);
-	static FORCE_INLINE int32_t getInt(const asAtom& a) { assert((a.uintval&0x3) == ATOM_INTEGER || (a.uintval&0x3) == ATOM_UINTEGER); return a.intval>>3; }
-	static FORCE_INLINE uint32_t getUInt(const asAtom& a) { assert((a.uintval&0x3) == ATOM_UINTEGER || (a.uintval&0x3) == ATOM_INTEGER); return a.uintval>>3; }
-	static FORCE_INLINE uint32_t getStringId(const asAtom& a) { assert((a.uintval&0x3) == ATOM_STRINGID); return a.uintval>>3; }
+	static FORCE_INLINE int32_t getInt(const asAtom& a) { assert((getAtomType(a)&0x3) == ATOM_INTEGER || (getAtomType(a)&0x3) == ATOM_UINTEGER); return getIntValue(a); }
+	static FORCE_INLINE uint32_t getUInt(const asAtom& a) { assert((getAtomType(a)&0x3) == ATOM_UINTEGER || (getAtomType(a)&0x3) == ATOM_INTEGER); return a.uintval>>3; }
+	static FORCE_INLINE uint32_t getStringId(const asAtom& a) { assert((getAtomType(a)&0x3) == ATOM_STRINGID); return a.uintval>>3; }
 	static FORCE_INLINE void setInt(asAtom& a,SystemState* sys, int64_t val);
 	static FORCE_INLINE void setUInt(asAtom& a,SystemState* sys, uint32_t val);
 	static void setNumber(asAtom& a,SystemState* sys,number_t val);
@@ -630,6 +690,98 @@ struct varName
 	}
 };
 
+#define SHAPE_MAX_VARIABLES 256
+#define SHAPE_MAX_COUNT 65536
+/*
+ * Shared description of the layout of a variables_map (a "hidden class").
+ * Maps that got the same variables (name, namespace and kind) added in the same order
+ * have the same shape, so the position of a variable in variables_map::shapeVars
+ * only depends on the shape and not on the object.
+ * Shapes form a tree starting at the empty root shape and are never deleted.
+ */
+class VariableShape
+{
+private:
+	struct transitionKey
+	{
+		uint32_t nameId;
+		uint32_t nsId;
+		TRAIT_KIND kind;
+		inline bool operator==(const transitionKey& r) const
+		{
+			return nameId==r.nameId && nsId==r.nsId && kind==r.kind;
+		}
+	};
+	struct transitionKeyHash
+	{
+		inline size_t operator()(const transitionKey& k) const
+		{
+			return std::hash<uint64_t>()((uint64_t(k.nameId)<<32) ^ (uint64_t(k.nsId)<<4) ^ uint64_t(k.kind));
+		}
+	};
+	VariableShape* parent;
+	transitionKey key;
+	// number of variables described by this shape
+	uint32_t count;
+	// the most recently added transition, can be checked without locking transitionMutex
+	ACQUIRE_RELEASE_VARIABLE(VariableShape*, lastTransition);
+	std::unordered_map<transitionKey,VariableShape*,transitionKeyHash> transitions;
+	static Mutex transitionMutex;
+	static ATOMIC_INT32(shapeCount);
+	VariableShape(VariableShape* p, const transitionKey& k);
+public:
+	static VariableShape* getRoot();
+	/*
+	 * Returns the shape resulting from adding a variable to a map of this shape.
+	 * Returns nullptr if the map has too many variables or too many shapes exist,
+	 * in that case the map should stop using shapes.
+	 */
+	VariableShape* addVariable(uint32_t nameId, uint32_t nsId, TRAIT_KIND kind);
+	inline VariableShape* getParent() const { return parent; }
+	inline uint32_t getNameId() const { return key.nameId; }
+	inline uint32_t getNsId() const { return key.nsId; }
+	inline uint32_t getCount() const { return count; }
+};
+
+#define PROPERTYCACHE_SIZE 4
+/*
+ * Polymorphic inline cache of a getproperty/setproperty call site.
+ * It maps the shapes of the objects seen at the call site to the position
+ * of the accessed variable in variables_map::shapeVars
+ */
+struct PropertyCache
+{
+	VariableShape* shapes[PROPERTYCACHE_SIZE];
+	uint32_t positions[PROPERTYCACHE_SIZE];
+	uint32_t next;
+	PropertyCache() { clear(); }
+	FORCE_INLINE int32_t find(const VariableShape* shape) const
+	{
+		for (uint32_t i = 0; i < PROPERTYCACHE_SIZE; i++)
+		{
+			if (shapes[i]==shape)
+				return positions[i];
+		}
+		return -1;
+	}
+	// replaces the oldest entry
+	void add(VariableShape* shape, uint32_t position)
+	{
+		shapes[next]=shape;
+		positions[next]=position;
+		next = (next+1)%PROPERTYCACHE_SIZE;
+	}
+	void clear()
+	{
+		for (uint32_t i = 0; i < PROPERTYCACHE_SIZE; i++)
+		{
+			shapes[i]=nullptr;
+			positions[i]=0;
+		}
+		next=0;
+	}
+};
+
 class variables_map
 {
 public:
@@ -642,7 +794,30 @@ public:
 	uint32_t slotcount;
 	// indicates if this map was initialized with no variables with non-primitive values
 	bool cloneable;
+	// shape of this map, nullptr if it doesn't use shapes (e.g. after a variable was deleted)
+	VariableShape* shape;
+	// the variables in the order they were added, only valid if shape is set
+	std::vector<variable*> shapeVars;
 	variables_map(MemoryAccount* m);
+	// has to be called for every variable added to the map
+	FORCE_INLINE void addToShape(variable* v, uint32_t nameId)
+	{
+		if (!shape)
+			return;
+		shape = shape->addVariable(nameId,v->ns.nsId,v->kind);
+		if (shape)
+			shapeVars.push_back(v);
+		else
+			shapeVars.clear();
+	}
+	// has to be called if a variable is removed from the map or its kind is changed
+	FORCE_INLINE void dropShape()
+	{
+		shape=nullptr;
+		shapeVars.clear();
+	}
+	// returns the position of v in shapeVars, or -1 if it is not found
+	int32_t getShapePosition(const variable* v) const;
 	/**
 	   Find a variable in the map
 
@@ -658,6 +833,7 @@ public:
 		var_iterator inserted=Variables.insert(Variables.cbegin(),
 				make_pair(nameID,variable(DYNAMIC_TRAIT,nsNameAndKind())));
 		asAtomHandler::set(inserted->second.var,v);
+		addToShape(&inserted->second,nameID);
 	}
 
 	/**
@@ -810,6 +986,8 @@ public:
 				std::map<const Class_base*, uint32_t>& traitsMap);
 	void dumpVariables();
 	void destroyContents();
+	// adds the objects released by destroyContents()
+	void getReferencedObjects(std::vector<ASObject*>& refs) const;
 	bool cloneInstance(variables_map& map);
 	void removeAllDeclaredProperties();
 };
@@ -831,11 +1009,19 @@ friend class SystemState;
 friend struct variable;
 friend class variables_map;
 friend class RootMovieClip;
+friend class CycleCollector;
 public:
 	asfreelist* objfreelist;
 private:
 	variables_map Variables;
 	Class_base* classdef;
+	// position+1 in the candidate buffer of the cycle collector, 0 if not buffered
+	uint32_t cycleCandidateIndex;
+	// returns false if the object was handed to the vm thread instead, as it is buffered there
+	bool removeFromCycleCollector(bool canDefer);
+	// report allocations and deletions to the sampler, only called while memory_reporter::sampleAllocations is set
+	void sampleAllocation(uint32_t size);
+	void sampleDeletion();
 	inline const variable* findGettable(const multiname& name, uint32_t* nsRealId = nullptr) const DLL_LOCAL
 	{
 		const variable* ret=Variables.findObjVarConst(getSystemState(),name,DECLARED_TRAIT|DYNAMIC_TRAIT,nsRealId);
@@ -853,7 +1039,7 @@ private:
 	multiname* proxyMultiName;
 	SystemState* sys;
 protected:
-	ASObject(MemoryAccount* m):objfreelist(nullptr),Variables(m),classdef(nullptr),proxyMultiName(nullptr),sys(nullptr),
+	ASObject(MemoryAccount* m):objfreelist(nullptr),Variables(m),classdef(nullptr),cycleCandidateIndex(0),proxyMultiName(nullptr),sys(nullptr),
 		stringId(UINT32_MAX),type(T_OBJECT),subtype(SUBTYPE_NOT_SET),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),implEnable(true)
 	{
 #ifndef NDEBUG
@@ -865,6 +1051,10 @@ protected:
 	ASObject(const ASObject& o);
 	virtual ~ASObject()
 	{
+		if (cycleCandidateIndex)
+			removeFromCycleCollector(false);
+		if (USUALLY_FALSE(sampleAllocations))
+			sampleDeletion();
 		destroy();
 	}
 	uint32_t stringId;
@@ -919,6 +1109,11 @@ protected:
 
 	FORCE_INLINE bool destructIntern()
 	{
+		if (cycleCandidateIndex && !removeFromCycleCollector(true))
+			return false;
+		if (USUALLY_FALSE(sampleAllocations))
+			sampleDeletion();
+		resetCycleCandidate();
 		destroyContents();
 		if (proxyMultiName)
 		{
@@ -1003,6 +1198,21 @@ public:
 	   The finalize method must be callable multiple time with the same effects (no double frees).
 	*/
 	inline virtual void finalize() {}
+	/*
+	   Used by the cycle collector to find the objects this object holds a reference to.
+	   Only references that are released by unlinkReferencedObjects() may be added,
+	   missing some of them only prevents the collection of cycles through them.
+	*/
+	virtual void getReferencedObjects(std::vector<ASObject*>& refs);
+	/*
+	   Called by the cycle collector on objects that are only referenced by garbage cycles.
+	   It has to decRef the objects reported by getReferencedObjects().
+	*/
+	virtual void unlinkReferencedObjects();
+	// whether the cycle collector may examine and break cycles through this object
+	bool isCycleCollectable() const;
+	// the part of isCycleCollectable() that doesn't change while the object is alive
+	bool isCycleCollectableKind() const;
 	// use this to mark an ASObject as constant, instead of RefCountable->setConstant()
 	// because otherwise it will not be properly deleted on application exit.
 	void setRefConstant();
@@ -1028,6 +1238,58 @@ public:
 	 * If the property found is a getter, it is called and its return value returned.
 	 */
 	GET_VARIABLE_RESULT getVariableByMultinameIntern(asAtom& ret, const multiname& name, Class_base* cls, GET_VARIABLE_OPTION opt=NONE);
+	/*
+	 * true for objects that don't override the property lookup of ASObject,
+	 * so their variables can be accessed directly through the property inline caches
+	 */
+	FORCE_INLINE bool hasDefaultPropertyAccess() const
+	{
+		return type==T_OBJECT && subtype==SUBTYPE_NOT_SET;
+	}
+	/*
+	 * Fast path for getproperty using the inline cache of the call site.
+	 * Returns false if the shape of this object is not in the cache or the variable
+	 * can't be read directly (getters, methods). The caller then has to use getVariableByMultiname.
+	 * The result is increffed.
+	 */
+	FORCE_INLINE bool getVariableFromPropertyCache(asAtom& ret, const PropertyCache* cache)
+	{
+		if (!Variables.shape || !hasDefaultPropertyAccess())
+			return false;
+		int32_t pos = cache->find(Variables.shape);
+		if (pos < 0)
+			return false;
+		variable* v = Variables.shapeVars[pos];
+		if (asAtomHandler::isValid(v->getter) || asAtomHandler::isInvalid(v->var) || asAtomHandler::isFunction(v->var))
+			return false;
+		ASATOM_INCREF(v->var);
+		asAtomHandler::set(ret,v->var);
+		return true;
+	}
+	/*
+	 * Fast path for setproperty using the inline cache of the call site.
+	 * Returns false without consuming o if the variable can't be set directly
+	 * (setters, constants, functions that need a scope check).
+	 */
+	FORCE_INLINE bool setVariableFromPropertyCache(asAtom& o, const PropertyCache* cache)
+	{
+		if (!Variables.shape || !hasDefaultPropertyAccess())
+			return false;
+		int32_t pos = cache->find(Variables.shape);
+		if (pos < 0)
+			return false;
+		variable* v = Variables.shapeVars[pos];
+		if (v->kind == CONSTANT_TRAIT || asAtomHandler::isValid(v->setter) || asAtomHandler::isValid(v->getter)
+				|| asAtomHandler::isInvalid(v->var) || asAtomHandler::isFunction(o))
+			return false;
+		v->setVar(o,this);
+		return true;
+	}
+	/*
+	 * Adds the own variable found for name to the inline cache of the call site,
+	 * if it can be accessed through the cache
+	 */
+	void updatePropertyCache(const multiname& name, PropertyCache* cache, bool forSetting);
 	GET_VARIABLE_RESULT getVariableByIntegerIntern(asAtom& ret, int index, GET_VARIABLE_OPTION opt=NONE)
 	{
 		multiname m(nullptr);
@@ -1186,7 +1448,6 @@ public:
 	void call_valueOf(asAtom &ret);
 	bool has_toString();
 	void call_toString(asAtom &ret);
-	tiny_string call_toJSON(bool &ok, std::vector<ASObject *> &path, asAtom replacer, const tiny_string &spaces, const tiny_string &filter);
 
 	/* Helper function for calling getClass()->getQualifiedClassName() */
 	virtual tiny_string getClassName() const;
@@ -1232,7 +1493,8 @@ public:
 
 	virtual ASObject *describeType() const;
 
-	virtual tiny_string toJSON(std::vector<ASObject *> &path, asAtom replacer, const tiny_string &spaces,const tiny_string& filter);
+	// appends the JSON text of this non primitive object, indent is the indentation of the current level
+	virtual void toJSON(JSONStringifier& s, const tiny_string& indent);
 	/* returns true if the current object is of type T */
 	template<class T> bool is() const { 
 		LOG(LOG_INFO,"dynamic cast:"<<this->getClassName());
@@ -1329,6 +1591,7 @@ class ContextMenuBuiltInItems;
 class ContextMenuEvent;
 class CubeTexture;
 class Date;
+class Dictionary;
 class DisplacementFilter;
 class DisplayObject;
 class DisplayObjectContainer;
@@ -1360,6 +1623,7 @@ class NetStream;
 class Null;
 class Number;
 class ObjectConstructor;
+class ObjectPrototype;
 class Point;
 class Program3D;
 class ProgressEvent;
@@ -1429,6 +1693,7 @@ template<> inline bool ASObject::is<ContextMenuEvent>() const { return subtype==
 template<> inline bool ASObject::is<ConvolutionFilter>() const { return subtype==SUBTYPE_CONVOLUTIONFILTER; }
 template<> inline bool ASObject::is<CubeTexture>() const { return subtype==SUBTYPE_CUBETEXTURE; }
 template<> inline bool ASObject::is<Date>() const { return subtype==SUBTYPE_DATE; }
+template<> inline bool ASObject::is<Dictionary>() const { return subtype==SUBTYPE_DICTIONARY; }
 template<> inline bool ASObject::is<DisplacementFilter>() const { return subtype==SUBTYPE_DISPLACEMENTFILTER; }
 template<> inline bool ASObject::is<DisplayObject>() const { return subtype==SUBTYPE_DISPLAYOBJECT || subtype==SUBTYPE_INTERACTIVE_OBJECT || subtype==SUBTYPE_TEXTFIELD || subtype==SUBTYPE_BITMAP || subtype==SUBTYPE_DISPLAYOBJECTCONTAINER || subtype==SUBTYPE_STAGE || subtype==SUBTYPE_ROOTMOVIECLIP || subtype==SUBTYPE_SPRITE || subtype == SUBTYPE_MOVIECLIP || subtype == SUBTYPE_TEXTLINE || subtype == SUBTYPE_VIDEO; }
 template<> inline bool ASObject::is<DisplayObjectContainer>() const { return subtype==SUBTYPE_DISPLAYOBJECTCONTAINER || subtype==SUBTYPE_STAGE || subtype==SUBTYPE_ROOTMOVIECLIP || subtype==SUBTYPE_SPRITE || subtype == SUBTYPE_MOVIECLIP || subtype == SUBTYPE_TEXTLINE; }
@@ -1460,6 +1725,7 @@ template<> inline bool ASObject::is<MovieClip>() const { return subtype==SUBTYPE
 template<> inline bool ASObject::is<Null>() const { return type==T_NULL; }
 template<> inline bool ASObject::is<Number>() const { return type==T_NUMBER; }
 template<> inline bool ASObject::is<ObjectConstructor>() const { return subtype==SUBTYPE_OBJECTCONSTRUCTOR; }
+template<> inline bool ASObject::is<ObjectPrototype>() const { return subtype==SUBTYPE_OBJECTPROTOTYPE; }
 template<> inline bool ASObject::is<Point>() const { return subtype==SUBTYPE_POINT; }
 template<> inline bool ASObject::is<Program3D>() const { return subtype==SUBTYPE_PROGRAM3D; }
 template<> inline bool ASObject::is<ProgressEvent>() const { return subtype==SUBTYPE_PROGRESSEVENT; }
@@ -1518,13 +1784,17 @@ template<> inline bool asAtomHandler::is<Undefined>(asAtom& a) { return isUndefi
 
 FORCE_INLINE int32_t asAtomHandler::toInt(const asAtom& a)
 {
-	if ((a.uintval&0x7)==ATOM_INTEGER)
-        return a.intval>>3;
-    else if ((a.uintval&0x7)==ATOM_UINTEGER)
+#ifdef LIGHTSPARK_NANBOXING
+	if (isInlineNumber(a))
+		return inlineNumberToInt(a);
+#endif
+	if (getAtomType(a)==ATOM_INTEGER)
+        return getIntValue(a);
+    else if (getAtomType(a)==ATOM_UINTEGER)
         return a.uintval>>3;
-    else if ((a.uintval&0x7)==ATOM_INVALID_UNDEFINED_NULL_BOOL)
+    else if (getAtomType(a)==ATOM_INVALID_UNDEFINED_NULL_BOOL)
         return (a.uintval&ATOMTYPE_BOOL_BIT) ? (a.uintval&0x80)>>7 : 0;
-    else if ((a.uintval&0x7)==ATOM_STRINGID)
+    else if (getAtomType(a)==ATOM_STRINGID)
     {
         ASObject* s = abstract_s(getSys(),a.uintval>>3);
         int32_t ret = s->toInt();
@@ -1536,10 +1806,14 @@ FORCE_INLINE int32_t asAtomHandler::toInt(const asAtom& a)
 }
 FORCE_INLINE int32_t asAtomHandler::toIntStrict(const asAtom& a)
 {
-	switch(a.uintval&0x7)
+#ifdef LIGHTSPARK_NANBOXING
+	if (isInlineNumber(a))
+		return inlineNumberToInt(a);
+#endif
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
-			return a.intval>>3;
+			return getIntValue(a);
 		case ATOM_UINTEGER:
 			return a.uintval>>3;
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
@@ -1558,10 +1832,14 @@ FORCE_INLINE int32_t asAtomHandler::toIntStrict(const asAtom& a)
 }
 FORCE_INLINE number_t asAtomHandler::toNumber(const asAtom& a)
 {
-	switch(a.uintval&0x7)
+#ifdef LIGHTSPARK_NANBOXING
+	if (isInlineNumber(a))
+		return getInlineNumber(a);
+#endif
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
-			return a.intval>>3;
+			return getIntValue(a);
 		case ATOM_UINTEGER:
 			return a.uintval>>3;
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
@@ -1580,10 +1858,14 @@ FORCE_INLINE number_t asAtomHandler::toNumber(const asAtom& a)
 }
 FORCE_INLINE number_t asAtomHandler::AVM1toNumber(asAtom& a,bool usesActionScript3)
 {
-	switch(a.uintval&0x7)
+#ifdef LIGHTSPARK_NANBOXING
+	if (isInlineNumber(a))
+		return getInlineNumber(a);
+#endif
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
-			return a.intval>>3;
+			return getIntValue(a);
 		case ATOM_UINTEGER:
 			return a.uintval>>3;
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
@@ -1602,10 +1884,10 @@ FORCE_INLINE number_t asAtomHandler::AVM1toNumber(asAtom& a,bool usesActionScrip
 }
 FORCE_INLINE bool asAtomHandler::AVM1toBool(asAtom& a)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
-			return a.intval>>3;
+			return getIntValue(a);
 		case ATOM_UINTEGER:
 			return a.uintval>>3;
 		case ATOM_NUMBERPTR:
@@ -1619,10 +1901,19 @@ FORCE_INLINE bool asAtomHandler::AVM1toBool(asAtom& a)
 
 FORCE_INLINE int64_t asAtomHandler::toInt64(const asAtom& a)
 {
-	switch(a.uintval&0x7)
+#ifdef LIGHTSPARK_NANBOXING
+	if (isInlineNumber(a))
+	{
+		number_t d = getInlineNumber(a);
+		if(std::isnan(d) || std::isinf(d))
+			return INT64_MAX;
+		return (int64_t)d;
+	}
+#endif
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
-			return a.intval>>3;
+			return getIntValue(a);
 		case ATOM_UINTEGER:
 			return a.uintval>>3;
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
@@ -1641,10 +1932,14 @@ FORCE_INLINE int64_t asAtomHandler::toInt64(const asAtom& a)
 }
 FORCE_INLINE uint32_t asAtomHandler::toUInt(asAtom& a)
 {
-	switch(a.uintval&0x7)
+#ifdef LIGHTSPARK_NANBOXING
+	if (isInlineNumber(a))
+		return (unsigned int)(getInlineNumber(a));
+#endif
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
-			return a.intval>>3;
+			return getIntValue(a);
 		case ATOM_UINTEGER:
 			return a.uintval>>3;
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
@@ -1664,7 +1959,7 @@ FORCE_INLINE uint32_t asAtomHandler::toUInt(asAtom& a)
 
 FORCE_INLINE void asAtomHandler::applyProxyProperty(asAtom& a,SystemState* sys,multiname &name)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 		case ATOM_UINTEGER:
@@ -1686,7 +1981,7 @@ FORCE_INLINE bool asAtomHandler::isEqualStrict(asAtom& a, SystemState *sys, asAt
 	if(getObjectType(a)!=getObjectType(v2))
 	{
 		//Type conversions are ok only for numeric types
-		switch(a.uintval&0x7)
+		switch(getAtomType(a))
 		{
 			case ATOM_NUMBERPTR:
 			case ATOM_INTEGER:
@@ -1713,7 +2008,7 @@ FORCE_INLINE bool asAtomHandler::isEqualStrict(asAtom& a, SystemState *sys, asAt
 			default:
 				return false;
 		}
-		switch(v2.uintval&0x7)
+		switch(getAtomType(v2))
 		{
 			case ATOM_NUMBERPTR:
 			case ATOM_INTEGER:
@@ -1746,7 +2041,7 @@ FORCE_INLINE bool asAtomHandler::isEqualStrict(asAtom& a, SystemState *sys, asAt
 
 FORCE_INLINE bool asAtomHandler::isConstructed(const asAtom& a)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 		case ATOM_UINTEGER:
@@ -1768,9 +2063,9 @@ FORCE_INLINE bool asAtomHandler::isPrimitive(const asAtom& a)
 }
 FORCE_INLINE bool asAtomHandler::checkArgumentConversion(const asAtom& a,const asAtom& obj)
 {
-	if ((a.uintval&0x7) == (obj.uintval&0x7))
+	if (getAtomType(a) == getAtomType(obj))
 	{
-		if ((a.uintval&0x7) == ATOM_OBJECTPTR)
+		if (getAtomType(a) == ATOM_OBJECTPTR)
 			return getObjectNoCheck(a)->getObjectType() == getObjectNoCheck(obj)->getObjectType();
 		return true;
 	}
@@ -1781,7 +2076,12 @@ FORCE_INLINE bool asAtomHandler::checkArgumentConversion(const asAtom& a,const a
 
 FORCE_INLINE void asAtomHandler::setInt(asAtom& a,SystemState* sys, int64_t val)
 {
-#ifdef LIGHTSPARK_64
+#ifdef LIGHTSPARK_NANBOXING
+	if (val >= -ATOM_MAX_INLINEINT && val < ATOM_MAX_INLINEINT)
+		a.uintval = (((uint64_t)(val<<3))|ATOM_INTEGER) & (ATOM_INLINENUMBER_OFFSET-1);
+	else
+		setNumber(a,sys,val);
+#elif defined(LIGHTSPARK_64)
 	a.intval = ((int64_t)val<<3)|ATOM_INTEGER;
 #else
 	if (val >=-(1<<28)  && val <=(1<<28))
@@ -1818,7 +2118,7 @@ FORCE_INLINE void asAtomHandler::setUndefined(asAtom& a)
 }
 FORCE_INLINE void asAtomHandler::increment(asAtom& a,SystemState* sys)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 		{
@@ -1839,7 +2139,7 @@ FORCE_INLINE void asAtomHandler::increment(asAtom& a,SystemState* sys)
 			break;
 		}
 		case ATOM_INTEGER:
-			setInt(a,sys,(a.intval>>3)+1);
+			setInt(a,sys,(getIntValue(a))+1);
 			break;
 		case ATOM_UINTEGER:
 			setUInt(a,sys,(a.uintval>>3)+1);
@@ -1866,7 +2166,7 @@ FORCE_INLINE void asAtomHandler::increment(asAtom& a,SystemState* sys)
 
 FORCE_INLINE void asAtomHandler::decrement(asAtom& a,SystemState* sys)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 		{
@@ -1923,15 +2223,15 @@ FORCE_INLINE void asAtomHandler::decrement(asAtom& a,SystemState* sys)
 
 FORCE_INLINE void asAtomHandler::increment_i(asAtom& a,SystemState* sys)
 {
-	if ((a.uintval&0x7) == ATOM_INTEGER)
-		setInt(a,sys,int32_t(a.intval>>3)+1);
+	if (getAtomType(a) == ATOM_INTEGER)
+		setInt(a,sys,int32_t(getIntValue(a))+1);
 	else
 		setInt(a,sys,toInt(a)+1);
 }
 FORCE_INLINE void asAtomHandler::decrement_i(asAtom& a,SystemState* sys)
 {
-	if ((a.uintval&0x7) == ATOM_INTEGER)
-		setInt(a,sys,int32_t(a.intval>>3)-1);
+	if (getAtomType(a) == ATOM_INTEGER)
+		setInt(a,sys,int32_t(getIntValue(a))-1);
 	else
 		setInt(a,sys,toInt(a)-1);
 }
@@ -1953,8 +2253,8 @@ FORCE_INLINE void asAtomHandler::bitnot(asAtom& a,SystemState* sys)
 
 FORCE_INLINE void asAtomHandler::subtract(asAtom& a,SystemState* sys,asAtom &v2, bool forceint)
 {
-	if( ((a.uintval&0x7) == ATOM_INTEGER || (a.uintval&0x7) == ATOM_UINTEGER) &&
-		(isInteger(v2) || (v2.uintval&0x7) ==ATOM_UINTEGER))
+	if( (getAtomType(a) == ATOM_INTEGER || getAtomType(a) == ATOM_UINTEGER) &&
+		(isInteger(v2) || getAtomType(v2) ==ATOM_UINTEGER))
 	{
 		int64_t num1=toInt64(a);
 		int64_t num2=toInt64(v2);
@@ -1982,8 +2282,8 @@ FORCE_INLINE void asAtomHandler::subtract(asAtom& a,SystemState* sys,asAtom &v2,
 }
 FORCE_INLINE void asAtomHandler::subtractreplace(asAtom& ret,SystemState* sys,const asAtom &v1, const asAtom &v2, bool forceint)
 {
-	if( ((v1.uintval&0x7) == ATOM_INTEGER || (v1.uintval&0x7) == ATOM_UINTEGER) &&
-		(isInteger(v2) || (v2.uintval&0x7) ==ATOM_UINTEGER))
+	if( (getAtomType(v1) == ATOM_INTEGER || getAtomType(v1) == ATOM_UINTEGER) &&
+		(isInteger(v2) || getAtomType(v2) ==ATOM_UINTEGER))
 	{
 		int64_t num1=toInt64(v1);
 		int64_t num2=toInt64(v2);
@@ -2018,8 +2318,8 @@ FORCE_INLINE void asAtomHandler::subtractreplace(asAtom& ret,SystemState* sys,co
 
 FORCE_INLINE void asAtomHandler::multiply(asAtom& a,SystemState* sys,asAtom &v2, bool forceint)
 {
-	if( ((a.uintval&0x7) == ATOM_INTEGER || (a.uintval&0x7) == ATOM_UINTEGER) &&
-		(isInteger(v2) || (v2.uintval&0x7) ==ATOM_UINTEGER))
+	if( (getAtomType(a) == ATOM_INTEGER || getAtomType(a) == ATOM_UINTEGER) &&
+		(isInteger(v2) || getAtomType(v2) ==ATOM_UINTEGER))
 	{
 		int64_t num1=toInt64(a);
 		int64_t num2=toInt64(v2);
@@ -2047,8 +2347,8 @@ FORCE_INLINE void asAtomHandler::multiply(asAtom& a,SystemState* sys,asAtom &v2,
 
 FORCE_INLINE void asAtomHandler::multiplyreplace(asAtom& ret, SystemState* sys,const asAtom& v1, const asAtom &v2,bool forceint)
 {
-	if( ((v1.uintval&0x7) == ATOM_INTEGER || (v1.uintval&0x7) == ATOM_UINTEGER) &&
-		(isInteger(v2) || (v2.uintval&0x7) ==ATOM_UINTEGER))
+	if( (getAtomType(v1) == ATOM_INTEGER || getAtomType(v1) == ATOM_UINTEGER) &&
+		(isInteger(v2) || getAtomType(v2) ==ATOM_UINTEGER))
 	{
 		int64_t num1=toInt64(v1);
 		int64_t num2=toInt64(v2);
@@ -2140,8 +2440,8 @@ FORCE_INLINE void asAtomHandler::dividereplace(asAtom& ret,SystemState* sys,cons
 FORCE_INLINE void asAtomHandler::modulo(asAtom& a,SystemState* sys,asAtom &v2)
 {
 	// if both values are Integers the result is also an int
-	if( ((a.uintval&0x7) == ATOM_INTEGER || (a.uintval&0x7) == ATOM_UINTEGER) &&
-		(isInteger(v2) || (v2.uintval&0x7) ==ATOM_UINTEGER))
+	if( (getAtomType(a) == ATOM_INTEGER || getAtomType(a) == ATOM_UINTEGER) &&
+		(isInteger(v2) || getAtomType(v2) ==ATOM_UINTEGER))
 	{
 		int32_t num1=toInt(a);
 		int32_t num2=toInt(v2);
@@ -2163,8 +2463,8 @@ FORCE_INLINE void asAtomHandler::modulo(asAtom& a,SystemState* sys,asAtom &v2)
 FORCE_INLINE void asAtomHandler::moduloreplace(asAtom& ret, SystemState* sys,const asAtom& v1, const asAtom &v2)
 {
 	// if both values are Integers the result is also an int
-	if( ((v1.uintval&0x7) == ATOM_INTEGER || (v1.uintval&0x7) == ATOM_UINTEGER) &&
-		(isInteger(v2) || (v2.uintval&0x7) ==ATOM_UINTEGER))
+	if( (getAtomType(v1) == ATOM_INTEGER || getAtomType(v1) == ATOM_UINTEGER) &&
+		(isInteger(v2) || getAtomType(v2) ==ATOM_UINTEGER))
 	{
 		int32_t num1=toInt(v1);
 		int32_t num2=toInt(v2);
@@ -2277,15 +2577,15 @@ FORCE_INLINE bool asAtomHandler::isNumeric(const asAtom& a)
 }
 FORCE_INLINE bool asAtomHandler::isNumber(const asAtom& a)
 {
-	return (a.uintval&0x7)==ATOM_NUMBERPTR;
+	return getAtomType(a)==ATOM_NUMBERPTR;
 }
 FORCE_INLINE bool asAtomHandler::isInteger(const asAtom& a)
 { 
-	return (a.uintval&0x3) == ATOM_INTEGER || ((a.uintval&0x7) == ATOM_U_INTEGERPTR && isObject(a) && getObjectNoCheck(a)->getObjectType() == T_INTEGER);
+	return (getAtomType(a)&0x3) == ATOM_INTEGER || (getAtomType(a) == ATOM_U_INTEGERPTR && isObject(a) && getObjectNoCheck(a)->getObjectType() == T_INTEGER);
 }
 FORCE_INLINE bool asAtomHandler::isUInteger(const asAtom& a)
 { 
-	return (a.uintval&0x7) == ATOM_UINTEGER || ((a.uintval&0x7) == ATOM_U_INTEGERPTR  && isObject(a) && getObjectNoCheck(a)->getObjectType() == T_UINTEGER);
+	return getAtomType(a) == ATOM_UINTEGER || (getAtomType(a) == ATOM_U_INTEGERPTR  && isObject(a) && getObjectNoCheck(a)->getObjectType() == T_UINTEGER);
 }
 FORCE_INLINE asAtom asAtomHandler::fromObjectNoPrimitive(ASObject* obj)
 {
@@ -2297,7 +2597,7 @@ FORCE_INLINE asAtom asAtomHandler::fromObjectNoPrimitive(ASObject* obj)
 
 FORCE_INLINE SWFOBJECT_TYPE asAtomHandler::getObjectType(const asAtom& a)
 {
-	switch (a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INTEGER:
 			return T_INTEGER;
@@ -2328,7 +2628,7 @@ FORCE_INLINE SWFOBJECT_TYPE asAtomHandler::getObjectType(const asAtom& a)
 FORCE_INLINE asAtom asAtomHandler::typeOf(asAtom& a)
 {
 	BUILTIN_STRINGS ret=BUILTIN_STRINGS::STRING_OBJECT;
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 		{
@@ -2379,19 +2679,19 @@ FORCE_INLINE asAtom asAtomHandler::typeOf(asAtom& a)
 }
 bool asAtomHandler::isEqual(asAtom& a, SystemState *sys, asAtom &v2)
 {
-	if ((((a.intval ^ ATOM_INTEGER) | (v2.intval ^ ATOM_INTEGER)) & 7) == 0)
+	if ((((a.intval ^ ATOM_INTEGER) | (v2.intval ^ ATOM_INTEGER)) & 7) == 0 && !isInlineNumber(a) && !isInlineNumber(v2))
 		return (a.intval == v2.intval);
 	if (a.uintval == v2.uintval && 
-			((a.uintval&0x7) != ATOM_NUMBERPTR)) // number needs special handling for NaN
+			(getAtomType(a) != ATOM_NUMBERPTR)) // number needs special handling for NaN
 		return true;
 	return isEqualIntern(a,sys,v2);
 }
 TRISTATE asAtomHandler::isLess(asAtom& a,SystemState *sys, asAtom &v2)
 {
-	if ((((a.intval ^ ATOM_INTEGER) | (v2.intval ^ ATOM_INTEGER)) & 7) == 0)
-		return (a.intval < v2.intval)?TTRUE:TFALSE;
+	if ((((a.intval ^ ATOM_INTEGER) | (v2.intval ^ ATOM_INTEGER)) & 7) == 0 && !isInlineNumber(a) && !isInlineNumber(v2))
+		return (getIntValue(a) < getIntValue(v2))?TTRUE:TFALSE;
 	if (a.uintval == v2.uintval && 
-			((a.uintval&0x7) != ATOM_NUMBERPTR)) // number needs special handling for NaN
+			(getAtomType(a) != ATOM_NUMBERPTR)) // number needs special handling for NaN
 	{
 		return a.uintval == ATOMTYPE_UNDEFINED_BIT ? TUNDEFINED : TFALSE;
 	}
@@ -2400,7 +2700,7 @@ TRISTATE asAtomHandler::isLess(asAtom& a,SystemState *sys, asAtom &v2)
 /* implements ecma3's ToBoolean() operation, see section 9.2, but returns the value instead of an Boolean object */
 FORCE_INLINE bool asAtomHandler::Boolean_concrete(asAtom& a)
 {
-	switch(a.uintval&0x7)
+	switch(getAtomType(a))
 	{
 		case ATOM_INVALID_UNDEFINED_NULL_BOOL:
 		{
@@ -2419,7 +2719,7 @@ FORCE_INLINE bool asAtomHandler::Boolean_concrete(asAtom& a)
 		case ATOM_NUMBERPTR:
 			return toNumber(a) != 0.0 && !std::isnan(toNumber(a));
 		case ATOM_INTEGER:
-			return (a.intval>>3) != 0;
+			return (getIntValue(a)) != 0;
 		case ATOM_UINTEGER:
 			return (a.uintval>>3) != 0;
 		case ATOM_STRINGID:
@@ -2439,17 +2739,17 @@ FORCE_INLINE bool asAtomHandler::isTemplate(const asAtom& a) { return isObject(a
 
 FORCE_INLINE ASObject* asAtomHandler::getObject(const asAtom& a)
 {
-	assert(!(a.uintval & ATOMTYPE_OBJECT_BIT) || !((ASObject*)(a.uintval& ~((LIGHTSPARK_ATOM_VALTYPE)0x7)))->getCached());
-	return a.uintval & ATOMTYPE_OBJECT_BIT ? (ASObject*)(a.uintval& ~((LIGHTSPARK_ATOM_VALTYPE)0x7)) : nullptr;
+	assert(!isObject(a) || !((ASObject*)(a.uintval& ~((LIGHTSPARK_ATOM_VALTYPE)0x7)))->getCached());
+	return isObject(a) ? (ASObject*)(a.uintval& ~((LIGHTSPARK_ATOM_VALTYPE)0x7)) : nullptr;
 }
 FORCE_INLINE ASObject* asAtomHandler::getObjectNoCheck(const asAtom& a)
 {
-	assert(!(a.uintval & ATOMTYPE_OBJECT_BIT) || !((ASObject*)(a.uintval& ~((LIGHTSPARK_ATOM_VALTYPE)0x7)))->getCached());
+	assert(!isObject(a) || !((ASObject*)(a.uintval& ~((LIGHTSPARK_ATOM_VALTYPE)0x7)))->getCached());
 	return (ASObject*)(a.uintval& ~((LIGHTSPARK_ATOM_VALTYPE)0x7));
 }
 FORCE_INLINE void asAtomHandler::resetCached(const asAtom& a)
 {
-	ASObject* o = a.uintval & ATOMTYPE_OBJECT_BIT ? (ASObject*)(a.uintval& ~((LIGHTSPARK_ATOM_VALTYPE)0x7)) : nullptr;
+	ASObject* o = isObject(a) ? (ASObject*)(a.uintval& ~((LIGHTSPARK_ATOM_VALTYPE)0x7)) : nullptr;
 	if (o)
 		o->resetCached();
 }
@@ -2463,6 +2763,8 @@ inline ASObject* asfreelist::getObjectFromFreeList()
 	assert(freelistsize>=0);
 	ASObject* o = freelistsize ? freelist[--freelistsize] :nullptr;
 	LOG_CALL("getfromfreelist:"<<freelistsize<<" "<<o<<" "<<this);
+	if (o && USUALLY_FALSE(memory_reporter::sampleAllocations))
+		o->sampleAllocation(0);
 	return o;
 }
 inline bool asfreelist::pushObjectToFreeList(ASObject *obj)
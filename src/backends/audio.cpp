@@ -21,29 +21,120 @@
 #include "backends/audio.h"
 #include "backends/config.h"
 #include <iostream>
+#include <fstream>
 #include "logger.h"
 #include <sys/time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 using namespace lightspark;
 using namespace std;
 
+//Interval in milliseconds in which the WAV output is written
+#define AUDIO_OUTPUT_INTERVAL 10
+
+static double besselI0(double x)
+{
+	double sum=1.0;
+	double term=1.0;
+	for(int k=1;k<32;k++)
+	{
+		term*=(x/(2*k))*(x/(2*k));
+		sum+=term;
+	}
+	return sum;
+}
+
+AudioResampler::AudioResampler(uint32_t inrate, uint32_t outrate):inputframes(AUDIO_RESAMPLER_TAPS/2-1),position(0)
+{
+	step=(uint64_t(inrate)<<32)/outrate;
+	//When downsampling the cutoff is lowered to the new nyquist frequency
+	double cutoff=0.95*min(1.0,double(outrate)/double(inrate));
+	const double beta=8.0;
+	const double center=AUDIO_RESAMPLER_TAPS/2-1;
+	filter.resize(AUDIO_RESAMPLER_PHASES*AUDIO_RESAMPLER_TAPS);
+	for(uint32_t p=0;p<AUDIO_RESAMPLER_PHASES;p++)
+	{
+		float* h=&filter[p*AUDIO_RESAMPLER_TAPS];
+		double sum=0;
+		for(uint32_t k=0;k<AUDIO_RESAMPLER_TAPS;k++)
+		{
+			double x=double(k)-center-double(p)/AUDIO_RESAMPLER_PHASES;
+			double w=x/(AUDIO_RESAMPLER_TAPS/2);
+			double window=fabs(w)<1.0 ? besselI0(beta*sqrt(1.0-w*w))/besselI0(beta) : 0.0;
+			double sinc=x==0.0 ? 1.0 : sin(M_PI*cutoff*x)/(M_PI*cutoff*x);
+			h[k]=cutoff*sinc*window;
+			sum+=h[k];
+		}
+		//Every phase has unity gain, so constant input gives constant output
+		for(uint32_t k=0;k<AUDIO_RESAMPLER_TAPS;k++)
+			h[k]/=sum;
+	}
+	//The filter is centered, the first output frame starts after the history of silence
+	input.resize(inputframes*2,0.0f);
+}
+
+void AudioResampler::process(AudioDecoder* decoder, float* out, uint32_t frames)
+{
+	if(frames==0)
+		return;
+	uint32_t needed=((position+uint64_t(frames-1)*step)>>32)+AUDIO_RESAMPLER_TAPS;
+	if(needed>inputframes)
+	{
+		uint32_t missing=needed-inputframes;
+		input.resize(needed*2);
+		readbuffer.resize(missing*2);
+		uint32_t readcount=0;
+		while(readcount<missing*4)
+		{
+			uint32_t ret=decoder->copyFrame(readbuffer.data()+readcount/2,missing*4-readcount);
+			if(!ret)
+				break;
+			readcount+=ret;
+		}
+		//Missing input is silence, as it is for streams mixed at their own rate
+		float* dest=&input[inputframes*2];
+		for(uint32_t i=0;i<readcount/2;i++)
+			dest[i]=readbuffer[i];
+		for(uint32_t i=readcount/2;i<missing*2;i++)
+			dest[i]=0.0f;
+		inputframes=needed;
+	}
+	for(uint32_t i=0;i<frames;i++)
+	{
+		const float* in=&input[(position>>32)*2];
+		const float* h=&filter[((position>>(32-AUDIO_RESAMPLER_PHASE_BITS))&(AUDIO_RESAMPLER_PHASES-1))*AUDIO_RESAMPLER_TAPS];
+		float left=0.0f;
+		float right=0.0f;
+		for(uint32_t k=0;k<AUDIO_RESAMPLER_TAPS;k++)
+		{
+			left+=in[k*2]*h[k];
+			right+=in[k*2+1]*h[k];
+		}
+		out[i*2]=left;
+		out[i*2+1]=right;
+		position+=step;
+	}
+	uint32_t consumed=position>>32;
+	input.erase(input.begin(),input.begin()+consumed*2);
+	inputframes-=consumed;
+	position-=uint64_t(consumed)<<32;
+}
+
 uint32_t AudioStream::getPlayedTime()
 {
-	uint32_t ret;
-	struct timeval now;
-	gettimeofday(&now, nullptr);
 	if (!mixingStarted)
 		return playedtime;
-
-	ret = playedtime + (now.tv_sec * 1000 + now.tv_usec / 1000) - (starttime.tv_sec * 1000 + starttime.tv_usec / 1000);
-	return ret;
+	return playedtime + EngineClock::getTime() - starttime;
 }
 bool AudioStream::init()
 {
 	unmutevolume = curvolume = 1.0;
-	mixer_channel = manager->engineData->audio_StreamInit(this);
-	manager->engineData->audio_StreamSetVolume(mixer_channel, curvolume);
+	updateGains();
+	if (manager->samplerate != manager->engineData->audio_getSampleRate())
+		resampler = new AudioResampler(manager->engineData->audio_getSampleRate(),manager->samplerate);
 	isPaused = false;
 	return true;
 }
@@ -53,7 +144,7 @@ void AudioStream::startMixing()
 	if(mixingStarted)
 		return;
 	mixingStarted=true;
-	gettimeofday(&starttime, nullptr);
+	starttime=EngineClock::getTime();
 }
 
 void AudioStream::SetPause(bool pause_on)
@@ -68,7 +159,6 @@ void AudioStream::SetPause(bool pause_on)
 		mixingStarted=false;
 		isPaused = false;
 	}
-	manager->engineData->audio_StreamPause(mixer_channel,pause_on);
 }
 
 bool AudioStream::ispaused()
@@ -87,18 +177,42 @@ void AudioStream::unmute()
 }
 void AudioStream::setVolume(double volume)
 {
-	manager->engineData->audio_StreamSetVolume(mixer_channel, volume);
 	curvolume = volume;
+	updateGains();
+}
+void AudioStream::setPan(double pan)
+{
+	curpan = max(-1.0,min(1.0,pan));
+	updateGains();
+}
+void AudioStream::updateGains()
+{
+	//Panning attenuates the opposite channel linearly, as the flash player does
+	gainleft.store(curvolume*(curpan > 0 ? 1.0-curpan : 1.0),std::memory_order_relaxed);
+	gainright.store(curvolume*(curpan < 0 ? 1.0+curpan : 1.0),std::memory_order_relaxed);
 }
 
 AudioStream::~AudioStream()
 {
-	manager->engineData->audio_StreamDeinit(mixer_channel);
 	manager->removeStream(this);
+	delete resampler;
 }
 
-AudioManager::AudioManager(EngineData *engine):muteAllStreams(false),audio_available(false),mixeropened(0),engineData(engine)
+AudioManager::AudioManager(EngineData *engine, const tiny_string& output):muteAllStreams(false),audio_available(false),mixeropened(0),engineData(engine),
+	mixingStreams(nullptr),mixing(0),samplerate(engine->audio_getSampleRate()),outputFile(output),outputThread(nullptr),stopOutput(false)
 {
+	if (!outputFile.empty() || EngineClock::isVirtual())
+	{
+		//Rendering to a file needs no audio device, the file is written until shutdown
+		//With the virtual clock the streams are consumed at its pace, even without a file
+		audio_available = true;
+		mixeropened = 1;
+		//Registered before the thread starts, so the virtual clock can't advance without the mixer
+		if (EngineClock::isVirtual())
+			EngineClock::registerThread(&outputWakeUp);
+		outputThread = SDL_CreateThread(outputWorker,"AudioOutput",this);
+		return;
+	}
 	audio_available = engine->audio_ManagerInit();
 	mixeropened = 0;
 }
@@ -121,11 +235,22 @@ void AudioManager::unmuteAll()
 	}
 }
 
+void AudioManager::publishStreams()
+{
+	vector<AudioStream*>* newStreams = streams.empty() ? nullptr : new vector<AudioStream*>(streams.begin(),streams.end());
+	vector<AudioStream*>* oldStreams = mixingStreams.exchange(newStreams);
+	//mix() calls starting from now see the new snapshot, wait for the ones still using the old one
+	while (mixing.load() != 0)
+		SDL_Delay(1);
+	delete oldStreams;
+}
+
 void AudioManager::removeStream(AudioStream *s)
 {
 	Locker l(streamMutex);
 	streams.remove(s);
-	if (streams.empty())
+	publishStreams();
+	if (streams.empty() && outputThread==nullptr && mixeropened)
 	{
 		engineData->audio_ManagerCloseMixer();
 		mixeropened = false;
@@ -158,7 +283,7 @@ AudioStream* AudioManager::createStream(AudioDecoder* decoder, bool startpaused,
 		return NULL;
 	if (!mixeropened)
 	{
-		if (!engineData->audio_ManagerOpenMixer())
+		if (!engineData->audio_ManagerOpenMixer(this,samplerate))
 		{
 			LOG(LOG_ERROR,"Couldn't open mixer");
 			audio_available = 0;
@@ -179,23 +304,228 @@ AudioStream* AudioManager::createStream(AudioDecoder* decoder, bool startpaused,
 	else
 		stream->hasStarted=true;
 	streams.push_back(stream);
+	publishStreams();
+	//The virtual clock may not pass the start of the stream before the mixer has seen it
+	if (outputThread && EngineClock::isVirtual())
+		EngineClock::busy(&outputWakeUp);
 
 	return stream;
 }
 
+static void mixInt16(float* dest, const int16_t* src, uint32_t frames, float left, float right)
+{
+	uint32_t i=0;
+#ifdef __SSE2__
+	const __m128 gains=_mm_setr_ps(left,right,left,right);
+	for(;i+4<=frames;i+=4)
+	{
+		__m128i in=_mm_loadu_si128((const __m128i*)(src+i*2));
+		//Sign extend the samples to 32 bit
+		__m128i lo=_mm_srai_epi32(_mm_unpacklo_epi16(in,in),16);
+		__m128i hi=_mm_srai_epi32(_mm_unpackhi_epi16(in,in),16);
+		__m128 acclo=_mm_loadu_ps(dest+i*2);
+		__m128 acchi=_mm_loadu_ps(dest+i*2+4);
+		acclo=_mm_add_ps(acclo,_mm_mul_ps(_mm_cvtepi32_ps(lo),gains));
+		acchi=_mm_add_ps(acchi,_mm_mul_ps(_mm_cvtepi32_ps(hi),gains));
+		_mm_storeu_ps(dest+i*2,acclo);
+		_mm_storeu_ps(dest+i*2+4,acchi);
+	}
+#endif
+	for(;i<frames;i++)
+	{
+		dest[i*2]+=src[i*2]*left;
+		dest[i*2+1]+=src[i*2+1]*right;
+	}
+}
+
+static void mixFloat(float* dest, const float* src, uint32_t frames, float left, float right)
+{
+	uint32_t i=0;
+#ifdef __SSE2__
+	const __m128 gains=_mm_setr_ps(left,right,left,right);
+	for(;i+2<=frames;i+=2)
+		_mm_storeu_ps(dest+i*2,_mm_add_ps(_mm_loadu_ps(dest+i*2),_mm_mul_ps(_mm_loadu_ps(src+i*2),gains)));
+#endif
+	for(;i<frames;i++)
+	{
+		dest[i*2]+=src[i*2]*left;
+		dest[i*2+1]+=src[i*2+1]*right;
+	}
+}
+
+static void convertToInt16(int16_t* dest, const float* src, uint32_t samples)
+{
+	uint32_t i=0;
+#ifdef __SSE2__
+	const __m128 maxval=_mm_set1_ps(32767.0f);
+	const __m128 minval=_mm_set1_ps(-32768.0f);
+	for(;i+8<=samples;i+=8)
+	{
+		__m128 a=_mm_max_ps(_mm_min_ps(_mm_loadu_ps(src+i),maxval),minval);
+		__m128 b=_mm_max_ps(_mm_min_ps(_mm_loadu_ps(src+i+4),maxval),minval);
+		_mm_storeu_si128((__m128i*)(dest+i),_mm_packs_epi32(_mm_cvtps_epi32(a),_mm_cvtps_epi32(b)));
+	}
+#endif
+	for(;i<samples;i++)
+		dest[i]=lrintf(max(-32768.0f,min(32767.0f,src[i])));
+}
+
+void AudioManager::mix(int16_t* out, uint32_t frames)
+{
+	if (mixbuffer.size() < frames*2)
+	{
+		mixbuffer.resize(frames*2);
+		streambuffer.resize(frames*2);
+		readbuffer.resize(frames*2);
+	}
+	float* acc = mixbuffer.data();
+	memset(acc,0,frames*2*sizeof(float));
+	mixing++;
+	vector<AudioStream*>* current = mixingStreams.load();
+	if (current)
+	{
+		for (auto it = current->begin(); it != current->end(); ++it)
+		{
+			AudioStream* s = *it;
+			if (s->isPaused)
+				continue;
+			s->startMixing();
+			float left = s->gainleft.load(std::memory_order_relaxed);
+			float right = s->gainright.load(std::memory_order_relaxed);
+			//Muted streams are still read, so that they keep their position
+			if (s->resampler)
+			{
+				s->resampler->process(s->decoder,streambuffer.data(),frames);
+				mixFloat(acc,streambuffer.data(),frames,left,right);
+				continue;
+			}
+			uint32_t readcount = 0;
+			while (readcount < frames*4)
+			{
+				uint32_t ret = s->decoder->copyFrame(readbuffer.data()+readcount/2,frames*4-readcount);
+				if (!ret)
+					break;
+				readcount += ret;
+			}
+			mixInt16(acc,readbuffer.data(),readcount/4,left,right);
+		}
+	}
+	mixing--;
+	convertToInt16(out,acc,frames*2);
+}
+
+static void writeLE(ostream& out, uint32_t v, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		out.put(char((v>>(i*8))&0xff));
+}
+
+int AudioManager::outputWorker(void* d)
+{
+	((AudioManager*)d)->renderOutput();
+	return 0;
+}
+
+void AudioManager::renderOutput()
+{
+	ofstream out;
+	if (!outputFile.empty())
+	{
+		out.open(outputFile.raw_buf(),ios_base::out|ios_base::trunc|ios_base::binary);
+		if (!out)
+		{
+			LOG(LOG_ERROR,"AudioManager: unable to open " << outputFile);
+			if (EngineClock::isVirtual())
+				EngineClock::unregisterThread(&outputWakeUp);
+			return;
+		}
+		writeWAVHeader(out);
+	}
+
+	vector<int16_t> buffer(samplerate*4*AUDIO_OUTPUT_INTERVAL/1000);
+	uint64_t written = 0;
+	uint64_t mixtime = 0;
+	uint64_t start = EngineClock::getTime();
+	//Mixing follows the engine clock, as the players of the streams expect a real device
+	while (!stopOutput.load())
+	{
+		uint64_t due = (EngineClock::getTime()-start)*samplerate/1000;
+		while (written < due)
+		{
+			uint32_t frames = min(uint64_t(buffer.size()/2),due-written);
+			uint64_t t = g_get_monotonic_time();
+			mix(buffer.data(),frames);
+			mixtime += g_get_monotonic_time()-t;
+			if (out.is_open())
+			{
+				for (uint32_t i = 0; i < frames*2; i++)
+					writeLE(out,uint16_t(buffer[i]),2);
+			}
+			written += frames;
+		}
+		if (EngineClock::isVirtual())
+		{
+			//While there are streams the virtual clock advances in steps of AUDIO_OUTPUT_INTERVAL, so they are mixed at its pace
+			Locker l(outputMutex);
+			EngineClock::idleUntil(&outputWakeUp,mixingStreams.load() ? EngineClock::getTime()+AUDIO_OUTPUT_INTERVAL : UINT64_MAX);
+			//The clock may be advanced by another thread without waking us up in time
+			outputWakeUp.wait_until(outputMutex,1);
+		}
+		else
+			SDL_Delay(AUDIO_OUTPUT_INTERVAL);
+	}
+	if (EngineClock::isVirtual())
+		EngineClock::unregisterThread(&outputWakeUp);
+	if (!out.is_open())
+	{
+		LOG(LOG_INFO,"AudioManager: " << written << " frames mixed, mixing took " << mixtime/1000 << " ms");
+		return;
+	}
+	uint32_t datasize = min(written*4,uint64_t(UINT32_MAX-36));
+	out.seekp(4);
+	writeLE(out,datasize+36,4);
+	out.seekp(40);
+	writeLE(out,datasize,4);
+	LOG(LOG_INFO,"AudioManager: " << written << " frames written to " << outputFile << ", mixing took " << mixtime/1000 << " ms");
+}
+
+void AudioManager::writeWAVHeader(ostream& out)
+{
+	//The sizes in the header are written when the file is closed
+	out.write("RIFF",4);
+	writeLE(out,0,4);
+	out.write("WAVEfmt ",8);
+	writeLE(out,16,4);
+	writeLE(out,1,2); // PCM
+	writeLE(out,2,2);
+	writeLE(out,samplerate,4);
+	writeLE(out,samplerate*4,4);
+	writeLE(out,4,2);
+	writeLE(out,16,2);
+	out.write("data",4);
+	writeLE(out,0,4);
+}
 
 AudioManager::~AudioManager()
 {
-	Locker l(streamMutex);
-	for (stream_iterator it = streams.begin(); it != streams.end(); ++it) {
-		delete *it;
+	{
+		Locker l(streamMutex);
+		// deleting a stream removes it from the list
+		while (!streams.empty())
+			delete streams.front();
+	}
+	if (outputThread)
+	{
+		stopOutput = true;
+		SDL_WaitThread(outputThread,nullptr);
 	}
-	if (mixeropened)
+	else if (mixeropened)
 	{
 		engineData->audio_ManagerCloseMixer();
 	}
-	if (audio_available)
+	if (audio_available && outputThread==nullptr)
 	{
 		engineData->audio_ManagerDeinit();
 	}
+	delete mixingStreams.load();
 }
@@ -23,13 +23,50 @@
 
 #include "compat.h"
 #include "backends/decoder.h"
+#include "tiny_string.h"
 #include <iostream>
+#include <vector>
 
 namespace lightspark
 {
 class AudioStream;
 class EngineData;
 
+//Taps of every phase of the resampling filter
+#define AUDIO_RESAMPLER_TAPS 32
+//The resampling filter is computed for 1<<AUDIO_RESAMPLER_PHASE_BITS fractional positions
+#define AUDIO_RESAMPLER_PHASE_BITS 8
+#define AUDIO_RESAMPLER_PHASES (1<<AUDIO_RESAMPLER_PHASE_BITS)
+
+/*
+ * Converts the stereo output of a decoder from its sample rate to the rate of the audio device
+ * with a polyphase windowed sinc filter (Kaiser window), only used when the rates differ.
+ */
+class AudioResampler
+{
+private:
+	// coefficients of every phase, AUDIO_RESAMPLER_TAPS for each
+	std::vector<float> filter;
+	// interleaved input frames not consumed yet
+	std::vector<float> input;
+	std::vector<int16_t> readbuffer;
+	uint32_t inputframes;
+	// position of the next output frame in input, 32.32 fixed point
+	uint64_t position;
+	uint64_t step;
+public:
+	AudioResampler(uint32_t inrate, uint32_t outrate);
+	// writes frames of interleaved output to out, reading as much input from decoder as needed
+	void process(AudioDecoder* decoder, float* out, uint32_t frames);
+};
+
+/*
+ * Mixes all streams into a single output, which is either the audio device of the EngineData
+ * or, when an output file is set or the engine clock is virtual, a WAV file written at the pace
+ * of the engine clock without opening any device.
+ * The mixing thread reads the streams from a snapshot of the stream list that is replaced
+ * as a whole when streams are added or removed, so mixing never waits for a lock.
+ */
 class AudioManager
 {
 	friend class AudioStream;
@@ -41,8 +78,29 @@ private:
 	std::list<AudioStream *> streams;
 	typedef std::list<AudioStream *>::iterator stream_iterator;
 	Mutex streamMutex;
+	// snapshot of streams used by mix()
+	std::atomic<std::vector<AudioStream*>*> mixingStreams;
+	// number of mix() calls currently reading mixingStreams
+	std::atomic<uint32_t> mixing;
+	// sample rate of the output, decoders produce audio at engineData->audio_getSampleRate()
+	int samplerate;
+	std::vector<float> mixbuffer;
+	std::vector<float> streambuffer;
+	std::vector<int16_t> readbuffer;
+	tiny_string outputFile;
+	SDL_Thread* outputThread;
+	std::atomic<bool> stopOutput;
+	// signaled by the virtual clock when the output thread has to mix up to its new time
+	Cond outputWakeUp;
+	Mutex outputMutex;
+	// replaces the snapshot used by mix(), streamMutex must be held
+	void publishStreams();
+	static int outputWorker(void* d);
+	// mixes at the pace of the engine clock, writing to outputFile if it is set
+	void renderOutput();
+	void writeWAVHeader(std::ostream& out);
 public:
-	AudioManager(EngineData* engine);
+	AudioManager(EngineData* engine, const tiny_string& output="");
 
 	AudioStream *createStream(AudioDecoder *decoder, bool startpaused, IThreadJob *producer, uint32_t playedTime);
 
@@ -52,6 +110,8 @@ public:
 	void unmuteAll();
 	void removeStream(AudioStream* s);
 	void stopAllSounds();
+	// mixes frames of interleaved stereo samples of all playing streams into out, called by the output
+	void mix(int16_t* out, uint32_t frames);
 	~AudioManager();
 };
 
@@ -63,18 +123,24 @@ private:
 	AudioManager* manager;
 	AudioDecoder *decoder;
 	IThreadJob* producer;
+	AudioResampler* resampler;
 	bool hasStarted;
-	bool isPaused;
+	std::atomic<bool> isPaused;
 	bool mixingStarted;
 	double curvolume;
 	double unmutevolume;
+	double curpan;
+	// gains of the channels computed from volume and pan, read by the mixing thread
+	std::atomic<float> gainleft;
+	std::atomic<float> gainright;
 	uint64_t playedtime;
-	struct timeval starttime;
-	int mixer_channel;
+	// time of the engine clock when mixing started
+	uint64_t starttime;
+	void updateGains();
 public:
 	bool init();
 	void startMixing();
-	AudioStream(AudioManager* _manager,IThreadJob* _producer,uint64_t _playedtime):manager(_manager),decoder(NULL),producer(_producer),hasStarted(false),isPaused(true),mixingStarted(false),playedtime(_playedtime) { }
+	AudioStream(AudioManager* _manager,IThreadJob* _producer,uint64_t _playedtime):manager(_manager),decoder(NULL),producer(_producer),resampler(nullptr),hasStarted(false),isPaused(true),mixingStarted(false),curpan(0.0),playedtime(_playedtime) { }
 
 	void SetPause(bool pause_on);
 	uint32_t getPlayedTime();
@@ -84,13 +150,15 @@ public:
 	void pause() { SetPause(true); }
 	void resume() { SetPause(false); }
 	void setVolume(double volume);
+	// pan from -1 (left) to 1 (right) as in SoundTransform
+	void setPan(double pan);
 	void setPlayedTime(uint64_t p) { playedtime = p; }
 	inline double getVolume() const { return curvolume; }
+	inline double getPan() const { return curpan; }
 	inline AudioDecoder *getDecoder() const { return decoder; }
 	~AudioStream();
 };
 
-
 }
 
 #endif /* BACKENDS_AUDIO_H */
@@ -0,0 +1,188 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "backends/bitmapdecoder.h"
+#include "scripting/flash/display/BitmapContainer.h"
+#include "swf.h"
+#include "logger.h"
+
+using namespace lightspark;
+
+class BitmapDecoder::DecodeJob: public IThreadJob
+{
+private:
+	BitmapDecoder* decoder;
+public:
+	DecodeJob(BitmapDecoder* d):decoder(d) {}
+	void execute()
+	{
+		while(!threadAborting)
+		{
+			_NR<BitmapContainer> b=decoder->nextPending();
+			if(b.isNull())
+				break;
+			b->ensureDecoded();
+		}
+	}
+	void threadAbort() {}
+	void jobFence()
+	{
+		decoder->jobFinished();
+		delete this;
+	}
+};
+
+BitmapDecoder::BitmapDecoder(SystemState* s, uint64_t _budget):sys(s),decodedBytes(0),budget(_budget),runningJobs(0),stopped(false),
+	decodedCount(0),evictedCount(0),evictedBytes(0),decodingTime(0)
+{
+}
+
+BitmapDecoder::~BitmapDecoder()
+{
+	assert(runningJobs==0);
+}
+
+void BitmapDecoder::prefetch(_R<BitmapContainer> b)
+{
+	mutex.lock();
+	//Bitmaps decoded ahead of time must not cause the eviction of the ones in use
+	if(stopped || decodedBytes>=budget/2)
+	{
+		mutex.unlock();
+		return;
+	}
+	pending.push_back(b);
+	bool start=runningJobs<BITMAPDECODER_MAX_JOBS;
+	if(start)
+		runningJobs++;
+	mutex.unlock();
+	if(!start)
+		return;
+	//The thread pool fences the job immediately if it is stopping, so it must not be added with the mutex held
+	sys->addJob(new DecodeJob(this));
+}
+
+_NR<BitmapContainer> BitmapDecoder::nextPending()
+{
+	Locker l(mutex);
+	if(stopped || decodedBytes>=budget/2)
+	{
+		pending.clear();
+		return NullRef;
+	}
+	while(!pending.empty())
+	{
+		_R<BitmapContainer> b=pending.front();
+		pending.pop_front();
+		if(!b->isDecoded())
+			return b;
+	}
+	return NullRef;
+}
+
+void BitmapDecoder::jobFinished()
+{
+	Locker l(mutex);
+	runningJobs--;
+}
+
+void BitmapDecoder::addDecoded(BitmapContainer* b, uint32_t time)
+{
+	Locker l(mutex);
+	decodedCount++;
+	decodingTime+=time;
+	if(stopped || b->inDecodedList)
+		return;
+	b->decodedPos=decoded.insert(decoded.end(),b);
+	b->inDecodedList=true;
+	decodedBytes+=b->data.size();
+}
+
+void BitmapDecoder::removeDecoded(BitmapContainer* b)
+{
+	Locker l(mutex);
+	if(!b->inDecodedList)
+		return;
+	decoded.erase(b->decodedPos);
+	b->inDecodedList=false;
+	decodedBytes-=b->data.size();
+}
+
+bool BitmapDecoder::needsEviction() const
+{
+	Locker l(mutex);
+	return decodedBytes>budget;
+}
+
+void BitmapDecoder::evict()
+{
+	Locker l(mutex);
+	//Evict down to 90% of the budget, so that the next decoded bitmaps do not evict again
+	uint64_t target=budget/10*9;
+	uint32_t examined=0;
+	uint32_t count=decoded.size();
+	auto it=decoded.begin();
+	//Each bitmap is examined at most twice, the first time it may only lose its second chance
+	while(decodedBytes>target && examined<2*count && !decoded.empty())
+	{
+		if(it==decoded.end())
+			it=decoded.begin();
+		examined++;
+		BitmapContainer* b=*it;
+		if(b->recentlyUsed.load(std::memory_order_relaxed))
+		{
+			b->recentlyUsed.store(false, std::memory_order_relaxed);
+			++it;
+			continue;
+		}
+		uint64_t size=b->data.size();
+		if(!b->evictPixels())
+		{
+			++it;
+			continue;
+		}
+		it=decoded.erase(it);
+		b->inDecodedList=false;
+		decodedBytes-=size;
+		evictedCount++;
+		evictedBytes+=size;
+	}
+	if(decodedBytes>target)
+		LOG(LOG_INFO,"BitmapDecoder: "<<decodedBytes<<" bytes of decoded bitmaps are in use, budget is "<<budget);
+}
+
+void BitmapDecoder::stop()
+{
+	Locker l(mutex);
+	stopped=true;
+	pending.clear();
+	for(auto it=decoded.begin();it!=decoded.end();++it)
+		(*it)->inDecodedList=false;
+	decoded.clear();
+	decodedBytes=0;
+	LOG(LOG_INFO,"BitmapDecoder: "<<decodedCount<<" bitmaps decoded in "<<decodingTime<<" ms, "
+		<<evictedCount<<" evicted ("<<evictedBytes<<" bytes)");
+}
+
+void BitmapDecoder::dumpStatistics(std::ostream& out) const
+{
+	Locker l(mutex);
+	out << "# bitmap decoder: " << decodedCount << " bitmaps decoded in " << decodingTime << " ms, "
+		<< decodedBytes << " bytes decoded, " << evictedCount << " evicted (" << evictedBytes << " bytes)" << std::endl;
+}
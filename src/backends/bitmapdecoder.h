@@ -0,0 +1,87 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef BACKENDS_BITMAPDECODER_H
+#define BACKENDS_BITMAPDECODER_H 1
+
+#include "compat.h"
+#include <deque>
+#include <list>
+#include <ostream>
+#include "threading.h"
+#include "smartrefs.h"
+
+namespace lightspark
+{
+
+//Maximum number of thread pool jobs decoding bitmaps ahead of time
+#define BITMAPDECODER_MAX_JOBS 4
+
+class SystemState;
+class BitmapContainer;
+
+/*
+ * Decodes the bitmaps of the SWF tags.
+ * The tags only keep the compressed data, the pixels are decoded on first use
+ * or ahead of time by at most BITMAPDECODER_MAX_JOBS jobs of the thread pool.
+ * When the decoded pixels exceed the memory budget the vm thread evicts the
+ * pixels of bitmaps that are not pinned by a PinnedBitmap, starting from the ones
+ * decoded first and giving a second chance to the recently used ones.
+ * Evicted pixels are decoded again on demand.
+ */
+class BitmapDecoder
+{
+private:
+	class DecodeJob;
+	SystemState* sys;
+	mutable Mutex mutex;
+	// bitmaps to decode ahead of time
+	std::deque<_R<BitmapContainer>> pending;
+	// decoded bitmaps that can be evicted, in decoding order
+	std::list<BitmapContainer*> decoded;
+	uint64_t decodedBytes;
+	uint64_t budget;
+	uint32_t runningJobs;
+	bool stopped;
+	// statistics
+	uint32_t decodedCount;
+	uint32_t evictedCount;
+	uint64_t evictedBytes;
+	uint64_t decodingTime;
+	_NR<BitmapContainer> nextPending();
+	void jobFinished();
+public:
+	BitmapDecoder(SystemState* s, uint64_t _budget);
+	~BitmapDecoder();
+	// Queues a bitmap to be decoded by the thread pool, can be called from any thread
+	void prefetch(_R<BitmapContainer> b);
+	// Called by the bitmaps when their pixels are decoded and when they are destroyed
+	void addDecoded(BitmapContainer* b, uint32_t time);
+	void removeDecoded(BitmapContainer* b);
+	// true when the decoded pixels exceed the budget
+	bool needsEviction() const;
+	// Evicts pixels until the budget is respected, called by the vm thread
+	void evict();
+	// Forgets the pending bitmaps and ignores new ones, called at shutdown
+	void stop();
+	void dumpStatistics(std::ostream& out) const;
+};
+
+}
+#endif /* BACKENDS_BITMAPDECODER_H */
@@ -85,7 +85,8 @@ Config::Config():
 	//DEFAULT SETTINGS
 	defaultCacheDirectory((string) g_get_user_cache_dir() + G_DIR_SEPARATOR_S + "lightspark"),
 	cacheDirectory(defaultCacheDirectory),cachePrefix("cache"),
-	renderingEnabled(true)
+	contentCacheSize(1024*1024*1024),contentCacheRevalidate(true),
+	renderingEnabled(true),decodedBitmapsSize(256*1024*1024)
 {
 #ifdef _WIN32
 	const char* exePath = getExectuablePath();
@@ -119,6 +120,8 @@ Config::Config():
 	//Expand tilde in path
 	if(cacheDirectory.length() > 0 && cacheDirectory[0] == '~')
 		cacheDirectory.replace(0, 1, getenv("HOME"));
+	if(contentCacheDirectory.length() > 0 && contentCacheDirectory[0] == '~')
+		contentCacheDirectory.replace(0, 1, getenv("HOME"));
 #endif
 
 	//If cache dir doesn't exist, create it
@@ -204,12 +207,22 @@ void Config::handleEntry()
 	//Rendering
 	if(group == "rendering" && key == "enabled")
 		renderingEnabled = atoi(value.c_str());
+	//Memory budget for decoded bitmaps
+	else if(group == "rendering" && key == "decoded_bitmaps_size")
+		decodedBitmapsSize = uint64_t(atoi(value.c_str()))*1024*1024;
 	//Cache directory
 	else if(group == "cache" && key == "directory")
 		cacheDirectory = value;
 	//Cache prefix
 	else if(group == "cache" && key == "prefix")
 		cachePrefix = value;
+	//Persistent content cache
+	else if(group == "cache" && key == "content_directory")
+		contentCacheDirectory = value;
+	else if(group == "cache" && key == "content_size")
+		contentCacheSize = uint64_t(atoi(value.c_str()))*1024*1024;
+	else if(group == "cache" && key == "content_revalidate")
+		contentCacheRevalidate = atoi(value.c_str());
 	else
 		LOG(LOG_ERROR,_("Invalid entry encountered in configuration file") << ": '" << group << "/" << key << "'='" << value << "'");
 }
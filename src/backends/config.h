@@ -48,9 +48,17 @@ namespace lightspark
 		std::string gnashPath;
 		//Specifies the directory where the app can store files
 		std::string dataDirectory;
+		//Specifies where downloaded content is kept between sessions, empty disables the content cache
+		std::string contentCacheDirectory;
+		//Maximum size of the content cache in bytes, default=1 GiB
+		uint64_t contentCacheSize;
+		//Specifies if stale cached content is revalidated with the server, default=true
+		bool contentCacheRevalidate;
 
 		//Specifies if rendering should be done
 		bool renderingEnabled;
+		//Decoded bitmaps of the SWF tags kept in memory before the unused ones are evicted, in bytes, default=256 MiB
+		uint64_t decodedBitmapsSize;
 		Config();
 		~Config();
 	public:
@@ -60,10 +68,14 @@ namespace lightspark
 		const std::string& getCacheDirectory() const { return cacheDirectory; }
 		const std::string& getCachePrefix() const { return cachePrefix; }
 		const std::string& getDataDirectory() const { return dataDirectory; }
+		const std::string& getContentCacheDirectory() const { return contentCacheDirectory; }
+		uint64_t getContentCacheSize() const { return contentCacheSize; }
+		bool getContentCacheRevalidate() const { return contentCacheRevalidate; }
 		
 		const std::string& getGnashPath() const { return gnashPath; }
 
 		bool isRenderingEnabled() const { return renderingEnabled; }
+		uint64_t getDecodedBitmapsSize() const { return decodedBitmapsSize; }
 	};
 }
 
@@ -0,0 +1,424 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <algorithm>
+#include <vector>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "backends/contentcache.h"
+#include "backends/config.h"
+#include "logger.h"
+
+using namespace std;
+using namespace lightspark;
+
+static int64_t currentTime()
+{
+	return g_get_real_time()/1000000;
+}
+
+bool ContentCacheEntry::isFresh() const
+{
+	return expires > currentTime();
+}
+
+bool ContentCacheEntry::matches(const std::map<tiny_string, tiny_string>& requestHeaders) const
+{
+	for(auto it=varyHeaders.begin();it!=varyHeaders.end();++it)
+	{
+		auto header = requestHeaders.find(it->first);
+		const tiny_string& value = header == requestHeaders.end() ? tiny_string() : header->second;
+		if(value != it->second)
+			return false;
+	}
+	return true;
+}
+
+ContentCacheWriter::ContentCacheWriter(const tiny_string& _url, const std::string& filename, FILE* f):
+	url(_url),tempFilename(filename),file(f),size(0),failed(false)
+{
+}
+
+ContentCacheWriter::~ContentCacheWriter()
+{
+	if(file)
+		fclose(file);
+	if(!tempFilename.empty())
+		g_remove(tempFilename.c_str());
+}
+
+void ContentCacheWriter::write(const unsigned char* buffer, size_t length)
+{
+	if(failed)
+		return;
+	if(fwrite(buffer, 1, length, file) != length)
+	{
+		LOG(LOG_ERROR, "ContentCache: could not write " << tempFilename);
+		failed = true;
+		return;
+	}
+	size += length;
+}
+
+ContentCache::ContentCache():
+	directory(Config::getConfig()->getContentCacheDirectory()),
+	maxSize(Config::getConfig()->getContentCacheSize()),totalSize(0),
+	revalidate(Config::getConfig()->getContentCacheRevalidate())
+{
+	if(directory.empty())
+		return;
+	if(g_mkdir_with_parents(directory.c_str(), S_IRUSR | S_IWUSR | S_IXUSR))
+	{
+		LOG(LOG_ERROR, "ContentCache: could not create directory " << directory << ", the content cache is disabled");
+		directory.clear();
+		return;
+	}
+	scan();
+	LOG(LOG_INFO, "ContentCache: " << entries.size() << " entries, " << totalSize << " bytes in " << directory);
+}
+
+ContentCache* ContentCache::getContentCache()
+{
+	static ContentCache cache;
+	return cache.directory.empty() ? NULL : &cache;
+}
+
+std::string ContentCache::keyFor(const tiny_string& url, const std::map<tiny_string, tiny_string>& varyHeaders) const
+{
+	//Without Vary'd headers the key is the hash of the url alone
+	std::string s(url.raw_buf(), url.numBytes());
+	for(auto it=varyHeaders.begin();it!=varyHeaders.end();++it)
+	{
+		s += "\n";
+		s += it->first.raw_buf();
+		s += ": ";
+		s += it->second.raw_buf();
+	}
+	gchar* checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA256, s.c_str(), s.length());
+	std::string ret(checksum);
+	g_free(checksum);
+	return ret;
+}
+
+std::string ContentCache::dataFilename(const std::string& key) const
+{
+	return directory + G_DIR_SEPARATOR_S + key + ".data";
+}
+
+std::string ContentCache::metaFilename(const std::string& key) const
+{
+	return directory + G_DIR_SEPARATOR_S + key + ".meta";
+}
+
+void ContentCache::scan()
+{
+	GDir* dir = g_dir_open(directory.c_str(), 0, NULL);
+	if(!dir)
+		return;
+	std::vector<std::string> keys;
+	const gchar* name;
+	while((name = g_dir_read_name(dir)))
+	{
+		std::string filename(name);
+		if(g_str_has_suffix(name, ".meta"))
+			keys.push_back(filename.substr(0, filename.length()-5));
+		else if(g_str_has_suffix(name, ".tmp"))
+		{
+			//Left over by an interrupted download
+			g_remove((directory + G_DIR_SEPARATOR_S + filename).c_str());
+		}
+	}
+	g_dir_close(dir);
+
+	for(auto it=keys.begin();it!=keys.end();++it)
+	{
+		ContentCacheEntry* e = readEntry(*it);
+		GStatBuf st;
+		if(e && g_stat(dataFilename(*it).c_str(), &st) == 0 && uint64_t(st.st_size) == e->size)
+		{
+			entries.insert(make_pair(e->url, _MR(e)));
+			totalSize += e->size;
+			continue;
+		}
+		LOG(LOG_INFO, "ContentCache: removing damaged entry " << *it);
+		if(e)
+			e->decRef();
+		g_remove(dataFilename(*it).c_str());
+		g_remove(metaFilename(*it).c_str());
+	}
+	evict();
+}
+
+ContentCacheEntry* ContentCache::readEntry(const std::string& key)
+{
+	GKeyFile* meta = g_key_file_new();
+	if(!g_key_file_load_from_file(meta, metaFilename(key).c_str(), G_KEY_FILE_NONE, NULL))
+	{
+		g_key_file_free(meta);
+		return NULL;
+	}
+	gchar* url = g_key_file_get_string(meta, "entry", "url", NULL);
+	if(!url)
+	{
+		g_key_file_free(meta);
+		return NULL;
+	}
+	ContentCacheEntry* e = new ContentCacheEntry();
+	e->key = key;
+	e->url = tiny_string(url, true);
+	g_free(url);
+	gsize count = 0;
+	gchar** names = g_key_file_get_keys(meta, "vary", &count, NULL);
+	for(gsize i=0;i<count;i++)
+	{
+		gchar* value = g_key_file_get_string(meta, "vary", names[i], NULL);
+		e->varyHeaders.insert(make_pair(tiny_string(names[i], true), value ? tiny_string(value, true) : tiny_string()));
+		g_free(value);
+	}
+	g_strfreev(names);
+	//The key must match, otherwise the file has been renamed
+	if(keyFor(e->url, e->varyHeaders) != key)
+	{
+		e->decRef();
+		g_key_file_free(meta);
+		return NULL;
+	}
+	gchar* etag = g_key_file_get_string(meta, "entry", "etag", NULL);
+	if(etag)
+		e->etag = tiny_string(etag, true);
+	g_free(etag);
+	gchar* lastModified = g_key_file_get_string(meta, "entry", "last_modified", NULL);
+	if(lastModified)
+		e->lastModified = tiny_string(lastModified, true);
+	g_free(lastModified);
+	e->expires = g_key_file_get_int64(meta, "entry", "expires", NULL);
+	e->size = g_key_file_get_uint64(meta, "entry", "size", NULL);
+	e->lastAccess = g_key_file_get_int64(meta, "entry", "last_access", NULL);
+	e->storedAccess = e->lastAccess;
+	names = g_key_file_get_keys(meta, "headers", &count, NULL);
+	for(gsize i=0;i<count;i++)
+	{
+		gchar* value = g_key_file_get_string(meta, "headers", names[i], NULL);
+		if(value)
+			e->headers.insert(make_pair(tiny_string(names[i], true), tiny_string(value, true)));
+		g_free(value);
+	}
+	g_strfreev(names);
+	g_key_file_free(meta);
+	return e;
+}
+
+bool ContentCache::writeEntry(const ContentCacheEntry* e)
+{
+	GKeyFile* meta = g_key_file_new();
+	g_key_file_set_string(meta, "entry", "url", e->url.raw_buf());
+	g_key_file_set_string(meta, "entry", "etag", e->etag.raw_buf());
+	g_key_file_set_string(meta, "entry", "last_modified", e->lastModified.raw_buf());
+	g_key_file_set_int64(meta, "entry", "expires", e->expires);
+	g_key_file_set_uint64(meta, "entry", "size", e->size);
+	g_key_file_set_int64(meta, "entry", "last_access", e->lastAccess);
+	for(auto it=e->varyHeaders.begin();it!=e->varyHeaders.end();++it)
+		g_key_file_set_string(meta, "vary", it->first.raw_buf(), it->second.raw_buf());
+	for(auto it=e->headers.begin();it!=e->headers.end();++it)
+		g_key_file_set_string(meta, "headers", it->first.raw_buf(), it->second.raw_buf());
+	gsize length = 0;
+	gchar* data = g_key_file_to_data(meta, &length, NULL);
+	bool ret = g_file_set_contents(metaFilename(e->key).c_str(), data, length, NULL);
+	if(!ret)
+		LOG(LOG_ERROR, "ContentCache: could not write " << metaFilename(e->key));
+	g_free(data);
+	g_key_file_free(meta);
+	return ret;
+}
+
+void ContentCache::removeEntry(const _R<ContentCacheEntry>& e)
+{
+	g_remove(dataFilename(e->key).c_str());
+	g_remove(metaFilename(e->key).c_str());
+	auto range = entries.equal_range(e->url);
+	for(auto it=range.first;it!=range.second;++it)
+	{
+		if(it->second == e)
+		{
+			totalSize -= e->size;
+			entries.erase(it);
+			break;
+		}
+	}
+}
+
+void ContentCache::evict()
+{
+	if(totalSize <= maxSize)
+		return;
+	std::vector<_R<ContentCacheEntry>> lru;
+	for(auto it=entries.begin();it!=entries.end();++it)
+		lru.push_back(it->second);
+	std::sort(lru.begin(), lru.end(),
+		  [](const _R<ContentCacheEntry>& a, const _R<ContentCacheEntry>& b) { return a->lastAccess < b->lastAccess; });
+	//Leave some room, so that the next entries do not evict again immediately
+	uint64_t target = maxSize/10*9;
+	for(auto it=lru.begin();it!=lru.end() && totalSize > target;++it)
+	{
+		LOG(LOG_INFO, "ContentCache: evicting " << (*it)->url);
+		removeEntry(*it);
+	}
+}
+
+_NR<ContentCacheEntry> ContentCache::lookup(const tiny_string& url, const std::map<tiny_string, tiny_string>& requestHeaders)
+{
+	Locker l(mutex);
+	auto range = entries.equal_range(url);
+	for(auto it=range.first;it!=range.second;++it)
+	{
+		if(it->second->matches(requestHeaders))
+			return it->second;
+	}
+	return NullRef;
+}
+
+bool ContentCache::canServeWithoutRevalidation(const _R<ContentCacheEntry>& entry) const
+{
+	return !revalidate || entry->isFresh();
+}
+
+MappedFile* ContentCache::open(const _R<ContentCacheEntry>& entry)
+{
+	MappedFile* f = MappedFile::open(dataFilename(entry->key));
+	Locker l(mutex);
+	if(!f || f->getLength() != entry->size)
+	{
+		LOG(LOG_ERROR, "ContentCache: removing damaged entry " << entry->url);
+		if(f)
+			f->decRef();
+		removeEntry(entry);
+		return NULL;
+	}
+	entry->lastAccess = currentTime();
+	//The eviction order does not need a precise access time on disk,
+	//so most hits do not rewrite the metadata
+	if(entry->lastAccess - entry->storedAccess >= CONTENTCACHE_ACCESS_RESOLUTION)
+	{
+		if(writeEntry(entry.getPtr()))
+			entry->storedAccess = entry->lastAccess;
+	}
+	return f;
+}
+
+ContentCacheWriter* ContentCache::createWriter(const tiny_string& url)
+{
+	std::string filename = directory + G_DIR_SEPARATOR_S + "XXXXXX.tmp";
+	std::vector<gchar> tmpl(filename.begin(), filename.end());
+	tmpl.push_back(0);
+	int fd = g_mkstemp_full(&tmpl[0], O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if(fd < 0)
+	{
+		LOG(LOG_ERROR, "ContentCache: could not create a temporary file in " << directory);
+		return NULL;
+	}
+	FILE* f = fdopen(fd, "wb");
+	if(!f)
+	{
+		close(fd);
+		g_remove(&tmpl[0]);
+		return NULL;
+	}
+	return new ContentCacheWriter(url, &tmpl[0], f);
+}
+
+void ContentCache::commit(ContentCacheWriter* writer, const tiny_string& etag, const tiny_string& lastModified,
+			  int64_t expires, const std::map<tiny_string, tiny_string>& headers,
+			  const std::map<tiny_string, tiny_string>& requestHeaders)
+{
+	int closed = fclose(writer->file);
+	writer->file = NULL;
+	if(closed != 0 || writer->failed || writer->size > maxSize)
+	{
+		delete writer;
+		return;
+	}
+	ContentCacheEntry* e = new ContentCacheEntry();
+	auto vary = headers.find("vary");
+	if(vary != headers.end())
+	{
+		gchar** names = g_strsplit(vary->second.lowercase().raw_buf(), ",", -1);
+		for(gchar** name=names;*name;name++)
+		{
+			g_strstrip(*name);
+			if(**name == 0)
+				continue;
+			tiny_string header(*name, true);
+			auto value = requestHeaders.find(header);
+			e->varyHeaders[header] = value == requestHeaders.end() ? tiny_string() : value->second;
+		}
+		g_strfreev(names);
+	}
+	e->key = keyFor(writer->url, e->varyHeaders);
+	e->url = writer->url;
+	e->etag = etag;
+	e->lastModified = lastModified;
+	e->expires = expires;
+	e->size = writer->size;
+	e->lastAccess = currentTime();
+	e->storedAccess = e->lastAccess;
+	for(auto it=headers.begin();it!=headers.end();++it)
+	{
+		if(it->first != "set-cookie")
+			e->headers.insert(*it);
+	}
+	_R<ContentCacheEntry> entry = _MR(e);
+
+	Locker l(mutex);
+	//Replace the variant stored with the same key, the other variants stay
+	auto range = entries.equal_range(entry->url);
+	for(auto old=range.first;old!=range.second;++old)
+	{
+		if(old->second->key == entry->key)
+		{
+			totalSize -= old->second->size;
+			entries.erase(old);
+			break;
+		}
+	}
+	std::string data = dataFilename(entry->key);
+	//Mappings of the old data stay valid, as the file is replaced and not overwritten
+	if(g_rename(writer->tempFilename.c_str(), data.c_str()) != 0)
+	{
+		//The destination can not be replaced on some platforms
+		g_remove(data.c_str());
+		if(g_rename(writer->tempFilename.c_str(), data.c_str()) != 0)
+		{
+			LOG(LOG_ERROR, "ContentCache: could not store " << entry->url);
+			g_remove(metaFilename(entry->key).c_str());
+			delete writer;
+			return;
+		}
+	}
+	writer->tempFilename.clear();
+	delete writer;
+	if(!writeEntry(entry.getPtr()))
+	{
+		g_remove(data.c_str());
+		return;
+	}
+	entries.insert(make_pair(entry->url, entry));
+	totalSize += entry->size;
+	LOG(LOG_INFO, "ContentCache: stored " << entry->url << " (" << entry->size << " bytes)");
+	evict();
+}
@@ -0,0 +1,142 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef BACKENDS_CONTENTCACHE_H
+#define BACKENDS_CONTENTCACHE_H 1
+
+#include <map>
+#include <string>
+#include <cstdio>
+#include "compat.h"
+#include "threading.h"
+#include "tiny_string.h"
+#include "smartrefs.h"
+#include "backends/streamcache.h"
+
+namespace lightspark
+{
+
+// The last access time of an entry is only written back to its metadata file
+// when it is at least this many seconds newer than the stored one
+#define CONTENTCACHE_ACCESS_RESOLUTION 3600
+
+/*
+ * A response stored in the content cache. Entries are never modified after
+ * they have been stored, a new download of the same url and the same values
+ * of the Vary'd request headers replaces the entry.
+ */
+class DLL_PUBLIC ContentCacheEntry : public RefCountable {
+friend class ContentCache;
+private:
+	// Name of the data and metadata files, derived from the url and varyHeaders
+	std::string key;
+	// Last access in seconds since the epoch, protected by the ContentCache mutex
+	int64_t lastAccess;
+	// Last access stored in the metadata file
+	int64_t storedAccess;
+public:
+	tiny_string url;
+	// Request headers named by the Vary header of the response with the values
+	// they had in the request, names in lower case. Missing headers have an empty value
+	std::map<tiny_string, tiny_string> varyHeaders;
+	// Validators sent back to the server when the entry is stale
+	tiny_string etag;
+	tiny_string lastModified;
+	// The entry can be used without revalidation until this time, in seconds since the epoch
+	int64_t expires;
+	uint64_t size;
+	// Response headers, names in lower case
+	std::map<tiny_string, tiny_string> headers;
+	ContentCacheEntry():lastAccess(0),storedAccess(0),expires(0),size(0) {}
+	bool isFresh() const;
+	// True if the entry was stored for a request with the same values of the Vary'd headers
+	bool matches(const std::map<tiny_string, tiny_string>& requestHeaders) const;
+	bool hasValidators() const { return !etag.empty() || !lastModified.empty(); }
+};
+
+/*
+ * Writes a response to a temporary file in the cache directory,
+ * it becomes an entry of the cache when it is committed.
+ */
+class DLL_PUBLIC ContentCacheWriter {
+friend class ContentCache;
+private:
+	tiny_string url;
+	std::string tempFilename;
+	FILE* file;
+	uint64_t size;
+	bool failed;
+	ContentCacheWriter(const tiny_string& _url, const std::string& filename, FILE* f);
+public:
+	// The temporary file is removed if the writer was not committed
+	~ContentCacheWriter();
+	void write(const unsigned char* buffer, size_t length);
+};
+
+/*
+ * Persistent cache of downloaded content, shared by all the instances in this process.
+ * It is enabled by the cache/content_directory configuration entry.
+ * Every entry is stored as a data file and a metadata file named after a hash of the url
+ * and of the request headers named by the Vary header of the response, so a url can have
+ * one entry for each variant. Responses with Vary: * are not stored.
+ * The total size of the data files is kept below cache/content_size MiB by removing
+ * the least recently used entries. The data files are memory mapped when they are read.
+ */
+class DLL_PUBLIC ContentCache {
+private:
+	Mutex mutex;
+	std::string directory;
+	uint64_t maxSize;
+	uint64_t totalSize;
+	bool revalidate;
+	// All the variants of a url are stored under the url
+	std::multimap<tiny_string, _R<ContentCacheEntry>> entries;
+	ContentCache();
+	std::string keyFor(const tiny_string& url, const std::map<tiny_string, tiny_string>& varyHeaders) const;
+	std::string dataFilename(const std::string& key) const;
+	std::string metaFilename(const std::string& key) const;
+	// Reads all the metadata files and removes incomplete entries
+	void scan();
+	ContentCacheEntry* readEntry(const std::string& key);
+	bool writeEntry(const ContentCacheEntry* entry);
+	void removeEntry(const _R<ContentCacheEntry>& entry);
+	// Removes the least recently used entries until the cache fits in maxSize, mutex must be held
+	void evict();
+public:
+	// Returns NULL if the content cache is not enabled
+	static ContentCache* getContentCache();
+	// Returns the entry stored for the url that matches the request headers, if any.
+	// The names of the request headers must be in lower case
+	_NR<ContentCacheEntry> lookup(const tiny_string& url, const std::map<tiny_string, tiny_string>& requestHeaders);
+	// True if the entry can be served without asking the server
+	bool canServeWithoutRevalidation(const _R<ContentCacheEntry>& entry) const;
+	// Maps the data of an entry and marks it as recently used, returns NULL and forgets the entry if it is damaged
+	MappedFile* open(const _R<ContentCacheEntry>& entry);
+	// Returns NULL if the response can not be stored
+	ContentCacheWriter* createWriter(const tiny_string& url);
+	// Stores the data written by the writer, the writer is deleted.
+	// requestHeaders are the headers of the request, to store the values of the Vary'd ones
+	void commit(ContentCacheWriter* writer, const tiny_string& etag, const tiny_string& lastModified,
+		    int64_t expires, const std::map<tiny_string, tiny_string>& headers,
+		    const std::map<tiny_string, tiny_string>& requestHeaders);
+};
+
+}
+
+#endif /* BACKENDS_CONTENTCACHE_H */
@@ -25,10 +25,10 @@
 #include "platforms/fastpaths.h"
 #include "swf.h"
 #include "backends/rendering.h"
-#include "SDL2/SDL_mixer.h"
 #include "scripting/class.h"
 #include "scripting/flash/net/flashnet.h"
 #include "parsing/tags.h"
+#include "tracing.h"
 
 #if LIBAVUTIL_VERSION_MAJOR < 51
 #define AVMEDIA_TYPE_VIDEO CODEC_TYPE_VIDEO
@@ -388,6 +388,7 @@ bool FFMpegVideoDecoder::discardFrame()
 
 bool FFMpegVideoDecoder::decodeData(uint8_t* data, uint32_t datalen, uint32_t time)
 {
+	LS_TRACE_SCOPE("decode","video");
 	Locker locker(mutex);
 	if(datalen==0)
 		return false;
@@ -921,6 +922,7 @@ bool FFMpegAudioDecoder::fillDataAndCheckValidity()
 
 uint32_t FFMpegAudioDecoder::decodeData(uint8_t* data, int32_t datalen, uint32_t time)
 {
+	LS_TRACE_SCOPE("decode","audio");
 #if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
 	AVPacket pkt;
 	av_init_packet(&pkt);
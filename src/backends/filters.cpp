@@ -0,0 +1,561 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "backends/filters.h"
+#include "swf.h"
+#include "threading.h"
+
+using namespace std;
+using namespace lightspark;
+
+// flash limits the number of blur passes to 15
+#define FILTER_MAX_QUALITY 15
+// maximum number of parts a filter pass is split into
+#define FILTER_MAX_TILES 8
+// minimum number of pixels for a tile, smaller jobs are not worth the dispatch
+#define FILTER_MIN_TILE_WORK (128*128)
+
+namespace lightspark
+{
+/*
+ * The tiles of a parallelFor call. It is shared by the caller and the jobs,
+ * as a job may only be run after the caller has finished all tiles
+ */
+struct FilterTileState
+{
+	std::function<void(int32_t)> func;
+	std::atomic<int32_t> next;
+	int32_t tiles;
+	// signaled for every tile finished by a job
+	Semaphore done;
+	FilterTileState(const std::function<void(int32_t)>& f, int32_t t):func(f),next(0),tiles(t),done(0) {}
+};
+class FilterTileJob: public IThreadJob
+{
+private:
+	std::shared_ptr<FilterTileState> state;
+public:
+	FilterTileJob(const std::shared_ptr<FilterTileState>& s):state(s) {}
+	void execute() override
+	{
+		int32_t i;
+		while ((i = state->next.fetch_add(1)) < state->tiles)
+		{
+			state->func(i);
+			state->done.signal();
+		}
+	}
+	void jobFence() override
+	{
+		delete this;
+	}
+	JOB_PRIORITY getPriority() const override
+	{
+		return JOB_PRIORITY_RENDER;
+	}
+};
+}
+
+static inline int32_t blurRadius(float blur)
+{
+	return blur > 1.0 ? int32_t(blur/2.0) : 0;
+}
+
+static inline int32_t blurPasses(int32_t quality)
+{
+	return max(0,min(quality,FILTER_MAX_QUALITY));
+}
+
+static void shadowOffset(const FilterData& filter, int32_t& dx, int32_t& dy)
+{
+	if (filter.type == FilterData::FILTER_DROPSHADOW)
+	{
+		dx = lrint(filter.distance*cos(filter.angle*M_PI/180.0));
+		dy = lrint(filter.distance*sin(filter.angle*M_PI/180.0));
+	}
+	else
+	{
+		dx = 0;
+		dy = 0;
+	}
+}
+
+static inline uint8_t clampChannel(float v)
+{
+	return v <= 0.0f ? 0 : (v >= 255.0f ? 255 : uint8_t(v+0.5f));
+}
+
+// multiply all channels of a premultiplied pixel by f/255
+static inline uint32_t scalePixel(uint32_t p, uint32_t f)
+{
+	uint32_t rb = (p & 0x00ff00ff)*f + 0x00800080;
+	rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+	uint32_t ag = ((p >> 8) & 0x00ff00ff)*f + 0x00800080;
+	ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+	return rb | ag;
+}
+
+// "src over dst" for premultiplied pixels
+static inline uint32_t blendOver(uint32_t src, uint32_t dst)
+{
+	return src + scalePixel(dst,255-(src>>24));
+}
+
+static inline uint32_t premultiply(uint8_t a, uint8_t r, uint8_t g, uint8_t b)
+{
+	return (uint32_t(a)<<24) | (uint32_t((r*a+127)/255)<<16) | (uint32_t((g*a+127)/255)<<8) | uint32_t((b*a+127)/255);
+}
+
+static inline void unpremultiply(uint32_t p, float* argb)
+{
+	uint32_t a = p>>24;
+	argb[0] = a;
+	if (a == 0)
+	{
+		argb[1] = argb[2] = argb[3] = 0;
+		return;
+	}
+	float f = 255.0f/a;
+	argb[1] = min(255.0f,((p>>16)&0xff)*f);
+	argb[2] = min(255.0f,((p>>8)&0xff)*f);
+	argb[3] = min(255.0f,(p&0xff)*f);
+}
+
+#ifdef __SSE2__
+static inline __m128i unpackPixel(uint32_t p)
+{
+	const __m128i zero = _mm_setzero_si128();
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int32_t(p)),zero),zero);
+}
+
+static inline uint32_t packPixel(__m128i sum, __m128 scale)
+{
+	__m128i v = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum),scale));
+	v = _mm_packs_epi32(v,v);
+	v = _mm_packus_epi16(v,v);
+	return uint32_t(_mm_cvtsi128_si32(v));
+}
+#else
+static inline void addPixel(int32_t* sum, uint32_t p)
+{
+	sum[0] += p&0xff;
+	sum[1] += (p>>8)&0xff;
+	sum[2] += (p>>16)&0xff;
+	sum[3] += p>>24;
+}
+
+static inline void subPixel(int32_t* sum, uint32_t p)
+{
+	sum[0] -= p&0xff;
+	sum[1] -= (p>>8)&0xff;
+	sum[2] -= (p>>16)&0xff;
+	sum[3] -= p>>24;
+}
+
+static inline uint32_t averagePixel(const int32_t* sum, int32_t size)
+{
+	const int32_t half = size/2;
+	return uint32_t((sum[0]+half)/size) | (uint32_t((sum[1]+half)/size)<<8)
+		| (uint32_t((sum[2]+half)/size)<<16) | (uint32_t((sum[3]+half)/size)<<24);
+}
+#endif
+
+FilterData::FilterData():type(FILTER_NONE),blurX(0),blurY(0),quality(1),color(0),alpha(1.0),
+	strength(1.0),angle(0),distance(0),inner(false),knockout(false),hideObject(false),
+	matrixX(0),matrixY(0),divisor(1.0),bias(0),clamp(true),preserveAlpha(true)
+{
+	// identity matrix
+	for (uint32_t i = 0; i < 20; i++)
+		colorMatrix[i] = (i%6 == 0) ? 1.0 : 0.0;
+}
+
+void FilterData::getMargins(int32_t& left, int32_t& top, int32_t& right, int32_t& bottom) const
+{
+	left = top = right = bottom = 0;
+	switch (type)
+	{
+		case FILTER_GLOW:
+		case FILTER_DROPSHADOW:
+			// inner effects never extend outside of the object
+			if (inner)
+				break;
+			/* fall through */
+		case FILTER_BLUR:
+		{
+			int32_t passes = blurPasses(quality);
+			int32_t rx = blurRadius(blurX)*passes;
+			int32_t ry = blurRadius(blurY)*passes;
+			int32_t dx,dy;
+			shadowOffset(*this,dx,dy);
+			left = rx + max(0,-dx);
+			right = rx + max(0,dx);
+			top = ry + max(0,-dy);
+			bottom = ry + max(0,dy);
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+void FilterEngine::parallelFor(SystemState* sys, int32_t count, uint32_t workPerItem, const std::function<void(int32_t,int32_t)>& f)
+{
+	int32_t tiles = 1;
+	if (sys && count > 1)
+		tiles = min<int64_t>(min(count,FILTER_MAX_TILES),int64_t(count)*workPerItem/FILTER_MIN_TILE_WORK);
+	if (tiles <= 1)
+	{
+		f(0,count);
+		return;
+	}
+	int32_t tilesize = (count+tiles-1)/tiles;
+	tiles = (count+tilesize-1)/tilesize;
+	std::shared_ptr<FilterTileState> state = std::make_shared<FilterTileState>([&](int32_t i)
+	{
+		f(i*tilesize,min(count,(i+1)*tilesize));
+	},tiles);
+	for (int32_t i = 1; i < tiles; i++)
+		sys->addJob(new FilterTileJob(state));
+	// the calling thread takes tiles too, so it never waits for a job that has not been started yet,
+	// only for the tiles the workers are still working on
+	int32_t i;
+	int32_t owntiles = 0;
+	while ((i = state->next.fetch_add(1)) < tiles)
+	{
+		state->func(i);
+		owntiles++;
+	}
+	for (int32_t j = owntiles; j < tiles; j++)
+		state->done.wait();
+}
+
+void FilterEngine::blurRows(uint32_t* data, int32_t stride, int32_t width, int32_t ystart, int32_t yend, int32_t radius)
+{
+	const int32_t size = radius*2+1;
+	std::vector<uint32_t> line(width);
+	for (int32_t y = ystart; y < yend; y++)
+	{
+		uint32_t* row = data+y*stride;
+		memcpy(line.data(),row,width*4);
+#ifdef __SSE2__
+		const __m128 scale = _mm_set1_ps(1.0f/size);
+		__m128i sum = _mm_setzero_si128();
+		for (int32_t x = 0; x < radius && x < width; x++)
+			sum = _mm_add_epi32(sum,unpackPixel(line[x]));
+		for (int32_t x = 0; x < width; x++)
+		{
+			if (x+radius < width)
+				sum = _mm_add_epi32(sum,unpackPixel(line[x+radius]));
+			row[x] = packPixel(sum,scale);
+			if (x >= radius)
+				sum = _mm_sub_epi32(sum,unpackPixel(line[x-radius]));
+		}
+#else
+		int32_t sum[4] = {0,0,0,0};
+		for (int32_t x = 0; x < radius && x < width; x++)
+			addPixel(sum,line[x]);
+		for (int32_t x = 0; x < width; x++)
+		{
+			if (x+radius < width)
+				addPixel(sum,line[x+radius]);
+			row[x] = averagePixel(sum,size);
+			if (x >= radius)
+				subPixel(sum,line[x-radius]);
+		}
+#endif
+	}
+}
+
+void FilterEngine::blurColumns(uint32_t* data, int32_t stride, int32_t height, int32_t xstart, int32_t xend, int32_t radius)
+{
+	// The columns are processed one row at a time with a running sum per column,
+	// so that memory is always accessed sequentially
+	const int32_t size = radius*2+1;
+	const int32_t w = xend-xstart;
+	std::vector<int32_t> sums(w*4,0);
+	std::vector<uint32_t> out(w*height);
+#ifdef __SSE2__
+	const __m128 scale = _mm_set1_ps(1.0f/size);
+	for (int32_t y = 0; y < radius && y < height; y++)
+	{
+		const uint32_t* row = data+y*stride+xstart;
+		for (int32_t x = 0; x < w; x++)
+		{
+			__m128i* s = (__m128i*)&sums[x*4];
+			_mm_storeu_si128(s,_mm_add_epi32(_mm_loadu_si128(s),unpackPixel(row[x])));
+		}
+	}
+	for (int32_t y = 0; y < height; y++)
+	{
+		const uint32_t* addrow = y+radius < height ? data+(y+radius)*stride+xstart : nullptr;
+		const uint32_t* subrow = y >= radius ? data+(y-radius)*stride+xstart : nullptr;
+		uint32_t* o = out.data()+y*w;
+		for (int32_t x = 0; x < w; x++)
+		{
+			__m128i* s = (__m128i*)&sums[x*4];
+			__m128i sum = _mm_loadu_si128(s);
+			if (addrow)
+				sum = _mm_add_epi32(sum,unpackPixel(addrow[x]));
+			o[x] = packPixel(sum,scale);
+			if (subrow)
+				sum = _mm_sub_epi32(sum,unpackPixel(subrow[x]));
+			_mm_storeu_si128(s,sum);
+		}
+	}
+#else
+	for (int32_t y = 0; y < radius && y < height; y++)
+	{
+		const uint32_t* row = data+y*stride+xstart;
+		for (int32_t x = 0; x < w; x++)
+			addPixel(&sums[x*4],row[x]);
+	}
+	for (int32_t y = 0; y < height; y++)
+	{
+		const uint32_t* addrow = y+radius < height ? data+(y+radius)*stride+xstart : nullptr;
+		const uint32_t* subrow = y >= radius ? data+(y-radius)*stride+xstart : nullptr;
+		uint32_t* o = out.data()+y*w;
+		for (int32_t x = 0; x < w; x++)
+		{
+			if (addrow)
+				addPixel(&sums[x*4],addrow[x]);
+			o[x] = averagePixel(&sums[x*4],size);
+			if (subrow)
+				subPixel(&sums[x*4],subrow[x]);
+		}
+	}
+#endif
+	for (int32_t y = 0; y < height; y++)
+		memcpy(data+y*stride+xstart,out.data()+y*w,w*4);
+}
+
+void FilterEngine::boxBlur(uint32_t* data, int32_t stride, int32_t width, int32_t height, float blurX, float blurY, int32_t passes, SystemState* sys)
+{
+	const int32_t rx = blurRadius(blurX);
+	const int32_t ry = blurRadius(blurY);
+	passes = blurPasses(passes);
+	for (int32_t i = 0; i < passes; i++)
+	{
+		if (rx > 0)
+			parallelFor(sys,height,width,[=](int32_t start, int32_t end)
+			{
+				blurRows(data,stride,width,start,end,rx);
+			});
+		if (ry > 0)
+			parallelFor(sys,width,height,[=](int32_t start, int32_t end)
+			{
+				blurColumns(data,stride,height,start,end,ry);
+			});
+	}
+}
+
+void FilterEngine::applyShadow(const FilterData& filter, uint32_t* data, int32_t stride, int32_t width, int32_t height, int32_t offsetX, int32_t offsetY, SystemState* sys)
+{
+	// build the (shifted) alpha mask of the object, inverted for inner effects
+	std::vector<uint32_t> mask(width*height);
+	uint32_t* m = mask.data();
+	parallelFor(sys,height,width,[=,&filter](int32_t start, int32_t end)
+	{
+		for (int32_t y = start; y < end; y++)
+		{
+			const int32_t sy = y-offsetY;
+			for (int32_t x = 0; x < width; x++)
+			{
+				const int32_t sx = x-offsetX;
+				uint32_t a = 0;
+				if (sx >= 0 && sx < width && sy >= 0 && sy < height)
+					a = data[sy*stride+sx]>>24;
+				if (filter.inner)
+					a = 255-a;
+				m[y*width+x] = a<<24;
+			}
+		}
+	});
+	boxBlur(m,width,width,height,filter.blurX,filter.blurY,filter.quality,sys);
+
+	const uint32_t strength = uint32_t(max(0.0f,filter.strength)*256);
+	const uint32_t alpha = clampChannel(filter.alpha*255);
+	const uint8_t r = (filter.color>>16)&0xff;
+	const uint8_t g = (filter.color>>8)&0xff;
+	const uint8_t b = filter.color&0xff;
+	parallelFor(sys,height,width,[=,&filter](int32_t start, int32_t end)
+	{
+		for (int32_t y = start; y < end; y++)
+		{
+			uint32_t* row = data+y*stride;
+			for (int32_t x = 0; x < width; x++)
+			{
+				uint32_t a = min(255u,((m[y*width+x]>>24)*strength)>>8);
+				a = (a*alpha+127)/255;
+				uint32_t shadow = premultiply(a,r,g,b);
+				uint32_t source = row[x];
+				uint32_t sourceAlpha = source>>24;
+				if (filter.inner)
+				{
+					shadow = scalePixel(shadow,sourceAlpha);
+					row[x] = (filter.knockout || filter.hideObject) ? shadow : blendOver(shadow,source);
+				}
+				else if (filter.knockout)
+					row[x] = scalePixel(shadow,255-sourceAlpha);
+				else if (filter.hideObject)
+					row[x] = shadow;
+				else
+					row[x] = blendOver(source,shadow);
+			}
+		}
+	});
+}
+
+void FilterEngine::applyColorMatrix(const FilterData& filter, uint32_t* data, int32_t stride, int32_t width, int32_t height, SystemState* sys)
+{
+	const float* cm = filter.colorMatrix;
+	parallelFor(sys,height,width,[=](int32_t start, int32_t end)
+	{
+		float argb[4];
+		for (int32_t y = start; y < end; y++)
+		{
+			uint32_t* row = data+y*stride;
+			for (int32_t x = 0; x < width; x++)
+			{
+				unpremultiply(row[x],argb);
+				const float a = argb[0];
+				const float r = argb[1];
+				const float g = argb[2];
+				const float b = argb[3];
+				row[x] = premultiply(clampChannel(cm[15]*r + cm[16]*g + cm[17]*b + cm[18]*a + cm[19]),
+						clampChannel(cm[0]*r + cm[1]*g + cm[2]*b + cm[3]*a + cm[4]),
+						clampChannel(cm[5]*r + cm[6]*g + cm[7]*b + cm[8]*a + cm[9]),
+						clampChannel(cm[10]*r + cm[11]*g + cm[12]*b + cm[13]*a + cm[14]));
+			}
+		}
+	});
+}
+
+void FilterEngine::applyConvolution(const FilterData& filter, uint32_t* data, int32_t stride, int32_t width, int32_t height, SystemState* sys)
+{
+	const int32_t mx = filter.matrixX;
+	const int32_t my = filter.matrixY;
+	if (mx <= 0 || my <= 0 || filter.kernel.size() < uint32_t(mx*my))
+		return;
+	// the kernel is applied to the unpremultiplied values
+	std::vector<float> src(width*height*4);
+	float* s = src.data();
+	parallelFor(sys,height,width,[=](int32_t start, int32_t end)
+	{
+		for (int32_t y = start; y < end; y++)
+		{
+			for (int32_t x = 0; x < width; x++)
+				unpremultiply(data[y*stride+x],s+(y*width+x)*4);
+		}
+	});
+	const float outside[4] = { float(clampChannel(filter.alpha*255)), float((filter.color>>16)&0xff), float((filter.color>>8)&0xff), float(filter.color&0xff) };
+	const float divisor = filter.divisor != 0 ? filter.divisor : 1.0f;
+	const float* kernel = filter.kernel.data();
+	const bool clamp = filter.clamp;
+	const bool preserveAlpha = filter.preserveAlpha;
+	const float bias = filter.bias;
+	parallelFor(sys,height,width*mx*my,[=,&outside](int32_t start, int32_t end)
+	{
+		for (int32_t y = start; y < end; y++)
+		{
+			for (int32_t x = 0; x < width; x++)
+			{
+				float sum[4] = {0,0,0,0};
+				for (int32_t ky = 0; ky < my; ky++)
+				{
+					int32_t sy = y+ky-my/2;
+					if (clamp)
+						sy = max(0,min(sy,height-1));
+					for (int32_t kx = 0; kx < mx; kx++)
+					{
+						int32_t sx = x+kx-mx/2;
+						if (clamp)
+							sx = max(0,min(sx,width-1));
+						const float* p = (sx < 0 || sx >= width || sy < 0 || sy >= height) ? outside : s+(sy*width+sx)*4;
+						const float k = kernel[ky*mx+kx];
+						sum[0] += p[0]*k;
+						sum[1] += p[1]*k;
+						sum[2] += p[2]*k;
+						sum[3] += p[3]*k;
+					}
+				}
+				const float* orig = s+(y*width+x)*4;
+				data[y*stride+x] = premultiply(preserveAlpha ? uint8_t(orig[0]) : clampChannel(sum[0]/divisor+bias),
+						clampChannel(sum[1]/divisor+bias),
+						clampChannel(sum[2]/divisor+bias),
+						clampChannel(sum[3]/divisor+bias));
+			}
+		}
+	});
+}
+
+void FilterEngine::applyFilter(const FilterData& filter, uint32_t* data, int32_t stride, int32_t width, int32_t height, SystemState* sys)
+{
+	if (width <= 0 || height <= 0)
+		return;
+	switch (filter.type)
+	{
+		case FilterData::FILTER_BLUR:
+			boxBlur(data,stride,width,height,filter.blurX,filter.blurY,filter.quality,sys);
+			break;
+		case FilterData::FILTER_GLOW:
+		case FilterData::FILTER_DROPSHADOW:
+		{
+			int32_t dx,dy;
+			shadowOffset(filter,dx,dy);
+			applyShadow(filter,data,stride,width,height,dx,dy,sys);
+			break;
+		}
+		case FilterData::FILTER_COLORMATRIX:
+			applyColorMatrix(filter,data,stride,width,height,sys);
+			break;
+		case FilterData::FILTER_CONVOLUTION:
+			applyConvolution(filter,data,stride,width,height,sys);
+			break;
+		case FilterData::FILTER_NONE:
+			break;
+	}
+}
+
+void FilterEngine::applyFilters(const std::vector<FilterData>& filters, uint32_t* data, int32_t stride, int32_t width, int32_t height, SystemState* sys)
+{
+	for (auto it = filters.begin(); it != filters.end(); it++)
+		applyFilter(*it,data,stride,width,height,sys);
+}
+
+void FilterEngine::getMargins(const std::vector<FilterData>& filters, int32_t& left, int32_t& top, int32_t& right, int32_t& bottom)
+{
+	left = top = right = bottom = 0;
+	for (auto it = filters.begin(); it != filters.end(); it++)
+	{
+		int32_t l,t,r,b;
+		it->getMargins(l,t,r,b);
+		left += l;
+		top += t;
+		right += r;
+		bottom += b;
+	}
+}
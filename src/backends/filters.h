@@ -0,0 +1,109 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef BACKENDS_FILTERS_H
+#define BACKENDS_FILTERS_H 1
+
+#include "compat.h"
+#include <vector>
+#include <functional>
+
+namespace lightspark
+{
+
+class SystemState;
+
+/*
+ * Plain description of a bitmap filter.
+ * It is filled from the ActionScript filter objects on the VM thread,
+ * so that it can be applied later from any thread (e.g. the render jobs).
+ */
+struct FilterData
+{
+	enum FILTER_TYPE { FILTER_NONE=0, FILTER_BLUR, FILTER_GLOW, FILTER_DROPSHADOW, FILTER_COLORMATRIX, FILTER_CONVOLUTION };
+	FILTER_TYPE type;
+	// blur, glow and dropshadow
+	float blurX;
+	float blurY;
+	int32_t quality;
+	// glow, dropshadow and convolution
+	uint32_t color;
+	float alpha;
+	// glow and dropshadow
+	float strength;
+	float angle;
+	float distance;
+	bool inner;
+	bool knockout;
+	bool hideObject;
+	// colormatrix
+	float colorMatrix[20];
+	// convolution
+	std::vector<float> kernel;
+	int32_t matrixX;
+	int32_t matrixY;
+	float divisor;
+	float bias;
+	bool clamp;
+	bool preserveAlpha;
+	FilterData();
+	/*
+	 * Number of pixels the result of the filter may extend outside of the source rectangle
+	 */
+	void getMargins(int32_t& left, int32_t& top, int32_t& right, int32_t& bottom) const;
+};
+
+/*
+ * CPU implementation of the bitmap filters.
+ * All the functions work on premultiplied, native-endian 32 bit ARGB data,
+ * the same format used by BitmapContainer and the cairo renderers.
+ */
+class FilterEngine
+{
+private:
+	/*
+	 * Calls f(start,end) on [0,count), split across the thread pool if sys is not null
+	 * and the amount of work is large enough. Returns when all parts are done.
+	 */
+	static void parallelFor(SystemState* sys, int32_t count, uint32_t workPerItem, const std::function<void(int32_t,int32_t)>& f);
+	static void blurRows(uint32_t* data, int32_t stride, int32_t width, int32_t ystart, int32_t yend, int32_t radius);
+	static void blurColumns(uint32_t* data, int32_t stride, int32_t height, int32_t xstart, int32_t xend, int32_t radius);
+	static void applyShadow(const FilterData& filter, uint32_t* data, int32_t stride, int32_t width, int32_t height, int32_t offsetX, int32_t offsetY, SystemState* sys);
+	static void applyColorMatrix(const FilterData& filter, uint32_t* data, int32_t stride, int32_t width, int32_t height, SystemState* sys);
+	static void applyConvolution(const FilterData& filter, uint32_t* data, int32_t stride, int32_t width, int32_t height, SystemState* sys);
+public:
+	/*
+	 * Blur the data in place using passes iterations of a separable box blur.
+	 * blurX and blurY are the box sizes in pixels
+	 */
+	static void boxBlur(uint32_t* data, int32_t stride, int32_t width, int32_t height, float blurX, float blurY, int32_t passes, SystemState* sys=nullptr);
+	/*
+	 * Apply the filter in place.
+	 * stride is in pixels. Pixels outside of [0,width)x[0,height) are treated as transparent.
+	 * If sys is not null large bitmaps are tiled across its ThreadPool.
+	 * It must be null when called from a ThreadPool job, as the workers
+	 * would otherwise wait on each other.
+	 */
+	static void applyFilter(const FilterData& filter, uint32_t* data, int32_t stride, int32_t width, int32_t height, SystemState* sys=nullptr);
+	static void applyFilters(const std::vector<FilterData>& filters, uint32_t* data, int32_t stride, int32_t width, int32_t height, SystemState* sys=nullptr);
+	static void getMargins(const std::vector<FilterData>& filters, int32_t& left, int32_t& top, int32_t& right, int32_t& bottom);
+};
+
+}
+#endif /* BACKENDS_FILTERS_H */
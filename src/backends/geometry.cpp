@@ -406,3 +406,189 @@ void ShapesBuilder::outputMorphTokens(const std::list<MORPHFILLSTYLE> &styles, c
 		
 	}
 }
+
+//Maximum distance in pixels between a curve and the segments it is flattened to
+#define FLATTEN_TOLERANCE 0.1
+#define FLATTEN_MAX_SEGMENTS 64
+
+//The number of segments is given by Wang's formula for the flattening tolerance
+static uint32_t flattenSegmentCount(number_t secondDifference, number_t factor)
+{
+	number_t n=ceil(sqrt(factor*secondDifference/FLATTEN_TOLERANCE));
+	if(n<1)
+		return 1;
+	return n>FLATTEN_MAX_SEGMENTS ? FLATTEN_MAX_SEGMENTS : n;
+}
+
+void FlattenedShape::addQuadratic(const Vector2f& p0, const Vector2f& p1, const Vector2f& p2)
+{
+	number_t dx=p0.x-2*p1.x+p2.x;
+	number_t dy=p0.y-2*p1.y+p2.y;
+	uint32_t n=flattenSegmentCount(sqrt(dx*dx+dy*dy),0.25);
+	for(uint32_t i=1;i<=n;i++)
+	{
+		number_t t=number_t(i)/n;
+		number_t u=1-t;
+		points.push_back(Vector2f(u*u*p0.x+2*u*t*p1.x+t*t*p2.x, u*u*p0.y+2*u*t*p1.y+t*t*p2.y));
+	}
+}
+
+void FlattenedShape::addCubic(const Vector2f& p0, const Vector2f& p1, const Vector2f& p2, const Vector2f& p3)
+{
+	number_t dx1=p0.x-2*p1.x+p2.x;
+	number_t dy1=p0.y-2*p1.y+p2.y;
+	number_t dx2=p1.x-2*p2.x+p3.x;
+	number_t dy2=p1.y-2*p2.y+p3.y;
+	uint32_t n=flattenSegmentCount(sqrt(max(dx1*dx1+dy1*dy1,dx2*dx2+dy2*dy2)),0.75);
+	for(uint32_t i=1;i<=n;i++)
+	{
+		number_t t=number_t(i)/n;
+		number_t u=1-t;
+		number_t a=u*u*u, b=3*u*u*t, c=3*u*t*t, d=t*t*t;
+		points.push_back(Vector2f(a*p0.x+b*p1.x+c*p2.x+d*p3.x, a*p0.y+b*p1.y+c*p2.y+d*p3.y));
+	}
+}
+
+void FlattenedShape::build(const tokensVector& tokens, float scaling)
+{
+	points.clear();
+	polygons.clear();
+	//Current point of the fill path, the stroked parts don't move it
+	Vector2f current;
+	bool hasCurrent=false;
+	bool instroke=false;
+	const std::vector<uint64_t>* lists[2]={ &tokens.filltokens, &tokens.stroketokens };
+	for(int l=0;l<2;l++)
+	{
+		const std::vector<uint64_t>& list=*lists[l];
+		for(uint32_t i=0;i<list.size();i++)
+		{
+			GeomToken p(list[i],false);
+			switch(p.type)
+			{
+				case MOVE:
+				{
+					GeomToken p1(list[++i],true);
+					if(instroke)
+						break;
+					current=Vector2f(p1.vec.x*scaling,p1.vec.y*scaling);
+					hasCurrent=true;
+					polygons.push_back(points.size());
+					points.push_back(current);
+					break;
+				}
+				case STRAIGHT:
+				case CURVE_QUADRATIC:
+				case CURVE_CUBIC:
+				{
+					int count=p.type==STRAIGHT ? 1 : (p.type==CURVE_QUADRATIC ? 2 : 3);
+					Vector2f v[3];
+					for(int j=0;j<count;j++)
+					{
+						GeomToken pj(list[++i],true);
+						v[j]=Vector2f(pj.vec.x*scaling,pj.vec.y*scaling);
+					}
+					if(instroke)
+						break;
+					if(!hasCurrent)
+					{
+						//Like cairo, a segment without current point only sets it
+						current=v[count-1];
+						hasCurrent=true;
+						polygons.push_back(points.size());
+						points.push_back(current);
+						break;
+					}
+					if(p.type==STRAIGHT)
+						points.push_back(v[0]);
+					else if(p.type==CURVE_QUADRATIC)
+						addQuadratic(current,v[0],v[1]);
+					else
+						addCubic(current,v[0],v[1],v[2]);
+					current=v[count-1];
+					break;
+				}
+				case SET_FILL:
+					i++;
+					break;
+				case SET_STROKE:
+					i++;
+					instroke=true;
+					break;
+				case CLEAR_STROKE:
+					instroke=false;
+					break;
+				case FILL_TRANSFORM_TEXTURE:
+					i+=6;
+					break;
+				default:
+					break;
+			}
+		}
+	}
+	//Polygons without any segment enclose nothing
+	uint32_t out=0;
+	uint32_t outPolygons=0;
+	for(uint32_t k=0;k<polygons.size();k++)
+	{
+		uint32_t start=polygons[k];
+		uint32_t end=k+1<polygons.size() ? polygons[k+1] : points.size();
+		if(end-start<3)
+			continue;
+		polygons[outPolygons++]=out;
+		for(uint32_t j=start;j<end;j++)
+			points[out++]=points[j];
+	}
+	points.resize(out);
+	polygons.resize(outPolygons);
+	if(!points.empty())
+	{
+		xmin=xmax=points[0].x;
+		ymin=ymax=points[0].y;
+		for(auto it=points.begin();it!=points.end();++it)
+		{
+			xmin=min(xmin,it->x);
+			xmax=max(xmax,it->x);
+			ymin=min(ymin,it->y);
+			ymax=max(ymax,it->y);
+		}
+	}
+}
+
+bool FlattenedShape::getBounds(number_t& _xmin, number_t& _xmax, number_t& _ymin, number_t& _ymax) const
+{
+	if(points.empty())
+		return false;
+	_xmin=xmin;
+	_xmax=xmax;
+	_ymin=ymin;
+	_ymax=ymax;
+	return true;
+}
+
+bool FlattenedShape::contains(number_t x, number_t y) const
+{
+	if(points.empty() || x<xmin || x>xmax || y<ymin || y>ymax)
+		return false;
+	int32_t winding=0;
+	for(uint32_t k=0;k<polygons.size();k++)
+	{
+		uint32_t start=polygons[k];
+		uint32_t end=k+1<polygons.size() ? polygons[k+1] : points.size();
+		const Vector2f* a=&points[end-1];
+		for(uint32_t j=start;j<end;j++)
+		{
+			const Vector2f* b=&points[j];
+			//Upward edges crossing the ray to the right of the point count +1, downward ones -1
+			if(a->y<=y)
+			{
+				if(b->y>y && (b->x-a->x)*(y-a->y)-(x-a->x)*(b->y-a->y)>0)
+					winding++;
+			}
+			else if(b->y<=y && (b->x-a->x)*(y-a->y)-(x-a->x)*(b->y-a->y)<0)
+				winding--;
+			a=b;
+		}
+	}
+	return winding!=0;
+}
@@ -154,6 +154,34 @@ public:
 	void clear();
 };
 
+/*
+ * The fill area of a tokensVector flattened to polygons, used for hit testing without cairo.
+ * Like the path built by CairoTokenRenderer, geometry between SET_STROKE and CLEAR_STROKE is
+ * left out and a new polygon only starts at MOVE. Polygons are implicitly closed.
+ */
+class FlattenedShape
+{
+private:
+	// vertices of all polygons
+	std::vector<Vector2f> points;
+	// index in points of the first vertex of every polygon
+	std::vector<uint32_t> polygons;
+	number_t xmin, xmax, ymin, ymax;
+	void addQuadratic(const Vector2f& p0, const Vector2f& p1, const Vector2f& p2);
+	void addCubic(const Vector2f& p0, const Vector2f& p1, const Vector2f& p2, const Vector2f& p3);
+public:
+	FlattenedShape():xmin(0),xmax(0),ymin(0),ymax(0) {}
+	void build(const tokensVector& tokens, float scaling);
+	bool isEmpty() const { return points.empty(); }
+	// bounds of all the vertices, returns false if the shape is empty
+	bool getBounds(number_t& _xmin, number_t& _xmax, number_t& _ymin, number_t& _ymax) const;
+	/*
+	 * Tests the point with the nonzero winding rule. Everything inside by the even-odd rule
+	 * is also inside by this one, so this is the union of both fill rules.
+	 */
+	bool contains(number_t x, number_t y) const;
+};
+
 std::ostream& operator<<(std::ostream& s, const Vector2& p);
 
 }
@@ -30,6 +30,7 @@
 #include "scripting/flash/geom/flashgeom.h"
 #include "scripting/flash/text/flashtext.h"
 #include "scripting/flash/display/BitmapData.h"
+#include "tracing.h"
 #include <pango/pangocairo.h>
 
 using namespace lightspark;
@@ -550,7 +551,16 @@ uint8_t* CairoRenderer::getPixelBuffer(float scalex, float scaley, bool *isBuffe
 		masks[i].m->applyCairoMask(cr,xOffset,yOffset,scalex,scaley);
 	}
 
-	executeDraw(cr,scalex, scaley);
+	if (filterMarginLeft || filterMarginTop)
+	{
+		//Leave room for the filters, the masks already use the enlarged offsets
+		cairo_save(cr);
+		cairo_translate(cr,filterMarginLeft,filterMarginTop);
+		executeDraw(cr,scalex, scaley);
+		cairo_restore(cr);
+	}
+	else
+		executeDraw(cr,scalex, scaley);
 
 	cairo_surface_t* maskSurface = nullptr;
 	uint8_t* maskRawData = nullptr;
@@ -602,33 +612,9 @@ uint8_t* CairoRenderer::getPixelBuffer(float scalex, float scaley, bool *isBuffe
 
 //	cairo_surface_write_to_png(cairoSurface,"/tmp/cairo.png");
 	cairo_destroy(cr);
-	return ret;
-}
-
-bool CairoTokenRenderer::hitTest(const tokensVector& tokens, float scaleFactor, number_t x, number_t y)
-{
-	cairo_surface_t* cairoSurface=cairo_image_surface_create_for_data(nullptr, CAIRO_FORMAT_ARGB32, 0, 0, 0);
-	cairo_t *cr=cairo_create(cairoSurface);
-	cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
-	cairo_set_fill_rule(cr, CAIRO_FILL_RULE_EVEN_ODD);
-
-	bool empty=cairoPathFromTokens(cr, tokens, scaleFactor, true,1.0,1.0,0,0,true);
-	bool ret=false;
-	if(!empty)
-	{
-		/* reset the matrix so x and y are not scaled
-		 * by the current cairo transformation
-		 */
-		cairo_identity_matrix(cr);
-		ret=cairo_in_fill(cr, x, y);
-		if (!ret) // no hit, so we also check with alternative fill rule
-		{
-			cairo_set_fill_rule(cr, CAIRO_FILL_RULE_WINDING);
-			ret=cairo_in_fill(cr, x, y);
-		}
-	}
-	cairo_destroy(cr);
-	cairo_surface_destroy(cairoSurface);
+	//We are running in a ThreadPool job, so the filters are not split across the pool
+	if (!filters.empty())
+		FilterEngine::applyFilters(filters,(uint32_t*)ret,width,width,height);
 	return ret;
 }
 
@@ -961,6 +947,7 @@ AsyncDrawJob::~AsyncDrawJob()
 
 void AsyncDrawJob::execute()
 {
+	LS_TRACE_SCOPE("render","rasterize");
 	owner->startDrawJob();
 	SystemState* sys = owner->getSystemState();
 	float scalex;
@@ -1059,6 +1046,31 @@ void SoftwareInvalidateQueue::addToInvalidateQueue(_R<DisplayObject> d)
 	queue.emplace_back(d);
 }
 
+void IDrawable::setFilters(const std::vector<FilterData>& f, float scalex, float scaley)
+{
+	filters = f;
+	for (auto it = filters.begin(); it != filters.end(); it++)
+	{
+		it->blurX *= scalex;
+		it->blurY *= scaley;
+		it->distance *= (scalex+scaley)/2.0;
+	}
+	int32_t left,top,right,bottom;
+	FilterEngine::getMargins(filters,left,top,right,bottom);
+	filterMarginLeft = left;
+	filterMarginTop = top;
+	filterMarginRight = right;
+	filterMarginBottom = bottom;
+	width += left+right;
+	height += top+bottom;
+	xOffset -= left;
+	yOffset -= top;
+	widthTransformed += left+right;
+	heightTransformed += top+bottom;
+	xOffsetTransformed -= left;
+	yOffsetTransformed -= top;
+}
+
 IDrawable::~IDrawable()
 {
 	auto it = masks.begin();
@@ -1083,9 +1095,44 @@ BitmapRenderer::BitmapRenderer(_NR<BitmapContainer> _data, int32_t _x, int32_t _
 
 uint8_t *BitmapRenderer::getPixelBuffer(float scalex, float scaley, bool *isBufferOwner)
 {
+	if (filters.empty())
+	{
+		if (isBufferOwner)
+			*isBufferOwner=false;
+		return data->getData();
+	}
+	//The filters are applied to a copy of the bitmap, scaled to the drawable size and enlarged by the filter margins
 	if (isBufferOwner)
-		*isBufferOwner=false;
-	return data->getData();
+		*isBufferOwner=true;
+	const int32_t w = getWidth();
+	const int32_t h = getHeight();
+	const int32_t innerw = w-filterMarginLeft-filterMarginRight;
+	const int32_t innerh = h-filterMarginTop-filterMarginBottom;
+	uint8_t* ret = new uint8_t[w*h*4];
+	memset(ret,0,w*h*4);
+	const uint8_t* src = data->getData();
+	const int32_t srcw = data->getWidth();
+	const int32_t srch = data->getHeight();
+	const size_t stride = data->getStride();
+	if (src && innerw > 0 && innerh > 0 && srcw > 0 && srch > 0)
+	{
+		uint32_t* dst = (uint32_t*)ret;
+		for (int32_t y = 0; y < innerh; y++)
+		{
+			const uint32_t* srcline = (const uint32_t*)(src+(y*srch/innerh)*stride);
+			uint32_t* dstline = dst+(y+filterMarginTop)*w+filterMarginLeft;
+			if (innerw == srcw)
+				memcpy(dstline,srcline,srcw*4);
+			else
+			{
+				for (int32_t x = 0; x < innerw; x++)
+					dstline[x] = srcline[x*srcw/innerw];
+			}
+		}
+	}
+	//We are running in a ThreadPool job, so the filters are not split across the pool
+	FilterEngine::applyFilters(filters,(uint32_t*)ret,w,w,h);
+	return ret;
 }
 
 
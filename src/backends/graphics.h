@@ -30,6 +30,7 @@
 #include <cairo.h>
 #include <pango/pango.h>
 #include "backends/geometry.h"
+#include "backends/filters.h"
 #include "memory_support.h"
 
 namespace lightspark
@@ -164,6 +165,15 @@ protected:
 	float alphaOffset;
 	bool isMask;
 	bool hasMask;
+	/*
+	 * The filters to be applied to the raster buffer and the
+	 * space reserved for them on each side
+	 */
+	std::vector<FilterData> filters;
+	int32_t filterMarginLeft;
+	int32_t filterMarginTop;
+	int32_t filterMarginRight;
+	int32_t filterMarginBottom;
 public:
 	IDrawable(int32_t w, int32_t h, int32_t x, int32_t y,
 		int32_t rw, int32_t rh, int32_t rx, int32_t ry, float r,
@@ -176,8 +186,13 @@ public:
 		alpha(a),xscale(xs),yscale(ys),
 		redMultiplier(_redMultiplier),greenMultiplier(_greenMultiplier),blueMultiplier(_blueMultiplier),alphaMultiplier(_alphaMultiplier),
 		redOffset(_redOffset),greenOffset(_greenOffset),blueOffset(_blueOffset),alphaOffset(_alphaOffset),
-		isMask(im),hasMask(hm) {}
+		isMask(im),hasMask(hm),filterMarginLeft(0),filterMarginTop(0),filterMarginRight(0),filterMarginBottom(0) {}
 	virtual ~IDrawable();
+	/*
+	 * Set the filters to be applied after rendering, scaled by the stage scaling.
+	 * The drawable is enlarged to make room for the area affected by the filters
+	 */
+	void setFilters(const std::vector<FilterData>& f, float scalex, float scaley);
 	/*
 	 * This method returns a raster buffer of the image
 	 * The various implementation are responsible for applying the
@@ -237,6 +252,7 @@ public:
 	void execute() override;
 	void threadAbort() override;
 	void jobFence() override;
+	JOB_PRIORITY getPriority() const override { return JOB_PRIORITY_RENDER; }
 	//ITextureUploadable interface
 	void upload(uint8_t* data, uint32_t w, uint32_t h) override;
 	void sizeNeeded(uint32_t& w, uint32_t& h) const override;
@@ -330,15 +346,6 @@ public:
 			float _redOffset, float _greenOffset, float _blueOffset, float _alphaOffset,
 			bool _smoothing,
 			number_t _xmin, number_t _ymin);
-	/*
-	   Hit testing helper. Uses cairo to find if a point in inside the shape
-
-	   @param tokens The tokens of the shape being tested
-	   @param scaleFactor The scale factor to be applied
-	   @param x The X in local coordinates
-	   @param y The Y in local coordinates
-	*/
-	static bool hitTest(const tokensVector& tokens, float scaleFactor, number_t x, number_t y);
 };
 
 class TextData
@@ -430,7 +437,7 @@ public:
 class BitmapRenderer: public IDrawable
 {
 protected:
-	_NR<BitmapContainer> data;
+	PinnedBitmap data;
 public:
 	BitmapRenderer(_NR<BitmapContainer> _data, int32_t _x, int32_t _y, int32_t _w, int32_t _h
 				  , int32_t _rx, int32_t _ry, int32_t _rw, int32_t _rh, float _r
@@ -392,6 +392,57 @@ uint8_t* ImageDecoder::decodePNGImpl(png_structp pngPtr, uint32_t* width, uint32
 	return outData;
 }
 
+bool ImageDecoder::getJPEGSize(const uint8_t* inData, int len, uint32_t* width, uint32_t* height)
+{
+	//SWF files may contain an encoding table block before the image, so skip
+	//everything up to the first start of frame marker
+	int i=0;
+	while(i+1<len)
+	{
+		if(inData[i]!=0xff)
+			return false;
+		uint8_t marker=inData[i+1];
+		//Padding, start and end of image and restart markers have no length
+		if(marker==0xff)
+		{
+			i++;
+			continue;
+		}
+		if(marker==0xd8 || marker==0xd9 || marker==0x01 || (marker>=0xd0 && marker<=0xd7))
+		{
+			i+=2;
+			continue;
+		}
+		if(i+4>len)
+			return false;
+		int segmentLen=(inData[i+2]<<8) | inData[i+3];
+		//Start of frame markers, but not the huffman and arithmetic coding tables
+		if(marker>=0xc0 && marker<=0xcf && marker!=0xc4 && marker!=0xc8 && marker!=0xcc)
+		{
+			if(i+9>len)
+				return false;
+			*height=(inData[i+5]<<8) | inData[i+6];
+			*width=(inData[i+7]<<8) | inData[i+8];
+			return *width && *height;
+		}
+		//The image data follows the start of scan segment
+		if(marker==0xda)
+			return false;
+		i+=2+segmentLen;
+	}
+	return false;
+}
+
+bool ImageDecoder::getPNGSize(const uint8_t* inData, int len, uint32_t* width, uint32_t* height)
+{
+	//The IHDR chunk must be the first one, after the 8 bytes of the signature
+	if(len<24 || memcmp(inData+12, "IHDR", 4)!=0)
+		return false;
+	*width=(inData[16]<<24) | (inData[17]<<16) | (inData[18]<<8) | inData[19];
+	*height=(inData[20]<<24) | (inData[21]<<16) | (inData[22]<<8) | inData[23];
+	return *width && *height && int32_t(*width)>0 && int32_t(*height)>0;
+}
+
 uint8_t* ImageDecoder::decodePalette(uint8_t* pixels, uint32_t width, uint32_t height, uint32_t stride, uint8_t* palette, unsigned int numColors, unsigned int paletteBPP)
 {
 	if (numColors == 0)
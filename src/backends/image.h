@@ -46,6 +46,12 @@ public:
 	static uint8_t* decodeJPEG(std::istream& str, uint32_t* width, uint32_t* height, bool* hasAlpha);
 	static uint8_t* decodePNG(uint8_t* inData, int len, uint32_t* width, uint32_t* height, bool *hasAlpha);
 	static uint8_t* decodePNG(std::istream& str, uint32_t* width, uint32_t* height, bool *hasAlpha);
+	/*
+	 * Read the size of the image from the headers, without decoding it.
+	 * Return false if the headers could not be parsed
+	 */
+	static bool getJPEGSize(const uint8_t* inData, int len, uint32_t* width, uint32_t* height);
+	static bool getPNGSize(const uint8_t* inData, int len, uint32_t* width, uint32_t* height);
 	/* Convert paletted image into new[]'ed 24bit RGB image.
 	 * pixels array contains indexes to the palette, 1 byte per
 	 * index. Palette has numColors RGB(A) values, paletteBPP (==
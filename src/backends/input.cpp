@@ -23,6 +23,7 @@
 #include "backends/rendering.h"
 #include "compat.h"
 #include "scripting/class.h"
+#include "tracing.h"
 #include <algorithm>
 
 #include <SDL2/SDL_keyboard.h>
@@ -502,6 +503,14 @@ bool InputThread::handleKeyboardShortcuts(const SDL_KeyboardEvent *keyevent)
 				m_sys->getRenderThread()->screenshotneeded=true;
 			}
 			break;
+		case SDLK_t:
+			// write the frame timeline recorded until now
+			handled = true;
+			if (Tracer::isEnabled())
+				Tracer::write(m_sys);
+			else
+				LOG(LOG_INFO, "Tracing is not enabled, use --trace-output");
+			break;
 #ifndef NDEBUG
 		case SDLK_l:
 			// switch between log levels LOG_CALLS and LOG_INFO
@@ -26,6 +26,7 @@
 #include "backends/netutils.h"
 #include "backends/rtmputils.h"
 #include "backends/streamcache.h"
+#include "backends/contentcache.h"
 #include "compat.h"
 #include <string>
 #include <algorithm>
@@ -148,14 +149,18 @@ bool DownloadManager::removeDownloader(Downloader* downloader)
  * The standalone download manager produces \c ThreadedDownloader-type \c Downloaders.
  * It should only be used in the standalone version of LS.
  */
-StandaloneDownloadManager::StandaloneDownloadManager()
+StandaloneDownloadManager::StandaloneDownloadManager():curlEngine(nullptr)
 {
 	type = STANDALONE;
+#ifdef ENABLE_CURL
+	curlEngine = new CurlMultiEngine();
+#endif
 }
 
 StandaloneDownloadManager::~StandaloneDownloadManager()
 {
 	cleanUp();
+	delete curlEngine;
 }
 
 /**
@@ -192,7 +197,41 @@ Downloader* StandaloneDownloadManager::download(const URLInfo& url, _R<StreamCac
 	else
 	{
 		LOG(LOG_INFO, _("NET: STANDALONE: DownloadManager: remote file"));
-		downloader=new CurlDownloader(url.getParsedURL(), cache, owner);
+		ContentCache* contentCache=ContentCache::getContentCache();
+		_NR<ContentCacheEntry> entry;
+		std::map<tiny_string, tiny_string> requestHeaders;
+		if(contentCache && (url.getProtocol() == "http" || url.getProtocol() == "https"))
+		{
+			requestHeaders=CurlDownloader::getRequestHeaders(url.getParsedURL());
+			entry=contentCache->lookup(url.getParsedURL(), requestHeaders);
+		}
+		if(!entry.isNull() && contentCache->canServeWithoutRevalidation(entry))
+		{
+			//The readers are created as soon as we return, so the data must be mapped now
+			MappedFile* mapped=contentCache->open(entry);
+			if(mapped)
+			{
+				LOG(LOG_INFO, _("NET: STANDALONE: DownloadManager: serving from the content cache"));
+				cache->useMappedFile(_MR(mapped));
+				downloader=new ContentCacheDownloader(url.getParsedURL(), cache, entry, owner);
+				downloader->enableFencingWaiting();
+				addDownloader(downloader);
+				getSys()->addDownloadJob(downloader);
+				return downloader;
+			}
+			entry=NullRef;
+		}
+		CurlDownloader* curlDownloader=new CurlDownloader(url.getParsedURL(), cache, owner);
+		if(contentCache && (url.getProtocol() == "http" || url.getProtocol() == "https"))
+			curlDownloader->enableContentCache(!entry.isNull() && entry->hasValidators() ? entry : NullRef, requestHeaders);
+		if(curlEngine)
+		{
+			curlDownloader->enableFencingWaiting();
+			addDownloader(curlDownloader);
+			curlEngine->addDownloader(curlDownloader);
+			return curlDownloader;
+		}
+		downloader=curlDownloader;
 	}
 	downloader->enableFencingWaiting();
 	addDownloader(downloader);
@@ -226,7 +265,15 @@ Downloader* StandaloneDownloadManager::downloadWithData(const URLInfo& url, _R<S
 	else
 	{
 		LOG(LOG_INFO, _("NET: STANDALONE: DownloadManager: remote file"));
-		downloader=new CurlDownloader(url.getParsedURL(), cache, data, headers, owner);
+		CurlDownloader* curlDownloader=new CurlDownloader(url.getParsedURL(), cache, data, headers, owner);
+		if(curlEngine)
+		{
+			curlDownloader->enableFencingWaiting();
+			addDownloader(curlDownloader);
+			curlEngine->addDownloader(curlDownloader);
+			return curlDownloader;
+		}
+		downloader=curlDownloader;
 	}
 	downloader->enableFencingWaiting();
 	addDownloader(downloader);
@@ -247,7 +294,8 @@ Downloader::Downloader(const tiny_string& _url, _R<StreamCache> _cache, ILoadabl
 	owner(o),                                                     //PROGRESS
 	redirected(false),requestStatus(0),                           //HTTP REDIR, STATUS & HEADERS
 	length(0),                                                    //DOWNLOADED DATA
-	emptyanswer(false)
+	emptyanswer(false),
+	downloadPriority(o ? o->getDownloadPriority() : DOWNLOAD_PRIORITY_NORMAL)
 {
 }
 
@@ -264,7 +312,8 @@ Downloader::Downloader(const tiny_string& _url, _R<StreamCache> _cache, const st
 	owner(o),                                                        //PROGRESS
 	redirected(false),requestStatus(0),requestHeaders(h),data(_data),//HTTP REDIR, STATUS & HEADERS
 	length(0),                                                       //DOWNLOADED DATA
-	emptyanswer(false)
+	emptyanswer(false),
+	downloadPriority(o ? o->getDownloadPriority() : DOWNLOAD_PRIORITY_NORMAL)
 {
 }
 
@@ -539,7 +588,7 @@ ThreadedDownloader::~ThreadedDownloader()
  * \param[in] _cached Whether or not to cache this download.
  */
 CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache, ILoadable* o):
-	ThreadedDownloader(_url, _cache, o)
+	ThreadedDownloader(_url, _cache, o),useContentCache(false),cacheWriter(NULL)
 {
 }
 
@@ -552,8 +601,49 @@ CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache,
 CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache,
 			       const std::vector<uint8_t>& _data,
 			       const std::list<tiny_string>& _headers, ILoadable* o):
-	ThreadedDownloader(_url, _cache, _data, _headers, o)
+	ThreadedDownloader(_url, _cache, _data, _headers, o),useContentCache(false),cacheWriter(NULL)
+{
+}
+
+CurlDownloader::~CurlDownloader()
+{
+	//The transfer did not finish, the partial response is discarded
+	delete cacheWriter;
+}
+
+/**
+ * \brief Stores the response of this download in the content cache
+ *
+ * Must be called before the download is started.
+ * \param[in] entry The stale cached copy of the response, it is revalidated with the server
+ * and served if the server answers 304 Not Modified.
+ * \param[in] requestHeaders The headers sent with the request, as returned by \c getRequestHeaders
+ */
+void CurlDownloader::enableContentCache(_NR<ContentCacheEntry> entry, const std::map<tiny_string, tiny_string>& requestHeaders)
+{
+	useContentCache=true;
+	cachedEntry=entry;
+	cacheRequestHeaders=requestHeaders;
+}
+
+/**
+ * \brief Returns the headers \c setupHandle sends with a GET request
+ *
+ * Used to find and store the variant of a response in the content cache.
+ * Accept-Encoding is set by CURL to the encodings it supports, which do not change
+ * between requests, so it is stored with the empty value we pass to CURL.
+ * \param[in] url The URL of the request
+ * \return The headers, names in lower case
+ */
+std::map<tiny_string, tiny_string> CurlDownloader::getRequestHeaders(const tiny_string& url)
 {
+	std::map<tiny_string, tiny_string> ret;
+	ret["user-agent"]="Mozilla/5.0";
+	ret["accept-encoding"]="";
+	if (URLInfo(url).sameHost(getSys()->mainClip->getOrigin()) &&
+	    !getSys()->getCookies().empty())
+		ret["cookie"]=getSys()->getCookies();
+	return ret;
 }
 
 /**
@@ -566,6 +656,84 @@ void CurlDownloader::threadAbort()
 	Downloader::stop();
 }
 
+/**
+ * \brief Configures a CURL easy handle for this download
+ *
+ * Sets the URL, the callbacks, the cookies and the data to send to the host.
+ * \return The list of request headers, to be freed with \c curl_slist_free_all after the transfer
+ */
+struct curl_slist* CurlDownloader::setupHandle(void* curl)
+{
+	struct curl_slist *headerList=NULL;
+#ifdef ENABLE_CURL
+	curl_easy_setopt(curl, CURLOPT_URL, url.raw_buf());
+	//Needed for thread-safety reasons.
+	//This makes CURL not respect DNS resolving timeouts.
+	//TODO: openssl needs locking callbacks. We should implement these.
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
+	//ALlow self-signed and incorrect certificates.
+	//TODO: decide if we should allow them.
+	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
+	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_header);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+	curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, progress_callback);
+	curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, this);
+	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0);
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+	//Its probably a good idea to limit redirections, 100 should be more than enough
+	curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 100);
+	curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0");
+	// Empty string means that CURL will decompress if the
+	// server send a compressed file. (This has been
+	// renamed to CURLOPT_ACCEPT_ENCODING in newer CURL,
+	// we use the old name to support the old versions.)
+	curl_easy_setopt(curl, CURLOPT_ENCODING, "");
+	if (URLInfo(url).sameHost(getSys()->mainClip->getOrigin()) &&
+	    !getSys()->getCookies().empty())
+		curl_easy_setopt(curl, CURLOPT_COOKIE, getSys()->getCookies().c_str());
+
+	if(!cachedEntry.isNull())
+	{
+		//The server answers 304 if our copy is still valid
+		if(!cachedEntry->etag.empty())
+			headerList=curl_slist_append(headerList, (std::string("If-None-Match: ")+cachedEntry->etag.raw_buf()).c_str());
+		if(!cachedEntry->lastModified.empty())
+			headerList=curl_slist_append(headerList, (std::string("If-Modified-Since: ")+cachedEntry->lastModified.raw_buf()).c_str());
+	}
+
+	bool hasContentType=false;
+	if(!requestHeaders.empty())
+	{
+		std::list<tiny_string>::const_iterator it;
+		for(it=requestHeaders.begin(); it!=requestHeaders.end(); ++it)
+		{
+			headerList=curl_slist_append(headerList, it->raw_buf());
+			hasContentType |= it->lowercase().startsWith("content-type:");
+		}
+	}
+
+	if(!data.empty())
+	{
+		curl_easy_setopt(curl, CURLOPT_POST, 1);
+		//data is const, it would not be invalidated
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, &data.front());
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data.size());
+
+		//For POST it's mandatory to set the Content-Type
+		assert(hasContentType);
+	}
+
+	if(headerList)
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
+
+	//curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
+#endif
+	return headerList;
+}
+
 /**
  * \brief Called by \c ThreadPool to start executing this thread
  */
@@ -583,86 +751,128 @@ void CurlDownloader::execute()
 	curl = curl_easy_init();
 	if(curl)
 	{
-		curl_easy_setopt(curl, CURLOPT_URL, url.raw_buf());
-		//Needed for thread-safety reasons.
-		//This makes CURL not respect DNS resolving timeouts.
-		//TODO: openssl needs locking callbacks. We should implement these.
-		curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
-		//ALlow self-signed and incorrect certificates.
-		//TODO: decide if we should allow them.
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0);
-		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
-		curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
-		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_header);
-		curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
-		curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, progress_callback);
-		curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, this);
-		curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0);
-		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-		//Its probably a good idea to limit redirections, 100 should be more than enough
-		curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 100);
-		curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0");
-		// Empty string means that CURL will decompress if the
-		// server send a compressed file. (This has been
-		// renamed to CURLOPT_ACCEPT_ENCODING in newer CURL,
-		// we use the old name to support the old versions.)
-		curl_easy_setopt(curl, CURLOPT_ENCODING, "");
-		if (URLInfo(url).sameHost(getSys()->mainClip->getOrigin()) &&
-		    !getSys()->getCookies().empty())
-			curl_easy_setopt(curl, CURLOPT_COOKIE, getSys()->getCookies().c_str());
-
-		struct curl_slist *headerList=NULL;
-		bool hasContentType=false;
-		if(!requestHeaders.empty())
-		{
-			std::list<tiny_string>::const_iterator it;
-			for(it=requestHeaders.begin(); it!=requestHeaders.end(); ++it)
-			{
-				headerList=curl_slist_append(headerList, it->raw_buf());
-				hasContentType |= it->lowercase().startsWith("content-type:");
-			}
-		}
-
-		if(!data.empty())
-		{
-			curl_easy_setopt(curl, CURLOPT_POST, 1);
-			//data is const, it would not be invalidated
-			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, &data.front());
-			curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data.size());
-
-			//For POST it's mandatory to set the Content-Type
-			assert(hasContentType);
-		}
-
-		if(headerList)
-			curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
-
-		//curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
+		struct curl_slist *headerList=setupHandle(curl);
 		res = curl_easy_perform(curl);
 
 		curl_slist_free_all(headerList);
 
 		curl_easy_cleanup(curl);
-		if(res!=0)
+		transferFinished(res!=0);
+	}
+	else
+		setFailed();
+#else
+	//ENABLE_CURL not defined
+	LOG(LOG_ERROR,_("NET: CURL not enabled in this build. Downloader will always fail."));
+	setFailed();
+#endif
+}
+
+#ifdef ENABLE_CURL
+/**
+ * \brief Ends the download when the transfer is done
+ *
+ * A successful response is stored in the content cache, if it is enabled.
+ * If the server confirmed that the cached copy is still valid the copy is served instead.
+ * \param[in] failed Whether the transfer failed
+ */
+void CurlDownloader::transferFinished(bool failed)
+{
+	if(!failed && !cachedEntry.isNull() && getRequestStatus() == 304)
+	{
+		MappedFile* mapped=ContentCache::getContentCache()->open(_R<ContentCacheEntry>(cachedEntry));
+		if(!mapped)
 		{
 			setFailed();
 			return;
 		}
+		LOG(LOG_INFO, _("NET: cached copy revalidated: ") << url);
+		//The headers of the 304 answer take precedence over the stored ones
+		for(auto it=cachedEntry->headers.begin();it!=cachedEntry->headers.end();++it)
+			headers.insert(*it);
+		requestStatus=200;
+		//Readers may already exist, so the data is copied into the StreamCache
+		append((uint8_t*)mapped->getData(), mapped->getLength());
+		mapped->decRef();
+		setFinished();
+		return;
 	}
-	else
+	if(cacheWriter)
 	{
+		if(!failed && !hasFailed())
+			ContentCache::getContentCache()->commit(cacheWriter, findHeader("etag"), findHeader("last-modified"),
+								getContentCacheExpiry(), headers, cacheRequestHeaders);
+		else
+			delete cacheWriter;
+		cacheWriter=NULL;
+	}
+	if(failed)
 		setFailed();
-		return;
+	else
+	{
+		//Notify the downloader no more data should be expected
+		setFinished();
 	}
-#else
-	//ENABLE_CURL not defined
-	LOG(LOG_ERROR,_("NET: CURL not enabled in this build. Downloader will always fail."));
-	setFailed();
-	return;
+}
+
+/**
+ * \brief Computes until when a response can be used without revalidation
+ *
+ * Uses Cache-Control max-age, or Expires, or 10% of the time since the last modification
+ * as a heuristic, in this order.
+ * \return The expiry time in seconds since the epoch
+ */
+int64_t CurlDownloader::getContentCacheExpiry() const
+{
+	int64_t now=g_get_real_time()/1000000;
+	tiny_string cacheControl=findHeader("cache-control").lowercase();
+	if(cacheControl.find("no-cache") != tiny_string::npos || cacheControl.find("must-revalidate") != tiny_string::npos)
+		return now;
+	uint32_t maxAge=cacheControl.find("max-age=");
+	if(maxAge != tiny_string::npos)
+		return now+atoll(cacheControl.raw_buf()+maxAge+8);
+	tiny_string expires=findHeader("expires");
+	if(!expires.empty())
+	{
+		int64_t t=curl_getdate(expires.raw_buf(), NULL);
+		return t == -1 ? now : t;
+	}
+	tiny_string lastModified=findHeader("last-modified");
+	if(!lastModified.empty())
+	{
+		int64_t modified=curl_getdate(lastModified.raw_buf(), NULL);
+		tiny_string date=findHeader("date");
+		int64_t served=date.empty() ? now : curl_getdate(date.raw_buf(), NULL);
+		if(modified != -1 && served != -1 && served > modified)
+			return now+(served-modified)/10;
+	}
+	return now;
+}
 #endif
-	//Notify the downloader no more data should be expected
-	setFinished();
+
+/**
+ * \brief Tees the response body to the content cache
+ *
+ * The writer is created with the first data, when all the headers are known.
+ */
+void CurlDownloader::writeToContentCache(const unsigned char* buffer, size_t length)
+{
+	if(!cacheWriter)
+	{
+		if(!useContentCache)
+			return;
+		//Only try once per download
+		useContentCache=false;
+		//Private responses are meant for one user, they are not stored in the shared cache
+		tiny_string cacheControl=findHeader("cache-control").lowercase();
+		if(cacheControl.find("no-store") != tiny_string::npos || cacheControl.find("private") != tiny_string::npos ||
+		   findHeader("vary").find("*") != tiny_string::npos)
+			return;
+		cacheWriter=ContentCache::getContentCache()->createWriter(originalURL);
+		if(!cacheWriter)
+			return;
+	}
+	cacheWriter->write(buffer, length);
 }
 
 /**
@@ -688,6 +898,8 @@ size_t CurlDownloader::write_data(void *buffer, size_t size, size_t nmemb, void
 	size_t added=size*nmemb;
 	if(th->getRequestStatus()/100 == 2 || th->getRequestStatus()/100 == 3)
 		th->append((uint8_t*)buffer,added);
+	if(th->getRequestStatus() == 200)
+		th->writeToContentCache((unsigned char*)buffer,added);
 	return added;
 }
 
@@ -711,6 +923,280 @@ size_t CurlDownloader::write_header(void *buffer, size_t size, size_t nmemb, voi
 	return size*nmemb;
 }
 
+#ifdef ENABLE_CURL
+CurlMultiEngine::CurlMultiEngine():started(false),stopping(false),fenceState(false),
+	completedTransfers(0),failedTransfers(0),receivedBytes(0),activeTime(0),totalTimeToFirstByte(0),maxTimeToFirstByte(0)
+{
+	multi=curl_multi_init();
+	//Keep the connections of all running transfers open for reuse
+	curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)CURLMULTI_MAX_TRANSFERS);
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	//Transfers to HTTP/2 hosts can share a single connection
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+#endif
+}
+
+/**
+ * \brief Destructor for the CurlMultiEngine class
+ *
+ * Waits until the thread pool has fenced the engine, all the downloaders are fenced by then.
+ */
+CurlMultiEngine::~CurlMultiEngine()
+{
+	while(ACQUIRE_READ(fenceState));
+	curl_multi_cleanup(multi);
+}
+
+/**
+ * \brief Queues a downloader, the transfer is started by the engine thread
+ *
+ * The engine is added to the download thread pool with the first downloader.
+ * If the engine is already stopped the downloader fails immediately.
+ */
+void CurlMultiEngine::addDownloader(CurlDownloader* d)
+{
+	mutex.lock();
+	if(ACQUIRE_READ(stopping))
+	{
+		mutex.unlock();
+		d->setFailed();
+		d->jobFence();
+		return;
+	}
+	incoming.push_back(d);
+	bool start=!started;
+	started=true;
+	if(start)
+		RELEASE_WRITE(fenceState,true);
+	mutex.unlock();
+	//The thread pool fences the job immediately if it is stopping, so it must not be added with the mutex held
+	if(start)
+		getSys()->addDownloadJob(this);
+	else
+	{
+#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_wakeup(multi);
+#endif
+	}
+}
+
+void CurlMultiEngine::acceptIncoming()
+{
+	std::list<CurlDownloader*> added;
+	mutex.lock();
+	added.swap(incoming);
+	mutex.unlock();
+	for(auto it=added.begin();it!=added.end();++it)
+	{
+		URLInfo u((*it)->getURL());
+		Transfer t;
+		t.downloader=*it;
+		t.handle=nullptr;
+		t.headerList=nullptr;
+		t.host=std::string(u.getHostname())+":"+std::to_string(u.getPort());
+		t.queuedTime=g_get_monotonic_time();
+		t.startTime=0;
+		queued[t.downloader->getDownloadPriority()].push_back(t);
+	}
+}
+
+/**
+ * \brief Starts the queued transfers, by priority, as long as the host and global limits allow it
+ */
+void CurlMultiEngine::startTransfers()
+{
+	for(uint32_t p=0;p<DOWNLOAD_PRIORITY_COUNT;p++)
+	{
+		auto it=queued[p].begin();
+		while(it!=queued[p].end())
+		{
+			CurlDownloader* d=it->downloader;
+			if(d->hasFinished() || d->url.empty())
+			{
+				//Stopped before it could start
+				d->setFailed();
+				d->jobFence();
+				it=queued[p].erase(it);
+				continue;
+			}
+			if(running.size()>=CURLMULTI_MAX_TRANSFERS)
+				return;
+			if(hostTransfers[it->host]>=CURLMULTI_MAX_HOST_TRANSFERS)
+			{
+				++it;
+				continue;
+			}
+			LOG(LOG_INFO, _("NET: CurlMultiEngine: reading remote file: ") << d->url.raw_buf());
+			CURL* curl=curl_easy_init();
+			if(!curl)
+			{
+				d->setFailed();
+				d->jobFence();
+				it=queued[p].erase(it);
+				continue;
+			}
+			it->handle=curl;
+			it->headerList=d->setupHandle(curl);
+			it->startTime=g_get_monotonic_time();
+			hostTransfers[it->host]++;
+			curl_multi_add_handle(multi,curl);
+			running.insert(std::make_pair((void*)curl,*it));
+			it=queued[p].erase(it);
+		}
+	}
+}
+
+/**
+ * \brief Releases the CURL handle of a transfer and notifies the downloader
+ *
+ * The downloader is fenced, so it may be destroyed as soon as this returns.
+ */
+void CurlMultiEngine::endTransfer(Transfer& t, bool failed)
+{
+	curl_multi_remove_handle(multi,t.handle);
+	curl_easy_cleanup(t.handle);
+	curl_slist_free_all(t.headerList);
+	auto host=hostTransfers.find(t.host);
+	if(host!=hostTransfers.end() && --(host->second)==0)
+		hostTransfers.erase(host);
+	if(failed)
+		failedTransfers++;
+	else
+		completedTransfers++;
+	t.downloader->transferFinished(failed);
+	t.downloader->jobFence();
+}
+
+void CurlMultiEngine::finishTransfers()
+{
+	CURLMsg* msg;
+	int left;
+	while((msg=curl_multi_info_read(multi,&left)))
+	{
+		if(msg->msg!=CURLMSG_DONE)
+			continue;
+		auto it=running.find(msg->easy_handle);
+		assert(it!=running.end());
+		//msg is not valid anymore after the handle has been removed
+		CURLcode res=msg->data.result;
+		if(res==CURLE_OK)
+		{
+			double startTransfer=0;
+			curl_easy_getinfo(it->second.handle, CURLINFO_STARTTRANSFER_TIME, &startTransfer);
+			//The time spent in the queue is part of the time to first byte
+			int64_t ttfb=it->second.startTime-it->second.queuedTime+int64_t(startTransfer*1000000);
+			totalTimeToFirstByte+=ttfb;
+			if(ttfb>maxTimeToFirstByte)
+				maxTimeToFirstByte=ttfb;
+			receivedBytes+=it->second.downloader->getReceivedLength();
+		}
+		endTransfer(it->second,res!=CURLE_OK);
+		running.erase(it);
+	}
+}
+
+/**
+ * \brief Called by \c ThreadPool to run the event loop until the engine is aborted
+ */
+void CurlMultiEngine::execute()
+{
+	int64_t lastTime=g_get_monotonic_time();
+	while(!ACQUIRE_READ(stopping))
+	{
+		acceptIncoming();
+		startTransfers();
+		int runningHandles;
+		curl_multi_perform(multi,&runningHandles);
+		finishTransfers();
+		//Use the slots freed by the finished transfers before sleeping
+		startTransfers();
+#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_poll(multi,nullptr,0,CURLMULTI_POLL_TIMEOUT,nullptr);
+#else
+		curl_multi_wait(multi,nullptr,0,CURLMULTI_POLL_TIMEOUT,nullptr);
+#endif
+		int64_t now=g_get_monotonic_time();
+		if(!running.empty())
+			activeTime+=now-lastTime;
+		lastTime=now;
+	}
+}
+
+/**
+ * \brief Called by \c ThreadPool::forceStop to end the event loop
+ */
+void CurlMultiEngine::threadAbort()
+{
+	RELEASE_WRITE(stopping,true);
+#if LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup(multi);
+#endif
+}
+
+/**
+ * \brief The jobFence for CurlMultiEngine
+ *
+ * Fails and fences all the downloaders that did not finish, as no transfer can be run anymore.
+ */
+void CurlMultiEngine::jobFence()
+{
+	mutex.lock();
+	RELEASE_WRITE(stopping,true);
+	mutex.unlock();
+	acceptIncoming();
+	for(uint32_t p=0;p<DOWNLOAD_PRIORITY_COUNT;p++)
+	{
+		for(auto it=queued[p].begin();it!=queued[p].end();++it)
+		{
+			it->downloader->setFailed();
+			it->downloader->jobFence();
+		}
+		queued[p].clear();
+	}
+	for(auto it=running.begin();it!=running.end();++it)
+		endTransfer(it->second,true);
+	running.clear();
+	LOG(LOG_INFO,"CurlMultiEngine: "<<completedTransfers<<" transfers completed, "<<failedTransfers<<" failed, "
+		<<receivedBytes<<" bytes received at "<<(activeTime ? receivedBytes*1000000/activeTime/1024 : 0)<<" KiB/s, "
+		<<"time to first byte "<<(completedTransfers ? totalTimeToFirstByte/completedTransfers/1000 : 0)<<" ms average, "
+		<<maxTimeToFirstByte/1000<<" ms max");
+	RELEASE_WRITE(fenceState,false);
+}
+#endif
+
+/**
+ * \brief Constructor for the ContentCacheDownloader class
+ *
+ * \param[in] _url The URL for the Downloader.
+ * \param[in] _cache The StreamCache, the data of the entry must already be mapped in it.
+ * \param[in] entry The content cache entry served by this downloader.
+ */
+ContentCacheDownloader::ContentCacheDownloader(const tiny_string& _url, _R<StreamCache> _cache, _R<ContentCacheEntry> entry, ILoadable* o):
+	ThreadedDownloader(_url, _cache, o)
+{
+	requestStatus=200;
+	headers=entry->headers;
+	length=entry->size;
+}
+
+void ContentCacheDownloader::threadAbort()
+{
+	Downloader::stop();
+}
+
+/**
+ * \brief Called by \c ThreadPool to notify the owner and finish the download
+ */
+void ContentCacheDownloader::execute()
+{
+	if(cache->getNotifyLoader())
+	{
+		notifyOwnerAboutBytesTotal();
+		notifyOwnerAboutBytesLoaded();
+	}
+	setFinished();
+}
+
 /**
  * \brief Constructor for the LocalDownloader class
  *
@@ -30,12 +30,18 @@
 #include "thread_pool.h"
 #include "backends/urlutils.h"
 #include "backends/streamcache.h"
+#include "backends/contentcache.h"
 #include "smartrefs.h"
 
+struct curl_slist;
+
 namespace lightspark
 {
 
 class Downloader;
+class CurlMultiEngine;
+
+enum DOWNLOAD_PRIORITY { DOWNLOAD_PRIORITY_HIGH=0, DOWNLOAD_PRIORITY_NORMAL, DOWNLOAD_PRIORITY_LOW, DOWNLOAD_PRIORITY_COUNT };
 
 class ILoadable
 {
@@ -44,6 +50,11 @@ protected:
 public:
 	virtual void setBytesTotal(uint32_t b) = 0;
 	virtual void setBytesLoaded(uint32_t b) = 0;
+	/*
+	 * Used by the download manager to order the transfers waiting for a connection.
+	 * Small data files usually block the application, big media files can wait.
+	 */
+	virtual DOWNLOAD_PRIORITY getDownloadPriority() const { return DOWNLOAD_PRIORITY_NORMAL; }
 };
 
 class DLL_PUBLIC DownloadManager
@@ -71,6 +82,9 @@ public:
 
 class DLL_PUBLIC StandaloneDownloadManager:public DownloadManager
 {
+private:
+	//Drives all the remote downloads, only available if CURL is enabled
+	CurlMultiEngine* curlEngine;
 public:
 	StandaloneDownloadManager();
 	~StandaloneDownloadManager();
@@ -118,6 +132,12 @@ protected:
 	std::map<tiny_string, tiny_string> headers;
 	void parseHeaders(const char* headers, bool _setLength);
 	void parseHeader(std::string header, bool _setLength);
+	//Unlike getHeader, does not add the header if it was not received
+	tiny_string findHeader(const char* header) const
+	{
+		auto it=headers.find(header);
+		return it==headers.end() ? tiny_string() : it->second;
+	}
 	//Data to send to the host
 	const std::list<tiny_string> requestHeaders;
 	const std::vector<uint8_t> data;
@@ -129,6 +149,7 @@ protected:
 	void setLength(uint32_t _length);
 	
 	bool emptyanswer;
+	DOWNLOAD_PRIORITY downloadPriority;
 public:
 	//This class can only get destroyed by DownloadManager derivate classes
 	virtual ~Downloader();
@@ -166,6 +187,7 @@ public:
 	bool isRedirected() { return redirected; }
 	const tiny_string& getOriginalURL() { return originalURL; }
 	uint16_t getRequestStatus() { return requestStatus; }
+	DOWNLOAD_PRIORITY getDownloadPriority() const { return downloadPriority; }
 	//Append data to the internal buffer
 	void append(uint8_t* buffer, uint32_t length);
 };
@@ -177,6 +199,7 @@ private:
 public:
 	void enableFencingWaiting();
 	void jobFence();
+	JOB_PRIORITY getPriority() const override { return JOB_PRIORITY_NETWORK; }
 	void waitFencing();
 protected:
 	//Abstract base class, can not be constructed
@@ -188,10 +211,27 @@ protected:
 //	virtual ~ThreadedDownloader();
 };
 
-//CurlDownloader can be used as a thread job, standalone or as a streambuf
+//CurlDownloader can be used as a thread job, standalone or as a streambuf,
+//or be driven by a CurlMultiEngine
 class CurlDownloader: public ThreadedDownloader
 {
+friend class CurlMultiEngine;
 private:
+	//-- CONTENT CACHE
+	//Store a successful response in the content cache
+	bool useContentCache;
+	//The stale copy to revalidate with the server, if any
+	_NR<ContentCacheEntry> cachedEntry;
+	//The headers sent with the request, to store the values of the Vary'd ones
+	std::map<tiny_string, tiny_string> cacheRequestHeaders;
+	ContentCacheWriter* cacheWriter;
+	void writeToContentCache(const unsigned char* buffer, size_t length);
+	//Returns the time until the response can be used without revalidation, from the response headers
+	int64_t getContentCacheExpiry() const;
+	//Called when the transfer ended, stores the response or serves the revalidated copy
+	void transferFinished(bool failed);
+	//Configures a CURL easy handle for this download, the returned list must be freed after the transfer
+	struct curl_slist* setupHandle(void* curl);
 	static size_t write_data(void *buffer, size_t size, size_t nmemb, void *userp);
 	static size_t write_header(void *buffer, size_t size, size_t nmemb, void *userp);
 	static int progress_callback(void *clientp, double dltotal, double dlnow, double ultotal, double ulnow);
@@ -201,6 +241,82 @@ public:
 	CurlDownloader(const tiny_string& _url, _R<StreamCache> cache, ILoadable* o);
 	CurlDownloader(const tiny_string& _url, _R<StreamCache> cache, const std::vector<uint8_t>& data,
 		       const std::list<tiny_string>& headers, ILoadable* o);
+	~CurlDownloader();
+	//Store the response in the content cache, entry is the stale copy to revalidate
+	void enableContentCache(_NR<ContentCacheEntry> entry, const std::map<tiny_string, tiny_string>& requestHeaders);
+	//Returns the headers sent with a GET request of the url, names in lower case
+	static std::map<tiny_string, tiny_string> getRequestHeaders(const tiny_string& url);
+};
+
+//ContentCacheDownloader serves a fresh entry of the content cache,
+//the data is mapped in the StreamCache before the job is started
+class ContentCacheDownloader: public ThreadedDownloader
+{
+private:
+	void execute();
+	void threadAbort();
+public:
+	ContentCacheDownloader(const tiny_string& _url, _R<StreamCache> cache, _R<ContentCacheEntry> entry, ILoadable* o);
+};
+
+//Maximum number of transfers running at the same time in a CurlMultiEngine
+#define CURLMULTI_MAX_TRANSFERS 64
+//Maximum number of transfers to the same host and port running at the same time
+#define CURLMULTI_MAX_HOST_TRANSFERS 8
+//Maximum time in milliseconds the engine sleeps without looking for new or stopped downloads
+#define CURLMULTI_POLL_TIMEOUT 100
+
+/*
+ * Runs all the CurlDownloaders of a download manager from a single event loop,
+ * instead of blocking a pool thread for each of them.
+ * All transfers share the connection cache of one curl_multi handle, so connections
+ * are reused. At most CURLMULTI_MAX_HOST_TRANSFERS transfers are started per host,
+ * the other ones are queued and started by the priority of their owner.
+ * The engine is a job of the download thread pool, started with the first download.
+ */
+class CurlMultiEngine: public IThreadJob
+{
+private:
+	struct Transfer
+	{
+		CurlDownloader* downloader;
+		void* handle;
+		struct curl_slist* headerList;
+		std::string host;
+		int64_t queuedTime;
+		int64_t startTime;
+	};
+	void* multi;
+	Mutex mutex;
+	//Downloads added by other threads, protected by the mutex
+	std::list<CurlDownloader*> incoming;
+	bool started;
+	ACQUIRE_RELEASE_FLAG(stopping);
+	ACQUIRE_RELEASE_FLAG(fenceState);
+	//Only accessed by the engine
+	std::list<Transfer> queued[DOWNLOAD_PRIORITY_COUNT];
+	std::map<void*, Transfer> running;
+	std::map<std::string, uint32_t> hostTransfers;
+	//Statistics
+	uint32_t completedTransfers;
+	uint32_t failedTransfers;
+	uint64_t receivedBytes;
+	int64_t activeTime;
+	int64_t totalTimeToFirstByte;
+	int64_t maxTimeToFirstByte;
+	void acceptIncoming();
+	void startTransfers();
+	void finishTransfers();
+	void endTransfer(Transfer& t, bool failed);
+public:
+	CurlMultiEngine();
+	~CurlMultiEngine();
+	//Can be called from any thread
+	void addDownloader(CurlDownloader* d);
+	void execute();
+	void threadAbort();
+	void jobFence();
+	JOB_PRIORITY getPriority() const override { return JOB_PRIORITY_NETWORK; }
 };
 
 //LocalDownloader can be used as a thread job, standalone or as a streambuf
@@ -252,6 +368,7 @@ public:
 	DownloaderThreadBase(_NR<URLRequest> request, IDownloaderThreadListener* listener);
 	void execute()=0;
 	void threadAbort();
+	JOB_PRIORITY getPriority() const override { return JOB_PRIORITY_NETWORK; }
 };
 
 };
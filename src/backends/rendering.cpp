@@ -23,6 +23,7 @@
 #include "backends/rendering.h"
 #include "backends/input.h"
 #include "compat.h"
+#include "tracing.h"
 #include <sstream>
 #include <unistd.h>
 
@@ -115,6 +116,7 @@ void RenderThread::finalizeUpload()
 
 void RenderThread::handleUpload()
 {
+	LS_TRACE_SCOPE("render","upload");
 	ITextureUploadable* u=getUploadJob();
 	assert(u);
 	uint32_t w,h;
@@ -157,6 +159,7 @@ int RenderThread::worker(void* d)
 	setTLSSys(th->m_sys);
 	/* set TLS variable for getRenderThread() */
 	tls_set(renderThread, th);
+	Tracer::setThreadName("Render");
 
 	ThreadProfile* profile=th->m_sys->allocateProfiler(RGB(200,0,0));
 	profile->setTag("Render");
@@ -204,6 +207,7 @@ bool RenderThread::doRender(ThreadProfile* profile,Chronometer* chronometer)
 	event.wait();
 	if(m_sys->isShuttingDown())
 		return false;
+	LS_TRACE_SCOPE("render","doRender");
 	if (chronometer)
 		chronometer->checkpoint();
 
@@ -87,6 +87,73 @@ void StreamCache::append(const unsigned char* buffer, size_t length)
 	}
 }
 
+MappedFile* MappedFile::open(const tiny_string& filename)
+{
+	GError* error=NULL;
+	GMappedFile* f=g_mapped_file_new(filename.raw_buf(), FALSE, &error);
+	if (!f)
+	{
+		LOG(LOG_ERROR, "could not map file " << filename << ": " << error->message);
+		g_error_free(error);
+		return NULL;
+	}
+	return new MappedFile(f);
+}
+
+MappedFile::~MappedFile()
+{
+	g_mapped_file_unref(file);
+}
+
+const unsigned char* MappedFile::getData() const
+{
+	return (const unsigned char*)g_mapped_file_get_contents(file);
+}
+
+size_t MappedFile::getLength() const
+{
+	return g_mapped_file_get_length(file);
+}
+
+void StreamCache::useMappedFile(_R<MappedFile> f)
+{
+	mappedFile = f;
+	stateMutex.lock();
+	receivedLength = f->getLength();
+	stateMutex.unlock();
+}
+
+StreamCache::MappedReader::MappedReader(_R<MappedFile> f) : file(f)
+{
+	char* data=(char*)file->getData();
+	setg(data, data, data+file->getLength());
+}
+
+streampos StreamCache::MappedReader::seekoff(streamoff off, std::ios_base::seekdir dir,
+					     std::ios_base::openmode mode)
+{
+	if (mode != std::ios_base::in)
+		return -1;
+
+	streamoff pos;
+	if (dir == std::ios_base::beg)
+		pos = off;
+	else if (dir == std::ios_base::cur)
+		pos = gptr() - eback() + off;
+	else
+		pos = egptr() - eback() + off;
+	return seekpos(pos, mode);
+}
+
+streampos StreamCache::MappedReader::seekpos(streampos pos, std::ios_base::openmode mode)
+{
+	if (mode != std::ios_base::in || pos < 0 || pos > egptr() - eback())
+		return -1;
+
+	setg(eback(), eback() + pos, egptr());
+	return pos;
+}
+
 class lightspark::MemoryChunk {
 public:
 	MemoryChunk(size_t len);
@@ -184,6 +251,9 @@ void MemoryStreamCache::reserve(size_t expectedLength)
 
 std::streambuf *MemoryStreamCache::createReader()
 {
+	if (!mappedFile.isNull())
+		return new MappedReader(mappedFile);
+
 	incRef();
 	return new MemoryStreamCache::Reader(_MR(this));
 }
@@ -477,6 +547,9 @@ bool FileStreamCache::waitForCache()
 
 std::streambuf *FileStreamCache::createReader()
 {
+	if (!mappedFile.isNull())
+		return new MappedReader(mappedFile);
+
 	if (!waitForCache())
 	{
 		LOG(LOG_ERROR,"could not open cache file");
@@ -30,10 +30,26 @@
 #include "compat.h"
 
 struct SDL_RWops;
+typedef struct _GMappedFile GMappedFile;
 
 namespace lightspark
 {
 
+/*
+ * A read only memory mapping of a whole file
+ */
+class DLL_PUBLIC MappedFile : public RefCountable {
+private:
+	GMappedFile* file;
+	MappedFile(GMappedFile* f):file(f) {}
+public:
+	~MappedFile();
+	// returns NULL if the file can not be mapped
+	static MappedFile* open(const tiny_string& filename);
+	const unsigned char* getData() const;
+	size_t getLength() const;
+};
+
 /*
  * A single-writer-multiple-reader buffer for downloaded streams.
  *
@@ -58,6 +74,20 @@ protected:
 	bool terminated:1;
 	bool notifyLoader:1;
 	SystemState* sys;
+	// Set if the whole stream is served from a mapped file
+	_NR<MappedFile> mappedFile;
+
+	/*
+	 * Reads directly from the mapped file, no data is copied
+	 */
+	class DLL_LOCAL MappedReader : public std::streambuf {
+	private:
+		_R<MappedFile> file;
+		std::streampos seekoff(std::streamoff, std::ios_base::seekdir, std::ios_base::openmode) override;
+		std::streampos seekpos(std::streampos, std::ios_base::openmode) override;
+	public:
+		MappedReader(_R<MappedFile> f);
+	};
 
 	// Wait until more than currentOffset bytes has been received
 	// or until terminated
@@ -98,6 +128,11 @@ public:
 	// thread). Every call returns a new, independent streambuf.
 	// The caller must delete the returned value.
 	virtual std::streambuf *createReader()=0;
+
+	// Use a mapped file as the complete stream, it is read without copying.
+	// Must be called before append() and createReader(), the stream must
+	// still be finished with markFinished().
+	void useMappedFile(_R<MappedFile> f);
 	
 	virtual void openForWriting() = 0;
 };
@@ -31,9 +31,11 @@ const pugi::xml_node XMLBase::buildFromString(const tiny_string& str,
 										const tiny_string& default_ns)
 {
 	tiny_string buf = quirkEncodeNull(removeWhitespace(str));
+	//A new document, the nodes of the previous one may still be referenced
+	xmldoc = make_shared<pugi::xml_document>();
 	if (buf.numBytes() > 0 && buf.charAt(0) == '<')
 	{
-		pugi::xml_parse_result res = xmldoc.load_buffer((void*)buf.raw_buf(),buf.numBytes(),xmlparsemode);
+		pugi::xml_parse_result res = xmldoc->load_buffer((void*)buf.raw_buf(),buf.numBytes(),xmlparsemode);
 		switch (res.status)
 		{
 			case pugi::status_ok:
@@ -66,10 +68,10 @@ const pugi::xml_node XMLBase::buildFromString(const tiny_string& str,
 	}
 	else
 	{
-		pugi::xml_node n = xmldoc.append_child(pugi::node_pcdata);
+		pugi::xml_node n = xmldoc->append_child(pugi::node_pcdata);
 		n.set_value(str.raw_buf());
 	}
-	return xmldoc.root();
+	return xmldoc->root();
 }
 const tiny_string XMLBase::encodeToXML(const tiny_string value, bool bIsAttribute)
 {
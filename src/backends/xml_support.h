@@ -21,6 +21,7 @@
 #define BACKENDS_XML_SUPPORT_H 1
 
 #include "tiny_string.h"
+#include <memory>
 #include <3rdparty/pugixml/src/pugixml.hpp>
 namespace lightspark
 {
@@ -32,8 +33,9 @@ namespace lightspark
 class XMLBase
 {
 protected:
-	//The parser will destroy the document and all the childs on destruction
-	pugi::xml_document xmldoc;
+	//The parser will destroy the document and all the childs on destruction,
+	//XML objects created lazily from the document share it
+	std::shared_ptr<pugi::xml_document> xmldoc;
 	const pugi::xml_node buildFromString(const tiny_string& str,
 										unsigned int xmlparsemode,
 										const tiny_string& default_ns=tiny_string());
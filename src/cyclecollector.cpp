@@ -0,0 +1,353 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <climits>
+#include "cyclecollector.h"
+#include "asobject.h"
+#include "logger.h"
+
+using namespace lightspark;
+
+thread_local CycleCollector* RefCountable::threadCycleCollector=nullptr;
+
+void RefCountable::bufferCycleCandidate()
+{
+	//Only ASObjects are cycle collectable
+	cycleCandidate=true;
+	threadCycleCollector->addCandidate(static_cast<ASObject*>(this));
+}
+
+CycleCollector::CycleCollector(MemoryAccount* m):candidates(reporter_allocator<ASObject*>(m)),stopped(false),phase(IDLE),scanRoot(0),restarts(0),
+	collectedObjects(0),collectedBytes(0),totalPauseTime(0),maxPauseTime(0),slices(0),restartedBatches(0)
+{
+}
+
+void CycleCollector::registerThread()
+{
+	RefCountable::threadCycleCollector=this;
+}
+
+void CycleCollector::addCandidate(ASObject* o)
+{
+	if(stopped)
+		return;
+	candidates.push_back(o);
+	o->cycleCandidateIndex=candidates.size();
+}
+
+bool CycleCollector::removeCandidate(ASObject* o)
+{
+	if(o->cycleCandidateIndex==0)
+		return true;
+	if(RefCountable::threadCycleCollector!=this)
+		return false;
+	//Move the last candidate in the free position
+	ASObject* last=candidates.back();
+	candidates[o->cycleCandidateIndex-1]=last;
+	last->cycleCandidateIndex=o->cycleCandidateIndex;
+	candidates.pop_back();
+	o->cycleCandidateIndex=0;
+	return true;
+}
+
+bool CycleCollector::hasCandidates() const
+{
+	return !stopped && (!candidates.empty() || phase!=IDLE);
+}
+
+bool CycleCollector::needsCollection() const
+{
+	return !stopped && candidates.size()>=CYCLECOLLECTOR_CANDIDATES_THRESHOLD;
+}
+
+void CycleCollector::stop()
+{
+	stopped=true;
+	for(auto it=candidates.begin();it!=candidates.end();++it)
+		(*it)->cycleCandidateIndex=0;
+	candidates.clear();
+	clearGraph();
+	for(auto it=roots.begin();it!=roots.end();++it)
+		(*it)->decRef();
+	roots.clear();
+	phase=IDLE;
+}
+
+void CycleCollector::objectsChanged()
+{
+	if(phase==IDLE)
+		return;
+	//The graph may not match the objects anymore, examine the same roots again
+	restarts++;
+	restartedBatches++;
+	clearGraph();
+	buildRootNodes();
+	phase=MARK;
+}
+
+void CycleCollector::collectSlice(uint32_t budget)
+{
+	if(stopped)
+		return;
+	int64_t start=g_get_monotonic_time();
+	int64_t deadline=start+budget;
+	uint64_t collected=collectedObjects;
+	uint64_t bytes=collectedBytes;
+	while(true)
+	{
+		if(phase==IDLE && !startBatch())
+			break;
+		//A batch that was restarted too often is finished in this slice
+		int64_t batchDeadline=restarts>=CYCLECOLLECTOR_MAX_RESTARTS ? INT64_MAX : deadline;
+		if(phase==MARK && !mark(batchDeadline))
+			break;
+		if(phase==SCAN && !scan(batchDeadline))
+			break;
+		if(g_get_monotonic_time()>=deadline)
+			break;
+	}
+	uint32_t pause=g_get_monotonic_time()-start;
+	totalPauseTime+=pause;
+	if(pause>maxPauseTime)
+		maxPauseTime=pause;
+	slices++;
+	if(collectedObjects!=collected)
+		LOG(LOG_INFO,"CycleCollector: collected "<<collectedObjects-collected<<" objects ("<<collectedBytes-bytes<<" bytes) in "<<pause<<" us");
+}
+
+bool CycleCollector::startBatch()
+{
+	while(!candidates.empty() && roots.size()<CYCLECOLLECTOR_BATCH_SIZE)
+	{
+		ASObject* o=candidates.back();
+		candidates.pop_back();
+		o->cycleCandidateIndex=0;
+		//The object is being destructed
+		if(o->getRefCount()<1 || o->getInDestruction())
+			continue;
+		//The flag stays set, so decRef doesn't buffer the object again
+		if(!o->isCycleCollectableKind())
+			continue;
+		if(!o->isCycleCollectable())
+		{
+			//The object can be buffered again by the next decRef
+			o->resetCycleCandidate();
+			continue;
+		}
+		//Keep the root alive while it is examined, it stays flagged until it is released
+		o->incRef();
+		roots.push_back(o);
+	}
+	if(roots.empty())
+		return false;
+	restarts=0;
+	buildRootNodes();
+	phase=MARK;
+	return true;
+}
+
+void CycleCollector::buildRootNodes()
+{
+	for(auto it=roots.begin();it!=roots.end();++it)
+	{
+		ASObject* o=*it;
+		if(!o->isCycleCollectable() || nodeIndex.count(o))
+			continue;
+		nodeIndex[o]=nodes.size();
+		//Do not count the reference we are holding
+		int32_t refCount=o->getRefCount();
+		nodes.push_back({refCount-1,refCount,0,0,GraphNode::GRAY});
+		objects.push_back(o);
+		stack.push_back(nodes.size()-1);
+	}
+}
+
+//1) Mark: build the graph reachable from the roots and subtract the internal references
+bool CycleCollector::mark(int64_t deadline)
+{
+	uint32_t steps=0;
+	while(!stack.empty())
+	{
+		if((++steps%CYCLECOLLECTOR_DEADLINE_CHECK)==0 && g_get_monotonic_time()>=deadline)
+			return false;
+		uint32_t n=stack.back();
+		stack.pop_back();
+		refs.clear();
+		objects[n]->getReferencedObjects(refs);
+		nodes[n].firstEdge=edges.size();
+		for(auto it=refs.begin();it!=refs.end();++it)
+		{
+			ASObject* child=*it;
+			if(!child->isCycleCollectable())
+				continue;
+			auto found=nodeIndex.find(child);
+			uint32_t c;
+			if(found==nodeIndex.end())
+			{
+				if(nodes.size()>=CYCLECOLLECTOR_MAX_GRAPH_SIZE)
+				{
+					//The graph is too big, consider everything alive
+					releaseRoots();
+					return true;
+				}
+				c=nodes.size();
+				nodeIndex[child]=c;
+				int32_t refCount=child->getRefCount();
+				nodes.push_back({refCount,refCount,0,0,GraphNode::GRAY});
+				objects.push_back(child);
+				stack.push_back(c);
+			}
+			else
+				c=found->second;
+			nodes[c].count--;
+			edges.push_back(c);
+		}
+		nodes[n].edgeCount=edges.size()-nodes[n].firstEdge;
+	}
+	for(auto it=nodes.begin();it!=nodes.end();++it)
+	{
+		if(it->count<0)
+		{
+			//More references were reported than the object really holds
+			LOG(LOG_ERROR,"CycleCollector: inconsistent reference count for "<<objects[it-nodes.begin()]->toDebugString());
+			releaseRoots();
+			return true;
+		}
+	}
+	scanRoot=0;
+	phase=SCAN;
+	return true;
+}
+
+//2) Scan: nodes that are still referenced from outside and everything
+//reachable from them are alive, the other ones are garbage
+bool CycleCollector::scan(int64_t deadline)
+{
+	uint32_t steps=0;
+	while(scanRoot<nodes.size() || !stack.empty() || !blackStack.empty())
+	{
+		if((++steps%CYCLECOLLECTOR_DEADLINE_CHECK)==0 && g_get_monotonic_time()>=deadline)
+			return false;
+		//Everything reachable from a live node is alive
+		if(!blackStack.empty())
+		{
+			uint32_t b=blackStack.back();
+			blackStack.pop_back();
+			for(uint32_t e=nodes[b].firstEdge;e<nodes[b].firstEdge+nodes[b].edgeCount;e++)
+			{
+				uint32_t c=edges[e];
+				nodes[c].count++;
+				if(nodes[c].color!=GraphNode::BLACK)
+				{
+					nodes[c].color=GraphNode::BLACK;
+					blackStack.push_back(c);
+				}
+			}
+			continue;
+		}
+		if(stack.empty())
+			stack.push_back(scanRoot++);
+		uint32_t n=stack.back();
+		stack.pop_back();
+		if(nodes[n].color!=GraphNode::GRAY)
+			continue;
+		if(nodes[n].count>0)
+		{
+			nodes[n].color=GraphNode::BLACK;
+			blackStack.push_back(n);
+		}
+		else
+		{
+			nodes[n].color=GraphNode::WHITE;
+			for(uint32_t e=nodes[n].firstEdge;e<nodes[n].firstEdge+nodes[n].edgeCount;e++)
+				stack.push_back(edges[e]);
+		}
+	}
+	collectGarbage();
+	return true;
+}
+
+//3) Collect: keep all the garbage alive until every cycle is broken
+void CycleCollector::collectGarbage()
+{
+	std::vector<ASObject*> garbage;
+	for(uint32_t n=0;n<nodes.size();n++)
+	{
+		if(nodes[n].color!=GraphNode::WHITE)
+			continue;
+		if(objects[n]->getRefCount()!=nodes[n].refCount)
+		{
+			//Another thread took or released a reference while the graph was examined
+			releaseRoots();
+			return;
+		}
+		garbage.push_back(objects[n]);
+	}
+	for(auto it=garbage.begin();it!=garbage.end();++it)
+		(*it)->incRef();
+	for(auto it=garbage.begin();it!=garbage.end();++it)
+		(*it)->unlinkReferencedObjects();
+	for(auto it=garbage.begin();it!=garbage.end();++it)
+	{
+#ifdef MEMORY_USAGE_PROFILING
+		collectedBytes+=memory_reporter::getAccountedSize(dynamic_cast<void*>(*it));
+#endif
+		collectedObjects++;
+		(*it)->decRef();
+	}
+	releaseRoots();
+}
+
+void CycleCollector::clearGraph()
+{
+	objects.clear();
+	nodes.clear();
+	edges.clear();
+	nodeIndex.clear();
+	stack.clear();
+	blackStack.clear();
+	scanRoot=0;
+}
+
+void CycleCollector::releaseRoots()
+{
+	clearGraph();
+	for(auto it=roots.begin();it!=roots.end();++it)
+	{
+		ASObject* o=*it;
+		//The root is still flagged, so releasing our reference doesn't buffer it again.
+		//The next decRef by the program does
+		if(o->isLastRef())
+			o->decRef();
+		else
+		{
+			o->decRef();
+			o->resetCycleCandidate();
+		}
+	}
+	roots.clear();
+	phase=IDLE;
+}
+
+void CycleCollector::dumpStatistics(std::ostream& out) const
+{
+	out << "# cycle collector: " << collectedObjects << " objects, " << collectedBytes << " bytes collected in "
+		<< slices << " slices, total pause " << totalPauseTime << " us, max pause " << maxPauseTime << " us, "
+		<< restartedBatches << " batches restarted" << std::endl;
+}
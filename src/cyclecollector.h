@@ -0,0 +1,127 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef CYCLECOLLECTOR_H
+#define CYCLECOLLECTOR_H 1
+
+#include "compat.h"
+#include <vector>
+#include <ostream>
+#include <unordered_map>
+#include "memory_support.h"
+
+namespace lightspark
+{
+
+//Time spent in one slice of the collector, in microseconds
+#define CYCLECOLLECTOR_SLICE_TIME 2000
+//Number of candidates examined together
+#define CYCLECOLLECTOR_BATCH_SIZE 256
+//Maximum number of objects visited for one batch, bigger graphs are considered alive
+#define CYCLECOLLECTOR_MAX_GRAPH_SIZE 65536
+//Number of candidates that triggers a slice even if the vm is busy
+#define CYCLECOLLECTOR_CANDIDATES_THRESHOLD 65536
+//Number of objects visited between two checks of the deadline
+#define CYCLECOLLECTOR_DEADLINE_CHECK 64
+//A batch restarted this many times is finished in one slice, so a busy vm still makes progress
+#define CYCLECOLLECTOR_MAX_RESTARTS 4
+
+class ASObject;
+
+/*
+ * Synchronous trial deletion cycle collector (Bacon and Rajan).
+ * Objects whose reference count is decremented without reaching zero on the vm thread
+ * are buffered as possible roots of garbage cycles. The buffer is only accessed from
+ * the vm thread, so decRef buffers a candidate without locking. The vm thread
+ * periodically calls collectSlice() which examines the subgraph reachable from a batch
+ * of candidates: the references inside the subgraph are subtracted from the reference
+ * counts, objects that are still referenced from outside (and everything reachable
+ * from them) are alive, all the others are only kept alive by cycles and are unlinked.
+ * The reference counts themselves are never modified, the trial counts are kept
+ * in a separate table. The examination of a batch is split across slices, but it is
+ * restarted whenever ActionScript code may have changed the objects (objectsChanged()).
+ * Other threads may still take or release references meanwhile, so the garbage is
+ * only unlinked if the reference counts are the same as when the graph was built.
+ */
+class CycleCollector
+{
+private:
+	struct GraphNode
+	{
+		int32_t count;
+		// the reference count when the node was visited
+		int32_t refCount;
+		uint32_t firstEdge;
+		uint32_t edgeCount;
+		enum COLOR { GRAY=0, BLACK, WHITE } color;
+	};
+	enum PHASE { IDLE=0, MARK, SCAN };
+	std::vector<ASObject*, reporter_allocator<ASObject*>> candidates;
+	bool stopped;
+	// state of the batch being examined, kept between slices
+	PHASE phase;
+	std::vector<ASObject*> roots;
+	std::vector<ASObject*> objects;
+	std::vector<GraphNode> nodes;
+	std::vector<uint32_t> edges;
+	std::unordered_map<ASObject*,uint32_t> nodeIndex;
+	std::vector<uint32_t> stack;
+	std::vector<uint32_t> blackStack;
+	std::vector<ASObject*> refs;
+	uint32_t scanRoot;
+	uint32_t restarts;
+	// statistics
+	uint64_t collectedObjects;
+	uint64_t collectedBytes;
+	uint64_t totalPauseTime;
+	uint32_t maxPauseTime;
+	uint32_t slices;
+	uint32_t restartedBatches;
+	bool startBatch();
+	void buildRootNodes();
+	// the steps of a batch return false if the deadline expired before they were finished
+	bool mark(int64_t deadline);
+	bool scan(int64_t deadline);
+	void collectGarbage();
+	void clearGraph();
+	void releaseRoots();
+public:
+	CycleCollector(MemoryAccount* m);
+	// makes decRef on the calling thread buffer the candidates in this collector
+	void registerThread();
+	void addCandidate(ASObject* o);
+	// returns false if the calling thread doesn't own the candidate buffer
+	bool removeCandidate(ASObject* o);
+	bool hasCandidates() const;
+	// true when the candidate buffer is big enough to justify a slice during busy frames
+	bool needsCollection() const;
+	// called by the vm thread after running ActionScript code, the batch being examined is restarted
+	void objectsChanged();
+	/*
+	 * Examines candidates for at most budget microseconds.
+	 * It must be called from the vm thread while no ActionScript code is executing.
+	 */
+	void collectSlice(uint32_t budget=CYCLECOLLECTOR_SLICE_TIME);
+	// forgets all candidates and ignores new ones, called at shutdown after the vm is stopped
+	void stop();
+	void dumpStatistics(std::ostream& out) const;
+};
+
+}
+#endif /* CYCLECOLLECTOR_H */
@@ -22,6 +22,7 @@
 #include "backends/security.h"
 #include "backends/config.h"
 #include "swf.h"
+#include "tracing.h"
 #include "logger.h"
 #include "platforms/engineutils.h"
 #include "compat.h"
@@ -252,12 +253,16 @@ int main(int argc, char* argv[])
 #ifdef PROFILING_SUPPORT
 	char* profilingFileName=nullptr;
 #endif
+	char* samplerFileName=nullptr;
+	char* traceFileName=nullptr;
+	char* audioFileName=nullptr;
 	char *HTTPcookie=nullptr;
 	SecurityManager::SANDBOXTYPE sandboxType=SecurityManager::LOCAL_WITH_FILE;
 	bool useInterpreter=true;
 	bool useFastInterpreter=false;
 	bool useJit=false;
 	bool ignoreUnhandledExceptions = false;
+	bool fastForward=false;
 	SystemState::ERROR_TYPE exitOnError=SystemState::ERROR_PARSING;
 	LOG_LEVEL log_level=LOG_INFO;
 	SystemState::FLASH_MODE flashMode=SystemState::FLASH;
@@ -299,6 +304,8 @@ int main(int argc, char* argv[])
 			useJit=true;
 		else if(strcmp(argv[i],"-ne")==0 || strcmp(argv[i],"--ignore-unhandled-exceptions")==0)
 			ignoreUnhandledExceptions=true;
+		else if(strcmp(argv[i],"-ff")==0 || strcmp(argv[i],"--fast-forward")==0)
+			fastForward=true;
 		else if(strcmp(argv[i],"-l")==0 || strcmp(argv[i],"--log-level")==0)
 		{
 			i++;
@@ -334,6 +341,39 @@ int main(int argc, char* argv[])
 			profilingFileName=argv[i];
 		}
 #endif
+		else if(strcmp(argv[i],"-so")==0 || 
+			strcmp(argv[i],"--sampler-output")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName=nullptr;
+				break;
+			}
+			samplerFileName=argv[i];
+		}
+		else if(strcmp(argv[i],"-to")==0 || 
+			strcmp(argv[i],"--trace-output")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName=nullptr;
+				break;
+			}
+			traceFileName=argv[i];
+		}
+		else if(strcmp(argv[i],"-ao")==0 || 
+			strcmp(argv[i],"--audio-output")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName=nullptr;
+				break;
+			}
+			audioFileName=argv[i];
+		}
 		else if(strcmp(argv[i],"-s")==0 || 
 			strcmp(argv[i],"--security-sandbox")==0)
 		{
@@ -392,7 +432,7 @@ int main(int argc, char* argv[])
 	{
 		LOG(LOG_ERROR, "Usage: " << argv[0] << " [--url|-u http://loader.url/file.swf]" <<
 			" [--disable-interpreter|-ni] [--enable-fast-interpreter|-fi]" <<
-#ifdef LLVM_ENABLED
+#if defined(LLVM_ENABLED) || defined(BASELINE_JIT_ENABLED)
 			" [--enable-jit|-j]" <<
 #endif
 			" [--log-level|-l 0-4] [--parameters-file|-p params-file] [--security-sandbox|-s sandbox]" <<
@@ -400,6 +440,10 @@ int main(int argc, char* argv[])
 #ifdef PROFILING_SUPPORT
 			" [--profiling-output|-o profiling-file]" <<
 #endif
+			" [--sampler-output|-so pprof-or-json-file]" <<
+			" [--trace-output|-to json-file]" <<
+			" [--audio-output|-ao wav-file]" <<
+			" [--fast-forward|-ff]" <<
 			" [--ignore-unhandled-exceptions|-ne]"
 			" [--version|-v]" <<
 			" <file.swf>");
@@ -427,6 +471,9 @@ int main(int argc, char* argv[])
 		SystemState::staticDeinit();
 		exit(3);
 	}
+	//The clock has to be chosen before the timers are started
+	if(fastForward)
+		EngineClock::setVirtual(true);
 	//NOTE: see SystemState declaration
 	SystemState* sys = new SystemState(fileSize, flashMode);
 	ParseThread* pt = new ParseThread(f, sys->mainClip);
@@ -482,6 +529,12 @@ int main(int argc, char* argv[])
 	if(profilingFileName)
 		sys->setProfilingOutput(profilingFileName);
 #endif
+	if(samplerFileName)
+		sys->setSamplerOutput(samplerFileName);
+	if(traceFileName)
+		Tracer::setOutput(traceFileName);
+	if(audioFileName)
+		sys->setAudioOutput(audioFileName);
 	if(HTTPcookie)
 		sys->setCookies(HTTPcookie);
 
@@ -21,6 +21,222 @@
 #include "swf.h"
 
 using namespace lightspark;
+
+//Offset of the first block of a chunk, keeping the blocks aligned like malloc does
+#define SLAB_CHUNK_HEADER_SIZE 64
+//Number of blocks moved to the local list of the owner when a chunk is carved
+#define SLAB_CARVE_BATCH 16
+
+static thread_local SlabAllocator* currentAllocator=nullptr;
+
+bool memory_reporter::sampleAllocations=false;
+thread_local uint32_t memory_reporter::lastAllocationSize=0;
+
+//Allocators released by terminated workers, waiting to be reused
+static Mutex detachedAllocatorsMutex;
+static std::vector<SlabAllocator*> detachedAllocators;
+
+SlabAllocator::SlabAllocator():chunks(nullptr)
+{
+	static_assert(sizeof(Chunk)<=SLAB_CHUNK_HEADER_SIZE,"slab chunk header is too big");
+	for(uint32_t i=0;i<SLAB_NUM_CLASSES;i++)
+	{
+		freeLists[i]=nullptr;
+		remoteFreeLists[i]=nullptr;
+		currentChunks[i]=nullptr;
+		currentOffsets[i]=0;
+	}
+}
+
+SlabAllocator::~SlabAllocator()
+{
+}
+
+SlabAllocator* SlabAllocator::getShared()
+{
+	//Intentionally leaked, objects may be freed during the static destruction
+	static SlabAllocator* shared=new SlabAllocator();
+	return shared;
+}
+
+SlabAllocator* SlabAllocator::create()
+{
+	Locker l(detachedAllocatorsMutex);
+	if(detachedAllocators.empty())
+		return new SlabAllocator();
+	SlabAllocator* ret=detachedAllocators.back();
+	detachedAllocators.pop_back();
+	return ret;
+}
+
+void SlabAllocator::attach()
+{
+	assert(currentAllocator==nullptr);
+	//Blocks freed while the allocator had no owner can now be used without locking
+	Locker l(mutex);
+	for(uint32_t i=0;i<SLAB_NUM_CLASSES;i++)
+	{
+		freeLists[i]=remoteFreeLists[i];
+		remoteFreeLists[i]=nullptr;
+	}
+	currentAllocator=this;
+}
+
+void SlabAllocator::release()
+{
+	assert(currentAllocator==this);
+	currentAllocator=nullptr;
+	{
+		Locker l(mutex);
+		//From now on every thread uses the locked path
+		for(uint32_t i=0;i<SLAB_NUM_CLASSES;i++)
+		{
+			while(freeLists[i])
+			{
+				FreeBlock* b=freeLists[i];
+				freeLists[i]=b->next;
+				b->next=remoteFreeLists[i];
+				remoteFreeLists[i]=b;
+			}
+		}
+		freeEmptyChunks();
+	}
+	Locker l(detachedAllocatorsMutex);
+	detachedAllocators.push_back(this);
+}
+
+void SlabAllocator::freeEmptyChunks()
+{
+	//No block of an empty chunk can be freed concurrently, so their free blocks only
+	//need to be dropped from the lists before the chunks are given back to the system
+	for(uint32_t i=0;i<SLAB_NUM_CLASSES;i++)
+	{
+		FreeBlock** b=&remoteFreeLists[i];
+		while(*b)
+		{
+			if(getChunk(*b)->used==0)
+				*b=(*b)->next;
+			else
+				b=&(*b)->next;
+		}
+		if(currentChunks[i] && currentChunks[i]->used==0)
+			currentChunks[i]=nullptr;
+	}
+	Chunk** c=&chunks;
+	while(*c)
+	{
+		Chunk* chunk=*c;
+		if(chunk->used==0)
+		{
+			*c=chunk->next;
+			chunk->~Chunk();
+			aligned_free(chunk);
+		}
+		else
+			c=&chunk->next;
+	}
+}
+
+SlabAllocator::FreeBlock* SlabAllocator::carveBlock(uint32_t sizeClass)
+{
+	uint32_t blockSize=(sizeClass+1)*SLAB_GRANULARITY;
+	Chunk* chunk=currentChunks[sizeClass];
+	if(chunk==nullptr || currentOffsets[sizeClass]+blockSize>SLAB_CHUNK_SIZE)
+	{
+		void* mem;
+		aligned_malloc(&mem,SLAB_CHUNK_SIZE,SLAB_CHUNK_SIZE);
+		chunk=new (mem) Chunk();
+		chunk->owner=this;
+		chunk->sizeClass=sizeClass;
+		chunk->used=0;
+		chunk->next=chunks;
+		chunks=chunk;
+		currentChunks[sizeClass]=chunk;
+		currentOffsets[sizeClass]=SLAB_CHUNK_HEADER_SIZE;
+	}
+	FreeBlock* ret=reinterpret_cast<FreeBlock*>(reinterpret_cast<uint8_t*>(chunk)+currentOffsets[sizeClass]);
+	currentOffsets[sizeClass]+=blockSize;
+	return ret;
+}
+
+void* SlabAllocator::allocateSlow(uint32_t sizeClass, bool isOwner)
+{
+	Locker l(mutex);
+	FreeBlock* ret=remoteFreeLists[sizeClass];
+	if(ret)
+	{
+		if(isOwner)
+		{
+			//Take back all the blocks freed by the other threads
+			freeLists[sizeClass]=ret->next;
+			remoteFreeLists[sizeClass]=nullptr;
+		}
+		else
+			remoteFreeLists[sizeClass]=ret->next;
+	}
+	else
+	{
+		ret=carveBlock(sizeClass);
+		if(isOwner)
+		{
+			for(uint32_t i=0;i<SLAB_CARVE_BATCH;i++)
+			{
+				FreeBlock* b=carveBlock(sizeClass);
+				b->next=freeLists[sizeClass];
+				freeLists[sizeClass]=b;
+			}
+		}
+	}
+	getChunk(ret)->used++;
+	return ret;
+}
+
+void* SlabAllocator::allocate(size_t size)
+{
+	if(size>SLAB_MAX_SIZE)
+	{
+		void* ret=malloc(size);
+		if(!ret)
+			throw std::bad_alloc();
+		return ret;
+	}
+	uint32_t sizeClass=getSizeClass(size);
+	SlabAllocator* a=currentAllocator;
+	if(a==nullptr)
+		return getShared()->allocateSlow(sizeClass,false);
+	FreeBlock* ret=a->freeLists[sizeClass];
+	if(ret==nullptr)
+		return a->allocateSlow(sizeClass,true);
+	a->freeLists[sizeClass]=ret->next;
+	getChunk(ret)->used++;
+	return ret;
+}
+
+void SlabAllocator::deallocate(void* p, size_t size)
+{
+	if(p==nullptr)
+		return;
+	if(size>SLAB_MAX_SIZE)
+	{
+		free(p);
+		return;
+	}
+	Chunk* chunk=getChunk(p);
+	assert(chunk->sizeClass==getSizeClass(size));
+	SlabAllocator* a=chunk->owner;
+	FreeBlock* b=reinterpret_cast<FreeBlock*>(p);
+	if(a==currentAllocator)
+	{
+		b->next=a->freeLists[chunk->sizeClass];
+		a->freeLists[chunk->sizeClass]=b;
+		chunk->used--;
+		return;
+	}
+	Locker l(a->mutex);
+	b->next=a->remoteFreeLists[chunk->sizeClass];
+	a->remoteFreeLists[chunk->sizeClass]=b;
+	chunk->used--;
+}
 #ifdef MEMORY_USAGE_PROFILING
 MemoryAccount* lightspark::getUnaccountedMemoryAccount()
 {
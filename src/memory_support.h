@@ -22,11 +22,110 @@
 
 #include "compat.h"
 #include "tiny_string.h"
+#include "threading.h"
 #include <malloc.h>
 
 namespace lightspark
 {
 
+#define SLAB_CHUNK_SIZE (64*1024)
+#define SLAB_GRANULARITY 16
+#define SLAB_MAX_SIZE 1024
+#define SLAB_NUM_CLASSES (SLAB_MAX_SIZE/SLAB_GRANULARITY)
+
+/*
+ * Size class allocator used for the objects derived from memory_reporter.
+ * Memory is taken from the system in SLAB_CHUNK_SIZE aligned chunks, each one
+ * holding blocks of a single size class. Every ASWorker (and the primordial vm thread)
+ * owns an allocator that is used without locking from its thread. Blocks freed
+ * by other threads are queued on their owner and reused once its local lists are empty.
+ * Threads without an allocator use a shared one, always under its mutex.
+ * Allocations bigger than SLAB_MAX_SIZE are forwarded to malloc.
+ */
+class DLL_PUBLIC SlabAllocator
+{
+private:
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+	struct Chunk
+	{
+		SlabAllocator* owner;
+		Chunk* next;
+		uint32_t sizeClass;
+		// number of blocks of this chunk in use
+		ATOMIC_INT32(used);
+	};
+	// only accessed from the owner thread
+	FreeBlock* freeLists[SLAB_NUM_CLASSES];
+	// everything below is protected by the mutex
+	Mutex mutex;
+	FreeBlock* remoteFreeLists[SLAB_NUM_CLASSES];
+	Chunk* currentChunks[SLAB_NUM_CLASSES];
+	uint32_t currentOffsets[SLAB_NUM_CLASSES];
+	Chunk* chunks;
+	SlabAllocator();
+	// allocators are never destroyed, as blocks may outlive their owner
+	~SlabAllocator();
+	static inline uint32_t getSizeClass(size_t size)
+	{
+		return (size-1)/SLAB_GRANULARITY;
+	}
+	static inline Chunk* getChunk(void* p)
+	{
+		return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(SLAB_CHUNK_SIZE-1));
+	}
+	static SlabAllocator* getShared();
+	void* allocateSlow(uint32_t sizeClass, bool isOwner);
+	// carve a new block from the current chunk of the size class, the mutex must be held
+	FreeBlock* carveBlock(uint32_t sizeClass);
+	void freeEmptyChunks();
+public:
+	/*
+	 * Returns an allocator without owner, possibly reusing one released by a terminated worker
+	 */
+	static SlabAllocator* create();
+	/*
+	 * Makes the calling thread the owner of this allocator
+	 */
+	void attach();
+	/*
+	 * Called from the owner thread when it stops allocating. The chunks without
+	 * live blocks are given back to the system and the allocator is kept for reuse.
+	 */
+	void release();
+	static void* allocate(size_t size);
+	static void deallocate(void* p, size_t size);
+	/*
+	 * The number of bytes actually used for an allocation of the given size
+	 */
+	static inline size_t getAllocatedSize(size_t size)
+	{
+		if(size>SLAB_MAX_SIZE)
+			return size;
+		return (getSizeClass(size)+1)*SLAB_GRANULARITY;
+	}
+};
+
+/*
+ * Creates and attaches an allocator for the lifetime of a thread's job
+ */
+class SlabAllocatorScope
+{
+private:
+	SlabAllocator* allocator;
+public:
+	SlabAllocatorScope():allocator(SlabAllocator::create())
+	{
+		allocator->attach();
+	}
+	~SlabAllocatorScope()
+	{
+		allocator->release();
+	}
+};
+
 #ifdef MEMORY_USAGE_PROFILING
 class MemoryAccount;
 DLL_PUBLIC MemoryAccount* getUnaccountedMemoryAccount();
@@ -61,6 +160,10 @@ private:
 		MemoryAccount* memoryAccount;
 	};
 public:
+	// set while the sampler records allocations, the size of every allocation is
+	// then kept in lastAllocationSize for the constructor of the object
+	static DLL_PUBLIC bool sampleAllocations;
+	static DLL_PUBLIC thread_local uint32_t lastAllocationSize;
 	//Placement new and delete
 	inline void* operator new( size_t size, void *p )
 	{
@@ -75,20 +178,29 @@ public:
 		//Prepend some internal data.
 		//Adding the data to the object itself would not work
 		//since it can be reset by the constructors
-		objData* ret=reinterpret_cast<objData*>(malloc(size+sizeof(objData)));
+		objData* ret=reinterpret_cast<objData*>(SlabAllocator::allocate(size+sizeof(objData)));
 		if(!m)
 			m = getUnaccountedMemoryAccount();
-		m->addBytes(size);
-		ret->objSize = size;
+		//Account the rounded up size, that is the memory really used by the object
+		uint32_t accounted=SlabAllocator::getAllocatedSize(size+sizeof(objData))-sizeof(objData);
+		m->addBytes(accounted);
+		ret->objSize = accounted;
 		ret->memoryAccount = m;
+		if(USUALLY_FALSE(sampleAllocations))
+			lastAllocationSize = accounted;
 		return ret+1;
 	}
-	inline void operator delete( void* obj )
+	//Number of bytes accounted for an object, obj has to point to the most derived object
+	static inline uint32_t getAccountedSize(const void* obj)
+	{
+		return (reinterpret_cast<const objData*>(obj)-1)->objSize;
+	}
+	inline void operator delete( void* obj, size_t size )
 	{
 		//Get back the metadata
 		objData* th=reinterpret_cast<objData*>(obj)-1;
 		th->memoryAccount->removeBytes(th->objSize);
-		free(th);
+		SlabAllocator::deallocate(th,size+sizeof(objData));
 	}
 };
 
@@ -172,6 +284,10 @@ class MemoryAccount;
 class memory_reporter
 {
 public:
+	// set while the sampler records allocations, the size of every allocation is
+	// then kept in lastAllocationSize for the constructor of the object
+	static DLL_PUBLIC bool sampleAllocations;
+	static DLL_PUBLIC thread_local uint32_t lastAllocationSize;
 	//Placement new and delete
 	inline void* operator new( size_t size, void *p )
 	{
@@ -183,11 +299,13 @@ public:
 	//Regular allocator
 	inline void* operator new( size_t size, MemoryAccount* m)
 	{
-		return malloc(size);
+		if(USUALLY_FALSE(sampleAllocations))
+			lastAllocationSize = size;
+		return SlabAllocator::allocate(size);
 	}
-	inline void operator delete( void* obj )
+	inline void operator delete( void* obj, size_t size )
 	{
-		free(obj);
+		SlabAllocator::deallocate(obj,size);
 	}
 };
 
@@ -47,6 +47,8 @@
 #include "scripting/flash/filters/flashfilters.h"
 #include "backends/audio.h"
 #include "backends/rendering.h"
+#include "backends/image.h"
+#include "backends/bitmapdecoder.h"
 
 #undef RGB
 
@@ -1255,29 +1257,177 @@ ASObject* DefineFont4Tag::instance(Class_base* c)
 	return ret;
 }
 
+/*
+ * JPEG or PNG data of a bitmap tag, with the JPEG encoding tables
+ * and the zlib compressed alpha channel of DefineBitsJPEG3, if any
+ */
+class EncodedBitmapSource: public BitmapSource
+{
+private:
+	std::vector<uint8_t> imageData;
+	std::vector<uint8_t> tables;
+	std::string alphaData;
+	bool png;
+public:
+	EncodedBitmapSource(const uint8_t* inData, int datasize, const uint8_t* tablesData, int tablesLen, const std::string& alpha, bool isPNG):
+		imageData(inData, inData+datasize),alphaData(alpha),png(isPNG)
+	{
+		if(tablesData)
+			tables.assign(tablesData, tablesData+tablesLen);
+	}
+	bool decode(BitmapContainer* b) override
+	{
+		bool ret;
+		if(png)
+			ret=b->fromPNG(&imageData[0], imageData.size());
+		else
+			ret=b->fromJPEG(&imageData[0], imageData.size(), tables.empty() ? nullptr : &tables[0], tables.size());
+		if(!ret || alphaData.empty())
+			return ret;
+
+		istringstream alphaStream(alphaData);
+		zlib_filter zf(alphaStream.rdbuf());
+		istream zfstream(&zf);
+		zfstream.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
+
+		//Catch the exception if the stream ends
+		try
+		{
+			//Set alpha
+			for(int32_t i=0;i<b->getHeight();i++)
+			{
+				for(int32_t j=0;j<b->getWidth();j++)
+					b->setAlpha(j, i, zfstream.get());
+			}
+		}
+		catch(std::exception& e)
+		{
+			LOG(LOG_ERROR, "Exception while parsing Alpha data in DefineBitsJPEG3");
+		}
+		return true;
+	}
+	size_t getCompressedSize() const override
+	{
+		return imageData.size()+tables.size()+alphaData.size();
+	}
+};
+
+/*
+ * zlib compressed data of DefineBitsLossless and DefineBitsLossless2
+ */
+class LosslessBitmapSource: public BitmapSource
+{
+private:
+	std::string compressedData;
+	uint8_t bitmapFormat;
+	int version;
+	uint32_t width;
+	uint32_t height;
+	uint8_t colorTableSize;
+public:
+	LosslessBitmapSource(const std::string& data, uint8_t format, int v, uint32_t w, uint32_t h, uint8_t tableSize):
+		compressedData(data),bitmapFormat(format),version(v),width(w),height(h),colorTableSize(tableSize)
+	{
+	}
+	bool decode(BitmapContainer* b) override
+	{
+		istringstream cDataStream(compressedData);
+		zlib_filter zf(cDataStream.rdbuf());
+		istream zfstream(&zf);
+
+		if (bitmapFormat == LOSSLESS_BITMAP_RGB15 ||
+		    bitmapFormat == LOSSLESS_BITMAP_RGB24)
+		{
+			size_t size = width * height * 4;
+			uint8_t* inData=new(nothrow) uint8_t[size];
+			if (!inData)
+				return false;
+			zfstream.read((char*)inData,size);
+			assert(!zfstream.fail() && !zfstream.eof());
+
+			BitmapContainer::BITMAP_FORMAT format;
+			if (bitmapFormat == LOSSLESS_BITMAP_RGB15)
+				format = BitmapContainer::RGB15;
+			else if (version == 1)
+				format = BitmapContainer::RGB32;
+			else
+				format = BitmapContainer::ARGB32;
+
+			return b->fromRGB(inData, width, height, format);
+		}
+
+		unsigned numColors = colorTableSize+1;
+
+		/* Bitmap rows are 32 bit aligned */
+		uint32_t stride = width;
+		while (stride % 4 != 0)
+			stride++;
+
+		unsigned int paletteBPP;
+		if (version == 1)
+			paletteBPP = 3;
+		else
+			paletteBPP = 4;
+
+		size_t size = paletteBPP*numColors + stride*height;
+		uint8_t* inData=new(nothrow) uint8_t[size];
+		if (!inData)
+			return false;
+		zfstream.read((char*)inData,size);
+		assert(!zfstream.fail() && !zfstream.eof());
+
+		uint8_t *palette = inData;
+		uint8_t *pixelData = inData + paletteBPP*numColors;
+		bool ret = b->fromPalette(pixelData, width, height, stride, palette, numColors, paletteBPP);
+		delete[] inData;
+		return ret;
+	}
+	size_t getCompressedSize() const override
+	{
+		return compressedData.size();
+	}
+};
+
 BitmapTag::BitmapTag(RECORDHEADER h,RootMovieClip* root):DictionaryTag(h,root),bitmap(_MR(new BitmapContainer(root->getSystemState()->tagsMemory)))
 {
+	//Decoded pixels are only evicted while they are not pinned by a PinnedBitmap
 	bitmap->setConstant();
 }
 
 _R<BitmapContainer> BitmapTag::getBitmap() const {
 	return bitmap;
 }
-void BitmapTag::loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData, int tablesLen)
+void BitmapTag::setBitmapSource(BitmapSource* source, uint32_t w, uint32_t h)
+{
+	SystemState* sys=loadedFrom->getSystemState();
+	bitmap->setSource(source, w, h, sys->bitmapDecoder);
+	sys->bitmapDecoder->prefetch(bitmap);
+}
+void BitmapTag::loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData, int tablesLen, const std::string& alphaData)
 {
 	if (datasize < 4)
 		return;
-	else if((inData[0]&0x80) && inData[1]=='P' && inData[2]=='N' && inData[3]=='G')
-		bitmap->fromPNG(inData,datasize);
-	else if(inData[0]==0xff && inData[1]==0xd8 && inData[2]==0xff)
-		bitmap->fromJPEG(inData,datasize,tablesData,tablesLen);
+	bool png=(inData[0]&0x80) && inData[1]=='P' && inData[2]=='N' && inData[3]=='G';
+	if(png || (inData[0]==0xff && inData[1]==0xd8 && inData[2]==0xff))
+	{
+		BitmapSource* source=new EncodedBitmapSource(inData, datasize, tablesData, tablesLen, alphaData, png);
+		uint32_t w,h;
+		if(png ? ImageDecoder::getPNGSize(inData, datasize, &w, &h) : ImageDecoder::getJPEGSize(inData, datasize, &w, &h))
+			setBitmapSource(source, w, h);
+		else
+		{
+			//The size must be known before the bitmap is used, so decode it now
+			source->decode(bitmap.getPtr());
+			delete source;
+		}
+	}
 	else if(inData[0]=='G' && inData[1]=='I' && inData[2]=='F' && inData[3]=='8')
 		LOG(LOG_ERROR,"GIF image found, not yet supported, ID :"<<getId());
 	else if(inData[0]==0xff && inData[1]==0xd9)
 		// I've found swf files with broken jpegs that start with the jpeg "end of file" magic bytes and two times the "begin of file" magic bytes
 		// so we just ignore the first 4 bytes
 		// TODO check if libjpeg has a better common way to deal with invalid headers
-		loadBitmap(inData+4, datasize-4, tablesData, tablesLen);
+		loadBitmap(inData+4, datasize-4, tablesData, tablesLen, alphaData);
 	else
 		LOG(LOG_ERROR,"unknown image format for ID "<<getId());
 }
@@ -1294,52 +1444,16 @@ DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int ve
 	size_t cSize = dest-in.tellg(); //rest of this tag
 	cData.resize(cSize);
 	in.read(&cData[0], cSize);
-	istringstream cDataStream(cData);
-	zlib_filter zf(cDataStream.rdbuf());
-	istream zfstream(&zf);
 
 	if (BitmapFormat == LOSSLESS_BITMAP_RGB15 ||
-	    BitmapFormat == LOSSLESS_BITMAP_RGB24)
-	{
-		size_t size = BitmapWidth * BitmapHeight * 4;
-		uint8_t* inData=new(nothrow) uint8_t[size];
-		zfstream.read((char*)inData,size);
-		assert(!zfstream.fail() && !zfstream.eof());
-
-		BitmapContainer::BITMAP_FORMAT format;
-		if (BitmapFormat == LOSSLESS_BITMAP_RGB15)
-			format = BitmapContainer::RGB15;
-		else if (version == 1)
-			format = BitmapContainer::RGB32;
-		else
-			format = BitmapContainer::ARGB32;
-
-		bitmap->fromRGB(inData, BitmapWidth, BitmapHeight, format);
-	}
-	else if (BitmapFormat == LOSSLESS_BITMAP_PALETTE)
+	    BitmapFormat == LOSSLESS_BITMAP_RGB24 ||
+	    BitmapFormat == LOSSLESS_BITMAP_PALETTE)
 	{
-		unsigned numColors = BitmapColorTableSize+1;
-
-		/* Bitmap rows are 32 bit aligned */
-		uint32_t stride = BitmapWidth;
-		while (stride % 4 != 0)
-			stride++;
-
-		unsigned int paletteBPP;
-		if (version == 1)
-			paletteBPP = 3;
-		else
-			paletteBPP = 4;
-
-		size_t size = paletteBPP*numColors + stride*BitmapHeight;
-		uint8_t* inData=new(nothrow) uint8_t[size];
-		zfstream.read((char*)inData,size);
-		assert(!zfstream.fail() && !zfstream.eof());
-
-		uint8_t *palette = inData;
-		uint8_t *pixelData = inData + paletteBPP*numColors;
-		bitmap->fromPalette(pixelData, BitmapWidth, BitmapHeight, stride, palette, numColors, paletteBPP);
-		delete[] inData;
+		if (BitmapWidth == 0 || BitmapHeight == 0)
+			return;
+		//The compressed data is kept, it is decoded on first use
+		setBitmapSource(new LosslessBitmapSource(cData, BitmapFormat, version, BitmapWidth, BitmapHeight, BitmapColorTableSize),
+				BitmapWidth, BitmapHeight);
 	}
 	else
 	{
@@ -1913,7 +2027,7 @@ void PlaceObject2Tag::execute(DisplayObjectContainer* parent, bool inskipping)
 			if (it->EventFlags.ClipEventConstruct)
 			{
 				AVM1context context;
-				ACTIONRECORD::executeActions(currchar ,&context,it->actions,it->startactionpos,m);
+				ACTIONRECORD::executeActions(currchar ,&context,it->actions.getPtr(),m);
 			}
 		}
 	}
@@ -1926,7 +2040,7 @@ void PlaceObject2Tag::execute(DisplayObjectContainer* parent, bool inskipping)
 			if (it->EventFlags.ClipEventInitialize)
 			{
 				AVM1context context;
-				ACTIONRECORD::executeActions(currchar ,&context,it->actions,it->startactionpos,m);
+				ACTIONRECORD::executeActions(currchar ,&context,it->actions.getPtr(),m);
 			}
 		}
 	}
@@ -2195,14 +2309,15 @@ DefineButtonTag::DefineButtonTag(RECORDHEADER h, std::istream& in, int version,
 	{
 		BUTTONCONDACTION a;
 		a.CondOverDownToOverUp=true; // clicked indicator
-		a.startactionpos=0;
-		a.actions.resize(len+ (datatag ? datatag->numbytes+datatagskipbytes : 0)+1,0);
+		uint32_t startactionpos=0;
+		std::vector<uint8_t> actions(len+ (datatag ? datatag->numbytes+datatagskipbytes : 0)+1,0);
 		if (datatag)
 		{
-			a.startactionpos=datatag->numbytes+datatagskipbytes;
-			memcpy(a.actions.data(),datatag->bytes,datatag->numbytes);
+			startactionpos=datatag->numbytes+datatagskipbytes;
+			memcpy(actions.data(),datatag->bytes,datatag->numbytes);
 		}
-		in.read((char*)a.actions.data()+a.startactionpos,len);
+		in.read((char*)actions.data()+startactionpos,len);
+		a.actions=_MR(new AVM1Code(root->getSystemState(),actions,startactionpos));
 		condactions.push_back(a);
 	}
 	else if(ActionOffset)
@@ -2217,14 +2332,15 @@ DefineButtonTag::DefineButtonTag(RECORDHEADER h, std::istream& in, int version,
 			len -= (((int)in.tellg())-pos);
 			pos = in.tellg();
 			int codesize = (r.CondActionSize ? r.CondActionSize-4 : len);
-			r.actions.resize(codesize+ (datatag ? datatag->numbytes+datatagskipbytes+4 : 0)+1,0);
-			r.startactionpos=0;
+			std::vector<uint8_t> actions(codesize+ (datatag ? datatag->numbytes+datatagskipbytes+4 : 0)+1,0);
+			uint32_t startactionpos=0;
 			if (datatag)
 			{
-				r.startactionpos=datatag->numbytes+datatagskipbytes+4;
-				memcpy(r.actions.data(),datatag->bytes,datatag->numbytes);
+				startactionpos=datatag->numbytes+datatagskipbytes+4;
+				memcpy(actions.data(),datatag->bytes,datatag->numbytes);
 			}
-			in.read((char*)r.actions.data()+r.startactionpos,codesize);
+			in.read((char*)actions.data()+startactionpos,codesize);
+			r.actions=_MR(new AVM1Code(root->getSystemState(),actions,startactionpos));
 			datatagskipbytes+= codesize+4;
 			len -= (((int)in.tellg())-pos);
 			condactions.push_back(r);
@@ -2722,37 +2838,17 @@ DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMov
 	uint8_t* inData=new(nothrow) uint8_t[dataSize];
 	in.read((char*)inData,dataSize);
 
-	loadBitmap(inData,dataSize);
-	delete[] inData;
-
-	//Read alpha data (if any)
+	//Read alpha data (if any), it is applied when the image is decoded
+	string alphaData;
 	int alphaSize=Header.getLength()-dataSize-6;
 	if(alphaSize>0) //If less that 0 the consistency check on tag size will stop later
 	{
-		//Create a zlib filter
-		string alphaData;
 		alphaData.resize(alphaSize);
 		in.read(&alphaData[0], alphaSize);
-		istringstream alphaStream(alphaData);
-		zlib_filter zf(alphaStream.rdbuf());
-		istream zfstream(&zf);
-		zfstream.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
-
-		//Catch the exception if the stream ends
-		try
-		{
-			//Set alpha
-			for(int32_t i=0;i<bitmap->getHeight();i++)
-			{
-				for(int32_t j=0;j<bitmap->getWidth();j++)
-					bitmap->setAlpha(j, i, zfstream.get());
-			}
-		}
-		catch(std::exception& e)
-		{
-			LOG(LOG_ERROR, "Exception while parsing Alpha data in DefineBitsJPEG3");
-		}
 	}
+
+	loadBitmap(inData,dataSize,nullptr,0,alphaData);
+	delete[] inData;
 }
 
 DefineBitsJPEG3Tag::~DefineBitsJPEG3Tag()
@@ -2879,20 +2975,21 @@ AVM1ActionTag::AVM1ActionTag(RECORDHEADER h, istream &s, RootMovieClip *root, Ad
 		skip(s);
 		return; 
 	}
-	startactionpos=0;
-	actions.resize(Header.getLength()+ (datatag ? datatag->numbytes+Header.getHeaderSize() : 0)+1,0);
+	uint32_t startactionpos=0;
+	std::vector<uint8_t> bytes(Header.getLength()+ (datatag ? datatag->numbytes+Header.getHeaderSize() : 0)+1,0);
 	if (datatag)
 	{
 		startactionpos=datatag->numbytes+Header.getHeaderSize();
-		memcpy(actions.data(),datatag->bytes,datatag->numbytes);
+		memcpy(bytes.data(),datatag->bytes,datatag->numbytes);
 	}
-	s.read((char*)actions.data()+startactionpos,Header.getLength());
+	s.read((char*)bytes.data()+startactionpos,Header.getLength());
+	actions=_MR(new AVM1Code(root->getSystemState(),bytes,startactionpos));
 }
 
 void AVM1ActionTag::execute(MovieClip* clip, AVM1context* context)
 {
 	std::map<uint32_t,asAtom> m;
-	ACTIONRECORD::executeActions(clip,context,actions, startactionpos,m);
+	ACTIONRECORD::executeActions(clip,context,actions.getPtr(),m);
 }
 
 AVM1InitActionTag::AVM1InitActionTag(RECORDHEADER h, istream &s, RootMovieClip *root, AdditionalDataTag* datatag):ControlTag(h)
@@ -2903,15 +3000,16 @@ AVM1InitActionTag::AVM1InitActionTag(RECORDHEADER h, istream &s, RootMovieClip *
 		skip(s);
 		return; 
 	}
-	startactionpos=0;
-	actions.resize(Header.getLength()+ (datatag ? datatag->numbytes+Header.getHeaderSize()+2 : 0)+1,0);
+	uint32_t startactionpos=0;
+	std::vector<uint8_t> bytes(Header.getLength()+ (datatag ? datatag->numbytes+Header.getHeaderSize()+2 : 0)+1,0);
 	if (datatag)
 	{
 		startactionpos=datatag->numbytes+Header.getHeaderSize()+2;// 2 bytes for SpriteID
-		memcpy(actions.data(),datatag->bytes,datatag->numbytes);
+		memcpy(bytes.data(),datatag->bytes,datatag->numbytes);
 	}
 	s >> SpriteId;
-	s.read((char*)actions.data()+startactionpos,Header.getLength()-2);
+	s.read((char*)bytes.data()+startactionpos,Header.getLength()-2);
+	actions=_MR(new AVM1Code(root->getSystemState(),bytes,startactionpos));
 	root->AVM1registerInitActionTag(SpriteId,this);
 }
 
@@ -2939,7 +3037,7 @@ void AVM1InitActionTag::executeDirect(MovieClip* clip) const
 	clip->incRef();
 	std::map<uint32_t,asAtom> m;
 	LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<clip->state.FP<<" initActions "<< clip->toDebugString()<<" "<<sprite->getId());
-	ACTIONRECORD::executeActions(clip,sprite->getAVM1Context(),actions,startactionpos,m);
+	ACTIONRECORD::executeActions(clip,sprite->getAVM1Context(),actions.getPtr(),m);
 	LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<clip->state.FP<<" initActions done "<< clip->toDebugString()<<" "<<sprite->getId());
 }
 
@@ -118,25 +118,23 @@ public:
 class AVM1ActionTag: public Tag
 {
 private:
-	std::vector<uint8_t> actions;
-	uint32_t startactionpos;
+	_NR<AVM1Code> actions;
 public:
 	AVM1ActionTag(RECORDHEADER h, std::istream& s,RootMovieClip* root, AdditionalDataTag* datatag);
 	TAGTYPE getType() const override { return AVM1ACTION_TAG; }
 	void execute(MovieClip* clip, AVM1context *context);
-	bool empty() { return actions.empty(); }
+	bool empty() { return actions.isNull(); }
 };
 class AVM1InitActionTag: public ControlTag
 {
 private:
 	UI16_SWF SpriteId;
-	std::vector<uint8_t> actions;
-	uint32_t startactionpos;
+	_NR<AVM1Code> actions;
 public:
 	AVM1InitActionTag(RECORDHEADER h, std::istream& s,RootMovieClip* root, AdditionalDataTag* datatag);
 	TAGTYPE getType() const override { return AVM1INITACTION_TAG; }
 	void execute(RootMovieClip* root) const override;
-	bool empty() { return actions.empty(); }
+	bool empty() { return actions.isNull(); }
 	void executeDirect(MovieClip *clip) const;
 };
 
@@ -628,12 +626,15 @@ public:
 };
 
 class BitmapContainer;
+class BitmapSource;
 
 class BitmapTag: public DictionaryTag
 {
 protected:
         _R<BitmapContainer> bitmap;
-    void loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData=nullptr, int tablesLen=0);
+    void loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData=nullptr, int tablesLen=0, const std::string& alphaData="");
+	// The bitmap is decoded on first use, or ahead of time by the thread pool
+	void setBitmapSource(BitmapSource* source, uint32_t w, uint32_t h);
 public:
 	BitmapTag(RECORDHEADER h,RootMovieClip* root);
 	ASObject* instance(Class_base* c=nullptr) override;
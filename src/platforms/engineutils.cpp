@@ -22,9 +22,9 @@
 #include "swf.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_mouse.h>
-#include <SDL2/SDL_mixer.h>
 #include "backends/input.h"
 #include "backends/rendering.h"
+#include "backends/audio.h"
 #include "backends/lsopengl.h"
 #include <pango/pangocairo.h>
 #include "version.h"
@@ -52,7 +52,7 @@ bool EngineData::mainthread_running = false;
 bool EngineData::sdl_needinit = true;
 bool EngineData::enablerendering = true;
 Semaphore EngineData::mainthread_initialized(0);
-EngineData::EngineData() : contextmenu(nullptr),contextmenurenderer(nullptr),sdleventtickjob(nullptr),incontextmenu(false),incontextmenupreparing(false),currentPixelBufPtr(nullptr),pixelBufferWidth(0),pixelBufferHeight(0),widget(0), width(0), height(0),needrenderthread(true),supportPackedDepthStencil(false),hasExternalFontRenderer(false)
+EngineData::EngineData() : contextmenu(nullptr),contextmenurenderer(nullptr),sdleventtickjob(nullptr),audiodevice(0),incontextmenu(false),incontextmenupreparing(false),currentPixelBufPtr(nullptr),pixelBufferWidth(0),pixelBufferHeight(0),widget(0), width(0), height(0),needrenderthread(true),supportPackedDepthStencil(false),hasExternalFontRenderer(false)
 {
 }
 
@@ -1272,64 +1272,9 @@ void EngineData::exec_glColorMask(bool red, bool green, bool blue, bool alpha)
 }
 
 
-void mixer_effect_ffmpeg_cb(int chan, void * stream, int len, void * udata)
+void mixer_audio_cb(void* udata, Uint8* stream, int len)
 {
-	AudioStream *s = (AudioStream*)udata;
-	if (!s)
-		return;
-	s->startMixing();
-	memset(stream,0,len);
-	uint32_t readcount = 0;
-	while (readcount < ((uint32_t)len))
-	{
-		uint32_t ret = s->getDecoder()->copyFrame((int16_t *)(((unsigned char*)stream)+readcount), ((uint32_t)len)-readcount);
-		if (!ret)
-			break;
-		readcount += ret;
-	}
-}
-
-
-
-int EngineData::audio_StreamInit(AudioStream* s)
-{
-	int mixer_channel = -1;
-
-	uint32_t len = LIGHTSPARK_AUDIO_BUFFERSIZE;
-
-	uint8_t *buf = new uint8_t[len];
-	memset(buf,0,len);
-	Mix_Chunk* chunk = Mix_QuickLoad_RAW(buf, len);
-	delete[] buf;
-
-
-	mixer_channel = Mix_PlayChannel(-1, chunk, -1);
-	Mix_RegisterEffect(mixer_channel, mixer_effect_ffmpeg_cb, NULL, s);
-	Mix_Resume(mixer_channel);
-	return mixer_channel;
-}
-
-void EngineData::audio_StreamPause(int channel, bool dopause)
-{
-	if (channel == -1)
-		return;
-	if(dopause)
-		Mix_Pause(channel);
-	else
-		Mix_Resume(channel);
-}
-
-void EngineData::audio_StreamSetVolume(int channel, double volume)
-{
-	int curvolume = SDL_MIX_MAXVOLUME * volume;
-	if (channel != -1)
-		Mix_Volume(channel, curvolume);
-}
-
-void EngineData::audio_StreamDeinit(int channel)
-{
-	if (channel != -1)
-		Mix_HaltChannel(channel);
+	((AudioManager*)udata)->mix((int16_t*)stream,len/4);
 }
 
 bool EngineData::audio_ManagerInit()
@@ -1344,12 +1289,32 @@ bool EngineData::audio_ManagerInit()
 
 void EngineData::audio_ManagerCloseMixer()
 {
-	Mix_CloseAudio();
-}
-
-bool EngineData::audio_ManagerOpenMixer()
-{
-	return Mix_OpenAudio (audio_getSampleRate(), AUDIO_S16, 2, LIGHTSPARK_AUDIO_BUFFERSIZE) >= 0;
+	if (audiodevice)
+		SDL_CloseAudioDevice(audiodevice);
+	audiodevice = 0;
+}
+
+bool EngineData::audio_ManagerOpenMixer(AudioManager* manager, int& samplerate)
+{
+	SDL_AudioSpec desired;
+	SDL_AudioSpec obtained;
+	SDL_zero(desired);
+	desired.freq = audio_getSampleRate();
+	desired.format = AUDIO_S16SYS;
+	desired.channels = 2;
+	desired.samples = LIGHTSPARK_AUDIO_BUFFERSIZE/4;
+	desired.callback = mixer_audio_cb;
+	desired.userdata = manager;
+	// the mixer resamples if the device does not support the rate of the decoders
+	audiodevice = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+	if (!audiodevice)
+	{
+		LOG(LOG_ERROR,"opening audio device failed:"<<SDL_GetError());
+		return false;
+	}
+	samplerate = obtained.freq;
+	SDL_PauseAudioDevice(audiodevice,0);
+	return true;
 }
 
 void EngineData::audio_ManagerDeinit()
@@ -1361,7 +1326,7 @@ void EngineData::audio_ManagerDeinit()
 
 int EngineData::audio_getSampleRate()
 {
-	return MIX_DEFAULT_FREQUENCY;
+	return LIGHTSPARK_AUDIO_SAMPLERATE;
 }
 
 IDrawable *EngineData::getTextRenderDrawable(const TextData &_textData, const MATRIX &_m, int32_t _x, int32_t _y, int32_t _w, int32_t _h, int32_t _rx, int32_t _ry, int32_t _rw, int32_t _rh, float _r, float _xs, float _ys, bool _im, bool _hm, float _s, float _a, const std::vector<IDrawable::MaskData> &_ms, float _redMultiplier, float _greenMultiplier, float _blueMultiplier, float _alphaMultiplier, float _redOffset, float _greenOffset, float _blueOffset, float _alphaOffset, bool smoothing)
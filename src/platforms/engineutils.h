@@ -31,6 +31,7 @@
 #include "flash/display/NativeMenuItem.h"
 
 #define LIGHTSPARK_AUDIO_BUFFERSIZE 8192
+#define LIGHTSPARK_AUDIO_SAMPLERATE 44100
 
 namespace lightspark
 {
@@ -43,7 +44,7 @@ namespace lightspark
 #define LS_USEREVENT_SELECTITEM_CONTEXTMENU EngineData::userevent+5
 class SystemState;
 class StreamCache;
-class AudioStream;
+class AudioManager;
 class ITickJob;
 
 enum DEPTH_FUNCTION { ALWAYS, EQUAL, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL, NEVER, NOT_EQUAL };
@@ -83,6 +84,7 @@ private:
 	int32_t contextmenuheight;
 	void openContextMenuIntern(InteractiveObject *dispatcher);
 	ITickJob* sdleventtickjob;
+	SDL_AudioDeviceID audiodevice;
 	std::string getsharedobjectfilename(const tiny_string &name);
 protected:
 	tiny_string sharedObjectDatapath;
@@ -289,13 +291,10 @@ public:
 	virtual void exec_glColorMask(bool red, bool green, bool blue, bool alpha);
 
 	// Audio handling
-	virtual int audio_StreamInit(AudioStream* s);
-	virtual void audio_StreamPause(int channel, bool dopause);
-	virtual void audio_StreamSetVolume(int channel, double volume);
-	virtual void audio_StreamDeinit(int channel);
 	virtual bool audio_ManagerInit();
 	virtual void audio_ManagerCloseMixer();
-	virtual bool audio_ManagerOpenMixer();
+	// opens the audio output, which gets its samples from manager->mix(), samplerate is set to the rate of the output
+	virtual bool audio_ManagerOpenMixer(AudioManager* manager, int& samplerate);
 	virtual void audio_ManagerDeinit();
 	virtual int audio_getSampleRate();
 	
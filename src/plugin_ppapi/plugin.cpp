@@ -2524,54 +2524,7 @@ void ppPluginEngineData::exec_glColorMask(bool red, bool green, bool blue, bool
 
 void audio_callback(void* sample_buffer,uint32_t buffer_size_in_bytes,PP_TimeDelta latency,void* user_data)
 {
-	AudioStream *s = (AudioStream*)user_data;
-	if (!s)
-		return;
-	s->startMixing();
-	uint32_t readcount = 0;
-	while (readcount < buffer_size_in_bytes)
-	{
-		uint32_t ret = s->getDecoder()->copyFrame((int16_t *)(((unsigned char*)sample_buffer)+readcount), buffer_size_in_bytes-readcount);
-		if (!ret)
-			break;
-		readcount += ret;
-	}
-	if (s->getVolume() != 1.0)
-	{
-		int16_t *p = (int16_t *)sample_buffer;
-		for (uint32_t i = 0; i < readcount/2; i++)
-		{
-			*p = (*p)*s->getVolume();
-			p++;
-		}
-	}
-}
-
-int ppPluginEngineData::audio_StreamInit(AudioStream *s)
-{
-	PP_Resource res = g_audio_interface->Create(instance->m_ppinstance,audioconfig,audio_callback,s);
-	if (res != 0)
-		g_audio_interface->StartPlayback(res);
-	else
-		LOG(LOG_ERROR,"creating audio interface failed");
-	return res;
-}
-
-void ppPluginEngineData::audio_StreamPause(int channel, bool dopause)
-{
-	if (dopause)
-		g_audio_interface->StopPlayback(channel);
-	else
-		g_audio_interface->StartPlayback(channel);
-}
-
-void ppPluginEngineData::audio_StreamSetVolume(int channel, double volume)
-{
-}
-
-void ppPluginEngineData::audio_StreamDeinit(int channel)
-{
-	g_audio_interface->StopPlayback(channel);
+	((AudioManager*)user_data)->mix((int16_t*)sample_buffer,buffer_size_in_bytes/4);
 }
 
 bool ppPluginEngineData::audio_ManagerInit()
@@ -2583,10 +2536,24 @@ bool ppPluginEngineData::audio_ManagerInit()
 
 void ppPluginEngineData::audio_ManagerCloseMixer()
 {
+	if (audioresource)
+	{
+		g_audio_interface->StopPlayback(audioresource);
+		g_core_interface->ReleaseResource(audioresource);
+	}
+	audioresource = 0;
 }
 
-bool ppPluginEngineData::audio_ManagerOpenMixer()
+bool ppPluginEngineData::audio_ManagerOpenMixer(AudioManager* manager, int& samplerate)
 {
+	audioresource = g_audio_interface->Create(instance->m_ppinstance,audioconfig,audio_callback,manager);
+	if (audioresource == 0)
+	{
+		LOG(LOG_ERROR,"creating audio interface failed");
+		return false;
+	}
+	samplerate = PP_AUDIOSAMPLERATE_44100;
+	g_audio_interface->StartPlayback(audioresource);
 	return true;
 }
 
@@ -181,7 +181,8 @@ private:
 public:
 	SystemState* sys;
 	PP_Resource audioconfig;
-	ppPluginEngineData(ppPluginInstance* i, uint32_t w, uint32_t h,SystemState* _sys) : EngineData(), instance(i),buffersswapped(false),sys(_sys),audioconfig(0)
+	PP_Resource audioresource;
+	ppPluginEngineData(ppPluginInstance* i, uint32_t w, uint32_t h,SystemState* _sys) : EngineData(), instance(i),buffersswapped(false),sys(_sys),audioconfig(0),audioresource(0)
 	{
 		contextmenucallback.func = contextmenucallbackfunc;
 		contextmenucallback.user_data = (void*)this;
@@ -325,13 +326,9 @@ public:
 	void exec_glColorMask(bool red, bool green, bool blue, bool alpha) override;
 
 	// Audio handling
-	virtual int audio_StreamInit(AudioStream* s) override;
-	virtual void audio_StreamPause(int channel, bool dopause) override;
-	virtual void audio_StreamSetVolume(int channel, double volume) override;
-	virtual void audio_StreamDeinit(int channel) override;
 	virtual bool audio_ManagerInit() override;
 	virtual void audio_ManagerCloseMixer() override;
-	virtual bool audio_ManagerOpenMixer() override;
+	virtual bool audio_ManagerOpenMixer(AudioManager* manager, int& samplerate) override;
 	virtual void audio_ManagerDeinit() override;
 	virtual int audio_getSampleRate() override;
 
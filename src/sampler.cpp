@@ -0,0 +1,586 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <fstream>
+#include <cstring>
+#include <zlib.h>
+#include "sampler.h"
+#include "swf.h"
+#include "asobject.h"
+#include "logger.h"
+#include "scripting/abc.h"
+#include "scripting/toplevel/toplevel.h"
+
+using namespace lightspark;
+using namespace std;
+
+static thread_local uint32_t suspendedOnThread=0;
+//Allocations of this thread left until the next one is recorded in the output file
+static thread_local uint32_t allocationCountdown=SAMPLER_ALLOCATION_INTERVAL;
+
+SamplerSuspender::SamplerSuspender()
+{
+	suspendedOnThread++;
+}
+
+SamplerSuspender::~SamplerSuspender()
+{
+	suspendedOnThread--;
+}
+
+Sampler::Sampler(SystemState* s):sys(s),startTime(g_get_monotonic_time()),nextId(1),droppedSamples(0),firstVisible(0),
+	sampling(false),ticking(false),internalAllocs(false),stopped(false)
+{
+	//Stack 0 is the empty stack, it is used when no ActionScript code is running
+	stacks.emplace_back();
+	stackIds[stacks.back()]=0;
+}
+
+Sampler::~Sampler()
+{
+	assert(!ticking);
+}
+
+void Sampler::update()
+{
+	bool active=isActive();
+	memory_reporter::sampleAllocations=active;
+	if(active && !ticking)
+	{
+		sys->addTick(SAMPLER_INTERVAL,this);
+		ticking=true;
+	}
+	else if(!active && ticking)
+	{
+		sys->removeJob(this);
+		ticking=false;
+	}
+	if(!active)
+	{
+		//Objects deleted from now on are not reported anymore
+		liveObjects.clear();
+	}
+}
+
+uint32_t Sampler::captureStack()
+{
+	ABCVm* vm=getVm(sys);
+	if(vm==nullptr)
+		return 0;
+	/*
+	 * The stack is read while the vm keeps running: the depth is clamped to the size of
+	 * the array and a frame that is pushed or popped meanwhile may be missing or stale,
+	 * which is acceptable for a statistical profile.
+	 */
+	ABCVm::stacktrace_entry* entries=vm->stacktrace;
+	uint32_t depth=vm->cur_recursion;
+	if(depth>vm->limits.max_recursion)
+		depth=vm->limits.max_recursion;
+	currentStack.clear();
+	for(uint32_t i=0;i<depth;i++)
+	{
+		Frame f;
+		f.className=entries[i].className;
+		f.name=entries[i].name;
+		uint64_t key=(uint64_t(f.className)<<32)|f.name;
+		auto it=frameIds.find(key);
+		if(it==frameIds.end())
+		{
+			it=frameIds.insert(make_pair(key,uint32_t(frames.size()))).first;
+			frames.push_back(f);
+		}
+		currentStack.push_back(it->second);
+	}
+	auto it=stackIds.find(currentStack);
+	if(it!=stackIds.end())
+		return it->second;
+	uint32_t ret=stacks.size();
+	stacks.push_back(currentStack);
+	stackIds[currentStack]=ret;
+	return ret;
+}
+
+bool Sampler::addSample(const SampleData& s)
+{
+	if(samples.size()>=SAMPLER_MAX_SAMPLES)
+	{
+		droppedSamples++;
+		return false;
+	}
+	samples.push_back(s);
+	return true;
+}
+
+void Sampler::clearLocked()
+{
+	if(!outputFile.empty())
+	{
+		//The samples are still needed for the output file, only hide them
+		firstVisible=samples.size();
+		return;
+	}
+	samples.clear();
+	firstVisible=0;
+}
+
+void Sampler::tick()
+{
+	Locker l(mutex);
+	if(!ticking)
+		return;
+	uint32_t stack=captureStack();
+	//Time spent outside of ActionScript code is not sampled
+	if(stack==0)
+		return;
+	SampleData s;
+	s.time=g_get_monotonic_time()-startTime;
+	s.id=0;
+	s.object=nullptr;
+	s.type=nullptr;
+	s.stack=stack;
+	s.size=0;
+	s.weight=1;
+	s.sampleType=CPU_SAMPLE;
+	addSample(s);
+}
+
+void Sampler::startSampling()
+{
+	Locker l(mutex);
+	sampling=true;
+	update();
+}
+
+void Sampler::pauseSampling()
+{
+	Locker l(mutex);
+	sampling=false;
+	update();
+}
+
+void Sampler::stopSampling()
+{
+	Locker l(mutex);
+	sampling=false;
+	clearLocked();
+	update();
+}
+
+void Sampler::clearSamples()
+{
+	Locker l(mutex);
+	clearLocked();
+}
+
+void Sampler::setInternalAllocs(bool b)
+{
+	Locker l(mutex);
+	internalAllocs=b;
+}
+
+uint32_t Sampler::getSampleCount()
+{
+	Locker l(mutex);
+	return samples.size()-firstVisible;
+}
+
+void Sampler::getSamples(vector<SampleData>& out, unordered_map<uint32_t,vector<tiny_string>>& stackFrames)
+{
+	Locker l(mutex);
+	out.assign(samples.begin()+firstVisible,samples.end());
+	for(auto it=out.begin();it!=out.end();++it)
+	{
+		if(it->stack==0 || stackFrames.find(it->stack)!=stackFrames.end())
+			continue;
+		const vector<uint32_t>& stack=stacks[it->stack];
+		vector<tiny_string>& names=stackFrames[it->stack];
+		for(auto f=stack.rbegin();f!=stack.rend();++f)
+			names.push_back(getFrameName(*f));
+	}
+}
+
+ASObject* Sampler::getLiveObject(uint64_t id, ASObject* o)
+{
+	Locker l(mutex);
+	auto it=liveObjects.find(o);
+	if(it==liveObjects.end() || it->second.id!=id)
+		return nullptr;
+	/*
+	 * Objects are removed from liveObjects when they are destructed, but the
+	 * subclasses run their destruct() before that. An object whose last reference
+	 * is being released must not get a new one.
+	 */
+	if(o->getInDestruction() || o->getCached() || o->getRefCount()<1)
+		return nullptr;
+	o->incRef();
+	return o;
+}
+
+void Sampler::setOutput(const tiny_string& f)
+{
+	Locker l(mutex);
+	outputFile=f;
+	update();
+}
+
+uint32_t Sampler::getObjectSize(ASObject* o)
+{
+#ifdef MEMORY_USAGE_PROFILING
+	return memory_reporter::getAccountedSize(dynamic_cast<const void*>(o));
+#else
+	Locker l(mutex);
+	auto it=liveObjects.find(o);
+	if(it!=liveObjects.end() && it->second.size)
+		return it->second.size;
+	auto c=classSizes.find(o->getClass());
+	if(c!=classSizes.end())
+		return c->second;
+	return sizeof(ASObject);
+#endif
+}
+
+void Sampler::recordAllocation(ASObject* o, uint32_t size)
+{
+	if(suspendedOnThread)
+		return;
+	//The output file only needs a statistical sample of the allocations, the others are skipped without locking
+	if(!ACQUIRE_READ(sampling))
+	{
+		if(--allocationCountdown>0)
+			return;
+		allocationCountdown=SAMPLER_ALLOCATION_INTERVAL;
+	}
+	Locker l(mutex);
+	if(!isActive())
+		return;
+	uint32_t interval=sampling ? 1 : SAMPLER_ALLOCATION_INTERVAL;
+	uint32_t stack=captureStack();
+	if(stack==0 && !internalAllocs)
+		return;
+	if(size)
+		classSizes[o->getClass()]=size;
+	else
+	{
+		auto it=classSizes.find(o->getClass());
+		if(it!=classSizes.end())
+			size=it->second;
+	}
+	SampleData s;
+	s.time=g_get_monotonic_time()-startTime;
+	s.id=nextId++;
+	s.object=o;
+	s.type=o->getClass();
+	s.stack=stack;
+	s.size=size;
+	s.weight=interval;
+	s.sampleType=NEW_OBJECT_SAMPLE;
+	if(!addSample(s))
+		return;
+	LiveObject& live=liveObjects[o];
+	live.id=s.id;
+	live.size=size;
+}
+
+void Sampler::recordDeletion(ASObject* o)
+{
+	Locker l(mutex);
+	auto it=liveObjects.find(o);
+	if(it==liveObjects.end())
+		return;
+	SampleData s;
+	s.time=g_get_monotonic_time()-startTime;
+	s.id=it->second.id;
+	s.object=nullptr;
+	s.type=nullptr;
+	s.stack=0;
+	s.size=it->second.size;
+	s.weight=1;
+	s.sampleType=DELETE_OBJECT_SAMPLE;
+	liveObjects.erase(it);
+	addSample(s);
+}
+
+tiny_string Sampler::getFrameName(uint32_t frame) const
+{
+	const Frame& f=frames[frame];
+	tiny_string name=sys->getStringFromUniqueId(f.name);
+	if(name.empty())
+		name="<anonymous>";
+	if(f.className==BUILTIN_STRINGS::EMPTY)
+		return name;
+	return sys->getStringFromUniqueId(f.className)+"/"+name;
+}
+
+void Sampler::stop()
+{
+	Locker l(mutex);
+	if(stopped)
+		return;
+	stopped=true;
+	update();
+	if(outputFile.empty())
+		return;
+	ofstream f(outputFile.raw_buf(),ios_base::out|ios_base::binary|ios_base::trunc);
+	if(!f)
+	{
+		LOG(LOG_ERROR,"Sampler: unable to open " << outputFile);
+		return;
+	}
+	if(outputFile.endsWith(".json"))
+		writeChromeTrace(f);
+	else
+		writePprof(f);
+	LOG(LOG_INFO,"Sampler: " << samples.size() << " samples written to " << outputFile);
+	if(droppedSamples)
+		LOG(LOG_ERROR,"Sampler: " << droppedSamples << " samples dropped, the buffer was full");
+}
+
+namespace
+{
+// minimal protobuf encoder for the pprof format (github.com/google/pprof/proto/profile.proto)
+class ProtoBuffer
+{
+public:
+	string data;
+	void varint(uint64_t v)
+	{
+		while(v>=0x80)
+		{
+			data.push_back(char((v&0x7f)|0x80));
+			v>>=7;
+		}
+		data.push_back(char(v));
+	}
+	void intField(uint32_t field, uint64_t v)
+	{
+		varint(field<<3);
+		varint(v);
+	}
+	void bytesField(uint32_t field, const string& v)
+	{
+		varint((field<<3)|2);
+		varint(v.size());
+		data+=v;
+	}
+	void packedField(uint32_t field, const vector<uint64_t>& v)
+	{
+		ProtoBuffer packed;
+		for(auto it=v.begin();it!=v.end();++it)
+			packed.varint(*it);
+		bytesField(field,packed.data);
+	}
+};
+
+class StringTable
+{
+public:
+	vector<string> strings;
+	unordered_map<string,uint64_t> ids;
+	StringTable()
+	{
+		//pprof requires the empty string to be the first one
+		get("");
+	}
+	uint64_t get(const string& s)
+	{
+		auto it=ids.find(s);
+		if(it!=ids.end())
+			return it->second;
+		uint64_t ret=strings.size();
+		strings.push_back(s);
+		ids[s]=ret;
+		return ret;
+	}
+};
+
+string valueType(StringTable& strings, const char* type, const char* unit)
+{
+	ProtoBuffer b;
+	b.intField(1,strings.get(type));
+	b.intField(2,strings.get(unit));
+	return b.data;
+}
+
+void writeJSONString(ostream& out, const tiny_string& s)
+{
+	out << '"';
+	for(const char* c=s.raw_buf();*c;c++)
+	{
+		if(*c=='"' || *c=='\\')
+			out << '\\' << *c;
+		else if(uint8_t(*c)<0x20)
+			out << ' ';
+		else
+			out << *c;
+	}
+	out << '"';
+}
+}
+
+void Sampler::writePprof(ostream& out)
+{
+	StringTable strings;
+	ProtoBuffer profile;
+	//values of every sample: number of cpu samples, cpu time, allocated objects, allocated bytes
+	profile.bytesField(1,valueType(strings,"samples","count"));
+	profile.bytesField(1,valueType(strings,"cpu","nanoseconds"));
+	profile.bytesField(1,valueType(strings,"alloc_objects","count"));
+	profile.bytesField(1,valueType(strings,"alloc_space","bytes"));
+	//Aggregate the samples by stack
+	vector<uint64_t> zero(4,0);
+	map<uint32_t,vector<uint64_t>> values;
+	for(auto it=samples.begin();it!=samples.end();++it)
+	{
+		if(it->stack==0)
+			continue;
+		if(it->sampleType==CPU_SAMPLE)
+		{
+			vector<uint64_t>& v=values.insert(make_pair(it->stack,zero)).first->second;
+			v[0]++;
+			v[1]+=SAMPLER_INTERVAL*1000000;
+		}
+		else if(it->sampleType==NEW_OBJECT_SAMPLE)
+		{
+			vector<uint64_t>& v=values.insert(make_pair(it->stack,zero)).first->second;
+			v[2]+=it->weight;
+			v[3]+=uint64_t(it->size)*it->weight;
+		}
+	}
+	for(auto it=values.begin();it!=values.end();++it)
+	{
+		//pprof expects the innermost frame first, location ids are the frame ids + 1
+		const vector<uint32_t>& stack=stacks[it->first];
+		vector<uint64_t> locations;
+		for(auto f=stack.rbegin();f!=stack.rend();++f)
+			locations.push_back(*f+1);
+		ProtoBuffer sample;
+		sample.packedField(1,locations);
+		sample.packedField(2,it->second);
+		profile.bytesField(2,sample.data);
+	}
+	for(uint32_t i=0;i<frames.size();i++)
+	{
+		ProtoBuffer line;
+		line.intField(1,i+1);
+		ProtoBuffer location;
+		location.intField(1,i+1);
+		location.bytesField(4,line.data);
+		profile.bytesField(4,location.data);
+	}
+	for(uint32_t i=0;i<frames.size();i++)
+	{
+		uint64_t name=strings.get(string(getFrameName(i).raw_buf()));
+		ProtoBuffer function;
+		function.intField(1,i+1);
+		function.intField(2,name);
+		function.intField(3,name);
+		profile.bytesField(5,function.data);
+	}
+	//the string table has to be complete before the fields that follow it are encoded
+	uint64_t periodType=strings.get("cpu");
+	uint64_t periodUnit=strings.get("nanoseconds");
+	for(auto it=strings.strings.begin();it!=strings.strings.end();++it)
+		profile.bytesField(6,*it);
+	uint64_t duration=(g_get_monotonic_time()-startTime)*1000;
+	profile.intField(9,g_get_real_time()*1000-duration);
+	profile.intField(10,duration);
+	ProtoBuffer period;
+	period.intField(1,periodType);
+	period.intField(2,periodUnit);
+	profile.bytesField(11,period.data);
+	profile.intField(12,SAMPLER_INTERVAL*1000000);
+
+	//pprof files are gzip compressed
+	z_stream strm;
+	memset(&strm,0,sizeof(strm));
+	if(deflateInit2(&strm,Z_DEFAULT_COMPRESSION,Z_DEFLATED,15+16,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+	{
+		LOG(LOG_ERROR,"Sampler: unable to initialize zlib");
+		return;
+	}
+	strm.next_in=(Bytef*)profile.data.data();
+	strm.avail_in=profile.data.size();
+	char buf[16384];
+	int ret;
+	do
+	{
+		strm.next_out=(Bytef*)buf;
+		strm.avail_out=sizeof(buf);
+		ret=deflate(&strm,Z_FINISH);
+		out.write(buf,sizeof(buf)-strm.avail_out);
+	}
+	while(ret==Z_OK);
+	deflateEnd(&strm);
+}
+
+void Sampler::writeChromeTrace(ostream& out)
+{
+	//The cpu samples are converted into begin and end events of the frames that change between two samples
+	out << "{\"traceEvents\":[" << endl;
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"ActionScript\"}}";
+	const uint64_t interval=SAMPLER_INTERVAL*1000;
+	vector<uint32_t> open;
+	uint64_t lastTime=0;
+	auto closeFrames=[&](uint32_t keep, uint64_t time)
+	{
+		while(open.size()>keep)
+		{
+			out << ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":1,\"ts\":" << time << "}";
+			open.pop_back();
+		}
+	};
+	for(auto it=samples.begin();it!=samples.end();++it)
+	{
+		if(it->sampleType==NEW_OBJECT_SAMPLE)
+		{
+			out << ",\n{\"name\":";
+			writeJSONString(out,it->type ? tiny_string("new ")+sys->getStringFromUniqueId(it->type->class_name.nameId) : tiny_string("new"));
+			out << ",\"cat\":\"allocation\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":1,\"ts\":" << it->time
+				<< ",\"args\":{\"size\":" << it->size << ",\"count\":" << it->weight << "}}";
+			continue;
+		}
+		if(it->sampleType!=CPU_SAMPLE)
+			continue;
+		//Samples are missing while no ActionScript code runs, close everything across the gap
+		if(it->time>lastTime+2*interval)
+			closeFrames(0,lastTime+interval);
+		const vector<uint32_t>& stack=stacks[it->stack];
+		uint32_t common=0;
+		while(common<open.size() && common<stack.size() && open[common]==stack[common])
+			common++;
+		closeFrames(common,it->time);
+		for(uint32_t i=common;i<stack.size();i++)
+		{
+			out << ",\n{\"name\":";
+			writeJSONString(out,getFrameName(stack[i]));
+			out << ",\"cat\":\"as3\",\"ph\":\"B\",\"pid\":1,\"tid\":1,\"ts\":" << it->time << "}";
+			open.push_back(stack[i]);
+		}
+		lastTime=it->time;
+	}
+	closeFrames(0,lastTime+interval);
+	out << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+}
+
+void Sampler::dumpStatistics(ostream& out) const
+{
+	Locker l(mutex);
+	out << "# sampler: " << samples.size() << " samples, " << droppedSamples << " dropped, "
+		<< stacks.size() << " stacks, " << frames.size() << " frames, " << liveObjects.size() << " tracked objects" << endl;
+}
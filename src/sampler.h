@@ -0,0 +1,164 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef SAMPLER_H
+#define SAMPLER_H 1
+
+#include "compat.h"
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <ostream>
+#include "threading.h"
+#include "timer.h"
+#include "tiny_string.h"
+
+namespace lightspark
+{
+
+//Interval between two samples of the call stack, in milliseconds
+#define SAMPLER_INTERVAL 1
+//When writing a profile file only one allocation every SAMPLER_ALLOCATION_INTERVAL is recorded,
+//samples requested through flash.sampler record every allocation
+#define SAMPLER_ALLOCATION_INTERVAL 512
+//Maximum number of samples kept, newer samples are dropped
+#define SAMPLER_MAX_SAMPLES (4*1024*1024)
+
+class ASObject;
+class Class_base;
+class SystemState;
+
+/*
+ * Sampling profiler behind the flash.sampler package and the --sampler-output option.
+ * The timer thread periodically copies the ActionScript call stack of the vm (ABCVm::stacktrace)
+ * without stopping it, so sampling costs nothing on the vm thread. Allocations and deletions of
+ * ASObjects are reported by hooks in ASObject that are only active while sampling.
+ * Frames and stacks are interned, a sample only stores the id of its stack.
+ * When an output file is set the samples are written at shutdown as a gzipped pprof profile
+ * or, if the file name ends with ".json", as a Chrome trace.
+ */
+class Sampler: public ITickJob
+{
+public:
+	enum SAMPLE_TYPE { CPU_SAMPLE=0, NEW_OBJECT_SAMPLE, DELETE_OBJECT_SAMPLE };
+	struct Frame
+	{
+		uint32_t className;
+		uint32_t name;
+	};
+	struct SampleData
+	{
+		// microseconds since the sampler was created
+		uint64_t time;
+		// id of the allocated object, 0 for cpu samples
+		uint64_t id;
+		// the allocated object, it must only be accessed while getLiveObject() returns it
+		ASObject* object;
+		Class_base* type;
+		uint32_t stack;
+		// size of the object, estimated from its class if it was reused from a free list
+		uint32_t size;
+		// number of allocations represented by this sample
+		uint32_t weight;
+		SAMPLE_TYPE sampleType;
+	};
+private:
+	struct LiveObject
+	{
+		uint64_t id;
+		uint32_t size;
+	};
+	SystemState* sys;
+	mutable Mutex mutex;
+	std::vector<Frame> frames;
+	std::unordered_map<uint64_t,uint32_t> frameIds;
+	// frames of every stack, outermost frame first, stack 0 is the empty stack
+	std::vector<std::vector<uint32_t>> stacks;
+	std::map<std::vector<uint32_t>,uint32_t> stackIds;
+	std::vector<uint32_t> currentStack;
+	std::vector<SampleData> samples;
+	std::unordered_map<ASObject*,LiveObject> liveObjects;
+	// last allocation size seen for every class, used for objects reused from a free list
+	std::unordered_map<Class_base*,uint32_t> classSizes;
+	tiny_string outputFile;
+	uint64_t startTime;
+	uint64_t nextId;
+	uint64_t droppedSamples;
+	// first sample returned by getSamples, samples before it are only kept for the output file
+	uint32_t firstVisible;
+	// sampling requested by flash.sampler.startSampling, also read without the mutex by recordAllocation
+	ACQUIRE_RELEASE_FLAG(sampling);
+	bool ticking;
+	bool internalAllocs;
+	bool stopped;
+	bool isActive() const { return !stopped && (sampling || !outputFile.empty()); }
+	// starts or stops the tick job and the allocation hooks according to the current state
+	void update();
+	// interns the current call stack of the vm, the mutex must be held
+	uint32_t captureStack();
+	bool addSample(const SampleData& s);
+	void clearLocked();
+	tiny_string getFrameName(uint32_t frame) const;
+	void writePprof(std::ostream& out);
+	void writeChromeTrace(std::ostream& out);
+public:
+	Sampler(SystemState* s);
+	~Sampler();
+	void tick() override;
+	void tickFence() override {}
+	// flash.sampler interface
+	void startSampling();
+	void pauseSampling();
+	void stopSampling();
+	void clearSamples();
+	void setInternalAllocs(bool b);
+	uint32_t getSampleCount();
+	/*
+	 * Copies the visible samples and the frames of their stacks, innermost frame first.
+	 * No ASObject may be created while the lock is held, as that would add samples.
+	 */
+	void getSamples(std::vector<SampleData>& out, std::unordered_map<uint32_t,std::vector<tiny_string>>& stackFrames);
+	// returns the object with the given id if it has not been deleted and is not being destroyed, with an added reference
+	ASObject* getLiveObject(uint64_t id, ASObject* o);
+	// start sampling until shutdown and write the samples to f
+	void setOutput(const tiny_string& f);
+	// stops sampling and writes the output file, called at shutdown
+	void stop();
+	// size of o as reported by flash.sampler.getSize
+	uint32_t getObjectSize(ASObject* o);
+	// called by the hooks in ASObject, size is 0 if it is not known.
+	// Only the allocations that are sampled take the mutex
+	void recordAllocation(ASObject* o, uint32_t size);
+	void recordDeletion(ASObject* o);
+	void dumpStatistics(std::ostream& out) const;
+};
+
+/*
+ * Allocations of the current thread are not recorded while an instance exists,
+ * used while creating the objects that describe the samples
+ */
+class SamplerSuspender
+{
+public:
+	SamplerSuspender();
+	~SamplerSuspender();
+};
+
+}
+#endif /* SAMPLER_H */
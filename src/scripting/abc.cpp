@@ -73,10 +73,14 @@
 #include <limits>
 #include <cmath>
 #include "swf.h"
+#include "cyclecollector.h"
+#include "backends/bitmapdecoder.h"
 #include "scripting/class.h"
 #include "exceptions.h"
 #include "scripting/abc.h"
+#include "scripting/abc_jit.h"
 #include"backends/rendering.h"
+#include "tracing.h"
 
 using namespace std;
 using namespace lightspark;
@@ -927,6 +931,9 @@ ABCVm::ABCVm(SystemState* s, MemoryAccount* m):m_sys(s),status(CREATED),isIdle(t
 	limits.script_timeout = 20;
 	m_sys=s;
 	stacktrace=new stacktrace_entry[256];
+#ifdef BASELINE_JIT_ENABLED
+	jit=nullptr;
+#endif
 }
 
 void ABCVm::start()
@@ -984,6 +991,9 @@ ABCVm::~ABCVm()
 		it++;
 	}
 	delete[] stacktrace;
+#ifdef BASELINE_JIT_ENABLED
+	delete jit;
+#endif
 }
 
 int ABCVm::getEventQueueSize()
@@ -1155,6 +1165,7 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 {
 	//LOG(LOG_INFO,"handleEvent:"<<e.second->type);
 	e.second->check();
+	LS_TRACE_SCOPE_DETAIL("event","handleEvent",m_sys->getUniqueStringId(e.second->type));
 	if(!e.first.isNull())
 		publicHandleEvent(e.first.getPtr(), e.second);
 	else
@@ -1179,6 +1190,8 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 				shuttingdown=true;
 				break;
 			}
+			case SYNC:
+				break;
 			case FUNCTION:
 			{
 				FunctionEvent* ev=static_cast<FunctionEvent*>(e.second.getPtr());
@@ -1256,6 +1269,7 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 			{
 				InitFrameEvent* ev=static_cast<InitFrameEvent*>(e.second.getPtr());
 				LOG(LOG_CALLS,"INIT_FRAME");
+				LS_TRACE_SCOPE("frame","initFrame");
 				assert(!ev->clip.isNull());
 				ev->clip->initFrame();
 				break;
@@ -1264,6 +1278,7 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 			{
 				ExecuteFrameScriptEvent* ev=static_cast<ExecuteFrameScriptEvent*>(e.second.getPtr());
 				LOG(LOG_CALLS,"EXECUTE_FRAMESCRIPT");
+				LS_TRACE_SCOPE("frame","executeFrameScript");
 				assert(!ev->clip.isNull());
 				ev->clip->executeFrameScript();
 				if (ev->clip == m_sys->stage)
@@ -1275,12 +1290,44 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 				Locker l(m_sys->getRenderThread()->mutexRendering);
 				AdvanceFrameEvent* ev=static_cast<AdvanceFrameEvent*>(e.second.getPtr());
 				LOG(LOG_CALLS,"ADVANCE_FRAME");
+				LS_TRACE_SCOPE("frame","advanceFrame");
 				if (ev->clip)
 					ev->clip->advanceFrame();
 				else
 					m_sys->stage->advanceFrame();
 				break;
 			}
+			case BROADCAST_EVENT:
+			{
+				BroadcastEvent* ev=static_cast<BroadcastEvent*>(e.second.getPtr());
+				LS_TRACE_SCOPE_DETAIL("frame","broadcast",m_sys->getUniqueStringId(ev->event->type));
+				uint64_t start=g_get_monotonic_time();
+				for(auto it=ev->listeners.begin();it!=ev->listeners.end();++it)
+				{
+					try
+					{
+						publicHandleEvent(it->getPtr(),ev->event);
+					}
+					catch(ASObject*& exception)
+					{
+						(*it)->afterHandleEvent(ev->event.getPtr());
+						//Like separate events in handleFrontEvent, the other listeners are still reached if an ASError is ignored
+						if(!m_sys->ignoreUnhandledExceptions || !exception->is<ASError>())
+							throw;
+						LOG(LOG_ERROR,_("Unhandled ActionScript exception in VM ") << exception->toString());
+						LOG(LOG_ERROR,_("Unhandled ActionScript exception in VM ") << exception->as<ASError>()->getStackTraceString());
+						continue;
+					}
+					catch(...)
+					{
+						(*it)->afterHandleEvent(ev->event.getPtr());
+						throw;
+					}
+					(*it)->afterHandleEvent(ev->event.getPtr());
+				}
+				LOG(LOG_CALLS,"BROADCAST " << ev->event->type << " to " << ev->listeners.size() << " listeners in " << (g_get_monotonic_time()-start) << " us");
+				break;
+			}
 			case ROOTCONSTRUCTEDEVENT:
 			{
 				RootConstructedEvent* ev=static_cast<RootConstructedEvent*>(e.second.getPtr());
@@ -1370,6 +1417,8 @@ bool ABCVm::prependEvent(_NR<EventDispatcher> obj ,_R<Event> ev, bool force)
 		events_queue.push_front(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
 	else
 		events_queue.push_back(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
+	if(EngineClock::isVirtual())
+		EngineClock::vmBusy();
 	sem_event_cond.signal();
 	return true;
 }
@@ -1404,6 +1453,9 @@ bool ABCVm::addEvent(_NR<EventDispatcher> obj ,_R<Event> ev)
 		obj->onNewEvent(ev.getPtr());
 	events_queue.push_back(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
 	RELEASE_WRITE(ev->queued,true);
+	//The virtual clock may not advance before the VM has handled the event
+	if(EngineClock::isVirtual())
+		EngineClock::vmBusy();
 	sem_event_cond.signal();
 	return true;
 }
@@ -1689,6 +1741,8 @@ void ABCContext::runScriptInit(unsigned int i, asAtom &g)
 int ABCVm::Run(void* d)
 {
 	ABCVm* th = (ABCVm*)d;
+	//Objects of the primordial worker are allocated without locking from this thread
+	SlabAllocatorScope allocatorScope;
 	//Spin wait until the VM is aknowledged by the SystemState
 	setTLSSys(th->m_sys);
 	while(getVm(th->m_sys)!=th)
@@ -1696,6 +1750,9 @@ int ABCVm::Run(void* d)
 
 	/* set TLS variable for isVmThread() */
         tls_set(is_vm_thread, GINT_TO_POINTER(1));
+	//Objects released by this thread are buffered as cycle candidates
+	th->m_sys->cycleCollector->registerThread();
+	Tracer::setThreadName("VM");
 #ifndef NDEBUG
 	inStartupOrClose= false;
 #endif
@@ -1768,6 +1825,9 @@ int ABCVm::Run(void* d)
 		th->FPM->add(llvm::createDeadStoreEliminationPass());
 
 		th->registerFunctions();
+#endif
+#ifdef BASELINE_JIT_ENABLED
+		th->jit=new BaselineJit();
 #endif
 	}
 	th->registerClasses();
@@ -1791,10 +1851,28 @@ int ABCVm::Run(void* d)
 	{
 		th->event_queue_mutex.lock();
 		while(th->events_queue.empty() && !th->shuttingdown)
+		{
+			//Use the idle time between frames to look for garbage cycles,
+			//other workers would change the objects while they are examined
+			if(th->m_sys->singleworker && th->m_sys->cycleCollector->hasCandidates())
+			{
+				th->event_queue_mutex.unlock();
+				th->m_sys->cycleCollector->collectSlice();
+				th->event_queue_mutex.lock();
+				continue;
+			}
+			if(EngineClock::isVirtual())
+				EngineClock::vmIdle();
 			th->sem_event_cond.wait(th->event_queue_mutex);
-		for (auto it = th->deletableObjects.begin(); it != th->deletableObjects.end(); it++)
-			(*it)->decRef();
-		th->deletableObjects.clear();
+		}
+		if (!th->deletableObjects.empty())
+		{
+			for (auto it = th->deletableObjects.begin(); it != th->deletableObjects.end(); it++)
+				(*it)->decRef();
+			th->deletableObjects.clear();
+			//Destructors may have changed objects the cycle collector is examining
+			th->m_sys->cycleCollector->objectsChanged();
+		}
 		if(th->shuttingdown)
 		{
 			//If the queue is empty stop immediately
@@ -1812,6 +1890,12 @@ int ABCVm::Run(void* d)
 		Chronometer chronometer;
 
 		th->handleFrontEvent();
+		th->m_sys->cycleCollector->objectsChanged();
+		//Don't let the candidates pile up if the vm is never idle
+		if(th->m_sys->singleworker && th->m_sys->cycleCollector->needsCollection())
+			th->m_sys->cycleCollector->collectSlice();
+		if(th->m_sys->bitmapDecoder->needsEviction())
+			th->m_sys->bitmapDecoder->evict();
 		profile->accountTime(chronometer.checkpoint());
 #ifdef MEMORY_USAGE_PROFILING
 		if((snapshotCount%100)==0)
@@ -309,6 +309,7 @@ public:
 
 struct BasicBlock;
 struct InferenceData;
+class BaselineJit;
 
 class ABCVm
 {
@@ -1228,6 +1229,10 @@ public:
 #endif
 	llvm::LLVMContext& llvm_context();
 #endif
+#ifdef BASELINE_JIT_ENABLED
+	// only created when the jit is enabled
+	BaselineJit* jit;
+#endif
 
 	ABCVm(SystemState* s, MemoryAccount* m) DLL_PUBLIC;
 	/**
@@ -1288,16 +1293,18 @@ public:
 	{
 		asAtom object;
 		uint32_t name;
-		void set(asAtom o, uint32_t n) { object=o; name=n; }
+		// name of the class defining the method, also read by the sampler from the timer thread
+		uint32_t className;
+		void set(asAtom o, uint32_t n, uint32_t c) { object=o; name=n; className=c; }
 	};
 	stacktrace_entry* stacktrace;
-	FORCE_INLINE call_context* incStack(asAtom o, uint32_t f)
+	FORCE_INLINE call_context* incStack(asAtom o, uint32_t f, uint32_t c)
 	{
 		if(USUALLY_FALSE(cur_recursion == limits.max_recursion))
 		{
 			throwStackOverflow();
 		}
-		stacktrace[cur_recursion].set(o,f);
+		stacktrace[cur_recursion].set(o,f,c);
 		++cur_recursion; //increment current recursion depth
 		return currentCallContext;
 	}
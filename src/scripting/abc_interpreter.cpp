@@ -21,6 +21,7 @@
 #include "compat.h"
 #include "exceptions.h"
 #include "scripting/abcutils.h"
+#include "scripting/abc_jit.h"
 #include "scripting/class.h"
 #include "scripting/toplevel/ASString.h"
 #include "scripting/toplevel/RegExp.h"
@@ -78,6 +79,18 @@ void ABCVm::clearOpcodeCounters()
 }
 #endif
 
+#ifdef BASELINE_JIT_ENABLED
+// compiles the method of context if the jit is enabled, returns true if it can be continued in the generated code
+static bool jitCompile(call_context* context)
+{
+	method_body_info* body=context->mi->body;
+	// never try again, even if the compilation fails
+	body->hit_count=JIT_CALL_THRESHOLD+1;
+	BaselineJit* jit=getVm(context->mi->context->root->getSystemState())->jit;
+	return jit && jit->compile(body);
+}
+#endif
+
 void ABCVm::executeFunction(call_context* context)
 {
 #ifdef PROFILING_SUPPORT
@@ -92,6 +105,35 @@ void ABCVm::executeFunction(call_context* context)
 #endif
 
 	asAtom* ret = &context->locals[context->mi->body->getReturnValuePos()];
+#ifdef BASELINE_JIT_ENABLED
+	method_body_info* body=context->mi->body;
+	// hit_count is already above the threshold for methods that are compiled, that failed to compile
+	// or that are never compiled because the jit is disabled, so nothing is counted for them
+	if(body->hit_count<=JIT_CALL_THRESHOLD)
+	{
+		if(++body->hit_count>JIT_CALL_THRESHOLD)
+			jitCompile(context);
+		else
+		{
+			// count the instructions of this call to find hot loops in methods that are rarely called
+			uint32_t jitbudget=JIT_LOOP_THRESHOLD;
+			while(asAtomHandler::isInvalid(*ret) && --jitbudget)
+			{
+#ifndef NDEBUG
+				uint32_t c = opcodecounter[context->exec_pos->func];
+				opcodecounter[context->exec_pos->func] = c+1;
+#endif
+				context->exec_pos->func(context);
+			}
+			// recursive calls may have compiled the method in the meantime
+			if(jitbudget==0 && asAtomHandler::isInvalid(*ret) && body->hit_count<=JIT_CALL_THRESHOLD)
+				jitCompile(context);
+		}
+	}
+	// the generated code returns early if exec_pos leaves the method, the interpreter continues from there
+	if(body->jitcode && asAtomHandler::isInvalid(*ret))
+		body->jitcode(context,ret);
+#endif
 	while(asAtomHandler::isInvalid(*ret))
 	{
 #ifdef PROFILING_SUPPORT
@@ -6077,6 +6119,22 @@ void ABCVm::preloadFunction(SyntheticFunction* function)
 			mi->body->preloadedcode[mi->body->preloadedcode.size()-1].local_pos2+= mi->body->getReturnValuePos()+1+mi->body->localresultcount;
 		if ((*itc).cachedslot3)
 			mi->body->preloadedcode[mi->body->preloadedcode.size()-1].local3.pos+= mi->body->getReturnValuePos()+1+mi->body->localresultcount;
+		// add inline caches to getproperty/setproperty with static names
+		abc_function f = mi->body->preloadedcode[mi->body->preloadedcode.size()-1].func;
+		if (f == abc_getPropertyStaticName_constant
+				|| f == abc_getPropertyStaticName_local
+				|| f == abc_getPropertyStaticName_constant_localresult
+				|| f == abc_getPropertyStaticName_local_localresult
+				|| f == abc_getPropertyStaticName_localresult
+				|| f == abc_setPropertyStaticName
+				|| f == abc_setPropertyStaticName_constant_constant
+				|| f == abc_setPropertyStaticName_local_constant
+				|| f == abc_setPropertyStaticName_constant_local
+				|| f == abc_setPropertyStaticName_local_local)
+		{
+			mi->body->propertycaches.emplace_back();
+			mi->body->preloadedcode[mi->body->preloadedcode.size()-1].propertycache = &mi->body->propertycaches.back();
+		}
 	}
 }
 
@@ -0,0 +1,433 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifdef BASELINE_JIT_ENABLED
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <cassert>
+#include "scripting/abc_jit.h"
+#include "scripting/abc.h"
+#include "scripting/abcutils.h"
+#include "logger.h"
+
+using namespace std;
+using namespace lightspark;
+
+//Provided by the unwinder of the compiler runtime (libgcc or libunwind)
+extern "C" void __register_frame(void* begin);
+extern "C" void __deregister_frame(void* begin);
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 1U
+#endif
+
+/*
+ * Machine code templates, the comments list the offsets of the holes patched for every copy.
+ * Register usage of the generated code:
+ * rbx: call_context*, r12: first slot of the preloaded code, r13: return value of the method,
+ * r14: dispatch table, rax/rcx/rdi: scratch.
+ * The five pushes keep the stack 16 byte aligned for the calls to the handlers.
+ */
+//push rbp; push rbx; push r12; push r13; push r14; mov rbx,rdi; mov r13,rsi;
+//movabs r12,<preloaded code>; movabs r14,<dispatch table>
+static const uint8_t template_prologue[] = {
+	0x55, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56,
+	0x48, 0x89, 0xfb,
+	0x49, 0x89, 0xf5,
+	0x49, 0xbc, 0, 0, 0, 0, 0, 0, 0, 0,
+	0x49, 0xbe, 0, 0, 0, 0, 0, 0, 0, 0
+};
+#define PROLOGUE_CODE 16
+#define PROLOGUE_TABLE 26
+
+//mov rdi,rbx; call <handler>
+static const uint8_t template_call_direct[] = {
+	0x48, 0x89, 0xdf,
+	0xe8, 0, 0, 0, 0
+};
+#define CALL_DIRECT_HANDLER 4
+
+//mov rdi,rbx; movabs rax,<handler>; call rax
+static const uint8_t template_call_indirect[] = {
+	0x48, 0x89, 0xdf,
+	0x48, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0,
+	0xff, 0xd0
+};
+#define CALL_INDIRECT_HANDLER 5
+
+//cmp qword [r13],0; jne <exit>; mov rax,[rbx+<exec_pos>]
+static const uint8_t template_check[] = {
+	0x49, 0x83, 0x7d, 0x00, 0x00,
+	0x0f, 0x85, 0, 0, 0, 0,
+	0x48, 0x8b, 0x83, 0, 0, 0, 0
+};
+#define CHECK_EXIT 7
+#define CHECK_EXECPOS 14
+
+//lea rcx,[r12+<slot>]; cmp rax,rcx; je <slot template>
+static const uint8_t template_compare[] = {
+	0x49, 0x8d, 0x8c, 0x24, 0, 0, 0, 0,
+	0x48, 0x39, 0xc8,
+	0x0f, 0x84, 0, 0, 0, 0
+};
+#define COMPARE_SLOT 4
+#define COMPARE_LABEL 13
+
+//sub rax,r12; cmp rax,<limit>; ja <exit>; jmp [r14+rax]
+static const uint8_t template_dispatch[] = {
+	0x4c, 0x29, 0xe0,
+	0x48, 0x3d, 0, 0, 0, 0,
+	0x0f, 0x87, 0, 0, 0, 0,
+	0x41, 0xff, 0x24, 0x06
+};
+#define DISPATCH_LIMIT 5
+#define DISPATCH_EXIT 11
+
+//lea rax,[r12+<target slot>]; mov [rbx+<exec_pos>],rax; jmp <target template>
+static const uint8_t template_jump[] = {
+	0x49, 0x8d, 0x84, 0x24, 0, 0, 0, 0,
+	0x48, 0x89, 0x83, 0, 0, 0, 0,
+	0xe9, 0, 0, 0, 0
+};
+#define JUMP_TARGET 4
+#define JUMP_EXECPOS 11
+#define JUMP_LABEL 16
+
+//pop r14; pop r13; pop r12; pop rbx; pop rbp; ret
+static const uint8_t template_exit[] = {
+	0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5b, 0x5d, 0xc3
+};
+
+static uint32_t copyTemplate(vector<uint8_t>& buf, const uint8_t* t, size_t len)
+{
+	uint32_t pos=buf.size();
+	buf.insert(buf.end(),t,t+len);
+	return pos;
+}
+
+static void patch32(vector<uint8_t>& buf, uint32_t pos, uint32_t val)
+{
+	memcpy(&buf[pos],&val,4);
+}
+
+static void patch64(vector<uint8_t>& buf, uint32_t pos, uint64_t val)
+{
+	memcpy(&buf[pos],&val,8);
+}
+
+static void appendULEB128(vector<uint8_t>& buf, uint32_t val)
+{
+	do
+	{
+		uint8_t b=val&0x7f;
+		val>>=7;
+		if(val)
+			b|=0x80;
+		buf.push_back(b);
+	}
+	while(val);
+}
+
+static void appendU32(vector<uint8_t>& buf, uint32_t val)
+{
+	buf.insert(buf.end(),(uint8_t*)&val,(uint8_t*)&val+4);
+}
+
+static void appendU64(vector<uint8_t>& buf, uint64_t val)
+{
+	buf.insert(buf.end(),(uint8_t*)&val,(uint8_t*)&val+8);
+}
+
+BaselineJit::BaselineJit():compiledMethods(0),compiledSlots(0),codeSize(0),failedMethods(0)
+{
+	call_context c(nullptr);
+	execPosOffset=(uint8_t*)&c.exec_pos-(uint8_t*)&c;
+}
+
+BaselineJit::~BaselineJit()
+{
+	for(auto it=methods.begin();it!=methods.end();++it)
+		deregisterFrameInfo(*it);
+	for(auto it=chunks.begin();it!=chunks.end();++it)
+	{
+		munmap(it->exec,it->size);
+		munmap(it->write,it->size);
+	}
+}
+
+BaselineJit::CodeChunk* BaselineJit::allocateCode(size_t size)
+{
+	size=(size+JIT_CODE_ALIGNMENT-1)&~size_t(JIT_CODE_ALIGNMENT-1);
+	if(!chunks.empty() && chunks.back().size-chunks.back().used>=size)
+		return &chunks.back();
+	const size_t pagesize=sysconf(_SC_PAGESIZE);
+	size_t chunksize=max(size,size_t(JIT_ARENA_CHUNK));
+	chunksize=(chunksize+pagesize-1)&~(pagesize-1);
+	//Ask for memory next to the handlers or after the last chunk, the kernel chooses another address if the range is not free
+	uint8_t* hint=chunks.empty() ? (uint8_t*)((uint64_t(ABCVm::abcfunctions[0])&~uint64_t(pagesize-1))-JIT_CODE_DISTANCE)
+		: chunks.back().exec+chunks.back().size;
+	int fd=syscall(SYS_memfd_create,"lightspark-jit",MFD_CLOEXEC);
+	if(fd<0)
+		return nullptr;
+	void* exec=MAP_FAILED;
+	void* write=MAP_FAILED;
+	if(ftruncate(fd,chunksize)==0)
+	{
+		exec=mmap(hint,chunksize,PROT_READ|PROT_EXEC,MAP_SHARED,fd,0);
+		write=mmap(nullptr,chunksize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	}
+	//The mappings keep the memory alive
+	close(fd);
+	if(exec==MAP_FAILED || write==MAP_FAILED)
+	{
+		if(exec!=MAP_FAILED)
+			munmap(exec,chunksize);
+		if(write!=MAP_FAILED)
+			munmap(write,chunksize);
+		return nullptr;
+	}
+	chunks.emplace_back();
+	CodeChunk& c=chunks.back();
+	c.exec=(uint8_t*)exec;
+	c.write=(uint8_t*)write;
+	c.size=chunksize;
+	c.used=0;
+	return &c;
+}
+
+void BaselineJit::commitCode(CodeChunk* chunk, uint8_t* code, size_t size)
+{
+	//The code is always the last allocation of the chunk, the rest of the reservation is used by the next method
+	chunk->used=(code-chunk->exec)+((size+JIT_CODE_ALIGNMENT-1)&~size_t(JIT_CODE_ALIGNMENT-1));
+}
+
+void BaselineJit::registerFrameInfo(CompiledMethod& m)
+{
+#ifdef HAVE_UNW_ADD_DYNAMIC_FDE
+	//LLVM libunwind takes a single FDE
+	__register_frame(m.ehframe.data()+m.fde);
+#else
+	//libgcc takes a whole .eh_frame section, terminated by a zero length
+	__register_frame(m.ehframe.data());
+#endif
+}
+
+void BaselineJit::deregisterFrameInfo(CompiledMethod& m)
+{
+#ifdef HAVE_UNW_ADD_DYNAMIC_FDE
+	__deregister_frame(m.ehframe.data()+m.fde);
+#else
+	__deregister_frame(m.ehframe.data());
+#endif
+}
+
+void BaselineJit::buildFrameInfo(CompiledMethod& m)
+{
+	vector<uint8_t>& eh=m.ehframe;
+	//CIE, the initial instructions describe the frame after the prologue,
+	//exceptions are only thrown from the handlers called by the body of the method
+	appendU32(eh,0); //length
+	appendU32(eh,0); //CIE id
+	eh.push_back(1); //version
+	eh.push_back('z');
+	eh.push_back('R');
+	eh.push_back(0);
+	appendULEB128(eh,1); //code alignment
+	eh.push_back(0x78); //data alignment -8
+	eh.push_back(16); //return address register
+	appendULEB128(eh,1); //augmentation data length
+	eh.push_back(0x00); //DW_EH_PE_absptr
+	const uint8_t cfa[] = {
+		0x0c, 7, 48, //DW_CFA_def_cfa rsp+48
+		0x90, 1, //return address at cfa-8
+		0x86, 2, //rbp at cfa-16
+		0x83, 3, //rbx at cfa-24
+		0x8c, 4, //r12 at cfa-32
+		0x8d, 5, //r13 at cfa-40
+		0x8e, 6 //r14 at cfa-48
+	};
+	eh.insert(eh.end(),cfa,cfa+sizeof(cfa));
+	while(eh.size()%8)
+		eh.push_back(0); //DW_CFA_nop
+	uint32_t len=eh.size()-4;
+	memcpy(&eh[0],&len,4);
+
+	//FDE covering the whole method
+	uint32_t fde=eh.size();
+	m.fde=fde;
+	appendU32(eh,0); //length
+	appendU32(eh,fde+4); //offset to the CIE
+	appendU64(eh,(uint64_t)m.code);
+	appendU64(eh,m.size);
+	appendULEB128(eh,0); //augmentation data length
+	while(eh.size()%8)
+		eh.push_back(0);
+	len=eh.size()-fde-4;
+	memcpy(&eh[fde],&len,4);
+	//terminator
+	appendU32(eh,0);
+}
+
+void BaselineJit::emitCheck(vector<uint8_t>& buf, vector<uint32_t>& exitfixups)
+{
+	uint32_t pos=copyTemplate(buf,template_check,sizeof(template_check));
+	exitfixups.push_back(pos+CHECK_EXIT);
+	patch32(buf,pos+CHECK_EXECPOS,execPosOffset);
+}
+
+void BaselineJit::emitCompare(vector<uint8_t>& buf, vector<pair<uint32_t,uint32_t>>& slotfixups, uint32_t slot)
+{
+	uint32_t pos=copyTemplate(buf,template_compare,sizeof(template_compare));
+	patch32(buf,pos+COMPARE_SLOT,slot*sizeof(preloadedcodedata));
+	slotfixups.push_back(make_pair(pos+COMPARE_LABEL,slot));
+}
+
+void BaselineJit::emitDispatch(vector<uint8_t>& buf, vector<uint32_t>& exitfixups, uint32_t limit)
+{
+	uint32_t pos=copyTemplate(buf,template_dispatch,sizeof(template_dispatch));
+	patch32(buf,pos+DISPATCH_LIMIT,limit);
+	exitfixups.push_back(pos+DISPATCH_EXIT);
+}
+
+bool BaselineJit::compile(method_body_info* body)
+{
+	Locker l(mutex);
+	if(body->jitcode)
+		return true;
+	const uint32_t count=body->preloadedcode.size();
+	const uint32_t stride=sizeof(preloadedcodedata);
+	static_assert(sizeof(preloadedcodedata)%8==0,"dispatch table entries must be aligned");
+	//All displacements are 32 bit signed values
+	if(count==0 || uint64_t(count)*stride>=0x10000000)
+	{
+		failedMethods++;
+		return false;
+	}
+	const uint64_t base=(uint64_t)body->preloadedcode.data();
+	const uint32_t limit=count*stride;
+
+	//The code is generated directly for its final address, so that handlers near enough can be called
+	//with a relative call. The memory is reserved for the worst case, every slot using the biggest template,
+	//and the unused part is given back to the arena.
+	const size_t maxslotsize=sizeof(template_call_indirect)+sizeof(template_check)+3*sizeof(template_compare)+sizeof(template_dispatch);
+	const size_t size=sizeof(template_prologue)+sizeof(template_check)+sizeof(template_dispatch)+count*maxslotsize+sizeof(template_exit);
+	CodeChunk* chunk=allocateCode(size);
+	if(!chunk)
+	{
+		LOG(LOG_ERROR,"jit: cannot allocate "<<size<<" bytes of executable memory");
+		failedMethods++;
+		return false;
+	}
+	methods.emplace_back();
+	CompiledMethod& m=methods.back();
+	m.code=chunk->exec+chunk->used;
+	m.dispatchtable.resize(limit/8+1);
+
+	vector<uint8_t> buf;
+	buf.reserve(size);
+	vector<uint32_t> slotpos(count+1);
+	//positions of rel32 holes and the slot they jump to
+	vector<pair<uint32_t,uint32_t>> slotfixups;
+	vector<uint32_t> exitfixups;
+
+	uint32_t pos=copyTemplate(buf,template_prologue,sizeof(template_prologue));
+	patch64(buf,pos+PROLOGUE_CODE,base);
+	patch64(buf,pos+PROLOGUE_TABLE,(uint64_t)m.dispatchtable.data());
+	emitCheck(buf,exitfixups);
+	emitDispatch(buf,exitfixups,limit);
+
+	for(uint32_t i=0;i<count;i++)
+	{
+		const preloadedcodedata& code=body->preloadedcode[i];
+		slotpos[i]=buf.size();
+		//Slots holding additional operands are never executed, their templates are unreachable,
+		//so it doesn't matter if their content is interpreted in the wrong way
+		const int64_t target=int64_t(i)+code.arg3_int;
+		const bool validtarget=target>=0 && target<=count;
+		if(code.func==ABCVm::abcfunctions[0x10] && validtarget)
+		{
+			//jump
+			pos=copyTemplate(buf,template_jump,sizeof(template_jump));
+			patch32(buf,pos+JUMP_TARGET,target*stride);
+			patch32(buf,pos+JUMP_EXECPOS,execPosOffset);
+			slotfixups.push_back(make_pair(pos+JUMP_LABEL,target));
+			continue;
+		}
+		const int64_t rel=int64_t(code.func)-int64_t(m.code+buf.size()+sizeof(template_call_direct));
+		if(rel==int32_t(rel))
+		{
+			pos=copyTemplate(buf,template_call_direct,sizeof(template_call_direct));
+			patch32(buf,pos+CALL_DIRECT_HANDLER,rel);
+		}
+		else
+		{
+			pos=copyTemplate(buf,template_call_indirect,sizeof(template_call_indirect));
+			patch64(buf,pos+CALL_INDIRECT_HANDLER,(uint64_t)code.func);
+		}
+		emitCheck(buf,exitfixups);
+		//Most handlers continue with the next slot
+		emitCompare(buf,slotfixups,i+1);
+		//Conditional branches store the offset of the target in arg3_int, checking it
+		//before the dispatch table keeps loops on direct jumps. If arg3_int is not a jump offset
+		//the comparison simply fails.
+		if(validtarget && target!=i+1)
+			emitCompare(buf,slotfixups,target);
+		//Instructions with one additional operand slot (calls, property access with a runtime name)
+		if(i+2<=count)
+			emitCompare(buf,slotfixups,i+2);
+		emitDispatch(buf,exitfixups,limit);
+	}
+	//Falling off the end of the method returns to the interpreter
+	const uint32_t exitpos=copyTemplate(buf,template_exit,sizeof(template_exit));
+	slotpos[count]=exitpos;
+	for(auto it=slotfixups.begin();it!=slotfixups.end();++it)
+		patch32(buf,it->first,slotpos[it->second]-(it->first+4));
+	for(auto it=exitfixups.begin();it!=exitfixups.end();++it)
+		patch32(buf,*it,exitpos-(*it+4));
+	assert(buf.size()<=size);
+
+	//Written through the writable view, the executable one sees the same pages
+	memcpy(chunk->write+(m.code-chunk->exec),buf.data(),buf.size());
+	m.size=buf.size();
+	commitCode(chunk,m.code,m.size);
+	for(uint32_t i=0;i<m.dispatchtable.size();i++)
+		m.dispatchtable[i]=(uint64_t)(m.code+exitpos);
+	for(uint32_t i=0;i<=count;i++)
+		m.dispatchtable[i*stride/8]=(uint64_t)(m.code+slotpos[i]);
+	buildFrameInfo(m);
+	registerFrameInfo(m);
+
+	compiledMethods++;
+	compiledSlots+=count;
+	codeSize+=buf.size();
+	LOG(LOG_TRACE,"jit: compiled "<<count<<" slots into "<<buf.size()<<" bytes");
+	body->jitcode=(jit_function)m.code;
+	return true;
+}
+
+void BaselineJit::dumpStatistics(std::ostream& out) const
+{
+	out << "# jit: " << compiledMethods << " methods compiled (" << compiledSlots << " slots, "
+		<< codeSize << " bytes of code), " << failedMethods << " failed" << std::endl;
+}
+
+#endif /* BASELINE_JIT_ENABLED */
@@ -0,0 +1,121 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef SCRIPTING_ABC_JIT_H
+#define SCRIPTING_ABC_JIT_H 1
+
+#ifdef BASELINE_JIT_ENABLED
+
+#include "compat.h"
+#include <list>
+#include <vector>
+#include <ostream>
+#include "threading.h"
+
+namespace lightspark
+{
+
+//Number of interpreted calls after which a method is compiled
+#define JIT_CALL_THRESHOLD 20
+//Number of instructions a single interpreted call may execute before its method is compiled,
+//this catches hot loops in methods that are only called once
+#define JIT_LOOP_THRESHOLD 10000
+//Preferred distance between the generated code and the handlers, the code is placed below
+//the library so that the handlers can be reached with relative calls
+#define JIT_CODE_DISTANCE (256*1024*1024)
+//Size of the chunks of the code arena, the code of many methods is placed in the same chunk
+#define JIT_ARENA_CHUNK (1024*1024)
+//Alignment of the code of every method in the arena
+#define JIT_CODE_ALIGNMENT 16
+
+struct method_body_info;
+struct call_context;
+
+/*
+ * Baseline jit for x86_64.
+ * The preloaded code of a method is translated into machine code by copying one small
+ * precompiled template for every instruction slot and patching its holes (handler address,
+ * slot address, jump targets). Every template calls the abc_function of its slot directly,
+ * so the indirect call of the interpreter loop is replaced by a direct call site per
+ * instruction, and jumps are translated into native jumps.
+ * All state stays in the call_context exactly as in the interpreter: after every handler
+ * exec_pos is compared with the next slot and with the possible branch target, if the handler
+ * moved it somewhere else (instructions with additional operand slots, lookupswitch) the code
+ * continues at the matching template through an indirect jump owned by the call site.
+ * The generated code returns to executeFunction() as soon as the return value is set or when
+ * exec_pos leaves the method, the interpreter then continues from exec_pos.
+ */
+class BaselineJit
+{
+private:
+	struct CompiledMethod
+	{
+		uint8_t* code;
+		size_t size;
+		// offset of every slot in the preloaded code -> address of its template
+		std::vector<uint64_t> dispatchtable;
+		// CIE and FDE describing the frame of the generated code, needed to unwind exceptions thrown by the handlers
+		std::vector<uint8_t> ehframe;
+		// offset of the FDE in ehframe
+		uint32_t fde;
+	};
+	/*
+	 * Memory of the code arena. The same pages are mapped twice, executable near the handlers
+	 * and writable somewhere else, so that new code is added without changing the protection
+	 * of the code that may be running.
+	 */
+	struct CodeChunk
+	{
+		uint8_t* exec;
+		uint8_t* write;
+		size_t size;
+		size_t used;
+	};
+	Mutex mutex;
+	std::list<CompiledMethod> methods;
+	std::list<CodeChunk> chunks;
+	uint32_t execPosOffset;
+	// statistics
+	uint32_t compiledMethods;
+	uint64_t compiledSlots;
+	uint64_t codeSize;
+	uint32_t failedMethods;
+	// Reserves size bytes at the end of a chunk, the unused part is given back by commitCode
+	CodeChunk* allocateCode(size_t size);
+	void commitCode(CodeChunk* chunk, uint8_t* code, size_t size);
+	void buildFrameInfo(CompiledMethod& m);
+	void registerFrameInfo(CompiledMethod& m);
+	void deregisterFrameInfo(CompiledMethod& m);
+	void emitCheck(std::vector<uint8_t>& buf, std::vector<uint32_t>& exitfixups);
+	void emitCompare(std::vector<uint8_t>& buf, std::vector<std::pair<uint32_t,uint32_t>>& slotfixups, uint32_t slot);
+	void emitDispatch(std::vector<uint8_t>& buf, std::vector<uint32_t>& exitfixups, uint32_t limit);
+public:
+	BaselineJit();
+	~BaselineJit();
+	/*
+	 * Translates the preloaded code of body and stores the entry point in body->jitcode.
+	 * Returns false if the method can't be compiled, it is then only executed by the interpreter.
+	 */
+	bool compile(method_body_info* body);
+	void dumpStatistics(std::ostream& out) const;
+};
+
+}
+#endif /* BASELINE_JIT_ENABLED */
+#endif /* SCRIPTING_ABC_JIT_H */
@@ -968,9 +968,11 @@ FORCE_INLINE void callprop_intern(call_context* context,asAtom& ret,asAtom& obj,
 {
 	if ((cacheptr->local2.flags&ABC_OP_CACHED) == ABC_OP_CACHED)
 	{
-		if (asAtomHandler::isObject(obj) &&
+		// inline Numbers have no object to take the class from
+		if ((asAtomHandler::isObject(obj) &&
 				((asAtomHandler::is<Class_base>(obj) && asAtomHandler::getObjectNoCheck(obj) == cacheptr->cacheobj1)
 				|| asAtomHandler::getObjectNoCheck(obj)->getClass() == cacheptr->cacheobj1))
+			|| (asAtomHandler::isInlineNumber(obj) && Class<Number>::getRef(context->mi->context->root->getSystemState()).getPtr() == cacheptr->cacheobj1))
 		{
 			asAtom o = asAtomHandler::fromObjectNoPrimitive(cacheptr->cacheobj3);
 			LOG_CALL( "callProperty from cache:"<<*name<<" "<<asAtomHandler::toDebugString(obj)<<" "<<asAtomHandler::toDebugString(o)<<" "<<coercearguments);
@@ -1931,13 +1933,21 @@ void ABCVm::abc_setPropertyStaticName(call_context* context)
 	}
 
 	ASObject* o = asAtomHandler::toObject(*obj,context->mi->context->root->getSystemState());
-	multiname* simplesettername = nullptr;
-	if (context->exec_pos->local3.pos == 0x68)//initproperty
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
-	else//Do not allow to set contant traits
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
-	if (simplesettername)
-		context->exec_pos->cachedmultiname2 = simplesettername;
+	if (!o->setVariableFromPropertyCache(*value,context->exec_pos->propertycache))
+	{
+		multiname* simplesettername = nullptr;
+		if (context->exec_pos->local3.pos == 0x68)//initproperty
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
+		else//Do not allow to set contant traits
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
+		if (simplesettername)
+		{
+			context->exec_pos->cachedmultiname2 = simplesettername;
+			context->exec_pos->propertycache->clear();
+		}
+		else
+			o->updatePropertyCache(*name,context->exec_pos->propertycache,true);
+	}
 	++(context->exec_pos);
 }
 void ABCVm::abc_setPropertyStaticName_constant_constant(call_context* context)
@@ -1962,13 +1972,21 @@ void ABCVm::abc_setPropertyStaticName_constant_constant(call_context* context)
 	}
 
 	ASObject* o = asAtomHandler::toObject(*obj,context->mi->context->root->getSystemState());
-	multiname* simplesettername = nullptr;
-	if (context->exec_pos->local3.pos == 0x68)//initproperty
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
-	else//Do not allow to set contant traits
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
-	if (simplesettername)
-		context->exec_pos->cachedmultiname2 = simplesettername;
+	if (!o->setVariableFromPropertyCache(*value,instrptr->propertycache))
+	{
+		multiname* simplesettername = nullptr;
+		if (context->exec_pos->local3.pos == 0x68)//initproperty
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
+		else//Do not allow to set contant traits
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
+		if (simplesettername)
+		{
+			context->exec_pos->cachedmultiname2 = simplesettername;
+			instrptr->propertycache->clear();
+		}
+		else
+			o->updatePropertyCache(*name,instrptr->propertycache,true);
+	}
 	++(context->exec_pos);
 }
 void ABCVm::abc_setPropertyStaticName_local_constant(call_context* context)
@@ -1992,13 +2010,21 @@ void ABCVm::abc_setPropertyStaticName_local_constant(call_context* context)
 		throwError<TypeError>(kConvertUndefinedToObjectError);
 	}
 	ASObject* o = asAtomHandler::toObject(*obj,context->mi->context->root->getSystemState());
-	multiname* simplesettername = nullptr;
-	if (context->exec_pos->local3.pos == 0x68)//initproperty
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
-	else//Do not allow to set contant traits
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
-	if (simplesettername)
-		context->exec_pos->cachedmultiname2 = simplesettername;
+	if (!o->setVariableFromPropertyCache(*value,instrptr->propertycache))
+	{
+		multiname* simplesettername = nullptr;
+		if (context->exec_pos->local3.pos == 0x68)//initproperty
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
+		else//Do not allow to set contant traits
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
+		if (simplesettername)
+		{
+			context->exec_pos->cachedmultiname2 = simplesettername;
+			instrptr->propertycache->clear();
+		}
+		else
+			o->updatePropertyCache(*name,instrptr->propertycache,true);
+	}
 	++(context->exec_pos);
 }
 void ABCVm::abc_setPropertyStaticName_constant_local(call_context* context)
@@ -2023,13 +2049,21 @@ void ABCVm::abc_setPropertyStaticName_constant_local(call_context* context)
 	}
 	ASObject* o = asAtomHandler::toObject(*obj,context->mi->context->root->getSystemState());
 	ASATOM_INCREF_POINTER(value);
-	multiname* simplesettername = nullptr;
-	if (context->exec_pos->local3.pos == 0x68)//initproperty
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
-	else//Do not allow to set contant traits
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
-	if (simplesettername)
-		context->exec_pos->cachedmultiname2 = simplesettername;
+	if (!o->setVariableFromPropertyCache(*value,instrptr->propertycache))
+	{
+		multiname* simplesettername = nullptr;
+		if (context->exec_pos->local3.pos == 0x68)//initproperty
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
+		else//Do not allow to set contant traits
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
+		if (simplesettername)
+		{
+			context->exec_pos->cachedmultiname2 = simplesettername;
+			instrptr->propertycache->clear();
+		}
+		else
+			o->updatePropertyCache(*name,instrptr->propertycache,true);
+	}
 	++(context->exec_pos);
 }
 void ABCVm::abc_setPropertyStaticName_local_local(call_context* context)
@@ -2054,13 +2088,21 @@ void ABCVm::abc_setPropertyStaticName_local_local(call_context* context)
 	}
 	ASObject* o = asAtomHandler::toObject(*obj,context->mi->context->root->getSystemState());
 	ASATOM_INCREF_POINTER(value);
-	multiname* simplesettername = nullptr;
-	if (context->exec_pos->local3.pos == 0x68)//initproperty
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
-	else//Do not allow to set contant traits
-		simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
-	if (simplesettername)
-		context->exec_pos->cachedmultiname2 = simplesettername;
+	if (!o->setVariableFromPropertyCache(*value,instrptr->propertycache))
+	{
+		multiname* simplesettername = nullptr;
+		if (context->exec_pos->local3.pos == 0x68)//initproperty
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_ALLOWED);
+		else//Do not allow to set contant traits
+			simplesettername =o->setVariableByMultiname(*name,*value,ASObject::CONST_NOT_ALLOWED);
+		if (simplesettername)
+		{
+			context->exec_pos->cachedmultiname2 = simplesettername;
+			instrptr->propertycache->clear();
+		}
+		else
+			o->updatePropertyCache(*name,instrptr->propertycache,true);
+	}
 	++(context->exec_pos);
 }
 void ABCVm::abc_setPropertyInteger(call_context* context)
@@ -2752,10 +2794,7 @@ void ABCVm::abc_getPropertyInteger(call_context* context)
 	LOG_CALL( _("getPropertyInteger ") << index << ' ' << obj->toDebugString() << ' '<<obj->isInitialized());
 	asAtom prop=asAtomHandler::invalidAtom;
 	if (obj->is<Vector>())
-	{
 		obj->as<Vector>()->getVariableByIntegerDirect(prop,index);
-		ASATOM_INCREF(prop);
-	}
 	else
 		obj->getVariableByInteger(prop,index);
 	if(asAtomHandler::isInvalid(prop))
@@ -2773,10 +2812,7 @@ void ABCVm::abc_getPropertyInteger_constant_constant(call_context* context)
 	LOG_CALL( _("getPropertyInteger_cc ") << index << ' ' << obj->toDebugString() << ' '<<obj->isInitialized());
 	asAtom prop=asAtomHandler::invalidAtom;
 	if (obj->is<Vector>())
-	{
 		obj->as<Vector>()->getVariableByIntegerDirect(prop,index);
-		ASATOM_INCREF(prop);
-	}
 	else
 		obj->getVariableByInteger(prop,index);
 	if(asAtomHandler::isInvalid(prop))
@@ -2794,10 +2830,7 @@ void ABCVm::abc_getPropertyInteger_local_constant(call_context* context)
 	LOG_CALL( _("getPropertyInteger_lc ") << index << ' ' << obj->toDebugString() << ' '<<obj->isInitialized());
 	asAtom prop=asAtomHandler::invalidAtom;
 	if (obj->is<Vector>())
-	{
 		obj->as<Vector>()->getVariableByIntegerDirect(prop,index);
-		ASATOM_INCREF(prop);
-	}
 	else
 		obj->getVariableByInteger(prop,index);
 	if(asAtomHandler::isInvalid(prop))
@@ -2815,10 +2848,7 @@ void ABCVm::abc_getPropertyInteger_constant_local(call_context* context)
 	LOG_CALL( _("getPropertyInteger_cl ") << index << ' ' << obj->toDebugString() << ' '<<obj->isInitialized());
 	asAtom prop=asAtomHandler::invalidAtom;
 	if (obj->is<Vector>())
-	{
 		obj->as<Vector>()->getVariableByIntegerDirect(prop,index);
-		ASATOM_INCREF(prop);
-	}
 	else
 		obj->getVariableByInteger(prop,index);
 	if(asAtomHandler::isInvalid(prop))
@@ -2838,10 +2868,7 @@ void ABCVm::abc_getPropertyInteger_local_local(call_context* context)
 	LOG_CALL( _("getPropertyInteger_ll ") << index <<"("<<instrptr->local_pos2<<")"<< ' ' << obj->toDebugString() <<"("<<instrptr->local_pos1<<")"<< ' '<<obj->isInitialized());
 	asAtom prop=asAtomHandler::invalidAtom;
 	if (obj->is<Vector>())
-	{
 		obj->as<Vector>()->getVariableByIntegerDirect(prop,index);
-		ASATOM_INCREF(prop);
-	}
 	else
 		obj->getVariableByInteger(prop,index);
 	if(asAtomHandler::isInvalid(prop))
@@ -2880,12 +2907,11 @@ void ABCVm::abc_getPropertyInteger_local_constant_localresult(call_context* cont
 	if (obj->is<Vector>())
 		obj->as<Vector>()->getVariableByIntegerDirect(prop,index);
 	else
-		obj->getVariableByInteger(prop,index,GET_VARIABLE_OPTION::NO_INCREF);
+		obj->getVariableByInteger(prop,index);
 	if(asAtomHandler::isInvalid(prop))
 		checkPropertyExceptionInteger(obj,index,prop);
 	ASObject* o = asAtomHandler::getObject(CONTEXT_GETLOCAL(context,instrptr->local3.pos));
 	asAtomHandler::set(CONTEXT_GETLOCAL(context,instrptr->local3.pos),prop);
-	ASATOM_INCREF(CONTEXT_GETLOCAL(context,instrptr->local3.pos));
 	if (o)
 		o->decRef();
 	++(context->exec_pos);
@@ -2902,12 +2928,11 @@ void ABCVm::abc_getPropertyInteger_constant_local_localresult(call_context* cont
 	if (obj->is<Vector>())
 		obj->as<Vector>()->getVariableByIntegerDirect(prop,index);
 	else
-		obj->getVariableByInteger(prop,index,GET_VARIABLE_OPTION::NO_INCREF);
+		obj->getVariableByInteger(prop,index);
 	if(asAtomHandler::isInvalid(prop))
 		checkPropertyExceptionInteger(obj,index,prop);
 	ASObject* o = asAtomHandler::getObject(CONTEXT_GETLOCAL(context,instrptr->local3.pos));
 	asAtomHandler::set(CONTEXT_GETLOCAL(context,instrptr->local3.pos),prop);
-	ASATOM_INCREF(CONTEXT_GETLOCAL(context,instrptr->local3.pos));
 	if (o)
 		o->decRef();
 	++(context->exec_pos);
@@ -2924,12 +2949,11 @@ void ABCVm::abc_getPropertyInteger_local_local_localresult(call_context* context
 	if (obj->is<Vector>())
 		obj->as<Vector>()->getVariableByIntegerDirect(prop,index);
 	else
-		obj->getVariableByInteger(prop,index,GET_VARIABLE_OPTION::NO_INCREF);
+		obj->getVariableByInteger(prop,index);
 	if(asAtomHandler::isInvalid(prop))
 		checkPropertyExceptionInteger(obj,index,prop);
 	ASObject* o = asAtomHandler::getObject(CONTEXT_GETLOCAL(context,instrptr->local3.pos));
 	asAtomHandler::set(CONTEXT_GETLOCAL(context,instrptr->local3.pos),prop);
-	ASATOM_INCREF(CONTEXT_GETLOCAL(context,instrptr->local3.pos));
 	if (o)
 		o->decRef();
 	++(context->exec_pos);
@@ -2942,7 +2966,7 @@ void ABCVm::abc_getPropertyStaticName_constant(call_context* context)
 	ASObject* obj= asAtomHandler::toObject(*instrptr->arg1_constant,context->mi->context->root->getSystemState());
 	LOG_CALL( _("getProperty_sc ") << *name << ' ' << obj->toDebugString() << ' '<<obj->isInitialized());
 	asAtom prop=asAtomHandler::invalidAtom;
-	if(asAtomHandler::isInvalid(prop))
+	if(!obj->getVariableFromPropertyCache(prop,instrptr->propertycache))
 	{
 		bool isgetter = obj->getVariableByMultiname(prop,*name,GET_VARIABLE_OPTION::DONT_CALL_GETTER) & GET_VARIABLE_RESULT::GETVAR_ISGETTER;
 		if (isgetter)
@@ -2958,9 +2982,12 @@ void ABCVm::abc_getPropertyStaticName_constant(call_context* context)
 			{
 				LOG_CALL("is simple getter " << *simplegetter);
 				instrptr->cachedmultiname2 = simplegetter;
+				instrptr->propertycache->clear();
 			}
 			LOG_CALL("End of getter"<< ' ' << f->toDebugString()<<" result:"<<asAtomHandler::toDebugString(prop));
 		}
+		else if (asAtomHandler::isValid(prop))
+			obj->updatePropertyCache(*name,instrptr->propertycache,false);
 	}
 	if(asAtomHandler::isInvalid(prop))
 		checkPropertyException(obj,name,prop);
@@ -2985,7 +3012,7 @@ void ABCVm::abc_getPropertyStaticName_local(call_context* context)
 	{
 		ASObject* obj= asAtomHandler::toObject(CONTEXT_GETLOCAL(context,instrptr->local_pos1),context->mi->context->root->getSystemState());
 		LOG_CALL( _("getProperty_sl ") << *name << ' ' << obj->toDebugString() << ' '<<obj->isInitialized());
-		if(asAtomHandler::isInvalid(prop))
+		if(!obj->getVariableFromPropertyCache(prop,instrptr->propertycache))
 		{
 			bool isgetter = obj->getVariableByMultiname(prop,*name,GET_VARIABLE_OPTION::DONT_CALL_GETTER) & GET_VARIABLE_RESULT::GETVAR_ISGETTER;
 			if (isgetter)
@@ -3001,9 +3028,12 @@ void ABCVm::abc_getPropertyStaticName_local(call_context* context)
 				{
 					LOG_CALL("is simple getter " << *simplegetter);
 					instrptr->cachedmultiname2 = simplegetter;
+					instrptr->propertycache->clear();
 				}
 				LOG_CALL("End of getter"<< ' ' << f->toDebugString()<<" result:"<<asAtomHandler::toDebugString(prop));
 			}
+			else if (asAtomHandler::isValid(prop))
+				obj->updatePropertyCache(*name,instrptr->propertycache,false);
 		}
 		if(asAtomHandler::isInvalid(prop))
 			checkPropertyException(obj,name,prop);
@@ -3019,7 +3049,7 @@ void ABCVm::abc_getPropertyStaticName_constant_localresult(call_context* context
 	ASObject* obj= asAtomHandler::toObject(*instrptr->arg1_constant,context->mi->context->root->getSystemState(),true);
 	LOG_CALL( _("getProperty_scl ") << *name << ' ' << obj->toDebugString() << ' '<<obj->isInitialized());
 	asAtom prop=asAtomHandler::invalidAtom;
-	if(asAtomHandler::isInvalid(prop))
+	if(!obj->getVariableFromPropertyCache(prop,instrptr->propertycache))
 	{
 		GET_VARIABLE_RESULT getvarres = obj->getVariableByMultiname(prop,*name,(GET_VARIABLE_OPTION)(GET_VARIABLE_OPTION::NO_INCREF | GET_VARIABLE_OPTION::DONT_CALL_GETTER));
 		bool isgetter = getvarres & GET_VARIABLE_RESULT::GETVAR_ISGETTER;
@@ -3036,11 +3066,17 @@ void ABCVm::abc_getPropertyStaticName_constant_localresult(call_context* context
 			{
 				LOG_CALL("is simple getter " << *simplegetter);
 				instrptr->cachedmultiname2 = simplegetter;
+				instrptr->propertycache->clear();
 			}
 			LOG_CALL("End of getter"<< ' ' << f->toDebugString()<<" result:"<<asAtomHandler::toDebugString(prop));
 		}
-		else if (!(getvarres & GET_VARIABLE_RESULT::GETVAR_ISNEWOBJECT))
-			ASATOM_INCREF(prop);
+		else
+		{
+			if (!(getvarres & GET_VARIABLE_RESULT::GETVAR_ISNEWOBJECT))
+				ASATOM_INCREF(prop);
+			if (asAtomHandler::isValid(prop))
+				obj->updatePropertyCache(*name,instrptr->propertycache,false);
+		}
 	}
 	if(asAtomHandler::isInvalid(prop))
 		checkPropertyException(obj,name,prop);
@@ -3068,39 +3104,7 @@ void ABCVm::abc_getPropertyStaticName_local_localresult(call_context* context)
 	{
 		ASObject* obj= asAtomHandler::toObject(CONTEXT_GETLOCAL(context,instrptr->local_pos1),context->mi->context->root->getSystemState());
 		asAtom prop=asAtomHandler::invalidAtom;
-// TODO caching doesn't work until we find a way to detect if obj is a reused object
-// that has been destroyed since the last call
-//		if (((context->exec_pos->data&ABC_OP_NOTCACHEABLE) == 0)
-//				&& ((obj->is<Class_base>() && obj->as<Class_base>()->isSealed) ||
-//					(obj->getClass()
-//					 && (obj->getClass()->isSealed
-//						 || (obj->getClass() == Class<Array>::getRef(obj->getSystemState()).getPtr())))))
-//		{
-//			variable* v = obj->findVariableByMultiname(*name,obj->getClass());
-//			if (v)
-//			{
-//				context->exec_pos->data |= ABC_OP_CACHED;
-//				context->exec_pos->cachedvar2=v;
-//				context->exec_pos->cacheobj1=obj;
-//				if (asAtomHandler::isValid(v->getter))
-//				{
-//					asAtomHandler::set(prop,v->getter);
-//					//Call the getter
-//					LOG_CALL("Calling the getter for " << *name << " on " << obj->toDebugString());
-//					assert(asAtomHandler::isFunction(prop));
-//					IFunction* f = asAtomHandler::as<IFunction>(prop);
-//					ASObject* closure = asAtomHandler::getClosure(prop);
-//					f->callGetter(prop,closure ? closure : obj);
-//					LOG_CALL("End of getter"<< ' ' << f->toDebugString()<<" result:"<<asAtomHandler::toDebugString(prop));
-//				}
-//				else
-//				{
-//					asAtomHandler::set(prop,v->var);
-//					ASATOM_INCREF(prop);
-//				}
-//			}
-//		}
-		if(asAtomHandler::isInvalid(prop))
+		if(!obj->getVariableFromPropertyCache(prop,instrptr->propertycache))
 		{
 			GET_VARIABLE_RESULT getvarres = obj->getVariableByMultiname(prop,*name,(GET_VARIABLE_OPTION)(GET_VARIABLE_OPTION::NO_INCREF | GET_VARIABLE_OPTION::DONT_CALL_GETTER));
 			bool isgetter = getvarres & GET_VARIABLE_RESULT::GETVAR_ISGETTER;
@@ -3117,6 +3121,7 @@ void ABCVm::abc_getPropertyStaticName_local_localresult(call_context* context)
 				{
 					LOG_CALL("is simple getter " << *simplegetter);
 					instrptr->cachedmultiname2 = simplegetter;
+					instrptr->propertycache->clear();
 				}
 				LOG_CALL("End of getter"<< ' ' << f->toDebugString()<<" result:"<<asAtomHandler::toDebugString(prop));
 			}
@@ -3125,8 +3130,9 @@ void ABCVm::abc_getPropertyStaticName_local_localresult(call_context* context)
 				LOG_CALL("getProperty_sll " << *name << ' ' << obj->toDebugString()<<" "<<instrptr->local3.pos<<" "<<asAtomHandler::toDebugString(prop));
 				if (!(getvarres & GET_VARIABLE_RESULT::GETVAR_ISNEWOBJECT))
 					ASATOM_INCREF(prop);
+				if (asAtomHandler::isValid(prop))
+					obj->updatePropertyCache(*name,instrptr->propertycache,false);
 			}
-
 		}
 		if(asAtomHandler::isInvalid(prop))
 			checkPropertyException(obj,name,prop);
@@ -3145,7 +3151,7 @@ void ABCVm::abc_getPropertyStaticName_localresult(call_context* context)
 	RUNTIME_STACK_POP_CREATE_ASOBJECT(context,obj,context->mi->context->root->getSystemState());
 	LOG_CALL( _("getProperty_slr ") << *name << ' ' << obj->toDebugString() << ' '<<obj->isInitialized());
 	asAtom prop=asAtomHandler::invalidAtom;
-	if(asAtomHandler::isInvalid(prop))
+	if(!obj->getVariableFromPropertyCache(prop,instrptr->propertycache))
 	{
 		GET_VARIABLE_RESULT getvarres = obj->getVariableByMultiname(prop,*name,(GET_VARIABLE_OPTION)(GET_VARIABLE_OPTION::NO_INCREF | GET_VARIABLE_OPTION::DONT_CALL_GETTER));
 		bool isgetter = getvarres & GET_VARIABLE_RESULT::GETVAR_ISGETTER;
@@ -3162,11 +3168,17 @@ void ABCVm::abc_getPropertyStaticName_localresult(call_context* context)
 			{
 				LOG_CALL("is simple getter " << *simplegetter);
 				instrptr->cachedmultiname2 = simplegetter;
+				instrptr->propertycache->clear();
 			}
 			LOG_CALL("End of getter"<< ' ' << f->toDebugString()<<" result:"<<asAtomHandler::toDebugString(prop));
 		}
-		else if (!(getvarres & GET_VARIABLE_RESULT::GETVAR_ISNEWOBJECT))
-			ASATOM_INCREF(prop);
+		else
+		{
+			if (!(getvarres & GET_VARIABLE_RESULT::GETVAR_ISNEWOBJECT))
+				ASATOM_INCREF(prop);
+			if (asAtomHandler::isValid(prop))
+				obj->updatePropertyCache(*name,instrptr->propertycache,false);
+		}
 	}
 	if(asAtomHandler::isInvalid(prop))
 		checkPropertyException(obj,name,prop);
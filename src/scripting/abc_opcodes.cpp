@@ -1190,7 +1190,17 @@ ASObject* ABCVm::add(ASObject* val2, ASObject* val1)
 		val2->decRef();
 		return res;
 	}
-	else if(val1->is<ASString>() || val2->is<ASString>())
+	else if(val1->is<ASString>())
+	{
+		//Don't copy the left string, it may be appended to in place
+		tiny_string b = val2->toString();
+		LOG_CALL("add " << val1->toString() << '+' << b);
+		res = val1->as<ASString>()->concatString(b);
+		val1->decRef();
+		val2->decRef();
+		return res;
+	}
+	else if(val2->is<ASString>())
 	{
 		tiny_string a = val1->toString();
 		tiny_string b = val2->toString();
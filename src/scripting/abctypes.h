@@ -22,7 +22,9 @@
 
 #include "swftypes.h"
 #include "memory_support.h"
+#include "asobject.h"
 #include <unordered_set>
+#include <deque>
 
 class memorystream;
 
@@ -263,6 +265,10 @@ struct method_info_simple
 	std::vector<u30> param_names;
 };
 typedef void (*abc_function)(struct call_context*);
+#ifdef BASELINE_JIT_ENABLED
+// entry point of a method compiled by the BaselineJit, the second argument is the return value of the method
+typedef void (*jit_function)(struct call_context*, asAtom*);
+#endif
 
 struct preloadedcodedata
 {
@@ -303,7 +309,9 @@ struct preloadedcodedata
 		int32_t arg3_int;
 		uint32_t arg3_uint;
 	};
-	preloadedcodedata():func(nullptr),cacheobj1(nullptr),cacheobj2(nullptr),cacheobj3(nullptr) {}
+	// inline cache of getproperty/setproperty instructions with a static name
+	PropertyCache* propertycache;
+	preloadedcodedata():func(nullptr),cacheobj1(nullptr),cacheobj2(nullptr),cacheobj3(nullptr),propertycache(nullptr) {}
 };
 struct localconstantslot
 {
@@ -313,7 +321,12 @@ struct localconstantslot
 
 struct method_body_info
 {
-	method_body_info():localresultcount(0),hit_count(0),codeStatus(ORIGINAL){}
+	method_body_info():localresultcount(0),hit_count(0),codeStatus(ORIGINAL)
+	{
+#ifdef BASELINE_JIT_ENABLED
+		jitcode=nullptr;
+#endif
+	}
 	u30 method;
 	u30 max_stack;
 	u30 local_count;
@@ -333,6 +346,12 @@ struct method_body_info
 	// list of local/slot pairs that were optimized away
 	std::vector<localconstantslot> localconstantslots;
 	std::vector<preloadedcodedata> preloadedcode;
+	// storage for the inline caches of preloadedcode, a deque keeps the pointers valid when adding caches
+	std::deque<PropertyCache> propertycaches;
+#ifdef BASELINE_JIT_ENABLED
+	// machine code generated for preloadedcode, nullptr while the method is interpreted
+	jit_function jitcode;
+#endif
 	inline uint16_t getReturnValuePos() const { return returnvaluepos; }
 };
 
@@ -27,12 +27,52 @@
 using namespace std;
 using namespace lightspark;
 
-void ACTIONRECORD::PushStack(std::stack<asAtom> &stack, const asAtom &a)
+//Number of operands kept on the C stack, deeper operand stacks are moved to the heap
+#define AVM1_INLINE_STACK_SIZE 64
+//Registers available at least, the preloaded values use registers 1 to 6
+#define AVM1_MIN_REGISTERS 8
+
+namespace lightspark
+{
+class AVM1Stack
+{
+private:
+	asAtom inlinevalues[AVM1_INLINE_STACK_SIZE];
+	asAtom* values;
+	uint32_t count;
+	uint32_t capacity;
+public:
+	AVM1Stack():values(inlinevalues),count(0),capacity(AVM1_INLINE_STACK_SIZE) {}
+	~AVM1Stack()
+	{
+		if (values != inlinevalues)
+			delete[] values;
+	}
+	bool empty() const { return count == 0; }
+	const asAtom& top() const { return values[count-1]; }
+	void pop() { count--; }
+	void push(const asAtom& a)
+	{
+		if (count == capacity)
+		{
+			asAtom* v = new asAtom[capacity*2];
+			std::copy(values,values+count,v);
+			if (values != inlinevalues)
+				delete[] values;
+			values = v;
+			capacity *= 2;
+		}
+		values[count++] = a;
+	}
+};
+}
+
+void ACTIONRECORD::PushStack(AVM1Stack &stack, const asAtom &a)
 {
 	stack.push(a);
 }
 
-asAtom ACTIONRECORD::PopStack(std::stack<asAtom>& stack)
+asAtom ACTIONRECORD::PopStack(AVM1Stack& stack)
 {
 	if (stack.empty())
 		return asAtomHandler::undefinedAtom;
@@ -40,33 +80,311 @@ asAtom ACTIONRECORD::PopStack(std::stack<asAtom>& stack)
 	stack.pop();
 	return ret;
 }
-asAtom ACTIONRECORD::PeekStack(std::stack<asAtom>& stack)
+asAtom ACTIONRECORD::PeekStack(AVM1Stack& stack)
 {
 	if (stack.empty())
 		throw RunTimeException("AVM1: empty stack");
 	return stack.top();
 }
+
+AVM1Code::AVM1Code(SystemState* sys, const std::vector<uint8_t>& actions, uint32_t startpos):startinstruction(AVM1_END_OF_CODE),registercount(0)
+{
+	decode(sys,actions.data(),actions.size(),startpos);
+}
+
+AVM1Code::AVM1Code(SystemState* sys, const uint8_t* data, uint32_t size):startinstruction(AVM1_END_OF_CODE),registercount(0)
+{
+	decode(sys,data,size,0);
+}
+
+void AVM1Code::decode(SystemState* sys, const uint8_t* data, uint32_t size, uint32_t startpos)
+{
+	std::vector<uint32_t> instructionAt(size,AVM1_END_OF_CODE);
+	std::vector<uint32_t> branches;
+	startinstruction = decodeFrom(sys,data,size,startpos,instructionAt,branches);
+	// decode the branch targets, this may add more branches
+	while (!branches.empty())
+	{
+		uint32_t i = branches.back();
+		branches.pop_back();
+		uint32_t target = decodeFrom(sys,data,size,instructions[i].target,instructionAt,branches);
+		instructions[i].target = target;
+	}
+	instructions.shrink_to_fit();
+}
+
+static uint32_t readUI16(const uint8_t* data, uint32_t size, uint32_t& pos)
+{
+	uint32_t ret = 0;
+	if (pos < size)
+		ret = data[pos];
+	if (pos+1 < size)
+		ret |= uint32_t(data[pos+1])<<8;
+	pos += 2;
+	return ret;
+}
+static uint8_t readUI8(const uint8_t* data, uint32_t size, uint32_t& pos)
+{
+	uint8_t ret = pos < size ? data[pos] : 0;
+	pos++;
+	return ret;
+}
+static tiny_string readString(const uint8_t* data, uint32_t size, uint32_t& pos)
+{
+	if (pos >= size)
+	{
+		pos++;
+		return tiny_string();
+	}
+	uint32_t end = pos;
+	while (end < size && data[end])
+		end++;
+	tiny_string ret(std::string((const char*)data+pos,end-pos));
+	pos = end+1;
+	return ret;
+}
+
+uint32_t AVM1Code::decodeFrom(SystemState* sys, const uint8_t* data, uint32_t size, uint32_t pos, std::vector<uint32_t>& instructionAt, std::vector<uint32_t>& branches)
+{
+	uint32_t startpos = pos;
+	uint32_t prev = AVM1_END_OF_CODE;
+	while (pos < size && instructionAt[pos] == AVM1_END_OF_CODE)
+	{
+		Instruction ins;
+		ins.pos = pos;
+		ins.next = AVM1_END_OF_CODE;
+		ins.target = AVM1_END_OF_CODE;
+		ins.arg1 = 0;
+		ins.arg2 = 0;
+		ins.opcode = data[pos++];
+		uint32_t len = 0;
+		if (ins.opcode > 0x80)
+			len = readUI16(data,size,pos);
+		uint32_t endpos = pos+len;
+		bool fallthrough = true;
+		switch (ins.opcode)
+		{
+			case 0x00:
+				fallthrough = false;
+				break;
+			case 0x81: // ActionGotoFrame
+				ins.arg1 = readUI16(data,size,pos);
+				endpos = pos;
+				break;
+			case 0x83: // ActionGetURL
+				ins.arg1 = strings.size();
+				strings.push_back(readString(data,size,pos));
+				strings.push_back(readString(data,size,pos));
+				endpos = pos;
+				break;
+			case 0x87: // ActionStoreRegister
+				ins.arg1 = readUI8(data,size,pos);
+				registercount = max(registercount,ins.arg1+1);
+				endpos = pos;
+				break;
+			case 0x88: // ActionConstantPool
+			{
+				uint32_t c = readUI16(data,size,pos);
+				ins.arg1 = constants.size();
+				ins.arg2 = c;
+				for (uint32_t i = 0; i < c; i++)
+					constants.push_back(sys->getUniqueStringId(readString(data,size,pos)));
+				endpos = pos;
+				break;
+			}
+			case 0x8a: // ActionWaitForFrame
+				ins.arg1 = readUI16(data,size,pos);
+				ins.arg2 = readUI8(data,size,pos);
+				endpos = pos;
+				break;
+			case 0x8b: // ActionSetTarget
+			case 0x8c: // ActionGotoLabel
+				ins.arg1 = strings.size();
+				strings.push_back(readString(data,size,pos));
+				endpos = pos;
+				break;
+			case 0x8d: // ActionWaitForFrame2
+				ins.arg1 = readUI8(data,size,pos);
+				endpos = pos;
+				break;
+			case 0x8e: // ActionDefineFunction2
+			case 0x9b: // ActionDefineFunction
+			{
+				FunctionDefinition f;
+				f.isFunction2 = ins.opcode == 0x8e;
+				f.flags = 0;
+				f.preloadGlobal = false;
+				f.name = readString(data,size,pos);
+				uint32_t paramcount = readUI16(data,size,pos);
+				uint32_t declaredregisters = 0;
+				if (f.isFunction2)
+				{
+					declaredregisters = readUI8(data,size,pos);
+					f.flags = readUI8(data,size,pos);
+					f.preloadGlobal = readUI8(data,size,pos)&0x01;
+				}
+				for (uint32_t i=0; i < paramcount; i++)
+				{
+					if (f.isFunction2)
+						f.registernumbers.push_back(readUI8(data,size,pos));
+					tiny_string n = readString(data,size,pos);
+					f.paramnames.push_back(sys->getUniqueStringId(n.lowercase()));
+				}
+				uint32_t codesize = readUI16(data,size,pos);
+				if (pos > size)
+					pos = size;
+				codesize = min(codesize,size-pos);
+				f.body = _MR(new AVM1Code(sys,data+pos,codesize));
+				f.body->registercount = max(f.body->registercount,declaredregisters);
+				pos += codesize;
+				ins.arg1 = functions.size();
+				functions.push_back(f);
+				endpos = pos;
+				break;
+			}
+			case 0x94: // ActionWith
+			{
+				uint32_t codesize = readUI16(data,size,pos);
+				ins.target = pos+codesize;
+				endpos = pos;
+				break;
+			}
+			case 0x96: // ActionPush
+			{
+				ins.arg1 = pushvalues.size();
+				uint32_t end = min(endpos,size);
+				while (pos < end)
+				{
+					PushValue v;
+					v.type = data[pos++];
+					v.numberval = 0;
+					switch (v.type)
+					{
+						case 0:
+							v.stringID = sys->getUniqueStringId(readString(data,size,pos));
+							break;
+						case 1:
+						{
+							FLOAT f;
+							if (pos+4 <= size)
+								f.read(data+pos);
+							pos += 4;
+							v.numberval = (float)f;
+							break;
+						}
+						case 4:
+							v.index = readUI8(data,size,pos);
+							registercount = max(registercount,v.index+1);
+							break;
+						case 5:
+							v.boolval = readUI8(data,size,pos);
+							break;
+						case 6:
+						{
+							DOUBLE d;
+							if (pos+8 <= size)
+								d.read(data+pos);
+							pos += 8;
+							v.numberval = (double)d;
+							break;
+						}
+						case 7:
+						{
+							uint32_t low = readUI16(data,size,pos);
+							uint32_t high = readUI16(data,size,pos);
+							v.intval = (int32_t)(low | (high<<16));
+							break;
+						}
+						case 8:
+							v.index = readUI8(data,size,pos);
+							break;
+						case 9:
+							v.index = readUI16(data,size,pos);
+							break;
+						default:
+							break;
+					}
+					pushvalues.push_back(v);
+				}
+				ins.arg2 = pushvalues.size()-ins.arg1;
+				endpos = max(pos,endpos);
+				break;
+			}
+			case 0x99: // ActionJump
+			case 0x9d: // ActionIf
+			{
+				int32_t skip = int16_t(readUI16(data,size,pos));
+				endpos = pos;
+				if (skip < 0 && int64_t(pos) < -skip)
+				{
+					LOG(LOG_ERROR,"AVM1: invalid skip target:"<< skip<<" "<<pos<<" "<<size);
+					ins.target = 0;
+				}
+				else if (skip >= 0 && int64_t(pos)+skip > size)
+				{
+					LOG(LOG_ERROR,"AVM1: invalid skip target:"<< skip<<" "<<pos<<" "<<size);
+					ins.target = size;
+				}
+				else
+					ins.target = pos+skip;
+				branches.push_back(instructions.size());
+				// the bytes after an unconditional jump are only decoded if they are the target of another branch
+				fallthrough = ins.opcode == 0x9d;
+				break;
+			}
+			case 0x9a: // ActionGetURL2
+				ins.arg1 = readUI8(data,size,pos);
+				endpos = pos;
+				break;
+			case 0x9f: // ActionGotoFrame2
+				ins.arg1 = readUI8(data,size,pos);
+				if (ins.arg1 & 0x02)
+					ins.arg2 = readUI16(data,size,pos);
+				endpos = pos;
+				break;
+			default:
+				// actions without operands or not implemented, their operands are skipped
+				break;
+		}
+		uint32_t index = instructions.size();
+		instructionAt[ins.pos] = index;
+		instructions.push_back(ins);
+		if (prev != AVM1_END_OF_CODE)
+			instructions[prev].next = index;
+		prev = fallthrough ? index : AVM1_END_OF_CODE;
+		if (!fallthrough)
+			break;
+		pos = endpos;
+	}
+	if (prev != AVM1_END_OF_CODE && pos < size)
+		instructions[prev].next = instructionAt[pos];
+	return startpos < size ? instructionAt[startpos] : AVM1_END_OF_CODE;
+}
 Mutex executeactionmutex;
-void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, const std::vector<uint8_t> &actionlist, uint32_t startactionpos, std::map<uint32_t, asAtom> &scopevariables, asAtom* result, asAtom* obj, asAtom *args, uint32_t num_args, const std::vector<uint32_t>& paramnames, const std::vector<uint8_t>& paramregisternumbers,
+void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, const AVM1Code* code, std::map<uint32_t, asAtom> &scopevariables, asAtom* result, asAtom* obj, asAtom *args, uint32_t num_args, const std::vector<uint32_t>& paramnames, const std::vector<uint8_t>& paramregisternumbers,
 								  bool preloadParent, bool preloadRoot, bool suppressSuper, bool preloadSuper, bool suppressArguments, bool preloadArguments, bool suppressThis, bool preloadThis, bool preloadGlobal, AVM1Function *caller, AVM1Function *callee, Activation_object *actobj, asAtom *superobj)
 {
 	Locker l(executeactionmutex);
 	assert(!clip->needsActionScript3());
 	Log::calls_indent++;
-	LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" executeActions "<<preloadParent<<preloadRoot<<suppressSuper<<preloadSuper<<suppressArguments<<preloadArguments<<suppressThis<<preloadThis<<preloadGlobal<<" "<<startactionpos<<" "<<num_args);
+	LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" executeActions "<<preloadParent<<preloadRoot<<suppressSuper<<preloadSuper<<suppressArguments<<preloadArguments<<suppressThis<<preloadThis<<preloadGlobal<<" "<<num_args);
 	if (result)
 		asAtomHandler::setUndefined(*result);
-	std::stack<asAtom> stack;
-	asAtom registers[256];
-	std::fill_n(registers,256,asAtomHandler::undefinedAtom);
+	AVM1Stack stack;
+	uint32_t registercount = max(code->getRegisterCount(),uint32_t(AVM1_MIN_REGISTERS));
+	for (uint32_t i = 0; i < paramregisternumbers.size(); i++)
+		registercount = max(registercount,uint32_t(paramregisternumbers[i])+1);
+	asAtom* registers = g_newa(asAtom, registercount);
+	std::fill_n(registers,registercount,asAtomHandler::undefinedAtom);
 	std::map<uint32_t,asAtom> locals;
 	int curdepth = 0;
 	int maxdepth= clip->loadedFrom->version < 6 ? 8 : 16;
 	asAtom* scopestack = g_newa(asAtom, maxdepth);
 	scopestack[0] = obj ? *obj : asAtomHandler::fromObject(clip);
 	ASATOM_INCREF(scopestack[0]);
-	std::vector<uint8_t>::const_iterator* scopestackstop = g_newa(std::vector<uint8_t>::const_iterator, maxdepth);
-	scopestackstop[0] = actionlist.end();
+	// byte offsets of the ends of the ActionWith blocks
+	uint32_t* scopestackstop = g_newa(uint32_t, maxdepth);
+	scopestackstop[0] = UINT32_MAX;
 	uint32_t currRegister = 1; // spec is not clear, but gnash starts at register 1
 	if (!suppressThis || preloadThis)
 	{
@@ -177,10 +495,12 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 
 	Array* argarray = nullptr;
 	DisplayObject *originalclip = clip;
-	auto it = actionlist.begin()+startactionpos;
-	while (it != actionlist.end())
+	uint32_t pc = code->startinstruction;
+	while (pc != AVM1_END_OF_CODE)
 	{
-		if (curdepth > 0 && it == scopestackstop[curdepth])
+		const AVM1Code::Instruction& ins = code->instructions[pc];
+		pc = ins.next;
+		if (curdepth > 0 && ins.pos == scopestackstop[curdepth])
 		{
 			LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" end with "<<asAtomHandler::toDebugString(scopestack[curdepth]));
 			if (asAtomHandler::is<DisplayObject>(scopestack[curdepth]))
@@ -190,21 +510,19 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			Log::calls_indent--;
 		}
 		if (!clip
-				&& *it != 0x20 // ActionSetTarget2
-				&& *it != 0x8b // ActionSetTarget
+				&& ins.opcode != 0x20 // ActionSetTarget2
+				&& ins.opcode != 0x8b // ActionSetTarget
 				)
 		{
 			// we are in a target that was not found during ActionSetTarget(2), so these actions are ignored
 			continue;
 		}
-		LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<< " "<<(it-actionlist.begin())<< " action code:"<<hex<<(int)*it<<dec<<" "<<clip->toDebugString());
-		uint8_t opcode = *it++;
-		if (opcode > 0x80)
-			it+=2; // skip length
+		LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<< " "<<ins.pos<< " action code:"<<hex<<(int)ins.opcode<<dec<<" "<<clip->toDebugString());
+		uint8_t opcode = ins.opcode;
 		switch (opcode)
 		{
 			case 0x00:
-				it = actionlist.end(); // force quit loop;
+				pc = AVM1_END_OF_CODE; // force quit loop;
 				break;
 			case 0x04: // ActionNextFrame
 			{
@@ -968,7 +1286,7 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			}
 			case 0x34: // ActionGetTime
 			{
-				gint64 runtime = compat_msectiming()-clip->getSystemState()->startTime;
+				gint64 runtime = EngineClock::getTime()-clip->getSystemState()->startTime;
 				asAtom ret=asAtomHandler::fromNumber(clip->getSystemState(),(number_t)runtime,false);
 				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionGetTime "<<asAtomHandler::toDebugString(ret));
 				PushStack(stack,asAtom(ret));
@@ -1949,17 +2267,15 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 					LOG(LOG_ERROR,"AVM1:"<<clip->getTagID()<<" no MovieClip for ActionGotoFrame "<<clip->toDebugString());
 					break;
 				}
-				uint32_t frame = uint32_t(*it++) | ((*it++)<<8);
+				uint32_t frame = ins.arg1;
 				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionGotoFrame "<<frame);
 				clip->as<MovieClip>()->AVM1gotoFrame(frame,true,!clip->as<MovieClip>()->state.stop_FP);
 				break;
 			}
 			case 0x83: // ActionGetURL
 			{
-				tiny_string s1((const char*)&(*it));
-				it += s1.numBytes()+1;
-				tiny_string s2((const char*)&(*it));
-				it += s2.numBytes()+1;
+				const tiny_string& s1 = code->strings[ins.arg1];
+				const tiny_string& s2 = code->strings[ins.arg1+1];
 				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionGetURL "<<s1<<" "<<s2);
 				clip->getSystemState()->openPageInBrowser(s1,s2);
 				break;
@@ -1968,21 +2284,17 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			{
 				asAtom a = PeekStack(stack);
 				ASATOM_INCREF(a);
-				uint8_t num = *it++;
+				uint8_t num = ins.arg1;
 				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionStoreRegister "<<(int)num<<" "<<asAtomHandler::toDebugString(a));
 				registers[num] = a;
 				break;
 			}
 			case 0x88: // ActionConstantPool
 			{
-				uint32_t c = uint32_t(*it++) | ((*it++)<<8);
+				uint32_t c = ins.arg2;
 				context->AVM1ClearConstants();
 				for (uint32_t i = 0; i < c; i++)
-				{
-					tiny_string s((const char*)&(*it),true);
-					it += s.numBytes()+1;
-					context->AVM1AddConstant(clip->getSystemState()->getUniqueStringId(s));
-				}
+					context->AVM1AddConstant(code->constants[ins.arg1+i]);
 				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionConstantPool "<<c);
 				break;
 			}
@@ -1993,32 +2305,26 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 					LOG(LOG_ERROR,"AVM1:"<<clip->getTagID()<<" no MovieClip for ActionWaitForFrame "<<clip->toDebugString());
 					break;
 				}
-				uint32_t frame = uint32_t(*it++) | ((*it++)<<8);
-				uint32_t skipcount = (uint32_t)(*it++);
+				uint32_t frame = ins.arg1;
+				uint32_t skipcount = ins.arg2;
 				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionWaitForFrame "<<frame<<"/"<<clip->as<MovieClip>()->getFramesLoaded()<<" skip "<<skipcount);
 				if (clip->as<MovieClip>()->getFramesLoaded() <= frame && !clip->as<MovieClip>()->hasFinishedLoading())
 				{
 					// frame not yet loaded, skip actions
-					while (skipcount && it != actionlist.end())
+					while (skipcount && pc != AVM1_END_OF_CODE)
 					{
-						it++;
-						if (*it > 0x80)
-						{
-							uint32_t c = uint32_t(*it++) | ((*it++)<<8);
-							it+=c;
-						}
+						pc = code->instructions[pc].next;
 						skipcount--;
 					}
 				}
 				break;
 			}
 			case 0x08: // ActionToggleQuality
-				LOG(LOG_NOT_IMPLEMENTED,"AVM1:"<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" SWF3 DoActionTag ActionToggleQuality "<<hex<<(int)*it);
+				LOG(LOG_NOT_IMPLEMENTED,"AVM1:"<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" SWF3 DoActionTag ActionToggleQuality");
 				break;
 			case 0x8b: // ActionSetTarget
 			{
-				tiny_string s((const char*)&(*it));
-				it += s.numBytes()+1;
+				tiny_string s = code->strings[ins.arg1];
 				if (!clip)
 				{
 					LOG_CALL("AVM1: ActionSetTarget: setting target from undefined value to "<<s);
@@ -2044,19 +2350,16 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 					LOG(LOG_ERROR,"AVM1:"<<clip->getTagID()<<" no MovieClip for ActionGotoLabel "<<clip->toDebugString());
 					break;
 				}
-				tiny_string s((const char*)&(*it));
-				it += s.numBytes()+1;
+				const tiny_string& s = code->strings[ins.arg1];
 				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionGotoLabel "<<s);
 				clip->as<MovieClip>()->AVM1gotoFrameLabel(s,true,!clip->as<MovieClip>()->state.stop_FP);
 				break;
 			}
 			case 0x8e: // ActionDefineFunction2
 			{
-				tiny_string name((const char*)&(*it),true);
-				it += name.numBytes()+1;
-				uint32_t paramcount = uint32_t(*it++) | ((*it++)<<8);
-				*it++; //register count not used
-				uint8_t flags = *it++;
+				const AVM1Code::FunctionDefinition& def = code->functions[ins.arg1];
+				const tiny_string& name = def.name;
+				uint8_t flags = def.flags;
 				bool flag1 = flags&0x80;//PreloadParent
 				bool flag2 = flags&0x40;//PreloadRoot
 				bool flag3 = flags&0x20;//SuppressSuper
@@ -2065,24 +2368,11 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 				bool flag6 = flags&0x04;//PreloadArguments
 				bool flag7 = flags&0x02;//SuppressThis
 				bool flag8 = flags&0x01;//PreloadThis
-				bool flag9 = (*it++)&0x01;//PreloadGlobal
-				std::vector<uint32_t> funcparamnames;
-				std::vector<uint8_t> registernumber;
-				for (uint16_t i=0; i < paramcount; i++)
-				{
-					uint8_t regnum = *it++;
-					tiny_string n((const char*)&(*it),true);
-					it += n.numBytes()+1;
-					funcparamnames.push_back(clip->getSystemState()->getUniqueStringId(n.lowercase()));
-					registernumber.push_back(regnum);
-				}
-				uint32_t codesize = uint32_t(*it++) | ((*it++)<<8);
-				vector<uint8_t> code;
-				code.assign(it,it+codesize);
-				it += codesize;
-				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionDefineFunction2 "<<name<<" "<<paramcount<<" "<<flag1<<flag2<<flag3<<flag4<<flag5<<flag6<<flag7<<flag8<<flag9<<" "<<codesize);
+				bool flag9 = def.preloadGlobal;//PreloadGlobal
+				std::vector<uint32_t> funcparamnames = def.paramnames;
+				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionDefineFunction2 "<<name<<" "<<funcparamnames.size()<<" "<<flag1<<flag2<<flag3<<flag4<<flag5<<flag6<<flag7<<flag8<<flag9);
 				clip->incRef();
-				AVM1Function* f = Class<IFunction>::getAVM1Function(clip->getSystemState(),clip,name == "" ? new_activationObject(clip->getSystemState()) : nullptr,context,funcparamnames,code,locals,registernumber,flag1, flag2, flag3, flag4, flag5, flag6, flag7, flag8, flag9);
+				AVM1Function* f = Class<IFunction>::getAVM1Function(clip->getSystemState(),clip,name == "" ? new_activationObject(clip->getSystemState()) : nullptr,context,funcparamnames,def.body,locals,def.registernumbers,flag1, flag2, flag3, flag4, flag5, flag6, flag7, flag8, flag9);
 				//Create the prototype object
 				f->prototype = _MR(new_asobject(f->getSystemState()));
 				if (name == "")
@@ -2111,17 +2401,17 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			case 0x94: // ActionWith
 			{
 				asAtom obj = PopStack(stack);
-				uint32_t codesize = uint32_t(*it++) | ((*it++)<<8);
-				auto itend = it;
-				itend+=codesize;
+				uint32_t itend = ins.target;
 				if (curdepth >= maxdepth)
 				{
-					it = itend;
+					// skip the block
+					while (pc != AVM1_END_OF_CODE && code->instructions[pc].pos < itend)
+						pc = code->instructions[pc].next;
 					LOG(LOG_ERROR,"AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionWith depth exceeds maxdepth");
 					break;
 				}
 				Log::calls_indent++;
-				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionWith "<<codesize<<" "<<asAtomHandler::toDebugString(obj));
+				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionWith "<<itend<<" "<<asAtomHandler::toDebugString(obj));
 				++curdepth;
 				if (asAtomHandler::is<DisplayObject>(obj))
 					clip = asAtomHandler::as<DisplayObject>(obj);
@@ -2131,30 +2421,22 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			}
 			case 0x96: // ActionPush
 			{
-				uint32_t len = ((*(it-1))<<8) | (*(it-2));
-				while (len > 0)
+				for (uint32_t i = 0; i < ins.arg2; i++)
 				{
-					uint8_t type = *it++;
-					len--;
+					const AVM1Code::PushValue& v = code->pushvalues[ins.arg1+i];
+					uint8_t type = v.type;
 					switch (type)
 					{
 						case 0:
 						{
-							tiny_string val((const char*)&(*it),true);
-							len -= val.numBytes()+1;
-							it += val.numBytes()+1;
-							asAtom a = asAtomHandler::fromStringID(clip->getSystemState()->getUniqueStringId(val));
+							asAtom a = asAtomHandler::fromStringID(v.stringID);
 							PushStack(stack,a);
 							LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionPush 0 "<<asAtomHandler::toDebugString(a));
 							break;
 						}
 						case 1:
 						{
-							FLOAT f;
-							f.read((const uint8_t*)&(*it));
-							it+=4;
-							len-=4;
-							asAtom a = asAtomHandler::fromNumber(clip->getSystemState(),f,false);
+							asAtom a = asAtomHandler::fromNumber(clip->getSystemState(),v.numberval,false);
 							PushStack(stack,a);
 							LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionPush 1 "<<asAtomHandler::toDebugString(a));
 							break;
@@ -2169,8 +2451,7 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 							break;
 						case 4:
 						{
-							uint32_t reg = *it++;
-							len--;
+							uint32_t reg = v.index;
 							asAtom a = registers[reg];
 							ASATOM_INCREF(a);
 							PushStack(stack,a);
@@ -2179,37 +2460,28 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 						}
 						case 5:
 						{
-							asAtom a = asAtomHandler::fromBool((bool)*it++);
-							len--;
+							asAtom a = asAtomHandler::fromBool(v.boolval);
 							PushStack(stack,a);
 							LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionPush 5 "<<asAtomHandler::toDebugString(a));
 							break;
 						}
 						case 6:
 						{
-							DOUBLE d;
-							d.read((const uint8_t*)&(*it));
-							it+=8;
-							len-=8;
-							asAtom a = asAtomHandler::fromNumber(clip->getSystemState(),d,false);
+							asAtom a = asAtomHandler::fromNumber(clip->getSystemState(),v.numberval,false);
 							PushStack(stack,a);
 							LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionPush 6 "<<asAtomHandler::toDebugString(a));
 							break;
 						}
 						case 7:
 						{
-							uint32_t d=GUINT32_FROM_LE(*(uint32_t*)&(*it));
-							it+=4;
-							len-=4;
-							asAtom a = asAtomHandler::fromInt((int32_t)d);
+							asAtom a = asAtomHandler::fromInt(v.intval);
 							PushStack(stack,a);
 							LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionPush 7 "<<asAtomHandler::toDebugString(a));
 							break;
 						}
 						case 8:
 						{
-							uint32_t index = (*it++);
-							len--;
+							uint32_t index = v.index;
 							asAtom a = context->AVM1GetConstant(index);
 							PushStack(stack,a);
 							LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionPush 8 "<<index<<" "<<asAtomHandler::toDebugString(a));
@@ -2217,8 +2489,7 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 						}
 						case 9:
 						{
-							uint32_t index = uint32_t(*it++) | ((*it++)<<8);
-							len-=2;
+							uint32_t index = v.index;
 							asAtom a = context->AVM1GetConstant(index);
 							PushStack(stack,a);
 							LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionPush 9 "<<index<<" "<<asAtomHandler::toDebugString(a));
@@ -2233,27 +2504,16 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			}
 			case 0x99: // ActionJump
 			{
-				int32_t skip = int16_t((*it++) | ((*it++)<<8));
-				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionJump "<<skip<<" "<< (it-actionlist.begin()));
-				if (skip < 0 && it-actionlist.begin() < -skip)
-				{
-					LOG(LOG_ERROR,"ActionJump: invalid skip target:"<< skip<<" "<<(it-actionlist.begin())<<" "<<actionlist.size());
-					it = actionlist.begin();
-				}
-				if (skip >=0 && skip + (it-actionlist.begin()) > (int)actionlist.size())
-				{
-					LOG(LOG_ERROR,"ActionJump: invalid skip target:"<< skip<<" "<<(it-actionlist.begin())<<" "<<actionlist.size());
-					it = actionlist.end();
-				}
-				else
-					it+= skip;
+				// invalid targets have been reported and clamped when decoding
+				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionJump "<<ins.pos<<" "<<ins.target);
+				pc = ins.target;
 				break;
 			}
 			case 0x9a: // ActionGetURL2
 			{
 				asAtom at=PopStack(stack);
 				asAtom au=PopStack(stack);
-				uint8_t b = *it++;
+				uint8_t b = ins.arg1;
 				uint8_t method = b&0xc0>>6;
 				bool loadtarget = b&0x02;
 				bool loadvars = b&0x01;
@@ -2288,23 +2548,12 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			}
 			case 0x9b: // ActionDefineFunction
 			{
-				tiny_string name((const char*)&(*it),true);
-				it += name.numBytes()+1;
-				uint32_t paramcount = uint32_t(*it++) | ((*it++)<<8);
-				std::vector<uint32_t> paramnames;
-				for (uint16_t i=0; i < paramcount; i++)
-				{
-					tiny_string n((const char*)&(*it),true);
-					it += n.numBytes()+1;
-					paramnames.push_back(clip->getSystemState()->getUniqueStringId(n.lowercase()));
-				}
-				uint32_t codesize = uint32_t(*it++) | ((*it++)<<8);
-				vector<uint8_t> code;
-				code.assign(it,it+codesize);
-				it += codesize;
-				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionDefineFunction "<<name<<" "<<paramcount);
+				const AVM1Code::FunctionDefinition& def = code->functions[ins.arg1];
+				const tiny_string& name = def.name;
+				std::vector<uint32_t> paramnames = def.paramnames;
+				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionDefineFunction "<<name<<" "<<paramnames.size());
 				clip->incRef();
-				AVM1Function* f = Class<IFunction>::getAVM1Function(clip->getSystemState(),clip,name == "" ? new_activationObject(clip->getSystemState()) : nullptr,context,paramnames,code,locals);
+				AVM1Function* f = Class<IFunction>::getAVM1Function(clip->getSystemState(),clip,name == "" ? new_activationObject(clip->getSystemState()) : nullptr,context,paramnames,def.body,locals);
 				//Create the prototype object
 				f->prototype = _MR(new_asobject(f->getSystemState()));
 				if (name == "")
@@ -2332,24 +2581,10 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			}
 			case 0x9d: // ActionIf
 			{
-				int32_t skip = int16_t((*it++) | ((*it++)<<8));
 				asAtom a = PopStack(stack);
-				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionIf "<<asAtomHandler::toDebugString(a)<<" "<<skip);
+				LOG_CALL("AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" ActionIf "<<asAtomHandler::toDebugString(a)<<" "<<ins.pos<<" "<<ins.target);
 				if (asAtomHandler::AVM1toBool(a))
-				{
-					if (skip < 0 && it-actionlist.begin() < -skip)
-					{
-						LOG(LOG_ERROR,"ActionIf: invalid skip target:"<< skip<<" "<<(it-actionlist.begin())<<" "<<actionlist.size());
-						it = actionlist.begin();
-					}
-					if (skip >=0 && skip + (it-actionlist.begin()) > (int)actionlist.size())
-					{
-						LOG(LOG_ERROR,"ActionIf: invalid skip target:"<< skip<<" "<<(it-actionlist.begin())<<" "<<actionlist.size());
-						it = actionlist.end();
-					}
-					else
-						it += skip;
-				}
+					pc = ins.target;
 				ASATOM_DECREF(a);
 				break;
 			}
@@ -2378,12 +2613,8 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			}
 			case 0x9f: // ActionGotoFrame2
 			{
-				bool biasflag = (*it)&0x02;
-				bool playflag = (*it)&0x01;
-				it++;
-				uint32_t biasframe = 0;
-				if (biasflag)
-					biasframe = uint32_t(*it++) | ((*it++)<<8);
+				bool playflag = ins.arg1&0x01;
+				uint32_t biasframe = ins.arg2;
 				
 				asAtom a = PopStack(stack);
 				if (!clip->is<MovieClip>())
@@ -2412,8 +2643,7 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			}
 			case 0x8d: // ActionWaitForFrame2
 			{
-				uint32_t skipcount= (*it);
-				it++;
+				uint32_t skipcount= ins.arg1;
 				asAtom a = PopStack(stack);
 				if (!clip->is<MovieClip>())
 				{
@@ -2434,14 +2664,9 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 				if (clip->as<MovieClip>()->getFramesLoaded() <= frame && !clip->as<MovieClip>()->hasFinishedLoading())
 				{
 					// frame not yet loaded, skip actions
-					while (skipcount && it != actionlist.end())
+					while (skipcount && pc != AVM1_END_OF_CODE)
 					{
-						it++;
-						if (*it > 0x80)
-						{
-							uint32_t c = uint32_t(*it++) | ((*it++)<<8);
-							it+=c;
-						}
+						pc = code->instructions[pc].next;
 						skipcount--;
 					}
 				}
@@ -2457,11 +2682,6 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			case 0x36: // ActionMBCharToAscii
 			case 0x37: // ActionMBAsciiToChar
 				LOG(LOG_NOT_IMPLEMENTED,"AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" SWF4 DoActionTag "<<hex<<(int)opcode);
-				if(opcode >= 0x80)
-				{
-					uint32_t len = ((*(it-1))<<8) | (*(it-2));
-					it+=len;
-				}
 				break;
 			case 0x45: // ActionTargetPath
 			case 0x46: // ActionEnumerate
@@ -2474,11 +2694,6 @@ void ACTIONRECORD::executeActions(DisplayObject *clip, AVM1context* context, con
 			case 0x2c: // ActionImplementsOp
 			case 0x8f: // ActionTry
 				LOG(LOG_NOT_IMPLEMENTED,"AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" SWF7 DoActionTag "<<hex<<(int)opcode);
-				if(opcode >= 0x80)
-				{
-					uint32_t len = ((*(it-1))<<8) | (*(it-2));
-					it+=len;
-				}
 				break;
 			default:
 				LOG(LOG_NOT_IMPLEMENTED,"AVM1:"<<clip->getTagID()<<" "<<(clip->is<MovieClip>() ? clip->as<MovieClip>()->state.FP : 0)<<" invalid DoActionTag "<<hex<<(int)opcode);
@@ -22,18 +22,23 @@
 #include "scripting/flash/display/flashdisplay.h"
 #include "backends/rendering.h"
 #include "backends/image.h"
+#include "backends/bitmapdecoder.h"
 #include "swf.h"
 
 using namespace std;
 using namespace lightspark;
 
 BitmapContainer::BitmapContainer(MemoryAccount* m):stride(0),width(0),height(0),
-	data(reporter_allocator<uint8_t>(m))
+	data(reporter_allocator<uint8_t>(m)),source(nullptr),pins(0),decoder(nullptr),needsDecode(false),decoding(false),
+	recentlyUsed(false),inDecodedList(false)
 {
 }
 
 BitmapContainer::~BitmapContainer()
 {
+	if (decoder)
+		decoder->removeDecoded(this);
+	delete source;
         if (bitmaptexture.isValid())
         {
                 RenderThread* rt = getSys()->getRenderThread();
@@ -44,6 +49,120 @@ BitmapContainer::~BitmapContainer()
         }
 }
 
+void BitmapContainer::setSource(BitmapSource* s, int32_t w, int32_t h, BitmapDecoder* d)
+{
+	assert(data.empty() && !source);
+	source = s;
+	decoder = d;
+	width = w;
+	height = h;
+	RELEASE_WRITE(needsDecode, true);
+}
+
+void BitmapContainer::decode()
+{
+	decodeMutex.lock();
+	// The mutex is recursive, the source may use the accessors of the container while decoding
+	if (!ACQUIRE_READ(needsDecode) || decoding)
+	{
+		decodeMutex.unlock();
+		return;
+	}
+	decoding = true;
+	int32_t w = width;
+	int32_t h = height;
+	uint64_t start = compat_msectiming();
+	bool ok = false;
+	try
+	{
+		ok = source->decode(this);
+	}
+	catch(LightsparkException& e)
+	{
+		LOG(LOG_ERROR, "Exception while decoding bitmap: " << e.cause);
+	}
+	uint32_t elapsed = compat_msectiming()-start;
+	if (!ok || width != w || height != h || data.empty())
+	{
+		LOG(LOG_ERROR, "Error decoding bitmap, using a transparent one");
+		width = w;
+		height = h;
+		stride = 4*w;
+		data.assign(stride*h, 0);
+	}
+	decoding = false;
+	RELEASE_WRITE(needsDecode, false);
+	decodeMutex.unlock();
+	// Registered without holding our mutex, the decoder locks them in the opposite order
+	if (decoder)
+		decoder->addDecoded(this, elapsed);
+}
+
+bool BitmapContainer::evictPixels()
+{
+	Locker l(decodeMutex);
+	if (!source || ACQUIRE_READ(needsDecode) || pins > 0)
+		return false;
+	/*
+	 * A reader pins the pixels before ensureDecoded checks needsDecode. Setting the flag before
+	 * checking the pins again means that either we see the new pin, or the reader sees the flag
+	 * and waits for us in decode(). Both sides use sequentially consistent operations for this.
+	 */
+	needsDecode.store(true);
+	if (pins.load() > 0)
+	{
+		RELEASE_WRITE(needsDecode, false);
+		return false;
+	}
+	data.clear();
+	data.shrink_to_fit();
+	return true;
+}
+
+PinnedBitmap::PinnedBitmap(_NR<BitmapContainer> b):bitmap(b)
+{
+	if (!bitmap.isNull())
+		bitmap->pinPixels();
+}
+
+PinnedBitmap::PinnedBitmap(const PinnedBitmap& r):bitmap(r.bitmap)
+{
+	if (!bitmap.isNull())
+		bitmap->pinPixels();
+}
+
+PinnedBitmap::~PinnedBitmap()
+{
+	reset();
+}
+
+PinnedBitmap& PinnedBitmap::operator=(const PinnedBitmap& r)
+{
+	return *this = r.bitmap;
+}
+
+PinnedBitmap& PinnedBitmap::operator=(_NR<BitmapContainer> b)
+{
+	// Pin first, the new bitmap may be the same as the old one
+	if (!b.isNull())
+		b->pinPixels();
+	reset();
+	bitmap = b;
+	return *this;
+}
+
+void PinnedBitmap::reset()
+{
+	if (!bitmap.isNull())
+		bitmap->unpinPixels();
+	bitmap.reset();
+}
+
+PinnedBitmap::operator _NR<BitmapContainer>() const
+{
+	return bitmap;
+}
+
 bool BitmapContainer::fromRGB(uint8_t* rgb, uint32_t w, uint32_t h, BITMAP_FORMAT format, bool frompng)
 {
 	if(!rgb)
@@ -126,6 +245,12 @@ bool BitmapContainer::fromPalette(uint8_t* inData, uint32_t w, uint32_t h, uint3
 
 void BitmapContainer::clear()
 {
+	if (decoder)
+		decoder->removeDecoded(this);
+	decoder = nullptr;
+	delete source;
+	source = nullptr;
+	RELEASE_WRITE(needsDecode, false);
 	data.clear();
 	data.shrink_to_fit();
 	stride=0;
@@ -146,6 +271,7 @@ const TextureChunk &BitmapContainer::getTexture()
 
 void BitmapContainer::uploadFence()
 {
+	unpinPixels();
 	decRef();// is increffed in checkTexture
 }
 bool BitmapContainer::checkTexture()
@@ -159,11 +285,14 @@ bool BitmapContainer::checkTexture()
 		bitmaptexture=getSys()->getRenderThread()->allocateTexture(width, height, true);
 	}
 	incRef();// is decreffed in uploadFence
+	// the render thread reads the pixels in upload
+	pinPixels();
     return true;
 }
 
 void BitmapContainer::setAlpha(int32_t x, int32_t y, uint8_t alpha)
 {
+	ensureDecoded();
 	if (x < 0 || x >= width || y < 0 || y >= height)
 		return;
 
@@ -173,6 +302,7 @@ void BitmapContainer::setAlpha(int32_t x, int32_t y, uint8_t alpha)
 
 void BitmapContainer::setPixel(int32_t x, int32_t y, uint32_t color, bool setAlpha, bool ispremultiplied)
 {
+	ensureDecoded();
 	if (x < 0 || x >= width || y < 0 || y >= height)
 		return;
 
@@ -198,6 +328,7 @@ void BitmapContainer::setPixel(int32_t x, int32_t y, uint32_t color, bool setAlp
 
 uint32_t BitmapContainer::getPixel(int32_t x, int32_t y,bool premultiplied) const
 {
+	ensureDecoded();
 	if (x < 0 || x >= width || y < 0 || y >= height)
 		return 0;
 
@@ -239,6 +370,8 @@ void BitmapContainer::copyRectangle(_R<BitmapContainer> source,
 	if (copyWidth <= 0 || copyHeight <= 0)
 		return;
 
+	ensureDecoded();
+	source->ensureDecoded();
 	int sx = clippedSourceRect.Xmin;
 	int sy = clippedSourceRect.Ymin;
 	if (mergeAlpha==false)
@@ -274,6 +407,8 @@ void BitmapContainer::copyRectangle(_R<BitmapContainer> source,
 
 void BitmapContainer::fillRectangle(const RECT& inputRect, uint32_t color, bool useAlpha)
 {
+	// the stride is only known after decoding
+	ensureDecoded();
 	RECT clippedRect;
 	clipRect(inputRect, clippedRect);
 
@@ -305,6 +440,7 @@ bool BitmapContainer::scroll(int32_t x, int32_t y)
 	if (copyWidth <= 0 && copyHeight <= 0)
 		return false;
 
+	ensureDecoded();
 	uint8_t *dataBase = &data[0];
 	for(int i=0; i<copyHeight; i++)
 	{
@@ -346,6 +482,7 @@ void BitmapContainer::floodFill(int32_t startX, int32_t startY, uint32_t color)
 		int32_t dy; // vertical direction (1 or -1)
 	};
 
+	ensureDecoded();
 	stack<LineSegment> segments;
 
 	if (startX < 0 || startX >= width || startY < 0 || startY >= height)
@@ -445,6 +582,45 @@ void BitmapContainer::floodFill(int32_t startX, int32_t startY, uint32_t color)
 	}
 }
 
+void BitmapContainer::applyFilter(_R<BitmapContainer> source,
+				  const RECT& sourceRect,
+				  int32_t destX, int32_t destY,
+				  const FilterData& filter, SystemState* sys)
+{
+	RECT filterRect;
+	source->clipRect(sourceRect, filterRect);
+	int filterWidth = filterRect.Xmax - filterRect.Xmin;
+	int filterHeight = filterRect.Ymax - filterRect.Ymin;
+
+	RECT clippedSourceRect;
+	int32_t clippedX;
+	int32_t clippedY;
+	clipRect(source, sourceRect, destX, destY, clippedSourceRect, clippedX, clippedY);
+	int copyWidth = clippedSourceRect.Xmax - clippedSourceRect.Xmin;
+	int copyHeight = clippedSourceRect.Ymax - clippedSourceRect.Ymin;
+
+	if (filterWidth <= 0 || filterHeight <= 0 || copyWidth <= 0 || copyHeight <= 0)
+		return;
+
+	ensureDecoded();
+	source->ensureDecoded();
+	// The filter is applied on a copy, source and destination may be the same bitmap
+	std::vector<uint32_t> buf(filterWidth*filterHeight);
+	for (int i=0; i<filterHeight; i++)
+	{
+		memcpy(&buf[i*filterWidth],
+		       source->getDataNoBoundsChecking(filterRect.Xmin, filterRect.Ymin+i),
+		       4*filterWidth);
+	}
+	FilterEngine::applyFilter(filter, buf.data(), filterWidth, filterWidth, filterHeight, sys);
+	for (int i=0; i<copyHeight; i++)
+	{
+		memcpy(getDataNoBoundsChecking(clippedX, clippedY+i),
+		       &buf[(clippedSourceRect.Ymin-filterRect.Ymin+i)*filterWidth + clippedSourceRect.Xmin-filterRect.Xmin],
+		       4*copyWidth);
+	}
+}
+
 void BitmapContainer::clipRect(const RECT& sourceRect, RECT& clippedRect) const
 {
 	clippedRect.Xmin = imax(sourceRect.Xmin, 0);
@@ -496,6 +672,7 @@ std::vector<uint32_t> BitmapContainer::getPixelVector(const RECT& inputRect) con
 	if ((rect.Xmax - rect.Xmin <= 0) || (rect.Ymax - rect.Ymin <= 0))
 		return result;
 
+	ensureDecoded();
 	result.reserve((rect.Xmax - rect.Xmin)*(rect.Ymax - rect.Ymin));
 	for (int32_t y=rect.Ymin; y<rect.Ymax; y++)
 	{
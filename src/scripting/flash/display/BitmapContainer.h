@@ -25,13 +25,33 @@
 #include "smartrefs.h"
 #include "swftypes.h"
 #include <vector>
+#include <list>
+#include "threading.h"
 #include "backends/graphics.h"
+#include "backends/filters.h"
 
 namespace lightspark
 {
 
+class BitmapContainer;
+class BitmapDecoder;
+
+/*
+ * The compressed data of a bitmap, owned by the BitmapContainer it is decoded into.
+ * The pixels are decoded on first use, and decoded again if they have been evicted.
+ */
+class BitmapSource
+{
+public:
+	virtual ~BitmapSource() {}
+	// Decodes the image into the empty container, may be called from any thread
+	virtual bool decode(BitmapContainer* b)=0;
+	virtual size_t getCompressedSize() const=0;
+};
+
 class BitmapContainer : public RefCountable, public ITextureUploadable
 {
+friend class BitmapDecoder;
 public:
 	enum BITMAP_FORMAT { RGB15, RGB24, RGB32, ARGB32 };
 protected:
@@ -45,15 +65,50 @@ protected:
 	// buffer to contain the 
 	std::vector<uint8_t> data_colortransformed;
 	uint32_t *getDataNoBoundsChecking(int32_t x, int32_t y) const;
+	// Lazy decoding, only used by bitmaps created from a BitmapSource
+	BitmapSource* source;
+	// Number of PinnedBitmap references and of pending texture uploads, the pixels are only evicted without them
+	ATOMIC_INT32(pins);
+	BitmapDecoder* decoder;
+	Mutex decodeMutex;
+	ACQUIRE_RELEASE_FLAG(needsDecode);
+	bool decoding;
+	// Set on every use, cleared by the decoder when looking for pixels to evict
+	mutable ACQUIRE_RELEASE_FLAG(recentlyUsed);
+	// Position in the list of decoded bitmaps of the decoder, protected by the decoder mutex
+	bool inDecodedList;
+	std::list<BitmapContainer*>::iterator decodedPos;
+	void decode();
+	// Drops the decoded pixels, they are decoded again on the next use.
+	// Returns false if the pixels are pinned
+	bool evictPixels();
 public:
 	TextureChunk bitmaptexture;
 	BitmapContainer(MemoryAccount* m);
 	~BitmapContainer();
-	uint32_t getDataSize() const { return data.size(); }
-	uint8_t* getData() { return &data[0]; }
-	const uint8_t* getData() const { return &data[0]; }
+	/*
+	 * Makes the container decode the source on first use. The size must be known in advance.
+	 * The container takes ownership of the source.
+	 */
+	void setSource(BitmapSource* s, int32_t w, int32_t h, BitmapDecoder* d);
+	// Readers of the pixels on other threads than the vm thread must pin them first
+	void pinPixels() { pins++; }
+	void unpinPixels() { pins--; }
+	// Decodes the pixels if they are not available yet
+	inline void ensureDecoded() const
+	{
+		if(ACQUIRE_READ(needsDecode))
+			const_cast<BitmapContainer*>(this)->decode();
+		if(source && !recentlyUsed.load(std::memory_order_relaxed))
+			recentlyUsed.store(true, std::memory_order_relaxed);
+	}
+	bool isDecoded() const { return !ACQUIRE_READ(needsDecode); }
+	uint32_t getDataSize() const { ensureDecoded(); return data.size(); }
+	uint8_t* getData() { ensureDecoded(); return &data[0]; }
+	const uint8_t* getData() const { ensureDecoded(); return &data[0]; }
 	uint8_t* getDataColorTransformed() 
 	{
+		ensureDecoded();
 		data_colortransformed.reserve(data.size());
 		return &data_colortransformed[0];
 	}
@@ -81,11 +136,17 @@ public:
 			   int32_t destX, int32_t destY,
 			   bool mergeAlpha);
 	void fillRectangle(const RECT& rect, uint32_t color, bool useAlpha);
+	// Apply filter to sourceRect of source and store the result at destX,destY
+	void applyFilter(_R<BitmapContainer> source,
+			 const RECT& sourceRect,
+			 int32_t destX, int32_t destY,
+			 const FilterData& filter, SystemState* sys);
 	bool scroll(int32_t x, int32_t y);
 	void floodFill(int32_t x, int32_t y, uint32_t color);
 	int getWidth() const { return width; }
+	size_t getStride() const { ensureDecoded(); return stride; }
 	int getHeight() const { return height; }
-	bool isEmpty() const { return data.empty(); }
+	bool isEmpty() const { return !ACQUIRE_READ(needsDecode) && data.empty(); }
 	void clear();
 
 	//ITextureUploadable interface
@@ -449,7 +449,7 @@ ASFUNCTIONBODY_ATOM(BitmapData,copyPixels)
 	if(!alphaBitmapData.isNull())
 		LOG(LOG_NOT_IMPLEMENTED, "BitmapData.copyPixels doesn't support alpha bitmap");
 
-	th->pixels->copyRectangle(source->pixels, sourceRect->getRect(),
+	th->pixels->copyRectangle(source->getBitmapContainer(), sourceRect->getRect(),
 				  destPoint->getX(), destPoint->getY(),
 				  mergeAlpha);
 	th->notifyUsers();
@@ -457,13 +457,28 @@ ASFUNCTIONBODY_ATOM(BitmapData,copyPixels)
 
 ASFUNCTIONBODY_ATOM(BitmapData,generateFilterRect)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"BitmapData::generateFilterRect is just a stub");
 	BitmapData* th = asAtomHandler::as<BitmapData>(obj);
+	_NR<Rectangle> sourceRect;
+	_NR<BitmapFilter> filter;
+	ARG_UNPACK_ATOM (sourceRect)(filter);
 	if(th->pixels.isNull())
 		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+	if (sourceRect.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceRect");
+	if (filter.isNull())
+		throwError<TypeError>(kNullPointerError, "filter");
+
+	int32_t left=0,top=0,right=0,bottom=0;
+	FilterData data;
+	if (filter->getFilterData(data))
+		data.getMargins(left,top,right,bottom);
+	else
+		LOG(LOG_NOT_IMPLEMENTED,"BitmapData.generateFilterRect for "<<filter->toDebugString());
 	Rectangle *rect=Class<Rectangle>::getInstanceS(sys);
-	rect->width=th->pixels->getWidth();
-	rect->height=th->pixels->getHeight();
+	rect->x=sourceRect->x-left;
+	rect->y=sourceRect->y-top;
+	rect->width=sourceRect->width+left+right;
+	rect->height=sourceRect->height+top+bottom;
 	ret = asAtomHandler::fromObject(rect);
 }
 
@@ -607,7 +622,7 @@ ASFUNCTIONBODY_ATOM(BitmapData,copyChannel)
 	RECT clippedSourceRect;
 	int32_t clippedDestX;
 	int32_t clippedDestY;
-	th->pixels->clipRect(source->pixels, sourceRect->getRect(),
+	th->pixels->clipRect(source->getBitmapContainer(), sourceRect->getRect(),
 				 destPoint->getX(), destPoint->getY(),
 				 clippedSourceRect, clippedDestX, clippedDestY);
 	int regionWidth = clippedSourceRect.Xmax - clippedSourceRect.Xmin;
@@ -875,9 +890,7 @@ ASFUNCTIONBODY_ATOM(BitmapData,setVector)
 			if (i >= inputVector->size())
 				throwError<RangeError>(kParamRangeError);
 
-			asAtom v = inputVector->at(i);
-			uint32_t pixel = asAtomHandler::toUInt(v);
-			th->pixels->setPixel(x, y, pixel, th->transparent);
+			th->pixels->setPixel(x, y, inputVector->getUIntAt(i), th->transparent);
 			i++;
 		}
 	}
@@ -992,12 +1005,34 @@ ASFUNCTIONBODY_ATOM(BitmapData,compare)
 
 ASFUNCTIONBODY_ATOM(BitmapData,applyFilter)
 {
+	BitmapData* th = asAtomHandler::as<BitmapData>(obj);
 	_NR<BitmapData> sourceBitmapData;
 	_NR<Rectangle> sourceRect;
 	_NR<Point> destPoint;
 	_NR<BitmapFilter> filter;
 	ARG_UNPACK_ATOM (sourceBitmapData)(sourceRect)(destPoint)(filter);
-	LOG(LOG_NOT_IMPLEMENTED,"BitmapData.applyFilter not implemented");
+	if(th->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+	if (sourceBitmapData.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceBitmapData");
+	if (sourceRect.isNull())
+		throwError<TypeError>(kNullPointerError, "sourceRect");
+	if (destPoint.isNull())
+		throwError<TypeError>(kNullPointerError, "destPoint");
+	if (filter.isNull())
+		throwError<TypeError>(kNullPointerError, "filter");
+	if(sourceBitmapData->pixels.isNull())
+		throw Class<ArgumentError>::getInstanceS(sys,"Disposed BitmapData", 2015);
+
+	FilterData data;
+	if (!filter->getFilterData(data))
+	{
+		LOG(LOG_NOT_IMPLEMENTED,"BitmapData.applyFilter for "<<filter->toDebugString());
+		return;
+	}
+	th->pixels->applyFilter(sourceBitmapData->getBitmapContainer(), sourceRect->getRect(),
+				destPoint->getX(), destPoint->getY(), data, sys);
+	th->notifyUsers();
 }
 
 ASFUNCTIONBODY_ATOM(BitmapData,noise)
@@ -32,8 +32,9 @@ class DisplayObject;
 
 class BitmapData: public ASObject, public IBitmapDrawable
 {
+friend class SoftwareContext3D;
 private:
-	_NR<BitmapContainer> pixels;
+	PinnedBitmap pixels;
 	int locked;
 	//Avoid cycles by not using automatic references
 	//Bitmap will take care of removing itself when needed
@@ -27,6 +27,7 @@
 #include "scripting/flash/geom/flashgeom.h"
 #include "scripting/flash/accessibility/flashaccessibility.h"
 #include "scripting/flash/display/BitmapData.h"
+#include "scripting/flash/filters/flashfilters.h"
 #include "scripting/flash/geom/flashgeom.h"
 #include <algorithm>
 
@@ -98,7 +99,8 @@ bool DisplayObject::Render(RenderContext& ctxt, bool force)
 
 DisplayObject::DisplayObject(Class_base* c):EventDispatcher(c),matrix(Class<Matrix>::getInstanceS(c->getSystemState())),tx(0),ty(0),rotation(0),
 	sx(1),sy(1),alpha(1.0),blendMode(BLENDMODE_NORMAL),isLoadedRoot(false),ClipDepth(0),maskOf(),parent(nullptr),constructed(false),useLegacyMatrix(true),
-	needsTextureRecalculation(true),textureRecalculationSkippable(false),onStage(false),
+	needsTextureRecalculation(true),textureRecalculationSkippable(false),hitBoundsVersion(1),cachedHitBoundsVersion(0),
+	cachedHitBounds(HIT_BOUNDS_UNBOUNDED),hitXMin(0),hitXMax(0),hitYMin(0),hitYMax(0),onStage(false),
 	visible(true),mask(),invalidateQueueNext(),loaderInfo(),loadedFrom(c->getSystemState()->mainClip),hasChanged(true),legacy(false),cacheAsBitmap(false),
 	name(BUILTIN_STRINGS::EMPTY)
 {
@@ -143,6 +145,7 @@ bool DisplayObject::destruct()
 	loadedFrom=getSystemState()->mainClip;
 	hasChanged = true;
 	needsTextureRecalculation=true;
+	hitBoundsVersion++;
 	tx=0;
 	ty=0;
 	rotation=0;
@@ -258,6 +261,26 @@ bool DisplayObject::computeCacheAsBitmap() const
 	return cacheAsBitmap || (!filters.isNull() && filters->size()!=0);
 }
 
+void DisplayObject::setupFilters(IDrawable* d, float scalex, float scaley) const
+{
+	if (!d || filters.isNull() || filters->size()==0)
+		return;
+	std::vector<FilterData> data;
+	for (uint32_t i = 0; i < filters->size(); i++)
+	{
+		asAtom f = filters->at(i);
+		if (!asAtomHandler::is<BitmapFilter>(f))
+			continue;
+		FilterData fd;
+		if (asAtomHandler::as<BitmapFilter>(f)->getFilterData(fd))
+			data.push_back(fd);
+		else
+			LOG(LOG_NOT_IMPLEMENTED,"rendering of filter "<<asAtomHandler::toDebugString(f));
+	}
+	if (!data.empty())
+		d->setFilters(data,scalex,scaley);
+}
+
 ASFUNCTIONBODY_ATOM(DisplayObject,_getTransform)
 {
 	DisplayObject* th=asAtomHandler::as<DisplayObject>(obj);
@@ -471,6 +494,7 @@ void DisplayObject::extractValuesFromMatrix()
 	sx=matrix->matrix.getScaleX();
 	sy=matrix->matrix.getScaleY();
 	rotation=matrix->matrix.getRotation();
+	invalidateHitBounds();
 	//Deapply translation
 	matrix->matrix.translate(-tx,-ty);
 	//Deapply rotation
@@ -730,6 +754,7 @@ void DisplayObject::setScaleX(number_t val)
 	{
 		sx=val;
 		hasChanged=true;
+		invalidateHitBounds();
 		if(onStage)
 			requestInvalidation(getSystemState());
 	}
@@ -759,6 +784,7 @@ void DisplayObject::setScaleY(number_t val)
 	{
 		sy=val;
 		hasChanged=true;
+		invalidateHitBounds();
 		if(onStage)
 			requestInvalidation(getSystemState());
 	}
@@ -821,6 +847,7 @@ void DisplayObject::setX(number_t val)
 	{
 		tx=val;
 		hasChanged=true;
+		invalidateHitBounds();
 		if(onStage)
 			requestInvalidation(getSystemState());
 	}
@@ -836,6 +863,7 @@ void DisplayObject::setY(number_t val)
 	{
 		ty=val;
 		hasChanged=true;
+		invalidateHitBounds();
 		if(onStage)
 			requestInvalidation(getSystemState());
 	}
@@ -1086,6 +1114,7 @@ ASFUNCTIONBODY_ATOM(DisplayObject,_setRotation)
 	{
 		th->rotation=val;
 		th->hasChanged=true;
+		th->invalidateHitBounds();
 		if(th->onStage)
 			th->requestInvalidation(sys);
 	}
@@ -1096,8 +1125,10 @@ void DisplayObject::setParent(DisplayObjectContainer *p)
 	Locker locker(spinlock);
 	if(parent!=p)
 	{
+		invalidateHitBounds();
 		parent=p;
 		hasChanged=true;
+		invalidateHitBounds();
 		if(onStage && !getSystemState()->isShuttingDown())
 			requestInvalidation(getSystemState());
 	}
@@ -1296,6 +1327,71 @@ _NR<DisplayObject> DisplayObject::hitTest(_NR<DisplayObject> last, number_t x, n
 	return hitTestImpl(last, x,y, type,interactiveObjectsOnly);
 }
 
+void DisplayObject::invalidateHitBounds()
+{
+	for(DisplayObject* d=this;d;d=d->parent)
+		d->hitBoundsVersion++;
+}
+
+DisplayObject::HIT_BOUNDS DisplayObject::getHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax)
+{
+	uint32_t version=hitBoundsVersion;
+	{
+		Locker locker(spinlock);
+		if(cachedHitBoundsVersion==version)
+		{
+			xmin=hitXMin;
+			xmax=hitXMax;
+			ymin=hitYMin;
+			ymax=hitYMax;
+			return cachedHitBounds;
+		}
+	}
+	//The bounds are computed without the lock, a change meanwhile increments the version again
+	xmin=xmax=ymin=ymax=0;
+	HIT_BOUNDS ret=localHitBounds(xmin,xmax,ymin,ymax);
+	if(ret==HIT_BOUNDS_RECT)
+	{
+		const MATRIX m=getMatrix();
+		number_t x[4],y[4];
+		m.multiply2D(xmin,ymin,x[0],y[0]);
+		m.multiply2D(xmax,ymin,x[1],y[1]);
+		m.multiply2D(xmax,ymax,x[2],y[2]);
+		m.multiply2D(xmin,ymax,x[3],y[3]);
+		xmin=xmax=x[0];
+		ymin=ymax=y[0];
+		for(int i=1;i<4;i++)
+		{
+			xmin=dmin(xmin,x[i]);
+			xmax=dmax(xmax,x[i]);
+			ymin=dmin(ymin,y[i]);
+			ymax=dmax(ymax,y[i]);
+		}
+	}
+	Locker locker(spinlock);
+	cachedHitBoundsVersion=version;
+	cachedHitBounds=ret;
+	hitXMin=xmin;
+	hitXMax=xmax;
+	hitYMin=ymin;
+	hitYMax=ymax;
+	return ret;
+}
+
+bool DisplayObject::mayHit(number_t x, number_t y)
+{
+	number_t xmin,xmax,ymin,ymax;
+	switch(getHitBounds(xmin,xmax,ymin,ymax))
+	{
+		case HIT_BOUNDS_EMPTY:
+			return false;
+		case HIT_BOUNDS_RECT:
+			return x>=xmin && x<=xmax && y>=ymin && y<=ymax;
+		default:
+			return true;
+	}
+}
+
 /* Display objects have no children in general,
  * so we skip to calling the constructor, if necessary.
  * This is called in vm's thread context */
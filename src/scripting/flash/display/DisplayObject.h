@@ -55,6 +55,10 @@ public:
 			MOUSE_CLICK, // point over the object and mouseEnabled
 			DOUBLE_CLICK // point over the object and doubleClickEnabled
 		      };
+	enum HIT_BOUNDS { HIT_BOUNDS_EMPTY, // no point can hit the object
+			HIT_BOUNDS_RECT, // only points inside the rectangle can hit the object
+			HIT_BOUNDS_UNBOUNDED // the hit area is not known
+		};
 private:
 	ASPROPERTY_GETTER_SETTER(_NR<AccessibilityProperties>,accessibilityProperties);
 	static ATOMIC_INT32(instanceCount);
@@ -98,6 +102,14 @@ private:
 	void gatherMaskIDrawables(std::vector<IDrawable::MaskData>& masks) const;
 	std::map<uint32_t,asAtom> avm1variables;
 	std::map<uint32_t,_NR<AVM1Function>> avm1functions;
+	/*
+	 * The hit bounds in the coordinates of the parent are cached until the version changes,
+	 * every change of the transformation or the content increments it on the whole parent chain
+	 */
+	std::atomic<uint32_t> hitBoundsVersion;
+	uint32_t cachedHitBoundsVersion;
+	HIT_BOUNDS cachedHitBounds;
+	number_t hitXMin,hitXMax,hitYMin,hitYMax;
 protected:
 	std::multimap<uint32_t,_NR<DisplayObject>> variablebindings;
 	bool onStage;
@@ -138,6 +150,14 @@ protected:
 		throw RunTimeException("DisplayObject::hitTestImpl: Derived class must implement this!");
 	}
 	virtual void afterSetLegacyMatrix() {}
+	/*
+	 * Bounds in local coordinates of the area where hitTestImpl can find a hit,
+	 * it may be larger than the hit area but never smaller
+	 */
+	virtual HIT_BOUNDS localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax)
+	{
+		return HIT_BOUNDS_UNBOUNDED;
+	}
 public:
 	void setMask(_NR<DisplayObject> m);
 	void setBlendMode(UI8 blendmode);
@@ -163,6 +183,10 @@ public:
 	 * cacheAsBitmap is true also if any filter is used
 	 */
 	bool computeCacheAsBitmap() const;
+	/**
+	 * Pass the parameters of the filters to the drawable
+	 */
+	void setupFilters(IDrawable* d, float scalex, float scaley) const;
 	void computeMasksAndMatrix(const DisplayObject *target, std::vector<IDrawable::MaskData>& masks, MATRIX& totalMatrix, bool includeRotation, bool &isMask, bool &hasMask) const;
 	ASPROPERTY_GETTER_SETTER(bool,cacheAsBitmap);
 	DisplayObjectContainer* getParent() const { return parent; }
@@ -216,6 +240,12 @@ public:
 	bool Render(RenderContext& ctxt,bool force=false);
 	bool getBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax, const MATRIX& m) const;
 	_NR<DisplayObject> hitTest(_NR<DisplayObject> last, number_t x, number_t y, HIT_TYPE type,bool interactiveObjectsOnly);
+	// bounds of the hit area in the coordinates of the parent
+	HIT_BOUNDS getHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax);
+	// returns false if the point in the coordinates of the parent can't hit the object
+	bool mayHit(number_t x, number_t y);
+	// must be called when the hit area of the object may have changed
+	void invalidateHitBounds();
 	virtual void setOnStage(bool staged, bool force = false);
 	bool isOnStage() const { return onStage; }
 	bool isMask() const { return !maskOf.isNull(); }
@@ -64,6 +64,13 @@ void Graphics::buildTraits(ASObject* o)
 {
 }
 
+Graphics::DrawLocker::~DrawLocker()
+{
+	//Runs before drawMutex is released, after the tokens have been appended
+	if(g->owner)
+		g->owner->tokensChanged();
+}
+
 //TODO: Add spinlock
 void Graphics::checkAndSetScaling()
 {
@@ -81,7 +88,7 @@ ASFUNCTIONBODY_ATOM(Graphics,_constructor)
 ASFUNCTIONBODY_ATOM(Graphics,clear)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 	th->inFilling = false;
 	th->hasChanged = false;
@@ -96,7 +103,7 @@ ASFUNCTIONBODY_ATOM(Graphics,clear)
 ASFUNCTIONBODY_ATOM(Graphics,moveTo)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 	assert_and_throw(argslen==2);
 	if (th->inFilling)
@@ -118,7 +125,7 @@ ASFUNCTIONBODY_ATOM(Graphics,moveTo)
 ASFUNCTIONBODY_ATOM(Graphics,lineTo)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	assert_and_throw(argslen==2);
 	th->checkAndSetScaling();
 
@@ -141,7 +148,7 @@ ASFUNCTIONBODY_ATOM(Graphics,lineTo)
 ASFUNCTIONBODY_ATOM(Graphics,curveTo)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	assert_and_throw(argslen==4);
 	th->checkAndSetScaling();
 
@@ -169,7 +176,7 @@ ASFUNCTIONBODY_ATOM(Graphics,curveTo)
 ASFUNCTIONBODY_ATOM(Graphics,cubicCurveTo)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	assert_and_throw(argslen==6);
 	th->checkAndSetScaling();
 
@@ -211,7 +218,7 @@ const double KAPPA = 0.55228474983079356;
 ASFUNCTIONBODY_ATOM(Graphics,drawRoundRect)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	assert_and_throw(argslen==5 || argslen==6);
 	th->checkAndSetScaling();
 
@@ -343,7 +350,7 @@ ASFUNCTIONBODY_ATOM(Graphics,drawRoundRectComplex)
 {
 	LOG(LOG_NOT_IMPLEMENTED,"Graphics.drawRoundRectComplex currently draws a normal rect");
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	assert_and_throw(argslen>=4);
 	th->checkAndSetScaling();
 
@@ -388,7 +395,7 @@ ASFUNCTIONBODY_ATOM(Graphics,drawRoundRectComplex)
 ASFUNCTIONBODY_ATOM(Graphics,drawCircle)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	assert_and_throw(argslen==3);
 	th->checkAndSetScaling();
 
@@ -463,7 +470,7 @@ ASFUNCTIONBODY_ATOM(Graphics,drawCircle)
 ASFUNCTIONBODY_ATOM(Graphics,drawEllipse)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	assert_and_throw(argslen==4);
 	th->checkAndSetScaling();
 
@@ -540,7 +547,7 @@ ASFUNCTIONBODY_ATOM(Graphics,drawEllipse)
 ASFUNCTIONBODY_ATOM(Graphics,drawRect)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	assert_and_throw(argslen==4);
 	th->checkAndSetScaling();
 
@@ -585,7 +592,7 @@ ASFUNCTIONBODY_ATOM(Graphics,drawRect)
 ASFUNCTIONBODY_ATOM(Graphics,drawPath)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 
 	_NR<Vector> commands;
@@ -612,20 +619,15 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 	if (winding != "evenOdd")
 		LOG(LOG_NOT_IMPLEMENTED, "Only event-odd winding implemented in Graphics.drawPath");
 
-	asAtom zero = asAtomHandler::fromInt(0);
-
 	int k = 0;
 	for (unsigned int i=0; i<commands->size(); i++)
 	{
-		asAtom c = commands->at(i);
-		switch (asAtomHandler::toInt(c))
+		switch (commands->getIntAt(i))
 		{
 			case GraphicsPathCommand::MOVE_TO:
 			{
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t x = data->getNumberAt(k++,0);
+				number_t y = data->getNumberAt(k++,0);
 				tokens.emplace_back(GeomToken(MOVE).uval);
 				tokens.emplace_back(GeomToken(Vector2(x, y)).uval);
 				break;
@@ -633,10 +635,8 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 
 			case GraphicsPathCommand::LINE_TO:
 			{
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t x = data->getNumberAt(k++,0);
+				number_t y = data->getNumberAt(k++,0);
 				tokens.emplace_back(GeomToken(STRAIGHT).uval);
 				tokens.emplace_back(GeomToken(Vector2(x, y)).uval);
 				break;
@@ -644,14 +644,10 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 
 			case GraphicsPathCommand::CURVE_TO:
 			{
-				asAtom acx = data->at(k++, zero);
-				asAtom acy = data->at(k++, zero);
-				number_t cx = asAtomHandler::toNumber(acx);
-				number_t cy = asAtomHandler::toNumber(acy);
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t cx = data->getNumberAt(k++,0);
+				number_t cy = data->getNumberAt(k++,0);
+				number_t x = data->getNumberAt(k++,0);
+				number_t y = data->getNumberAt(k++,0);
 				tokens.emplace_back(GeomToken(CURVE_QUADRATIC).uval);
 				tokens.emplace_back(GeomToken(Vector2(cx, cy)).uval);
 				tokens.emplace_back(GeomToken(Vector2(x, y)).uval);
@@ -661,10 +657,8 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 			case GraphicsPathCommand::WIDE_MOVE_TO:
 			{
 				k+=2;
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t x = data->getNumberAt(k++,0);
+				number_t y = data->getNumberAt(k++,0);
 				tokens.emplace_back(GeomToken(MOVE).uval);
 				tokens.emplace_back(GeomToken(Vector2(x, y)).uval);
 				break;
@@ -673,10 +667,8 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 			case GraphicsPathCommand::WIDE_LINE_TO:
 			{
 				k+=2;
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t x = data->getNumberAt(k++,0);
+				number_t y = data->getNumberAt(k++,0);
 				tokens.emplace_back(GeomToken(STRAIGHT).uval);
 				tokens.emplace_back(GeomToken(Vector2(x, y)).uval);
 				break;
@@ -684,18 +676,12 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 
 			case GraphicsPathCommand::CUBIC_CURVE_TO:
 			{
-				asAtom ac1x = data->at(k++, zero);
-				asAtom ac1y = data->at(k++, zero);
-				asAtom ac2x = data->at(k++, zero);
-				asAtom ac2y = data->at(k++, zero);
-				number_t c1x = asAtomHandler::toNumber(ac1x);
-				number_t c1y = asAtomHandler::toNumber(ac1y);
-				number_t c2x = asAtomHandler::toNumber(ac2x);
-				number_t c2y = asAtomHandler::toNumber(ac2y);
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t c1x = data->getNumberAt(k++,0);
+				number_t c1y = data->getNumberAt(k++,0);
+				number_t c2x = data->getNumberAt(k++,0);
+				number_t c2y = data->getNumberAt(k++,0);
+				number_t x = data->getNumberAt(k++,0);
+				number_t y = data->getNumberAt(k++,0);
 				tokens.emplace_back(GeomToken(CURVE_CUBIC).uval);
 				tokens.emplace_back(GeomToken(Vector2(c1x, c1y)).uval);
 				tokens.emplace_back(GeomToken(Vector2(c2x, c2y)).uval);
@@ -792,7 +778,7 @@ bool Graphics::destruct()
 ASFUNCTIONBODY_ATOM(Graphics,drawTriangles)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 
 	_NR<Vector> vertices;
@@ -875,21 +861,16 @@ void Graphics::drawTrianglesToTokens(_NR<Vector> vertices, _NR<Vector> indices,
 				vertex=3*i+j;
 			else
 			{
-				asAtom a =indices->at(3*i+j);
-				vertex=asAtomHandler::toInt(a);
+				vertex=indices->getIntAt(3*i+j);
 			}
 
-			asAtom ax = vertices->at(2*vertex);
-			x[j]=asAtomHandler::toNumber(ax);
-			asAtom ay = vertices->at(2*vertex+1);
-			y[j]=asAtomHandler::toNumber(ay);;
+			x[j]=vertices->getNumberAt(2*vertex);
+			y[j]=vertices->getNumberAt(2*vertex+1);
 
 			if (has_uvt)
 			{
-				asAtom au = uvtData->at(vertex*uvtElemSize);
-				u[j]=asAtomHandler::toNumber(au)*texturewidth;
-				asAtom av = uvtData->at(vertex*uvtElemSize+1);
-				v[j]=asAtomHandler::toNumber(av)*textureheight;
+				u[j]=uvtData->getNumberAt(vertex*uvtElemSize)*texturewidth;
+				v[j]=uvtData->getNumberAt(vertex*uvtElemSize+1)*textureheight;
 			}
 		}
 		
@@ -939,7 +920,7 @@ void Graphics::drawTrianglesToTokens(_NR<Vector> vertices, _NR<Vector> indices,
 ASFUNCTIONBODY_ATOM(Graphics,drawGraphicsData)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 
 	_NR<Vector> graphicsData;
@@ -964,7 +945,7 @@ ASFUNCTIONBODY_ATOM(Graphics,drawGraphicsData)
 ASFUNCTIONBODY_ATOM(Graphics,lineStyle)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 
 	if (argslen == 0)
@@ -1030,7 +1011,7 @@ ASFUNCTIONBODY_ATOM(Graphics,lineStyle)
 ASFUNCTIONBODY_ATOM(Graphics,lineBitmapStyle)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 
 	_NR<BitmapData> bitmap;
@@ -1053,7 +1034,7 @@ ASFUNCTIONBODY_ATOM(Graphics,lineBitmapStyle)
 ASFUNCTIONBODY_ATOM(Graphics,lineGradientStyle)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 
 	tiny_string type;
@@ -1081,7 +1062,7 @@ ASFUNCTIONBODY_ATOM(Graphics,lineGradientStyle)
 ASFUNCTIONBODY_ATOM(Graphics,beginGradientFill)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 
 	tiny_string type;
@@ -1260,7 +1241,7 @@ FILLSTYLE Graphics::createSolidFill(uint32_t color, uint8_t alpha)
 ASFUNCTIONBODY_ATOM(Graphics,beginBitmapFill)
 {
 	Graphics* th = asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	_NR<BitmapData> bitmap;
 	_NR<Matrix> matrix;
 	bool repeat, smooth;
@@ -1281,7 +1262,7 @@ ASFUNCTIONBODY_ATOM(Graphics,beginBitmapFill)
 ASFUNCTIONBODY_ATOM(Graphics,beginFill)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 	th->dorender(true);
 	uint32_t color=0;
@@ -1299,7 +1280,7 @@ ASFUNCTIONBODY_ATOM(Graphics,beginFill)
 ASFUNCTIONBODY_ATOM(Graphics,endFill)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	th->checkAndSetScaling();
 	th->dorender(true);
 
@@ -1311,7 +1292,7 @@ ASFUNCTIONBODY_ATOM(Graphics,endFill)
 ASFUNCTIONBODY_ATOM(Graphics,copyFrom)
 {
 	Graphics* th=asAtomHandler::as<Graphics>(obj);
-	Locker l(th->drawMutex);
+	DrawLocker l(th);
 	_NR<Graphics> source;
 	ARG_UNPACK_ATOM(source);
 	if (source.isNull())
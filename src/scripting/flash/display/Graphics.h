@@ -39,6 +39,17 @@ class Graphics: public ASObject
 private:
 	Mutex drawMutex;
 	TokenContainer *owner;
+	/* Holds drawMutex for a drawing function and bumps the hit bounds
+	 * version of the owner once the tokens have been modified */
+	class DrawLocker
+	{
+	private:
+		Graphics* g;
+		Locker l;
+	public:
+		DrawLocker(Graphics* _g):g(_g),l(_g->drawMutex) {}
+		~DrawLocker();
+	};
 	std::list<FILLSTYLE> fillStyles;
 	std::list<LINESTYLE2> lineStyles;
 	void checkAndSetScaling();
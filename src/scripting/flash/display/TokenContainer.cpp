@@ -28,11 +28,13 @@
 using namespace lightspark;
 using namespace std;
 
-TokenContainer::TokenContainer(DisplayObject* _o) : owner(_o), scaling(1.0f)
+TokenContainer::TokenContainer(DisplayObject* _o) : hitShapeValid(false),hitShapeFillSize(0),hitShapeStrokeSize(0),hitShapeScaling(0),
+	owner(_o), scaling(1.0f)
 {
 }
 
 TokenContainer::TokenContainer(DisplayObject* _o, const tokensVector& _tokens, float _scaling) :
+	hitShapeValid(false),hitShapeFillSize(0),hitShapeStrokeSize(0),hitShapeScaling(0),
 	owner(_o), scaling(_scaling)
 
 {
@@ -336,7 +338,7 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 		blueOffset=ct->blueOffset;
 		alphaOffset=ct->alphaOffset;
 	}
-	return new CairoTokenRenderer(tokens,totalMatrix
+	IDrawable* res = new CairoTokenRenderer(tokens,totalMatrix
 				, x*scalex, y*scaley, width*scalex, height*scaley
 				, rx*scalex,ry*scaley,rwidth*scalex,rheight*scaley,rotation
 				, xscale, yscale
@@ -346,17 +348,59 @@ IDrawable* TokenContainer::invalidate(DisplayObject* target, const MATRIX& initi
 				, redOffset,greenOffset,blueOffset,alphaOffset
 				, smoothing
 				,bxmin*scaling,bymin*scaling);
+	owner->setupFilters(res,scalex,scaley);
+	return res;
+}
+
+void TokenContainer::tokensChanged()
+{
+	//Called while the tokens are being modified, so the hit shape mutex is not taken here
+	hitShapeValid=false;
+	owner->invalidateHitBounds();
+}
+
+void TokenContainer::updateHitShape() const
+{
+	if(hitShapeValid && hitShapeFillSize==tokens.filltokens.size() &&
+			hitShapeStrokeSize==tokens.stroketokens.size() && hitShapeScaling==scaling)
+		return;
+	hitShapeValid=true;
+	hitShape.build(tokens,scaling);
+	hitShapeFillSize=tokens.filltokens.size();
+	hitShapeStrokeSize=tokens.stroketokens.size();
+	hitShapeScaling=scaling;
 }
 
 _NR<DisplayObject> TokenContainer::hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type) const
 {
 	//Masks have been already checked along the way
-
-	if(CairoTokenRenderer::hitTest(tokens, scaling, x, y))
+	//The draw job keeps the tokens from being modified by the VM meanwhile
+	owner->startDrawJob();
+	bool hit;
+	{
+		Locker l(hitShapeMutex);
+		updateHitShape();
+		hit=hitShape.contains(x,y);
+	}
+	owner->endDrawJob();
+	if(hit)
 		return last;
 	return NullRef;
 }
 
+bool TokenContainer::hitBoundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) const
+{
+	owner->startDrawJob();
+	bool ret;
+	{
+		Locker l(hitShapeMutex);
+		updateHitShape();
+		ret=hitShape.getBounds(xmin,xmax,ymin,ymax);
+	}
+	owner->endDrawJob();
+	return ret;
+}
+
 bool TokenContainer::boundsRectFromTokens(const tokensVector& tokens,float scaling, number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax)
 {
 
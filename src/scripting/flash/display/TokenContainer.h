@@ -38,6 +38,19 @@ class TokenContainer
 	friend class Graphics;
 	friend class MorphShape;
 	friend class TextField;
+private:
+	/*
+	 * The tokens flattened for hit testing, rebuilt on the first hit test after they changed.
+	 * The sizes and scaling of the tokens it was built from also catch changes that were not
+	 * reported by tokensChanged().
+	 */
+	mutable FlattenedShape hitShape;
+	mutable std::atomic<bool> hitShapeValid;
+	mutable uint32_t hitShapeFillSize;
+	mutable uint32_t hitShapeStrokeSize;
+	mutable float hitShapeScaling;
+	mutable Mutex hitShapeMutex;
+	void updateHitShape() const;
 public:
 	DisplayObject* owner;
 	/* multiply shapes' coordinates by this
@@ -59,6 +72,8 @@ public:
 	static bool boundsRectFromTokens(const tokensVector& tokens,float scaling, number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax);
 	uint16_t getCurrentLineWidth() const;
 	float scaling;
+	// must be called after the tokens or the scaling have been modified
+	void tokensChanged();
 protected:
 	TokenContainer(DisplayObject* _o);
 	TokenContainer(DisplayObject* _o, const tokensVector& _tokens, float _scaling);
@@ -69,6 +84,8 @@ protected:
 		return boundsRectFromTokens(tokens,scaling,xmin,xmax,ymin,ymax);
 	}
 	_NR<DisplayObject> hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type) const;
+	// bounds of the area that can be hit, returns false if no point can hit the tokens
+	bool hitBoundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) const;
 	bool renderImpl(RenderContext& ctxt) const;
 	bool tokensEmpty() const { return tokens.empty(); }
 };
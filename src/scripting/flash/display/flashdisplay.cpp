@@ -821,6 +821,7 @@ bool Sprite::destruct()
 	useHandCursor = false;
 	streamingsound=false;
 	tokens.clear();
+	tokensChanged();
 	return DisplayObjectContainer::destruct();
 }
 
@@ -831,6 +832,7 @@ void Sprite::finalize()
 	hitArea.reset();
 	hitTarget.reset();
 	tokens.clear();
+	tokensChanged();
 	DisplayObjectContainer::finalize();
 }
 
@@ -915,6 +917,7 @@ ASFUNCTIONBODY_ATOM(Sprite,_setter_hitArea)
 		th->incRef();
 		th->hitArea->hitTarget = _MNR(th);
 	}
+	th->invalidateHitBounds();
 }
 
 ASFUNCTIONBODY_ATOM(Sprite,getSoundTransform)
@@ -1077,11 +1080,16 @@ _NR<DisplayObject> DisplayObjectContainer::hitTestImpl(_NR<DisplayObject> last,
 		if((*j)->isMask())
 			continue;
 
-		if(!(*j)->getMatrix().isInvertible())
+		//Skip the children whose cached bounds don't contain the point
+		if(!(*j)->mayHit(x,y))
+			continue;
+
+		const MATRIX m=(*j)->getMatrix();
+		if(!m.isInvertible())
 			continue; /* The object is shrunk to zero size */
 
 		number_t localX, localY;
-		(*j)->getMatrix().getInverted().multiply2D(x,y,localX,localY);
+		m.getInverted().multiply2D(x,y,localX,localY);
 		if (!this->is<RootMovieClip>())
 		{
 			this->incRef();
@@ -1122,6 +1130,64 @@ _NR<DisplayObject> DisplayObjectContainer::hitTestImpl(_NR<DisplayObject> last,
 	return ret;
 }
 
+DisplayObject::HIT_BOUNDS DisplayObjectContainer::localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax)
+{
+	HIT_BOUNDS ret=HIT_BOUNDS_EMPTY;
+	Locker l(mutexDisplayList);
+	for(auto it=dynamicDisplayList.begin();it!=dynamicDisplayList.end();++it)
+	{
+		//Masks are included, an object may become a mask without changing the bounds of its parent
+		number_t txmin,txmax,tymin,tymax;
+		HIT_BOUNDS b=(*it)->getHitBounds(txmin,txmax,tymin,tymax);
+		if(b==HIT_BOUNDS_UNBOUNDED)
+			return HIT_BOUNDS_UNBOUNDED;
+		if(b==HIT_BOUNDS_EMPTY)
+			continue;
+		if(ret==HIT_BOUNDS_EMPTY)
+		{
+			xmin=txmin;
+			xmax=txmax;
+			ymin=tymin;
+			ymax=tymax;
+			ret=HIT_BOUNDS_RECT;
+		}
+		else
+		{
+			xmin=min(xmin,txmin);
+			xmax=max(xmax,txmax);
+			ymin=min(ymin,tymin);
+			ymax=max(ymax,tymax);
+		}
+	}
+	return ret;
+}
+
+DisplayObject::HIT_BOUNDS Sprite::localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax)
+{
+	//The hit area can be anywhere in the display list
+	if(!hitArea.isNull())
+		return HIT_BOUNDS_UNBOUNDED;
+	HIT_BOUNDS ret=DisplayObjectContainer::localHitBounds(xmin,xmax,ymin,ymax);
+	if(ret==HIT_BOUNDS_UNBOUNDED)
+		return ret;
+	number_t txmin,txmax,tymin,tymax;
+	if(!TokenContainer::hitBoundsRect(txmin,txmax,tymin,tymax))
+		return ret;
+	if(ret==HIT_BOUNDS_EMPTY)
+	{
+		xmin=txmin;
+		xmax=txmax;
+		ymin=tymin;
+		ymax=tymax;
+		return HIT_BOUNDS_RECT;
+	}
+	xmin=min(xmin,txmin);
+	xmax=max(xmax,txmax);
+	ymin=min(ymin,tymin);
+	ymax=max(ymax,tymax);
+	return HIT_BOUNDS_RECT;
+}
+
 _NR<DisplayObject> Sprite::hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type,bool interactiveObjectsOnly)
 {
 	//Did we hit a children?
@@ -1894,7 +1960,7 @@ bool MovieClip::AVM1HandleKeyboardEvent(KeyboardEvent *e)
 				(e->type == "keyUp" && it->EventFlags.ClipEventKeyDown))
 			{
 				std::map<uint32_t,asAtom> m;
-				ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions,it->startactionpos,m);
+				ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions.getPtr(),m);
 			}
 		}
 	}
@@ -1924,7 +1990,7 @@ bool MovieClip::AVM1HandleMouseEvent(EventDispatcher *dispatcher, MouseEvent *e)
 					)
 				{
 					std::map<uint32_t,asAtom> m;
-					ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions,it->startactionpos,m);
+					ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions.getPtr(),m);
 				}
 				if( dispobj &&
 					((e->type == "mouseUp" && it->EventFlags.ClipEventRelease)
@@ -1935,7 +2001,7 @@ bool MovieClip::AVM1HandleMouseEvent(EventDispatcher *dispatcher, MouseEvent *e)
 					))
 				{
 					std::map<uint32_t,asAtom> m;
-					ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions,it->startactionpos,m);
+					ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions.getPtr(),m);
 				}
 			}
 		}
@@ -1954,7 +2020,7 @@ void MovieClip::AVM1HandleEvent(EventDispatcher *dispatcher, Event* e)
 			{
 				if (e->type == "complete" && it->EventFlags.ClipEventLoad)
 				{
-					ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions,it->startactionpos,m);
+					ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions.getPtr(),m);
 				}
 				if (e->type == "enterFrame" && it->EventFlags.ClipEventEnterFrame)
 				{
@@ -1962,12 +2028,12 @@ void MovieClip::AVM1HandleEvent(EventDispatcher *dispatcher, Event* e)
 						return;
 					if (!this->state.explicit_FP)
 					{
-						ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions,it->startactionpos,m);
+						ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions.getPtr(),m);
 					}
 				}
 				if (e->type == "load" && it->EventFlags.ClipEventLoad)
 				{
-					ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions,it->startactionpos,m);
+					ACTIONRECORD::executeActions(this,this->getCurrentFrame()->getAVM1Context(),it->actions.getPtr(),m);
 				}
 			}
 		}
@@ -2217,6 +2283,7 @@ ASFUNCTIONBODY_ATOM(MovieClip,AVM1DuplicateMovieClip)
 	toAdd->setMouseEnabled(false);
 	toAdd->tokens.filltokens = th->tokens.filltokens;
 	toAdd->tokens.stroketokens = th->tokens.stroketokens;
+	toAdd->tokensChanged();
 	if (argslen > 2)
 	{
 		ASObject* initobj = asAtomHandler::toObject(args[2],sys);
@@ -2351,6 +2418,7 @@ ASFUNCTIONBODY_ATOM(MovieClip,AVM1UnloadMovie)
 	MovieClip* th=asAtomHandler::as<MovieClip>(obj);
 	th->setOnStage(false);
 	th->tokens.clear();
+	th->tokensChanged();
 }
 ASFUNCTIONBODY_ATOM(MovieClip,AVM1CreateTextField)
 {
@@ -3309,6 +3377,15 @@ bool Shape::boundsRect(number_t &xmin, number_t &xmax, number_t &ymin, number_t
 	return true;
 }
 
+DisplayObject::HIT_BOUNDS Shape::localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax)
+{
+	//hitTestImpl only tests the points inside boundsRect
+	startDrawJob();
+	bool ret=boundsRect(xmin,xmax,ymin,ymax);
+	endDrawJob();
+	return ret ? HIT_BOUNDS_RECT : HIT_BOUNDS_EMPTY;
+}
+
 _NR<DisplayObject> Shape::hitTestImpl(NullableRef<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type, bool interactiveObjectsOnly)
 {
 	number_t xmin, xmax, ymin, ymax;
@@ -3339,6 +3416,7 @@ void Shape::setupShape(DefineShapeTag* tag, float _scaling)
 	if (tag->chunk.isValid()) // Shape texture was already created, so we don't have to redo it
 		resetNeedsTextureRecalculation();
 	scaling=_scaling;
+	tokensChanged();
 }
 
 uint32_t Shape::getTagID() const 
@@ -3429,6 +3507,7 @@ void MorphShape::checkRatio(uint32_t ratio, bool inskipping)
 		return;
 	if (this->morphshapetag)
 		this->morphshapetag->getTokensForRatio(tokens,ratio);
+	tokensChanged();
 	this->hasChanged = true;
 	this->setNeedsTextureRecalculation(ratio != 0 && ratio != 65535);
 	if (isOnStage())
@@ -4254,10 +4333,14 @@ ASFUNCTIONBODY_GETTER_SETTER_CB(Bitmap,pixelSnapping,onPixelSnappingChanged);
 
 void Bitmap::updatedData()
 {
+	invalidateHitBounds();
 	if(bitmapData.isNull() || bitmapData->getBitmapContainer().isNull())
 		return;
-	cachedSurface.tex = &bitmapData->getBitmapContainer()->bitmaptexture;
-	cachedSurface.isChunkOwner=false;
+	if (filters.isNull() || filters->size()==0)
+	{
+		cachedSurface.tex = &bitmapData->getBitmapContainer()->bitmaptexture;
+		cachedSurface.isChunkOwner=false;
+	}
 	hasChanged=true;
 	if(onStage)
 		requestInvalidation(getSystemState());
@@ -4273,6 +4356,11 @@ bool Bitmap::boundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t
 	return true;
 }
 
+DisplayObject::HIT_BOUNDS Bitmap::localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax)
+{
+	return boundsRect(xmin,xmax,ymin,ymax) ? HIT_BOUNDS_RECT : HIT_BOUNDS_EMPTY;
+}
+
 _NR<DisplayObject> Bitmap::hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type,bool interactiveObjectsOnly)
 {
 	//Simple check inside the area, opacity data should not be considered
@@ -4305,8 +4393,21 @@ void Bitmap::requestInvalidation(InvalidateQueue *q, bool forceTextureRefresh)
 	if(skipRender())
 		return;
 	incRef();
-	// texture recalculation is never needed for bitmaps
-	resetNeedsTextureRecalculation();
+	if (filters.isNull() || filters->size()==0)
+	{
+		// texture recalculation is never needed for bitmaps without filters
+		if (!bitmapData.isNull() && !bitmapData->getBitmapContainer().isNull())
+		{
+			cachedSurface.tex = &bitmapData->getBitmapContainer()->bitmaptexture;
+			cachedSurface.isChunkOwner=false;
+		}
+		resetNeedsTextureRecalculation();
+	}
+	else
+	{
+		// filtered bitmaps are rendered into their own texture by an AsyncDrawJob
+		setNeedsTextureRecalculation();
+	}
 	q->addToInvalidateQueue(_MR(this));
 }
 
@@ -4380,7 +4481,7 @@ IDrawable *Bitmap::invalidate(DisplayObject *target, const MATRIX &initialMatrix
 		blueOffset=ct->blueOffset;
 		alphaOffset=ct->alphaOffset;
 	}
-	return new BitmapRenderer(this->bitmapData->getBitmapContainer()
+	IDrawable* res = new BitmapRenderer(this->bitmapData->getBitmapContainer()
 				, x*scalex, y*scaley, width*scalex, height*scaley
 				, rx*scalex,ry*scaley,rwidth*scalex,rheight*scaley,rotation
 				, xscale, yscale
@@ -4388,6 +4489,8 @@ IDrawable *Bitmap::invalidate(DisplayObject *target, const MATRIX &initialMatrix
 				, getConcatenatedAlpha(), masks
 				, redMultiplier,greenMultiplier,blueMultiplier,alphaMultiplier
 				, redOffset,greenOffset,blueOffset,alphaOffset);
+	setupFilters(res,scalex,scaley);
+	return res;
 }
 
 void SimpleButton::sinit(Class_base* c)
@@ -4494,7 +4597,7 @@ bool SimpleButton::AVM1HandleMouseEvent(EventDispatcher* dispatcher, MouseEvent
 				if (c)
 				{
 					std::map<uint32_t,asAtom> m;
-					ACTIONRECORD::executeActions(c->as<MovieClip>(),c->as<MovieClip>()->getCurrentFrame()->getAVM1Context(),it->actions,it->startactionpos,m);
+					ACTIONRECORD::executeActions(c->as<MovieClip>(),c->as<MovieClip>()->getCurrentFrame()->getAVM1Context(),it->actions.getPtr(),m);
 					handled = true;
 				}
 				
@@ -4654,7 +4757,7 @@ bool SimpleButton::AVM1HandleKeyboardEvent(KeyboardEvent *e)
 			while (c && !c->is<MovieClip>())
 				c = c->getParent();
 			std::map<uint32_t,asAtom> m;
-			ACTIONRECORD::executeActions(c->as<MovieClip>(),c->as<MovieClip>()->getCurrentFrame()->getAVM1Context(),it->actions,it->startactionpos,m);
+			ACTIONRECORD::executeActions(c->as<MovieClip>(),c->as<MovieClip>()->getCurrentFrame()->getAVM1Context(),it->actions.getPtr(),m);
 			handled=true;
 		}
 	}
@@ -5559,7 +5662,13 @@ ASFUNCTIONBODY_ATOM(Stage3D,requestContext3D)
 	ARG_UNPACK_ATOM(context3DRenderMode,"auto")(profile,"baseline");
 	
 	th->context3D = _MR(Class<Context3D>::getInstanceS(sys));
-	th->context3D->driverInfo = sys->getEngineData()->driverInfoString;
+	if (context3DRenderMode == "software" || sys->softwareContext3D)
+	{
+		th->context3D->enableSoftwareRendering();
+		th->context3D->driverInfo = context3DRenderMode == "software" ? "Software Hw_disabled=explicit" : "Software Hw_disabled=userDisabled";
+	}
+	else
+		th->context3D->driverInfo = sys->getEngineData()->driverInfoString;
 	th->incRef();
 	getVm(sys)->addEvent(_MR(th),_MR(Class<Event>::getInstanceS(sys,"context3DCreate")));
 }
@@ -117,6 +117,7 @@ protected:
 	mutable Mutex mutexDisplayList;
 	void setOnStage(bool staged, bool force = false) override;
 	_NR<DisplayObject> hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type,bool interactiveObjectsOnly) override;
+	HIT_BOUNDS localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) override;
 	bool boundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) const override;
 	bool boundsRectWithoutChildren(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) const override
 	{
@@ -210,6 +211,9 @@ private:
 	bool useHandCursor;
 	void reflectState();
 	_NR<DisplayObject> hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type,bool interactiveObjectsOnly) override;
+	//The hit state is not a child, so its bounds are not known
+	HIT_BOUNDS localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) override
+		{ return HIT_BOUNDS_UNBOUNDED; }
 	/* This is called by when an event is dispatched */
 	void defaultEventBehavior(_R<Event> e) override;
 public:
@@ -251,6 +255,7 @@ protected:
 	bool renderImpl(RenderContext& ctxt) const override
 		{ return TokenContainer::renderImpl(ctxt); }
 	_NR<DisplayObject> hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type,bool interactiveObjectsOnly) override;
+	HIT_BOUNDS localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) override;
 	
 	DefineShapeTag* fromTag;
 public:
@@ -287,6 +292,8 @@ protected:
 				this->incRef();
 			return TokenContainer::hitTestImpl(interactiveObjectsOnly ? _NR<DisplayObject>(this) : last,x,y, type); 
 		}
+	HIT_BOUNDS localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) override
+		{ return TokenContainer::hitBoundsRect(xmin,xmax,ymin,ymax) ? HIT_BOUNDS_RECT : HIT_BOUNDS_EMPTY; }
 public:
 	MorphShape(Class_base* c);
 	MorphShape(Class_base* c, DefineMorphShapeTag* _morphshapetag);
@@ -455,6 +462,7 @@ protected:
 	}
 	bool renderImpl(RenderContext& ctxt) const override;
 	_NR<DisplayObject> hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type,bool interactiveObjectsOnly) override;
+	HIT_BOUNDS localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) override;
 	void resetToStart() override;
 	void checkSound(uint32_t frame);// start sound streaming if it is not already playing
 	void stopSound();
@@ -923,6 +931,7 @@ public:
 	ASFUNCTION_ATOM(_constructor);
 	bool boundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) const override;
 	_NR<DisplayObject> hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type,bool interactiveObjectsOnly) override;
+	HIT_BOUNDS localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) override;
 	virtual IntSize getBitmapSize() const;
 	void requestInvalidation(InvalidateQueue* q, bool forceTextureRefresh=false) override;
 	IDrawable* invalidate(DisplayObject* target, const MATRIX& initialMatrix,bool smoothing) override;
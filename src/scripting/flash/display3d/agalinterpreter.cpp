@@ -0,0 +1,556 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2017 Ludger Krämer <dbluelle@onlinehome.de>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "scripting/flash/display/flashdisplay.h"
+#include "scripting/flash/display3d/agalinterpreter.h"
+#include "scripting/flash/utils/ByteArray.h"
+#include "logger.h"
+
+using namespace std;
+using namespace lightspark;
+
+// the same opcodes as handled by AGALtoGLSL
+enum AGAL_OPCODE { AGAL_MOV=0x00, AGAL_ADD=0x01, AGAL_SUB=0x02, AGAL_MUL=0x03, AGAL_DIV=0x04, AGAL_RCP=0x05, AGAL_MIN=0x06, AGAL_MAX=0x07,
+				   AGAL_FRC=0x08, AGAL_SQT=0x09, AGAL_RSQ=0x0A, AGAL_POW=0x0B, AGAL_LOG=0x0C, AGAL_EXP=0x0D, AGAL_NRM=0x0E, AGAL_SIN=0x0F,
+				   AGAL_COS=0x10, AGAL_CRS=0x11, AGAL_DP3=0x12, AGAL_DP4=0x13, AGAL_ABS=0x14, AGAL_NEG=0x15, AGAL_SAT=0x16, AGAL_M33=0x17,
+				   AGAL_M44=0x18, AGAL_M34=0x19, AGAL_KIL=0x27, AGAL_TEX=0x28, AGAL_SGE=0x29, AGAL_SLT=0x2A, AGAL_SEQ=0x2C, AGAL_SNE=0x2D };
+
+#ifdef __SSE2__
+typedef __m128 agalvec;
+static inline agalvec vload(const float* p) { return _mm_loadu_ps(p); }
+static inline void vstore(float* p, agalvec v) { _mm_storeu_ps(p,v); }
+static inline agalvec vset(float f) { return _mm_set1_ps(f); }
+static inline agalvec vadd(agalvec a, agalvec b) { return _mm_add_ps(a,b); }
+static inline agalvec vsub(agalvec a, agalvec b) { return _mm_sub_ps(a,b); }
+static inline agalvec vmul(agalvec a, agalvec b) { return _mm_mul_ps(a,b); }
+static inline agalvec vdiv(agalvec a, agalvec b) { return _mm_div_ps(a,b); }
+static inline agalvec vmin(agalvec a, agalvec b) { return _mm_min_ps(a,b); }
+static inline agalvec vmax(agalvec a, agalvec b) { return _mm_max_ps(a,b); }
+static inline agalvec vsqrt(agalvec a) { return _mm_sqrt_ps(a); }
+static inline agalvec vabs(agalvec a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f),a); }
+static inline agalvec vneg(agalvec a) { return _mm_xor_ps(_mm_set1_ps(-0.0f),a); }
+static inline agalvec vge(agalvec a, agalvec b) { return _mm_and_ps(_mm_cmpge_ps(a,b),_mm_set1_ps(1.0f)); }
+static inline agalvec vlt(agalvec a, agalvec b) { return _mm_and_ps(_mm_cmplt_ps(a,b),_mm_set1_ps(1.0f)); }
+static inline agalvec veq(agalvec a, agalvec b) { return _mm_and_ps(_mm_cmpeq_ps(a,b),_mm_set1_ps(1.0f)); }
+static inline agalvec vne(agalvec a, agalvec b) { return _mm_and_ps(_mm_cmpneq_ps(a,b),_mm_set1_ps(1.0f)); }
+static inline uint32_t vnegativelanes(agalvec a) { return _mm_movemask_ps(_mm_cmplt_ps(a,_mm_setzero_ps())); }
+#else
+struct agalvec
+{
+	float f[AGAL_LANES];
+};
+#define AGAL_LANEWISE(expr) agalvec r; for (uint32_t l = 0; l < AGAL_LANES; l++) r.f[l] = (expr); return r;
+static inline agalvec vload(const float* p) { agalvec r; memcpy(r.f,p,sizeof(r.f)); return r; }
+static inline void vstore(float* p, agalvec v) { memcpy(p,v.f,sizeof(v.f)); }
+static inline agalvec vset(float f) { AGAL_LANEWISE(f) }
+static inline agalvec vadd(agalvec a, agalvec b) { AGAL_LANEWISE(a.f[l]+b.f[l]) }
+static inline agalvec vsub(agalvec a, agalvec b) { AGAL_LANEWISE(a.f[l]-b.f[l]) }
+static inline agalvec vmul(agalvec a, agalvec b) { AGAL_LANEWISE(a.f[l]*b.f[l]) }
+static inline agalvec vdiv(agalvec a, agalvec b) { AGAL_LANEWISE(a.f[l]/b.f[l]) }
+static inline agalvec vmin(agalvec a, agalvec b) { AGAL_LANEWISE(b.f[l] < a.f[l] ? b.f[l] : a.f[l]) }
+static inline agalvec vmax(agalvec a, agalvec b) { AGAL_LANEWISE(b.f[l] > a.f[l] ? b.f[l] : a.f[l]) }
+static inline agalvec vsqrt(agalvec a) { AGAL_LANEWISE(sqrtf(a.f[l])) }
+static inline agalvec vabs(agalvec a) { AGAL_LANEWISE(fabsf(a.f[l])) }
+static inline agalvec vneg(agalvec a) { AGAL_LANEWISE(-a.f[l]) }
+static inline agalvec vge(agalvec a, agalvec b) { AGAL_LANEWISE(a.f[l] >= b.f[l] ? 1.0f : 0.0f) }
+static inline agalvec vlt(agalvec a, agalvec b) { AGAL_LANEWISE(a.f[l] < b.f[l] ? 1.0f : 0.0f) }
+static inline agalvec veq(agalvec a, agalvec b) { AGAL_LANEWISE(a.f[l] == b.f[l] ? 1.0f : 0.0f) }
+static inline agalvec vne(agalvec a, agalvec b) { AGAL_LANEWISE(a.f[l] != b.f[l] ? 1.0f : 0.0f) }
+static inline uint32_t vnegativelanes(agalvec a)
+{
+	uint32_t r = 0;
+	for (uint32_t l = 0; l < AGAL_LANES; l++)
+		if (a.f[l] < 0)
+			r |= 1<<l;
+	return r;
+}
+#undef AGAL_LANEWISE
+#endif
+
+// the operations without a SIMD instruction are done one lane at a time
+static inline agalvec vapply(agalvec a, float (*f)(float))
+{
+	float lanes[AGAL_LANES];
+	vstore(lanes,a);
+	for (uint32_t l = 0; l < AGAL_LANES; l++)
+		lanes[l] = f(lanes[l]);
+	return vload(lanes);
+}
+static inline agalvec vpow(agalvec a, agalvec b)
+{
+	float la[AGAL_LANES];
+	float lb[AGAL_LANES];
+	vstore(la,a);
+	vstore(lb,b);
+	for (uint32_t l = 0; l < AGAL_LANES; l++)
+		la[l] = powf(la[l],lb[l]);
+	return vload(la);
+}
+static float fract(float f)
+{
+	return f-floorf(f);
+}
+
+static inline AGALLanes* agalRegister(AGALRegisters& regs, RegisterType type, uint32_t n)
+{
+	switch (type)
+	{
+		case RegisterType::ATTRIBUTE:
+			return &regs.attributes[n];
+		case RegisterType::VARYING:
+			return &regs.varyings[n];
+		case RegisterType::TEMPORARY:
+			return &regs.temporaries[n];
+		default:
+			return &regs.output;
+	}
+}
+
+// component comp (already swizzled) of the source, row is added to the register number for the matrix opcodes
+static inline agalvec fetch(AGALRegisters& regs, const constantregister* constants, const AGALSource& s, uint32_t comp, uint32_t row=0)
+{
+	if (s.indirect)
+	{
+		const AGALLanes* index = agalRegister(regs,s.indextype,s.indexn);
+		float lanes[AGAL_LANES];
+		for (uint32_t l = 0; l < AGAL_LANES; l++)
+		{
+			int32_t r = int32_t(index->c[s.indexcomponent][l])+s.n+row;
+			lanes[l] = (r >= 0 && r < CONTEXT3D_PROGRAM_REGISTERS) ? constants[r].data[comp] : 0.0f;
+		}
+		return vload(lanes);
+	}
+	if (s.type == RegisterType::CONSTANT)
+		return vset(constants[s.n+row].data[comp]);
+	return vload(agalRegister(regs,s.type,s.n+row)->c[comp]);
+}
+
+static inline uint32_t wrapCoordinate(int32_t c, uint32_t size, bool repeat)
+{
+	if (repeat)
+	{
+		c %= int32_t(size);
+		return c < 0 ? c+size : c;
+	}
+	return c < 0 ? 0 : (uint32_t(c) >= size ? size-1 : c);
+}
+
+static inline void texel(const AGALTexture& tex, const uint8_t* face, uint32_t x, uint32_t y, float* rgba)
+{
+	const uint8_t* p = face+(y*tex.width+x)*tex.bytesPerPixel;
+	rgba[0] = p[0]/255.0f;
+	rgba[1] = p[1]/255.0f;
+	rgba[2] = p[2]/255.0f;
+	rgba[3] = tex.bytesPerPixel == 4 ? p[3]/255.0f : 1.0f;
+}
+
+static void sampleTexture(const AGALTexture& tex, const SamplerRegister& sampler, const agalvec* coords, agalvec* result)
+{
+	float u[AGAL_LANES];
+	float v[AGAL_LANES];
+	float w[AGAL_LANES];
+	vstore(u,coords[0]);
+	vstore(v,coords[1]);
+	vstore(w,coords[2]);
+	float out[4][AGAL_LANES];
+	const bool repeat = sampler.w == 1;
+	for (uint32_t l = 0; l < AGAL_LANES; l++)
+	{
+		const uint8_t* face = tex.faces[0];
+		float s = u[l];
+		float t = v[l];
+		if (sampler.d == 1)
+		{
+			// select the face of the cube by the major axis, in the order of the gl cube map faces
+			float ax = fabsf(u[l]), ay = fabsf(v[l]), az = fabsf(w[l]);
+			float sc, tc, ma;
+			uint32_t f;
+			if (ax >= ay && ax >= az)
+			{
+				f = u[l] >= 0 ? 0 : 1;
+				sc = u[l] >= 0 ? -w[l] : w[l];
+				tc = -v[l];
+				ma = ax;
+			}
+			else if (ay >= az)
+			{
+				f = v[l] >= 0 ? 2 : 3;
+				sc = u[l];
+				tc = v[l] >= 0 ? w[l] : -w[l];
+				ma = ay;
+			}
+			else
+			{
+				f = w[l] >= 0 ? 4 : 5;
+				sc = w[l] >= 0 ? u[l] : -u[l];
+				tc = -v[l];
+				ma = az;
+			}
+			face = tex.faces[f];
+			s = ma > 0 ? (sc/ma+1.0f)*0.5f : 0.5f;
+			t = ma > 0 ? (tc/ma+1.0f)*0.5f : 0.5f;
+		}
+		float rgba[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		if (face && tex.width && tex.height)
+		{
+			if (sampler.f == 0)
+			{
+				uint32_t x = wrapCoordinate(int32_t(floorf(s*tex.width)),tex.width,repeat);
+				uint32_t y = wrapCoordinate(int32_t(floorf(t*tex.height)),tex.height,repeat);
+				texel(tex,face,x,y,rgba);
+			}
+			else
+			{
+				float fx = s*tex.width-0.5f;
+				float fy = t*tex.height-0.5f;
+				float x0 = floorf(fx);
+				float y0 = floorf(fy);
+				float ix = fx-x0;
+				float iy = fy-y0;
+				uint32_t xa = wrapCoordinate(int32_t(x0),tex.width,repeat);
+				uint32_t xb = wrapCoordinate(int32_t(x0)+1,tex.width,repeat);
+				uint32_t ya = wrapCoordinate(int32_t(y0),tex.height,repeat);
+				uint32_t yb = wrapCoordinate(int32_t(y0)+1,tex.height,repeat);
+				float t00[4], t10[4], t01[4], t11[4];
+				texel(tex,face,xa,ya,t00);
+				texel(tex,face,xb,ya,t10);
+				texel(tex,face,xa,yb,t01);
+				texel(tex,face,xb,yb,t11);
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					float top = t00[c]+(t10[c]-t00[c])*ix;
+					float bottom = t01[c]+(t11[c]-t01[c])*ix;
+					rgba[c] = top+(bottom-top)*iy;
+				}
+			}
+		}
+		for (uint32_t c = 0; c < 4; c++)
+			out[c][l] = rgba[c];
+	}
+	for (uint32_t c = 0; c < 4; c++)
+		result[c] = vload(out[c]);
+}
+
+static bool validRegister(RegisterType type, uint32_t n, bool isVertexProgram, bool isDestination)
+{
+	switch (type)
+	{
+		case RegisterType::ATTRIBUTE:
+			return isVertexProgram && !isDestination && n < CONTEXT3D_ATTRIBUTE_COUNT;
+		case RegisterType::CONSTANT:
+			return !isDestination && n < CONTEXT3D_PROGRAM_REGISTERS;
+		case RegisterType::TEMPORARY:
+			return n < AGAL_TEMPORARY_COUNT;
+		case RegisterType::OUTPUT:
+			return n == 0;
+		case RegisterType::VARYING:
+			return n < AGAL_VARYING_COUNT && (isVertexProgram || !isDestination);
+		default:
+			return false;
+	}
+}
+
+bool AGALProgram::decodeSource(uint64_t v, AGALSource& src)
+{
+	src.indirect = ((v >> 63) & 1);
+	src.indexcomponent = ((v >> 48) & 0x3);
+	src.indextype = (RegisterType)((v >> 40) & 0xF);
+	src.type = (RegisterType)((v >> 32) & 0xF);
+	uint32_t swizzle = ((v >> 24) & 0xFF);
+	for (uint32_t i = 0; i < 4; i++)
+		src.swizzle[i] = (swizzle >> (i*2)) & 3;
+	if (src.indirect)
+	{
+		// like in AGALtoGLSL the offset is the first register of the array and the number is the index register
+		src.n = ((v >> 16) & 0xFF);
+		src.indexn = (v & 0xFFFF);
+		if (src.type != RegisterType::CONSTANT || src.indextype == RegisterType::CONSTANT
+				|| !validRegister(src.indextype,src.indexn,isVertexProgram,false))
+			return false;
+	}
+	else
+	{
+		src.n = (v & 0xFFFF);
+		src.indextype = RegisterType::TEMPORARY;
+		src.indexn = 0;
+		if (!validRegister(src.type,src.n,isVertexProgram,false))
+			return false;
+	}
+	if (src.type == RegisterType::ATTRIBUTE)
+		attributemask |= 1<<src.n;
+	if (src.type == RegisterType::VARYING)
+		varyingmask |= 1<<src.n;
+	return true;
+}
+
+bool AGALProgram::parse(ByteArray* agal, bool vertex)
+{
+	clear();
+	isVertexProgram = vertex;
+	agal->setPosition(0);
+	uint8_t by;
+	uint32_t version;
+	agal->readByte(by);
+	if (by == 0xB0)
+	{
+		LOG(LOG_NOT_IMPLEMENTED,"AGAL:embedded GLSL shaders are not supported by the software Context3D");
+		return false;
+	}
+	if (by != 0xA0 || !agal->readUnsignedInt(version) || version != 1 || !agal->readByte(by) || by != 0xA1 || !agal->readByte(by))
+	{
+		LOG(LOG_ERROR,"AGAL:invalid header");
+		return false;
+	}
+	while (agal->getPosition()+24 <= agal->getLength())
+	{
+		AGALInstruction ins;
+		uint32_t dest;
+		uint32_t low, high;
+		agal->readUnsignedInt(ins.opcode);
+		agal->readUnsignedInt(dest);
+		agal->readUnsignedInt(low);
+		agal->readUnsignedInt(high);
+		uint64_t source1 = ((uint64_t)high)<<32 | low;
+		agal->readUnsignedInt(low);
+		agal->readUnsignedInt(high);
+		uint64_t source2 = ((uint64_t)high)<<32 | low;
+
+		ins.desttype = (RegisterType)((dest >> 24) & 0xF);
+		ins.mask = (dest >> 16) & 0xF;
+		ins.destn = (dest & 0xFFFF);
+		bool valid = true;
+		switch (ins.opcode)
+		{
+			case AGAL_MOV: case AGAL_RCP: case AGAL_FRC: case AGAL_SQT: case AGAL_RSQ: case AGAL_LOG: case AGAL_EXP:
+			case AGAL_SIN: case AGAL_COS: case AGAL_ABS: case AGAL_NEG: case AGAL_SAT:
+				valid = decodeSource(source1,ins.source1);
+				break;
+			case AGAL_NRM:
+				ins.mask &= 7;
+				valid = decodeSource(source1,ins.source1);
+				break;
+			case AGAL_ADD: case AGAL_SUB: case AGAL_MUL: case AGAL_DIV: case AGAL_MIN: case AGAL_MAX: case AGAL_POW:
+			case AGAL_DP3: case AGAL_DP4: case AGAL_SGE: case AGAL_SLT: case AGAL_SEQ: case AGAL_SNE:
+				valid = decodeSource(source1,ins.source1) && decodeSource(source2,ins.source2);
+				break;
+			case AGAL_CRS:
+				ins.mask &= 7;
+				valid = decodeSource(source1,ins.source1) && decodeSource(source2,ins.source2);
+				break;
+			case AGAL_M33: case AGAL_M34: case AGAL_M44:
+				if (ins.opcode != AGAL_M44)
+					ins.mask &= 7;
+				valid = decodeSource(source1,ins.source1) && decodeSource(source2,ins.source2)
+						&& (ins.source2.indirect || validRegister(ins.source2.type,ins.source2.n+3,isVertexProgram,false));
+				break;
+			case AGAL_KIL:
+				valid = !isVertexProgram && decodeSource(source1,ins.source1);
+				haskill = true;
+				break;
+			case AGAL_TEX:
+				ins.sampler = SamplerRegister::parse(source2,isVertexProgram);
+				valid = decodeSource(source1,ins.source1) && ins.sampler.n < CONTEXT3D_SAMPLER_COUNT;
+				break;
+			default:
+				// skipped, as by AGALtoGLSL
+				LOG(LOG_ERROR,"AGAL:illegal Opcode " <<hex<<ins.opcode);
+				continue;
+		}
+		if (ins.opcode != AGAL_KIL)
+		{
+			valid = valid && validRegister(ins.desttype,ins.destn,isVertexProgram,true);
+			if (ins.desttype == RegisterType::VARYING)
+				varyingmask |= 1<<ins.destn;
+		}
+		if (!valid)
+		{
+			LOG(LOG_ERROR,"AGAL:invalid register in instruction "<<instructions.size()<<" opcode "<<hex<<ins.opcode);
+			clear();
+			return false;
+		}
+		instructions.push_back(ins);
+	}
+	return true;
+}
+
+void AGALProgram::clear()
+{
+	instructions.clear();
+	attributemask = 0;
+	varyingmask = 0;
+	haskill = false;
+}
+
+void AGALProgram::execute(AGALRegisters& regs, const constantregister* constants, const AGALTexture* textures) const
+{
+	regs.killed = 0;
+	agalvec r[4];
+	agalvec a[4];
+	agalvec b[4];
+	for (auto it = instructions.begin(); it != instructions.end(); it++)
+	{
+		const AGALInstruction& ins = *it;
+		const AGALSource& s1 = ins.source1;
+		const AGALSource& s2 = ins.source2;
+		const uint32_t mask = ins.mask;
+#define SOURCE1(c) fetch(regs,constants,s1,s1.swizzle[c])
+#define SOURCE2(c) fetch(regs,constants,s2,s2.swizzle[c])
+#define FOR_MASKED(c) for (uint32_t c = 0; c < 4; c++) if (mask & (1<<c))
+		switch (ins.opcode)
+		{
+			case AGAL_MOV:
+				FOR_MASKED(c) r[c] = SOURCE1(c);
+				break;
+			case AGAL_ADD:
+				FOR_MASKED(c) r[c] = vadd(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_SUB:
+				FOR_MASKED(c) r[c] = vsub(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_MUL:
+				FOR_MASKED(c) r[c] = vmul(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_DIV:
+				FOR_MASKED(c) r[c] = vdiv(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_RCP:
+				FOR_MASKED(c) r[c] = vdiv(vset(1.0f),SOURCE1(c));
+				break;
+			case AGAL_MIN:
+				FOR_MASKED(c) r[c] = vmin(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_MAX:
+				FOR_MASKED(c) r[c] = vmax(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_FRC:
+				FOR_MASKED(c) r[c] = vapply(SOURCE1(c),fract);
+				break;
+			case AGAL_SQT:
+				FOR_MASKED(c) r[c] = vsqrt(SOURCE1(c));
+				break;
+			case AGAL_RSQ:
+				FOR_MASKED(c) r[c] = vdiv(vset(1.0f),vsqrt(SOURCE1(c)));
+				break;
+			case AGAL_POW:
+				FOR_MASKED(c) r[c] = vpow(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_LOG:
+				FOR_MASKED(c) r[c] = vapply(SOURCE1(c),log2f);
+				break;
+			case AGAL_EXP:
+				FOR_MASKED(c) r[c] = vapply(SOURCE1(c),exp2f);
+				break;
+			case AGAL_NRM:
+			{
+				for (uint32_t c = 0; c < 3; c++)
+					a[c] = SOURCE1(c);
+				agalvec len = vsqrt(vadd(vadd(vmul(a[0],a[0]),vmul(a[1],a[1])),vmul(a[2],a[2])));
+				FOR_MASKED(c) r[c] = vdiv(a[c],len);
+				break;
+			}
+			case AGAL_SIN:
+				FOR_MASKED(c) r[c] = vapply(SOURCE1(c),sinf);
+				break;
+			case AGAL_COS:
+				FOR_MASKED(c) r[c] = vapply(SOURCE1(c),cosf);
+				break;
+			case AGAL_CRS:
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					a[c] = SOURCE1(c);
+					b[c] = SOURCE2(c);
+				}
+				r[0] = vsub(vmul(a[1],b[2]),vmul(a[2],b[1]));
+				r[1] = vsub(vmul(a[2],b[0]),vmul(a[0],b[2]));
+				r[2] = vsub(vmul(a[0],b[1]),vmul(a[1],b[0]));
+				break;
+			case AGAL_DP3:
+			case AGAL_DP4:
+			{
+				agalvec d = vmul(SOURCE1(0),SOURCE2(0));
+				for (uint32_t c = 1; c < (ins.opcode == AGAL_DP3 ? 3u : 4u); c++)
+					d = vadd(d,vmul(SOURCE1(c),SOURCE2(c)));
+				FOR_MASKED(c) r[c] = d;
+				break;
+			}
+			case AGAL_ABS:
+				FOR_MASKED(c) r[c] = vabs(SOURCE1(c));
+				break;
+			case AGAL_NEG:
+				FOR_MASKED(c) r[c] = vneg(SOURCE1(c));
+				break;
+			case AGAL_SAT:
+				FOR_MASKED(c) r[c] = vmin(vmax(SOURCE1(c),vset(0.0f)),vset(1.0f));
+				break;
+			case AGAL_M33:
+			case AGAL_M34:
+			case AGAL_M44:
+			{
+				// the rows of the matrix are the registers following source2, used without swizzle
+				const uint32_t columns = ins.opcode == AGAL_M33 ? 3 : 4;
+				for (uint32_t c = 0; c < columns; c++)
+					a[c] = SOURCE1(c);
+				FOR_MASKED(row)
+				{
+					agalvec d = vmul(a[0],fetch(regs,constants,s2,0,row));
+					for (uint32_t c = 1; c < columns; c++)
+						d = vadd(d,vmul(a[c],fetch(regs,constants,s2,c,row)));
+					r[row] = d;
+				}
+				break;
+			}
+			case AGAL_KIL:
+				// like AGALtoGLSL, the fragment is discarded if any component is negative
+				for (uint32_t c = 0; c < 4; c++)
+					regs.killed |= vnegativelanes(SOURCE1(c));
+				break;
+			case AGAL_TEX:
+				for (uint32_t c = 0; c < 3; c++)
+					a[c] = SOURCE1(c);
+				sampleTexture(textures[ins.sampler.n],ins.sampler,a,r);
+				break;
+			case AGAL_SGE:
+				FOR_MASKED(c) r[c] = vge(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_SLT:
+				FOR_MASKED(c) r[c] = vlt(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_SEQ:
+				FOR_MASKED(c) r[c] = veq(SOURCE1(c),SOURCE2(c));
+				break;
+			case AGAL_SNE:
+				FOR_MASKED(c) r[c] = vne(SOURCE1(c),SOURCE2(c));
+				break;
+		}
+		if (ins.opcode != AGAL_KIL)
+		{
+			// the results are written after all sources are read, as the destination may be a source, too
+			AGALLanes* dest = agalRegister(regs,ins.desttype,ins.destn);
+			FOR_MASKED(c) vstore(dest->c[c],r[c]);
+		}
+#undef SOURCE1
+#undef SOURCE2
+#undef FOR_MASKED
+	}
+}
@@ -0,0 +1,109 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2017 Ludger Krämer <dbluelle@onlinehome.de>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+#ifndef AGALINTERPRETER_H
+#define AGALINTERPRETER_H
+
+#include "compat.h"
+#include <cstring>
+#include <vector>
+#include "scripting/flash/display3d/flashdisplay3d.h"
+
+// number of program invocations computed by one pass over the instructions (one 2x2 pixel quad)
+#define AGAL_LANES 4
+#define AGAL_TEMPORARY_COUNT 26
+#define AGAL_VARYING_COUNT 10
+
+namespace lightspark
+{
+class ByteArray;
+
+// one AGAL register for all lanes, stored per component so that a component of all lanes is one SIMD vector
+struct AGALLanes
+{
+	float c[4][AGAL_LANES];
+};
+
+struct AGALRegisters
+{
+	AGALLanes attributes[CONTEXT3D_ATTRIBUTE_COUNT];
+	AGALLanes varyings[AGAL_VARYING_COUNT];
+	AGALLanes temporaries[AGAL_TEMPORARY_COUNT];
+	AGALLanes output;
+	// bit n is set if lane n executed a kil with a negative source
+	uint32_t killed;
+};
+
+// level 0 of a texture bound to a sampler, in the RGBA or RGB byte order used for the gl textures
+struct AGALTexture
+{
+	// one face for 2d textures, six for cube textures
+	const uint8_t* faces[6];
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytesPerPixel;
+	AGALTexture():width(0),height(0),bytesPerPixel(4) { memset(faces,0,sizeof(faces)); }
+};
+
+struct AGALSource
+{
+	RegisterType type;
+	uint32_t n;
+	uint8_t swizzle[4];
+	bool indirect;
+	RegisterType indextype;
+	uint32_t indexn;
+	uint32_t indexcomponent;
+};
+
+struct AGALInstruction
+{
+	uint32_t opcode;
+	RegisterType desttype;
+	uint32_t destn;
+	uint32_t mask;
+	AGALSource source1;
+	AGALSource source2;
+	SamplerRegister sampler;
+};
+
+/*
+ * AGAL bytecode decoded for the software Context3D.
+ * execute() runs every instruction for AGAL_LANES invocations at once, using SSE2 if available.
+ */
+class AGALProgram
+{
+private:
+	bool decodeSource(uint64_t v, AGALSource& src);
+public:
+	std::vector<AGALInstruction> instructions;
+	bool isVertexProgram;
+	// bit n is set if the attribute/varying register n is used
+	uint32_t attributemask;
+	uint32_t varyingmask;
+	bool haskill;
+	AGALProgram():isVertexProgram(false),attributemask(0),varyingmask(0),haskill(false) {}
+	// returns false and leaves the program empty if the bytecode is not valid
+	bool parse(ByteArray* agal, bool vertex);
+	void clear();
+	bool empty() const { return instructions.empty(); }
+	void execute(AGALRegisters& regs, const constantregister* constants, const AGALTexture* textures) const;
+};
+
+}
+#endif // AGALINTERPRETER_H
@@ -26,6 +26,8 @@
 #include "backends/rendering.h"
 #include "backends/rendering_context.h"
 #include "scripting/flash/display3d/agalconverter.h"
+#include "scripting/flash/display3d/agalinterpreter.h"
+#include "scripting/flash/display3d/softwarecontext3d.h"
 
 SamplerRegister SamplerRegister::parse (uint64_t v, bool isVertexProgram)
 {
@@ -345,49 +347,9 @@ void Context3D::handleRenderAction(EngineData* engineData, renderaction& action)
 			engineData->exec_glDeleteBuffers(1,&action.udata1);
 			break;
 		case RENDER_SETPROGRAMCONSTANTS_FROM_MATRIX:
-		{
-			//action.udata1 = firstRegister
-			//action.udata2 = 1, if vertex constants, 0 if fragment constants
-			//action.udata3 = 1, if transposed
-			//action.fdata = matrix (4*4)
-			for (uint32_t i = 0; i < 4 && i < CONTEXT3D_PROGRAM_REGISTERS-action.udata1; i++ )
-			{
-				float* data = action.udata2 ? vertexConstants[i+action.udata1].data : fragmentConstants[i+action.udata1].data;
-				if (action.udata3)
-				{
-					data[0] = action.fdata[i];
-					data[1] = action.fdata[i+4];
-					data[2] = action.fdata[i+8];
-					data[3] = action.fdata[i+12];
-				}
-				else
-				{
-					data[0] = action.fdata[i*4];
-					data[1] = action.fdata[i*4+1];
-					data[2] = action.fdata[i*4+2];
-					data[3] = action.fdata[i*4+3];
-				}
-			}
-			delete[] action.fdata;
-			break;
-		}
 		case RENDER_SETPROGRAMCONSTANTS_FROM_VECTOR:
-		{
-			//action.udata1 = firstRegister
-			//action.udata2 = 1, if vertex constants, 0 if fragment constants
-			//action.udata3 = numRegisters
-			//action.fdata = vector list (4*numRegisters)
-			for (uint32_t i = 0; i < action.udata3 && i < CONTEXT3D_PROGRAM_REGISTERS-action.udata1; i++ )
-			{
-				float* data = action.udata2 ? vertexConstants[i+action.udata1].data : fragmentConstants[i+action.udata1].data;
-				data[0] = action.fdata[i*4];
-				data[1] = action.fdata[i*4+1];
-				data[2] = action.fdata[i*4+2];
-				data[3] = action.fdata[i*4+3];
-			}
-			delete[] action.fdata;
+			setProgramConstants(action);
 			break;
-		}
 		case RENDER_SETTEXTUREAT:
 		{
 			//action.dataobject = TextureBase
@@ -439,17 +401,69 @@ void Context3D::handleRenderAction(EngineData* engineData, renderaction& action)
 			loadCubeTexture(action.dataobject->as<CubeTexture>());
 			break;
 		case RENDER_SETSCISSORRECTANGLE:
-			// action.fdata = x,y,width,height
-			engineData->exec_glScissor(action.fdata[0],action.fdata[1],action.fdata[2],action.fdata[3]);
-			delete[] action.fdata;
+			// action.fdata = x,y,width,height, NULL if the scissor rectangle is removed
+			if (action.fdata)
+			{
+				engineData->exec_glScissor(action.fdata[0],action.fdata[1],action.fdata[2],action.fdata[3]);
+				delete[] action.fdata;
+			}
 			break;
 		case RENDER_SETCOLORMASK:
 			// action.udata1 = red | green | blue | alpha
 			engineData->exec_glColorMask(action.udata1&0x01,action.udata1&0x02,action.udata1&0x04,action.udata1&0x08);
 			break;
+		case RENDER_SETSTENCILACTIONS:
+		case RENDER_SETSTENCILREFERENCEVALUE:
+			// only queued by the software renderer
+			break;
 	}
 }
 
+void Context3D::setProgramConstants(renderaction& action)
+{
+	if (action.action == RENDER_SETPROGRAMCONSTANTS_FROM_MATRIX)
+	{
+		//action.udata1 = firstRegister
+		//action.udata2 = 1, if vertex constants, 0 if fragment constants
+		//action.udata3 = 1, if transposed
+		//action.fdata = matrix (4*4)
+		for (uint32_t i = 0; i < 4 && i < CONTEXT3D_PROGRAM_REGISTERS-action.udata1; i++ )
+		{
+			float* data = action.udata2 ? vertexConstants[i+action.udata1].data : fragmentConstants[i+action.udata1].data;
+			if (action.udata3)
+			{
+				data[0] = action.fdata[i];
+				data[1] = action.fdata[i+4];
+				data[2] = action.fdata[i+8];
+				data[3] = action.fdata[i+12];
+			}
+			else
+			{
+				data[0] = action.fdata[i*4];
+				data[1] = action.fdata[i*4+1];
+				data[2] = action.fdata[i*4+2];
+				data[3] = action.fdata[i*4+3];
+			}
+		}
+	}
+	else
+	{
+		//action.udata1 = firstRegister
+		//action.udata2 = 1, if vertex constants, 0 if fragment constants
+		//action.udata3 = numRegisters
+		//action.fdata = vector list (4*numRegisters)
+		for (uint32_t i = 0; i < action.udata3 && i < CONTEXT3D_PROGRAM_REGISTERS-action.udata1; i++ )
+		{
+			float* data = action.udata2 ? vertexConstants[i+action.udata1].data : fragmentConstants[i+action.udata1].data;
+			data[0] = action.fdata[i*4];
+			data[1] = action.fdata[i*4+1];
+			data[2] = action.fdata[i*4+2];
+			data[3] = action.fdata[i*4+3];
+		}
+	}
+	delete[] action.fdata;
+}
+
 void Context3D::setRegisters(EngineData* engineData,std::vector<RegisterMapEntry>& registermap,constantregister* constants, bool isVertex)
 {
 	auto it = registermap.begin();
@@ -565,6 +579,8 @@ void Context3D::setPositionScale(EngineData *engineData)
 
 bool Context3D::renderImpl(RenderContext &ctxt)
 {
+	if (software)
+		return software->render(ctxt);
 	Locker l(rendermutex);
 	if (!swapbuffers || actions[1-currentactionvector].size() == 0)
 		return false;
@@ -672,7 +688,7 @@ void Context3D::loadCubeTexture(CubeTexture *tex)
 
 Context3D::Context3D(Class_base *c):EventDispatcher(c),samplers{UINT32_MAX,UINT32_MAX,UINT32_MAX,UINT32_MAX,UINT32_MAX,UINT32_MAX,UINT32_MAX,UINT32_MAX},currentactionvector(0)
   ,textureframebuffer(UINT32_MAX),textureframebufferID(UINT32_MAX),depthRenderBuffer(UINT32_MAX),stencilRenderBuffer(UINT32_MAX),currentprogram(NULL)
-  ,renderingToTexture(false),enableDepthAndStencilBackbuffer(true),enableDepthAndStencilTextureBuffer(true),swapbuffers(false),backBufferHeight(0),backBufferWidth(0),enableErrorChecking(false)
+  ,renderingToTexture(false),enableDepthAndStencilBackbuffer(true),enableDepthAndStencilTextureBuffer(true),swapbuffers(false),software(nullptr),backBufferHeight(0),backBufferWidth(0),enableErrorChecking(false)
   ,maxBackBufferHeight(16384),maxBackBufferWidth(16384)
 {
 	subtype = SUBTYPE_CONTEXT3D;
@@ -681,6 +697,23 @@ Context3D::Context3D(Class_base *c):EventDispatcher(c),samplers{UINT32_MAX,UINT3
 	driverInfo = "Disposed";
 }
 
+bool Context3D::destruct()
+{
+	if (software)
+	{
+		Locker l(rendermutex);
+		delete software;
+		software = nullptr;
+	}
+	return EventDispatcher::destruct();
+}
+
+void Context3D::enableSoftwareRendering()
+{
+	if (!software)
+		software = new SoftwareContext3D(this);
+}
+
 void Context3D::addAction(RENDER_ACTION type, ASObject *dataobject)
 {
 	renderaction action;
@@ -690,12 +723,15 @@ void Context3D::addAction(RENDER_ACTION type, ASObject *dataobject)
 		dataobject->incRef();
 		action.dataobject = _MR(dataobject);
 	}
-	actions[currentactionvector].push_back(action);
+	addAction(action);
 }
 
 void Context3D::addAction(renderaction action)
 {
-	actions[currentactionvector].push_back(action);
+	if (software)
+		software->handleRenderAction(action);
+	else
+		actions[currentactionvector].push_back(action);
 }
 
 void Context3D::sinit(lightspark::Class_base *c)
@@ -867,9 +903,15 @@ ASFUNCTIONBODY_ATOM(Context3D,clear)
 
 ASFUNCTIONBODY_ATOM(Context3D,drawToBitmapData)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"Context3D.drawToBitmapData does nothing");
+	Context3D* th = asAtomHandler::as<Context3D>(obj);
 	_NR<BitmapData> destination;
 	ARG_UNPACK_ATOM(destination);
+	if (destination.isNull())
+		throwError<TypeError>(kNullPointerError,"destination");
+	if (th->software)
+		th->software->drawToBitmapData(destination.getPtr());
+	else
+		LOG(LOG_NOT_IMPLEMENTED,"Context3D.drawToBitmapData is only implemented for renderMode software");
 }
 
 ASFUNCTIONBODY_ATOM(Context3D,drawTriangles)
@@ -879,12 +921,19 @@ ASFUNCTIONBODY_ATOM(Context3D,drawTriangles)
 	uint32_t firstIndex;
 	int32_t numTriangles;
 	ARG_UNPACK_ATOM(indexBuffer)(firstIndex,0)(numTriangles,-1);
+	if (indexBuffer.isNull())
+		throwError<TypeError>(kNullPointerError,"indexBuffer");
+	//The buffer is read when the action is rendered, so the range can't be checked there
+	uint64_t available = indexBuffer->data.size();
+	if (numTriangles < -1 || firstIndex > available
+			|| (numTriangles != -1 && uint64_t(firstIndex)+uint64_t(numTriangles)*3 > available))
+		throwError<RangeError>(kParamRangeError);
 	renderaction action;
 	action.action = RENDER_ACTION::RENDER_DRAWTRIANGLES;
 	action.dataobject = indexBuffer;
 	action.udata1 = firstIndex;
 	action.udata2 = (numTriangles == -1 ? UINT32_MAX : numTriangles);
-	th->actions[th->currentactionvector].push_back(action);
+	th->addAction(action);
 }
 
 ASFUNCTIONBODY_ATOM(Context3D,setBlendFactors)
@@ -942,7 +991,7 @@ ASFUNCTIONBODY_ATOM(Context3D,setBlendFactors)
 	action.action = RENDER_ACTION::RENDER_SETBLENDFACTORS;
 	action.udata1 = src;
 	action.udata2 = dst;
-	th->actions[th->currentactionvector].push_back(action);
+	th->addAction(action);
 }
 ASFUNCTIONBODY_ATOM(Context3D,setColorMask)
 {
@@ -959,7 +1008,7 @@ ASFUNCTIONBODY_ATOM(Context3D,setColorMask)
 	if (green) action.udata1 |= 0x02;
 	if (blue) action.udata1 |= 0x04;
 	if (alpha) action.udata1 |= 0x08;
-	th->actions[th->currentactionvector].push_back(action);
+	th->addAction(action);
 }
 ASFUNCTIONBODY_ATOM(Context3D,setCulling)
 {
@@ -1068,10 +1117,7 @@ ASFUNCTIONBODY_ATOM(Context3D,setProgramConstantsFromVector)
 		action.udata3= numRegisters < 0 ? data->size()/4 : min ((uint32_t)numRegisters,data->size()/4);
 		action.fdata= new float[action.udata3*4];
 		for (uint32_t i = 0; i < action.udata3*4; i++)
-		{
-			asAtom a = data->at(i);
-			action.fdata[i] = asAtomHandler::toNumber(a);
-		}
+			action.fdata[i] = data->getNumberAt(i);
 		th->addAction(action);
 	}
 }
@@ -1093,6 +1139,13 @@ ASFUNCTIONBODY_ATOM(Context3D,setScissorRectangle)
 		action.fdata[3] = rectangle->height;
 		th->addAction(action);
 	}
+	else if (th->software)
+	{
+		// removes the scissor rectangle
+		renderaction action;
+		action.action = RENDER_ACTION::RENDER_SETSCISSORRECTANGLE;
+		th->addAction(action);
+	}
 }
 ASFUNCTIONBODY_ATOM(Context3D,setRenderToBackBuffer)
 {
@@ -1136,6 +1189,11 @@ ASFUNCTIONBODY_ATOM(Context3D,setSamplerStateAt)
 ASFUNCTIONBODY_ATOM(Context3D,present)
 {
 	Context3D* th = asAtomHandler::as<Context3D>(obj);
+	if (th->software)
+	{
+		th->software->present();
+		return;
+	}
 	Locker l(th->rendermutex);
 	if (th->swapbuffers)
 	{
@@ -1148,23 +1206,97 @@ ASFUNCTIONBODY_ATOM(Context3D,present)
 		th->currentactionvector=1-th->currentactionvector;
 	}
 }
+static uint32_t stencilActionFromString(const tiny_string& s)
+{
+	if (s == "keep")
+		return STENCIL_KEEP;
+	else if (s == "zero")
+		return STENCIL_ZERO;
+	else if (s == "set")
+		return STENCIL_SET;
+	else if (s == "incrementSaturate")
+		return STENCIL_INCREMENT_SATURATE;
+	else if (s == "decrementSaturate")
+		return STENCIL_DECREMENT_SATURATE;
+	else if (s == "incrementWrap")
+		return STENCIL_INCREMENT_WRAP;
+	else if (s == "decrementWrap")
+		return STENCIL_DECREMENT_WRAP;
+	else if (s == "invert")
+		return STENCIL_INVERT;
+	throwError<ArgumentError>(kInvalidArgumentError,s);
+	return STENCIL_KEEP;
+}
 ASFUNCTIONBODY_ATOM(Context3D,setStencilActions)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"Context3D.setStencilActions does nothing");
+	Context3D* th = asAtomHandler::as<Context3D>(obj);
 	tiny_string triangleFace;
 	tiny_string compareMode;
 	tiny_string actionOnBothPass;
 	tiny_string actionOnDepthFail;
 	tiny_string actionOnDepthPassStencilFail;
 	ARG_UNPACK_ATOM(triangleFace,"frontAndBack")(compareMode,"always")(actionOnBothPass,"keep")(actionOnDepthFail,"keep")(actionOnDepthPassStencilFail,"keep");
+	if (!th->software)
+	{
+		LOG(LOG_NOT_IMPLEMENTED,"Context3D.setStencilActions does nothing");
+		return;
+	}
+	renderaction action;
+	action.action = RENDER_ACTION::RENDER_SETSTENCILACTIONS;
+	//action.udata1 = triangleFace
+	//action.udata2 = compareMode
+	//action.udata3 = actionOnBothPass | actionOnDepthFail<<8 | actionOnDepthPassStencilFail<<16
+	if (triangleFace == "none")
+		action.udata1 = FACE_NONE;
+	else if (triangleFace == "front")
+		action.udata1 = FACE_FRONT;
+	else if (triangleFace == "back")
+		action.udata1 = FACE_BACK;
+	else if (triangleFace == "frontAndBack")
+		action.udata1 = FACE_FRONT_AND_BACK;
+	else
+		throwError<ArgumentError>(kInvalidArgumentError,"triangleFace");
+	if (compareMode =="always")
+		action.udata2 = DEPTH_FUNCTION::ALWAYS;
+	else if (compareMode =="equal")
+		action.udata2 = DEPTH_FUNCTION::EQUAL;
+	else if (compareMode =="greater")
+		action.udata2 = DEPTH_FUNCTION::GREATER;
+	else if (compareMode =="greaterEqual")
+		action.udata2 = DEPTH_FUNCTION::GREATER_EQUAL;
+	else if (compareMode =="less")
+		action.udata2 = DEPTH_FUNCTION::LESS;
+	else if (compareMode =="lessEqual")
+		action.udata2 = DEPTH_FUNCTION::LESS_EQUAL;
+	else if (compareMode =="never")
+		action.udata2 = DEPTH_FUNCTION::NEVER;
+	else if (compareMode =="notEqual")
+		action.udata2 = DEPTH_FUNCTION::NOT_EQUAL;
+	else
+		throwError<ArgumentError>(kInvalidArgumentError,"compareMode");
+	action.udata3 = stencilActionFromString(actionOnBothPass)
+			| (stencilActionFromString(actionOnDepthFail)<<8)
+			| (stencilActionFromString(actionOnDepthPassStencilFail)<<16);
+	th->addAction(action);
 }
 ASFUNCTIONBODY_ATOM(Context3D,setStencilReferenceValue)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"Context3D.setStencilReferenceValue does nothing");
+	Context3D* th = asAtomHandler::as<Context3D>(obj);
 	uint32_t referenceValue;
 	uint32_t readMask;
 	uint32_t writeMask;
 	ARG_UNPACK_ATOM(referenceValue)(readMask,255)(writeMask,255);
+	if (!th->software)
+	{
+		LOG(LOG_NOT_IMPLEMENTED,"Context3D.setStencilReferenceValue does nothing");
+		return;
+	}
+	renderaction action;
+	action.action = RENDER_ACTION::RENDER_SETSTENCILREFERENCEVALUE;
+	action.udata1 = referenceValue;
+	action.udata2 = readMask;
+	action.udata3 = writeMask;
+	th->addAction(action);
 }
 
 ASFUNCTIONBODY_ATOM(Context3D,setTextureAt)
@@ -1181,7 +1313,7 @@ ASFUNCTIONBODY_ATOM(Context3D,setTextureAt)
 	action.action = RENDER_ACTION::RENDER_SETTEXTUREAT;
 	action.dataobject = texture;
 	action.udata1 = sampler;
-	th->actions[th->currentactionvector].push_back(action);
+	th->addAction(action);
 }
 
 ASFUNCTIONBODY_ATOM(Context3D,setVertexBufferAt)
@@ -1209,7 +1341,7 @@ ASFUNCTIONBODY_ATOM(Context3D,setVertexBufferAt)
 		action.udata3 = VERTEXBUFFER_FORMAT::FLOAT_3;
 	else if (format == "float4")
 		action.udata3 = VERTEXBUFFER_FORMAT::FLOAT_4;
-	th->actions[th->currentactionvector].push_back(action);
+	th->addAction(action);
 }
 
 
@@ -1423,10 +1555,7 @@ ASFUNCTIONBODY_ATOM(IndexBuffer3D,uploadFromVector)
 	if (th->data.size() < count+startOffset)
 		th->data.resize(count+startOffset);
 	for (uint32_t i = 0; i< count; i++)
-	{
-		asAtom a = data->at(i);
-		th->data[startOffset+i] = asAtomHandler::toUInt(a);
-	}
+		th->data[startOffset+i] = data->getUIntAt(i);
 }
 
 void Program3D::sinit(Class_base *c)
@@ -1436,6 +1565,12 @@ void Program3D::sinit(Class_base *c)
 	c->setDeclaredMethodByQName("upload","",Class<IFunction>::getFunction(c->getSystemState(),upload),NORMAL_METHOD,true);
 }
 
+Program3D::~Program3D()
+{
+	delete softwarevertexprogram;
+	delete softwarefragmentprogram;
+}
+
 ASFUNCTIONBODY_ATOM(Program3D,dispose)
 {
 	Program3D* th = asAtomHandler::as<Program3D>(obj);
@@ -1447,6 +1582,21 @@ ASFUNCTIONBODY_ATOM(Program3D,upload)
 	_NR<ByteArray> vertexProgram;
 	_NR<ByteArray> fragmentProgram;
 	ARG_UNPACK_ATOM(vertexProgram)(fragmentProgram);
+	if (!th->context3D.isNull() && th->context3D->isSoftware())
+	{
+		// the software renderer interprets the bytecode directly
+		if (!th->softwarevertexprogram)
+			th->softwarevertexprogram = new AGALProgram();
+		if (!th->softwarefragmentprogram)
+			th->softwarefragmentprogram = new AGALProgram();
+		th->softwarevertexprogram->clear();
+		th->softwarefragmentprogram->clear();
+		if (!vertexProgram.isNull() && !th->softwarevertexprogram->parse(vertexProgram.getPtr(),true))
+			LOG(LOG_ERROR,"Program3D.upload: invalid vertex program");
+		if (!fragmentProgram.isNull() && !th->softwarefragmentprogram->parse(fragmentProgram.getPtr(),false))
+			LOG(LOG_ERROR,"Program3D.upload: invalid fragment program");
+		return;
+	}
 	th->samplerState.clear();
 	if (!vertexProgram.isNull())
 		th->vertexprogram = AGALtoGLSL(vertexProgram.getPtr(),true,th->samplerState,th->vertexregistermap,th->vertexattributes);
@@ -1530,10 +1680,7 @@ ASFUNCTIONBODY_ATOM(VertexBuffer3D,uploadFromVector)
 	if (th->data.size() < (numVertices+startVertex)* th->data32PerVertex)
 		th->data.resize((numVertices+startVertex)* th->data32PerVertex);
 	for (uint32_t i = 0; i< numVertices* th->data32PerVertex; i++)
-	{
-		asAtom a = data->at(i);
-		th->data[startVertex*th->data32PerVertex+i] = asAtomHandler::toNumber(a);
-	}
+		th->data[startVertex*th->data32PerVertex+i] = data->getNumberAt(i);
 }
 
 }
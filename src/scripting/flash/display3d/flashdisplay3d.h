@@ -78,12 +78,14 @@ namespace lightspark
 class RenderContext;
 class VertexBuffer3D;
 class Program3D;
+class SoftwareContext3D;
+class AGALProgram;
 
 enum RENDER_ACTION { RENDER_CLEAR,RENDER_CONFIGUREBACKBUFFER,RENDER_SETPROGRAM,RENDER_RENDERTOBACKBUFFER,RENDER_TOTEXTURE,RENDER_DELETEPROGRAM,
 					 RENDER_SETVERTEXBUFFER,RENDER_DRAWTRIANGLES,RENDER_DELETEBUFFER,
 					 RENDER_SETPROGRAMCONSTANTS_FROM_MATRIX,RENDER_SETPROGRAMCONSTANTS_FROM_VECTOR,RENDER_SETTEXTUREAT,
 					 RENDER_SETBLENDFACTORS,RENDER_SETDEPTHTEST,RENDER_SETCULLING,RENDER_LOADTEXTURE,RENDER_LOADCUBETEXTURE,
-					 RENDER_SETSCISSORRECTANGLE, RENDER_SETCOLORMASK };
+					 RENDER_SETSCISSORRECTANGLE, RENDER_SETCOLORMASK, RENDER_SETSTENCILACTIONS, RENDER_SETSTENCILREFERENCEVALUE };
 struct renderaction
 {
 	RENDER_ACTION action;
@@ -113,6 +115,7 @@ struct attribregister
 class Context3D: public EventDispatcher
 {
 friend class Stage3D;
+friend class SoftwareContext3D;
 private:
 	std::vector<renderaction> actions[2];
 	constantregister vertexConstants[CONTEXT3D_PROGRAM_REGISTERS];
@@ -130,7 +133,10 @@ private:
 	bool enableDepthAndStencilBackbuffer;
 	bool enableDepthAndStencilTextureBuffer;
 	bool swapbuffers;
+	// only set for renderMode "software", the actions are then executed when they are added
+	SoftwareContext3D* software;
 	void handleRenderAction(EngineData *engineData, renderaction &action);
+	void setProgramConstants(renderaction &action);
 	void setRegisters(EngineData *engineData, std::vector<RegisterMapEntry> &registermap, constantregister *constants, bool isVertex);
 	void setAttribs(EngineData* engineData, std::vector<RegisterMapEntry> &attributes);
 	void setSamplers(EngineData* engineData);
@@ -142,7 +148,10 @@ protected:
 public:
 	Mutex rendermutex;
 	Context3D(Class_base* c);
+	bool destruct() override;
 	static void sinit(Class_base* c);
+	void enableSoftwareRendering();
+	bool isSoftware() const { return software != nullptr; }
 
 	void addAction(RENDER_ACTION type, ASObject* dataobject);
 	void addAction(renderaction action);
@@ -286,6 +295,7 @@ public:
 class IndexBuffer3D: public ASObject
 {
 friend class Context3D;
+friend class SoftwareContext3D;
 protected:
 	Context3D* context;
 	uint32_t bufferID;
@@ -304,9 +314,12 @@ public:
 class Program3D: public ASObject
 {
 friend class Context3D;
+friend class SoftwareContext3D;
 private:
 	_NR<Context3D> context3D;
 	uint32_t gpu_program;
+	AGALProgram* softwarevertexprogram;
+	AGALProgram* softwarefragmentprogram;
 protected:
 	uint32_t vcPositionScale;
 	tiny_string vertexprogram;
@@ -317,8 +330,9 @@ protected:
 	std::vector<RegisterMapEntry> fragmentregistermap;
 	std::vector<RegisterMapEntry> fragmentattributes;
 public:
-	Program3D(Class_base* c):ASObject(c,T_OBJECT,SUBTYPE_PROGRAM3D),gpu_program(UINT32_MAX),vcPositionScale(UINT32_MAX){}
-	Program3D(Class_base* c,_NR<Context3D> _ct):ASObject(c,T_OBJECT,SUBTYPE_PROGRAM3D),context3D(_ct),gpu_program(UINT32_MAX),vcPositionScale(UINT32_MAX){}
+	Program3D(Class_base* c):ASObject(c,T_OBJECT,SUBTYPE_PROGRAM3D),gpu_program(UINT32_MAX),softwarevertexprogram(nullptr),softwarefragmentprogram(nullptr),vcPositionScale(UINT32_MAX){}
+	Program3D(Class_base* c,_NR<Context3D> _ct):ASObject(c,T_OBJECT,SUBTYPE_PROGRAM3D),context3D(_ct),gpu_program(UINT32_MAX),softwarevertexprogram(nullptr),softwarefragmentprogram(nullptr),vcPositionScale(UINT32_MAX){}
+	~Program3D();
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(dispose);
 	ASFUNCTION_ATOM(upload);
@@ -326,6 +340,7 @@ public:
 class VertexBuffer3D: public ASObject
 {
 friend class Context3D;
+friend class SoftwareContext3D;
 protected:
 	Context3D* context;
 	uint32_t bufferID;
@@ -0,0 +1,911 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2017 Ludger Krämer <dbluelle@onlinehome.de>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include "scripting/flash/display3d/softwarecontext3d.h"
+#include "scripting/flash/display/BitmapData.h"
+#include "backends/rendering.h"
+#include "backends/rendering_context.h"
+#include "swf.h"
+#include "threading.h"
+#include "logger.h"
+#include "tracing.h"
+
+using namespace std;
+using namespace lightspark;
+
+// vertices with a smaller w are clipped, so the projected coordinates stay finite
+#define SOFTWARE3D_NEAR_W 1e-5f
+// a draw call covering less pixels than this is rasterized on the calling thread only
+#define SOFTWARE3D_PARALLEL_PIXELS (4*SOFTWARE3D_TILE_SIZE*SOFTWARE3D_TILE_SIZE)
+
+namespace lightspark
+{
+/*
+ * Takes items of a draw call until there are none left. The draw call only waits for the jobs
+ * that started before it took the last item, the others are cancelled and do nothing when they
+ * are executed later, so they may only access the state of the draw call once they are started.
+ */
+class SoftwareRenderJob: public IThreadJob
+{
+public:
+	enum STATE { PENDING, STARTED, CANCELLED };
+private:
+	const std::function<void(uint32_t)>& func;
+	std::atomic<uint32_t>& next;
+	uint32_t count;
+	Semaphore& done;
+	// shared with the draw call, as the job may outlive it
+	std::shared_ptr<std::atomic<int>> state;
+public:
+	SoftwareRenderJob(const std::function<void(uint32_t)>& f, std::atomic<uint32_t>& n, uint32_t c, Semaphore& d, const std::shared_ptr<std::atomic<int>>& st)
+		:func(f),next(n),count(c),done(d),state(st) {}
+	void execute() override
+	{
+		int expected = PENDING;
+		if (!state->compare_exchange_strong(expected,STARTED))
+			return;
+		uint32_t i;
+		while ((i = next.fetch_add(1)) < count)
+			func(i);
+		done.signal();
+	}
+	void jobFence() override
+	{
+		delete this;
+	}
+	JOB_PRIORITY getPriority() const override { return JOB_PRIORITY_RENDER; }
+};
+}
+
+static inline float clampUnit(float f)
+{
+	// also maps NaN to 0
+	return f > 0.0f ? (f < 1.0f ? f : 1.0f) : 0.0f;
+}
+// packs clamped RGBA floats into ARGB
+static inline uint32_t packColor(const float* rgba)
+{
+	return (uint32_t(clampUnit(rgba[3])*255.0f+0.5f)<<24)
+			| (uint32_t(clampUnit(rgba[0])*255.0f+0.5f)<<16)
+			| (uint32_t(clampUnit(rgba[1])*255.0f+0.5f)<<8)
+			| uint32_t(clampUnit(rgba[2])*255.0f+0.5f);
+}
+// the ARGB bits written for a color mask of red=1, green=2, blue=4, alpha=8
+static inline uint32_t channelMask(uint32_t colormask)
+{
+	return ((colormask & 0x01) ? 0x00ff0000 : 0)
+			| ((colormask & 0x02) ? 0x0000ff00 : 0)
+			| ((colormask & 0x04) ? 0x000000ff : 0)
+			| ((colormask & 0x08) ? 0xff000000 : 0);
+}
+template<class T>
+static inline bool compareValues(DEPTH_FUNCTION f, T a, T b)
+{
+	switch (f)
+	{
+		case ALWAYS: return true;
+		case EQUAL: return a == b;
+		case GREATER: return a > b;
+		case GREATER_EQUAL: return a >= b;
+		case LESS: return a < b;
+		case LESS_EQUAL: return a <= b;
+		case NEVER: return false;
+		case NOT_EQUAL: return a != b;
+	}
+	return true;
+}
+static inline uint8_t stencilAction(STENCIL_ACTION a, uint8_t value, uint8_t reference)
+{
+	switch (a)
+	{
+		case STENCIL_KEEP: return value;
+		case STENCIL_ZERO: return 0;
+		case STENCIL_SET: return reference;
+		case STENCIL_INCREMENT_SATURATE: return value < 0xff ? value+1 : 0xff;
+		case STENCIL_DECREMENT_SATURATE: return value > 0 ? value-1 : 0;
+		case STENCIL_INCREMENT_WRAP: return value+1;
+		case STENCIL_DECREMENT_WRAP: return value-1;
+		case STENCIL_INVERT: return ~value;
+	}
+	return value;
+}
+static inline float blendFactor(BLEND_FACTOR f, uint32_t c, const float* s, const float* d)
+{
+	switch (f)
+	{
+		case BLEND_ONE: return 1.0f;
+		case BLEND_ZERO: return 0.0f;
+		case BLEND_SRC_ALPHA: return s[3];
+		case BLEND_SRC_COLOR: return s[c];
+		case BLEND_DST_ALPHA: return d[3];
+		case BLEND_DST_COLOR: return d[c];
+		case BLEND_ONE_MINUS_SRC_ALPHA: return 1.0f-s[3];
+		case BLEND_ONE_MINUS_SRC_COLOR: return 1.0f-s[c];
+		case BLEND_ONE_MINUS_DST_ALPHA: return 1.0f-d[3];
+		case BLEND_ONE_MINUS_DST_COLOR: return 1.0f-d[c];
+	}
+	return 1.0f;
+}
+
+void SoftwareContext3D::Surface::resize(uint32_t w, uint32_t h)
+{
+	width = w;
+	height = h;
+	color.assign(w*h,0);
+	depth.assign(w*h,1.0f);
+	stencil.assign(w*h,0);
+}
+
+SoftwareContext3D::SoftwareContext3D(Context3D* ctx):sys(ctx->getSystemState()),context(ctx),target(&backbuffer)
+  ,blendSource(BLEND_ONE),blendDestination(BLEND_ZERO),depthMask(true),depthFunction(LESS),culling(FACE_NONE),colorMask(0x0f),scissor(false)
+  ,stencilReference(0),stencilReadMask(0xff),stencilWriteMask(0xff),varyingCount(0),frontWidth(0),frontHeight(0),newFrame(false)
+{
+	for (uint32_t i = 0; i < CONTEXT3D_ATTRIBUTE_COUNT; i++)
+	{
+		attributes[i].offset = 0;
+		attributes[i].format = FLOAT_4;
+	}
+	memset(scissorRect,0,sizeof(scissorRect));
+}
+
+SoftwareContext3D::~SoftwareContext3D()
+{
+	if (texture.isValid() && sys->getRenderThread())
+		sys->getRenderThread()->releaseTexture(texture);
+}
+
+void SoftwareContext3D::runParallel(uint32_t count, bool parallel, const std::function<void(uint32_t)>& f)
+{
+	uint32_t jobcount = parallel && count > 1 ? min(count,(uint32_t)SOFTWARE3D_MAX_JOBS)-1 : 0;
+	if (jobcount == 0)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			f(i);
+		return;
+	}
+	std::atomic<uint32_t> next(0);
+	Semaphore done(0);
+	std::vector<std::shared_ptr<std::atomic<int>>> states;
+	for (uint32_t i = 0; i < jobcount; i++)
+	{
+		states.push_back(make_shared<std::atomic<int>>(int(SoftwareRenderJob::PENDING)));
+		sys->addJob(new SoftwareRenderJob(f,next,count,done,states.back()));
+	}
+	// the calling thread takes items as well and only waits for the jobs that are running,
+	// so the draw call never waits for a thread pool that is busy with other jobs
+	uint32_t i;
+	while ((i = next.fetch_add(1)) < count)
+		f(i);
+	for (auto it = states.begin(); it != states.end(); it++)
+	{
+		int expected = SoftwareRenderJob::PENDING;
+		if (!(*it)->compare_exchange_strong(expected,SoftwareRenderJob::CANCELLED))
+			done.wait();
+	}
+}
+
+void SoftwareContext3D::setTarget(Surface* s)
+{
+	finishTextureTarget();
+	target = s;
+}
+
+void SoftwareContext3D::finishTextureTarget()
+{
+	if (target != &texturebuffer)
+		return;
+	target = &backbuffer;
+	if (targettexture.isNull())
+		return;
+	TextureBase* tex = targettexture->as<TextureBase>();
+	if (tex->bitmaparray.empty())
+		tex->bitmaparray.resize(1);
+	vector<uint8_t>& bytes = tex->bitmaparray[0];
+	bytes.resize(texturebuffer.width*texturebuffer.height*4);
+	for (uint32_t i = 0; i < texturebuffer.width*texturebuffer.height; i++)
+	{
+		uint32_t c = texturebuffer.color[i];
+		bytes[i*4] = (c>>16)&0xff;
+		bytes[i*4+1] = (c>>8)&0xff;
+		bytes[i*4+2] = c&0xff;
+		bytes[i*4+3] = c>>24;
+	}
+	tex->hasalpha = true;
+	tex->needrefresh = true;
+	targettexture.reset();
+}
+
+void SoftwareContext3D::clear(const renderaction& action)
+{
+	Surface* s = target;
+	int32_t x0 = 0, y0 = 0, x1 = s->width, y1 = s->height;
+	if (scissor)
+	{
+		x0 = max(x0,scissorRect[0]);
+		y0 = max(y0,scissorRect[1]);
+		x1 = min(x1,scissorRect[0]+scissorRect[2]);
+		y1 = min(y1,scissorRect[1]+scissorRect[3]);
+	}
+	if (x0 >= x1 || y0 >= y1)
+		return;
+	if (action.udata2 & CLEARMASK::COLOR)
+	{
+		uint32_t color = packColor(action.fdata);
+		uint32_t written = channelMask(colorMask);
+		for (int32_t y = y0; y < y1; y++)
+		{
+			uint32_t* p = &s->color[y*s->width];
+			for (int32_t x = x0; x < x1; x++)
+				p[x] = (p[x] & ~written) | (color & written);
+		}
+	}
+	if (!s->depthAndStencil)
+		return;
+	bool cleardepth = (action.udata2 & CLEARMASK::DEPTH) && depthMask;
+	bool clearstencil = (action.udata2 & CLEARMASK::STENCIL) && (stencilWriteMask & 0xff);
+	float depth = clampUnit(action.fdata[4]);
+	for (int32_t y = y0; y < y1; y++)
+	{
+		for (int32_t x = x0; x < x1; x++)
+		{
+			uint32_t index = y*s->width+x;
+			if (cleardepth)
+				s->depth[index] = depth;
+			if (clearstencil)
+				s->stencil[index] = (s->stencil[index] & ~stencilWriteMask) | (action.udata1 & stencilWriteMask);
+		}
+	}
+}
+
+void SoftwareContext3D::handleRenderAction(renderaction& action)
+{
+	switch (action.action)
+	{
+		case RENDER_CLEAR:
+			clear(action);
+			delete[] action.fdata;
+			break;
+		case RENDER_CONFIGUREBACKBUFFER:
+			backbuffer.resize(max(context->backBufferWidth,0),max(context->backBufferHeight,0));
+			backbuffer.depthAndStencil = action.udata1;
+			break;
+		case RENDER_SETPROGRAM:
+			program = action.dataobject;
+			break;
+		case RENDER_RENDERTOBACKBUFFER:
+			setTarget(&backbuffer);
+			break;
+		case RENDER_TOTEXTURE:
+		{
+			setTarget(&texturebuffer);
+			TextureBase* tex = action.dataobject->as<TextureBase>();
+			texturebuffer.resize(tex->width,tex->height);
+			texturebuffer.depthAndStencil = action.udata1;
+			// the texture keeps its content where nothing is drawn
+			uint32_t bpp = tex->hasalpha ? 4 : 3;
+			if (!tex->bitmaparray.empty() && tex->bitmaparray[0].size() >= tex->width*tex->height*bpp)
+			{
+				const uint8_t* bytes = tex->bitmaparray[0].data();
+				for (uint32_t i = 0; i < tex->width*tex->height; i++)
+				{
+					uint32_t alpha = bpp == 4 ? bytes[i*bpp+3] : 0xff;
+					texturebuffer.color[i] = (alpha<<24) | (bytes[i*bpp]<<16) | (bytes[i*bpp+1]<<8) | bytes[i*bpp+2];
+				}
+			}
+			targettexture = action.dataobject;
+			break;
+		}
+		case RENDER_DELETEPROGRAM:
+			if (program.getPtr() == action.dataobject.getPtr())
+				program.reset();
+			break;
+		case RENDER_SETVERTEXBUFFER:
+			//action.udata1 = index
+			//action.udata2 = bufferOffset
+			//action.udata3 = format
+			attributes[action.udata1].buffer = action.dataobject;
+			attributes[action.udata1].offset = action.udata2;
+			attributes[action.udata1].format = (VERTEXBUFFER_FORMAT)action.udata3;
+			break;
+		case RENDER_DRAWTRIANGLES:
+			if (action.dataobject.isNull())
+				break;
+			drawTriangles(action.dataobject->as<IndexBuffer3D>(),action.udata1,action.udata2);
+			break;
+		case RENDER_DELETEBUFFER:
+		case RENDER_LOADTEXTURE:
+		case RENDER_LOADCUBETEXTURE:
+			// buffers and textures are read directly from their objects when drawing
+			break;
+		case RENDER_SETPROGRAMCONSTANTS_FROM_MATRIX:
+		case RENDER_SETPROGRAMCONSTANTS_FROM_VECTOR:
+			context->setProgramConstants(action);
+			break;
+		case RENDER_SETTEXTUREAT:
+			textures[action.udata1] = action.dataobject;
+			break;
+		case RENDER_SETBLENDFACTORS:
+			blendSource = (BLEND_FACTOR)action.udata1;
+			blendDestination = (BLEND_FACTOR)action.udata2;
+			break;
+		case RENDER_SETDEPTHTEST:
+			depthMask = action.udata1;
+			depthFunction = (DEPTH_FUNCTION)action.udata2;
+			break;
+		case RENDER_SETCULLING:
+			culling = (TRIANGLE_FACE)action.udata1;
+			break;
+		case RENDER_SETSCISSORRECTANGLE:
+			scissor = action.fdata != nullptr;
+			if (scissor)
+			{
+				for (uint32_t i = 0; i < 4; i++)
+					scissorRect[i] = (int32_t)action.fdata[i];
+				delete[] action.fdata;
+			}
+			break;
+		case RENDER_SETCOLORMASK:
+			colorMask = action.udata1;
+			break;
+		case RENDER_SETSTENCILACTIONS:
+		{
+			StencilState s;
+			s.compare = (DEPTH_FUNCTION)action.udata2;
+			s.bothPass = (STENCIL_ACTION)(action.udata3&0xff);
+			s.depthFail = (STENCIL_ACTION)((action.udata3>>8)&0xff);
+			s.stencilFail = (STENCIL_ACTION)((action.udata3>>16)&0xff);
+			if (action.udata1 == FACE_FRONT || action.udata1 == FACE_FRONT_AND_BACK)
+				stencilFront = s;
+			if (action.udata1 == FACE_BACK || action.udata1 == FACE_FRONT_AND_BACK)
+				stencilBack = s;
+			break;
+		}
+		case RENDER_SETSTENCILREFERENCEVALUE:
+			stencilReference = action.udata1 & 0xff;
+			stencilReadMask = action.udata2 & 0xff;
+			stencilWriteMask = action.udata3 & 0xff;
+			break;
+	}
+}
+
+void SoftwareContext3D::present()
+{
+	finishTextureTarget();
+	// the stage below the 3d layer is not visible
+	for (auto it = backbuffer.color.begin(); it != backbuffer.color.end(); it++)
+		*it |= 0xff000000;
+	Locker l(context->rendermutex);
+	frontbuffer.swap(backbuffer.color);
+	backbuffer.color.resize(backbuffer.width*backbuffer.height);
+	frontWidth = backbuffer.width;
+	frontHeight = backbuffer.height;
+	newFrame = true;
+}
+
+void SoftwareContext3D::drawToBitmapData(BitmapData* destination)
+{
+	BitmapContainer* pixels = destination->getBitmapContainer().getPtr();
+	uint32_t w = min((uint32_t)destination->getWidth(),backbuffer.width);
+	uint32_t h = min((uint32_t)destination->getHeight(),backbuffer.height);
+	for (uint32_t y = 0; y < h; y++)
+	{
+		for (uint32_t x = 0; x < w; x++)
+		{
+			uint32_t c = backbuffer.color[y*backbuffer.width+x];
+			uint32_t alpha = c>>24;
+			if (!destination->transparent)
+				c |= 0xff000000;
+			else if (alpha != 0xff)
+			{
+				// BitmapData stores premultiplied colors
+				c = (alpha<<24) | ((((c>>16)&0xff)*alpha/255)<<16) | ((((c>>8)&0xff)*alpha/255)<<8) | ((c&0xff)*alpha/255);
+			}
+			pixels->setPixel(x,y,c,true,true);
+		}
+	}
+	destination->notifyUsers();
+}
+
+bool SoftwareContext3D::render(RenderContext& ctxt)
+{
+	Locker l(context->rendermutex);
+	if (frontWidth == 0 || frontHeight == 0)
+		return false;
+	RenderThread* rt = sys->getRenderThread();
+	if (!texture.isValid() || texture.width != frontWidth || texture.height != frontHeight)
+	{
+		if (texture.isValid())
+			rt->releaseTexture(texture);
+		// the gl texture may only be created at the start of the next frame
+		texture = rt->allocateTexture(frontWidth,frontHeight,true);
+		newFrame = true;
+		return false;
+	}
+	if (newFrame)
+	{
+		rt->loadChunkBGRA(texture,frontWidth,frontHeight,(uint8_t*)frontbuffer.data());
+		newFrame = false;
+	}
+	ctxt.lsglLoadIdentity();
+	ctxt.renderTextured(texture, 0, 0, frontWidth, frontHeight,
+			1.0, RenderContext::RGB_MODE,
+			0, 0, 0, frontWidth, frontHeight, 1.0, 1.0,
+			1.0, 1.0, 1.0, 1.0,
+			0.0, 0.0, 0.0, 0.0,
+			false, false, 0.0, RGB());
+	return true;
+}
+
+void SoftwareContext3D::drawTriangles(IndexBuffer3D* buffer, uint32_t firstIndex, uint32_t numTriangles)
+{
+	LS_TRACE_SCOPE("render","software3d.drawTriangles");
+	//The range is checked by Context3D.drawTriangles, index buffers only grow afterwards
+	if (firstIndex > buffer->data.size())
+		return;
+	uint32_t count = (numTriangles == UINT32_MAX) ? buffer->data.size()-firstIndex : (numTriangles * 3);
+	if (count > buffer->data.size()-firstIndex)
+		return;
+	Program3D* p = program.isNull() ? nullptr : program->as<Program3D>();
+	if (!p || !p->softwarevertexprogram || !p->softwarefragmentprogram
+			|| p->softwarevertexprogram->empty() || p->softwarefragmentprogram->empty())
+	{
+		LOG(LOG_ERROR,"Context3D.drawTriangles without a valid program");
+		return;
+	}
+	count -= count%3;
+	if (count == 0 || target->width == 0 || target->height == 0)
+		return;
+	const AGALProgram& vertexprogram = *p->softwarevertexprogram;
+	const AGALProgram& fragmentprogram = *p->softwarefragmentprogram;
+
+	for (uint32_t i = 0; i < CONTEXT3D_SAMPLER_COUNT; i++)
+	{
+		samplerTextures[i] = AGALTexture();
+		if (textures[i].isNull() || textures[i].getPtr() == targettexture.getPtr())
+			continue;
+		TextureBase* tex = textures[i]->as<TextureBase>();
+		AGALTexture& t = samplerTextures[i];
+		t.width = tex->width;
+		t.height = tex->height;
+		t.bytesPerPixel = tex->hasalpha ? 4 : 3;
+		uint32_t size = t.width*t.height*t.bytesPerPixel;
+		if (tex->is<CubeTexture>())
+		{
+			uint32_t levels = tex->as<CubeTexture>()->max_miplevel;
+			for (uint32_t f = 0; f < 6; f++)
+			{
+				if (levels*f < tex->bitmaparray.size() && tex->bitmaparray[levels*f].size() >= size)
+					t.faces[f] = tex->bitmaparray[levels*f].data();
+			}
+		}
+		else if (!tex->bitmaparray.empty() && tex->bitmaparray[0].size() >= size)
+			t.faces[0] = tex->bitmaparray[0].data();
+	}
+
+	const uint16_t* indices = buffer->data.data()+firstIndex;
+	uint32_t minindex = UINT32_MAX;
+	uint32_t maxindex = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		minindex = min(minindex,(uint32_t)indices[i]);
+		maxindex = max(maxindex,(uint32_t)indices[i]);
+	}
+	uint32_t numvertices = maxindex-minindex+1;
+	uint32_t varyings = vertexprogram.varyingmask | fragmentprogram.varyingmask;
+	varyingCount = 0;
+	while (varyings >> varyingCount)
+		varyingCount++;
+	const uint32_t stride = 4+4*varyingCount;
+
+	// vertex stage
+	clipVertices.resize(numvertices*stride);
+	uint32_t batches = (numvertices+SOFTWARE3D_VERTEX_BATCH-1)/SOFTWARE3D_VERTEX_BATCH;
+	runParallel(batches,batches > 1,[&](uint32_t batch)
+	{
+		shadeVertices(vertexprogram,minindex,batch*SOFTWARE3D_VERTEX_BATCH,min(numvertices,(batch+1)*SOFTWARE3D_VERTEX_BATCH));
+	});
+
+	// project the vertices in front of the near plane, triangles crossing it are clipped
+	vertices.clear();
+	vertices.reserve(numvertices*stride);
+	projectedVertices.resize(numvertices);
+	for (uint32_t v = 0; v < numvertices; v++)
+	{
+		const float* c = &clipVertices[v*stride];
+		projectedVertices[v] = (c[3] > SOFTWARE3D_NEAR_W && c[2] >= -c[3]) ? projectVertex(c) : UINT32_MAX;
+	}
+	triangles.clear();
+	for (uint32_t i = 0; i < count; i += 3)
+	{
+		uint32_t i0 = indices[i]-minindex;
+		uint32_t i1 = indices[i+1]-minindex;
+		uint32_t i2 = indices[i+2]-minindex;
+		if (projectedVertices[i0] != UINT32_MAX && projectedVertices[i1] != UINT32_MAX && projectedVertices[i2] != UINT32_MAX)
+			setupTriangle(projectedVertices[i0],projectedVertices[i1],projectedVertices[i2]);
+		else
+			clipTriangle(&clipVertices[i0*stride],&clipVertices[i1*stride],&clipVertices[i2*stride]);
+	}
+	if (triangles.empty())
+		return;
+
+	// bin the triangles into tiles, in submission order so blending stays ordered within every tile
+	uint32_t tilesx = (target->width+SOFTWARE3D_TILE_SIZE-1)/SOFTWARE3D_TILE_SIZE;
+	uint32_t tilesy = (target->height+SOFTWARE3D_TILE_SIZE-1)/SOFTWARE3D_TILE_SIZE;
+	bins.resize(tilesx*tilesy);
+	for (auto it = bins.begin(); it != bins.end(); it++)
+		it->clear();
+	uint64_t pixels = 0;
+	for (uint32_t i = 0; i < triangles.size(); i++)
+	{
+		const Triangle& t = triangles[i];
+		for (int32_t ty = t.miny/SOFTWARE3D_TILE_SIZE; ty <= (t.maxy-1)/SOFTWARE3D_TILE_SIZE; ty++)
+		{
+			for (int32_t tx = t.minx/SOFTWARE3D_TILE_SIZE; tx <= (t.maxx-1)/SOFTWARE3D_TILE_SIZE; tx++)
+				bins[ty*tilesx+tx].push_back(i);
+		}
+		pixels += uint64_t(t.maxx-t.minx)*uint64_t(t.maxy-t.miny);
+	}
+	std::vector<uint32_t> activetiles;
+	for (uint32_t i = 0; i < bins.size(); i++)
+	{
+		if (!bins[i].empty())
+			activetiles.push_back(i);
+	}
+	// fragment stage
+	runParallel(activetiles.size(),pixels >= SOFTWARE3D_PARALLEL_PIXELS,[&](uint32_t i)
+	{
+		rasterizeTile(fragmentprogram,activetiles[i]);
+	});
+}
+
+void SoftwareContext3D::shadeVertices(const AGALProgram& vertexprogram, uint32_t firstVertex, uint32_t start, uint32_t end)
+{
+	AGALRegisters regs;
+	memset(&regs,0,sizeof(regs));
+	const uint32_t stride = 4+4*varyingCount;
+	for (uint32_t v = start; v < end; v += AGAL_LANES)
+	{
+		uint32_t lanes = min((uint32_t)AGAL_LANES,end-v);
+		for (uint32_t a = 0; a < CONTEXT3D_ATTRIBUTE_COUNT; a++)
+		{
+			if (!(vertexprogram.attributemask & (1<<a)))
+				continue;
+			const VertexAttribute& attr = attributes[a];
+			VertexBuffer3D* vb = attr.buffer.isNull() ? nullptr : attr.buffer->as<VertexBuffer3D>();
+			uint32_t size = 4;
+			switch (attr.format)
+			{
+				case BYTES_4: size = 1; break;
+				case FLOAT_1: size = 1; break;
+				case FLOAT_2: size = 2; break;
+				case FLOAT_3: size = 3; break;
+				case FLOAT_4: size = 4; break;
+			}
+			for (uint32_t l = 0; l < AGAL_LANES; l++)
+			{
+				// unused lanes repeat the first vertex of the batch
+				uint32_t index = firstVertex+v+(l < lanes ? l : 0);
+				float value[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				if (vb && index < vb->numVertices && attr.offset+size <= (uint32_t)vb->data32PerVertex
+						&& (index+1)*vb->data32PerVertex <= vb->data.size())
+				{
+					const float* src = &vb->data[index*vb->data32PerVertex+attr.offset];
+					if (attr.format == BYTES_4)
+					{
+						uint32_t bits;
+						memcpy(&bits,src,sizeof(bits));
+						for (uint32_t k = 0; k < 4; k++)
+							value[k] = ((bits>>(8*k))&0xff)/255.0f;
+					}
+					else
+					{
+						for (uint32_t k = 0; k < size; k++)
+							value[k] = src[k];
+					}
+				}
+				for (uint32_t k = 0; k < 4; k++)
+					regs.attributes[a].c[k][l] = value[k];
+			}
+		}
+		vertexprogram.execute(regs,context->vertexConstants,samplerTextures);
+		for (uint32_t l = 0; l < lanes; l++)
+		{
+			float* out = &clipVertices[(v+l)*stride];
+			for (uint32_t k = 0; k < 4; k++)
+				out[k] = regs.output.c[k][l];
+			for (uint32_t r = 0; r < varyingCount; r++)
+			{
+				for (uint32_t k = 0; k < 4; k++)
+					out[4+r*4+k] = regs.varyings[r].c[k][l];
+			}
+		}
+	}
+}
+
+uint32_t SoftwareContext3D::projectVertex(const float* clip)
+{
+	const uint32_t stride = 4+4*varyingCount;
+	uint32_t index = vertices.size()/stride;
+	vertices.resize(vertices.size()+stride);
+	float* out = &vertices[index*stride];
+	float invw = 1.0f/clip[3];
+	out[0] = (clip[0]*invw*0.5f+0.5f)*target->width;
+	out[1] = (0.5f-clip[1]*invw*0.5f)*target->height;
+	// the same depth range as the gl backend
+	out[2] = clip[2]*invw*0.5f+0.5f;
+	out[3] = invw;
+	for (uint32_t i = 4; i < stride; i++)
+		out[i] = clip[i]*invw;
+	return index;
+}
+
+void SoftwareContext3D::clipTriangle(const float* c0, const float* c1, const float* c2)
+{
+	const uint32_t stride = 4+4*varyingCount;
+	// clipping a triangle against two planes adds at most two vertices
+	float buffer1[5*(4+4*AGAL_VARYING_COUNT)];
+	float buffer2[5*(4+4*AGAL_VARYING_COUNT)];
+	float* in = buffer1;
+	float* out = buffer2;
+	memcpy(in,c0,stride*sizeof(float));
+	memcpy(in+stride,c1,stride*sizeof(float));
+	memcpy(in+2*stride,c2,stride*sizeof(float));
+	uint32_t n = 3;
+	for (uint32_t plane = 0; plane < 2; plane++)
+	{
+		uint32_t m = 0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			const float* a = in+i*stride;
+			const float* b = in+((i+1)%n)*stride;
+			// plane 0 is w >= SOFTWARE3D_NEAR_W, plane 1 is z >= -w
+			float da = plane == 0 ? a[3]-SOFTWARE3D_NEAR_W : a[2]+a[3];
+			float db = plane == 0 ? b[3]-SOFTWARE3D_NEAR_W : b[2]+b[3];
+			if (da >= 0)
+				memcpy(out+(m++)*stride,a,stride*sizeof(float));
+			if ((da >= 0) != (db >= 0))
+			{
+				float t = da/(da-db);
+				float* o = out+(m++)*stride;
+				for (uint32_t k = 0; k < stride; k++)
+					o[k] = a[k]+(b[k]-a[k])*t;
+			}
+		}
+		std::swap(in,out);
+		n = m;
+		if (n < 3)
+			return;
+	}
+	uint32_t first = projectVertex(in);
+	uint32_t prev = projectVertex(in+stride);
+	for (uint32_t i = 2; i < n; i++)
+	{
+		uint32_t v = projectVertex(in+i*stride);
+		setupTriangle(first,prev,v);
+		prev = v;
+	}
+}
+
+void SoftwareContext3D::setupTriangle(uint32_t v0, uint32_t v1, uint32_t v2)
+{
+	const uint32_t stride = 4+4*varyingCount;
+	const float* p0 = &vertices[v0*stride];
+	const float* p1 = &vertices[v1*stride];
+	const float* p2 = &vertices[v2*stride];
+	float area = (p1[0]-p0[0])*(p2[1]-p0[1]) - (p1[1]-p0[1])*(p2[0]-p0[0]);
+	if (area == 0 || !std::isfinite(area))
+		return;
+	// clockwise on screen is the front face, like the gl backend
+	bool front = area > 0;
+	if (culling == FACE_FRONT_AND_BACK || (culling == FACE_FRONT && front) || (culling == FACE_BACK && !front))
+		return;
+	Triangle t;
+	t.front = front;
+	t.v[0] = v0;
+	t.v[1] = front ? v1 : v2;
+	t.v[2] = front ? v2 : v1;
+	if (!front)
+	{
+		std::swap(p1,p2);
+		area = -area;
+	}
+	float minx = min(p0[0],min(p1[0],p2[0]));
+	float maxx = max(p0[0],max(p1[0],p2[0]));
+	float miny = min(p0[1],min(p1[1],p2[1]));
+	float maxy = max(p0[1],max(p1[1],p2[1]));
+	int32_t x0 = 0, y0 = 0, x1 = target->width, y1 = target->height;
+	if (scissor)
+	{
+		x0 = max(x0,scissorRect[0]);
+		y0 = max(y0,scissorRect[1]);
+		x1 = min(x1,scissorRect[0]+scissorRect[2]);
+		y1 = min(y1,scissorRect[1]+scissorRect[3]);
+	}
+	t.minx = max(x0,(int32_t)floorf(max(minx,-1.0f)));
+	t.miny = max(y0,(int32_t)floorf(max(miny,-1.0f)));
+	t.maxx = min(x1,(int32_t)ceilf(min(maxx,(float)x1+1.0f)));
+	t.maxy = min(y1,(int32_t)ceilf(min(maxy,(float)y1+1.0f)));
+	if (t.minx >= t.maxx || t.miny >= t.maxy)
+		return;
+	const float* p[3] = { p0, p1, p2 };
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const float* a = p[(i+1)%3];
+		const float* b = p[(i+2)%3];
+		float dx = b[0]-a[0];
+		float dy = b[1]-a[1];
+		t.a[i] = -dy;
+		t.b[i] = dx;
+		t.c[i] = dy*a[0] - dx*a[1];
+		// pixels exactly on an edge belong to the triangle on its right or below it
+		t.topleft[i] = (dy == 0 && dx > 0) || dy < 0;
+	}
+	t.invarea = 1.0f/area;
+	triangles.push_back(t);
+}
+
+void SoftwareContext3D::rasterizeTile(const AGALProgram& fragmentprogram, uint32_t tile)
+{
+	uint32_t tilesx = (target->width+SOFTWARE3D_TILE_SIZE-1)/SOFTWARE3D_TILE_SIZE;
+	int32_t tx0 = (tile%tilesx)*SOFTWARE3D_TILE_SIZE;
+	int32_t ty0 = (tile/tilesx)*SOFTWARE3D_TILE_SIZE;
+	int32_t tx1 = min(tx0+SOFTWARE3D_TILE_SIZE,(int32_t)target->width);
+	int32_t ty1 = min(ty0+SOFTWARE3D_TILE_SIZE,(int32_t)target->height);
+	const std::vector<uint32_t>& bin = bins[tile];
+	AGALRegisters regs;
+	memset(&regs,0,sizeof(regs));
+	for (auto it = bin.begin(); it != bin.end(); it++)
+	{
+		const Triangle& t = triangles[*it];
+		int32_t x0 = max(t.minx,tx0);
+		int32_t y0 = max(t.miny,ty0);
+		int32_t x1 = min(t.maxx,tx1);
+		int32_t y1 = min(t.maxy,ty1);
+		if (x0 < x1 && y0 < y1)
+			rasterizeTriangle(fragmentprogram,regs,t,x0,y0,x1,y1);
+	}
+}
+
+void SoftwareContext3D::rasterizeTriangle(const AGALProgram& fragmentprogram, AGALRegisters& regs, const Triangle& t, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+	static const float lanex[AGAL_LANES] = { 0.5f, 1.5f, 0.5f, 1.5f };
+	static const float laney[AGAL_LANES] = { 0.5f, 0.5f, 1.5f, 1.5f };
+	const uint32_t stride = 4+4*varyingCount;
+	const float* p[3] = { &vertices[t.v[0]*stride], &vertices[t.v[1]*stride], &vertices[t.v[2]*stride] };
+	// without kil the tests are done before shading, so hidden quads are never shaded
+	const bool earlytest = !fragmentprogram.haskill;
+	Surface* s = target;
+	for (int32_t y = y0 & ~1; y < y1; y += 2)
+	{
+		for (int32_t x = x0 & ~1; x < x1; x += 2)
+		{
+			float lambda[3][AGAL_LANES];
+			float z[AGAL_LANES];
+			uint32_t covered = 0;
+			for (uint32_t l = 0; l < AGAL_LANES; l++)
+			{
+				int32_t ix = x+(l&1);
+				int32_t iy = y+(l>>1);
+				float px = x+lanex[l];
+				float py = y+laney[l];
+				bool inside = ix >= x0 && ix < x1 && iy >= y0 && iy < y1;
+				for (uint32_t e = 0; e < 3; e++)
+				{
+					float v = t.a[e]*px + t.b[e]*py + t.c[e];
+					if (!(v > 0 || (v == 0 && t.topleft[e])))
+						inside = false;
+					lambda[e][l] = v*t.invarea;
+				}
+				z[l] = lambda[0][l]*p[0][2] + lambda[1][l]*p[1][2] + lambda[2][l]*p[2][2];
+				//Triangles are clipped against the near plane by clipTriangle, the far plane is handled by discarding the fragments whose depth is outside [0,1]
+				if (!(z[l] >= 0.0f && z[l] <= 1.0f))
+					inside = false;
+				if (inside)
+					covered |= 1<<l;
+			}
+			if (earlytest)
+			{
+				for (uint32_t l = 0; l < AGAL_LANES; l++)
+				{
+					if ((covered & (1<<l)) && !testDepthStencil((y+(l>>1))*s->width+x+(l&1),z[l],t.front))
+						covered &= ~(1<<l);
+				}
+			}
+			if (!covered)
+				continue;
+			// perspective correct interpolation of the varyings
+			float w[AGAL_LANES];
+			for (uint32_t l = 0; l < AGAL_LANES; l++)
+			{
+				float invw = lambda[0][l]*p[0][3] + lambda[1][l]*p[1][3] + lambda[2][l]*p[2][3];
+				w[l] = invw != 0 ? 1.0f/invw : 0.0f;
+			}
+			for (uint32_t r = 0; r < varyingCount; r++)
+			{
+				if (!(fragmentprogram.varyingmask & (1<<r)))
+					continue;
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					uint32_t o = 4+r*4+k;
+					for (uint32_t l = 0; l < AGAL_LANES; l++)
+						regs.varyings[r].c[k][l] = (lambda[0][l]*p[0][o] + lambda[1][l]*p[1][o] + lambda[2][l]*p[2][o])*w[l];
+				}
+			}
+			fragmentprogram.execute(regs,context->fragmentConstants,samplerTextures);
+			covered &= ~regs.killed;
+			for (uint32_t l = 0; l < AGAL_LANES; l++)
+			{
+				if (!(covered & (1<<l)))
+					continue;
+				uint32_t index = (y+(l>>1))*s->width+x+(l&1);
+				if (!earlytest && !testDepthStencil(index,z[l],t.front))
+					continue;
+				float src[4] = { regs.output.c[0][l], regs.output.c[1][l], regs.output.c[2][l], regs.output.c[3][l] };
+				s->color[index] = blend(src,s->color[index]);
+			}
+		}
+	}
+}
+
+bool SoftwareContext3D::testDepthStencil(uint32_t index, float z, bool front)
+{
+	Surface* s = target;
+	if (!s->depthAndStencil)
+		return true;
+	const StencilState& st = front ? stencilFront : stencilBack;
+	uint8_t& stencil = s->stencil[index];
+	STENCIL_ACTION a;
+	bool pass = false;
+	if (!compareValues<uint32_t>(st.compare,stencilReference & stencilReadMask,stencil & stencilReadMask))
+		a = st.stencilFail;
+	else if (!compareValues<float>(depthFunction,z,s->depth[index]))
+		a = st.depthFail;
+	else
+	{
+		a = st.bothPass;
+		pass = true;
+		if (depthMask)
+			s->depth[index] = z;
+	}
+	if (a != STENCIL_KEEP)
+		stencil = (stencil & ~stencilWriteMask) | (stencilAction(a,stencil,stencilReference) & stencilWriteMask);
+	return pass;
+}
+
+uint32_t SoftwareContext3D::blend(const float* src, uint32_t dst) const
+{
+	uint32_t result;
+	if (blendSource == BLEND_ONE && blendDestination == BLEND_ZERO)
+		result = packColor(src);
+	else
+	{
+		float s[4] = { clampUnit(src[0]), clampUnit(src[1]), clampUnit(src[2]), clampUnit(src[3]) };
+		float d[4] = { ((dst>>16)&0xff)/255.0f, ((dst>>8)&0xff)/255.0f, (dst&0xff)/255.0f, (dst>>24)/255.0f };
+		float out[4];
+		for (uint32_t c = 0; c < 4; c++)
+			out[c] = s[c]*blendFactor(blendSource,c,s,d) + d[c]*blendFactor(blendDestination,c,s,d);
+		result = packColor(out);
+	}
+	uint32_t written = channelMask(colorMask);
+	return (result & written) | (dst & ~written);
+}
@@ -0,0 +1,169 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2017 Ludger Krämer <dbluelle@onlinehome.de>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+#ifndef SOFTWARECONTEXT3D_H
+#define SOFTWARECONTEXT3D_H
+
+#include "compat.h"
+#include <functional>
+#include <vector>
+#include "scripting/flash/display3d/flashdisplay3d.h"
+#include "scripting/flash/display3d/agalinterpreter.h"
+#include "backends/graphics.h"
+
+// size in pixels of the screen tiles the triangles are binned into
+#define SOFTWARE3D_TILE_SIZE 64
+// maximum number of thread pool jobs used for one draw call
+#define SOFTWARE3D_MAX_JOBS 8
+// vertices shaded by one job
+#define SOFTWARE3D_VERTEX_BATCH 256
+
+namespace lightspark
+{
+class BitmapData;
+
+enum STENCIL_ACTION { STENCIL_KEEP, STENCIL_ZERO, STENCIL_SET, STENCIL_INCREMENT_SATURATE, STENCIL_DECREMENT_SATURATE,
+					  STENCIL_INCREMENT_WRAP, STENCIL_DECREMENT_WRAP, STENCIL_INVERT };
+
+/*
+ * CPU implementation of Context3D, used for renderMode "software" or if LIGHTSPARK_SOFTWARE_CONTEXT3D is set.
+ * The render actions are executed on the calling thread when they are added, so the content
+ * can be rendered without any gpu and read back with drawToBitmapData.
+ * The vertices of a draw call are shaded in batches and its triangles are binned into screen tiles,
+ * both are split across the thread pool. The tiles are rasterized in 2x2 pixel quads, one quad is
+ * one execution of the AGAL fragment program.
+ * The color buffers hold native-endian 32 bit ARGB like BitmapContainer, but not premultiplied.
+ */
+class SoftwareContext3D
+{
+private:
+	struct Surface
+	{
+		uint32_t width;
+		uint32_t height;
+		bool depthAndStencil;
+		std::vector<uint32_t> color;
+		std::vector<float> depth;
+		std::vector<uint8_t> stencil;
+		Surface():width(0),height(0),depthAndStencil(false) {}
+		void resize(uint32_t w, uint32_t h);
+	};
+	struct StencilState
+	{
+		DEPTH_FUNCTION compare;
+		STENCIL_ACTION bothPass;
+		STENCIL_ACTION depthFail;
+		STENCIL_ACTION stencilFail;
+		StencilState():compare(ALWAYS),bothPass(STENCIL_KEEP),depthFail(STENCIL_KEEP),stencilFail(STENCIL_KEEP) {}
+	};
+	struct VertexAttribute
+	{
+		_NR<ASObject> buffer;
+		uint32_t offset;
+		VERTEXBUFFER_FORMAT format;
+	};
+	struct Triangle
+	{
+		// indices into vertices, ordered counter clockwise on screen
+		uint32_t v[3];
+		bool front;
+		// pixel bounds, the max values are exclusive
+		int32_t minx;
+		int32_t miny;
+		int32_t maxx;
+		int32_t maxy;
+		// edge functions, edge i is opposite to vertex i
+		float a[3];
+		float b[3];
+		float c[3];
+		bool topleft[3];
+		float invarea;
+	};
+	SystemState* sys;
+	Context3D* context;
+	Surface backbuffer;
+	Surface texturebuffer;
+	Surface* target;
+	_NR<ASObject> targettexture;
+	_NR<ASObject> program;
+	_NR<ASObject> textures[CONTEXT3D_SAMPLER_COUNT];
+	VertexAttribute attributes[CONTEXT3D_ATTRIBUTE_COUNT];
+	BLEND_FACTOR blendSource;
+	BLEND_FACTOR blendDestination;
+	bool depthMask;
+	DEPTH_FUNCTION depthFunction;
+	TRIANGLE_FACE culling;
+	uint32_t colorMask;
+	bool scissor;
+	int32_t scissorRect[4];
+	StencilState stencilFront;
+	StencilState stencilBack;
+	uint32_t stencilReference;
+	uint32_t stencilReadMask;
+	uint32_t stencilWriteMask;
+
+	// data of the current draw call
+	uint32_t varyingCount;
+	// clip space position and varyings of every shaded vertex
+	std::vector<float> clipVertices;
+	// index of every shaded vertex in vertices, UINT32_MAX if it is behind the near plane
+	std::vector<uint32_t> projectedVertices;
+	// screen position, depth, 1/w and the varyings divided by w of the projected and clipped vertices
+	std::vector<float> vertices;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<uint32_t>> bins;
+	AGALTexture samplerTextures[CONTEXT3D_SAMPLER_COUNT];
+
+	// last presented frame, protected by the rendermutex of the context
+	std::vector<uint32_t> frontbuffer;
+	uint32_t frontWidth;
+	uint32_t frontHeight;
+	bool newFrame;
+	// only used by the render thread
+	TextureChunk texture;
+
+	/*
+	 * Calls f(i) for every i in [0,count). If parallel is true, the items are taken
+	 * by the calling thread and up to SOFTWARE3D_MAX_JOBS-1 thread pool jobs.
+	 */
+	void runParallel(uint32_t count, bool parallel, const std::function<void(uint32_t)>& f);
+	void setTarget(Surface* s);
+	void finishTextureTarget();
+	void clear(const renderaction& action);
+	void drawTriangles(IndexBuffer3D* buffer, uint32_t firstIndex, uint32_t numTriangles);
+	void shadeVertices(const AGALProgram& vertexprogram, uint32_t firstVertex, uint32_t start, uint32_t end);
+	uint32_t projectVertex(const float* clip);
+	void setupTriangle(uint32_t v0, uint32_t v1, uint32_t v2);
+	void clipTriangle(const float* c0, const float* c1, const float* c2);
+	void rasterizeTile(const AGALProgram& fragmentprogram, uint32_t tile);
+	void rasterizeTriangle(const AGALProgram& fragmentprogram, AGALRegisters& regs, const Triangle& t, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+	bool testDepthStencil(uint32_t index, float z, bool front);
+	uint32_t blend(const float* src, uint32_t dst) const;
+public:
+	SoftwareContext3D(Context3D* ctx);
+	~SoftwareContext3D();
+	// executes the action on the calling thread
+	void handleRenderAction(renderaction& action);
+	void present();
+	void drawToBitmapData(BitmapData* destination);
+	// called from the render thread, draws the last presented frame
+	bool render(RenderContext& ctxt);
+};
+
+}
+#endif // SOFTWARECONTEXT3D_H
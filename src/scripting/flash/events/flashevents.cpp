@@ -565,6 +565,36 @@ bool EventDispatcher::destruct()
 	return ASObject::destruct();
 }
 
+void EventDispatcher::getReferencedObjects(std::vector<ASObject*>& refs)
+{
+	ASObject::getReferencedObjects(refs);
+	Locker l(handlersMutex);
+	for(auto it=handlers.begin();it!=handlers.end();++it)
+	{
+		for(auto it2=it->second.begin();it2!=it->second.end();++it2)
+		{
+			if(asAtomHandler::isObject(it2->f))
+				refs.push_back(asAtomHandler::getObjectNoCheck(it2->f));
+		}
+	}
+}
+
+void EventDispatcher::unlinkReferencedObjects()
+{
+	std::map<tiny_string,std::list<listener> > oldhandlers;
+	{
+		Locker l(handlersMutex);
+		oldhandlers.swap(handlers);
+	}
+	//Release the listeners outside of the lock, as their destruction may access this object
+	for(auto it=oldhandlers.begin();it!=oldhandlers.end();++it)
+	{
+		for(auto it2=it->second.begin();it2!=it->second.end();++it2)
+			ASATOM_DECREF(it2->f);
+	}
+	ASObject::unlinkReferencedObjects();
+}
+
 void EventDispatcher::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructor, CLASS_SEALED);
@@ -32,7 +32,7 @@ namespace lightspark
 
 enum EVENT_TYPE { EVENT=0, BIND_CLASS, SHUTDOWN, SYNC, MOUSE_EVENT,
 	FUNCTION, EXTERNAL_CALL, CONTEXT_INIT, INIT_FRAME,
-	FLUSH_INVALIDATION_QUEUE, ADVANCE_FRAME, PARSE_RPC_MESSAGE,EXECUTE_FRAMESCRIPT,TEXTINPUT_EVENT,IDLE_EVENT,AVM1INITACTION_EVENT,ROOTCONSTRUCTEDEVENT };
+	FLUSH_INVALIDATION_QUEUE, ADVANCE_FRAME, PARSE_RPC_MESSAGE,EXECUTE_FRAMESCRIPT,TEXTINPUT_EVENT,IDLE_EVENT,AVM1INITACTION_EVENT,ROOTCONSTRUCTEDEVENT,BROADCAST_EVENT };
 
 class ABCContext;
 class DictionaryTag;
@@ -374,6 +374,8 @@ public:
 	EventDispatcher(Class_base* c);
 	void finalize() override;
 	bool destruct() override;
+	void getReferencedObjects(std::vector<ASObject*>& refs) override;
+	void unlinkReferencedObjects() override;
 	// is called when a new event is added to the event queue
 	virtual void onNewEvent(Event* ev){}
 	// is called after an event was handled by the event queue
@@ -520,6 +522,21 @@ public:
 	EVENT_TYPE getEventType() const override { return EXECUTE_FRAMESCRIPT; }
 };
 
+/*
+ * Dispatches one event to a snapshot of the frame listeners in a single pass of the VM,
+ * instead of queueing it once for every listener
+ */
+class BroadcastEvent: public Event
+{
+friend class ABCVm;
+private:
+	_R<Event> event;
+	std::vector<_R<DisplayObject>> listeners;
+public:
+	BroadcastEvent(_R<Event> e, const std::set<_R<DisplayObject>>& l):Event(nullptr,"BroadcastEvent"),event(e),listeners(l.begin(),l.end()) {}
+	EVENT_TYPE getEventType() const override { return BROADCAST_EVENT; }
+};
+
 class AdvanceFrameEvent: public Event
 {
 friend class ABCVm;
@@ -539,6 +556,14 @@ public:
 	EVENT_TYPE getEventType() const override { return ROOTCONSTRUCTEDEVENT; }
 };
 
+//Event that does nothing, waiting for it waits until the events queued before are handled
+class SyncEvent: public WaitableEvent
+{
+public:
+	SyncEvent(): WaitableEvent("SyncEvent") {}
+	EVENT_TYPE getEventType() const override { return SYNC; }
+};
+
 class IdleEvent: public WaitableEvent
 {
 public:
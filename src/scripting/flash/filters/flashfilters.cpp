@@ -22,6 +22,7 @@
 #include "scripting/argconv.h"
 #include "scripting/flash/display/BitmapData.h"
 #include "scripting/flash/geom/flashgeom.h"
+#include "backends/filters.h"
 
 using namespace std;
 using namespace lightspark;
@@ -52,7 +53,6 @@ GlowFilter::GlowFilter(Class_base* c,const GLOWFILTER& filter):
 	BitmapFilter(c,SUBTYPE_GLOWFILTER), alpha(filter.GlowColor.af()), blurX(filter.BlurX), blurY(filter.BlurY), color(RGB(filter.GlowColor.Red,filter.GlowColor.Green,filter.GlowColor.Blue).toUInt()),
 	inner(filter.InnerGlow), knockout(filter.Knockout), quality(filter.Passes), strength(filter.Strength)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"GlowFilter from Tag");
 }
 
 void GlowFilter::sinit(Class_base* c)
@@ -88,7 +88,6 @@ ASFUNCTIONBODY_ATOM(GlowFilter,_constructor)
 		(th->quality, 1)
 		(th->inner, false)
 		(th->knockout, false);
-	LOG(LOG_NOT_IMPLEMENTED,"GlowFilter does nothing");
 }
 
 BitmapFilter* GlowFilter::cloneImpl() const
@@ -105,6 +104,20 @@ BitmapFilter* GlowFilter::cloneImpl() const
 	return cloned;
 }
 
+bool GlowFilter::getFilterData(FilterData& data) const
+{
+	data.type = FilterData::FILTER_GLOW;
+	data.alpha = alpha;
+	data.blurX = blurX;
+	data.blurY = blurY;
+	data.color = color;
+	data.inner = inner;
+	data.knockout = knockout;
+	data.quality = quality;
+	data.strength = strength;
+	return true;
+}
+
 DropShadowFilter::DropShadowFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_DROPSHADOWFILTER), alpha(1.0), angle(45), blurX(4.0), blurY(4.0),
 	color(0), distance(4.0), hideObject(false), inner(false),
@@ -116,7 +129,6 @@ DropShadowFilter::DropShadowFilter(Class_base* c,const DROPSHADOWFILTER& filter)
 	color(RGB(filter.DropShadowColor.Red,filter.DropShadowColor.Green,filter.DropShadowColor.Blue).toUInt()), distance(filter.Distance), hideObject(false), inner(filter.InnerShadow),
 	knockout(filter.Knockout), quality(filter.Passes), strength(filter.Strength)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"DropShadowFilter from Tag");
 }
 
 
@@ -162,7 +174,6 @@ ASFUNCTIONBODY_ATOM(DropShadowFilter,_constructor)
 		(th->inner, false)
 		(th->knockout, false)
 		(th->hideObject, false);
-	LOG(LOG_NOT_IMPLEMENTED,"DropShadowFilter does nothing");
 }
 
 BitmapFilter* DropShadowFilter::cloneImpl() const
@@ -182,6 +193,23 @@ BitmapFilter* DropShadowFilter::cloneImpl() const
 	return cloned;
 }
 
+bool DropShadowFilter::getFilterData(FilterData& data) const
+{
+	data.type = FilterData::FILTER_DROPSHADOW;
+	data.alpha = alpha;
+	data.angle = angle;
+	data.blurX = blurX;
+	data.blurY = blurY;
+	data.color = color;
+	data.distance = distance;
+	data.hideObject = hideObject;
+	data.inner = inner;
+	data.knockout = knockout;
+	data.quality = quality;
+	data.strength = strength;
+	return true;
+}
+
 GradientGlowFilter::GradientGlowFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_GRADIENTGLOWFILTER),distance(4.0),angle(45), blurX(4.0), blurY(4.0), strength(1), quality(1), type("inner"), knockout(false)
 {
@@ -346,7 +374,6 @@ ColorMatrixFilter::ColorMatrixFilter(Class_base* c):
 ColorMatrixFilter::ColorMatrixFilter(Class_base* c,const COLORMATRIXFILTER& filter):
 	BitmapFilter(c,SUBTYPE_COLORMATRIXFILTER)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"ColorMatrixFilter from Tag");
 	matrix = _MR(Class<Array>::getInstanceSNoArgs(c->getSystemState()));
 	for (uint32_t i = 0; i < 20 ; i++)
 	{
@@ -367,7 +394,6 @@ ASFUNCTIONBODY_ATOM(ColorMatrixFilter,_constructor)
 {
 	ColorMatrixFilter *th = asAtomHandler::as<ColorMatrixFilter>(obj);
 	ARG_UNPACK_ATOM(th->matrix,NullRef);
-	LOG(LOG_NOT_IMPLEMENTED,"ColorMatrixFilter does nothing");
 }
 
 BitmapFilter* ColorMatrixFilter::cloneImpl() const
@@ -380,6 +406,20 @@ BitmapFilter* ColorMatrixFilter::cloneImpl() const
 	}
 	return cloned;
 }
+
+bool ColorMatrixFilter::getFilterData(FilterData& data) const
+{
+	data.type = FilterData::FILTER_COLORMATRIX;
+	if (matrix.isNull())
+		return true;
+	uint32_t size = min(matrix->size(),(uint64_t)20);
+	for (uint32_t i = 0; i < size; i++)
+	{
+		asAtom a = matrix->at(i);
+		data.colorMatrix[i] = asAtomHandler::toNumber(a);
+	}
+	return true;
+}
 BlurFilter::BlurFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_BLURFILTER),blurX(4.0),blurY(4.0),quality(1)
 {
@@ -387,7 +427,6 @@ BlurFilter::BlurFilter(Class_base* c):
 BlurFilter::BlurFilter(Class_base* c,const BLURFILTER& filter):
 	BitmapFilter(c,SUBTYPE_BLURFILTER),blurX(filter.BlurX),blurY(filter.BlurY),quality(filter.Passes)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"BlurFilter from Tag");
 }
 
 void BlurFilter::sinit(Class_base* c)
@@ -405,7 +444,6 @@ ASFUNCTIONBODY_ATOM(BlurFilter,_constructor)
 {
 	BlurFilter *th = asAtomHandler::as<BlurFilter>(obj);
 	ARG_UNPACK_ATOM(th->blurX,4.0)(th->blurY,4.0)(th->quality,1);
-	LOG(LOG_NOT_IMPLEMENTED,"BlurFilter is not implemented");
 }
 
 BitmapFilter* BlurFilter::cloneImpl() const
@@ -417,6 +455,15 @@ BitmapFilter* BlurFilter::cloneImpl() const
 	return cloned;
 }
 
+bool BlurFilter::getFilterData(FilterData& data) const
+{
+	data.type = FilterData::FILTER_BLUR;
+	data.blurX = blurX;
+	data.blurY = blurY;
+	data.quality = quality;
+	return true;
+}
+
 ConvolutionFilter::ConvolutionFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_CONVOLUTIONFILTER),
 	alpha(0.0),
@@ -440,7 +487,6 @@ ConvolutionFilter::ConvolutionFilter(Class_base* c, const CONVOLUTIONFILTER& fil
 	matrixY((uint32_t)filter.MatrixY),
 	preserveAlpha(filter.PreserveAlpha)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"ConvolutionFilter from Tag");
 	if (filter.Matrix.size())
 	{
 		matrix = _MR(Class<Array>::getInstanceSNoArgs(c->getSystemState()));
@@ -466,20 +512,28 @@ void ConvolutionFilter::sinit(Class_base* c)
 	REGISTER_GETTER_SETTER(c,matrixY);
 	REGISTER_GETTER_SETTER(c,preserveAlpha);
 }
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,alpha);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,bias);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,clamp);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,color);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,divisor);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,matrix);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,matrixX);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,matrixY);
-ASFUNCTIONBODY_GETTER_SETTER_NOT_IMPLEMENTED(ConvolutionFilter,preserveAlpha);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,alpha);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,bias);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,clamp);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,color);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,divisor);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,matrix);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,matrixX);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,matrixY);
+ASFUNCTIONBODY_GETTER_SETTER(ConvolutionFilter,preserveAlpha);
 
 ASFUNCTIONBODY_ATOM(ConvolutionFilter,_constructor)
 {
-	//ConvolutionFilter *th = obj.as<ConvolutionFilter>();
-	LOG(LOG_NOT_IMPLEMENTED,"ConvolutionFilter is not implemented");
+	ConvolutionFilter *th = asAtomHandler::as<ConvolutionFilter>(obj);
+	ARG_UNPACK_ATOM(th->matrixX,0)
+		(th->matrixY,0)
+		(th->matrix,NullRef)
+		(th->divisor,1.0)
+		(th->bias,0.0)
+		(th->preserveAlpha,true)
+		(th->clamp,true)
+		(th->color,0)
+		(th->alpha,0.0);
 }
 
 BitmapFilter* ConvolutionFilter::cloneImpl() const
@@ -497,6 +551,28 @@ BitmapFilter* ConvolutionFilter::cloneImpl() const
 	return cloned;
 }
 
+bool ConvolutionFilter::getFilterData(FilterData& data) const
+{
+	data.type = FilterData::FILTER_CONVOLUTION;
+	data.alpha = alpha;
+	data.bias = bias;
+	data.clamp = clamp;
+	data.color = color;
+	data.divisor = divisor;
+	data.matrixX = matrixX;
+	data.matrixY = matrixY;
+	data.preserveAlpha = preserveAlpha;
+	if (!matrix.isNull())
+	{
+		for (uint32_t i = 0; i < matrix->size(); i++)
+		{
+			asAtom a = matrix->at(i);
+			data.kernel.push_back(asAtomHandler::toNumber(a));
+		}
+	}
+	return true;
+}
+
 DisplacementMapFilter::DisplacementMapFilter(Class_base* c):
 	BitmapFilter(c,SUBTYPE_DISPLACEMENTFILTER)
 {
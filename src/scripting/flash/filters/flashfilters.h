@@ -25,6 +25,7 @@
 
 namespace lightspark
 {
+struct FilterData;
 
 class BitmapFilter: public ASObject
 {
@@ -33,6 +34,11 @@ private:
 public:
 	BitmapFilter(Class_base* c, CLASS_SUBTYPE st=SUBTYPE_BITMAPFILTER):ASObject(c,T_OBJECT,st){}
 	static void sinit(Class_base* c);
+	/*
+	 * Fills data with the current parameters of the filter.
+	 * Returns false if the filter is not supported by the FilterEngine
+	 */
+	virtual bool getFilterData(FilterData& data) const { return false; }
 	ASFUNCTION_ATOM(clone);
 };
 
@@ -50,6 +56,7 @@ private:
 	BitmapFilter* cloneImpl() const override;
 public:
 	GlowFilter(Class_base* c);
+	bool getFilterData(FilterData& data) const override;
 	GlowFilter(Class_base* c,const GLOWFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
@@ -72,6 +79,7 @@ private:
 	BitmapFilter* cloneImpl() const override;
 public:
 	DropShadowFilter(Class_base* c);
+	bool getFilterData(FilterData& data) const override;
 	DropShadowFilter(Class_base* c,const DROPSHADOWFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
@@ -127,6 +135,7 @@ private:
 	BitmapFilter* cloneImpl() const override;
 public:
 	ColorMatrixFilter(Class_base* c);
+	bool getFilterData(FilterData& data) const override;
 	ColorMatrixFilter(Class_base* c,const COLORMATRIXFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
@@ -138,6 +147,7 @@ private:
 	BitmapFilter* cloneImpl() const override;
 public:
 	BlurFilter(Class_base* c);
+	bool getFilterData(FilterData& data) const override;
 	BlurFilter(Class_base* c,const BLURFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
@@ -151,6 +161,7 @@ private:
 	BitmapFilter* cloneImpl() const override;
 public:
 	ConvolutionFilter(Class_base* c);
+	bool getFilterData(FilterData& data) const override;
 	ConvolutionFilter(Class_base* c,const CONVOLUTIONFILTER& filter);
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
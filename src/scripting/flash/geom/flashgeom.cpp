@@ -2060,8 +2060,7 @@ ASFUNCTIONBODY_ATOM(Matrix3D,_constructor)
 	{
 		for (uint32_t i = 0; i < v->size() && i < 4*4; i++)
 		{
-			asAtom a = v->at(i);
-			th->data[i] = asAtomHandler::toNumber(a);
+			th->data[i] = v->getNumberAt(i);
 		}
 	}
 }
@@ -2240,8 +2239,7 @@ ASFUNCTIONBODY_ATOM(Matrix3D,copyRawDataFrom)
 		LOG(LOG_NOT_IMPLEMENTED, "Matrix3D.copyRawDataFrom ignores parameter 'transpose'");
 	for (uint32_t i = 0; i < vector->size()-index && i < 16; i++)
 	{
-		asAtom a = vector->at(index+i);
-		th->data[i] = asAtomHandler::toNumber(a);
+		th->data[i] = vector->getNumberAt(index+i);
 	}
 }
 
@@ -2370,8 +2368,7 @@ ASFUNCTIONBODY_ATOM(Matrix3D,_set_rawData)
 	// TODO handle not invertible argument
 	for (uint32_t i = 0; i < data->size(); i++)
 	{
-		asAtom a = data->at(i);
-		th->data[i] = asAtomHandler::toNumber(a);
+		th->data[i] = data->getNumberAt(i);
 	}
 }
 ASFUNCTIONBODY_ATOM(Matrix3D,_get_position)
@@ -708,7 +708,7 @@ ASFUNCTIONBODY_GETTER_SETTER(SoundLoaderContext,checkPolicyFile);
 
 SoundChannel::SoundChannel(Class_base* c, _NR<StreamCache> _stream, AudioFormat _format, bool autoplay)
 	: EventDispatcher(c),stream(_stream),stopped(true),terminated(true),audioDecoder(nullptr),audioStream(nullptr),
-	format(_format),oldVolume(-1.0),startTime(0),restartafterabort(false),soundTransform(_MR(Class<SoundTransform>::getInstanceS(c->getSystemState()))),
+	format(_format),oldVolume(-1.0),oldPan(0.0),startTime(0),restartafterabort(false),soundTransform(_MR(Class<SoundTransform>::getInstanceS(c->getSystemState()))),
 	leftPeak(1),rightPeak(1)
 {
 	subtype=SUBTYPE_SOUNDCHANNEL;
@@ -901,12 +901,16 @@ void SoundChannel::playStream()
 
 			if(audioStream)
 			{
-				//TODO: use soundTransform->pan
 				if(soundTransform && soundTransform->volume != oldVolume)
 				{
 					audioStream->setVolume(soundTransform->volume);
 					oldVolume = soundTransform->volume;
 				}
+				if(soundTransform && soundTransform->pan != oldPan)
+				{
+					audioStream->setPan(soundTransform->pan);
+					oldPan = soundTransform->pan;
+				}
 			}
 			
 			if(threadAborting)
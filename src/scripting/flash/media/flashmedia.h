@@ -59,6 +59,7 @@ protected:
 	//ILoadable interface
 	void setBytesTotal(uint32_t b);
 	void setBytesLoaded(uint32_t b);
+	DOWNLOAD_PRIORITY getDownloadPriority() const { return DOWNLOAD_PRIORITY_LOW; }
 	_NR<ProgressEvent> progressEvent;
 public:
 	Sound(Class_base* c);
@@ -99,6 +100,7 @@ private:
 	AudioStream* audioStream;
 	AudioFormat format;
 	number_t oldVolume;
+	number_t oldPan;
 	void validateSoundTransform(_NR<SoundTransform>);
 	void playStream();
 	number_t startTime;
@@ -124,6 +124,7 @@ public:
 	~ASSocketThread();
 	virtual void execute();
 	virtual void jobFence();
+	JOB_PRIORITY getPriority() const override { return JOB_PRIORITY_NETWORK; }
 	void flushData();
 	void requestClose();
 	bool isConnected();
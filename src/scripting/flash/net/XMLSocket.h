@@ -75,6 +75,7 @@ public:
 	~XMLSocketThread();
 	virtual void execute();
 	virtual void jobFence();
+	JOB_PRIORITY getPriority() const override { return JOB_PRIORITY_NETWORK; }
 	void sendData(const tiny_string& data);
 	void requestClose();
 	bool isConnected();
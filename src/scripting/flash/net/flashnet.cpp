@@ -1234,7 +1234,7 @@ void NetStreamAppendBytesAction::sinit(Class_base* c)
 NetStream::NetStream(Class_base* c):EventDispatcher(c),tickStarted(false),paused(false),closed(true),
 	streamTime(0),frameRate(0),connection(),downloader(nullptr),videoDecoder(nullptr),
 	audioDecoder(nullptr),audioStream(nullptr),datagenerationfile(nullptr),datagenerationthreadstarted(false),client(NullRef),
-	oldVolume(-1.0),checkPolicyFile(false),rawAccessAllowed(false),framesdecoded(0),playbackBytesPerSecond(0),maxBytesPerSecond(0),datagenerationexpecttype(DATAGENERATION_HEADER),datagenerationbuffer(Class<ByteArray>::getInstanceS(c->getSystemState())),
+	oldVolume(-1.0),oldPan(0.0),checkPolicyFile(false),rawAccessAllowed(false),framesdecoded(0),playbackBytesPerSecond(0),maxBytesPerSecond(0),datagenerationexpecttype(DATAGENERATION_HEADER),datagenerationbuffer(Class<ByteArray>::getInstanceS(c->getSystemState())),
 	streamDecoder(nullptr),
 	backBufferLength(0),backBufferTime(30),bufferLength(0),bufferTime(0.1),bufferTimeMax(0),
 	maxPauseBufferTime(0)
@@ -1801,12 +1801,16 @@ void NetStream::tick()
 	//Check if the stream is paused
 	if(audioStream)
 	{
-		//TODO: use soundTransform->pan
 		if(soundTransform && soundTransform->volume != oldVolume)
 		{
 			audioStream->setVolume(soundTransform->volume);
 			oldVolume = soundTransform->volume;
 		}
+		if(soundTransform && soundTransform->pan != oldPan)
+		{
+			audioStream->setPan(soundTransform->pan);
+			oldPan = soundTransform->pan;
+		}
 	}
 	if(paused)
 		return;
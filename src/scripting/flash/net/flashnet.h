@@ -193,6 +193,7 @@ public:
 	void setDataFormat(const tiny_string& newFormat);
 	void setBytesTotal(uint32_t b);
 	void setBytesLoaded(uint32_t b);
+	DOWNLOAD_PRIORITY getDownloadPriority() const { return DOWNLOAD_PRIORITY_HIGH; }
 	ASFUNCTION_ATOM(_constructor);
 	ASFUNCTION_ATOM(load);
 	ASFUNCTION_ATOM(close);
@@ -240,6 +241,7 @@ private:
 	void execute();
 	void threadAbort();
 	void jobFence();
+	JOB_PRIORITY getPriority() const override { return JOB_PRIORITY_NETWORK; }
 public:
 	NetConnection(Class_base* c);
 	void finalize();
@@ -310,6 +312,7 @@ private:
 
 	ASPROPERTY_GETTER_SETTER(NullableRef<SoundTransform>,soundTransform);
 	number_t oldVolume;
+	number_t oldPan;
 
 	enum CONNECTION_TYPE { CONNECT_TO_FMS=0, DIRECT_CONNECTIONS };
 	CONNECTION_TYPE peerID;
@@ -1,47 +1,88 @@
 #include "scripting/flash/sampler/flashsampler.h"
 #include "scripting/toplevel/Array.h"
+#include "scripting/toplevel/Integer.h"
 #include "scripting/argconv.h"
+#include "scripting/class.h"
+#include "sampler.h"
+#include "swf.h"
 
 using namespace lightspark;
 
 Sample::Sample(Class_base* c):
-	ASObject(c)
+	ASObject(c),time(0)
 {
 }
 
 void Sample::sinit(Class_base* c)
 {
 	CLASS_SETUP_NO_CONSTRUCTOR(c, ASObject, CLASS_SEALED|CLASS_FINAL);
+	REGISTER_GETTER(c,time);
+	REGISTER_GETTER(c,stack);
+}
+ASFUNCTIONBODY_GETTER(Sample,time);
+ASFUNCTIONBODY_GETTER(Sample,stack);
+
+bool Sample::destruct()
+{
+	time=0;
+	stack.reset();
+	return ASObject::destruct();
 }
 
 
 DeleteObjectSample::DeleteObjectSample(Class_base* c):
-	Sample(c)
+	Sample(c),id(0),size(0)
 {
 }
 
 void DeleteObjectSample::sinit(Class_base* c)
 {
 	CLASS_SETUP_NO_CONSTRUCTOR(c, Sample, CLASS_SEALED|CLASS_FINAL);
+	REGISTER_GETTER(c,id);
+	REGISTER_GETTER(c,size);
 }
+ASFUNCTIONBODY_GETTER(DeleteObjectSample,id);
+ASFUNCTIONBODY_GETTER(DeleteObjectSample,size);
 
 
 NewObjectSample::NewObjectSample(Class_base* c):
-	Sample(c)
+	Sample(c),id(0),size(0),sampledObject(nullptr)
 {
 }
 
 void NewObjectSample::sinit(Class_base* c)
 {
 	CLASS_SETUP_NO_CONSTRUCTOR(c, Sample, CLASS_SEALED|CLASS_FINAL);
+	REGISTER_GETTER(c,id);
+	REGISTER_GETTER(c,type);
 	REGISTER_GETTER(c,object);
 	REGISTER_GETTER(c,size);
 }
-ASFUNCTIONBODY_GETTER_NOT_IMPLEMENTED(NewObjectSample,object);
-ASFUNCTIONBODY_GETTER_NOT_IMPLEMENTED(NewObjectSample,size);
+ASFUNCTIONBODY_GETTER(NewObjectSample,id);
+ASFUNCTIONBODY_GETTER(NewObjectSample,type);
+ASFUNCTIONBODY_GETTER(NewObjectSample,size);
+
+bool NewObjectSample::destruct()
+{
+	id=0;
+	type.reset();
+	size=0;
+	sampledObject=nullptr;
+	return Sample::destruct();
+}
+
+ASFUNCTIONBODY_ATOM(NewObjectSample,_getter_object)
+{
+	NewObjectSample* th=asAtomHandler::as<NewObjectSample>(obj);
+	ASObject* o=sys->sampler->getLiveObject(th->id,th->sampledObject);
+	if(o)
+		ret = asAtomHandler::fromObject(o);
+	else
+		asAtomHandler::setUndefined(ret);
+}
 
 StackFrame::StackFrame(Class_base* c):
-	ASObject(c)
+	ASObject(c),line(0),scriptID(0)
 {
 }
 
@@ -49,17 +90,34 @@ void StackFrame::sinit(Class_base* c)
 {
 	CLASS_SETUP_NO_CONSTRUCTOR(c, ASObject, CLASS_SEALED|CLASS_FINAL);
 	c->setDeclaredMethodByQName("toString","",Class<IFunction>::getFunction(c->getSystemState(),_toString),NORMAL_METHOD,true);
+	REGISTER_GETTER(c,name);
+	REGISTER_GETTER(c,file);
+	REGISTER_GETTER(c,line);
+	REGISTER_GETTER(c,scriptID);
 }
+ASFUNCTIONBODY_GETTER(StackFrame,name);
+ASFUNCTIONBODY_GETTER(StackFrame,file);
+ASFUNCTIONBODY_GETTER(StackFrame,line);
+ASFUNCTIONBODY_GETTER(StackFrame,scriptID);
+
 ASFUNCTIONBODY_ATOM(StackFrame,_toString)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.stackFrame.toString not implemented");
-	ret = asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY);
+	StackFrame* th=asAtomHandler::as<StackFrame>(obj);
+	tiny_string res=th->name+"()";
+	if(!th->file.empty())
+	{
+		res+="[";
+		res+=th->file;
+		res+=":";
+		res+=Integer::toString(th->line);
+		res+="]";
+	}
+	ret = asAtomHandler::fromString(sys,res);
 }
 
-
 ASFUNCTIONBODY_ATOM(lightspark,clearSamples)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.clearSamples not implemented");
+	sys->sampler->clearSamples();
 }
 ASFUNCTIONBODY_ATOM(lightspark,getGetterInvocationCount)
 {
@@ -110,21 +168,77 @@ ASFUNCTIONBODY_ATOM(lightspark,getMemberNames)
 }
 ASFUNCTIONBODY_ATOM(lightspark,getSampleCount)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.getSampleCount not implemented");
-	asAtomHandler::setInt(ret,sys,-1);
+	asAtomHandler::setNumber(ret,sys,sys->sampler->getSampleCount());
 }
 ASFUNCTIONBODY_ATOM(lightspark,getSamples)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.getSamples not implemented");
-	asAtomHandler::setUndefined(ret);
+	std::vector<Sampler::SampleData> samples;
+	std::unordered_map<uint32_t,std::vector<tiny_string>> stacks;
+	sys->sampler->getSamples(samples,stacks);
+	//The objects describing the samples are not samples themselves
+	SamplerSuspender suspender;
+	Array* res=Class<Array>::getInstanceSNoArgs(sys);
+	for(auto it=samples.begin();it!=samples.end();++it)
+	{
+		Sample* s;
+		if(it->sampleType==Sampler::NEW_OBJECT_SAMPLE)
+		{
+			NewObjectSample* n=Class<NewObjectSample>::getInstanceSNoArgs(sys);
+			n->id=it->id;
+			if(it->type)
+			{
+				it->type->incRef();
+				n->type=_MNR(it->type);
+			}
+			n->size=it->size;
+			n->sampledObject=it->object;
+			s=n;
+		}
+		else if(it->sampleType==Sampler::DELETE_OBJECT_SAMPLE)
+		{
+			DeleteObjectSample* d=Class<DeleteObjectSample>::getInstanceSNoArgs(sys);
+			d->id=it->id;
+			d->size=it->size;
+			s=d;
+		}
+		else
+			s=Class<Sample>::getInstanceSNoArgs(sys);
+		s->time=it->time;
+		if(it->stack)
+		{
+			//The innermost frame comes first
+			const std::vector<tiny_string>& names=stacks[it->stack];
+			Array* stack=Class<Array>::getInstanceSNoArgs(sys);
+			for(auto n=names.begin();n!=names.end();++n)
+			{
+				StackFrame* f=Class<StackFrame>::getInstanceSNoArgs(sys);
+				f->name=*n;
+				stack->push(asAtomHandler::fromObject(f));
+			}
+			s->stack=_MNR(stack);
+		}
+		res->push(asAtomHandler::fromObject(s));
+	}
+	ret = asAtomHandler::fromObject(res);
 }
 
 ASFUNCTIONBODY_ATOM(lightspark,getSize)
 {
-	_NR<ASObject> o;
-	ARG_UNPACK_ATOM (o);
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.getSize not implemented");
-	asAtomHandler::setInt(ret,sys,0);
+	number_t size=0;
+	if(argslen>0)
+	{
+		asAtom o=args[0];
+		if(asAtomHandler::isObject(o))
+			size=sys->sampler->getObjectSize(asAtomHandler::getObjectNoCheck(o));
+		else if(asAtomHandler::isNumber(o))
+			size=sizeof(number_t);
+		else
+			size=sizeof(asAtom);
+		//The characters are stored outside of the object
+		if(asAtomHandler::isString(o))
+			size+=asAtomHandler::toString(o,sys).numBytes();
+	}
+	asAtomHandler::setNumber(ret,sys,size);
 }
 ASFUNCTIONBODY_ATOM(lightspark,getSavedThis)
 {
@@ -143,13 +257,13 @@ ASFUNCTIONBODY_ATOM(lightspark,isGetterSetter)
 }
 ASFUNCTIONBODY_ATOM(lightspark,pauseSampling)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.pauseSampling not implemented");
+	sys->sampler->pauseSampling();
 }
 ASFUNCTIONBODY_ATOM(lightspark,sampleInternalAllocs)
 {
 	bool b;
 	ARG_UNPACK_ATOM (b);
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.sampleInternalAllocs not implemented");
+	sys->sampler->setInternalAllocs(b);
 }
 ASFUNCTIONBODY_ATOM(lightspark,setSamplerCallback)
 {
@@ -157,10 +271,10 @@ ASFUNCTIONBODY_ATOM(lightspark,setSamplerCallback)
 }
 ASFUNCTIONBODY_ATOM(lightspark,startSampling)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.startSampling not implemented");
+	sys->sampler->startSampling();
 }
 ASFUNCTIONBODY_ATOM(lightspark,stopSampling)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.stopSampling not implemented");
+	sys->sampler->stopSampling();
 }
 
@@ -30,6 +30,9 @@ class Sample : public ASObject
 public:
 	Sample(Class_base* c);
 	static void sinit(Class_base*);
+	bool destruct() override;
+	ASPROPERTY_GETTER(number_t,time);
+	ASPROPERTY_GETTER(_NR<Array>,stack);
 };
 
 class DeleteObjectSample : public Sample
@@ -37,20 +40,31 @@ class DeleteObjectSample : public Sample
 public:
 	DeleteObjectSample(Class_base* c);
 	static void sinit(Class_base*);
+	ASPROPERTY_GETTER(number_t,id);
+	ASPROPERTY_GETTER(number_t,size);
 };
 class NewObjectSample : public Sample
 {
 public:
 	NewObjectSample(Class_base* c);
 	static void sinit(Class_base*);
-	ASPROPERTY_GETTER(_NR<ASObject>,object);
+	bool destruct() override;
+	ASPROPERTY_GETTER(number_t,id);
+	ASPROPERTY_GETTER(_NR<ASObject>,type);
 	ASPROPERTY_GETTER(number_t,size);
+	// the object is only returned while the sampler reports it as alive
+	ASObject* sampledObject;
+	ASFUNCTION_ATOM(_getter_object);
 };
 class StackFrame : public ASObject
 {
 public:
 	StackFrame(Class_base* c);
 	static void sinit(Class_base*);
+	ASPROPERTY_GETTER(tiny_string,name);
+	ASPROPERTY_GETTER(tiny_string,file);
+	ASPROPERTY_GETTER(uint32_t,line);
+	ASPROPERTY_GETTER(number_t,scriptID);
 	ASFUNCTION_ATOM(_toString);
 };
 
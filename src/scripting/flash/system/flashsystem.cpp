@@ -711,6 +711,8 @@ void ASWorker::sinit(Class_base* c)
 void ASWorker::execute()
 {
 	setTLSWorker(this);
+	//Objects of this worker are allocated from its own arenas, released when the worker ends
+	SlabAllocatorScope allocatorScope;
 
 	streambuf *sbuf = new bytes_buf(swf->bytes,swf->getLength());
 	istream s(sbuf);
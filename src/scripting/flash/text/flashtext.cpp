@@ -1409,6 +1409,7 @@ IDrawable* TextField::invalidate(DisplayObject* target, const MATRIX& initialMat
 		fillstyleTextColor.FillStyleType=SOLID_FILL;
 		fillstyleTextColor.Color= RGBA(textColor.Red,textColor.Green,textColor.Blue,255);
 		embeddedfont->fillTextTokens(tokens,text,fontSize,fillstyleTextColor,leading,autosizeposition);
+		tokensChanged();
 		return TokenContainer::invalidate(target, totalMatrix,smoothing);
 	}
 	std::vector<IDrawable::MaskData> masks;
@@ -1445,7 +1446,7 @@ IDrawable* TextField::invalidate(DisplayObject* target, const MATRIX& initialMat
 		Width changes do not change the font size, and do nothing when autosize is on and wordwrap off.
 		Currently, the TextField is stretched in case of scaling.
 	*/
-	return new CairoPangoRenderer(*this,totalMatrix,
+	IDrawable* drawable = new CairoPangoRenderer(*this,totalMatrix,
 				x, y, width, height,
 				rx,ry,rwidth,rheight,rotation,
 				xscale,yscale,
@@ -1454,6 +1455,8 @@ IDrawable* TextField::invalidate(DisplayObject* target, const MATRIX& initialMat
 				1.0f,1.0f,1.0f,1.0f,
 				0.0f,0.0f,0.0f,0.0f,
 				smoothing,bxmin,bymin,caretIndex);
+	setupFilters(drawable,1.0f,1.0f);
+	return drawable;
 }
 
 bool TextField::renderImpl(RenderContext& ctxt) const
@@ -278,6 +278,8 @@ protected:
 	bool renderImpl(RenderContext& ctxt) const override
 		{ return TokenContainer::renderImpl(ctxt); }
 	_NR<DisplayObject> hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, HIT_TYPE type,bool interactiveObjectsOnly) override;
+	HIT_BOUNDS localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) override
+		{ return boundsRect(xmin,xmax,ymin,ymax) ? HIT_BOUNDS_RECT : HIT_BOUNDS_EMPTY; }
 public:
 	StaticText(Class_base* c) : DisplayObject(c),TokenContainer(this),tagID(UINT32_MAX) {}
 	StaticText(Class_base* c, const tokensVector& tokens,const RECT& b,uint32_t _tagID):
@@ -733,7 +733,7 @@ IDrawable* TextLine::invalidate(DisplayObject* target, const MATRIX& initialMatr
 		return nullptr;
 
 	float rotation = getConcatenatedMatrix().getRotation();
-	return new CairoPangoRenderer(*this, totalMatrix,
+	IDrawable* res = new CairoPangoRenderer(*this, totalMatrix,
 				x, y, width, height,
 				rx, ry, rwidth, rheight,rotation,
 				totalMatrix.getScaleX(),totalMatrix.getScaleY(),
@@ -742,6 +742,8 @@ IDrawable* TextLine::invalidate(DisplayObject* target, const MATRIX& initialMatr
 				1.0f,1.0f,1.0f,1.0f,
 				0.0f,0.0f,0.0f,0.0f,
 				smoothing,bxmin,bymin,0);
+	setupFilters(res,1.0f,1.0f);
+	return res;
 }
 
 bool TextLine::renderImpl(RenderContext& ctxt) const
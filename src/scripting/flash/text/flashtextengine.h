@@ -213,6 +213,8 @@ private:
 	IDrawable* invalidate(DisplayObject* target, const MATRIX& initialMatrix, bool smoothing) override;
 	bool renderImpl(RenderContext& ctxt) const override;
 	_NR<DisplayObject> hitTestImpl(_NR<DisplayObject> last, number_t x, number_t y, DisplayObject::HIT_TYPE type,bool interactiveObjectsOnly) override;
+	HIT_BOUNDS localHitBounds(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax) override
+		{ return HIT_BOUNDS_UNBOUNDED; }
 public:
 	TextLine(Class_base* c,tiny_string linetext = "", _NR<TextBlock> owner=NullRef);
 	static void sinit(Class_base* c);
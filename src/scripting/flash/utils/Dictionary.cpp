@@ -29,8 +29,9 @@
 using namespace std;
 using namespace lightspark;
 
-Dictionary::Dictionary(Class_base* c):ASObject(c),
-	data(std::less<dictType::key_type>(), reporter_allocator<dictType::value_type>(c->memoryAccount)),weakkeys(false)
+Dictionary::Dictionary(Class_base* c):ASObject(c,T_OBJECT,SUBTYPE_DICTIONARY),
+	entries(reporter_allocator<Entry>(c->memoryAccount)),slots(reporter_allocator<uint32_t>(c->memoryAccount)),
+	livecount(0),enumerationBase(0),enumerated(false),weakkeys(false)
 {
 }
 
@@ -55,16 +56,206 @@ ASFUNCTIONBODY_ATOM(Dictionary,_toJSON)
 	ret = asAtomHandler::fromString(sys,"Dictionary");
 }
 
-Dictionary::dictType::iterator Dictionary::findKey(ASObject *o)
+/*
+ * Reading a method binds a new function object every time, so bound functions are keyed by the
+ * code they run and their closure, like isEqualStrict compares them. Other objects are keyed by identity.
+ */
+static inline bool isBoundFunction(const ASObject* o)
 {
-	Dictionary::dictType::iterator it = data.begin();
-	for(; it!=data.end(); ++it)
+	return (o->is<SyntheticFunction>() || o->is<Function>()) && !static_cast<const IFunction*>(o)->closure_this.isNull();
+}
+
+static inline uint32_t hashKey(const ASObject* o)
+{
+	uintptr_t id=uintptr_t(o);
+	if(isBoundFunction(o))
+	{
+		const IFunction* f=static_cast<const IFunction*>(o);
+		//Builtin functions have no method_info, they only differ by the closure then
+		id=uintptr_t(f->getMethodInfo())*31+uintptr_t(f->closure_this.getPtr());
+	}
+	return (uint64_t(id)*UINT64_C(0x9E3779B97F4A7C15))>>32;
+}
+
+static inline bool keysEqual(ASObject* a, ASObject* b)
+{
+	if(a==b)
+		return true;
+	if(a==nullptr || !isBoundFunction(a) || !isBoundFunction(b))
+		return false;
+	return static_cast<IFunction*>(a)->closure_this==static_cast<IFunction*>(b)->closure_this && a->isEqualStrict(b);
+}
+
+uint32_t Dictionary::findEntry(ASObject* key) const
+{
+	if(slots.empty())
+		return UINT32_MAX;
+	uint32_t mask=slots.size()-1;
+	for(uint32_t i=hashKey(key)&mask;;i=(i+1)&mask)
+	{
+		uint32_t slot=slots[i];
+		if(slot==0)
+			return UINT32_MAX;
+		//Deleted entries keep their slot, their key never matches
+		if(keysEqual(entries[slot-1].key,key))
+			return slot-1;
+	}
+}
+
+void Dictionary::insertEntry(ASObject* key, asAtom& value)
+{
+	//At most half of the slots are used, so probing always reaches an empty slot
+	if((entries.size()+1)*2>slots.size())
+		rehash();
+	uint32_t mask=slots.size()-1;
+	uint32_t i=hashKey(key)&mask;
+	while(slots[i]!=0)
+		i=(i+1)&mask;
+	entries.push_back(Entry{key,value});
+	slots[i]=entries.size();
+	livecount++;
+}
+
+void Dictionary::eraseEntry(uint32_t index)
+{
+	Entry& e=entries[index];
+	ASObject* key=e.key;
+	asAtom value=e.value;
+	e.key=nullptr;
+	e.value=asAtomHandler::invalidAtom;
+	livecount--;
+	key->decRef();
+	ASATOM_DECREF(value);
+}
+
+void Dictionary::rehash()
+{
+	if(weakkeys)
+		purgeWeakKeys();
+	if(entries.size()-livecount>livecount)
+		compactEntries();
+	uint32_t capacity=16;
+	while(capacity<(entries.size()+1)*4)
+		capacity*=2;
+	slots.assign(capacity,0);
+	uint32_t mask=capacity-1;
+	for(uint32_t e=0;e<entries.size();e++)
+	{
+		if(entries[e].key==nullptr)
+			continue;
+		uint32_t i=hashKey(entries[e].key)&mask;
+		while(slots[i]!=0)
+			i=(i+1)&mask;
+		slots[i]=e+1;
+	}
+}
+
+void Dictionary::compactEntries()
+{
+	uint32_t oldsize=entries.size();
+	std::vector<uint32_t, reporter_allocator<uint32_t>> positions(oldsize+1,0,slots.get_allocator());
+	uint32_t live=0;
+	for(uint32_t i=0;i<oldsize;i++)
+	{
+		positions[i]=live;
+		if(entries[i].key)
+			entries[live++]=entries[i];
+	}
+	positions[oldsize]=live;
+	entries.resize(live);
+	//Indices from earlier compactions are translated to the current positions in one step
+	for(auto it=compactions.begin();it!=compactions.end();++it)
+	{
+		for(uint32_t& p : it->positions)
+			p=positions[p];
+	}
+	//Without enumerations since the last compaction no index of the old entries can be in use
+	if(enumerated)
+	{
+		compactions.push_back(Compaction{enumerationBase,std::move(positions)});
+		//Dictionaries enumerated every frame while their entries change would keep the whole history otherwise
+		if(compactions.size()>DICTIONARY_MAX_COMPACTIONS)
+			compactions.erase(compactions.begin());
+	}
+	enumerated=false;
+	enumerationBase+=oldsize;
+	if(enumerationBase+live>=DICTIONARY_FIRST_INDEX-1)
+	{
+		//Only happens after billions of deletions, enumerations running right now may end early
+		enumerationBase=0;
+		compactions.clear();
+	}
+}
+
+void Dictionary::purgeWeakKeys()
+{
+	for(uint32_t i=0;i<entries.size();i++)
+	{
+		if(entries[i].key && entries[i].key->isLastRef())
+			eraseEntry(i);
+	}
+}
+
+uint32_t Dictionary::nextPosition(uint32_t index) const
+{
+	uint32_t i=index-DICTIONARY_FIRST_INDEX;
+	if(i>enumerationBase)
+		return i-enumerationBase;
+	//The index was handed out before one or more compactions, their index ranges follow each other
+	for(auto it=compactions.rbegin();it!=compactions.rend();++it)
+	{
+		if(i>it->base)
+			return i-it->base<it->positions.size() ? it->positions[i-it->base] : entries.size();
+	}
+	//The compaction the index belongs to has been forgotten, the enumeration starts again
+	return 0;
+}
+
+Dictionary::Entry* Dictionary::getEntryAt(uint32_t index)
+{
+	uint32_t i=index-DICTIONARY_FIRST_INDEX;
+	if(i<=enumerationBase || i-enumerationBase>entries.size())
+		return nullptr;
+	Entry* e=&entries[i-enumerationBase-1];
+	return e->key ? e : nullptr;
+}
+
+void Dictionary::clearEntries()
+{
+	//The references are released after the table is emptied, as releasing them may access it
+	std::vector<Entry, reporter_allocator<Entry>> tmp(entries.get_allocator());
+	entries.swap(tmp);
+	std::vector<uint32_t, reporter_allocator<uint32_t>>(slots.get_allocator()).swap(slots);
+	compactions.clear();
+	livecount=0;
+	enumerationBase=0;
+	enumerated=false;
+	for(auto it=tmp.begin();it!=tmp.end();++it)
+	{
+		if(it->key==nullptr)
+			continue;
+		it->key->decRef();
+		ASATOM_DECREF(it->value);
+	}
+}
+
+void Dictionary::getReferencedObjects(std::vector<ASObject*>& refs)
+{
+	ASObject::getReferencedObjects(refs);
+	for(auto it=entries.begin();it!=entries.end();++it)
 	{
-		if (it->first->isEqualStrict(o))
-			return it;
+		if(it->key==nullptr)
+			continue;
+		refs.push_back(it->key);
+		if(asAtomHandler::isObject(it->value))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->value));
 	}
+}
 
-	return data.end();
+void Dictionary::unlinkReferencedObjects()
+{
+	clearEntries();
+	ASObject::unlinkReferencedObjects();
 }
 
 void Dictionary::setVariableByMultiname_i(multiname& name, int32_t value)
@@ -103,22 +294,23 @@ multiname *Dictionary::setVariableByMultiname(multiname& name, asAtom& o, CONST_
 			default:
 				break;
 		}
-		name.name_o->incRef();
-		_R<ASObject> name_o(name.name_o);
-
-		Dictionary::dictType::iterator it=findKey(name_o.getPtr());
-		if(it!=data.end())
+		uint32_t index=findEntry(name.name_o);
+		if(index!=UINT32_MAX)
 		{
-			if (alreadyset && it->second.uintval == o.uintval)
+			Entry& e=entries[index];
+			if (alreadyset && e.value.uintval == o.uintval)
 				*alreadyset=true;
 			else
 			{
-				ASATOM_DECREF(it->second);
-				it->second=o;
+				ASATOM_DECREF(e.value);
+				e.value=o;
 			}
 		}
 		else
-			data.insert(make_pair(name_o,o));
+		{
+			name.name_o->incRef();
+			insertEntry(name.name_o,o);
+		}
 	}
 	else
 	{
@@ -163,14 +355,10 @@ bool Dictionary::deleteVariableByMultiname(const multiname& name)
 			default:
 				break;
 		}
-		name.name_o->incRef();
-		_R<ASObject> name_o(name.name_o);
-
-		Dictionary::dictType::iterator it=findKey(name_o.getPtr());
-		if(it != data.end())
+		uint32_t index=findEntry(name.name_o);
+		if(index!=UINT32_MAX)
 		{
-			ASATOM_DECREF(it->second);
-			data.erase(it);
+			eraseEntry(index);
 			return true;
 		}
 		return false;
@@ -217,26 +405,13 @@ GET_VARIABLE_RESULT Dictionary::getVariableByMultiname(asAtom& ret, const multin
 				default:
 					break;
 			}
-			bool islastref = name.name_o->isLastRef();
-			name.name_o->incRef();
-			_R<ASObject> name_o(name.name_o);
-
-			Dictionary::dictType::iterator it=findKey(name_o.getPtr());
-			if(it != data.end())
+			uint32_t index=findEntry(name.name_o);
+			if(index!=UINT32_MAX)
 			{
-				ret = it->second;
-				if (islastref)
-				{
-					LOG(LOG_INFO,"erasing weak key from dictionary:"<< name.name_o->toDebugString());
-					name.name_o->decRef();
-					data.erase(it);
-				}
-				else
-					ASATOM_INCREF(ret);
-				return GET_VARIABLE_RESULT::GETVAR_NORMAL;
+				ret = entries[index].value;
+				ASATOM_INCREF(ret);
 			}
-			else
-				return GET_VARIABLE_RESULT::GETVAR_NORMAL;
+			return GET_VARIABLE_RESULT::GETVAR_NORMAL;
 		}
 		else
 		{
@@ -291,11 +466,7 @@ bool Dictionary::hasPropertyByMultiname(const multiname& name, bool considerDyna
 				break;
 		}
 
-		name.name_o->incRef();
-		_R<ASObject> name_o(name.name_o);
-
-		Dictionary::dictType::iterator it=findKey(name_o.getPtr());
-		return it != data.end();
+		return findEntry(name.name_o)!=UINT32_MAX;
 	}
 	else
 	{
@@ -312,68 +483,75 @@ bool Dictionary::hasPropertyByMultiname(const multiname& name, bool considerDyna
 uint32_t Dictionary::nextNameIndex(uint32_t cur_index)
 {
 	assert_and_throw(implEnable);
-	if(cur_index<data.size())
-		return cur_index+1;
-	else
+	uint32_t pos=0;
+	if(cur_index<DICTIONARY_FIRST_INDEX)
 	{
-		//Fall back on object properties
-		uint32_t ret=ASObject::nextNameIndex(cur_index-data.size());
-		if(ret==0)
-			return 0;
-		else
-			return ret+data.size();
-
+		if(cur_index==0 && weakkeys)
+			purgeWeakKeys();
+		//Primitive keys are enumerated first
+		uint32_t ret=ASObject::nextNameIndex(cur_index);
+		if(ret!=0)
+			return ret;
 	}
+	else
+		pos=nextPosition(cur_index);
+	while(pos<entries.size() && entries[pos].key==nullptr)
+		pos++;
+	if(pos>=entries.size())
+		return 0;
+	enumerated=true;
+	return DICTIONARY_FIRST_INDEX+enumerationBase+pos+1;
 }
 
 void Dictionary::nextName(asAtom& ret,uint32_t index)
 {
 	assert_and_throw(implEnable);
-	if(index<=data.size())
+	if(index<DICTIONARY_FIRST_INDEX)
 	{
-		auto it=data.begin();
-		for(unsigned int i=1;i<index;i++)
-			++it;
-		it->first->incRef();
-		ret = asAtomHandler::fromObject(it->first.getPtr());
+		ASObject::nextName(ret,index);
+		return;
 	}
-	else
+	Entry* e=getEntryAt(index);
+	if(e)
 	{
-		//Fall back on object properties
-		ASObject::nextName(ret,index-data.size());
+		e->key->incRef();
+		ret = asAtomHandler::fromObject(e->key);
 	}
+	else
+		asAtomHandler::setUndefined(ret);
 }
 
 void Dictionary::nextValue(asAtom& ret,uint32_t index)
 {
 	assert_and_throw(implEnable);
-	if(index<=data.size())
+	if(index<DICTIONARY_FIRST_INDEX)
 	{
-		auto it=data.begin();
-		for(unsigned int i=1;i<index;i++)
-			++it;
-
-		ASATOM_INCREF(it->second);
-		ret = it->second;
+		ASObject::nextValue(ret,index);
+		return;
 	}
-	else
+	Entry* e=getEntryAt(index);
+	if(e)
 	{
-		//Fall back on object properties
-		ASObject::nextValue(ret,index-data.size());
+		ASATOM_INCREF(e->value);
+		ret = e->value;
 	}
+	else
+		asAtomHandler::setUndefined(ret);
 }
 
 tiny_string Dictionary::toString()
 {
 	std::stringstream retstr;
 	retstr << "{";
-	auto it=data.begin();
-	while(it != data.end())
+	bool first=true;
+	for(auto it=entries.begin();it!=entries.end();++it)
 	{
-		if(it != data.begin())
+		if(it->key==nullptr)
+			continue;
+		if(!first)
 			retstr << ", ";
-		retstr << "{" << it->first->toString() << ", " << asAtomHandler::toString(it->second,getSystemState()) << "}";
-		++it;
+		first=false;
+		retstr << "{" << it->key->toString() << ", " << asAtomHandler::toString(it->value,getSystemState()) << "}";
 	}
 	retstr << "}";
 
@@ -405,10 +583,10 @@ void Dictionary::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stri
 		objMap.insert(make_pair(this, objMap.size()));
 
 		uint32_t count = 0;
-		uint32_t tmp;
-		while ((tmp = nextNameIndex(count)) != 0)
+		uint32_t tmp = 0;
+		while ((tmp = nextNameIndex(tmp)) != 0)
 		{
-			count = tmp;
+			count++;
 		}
 		assert_and_throw(count<0x20000000);
 		uint32_t value = (count << 1) | 1;
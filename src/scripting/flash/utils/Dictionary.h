@@ -27,28 +27,68 @@
 namespace lightspark
 {
 
+//Enumeration indices of the object keys start here, lower indices enumerate the primitive keys
+#define DICTIONARY_FIRST_INDEX 0x40000000
+//Compactions remembered for running enumerations, older enumerations restart from the first object key
+#define DICTIONARY_MAX_COMPACTIONS 8
+
+/*
+ * Primitive keys are stored by value as dynamic properties, object keys by identity in an
+ * open addressing hash table. The entries are kept in insertion order and deleted entries stay
+ * in place until the table is compacted, enumeration indices are positions in the entries.
+ * Indices handed out before the last DICTIONARY_MAX_COMPACTIONS compactions are translated, so for..in
+ * loops visit every key once even when the table changes while it is enumerated.
+ * Weak keys are only referenced by the dictionary once their entries are dropped, which happens
+ * before the table grows and when an enumeration starts.
+ */
 class Dictionary: public ASObject
 {
 friend class ABCVm;
 private:
-	typedef std::map<_R<ASObject>,asAtom,std::less<_R<ASObject>>,
-	       reporter_allocator<std::pair<const _R<ASObject>, asAtom>>> dictType;
-	dictType data;
-	dictType::iterator findKey(ASObject *);
+	struct Entry
+	{
+		// nullptr for deleted entries
+		ASObject* key;
+		asAtom value;
+	};
+	std::vector<Entry, reporter_allocator<Entry>> entries;
+	// index of the entry + 1 for every slot, 0 for empty slots, the size is a power of 2
+	std::vector<uint32_t, reporter_allocator<uint32_t>> slots;
+	uint32_t livecount;
+	struct Compaction
+	{
+		// enumeration indices of the entries before this compaction started after this value
+		uint32_t base;
+		// current position for every position of the entries before this compaction
+		std::vector<uint32_t, reporter_allocator<uint32_t>> positions;
+	};
+	// enumeration indices of the current entries start after this value
+	uint32_t enumerationBase;
+	// compactions after which indices of the entries before them may still be in use, oldest first
+	std::vector<Compaction> compactions;
+	// an enumeration index of the current entries has been handed out
+	bool enumerated;
 	bool weakkeys;
+	uint32_t findEntry(ASObject* key) const;
+	void insertEntry(ASObject* key, asAtom& value);
+	void eraseEntry(uint32_t index);
+	void rehash();
+	void compactEntries();
+	// drops the entries whose key is only referenced by the dictionary
+	void purgeWeakKeys();
+	// position of the first entry to examine after the entry at index
+	uint32_t nextPosition(uint32_t index) const;
+	Entry* getEntryAt(uint32_t index);
+	void clearEntries();
 public:
 	Dictionary(Class_base* c);
 	bool destruct()
 	{
-		Dictionary::dictType::iterator it = data.begin();
-		while(it!=data.end())
-		{
-			ASATOM_DECREF(it->second);
-			it++;
-		}
-		data.clear();
+		clearEntries();
 		return destructIntern();
 	}
+	void getReferencedObjects(std::vector<ASObject*>& refs) override;
+	void unlinkReferencedObjects() override;
 	
 	static void sinit(Class_base*);
 	static void buildTraits(ASObject* o);
@@ -271,7 +271,7 @@ ASFUNCTIONBODY_ATOM(lightspark,describeTypeJSON)
 
 ASFUNCTIONBODY_ATOM(lightspark,getTimer)
 {
-	uint64_t res=compat_msectiming() - sys->startTime;
+	uint64_t res=EngineClock::getTime() - sys->startTime;
 	asAtomHandler::setInt(ret,sys,(int32_t)res);
 }
 
@@ -29,20 +29,20 @@
 using namespace std;
 using namespace lightspark;
 
-ASString::ASString(Class_base* c):ASObject(c,T_STRING),currentindex(0),hasId(true),datafilled(true)
+ASString::ASString(Class_base* c):ASObject(c,T_STRING),currentindex(0),builderBytes(0),builderChars(0),hasId(true),datafilled(true)
 {
 	stringId = BUILTIN_STRINGS::EMPTY;
 }
 
-ASString::ASString(Class_base* c,const string& s) : ASObject(c,T_STRING),data(s),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const string& s) : ASObject(c,T_STRING),data(s),currentindex(0),builderBytes(0),builderChars(0),hasId(false),datafilled(true)
 {
 }
 
-ASString::ASString(Class_base* c,const tiny_string& s) : ASObject(c,T_STRING),data(s),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const tiny_string& s) : ASObject(c,T_STRING),data(s),currentindex(0),builderBytes(0),builderChars(0),hasId(false),datafilled(true)
 {
 }
 
-ASString::ASString(Class_base* c,const char* s) : ASObject(c,T_STRING),data(s, /*copy:*/true),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const char* s) : ASObject(c,T_STRING),data(s, /*copy:*/true),currentindex(0),builderBytes(0),builderChars(0),hasId(false),datafilled(true)
 {
 }
 
@@ -52,6 +52,60 @@ ASString::ASString(Class_base* c,const char* s, uint32_t len) : ASObject(c,T_STR
 	hasId = false;
 	datafilled=true;
 	currentindex=0;
+	builderBytes=0;
+	builderChars=0;
+}
+
+bool ASStringBuilder::append(uint32_t len, const tiny_string& s)
+{
+	Locker l(mutex);
+	if(buf.numBytes()!=len)
+		return false;
+	buf+=s;
+	return true;
+}
+
+tiny_string ASStringBuilder::getPrefix(uint32_t len)
+{
+	Locker l(mutex);
+	return buf.substr_bytes(0,len);
+}
+
+void ASString::flatten()
+{
+	data = builder->getPrefix(builderBytes);
+	builder.reset();
+	builderBytes=0;
+	builderChars=0;
+}
+
+ASString* ASString::concatString(const tiny_string& s)
+{
+	ASString* ret=Class<ASString>::getInstanceSNoArgs(getSystemState());
+	ret->stringId = UINT32_MAX;
+	ret->hasId = false;
+	if(!builder.isNull() && builder->append(builderBytes,s))
+	{
+		//This string was the end of the builder, the new one takes its place
+		ret->builder = builder;
+		ret->builderBytes = builderBytes+s.numBytes();
+		ret->builderChars = builderChars+s.numChars();
+		ret->datafilled = false;
+		return ret;
+	}
+	const tiny_string& d=getData();
+	if(d.numBytes()+s.numBytes() < ASSTRING_BUILDER_MIN_SIZE)
+	{
+		ret->data = d+s;
+		ret->datafilled = true;
+		return ret;
+	}
+	ret->builder = _MR(new ASStringBuilder(d));
+	ret->builder->append(d.numBytes(),s);
+	ret->builderBytes = d.numBytes()+s.numBytes();
+	ret->builderChars = d.numChars()+s.numChars();
+	ret->datafilled = false;
+	return ret;
 }
 
 ASFUNCTIONBODY_ATOM(ASString,_constructor)
@@ -76,7 +130,7 @@ ASFUNCTIONBODY_ATOM(ASString,_getLength)
 	else if (asAtomHandler::isString(obj))
 	{
 		ASString* th = asAtomHandler::getObjectNoCheck(obj)->as<ASString>();
-		asAtomHandler::setInt(ret,sys,int32_t(th->getData().numChars()));
+		asAtomHandler::setInt(ret,sys,int32_t(th->getNumChars()));
 	}
 	else
 	{
@@ -169,33 +223,20 @@ ASFUNCTIONBODY_ATOM(ASString,search)
 		restr = asAtomHandler::toString(args[0],sys);
 	}
 
-	const char* error;
-	int errorOffset;
-	pcre* pcreRE=pcre_compile(restr.raw_buf(), options, &error, &errorOffset,NULL);
-	if(error)
+	_NR<CompiledRegExp> pcreRE=RegExp::getCompiledPattern(restr, options);
+	if(pcreRE.isNull() || pcreRE->capturingGroups < 0)
 	{
 		asAtomHandler::setInt(ret,sys,res);
 		return;
 	}
-	int capturingGroups;
-	int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		asAtomHandler::setInt(ret,sys,res);
-		return;
-	}
-	pcre_extra extra;
-	extra.match_limit_recursion=200;
-	extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+	int capturingGroups=pcreRE->capturingGroups;
 	int ovector[(capturingGroups+1)*3];
 	int offset=0;
 	//Global is not used in search
-	int rc=pcre_exec(pcreRE, &extra, data.raw_buf(), data.numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+	int rc=pcreRE->exec(data, offset, ovector, (capturingGroups+1)*3);
 	if(rc<0)
 	{
 		//No matches or error
-		pcre_free(pcreRE);
 		asAtomHandler::setInt(ret,sys,res);
 		return;
 	}
@@ -323,23 +364,13 @@ ASFUNCTIONBODY_ATOM(ASString,split)
 			return;
 		}
 
-		pcre* pcreRE = re->compile();
-		if (!pcreRE)
-		{
-			ret = asAtomHandler::fromObject(res);
-			return;
-		}
-		int capturingGroups;
-		int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-		if(infoOk!=0)
+		_NR<CompiledRegExp> pcreRE = re->compile();
+		if (pcreRE.isNull() || pcreRE->capturingGroups < 0)
 		{
-			pcre_free(pcreRE);
 			ret = asAtomHandler::fromObject(res);
 			return;
 		}
-		pcre_extra extra;
-		extra.match_limit_recursion=200;
-		extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+		int capturingGroups=pcreRE->capturingGroups;
 		int ovector[(capturingGroups+1)*3];
 		int offset=0;
 		unsigned int end;
@@ -347,7 +378,7 @@ ASFUNCTIONBODY_ATOM(ASString,split)
 		do
 		{
 			//offset is a byte offset that must point to the beginning of an utf8 character
-			int rc=pcre_exec(pcreRE, &extra, data.raw_buf(), data.numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+			int rc=pcreRE->exec(data, offset, ovector, (capturingGroups+1)*3);
 			end=ovector[0];
 			if(rc<0)
 				break;
@@ -379,7 +410,6 @@ ASFUNCTIONBODY_ATOM(ASString,split)
 			ASObject* s=abstract_s(sys,data.substr_bytes(lastMatch,data.numBytes()-lastMatch));
 			res->push(asAtomHandler::fromObject(s));
 		}
-		pcre_free(pcreRE);
 	}
 	else
 	{
@@ -952,24 +982,14 @@ ASFUNCTIONBODY_ATOM(ASString,replace)
 	{
 		RegExp* re=asAtomHandler::as<RegExp>(args[0]);
 
-		pcre* pcreRE = re->compile();
-		if (!pcreRE)
+		_NR<CompiledRegExp> pcreRE = re->compile();
+		if (pcreRE.isNull() || pcreRE->capturingGroups < 0)
 		{
 			ret = asAtomHandler::fromObject(res);
 			return;
 		}
 
-		int capturingGroups;
-		int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-		if(infoOk!=0)
-		{
-			pcre_free(pcreRE);
-			ret = asAtomHandler::fromObject(res);
-			return;
-		}
-		pcre_extra extra;
-		extra.match_limit_recursion=200;
-		extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+		int capturingGroups=pcreRE->capturingGroups;
 		int ovector[(capturingGroups+1)*3];
 		int offset=0;
 		int retDiff=0;
@@ -977,11 +997,10 @@ ASFUNCTIONBODY_ATOM(ASString,replace)
 		do
 		{
 			tiny_string replaceWithTmp = replaceWith;
-			int rc=pcre_exec(pcreRE, &extra, res->getData().raw_buf(), res->getData().numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+			int rc=pcreRE->exec(res->getData(), offset, ovector, (capturingGroups+1)*3);
 			if(rc<0)
 			{
 				//No matches or error
-				pcre_free(pcreRE);
 				ret = asAtomHandler::fromObject(res);
 				return;
 			}
@@ -1055,8 +1074,6 @@ ASFUNCTIONBODY_ATOM(ASString,replace)
 			retDiff+=replaceWithTmp.numBytes()-(ovector[1]-ovector[0]);
 		}
 		while(re->global);
-
-		pcre_free(pcreRE);
 	}
 	else
 	{
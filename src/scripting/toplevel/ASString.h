@@ -26,6 +26,27 @@ namespace Glib { class ustring; }
 
 namespace lightspark
 {
+//Strings shorter than this are concatenated by copying
+#define ASSTRING_BUILDER_MIN_SIZE 256
+
+/*
+ * Append buffer shared by the strings created by repeated concatenation.
+ * Every string backed by the builder is a prefix of the buffer. Only the string
+ * ending at the current end of the buffer may append to it, so the prefixes
+ * seen by the other strings never change.
+ */
+class ASStringBuilder: public RefCountable
+{
+private:
+	Mutex mutex;
+	tiny_string buf;
+public:
+	ASStringBuilder(const tiny_string& s):buf(s) {}
+	/* appends s if the buffer is exactly len bytes long, returns false otherwise */
+	bool append(uint32_t len, const tiny_string& s);
+	tiny_string getPrefix(uint32_t len);
+};
+
 /*
  * The AS String class.
  * The 'data' is immutable -> it cannot be changed after creation of the object
@@ -45,6 +66,11 @@ private:
 	// speeds up iterating over all chars in the string
 	CharIterator currentpos;
 	uint32_t currentindex;
+	// the data of strings built by concatenation is kept in the builder until it is needed
+	_NR<ASStringBuilder> builder;
+	uint32_t builderBytes;
+	uint32_t builderChars;
+	void flatten();
 public:
 	ASString(Class_base* c);
 	ASString(Class_base* c, const std::string& s);
@@ -58,13 +84,24 @@ public:
 	{
 		if (!datafilled)
 		{
-			data = getSystemState()->getStringFromUniqueId(stringId);
+			if (builder.isNull())
+				data = getSystemState()->getStringFromUniqueId(stringId);
+			else
+				flatten();
 			datafilled = true;
 		}
 		return data;
 	}
+	FORCE_INLINE uint32_t getNumChars()
+	{
+		if (!datafilled && !builder.isNull())
+			return builderChars;
+		return getData().numChars();
+	}
 	FORCE_INLINE bool isEmpty() const
 	{
+		if (!builder.isNull())
+			return builderBytes == 0;
 		if (hasId)
 			return stringId == BUILTIN_STRINGS::EMPTY || stringId == UINT32_MAX;
 		return data.empty();
@@ -92,6 +129,11 @@ public:
 	ASFUNCTION_ATOM(_getLength);
 	ASFUNCTION_ATOM(localeCompare);
 	ASFUNCTION_ATOM(localeCompare_prototype);
+	/*
+	 * returns a new string containing this string followed by s,
+	 * long strings are appended to a builder in amortized constant time
+	 */
+	ASString* concatString(const tiny_string& s);
 	bool isEqual(ASObject* r);
 	TRISTATE isLess(ASObject* r);
 	TRISTATE isLessAtom(asAtom& r);
@@ -112,6 +154,9 @@ public:
 	inline bool destruct() 
 	{ 
 		data.clear(); 
+		builder.reset();
+		builderBytes=0;
+		builderChars=0;
 		hasId = false;
 		datafilled=false; 
 		if (!destructIntern())
@@ -20,6 +20,7 @@
 #include "scripting/toplevel/Array.h"
 #include "scripting/abc.h"
 #include "scripting/argconv.h"
+#include "scripting/toplevel/JSON.h"
 #include "parsing/amf3_generator.h"
 #include "scripting/toplevel/Vector.h"
 #include "scripting/toplevel/RegExp.h"
@@ -34,6 +35,27 @@ Array::Array(Class_base* c):ASObject(c,T_ARRAY),currentsize(0)
 }
 
 bool Array::destruct()
+{
+	unlinkReferencedObjects();
+	return destructIntern();
+}
+
+void Array::getReferencedObjects(std::vector<ASObject*>& refs)
+{
+	ASObject::getReferencedObjects(refs);
+	for (auto it=data_first.begin() ; it != data_first.end(); ++it)
+	{
+		if (asAtomHandler::isObject(*it))
+			refs.push_back(asAtomHandler::getObjectNoCheck(*it));
+	}
+	for (auto it=data_second.begin() ; it != data_second.end(); ++it)
+	{
+		if (asAtomHandler::isObject(it->second))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->second));
+	}
+}
+
+void Array::unlinkReferencedObjects()
 {
 	for (auto it=data_first.begin() ; it != data_first.end(); ++it)
 	{
@@ -46,7 +68,7 @@ bool Array::destruct()
 	data_first.clear();
 	data_second.clear();
 	currentsize=0;
-	return destructIntern();
+	ASObject::unlinkReferencedObjects();
 }
 
 void Array::sinit(Class_base* c)
@@ -2064,70 +2086,33 @@ void Array::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap
 	}
 }
 
-tiny_string Array::toJSON(std::vector<ASObject *> &path, asAtom replacer, const tiny_string& spaces,const tiny_string& filter)
+void Array::toJSON(JSONStringifier& s, const tiny_string& indent)
 {
-	bool ok;
-	tiny_string res = call_toJSON(ok,path,replacer,spaces,filter);
-	if (ok)
-		return res;
-	// check for cylic reference
-	if (std::find(path.begin(),path.end(), this) != path.end())
-		throwError<TypeError>(kJSONCyclicStructure);
-	
-	path.push_back(this);
-	res += "[";
-	bool bfirst = true;
-	tiny_string newline = (spaces.empty() ? "" : "\n");
-	uint32_t denseCount = currentsize;
-	asAtom closure = asAtomHandler::isValid(replacer) && asAtomHandler::getClosure(replacer) ? asAtomHandler::fromObject(asAtomHandler::getClosure(replacer)) : asAtomHandler::nullAtom;
-	
-	for (uint32_t i=0 ; i < denseCount; i++)
+	tiny_string inner = s.getGap().empty() ? indent : indent+s.getGap();
+	s.out += '[';
+	for (uint32_t i=0 ; i < currentsize; i++)
 	{
 		asAtom a=asAtomHandler::invalidAtom;
 		if ( i < ARRAY_SIZE_THRESHOLD)
-			a = data_first.at(i);
+		{
+			if (i < data_first.size())
+				a = data_first[i];
+		}
 		else
 		{
 			auto it = data_second.find(i);
 			if (it != data_second.end())
 				a = it->second;
 		}
-		tiny_string subres;
-		if (asAtomHandler::isValid(replacer) && asAtomHandler::isValid(a))
-		{
-			asAtom params[2];
-			
-			params[0] = asAtomHandler::fromUInt(i);
-			params[1] = a;
-			asAtom funcret=asAtomHandler::invalidAtom;
-			asAtomHandler::callFunction(replacer,funcret,closure, params, 2,false);
-			if (asAtomHandler::isValid(funcret))
-				subres = asAtomHandler::toObject(funcret,getSystemState())->toJSON(path,asAtomHandler::invalidAtom,spaces,filter);
-		}
-		else
-		{
-			ASObject* o = asAtomHandler::isInvalid(a) ? getSystemState()->getNullRef() : asAtomHandler::toObject(a,getSystemState());
-			if (o)
-				subres = o->toJSON(path,replacer,spaces,filter);
-			else
-				continue;
-		}
-		if (!subres.empty())
-		{
-			if (!bfirst)
-				res += ",";
-			res += newline+spaces;
-			
-			bfirst = false;
-			res += subres;
-		}
+		if (i > 0)
+			s.out += ',';
+		s.writeNewline(inner);
+		if (!s.writeProperty(this,asAtomHandler::fromUInt(i),a,inner))
+			s.out += "null";
 	}
-	if (!bfirst)
-		res += newline+spaces.substr_bytes(0,spaces.numBytes()/2);
-	res += "]";
-	path.pop_back();
-	return res;
-	
+	if (currentsize > 0)
+		s.writeNewline(indent);
+	s.out += ']';
 }
 
 Array::~Array()
@@ -19,6 +19,9 @@
 
 #include "scripting/argconv.h"
 #include "scripting/toplevel/JSON.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 using namespace lightspark;
@@ -48,757 +51,858 @@ ASFUNCTIONBODY_ATOM(JSON,generator)
 	ret = asAtomHandler::invalidAtom;
 }
 
-ASObject *JSON::doParse(const tiny_string &jsonstring, asAtom reviver)
+/*
+ * JSON.parse works in two stages. The first stage finds the offsets of all quotes, structural
+ * characters and starts of scalars outside of strings, 64 bytes at a time. The second stage
+ * builds the tree by walking this index, it only looks at the bytes of strings and scalars.
+ */
+struct JSONBlockMasks
 {
-	ASObject* res = NULL;
-	multiname dummy(NULL);
-	
-	parseAll(jsonstring,&res,dummy,reviver);
-	return res;
-}
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t op;
+	uint64_t space;
+};
 
-ASFUNCTIONBODY_ATOM(JSON,_parse)
+static inline void classifyBlock(const char* p, JSONBlockMasks& m)
 {
-	tiny_string text;
-	asAtom reviver=asAtomHandler::invalidAtom;
-
-	if (argslen > 0 && (asAtomHandler::is<Null>(args[0]) ||asAtomHandler::is<Undefined>(args[0])))
-		throwError<SyntaxError>(kJSONInvalidParseInput);
-	ARG_UNPACK_ATOM_MORE_ALLOWED(text);
-	if (argslen > 1)
+#ifdef __SSE2__
+	m.quote=m.backslash=m.op=m.space=0;
+	for (int i = 0; i < 4; i++)
 	{
-		if (!asAtomHandler::is<IFunction>(args[1]))
-			throwError<TypeError>(kCheckTypeFailedError);
-		reviver = args[1];
+		__m128i v = _mm_loadu_si128((const __m128i*)(p+i*16));
+		// '[' and ']' only differ from '{' and '}' in bit 5
+		__m128i lower = _mm_or_si128(v,_mm_set1_epi8(0x20));
+		__m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lower,_mm_set1_epi8('{')),_mm_cmpeq_epi8(lower,_mm_set1_epi8('}'))),
+					  _mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8(':')),_mm_cmpeq_epi8(v,_mm_set1_epi8(','))));
+		__m128i space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8(' ')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\t'))),
+					     _mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8('\n')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\r'))));
+		m.quote |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v,_mm_set1_epi8('"')))))<<(i*16);
+		m.backslash |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v,_mm_set1_epi8('\\')))))<<(i*16);
+		m.op |= uint64_t(uint32_t(_mm_movemask_epi8(op)))<<(i*16);
+		m.space |= uint64_t(uint32_t(_mm_movemask_epi8(space)))<<(i*16);
 	}
-	ASObject* res = doParse(text,reviver);
-	if (!res)
-		throwError<TypeError>(kJSONInvalidParseInput);
-	ret = asAtomHandler::fromObject(res);
-}
-
-ASFUNCTIONBODY_ATOM(JSON,_stringify)
-{
-	_NR<ASObject> value;
-	ARG_UNPACK_ATOM_MORE_ALLOWED(value);
-	std::vector<ASObject *> path;
-	tiny_string filter;
-	asAtom replacer=asAtomHandler::invalidAtom;
-	if (argslen > 1 && !asAtomHandler::isNull(args[1]) && !asAtomHandler::isUndefined(args[1]))
+#else
+	m.quote=m.backslash=m.op=m.space=0;
+	for (int i = 0; i < 64; i++)
 	{
-		if (asAtomHandler::isFunction(args[1]))
+		uint64_t bit = uint64_t(1)<<i;
+		switch (p[i])
 		{
-			replacer = args[1];
+			case '"': m.quote |= bit; break;
+			case '\\': m.backslash |= bit; break;
+			case '{': case '}': case '[': case ']': case ':': case ',': m.op |= bit; break;
+			case ' ': case '\t': case '\n': case '\r': m.space |= bit; break;
+			default: break;
 		}
-		else if (asAtomHandler::isArray(args[1]))
-		{
-			filter = " ";
-			Array* ar = asAtomHandler::as<Array>(args[1]);
-			for (uint64_t i = 0; i < ar->size(); i++)
-			{
-				asAtom a = ar->at(i);
-				filter += asAtomHandler::toString(a,sys);
-				filter += " ";
-			}
-		}
-		else
-			throwError<TypeError>(kJSONInvalidReplacer);
 	}
+#endif
+}
 
-	tiny_string spaces = "";
-	if (argslen > 2)
+// sets every bit that has an odd number of set bits at or below its position
+static inline uint64_t prefixXor(uint64_t x)
+{
+	x ^= x<<1;
+	x ^= x<<2;
+	x ^= x<<4;
+	x ^= x<<8;
+	x ^= x<<16;
+	x ^= x<<32;
+	return x;
+}
+
+// returns false if a string is not terminated
+static bool buildStructuralIndex(const char* buf, uint32_t len, std::vector<uint32_t>& index)
+{
+	index.reserve(len/4+8);
+	// the last byte of the previous block escapes the first one
+	bool escapeCarry = false;
+	// all bits set if the previous block ended inside a string
+	uint64_t inStringCarry = 0;
+	// set if the previous block ended with a scalar
+	uint64_t scalarCarry = 0;
+	char tail[64];
+	for (uint32_t base = 0; base < len; base += 64)
 	{
-		asAtom space = args[2];
-		spaces = "          ";
-		if (asAtomHandler::is<Number>(space) || asAtomHandler::is<Integer>(space) || asAtomHandler::is<UInteger>(space))
+		const char* p = buf+base;
+		if (len-base < 64)
 		{
-			int32_t v = asAtomHandler::toInt(space);
-			if (v < 0) v = 0;
-			if (v > 10) v = 10;
-			spaces = spaces.substr_bytes(0,v);
+			memset(tail,' ',64);
+			memcpy(tail,p,len-base);
+			p = tail;
 		}
-		else if (asAtomHandler::is<Boolean>(space) || asAtomHandler::is<Null>(space))
+		JSONBlockMasks m;
+		classifyBlock(p,m);
+
+		// a backslash escapes the next byte, which can't escape anything itself
+		uint64_t escaped = 0;
+		uint64_t backslash = m.backslash;
+		if (escapeCarry)
 		{
-			spaces = "";
+			escaped = 1;
+			backslash &= ~uint64_t(1);
 		}
-		else
+		escapeCarry = false;
+		while (backslash)
 		{
-			if(asAtomHandler::getObject(space) && asAtomHandler::getObject(space)->has_toString())
+			int i = __builtin_ctzll(backslash);
+			if (i == 63)
 			{
-				asAtom ret=asAtomHandler::invalidAtom;
-				asAtomHandler::getObject(space)->call_toString(ret);
-				spaces = asAtomHandler::toString(ret,sys);
+				escapeCarry = true;
+				break;
 			}
-			else
-				spaces = asAtomHandler::toString(space,sys);
-			if (spaces.numBytes() > 10)
-				spaces = spaces.substr_bytes(0,10);
+			escaped |= uint64_t(2)<<i;
+			backslash &= ~(uint64_t(3)<<i);
+		}
+		uint64_t quotes = m.quote & ~escaped;
+		// bits of opening quotes and string contents, closing quotes are not included
+		uint64_t inString = prefixXor(quotes) ^ inStringCarry;
+		inStringCarry = uint64_t(int64_t(inString)>>63);
+		uint64_t scalar = ~(m.op | m.space | quotes | inString);
+		uint64_t scalarStart = scalar & ~((scalar<<1) | scalarCarry);
+		scalarCarry = scalar>>63;
+
+		uint64_t structural = (m.op & ~inString) | quotes | scalarStart;
+		while (structural)
+		{
+			index.push_back(base+__builtin_ctzll(structural));
+			structural &= structural-1;
 		}
 	}
-	tiny_string res = value->toJSON(path,replacer,spaces,filter);
+	return inStringCarry == 0;
+}
 
-	ret = asAtomHandler::fromObject(abstract_s(sys,res));
+class JSONTreeBuilder
+{
+private:
+	struct Frame
+	{
+		ASObject* container;
+		// name of the member being parsed
+		uint32_t key;
+		bool isArray;
+	};
+	SystemState* sys;
+	const char* buf;
+	uint32_t len;
+	const std::vector<uint32_t>& index;
+	uint32_t next;
+	std::vector<Frame> stack;
+	std::string scratch;
+	multiname name;
+	void attach(asAtom v, asAtom& result);
+	bool decodeString(uint32_t start, uint32_t end);
+	bool parseScalar(uint32_t pos, asAtom& v);
+	bool parseNumber(const char*& p, asAtom& v);
+	char peek() const { return next < index.size() ? buf[index[next]] : 0; }
+public:
+	JSONTreeBuilder(SystemState* s, const char* b, uint32_t l, const std::vector<uint32_t>& i)
+		:sys(s),buf(b),len(l),index(i),next(0),name(nullptr)
+	{
+		name.name_type=multiname::NAME_STRING;
+		name.ns.push_back(nsNameAndKind(sys,"",NAMESPACE));
+		name.isAttribute = false;
+	}
+	/*
+	 * Builds the tree, result is set as soon as the root value is created.
+	 * Returns false if the text is not valid JSON, result then holds the partial tree.
+	 */
+	bool build(asAtom& result);
+};
+
+void JSONTreeBuilder::attach(asAtom v, asAtom& result)
+{
+	if (stack.empty())
+	{
+		result = v;
+		return;
+	}
+	Frame& f = stack.back();
+	if (f.isArray)
+	{
+		f.container->as<Array>()->push(v);
+		ASATOM_DECREF(v);
+	}
+	else
+	{
+		name.name_s_id = f.key;
+		f.container->setVariableByMultiname(name,v,ASObject::CONST_NOT_ALLOWED);
+	}
 }
-void JSON::parseAll(const tiny_string &jsonstring, ASObject** parent , multiname& key, asAtom reviver)
+
+static inline int hexValue(char c)
 {
-	int len = jsonstring.numChars();
-	int pos = 0;
-	while (pos < len)
+	if (c >= '0' && c <= '9')
+		return c-'0';
+	if (c >= 'a' && c <= 'f')
+		return c-'a'+10;
+	if (c >= 'A' && c <= 'F')
+		return c-'A'+10;
+	return -1;
+}
+
+static inline int32_t parseHex4(const char* p, const char* end)
+{
+	if (end-p < 4)
+		return -1;
+	int32_t res = 0;
+	for (int i = 0; i < 4; i++)
 	{
-		if (*parent && (*parent)->isPrimitive())
-			throwError<SyntaxError>(kJSONInvalidParseInput);
-		pos = parse(jsonstring, pos, parent , key, reviver);
-		while (jsonstring.charAt(pos) == ' ' ||
-			   jsonstring.charAt(pos) == '\t' ||
-			   jsonstring.charAt(pos) == '\n' ||
-			   jsonstring.charAt(pos) == '\r'
-			   )
-			pos++;
+		int d = hexValue(p[i]);
+		if (d < 0)
+			return -1;
+		res = (res<<4) | d;
 	}
+	return res;
 }
-int JSON::parse(const tiny_string &jsonstring, int pos, ASObject** parent , multiname& key, asAtom reviver)
+
+// decodes the string contents between the quotes at start-1 and end into scratch
+bool JSONTreeBuilder::decodeString(uint32_t start, uint32_t end)
 {
-	while (jsonstring.charAt(pos) == ' ' ||
-		   jsonstring.charAt(pos) == '\t' ||
-		   jsonstring.charAt(pos) == '\n' ||
-		   jsonstring.charAt(pos) == '\r'
-		   )
-		   pos++;
-	int len = jsonstring.numChars();
-	if (pos < len)
-	{
-		char c = jsonstring.charAt(pos);
-		switch(c)
-		{
-			case '{':
-				pos = parseObject(jsonstring,pos,parent,key, reviver);
-				break;
-			case '[': 
-				pos = parseArray(jsonstring,pos,parent,key, reviver);
-				break;
-			case '"':
-				pos = parseString(jsonstring,pos,parent,key);
-				break;
-			case '0':
-			case '1':
-			case '2':
-			case '3':
-			case '4':
-			case '5':
-			case '6':
-			case '7':
-			case '8':
-			case '9':
-			case '-':
-				pos = parseNumber(jsonstring,pos,parent,key);
-				break;
-			case 't':
-				pos = parseTrue(jsonstring,pos,parent,key);
-				break;
-			case 'f':
-				pos = parseFalse(jsonstring,pos,parent,key);
-				break;
-			case 'n':
-				pos = parseNull(jsonstring,pos,parent,key);
-				break;
-			default:
-				throwError<SyntaxError>(kJSONInvalidParseInput);
-		}
+	const char* p = buf+start;
+	const char* stop = buf+end;
+	const char* plain = p;
+	while (plain < stop && *plain != '\\')
+	{
+		if (uint8_t(*plain) < 0x20)
+			return false;
+		plain++;
 	}
-	if (asAtomHandler::isValid(reviver))
+	scratch.assign(p,plain-p);
+	p = plain;
+	while (p < stop)
 	{
-		bool haskey = key.name_type!= multiname::NAME_OBJECT;
-		asAtom params[2];
-		
-		if (haskey)
-		{
-			params[0] = asAtomHandler::fromObject(abstract_s(getSys(),key.normalizedName(getSys())));
-			if ((*parent)->hasPropertyByMultiname(key,true,false))
-			{
-				(*parent)->getVariableByMultiname(params[1],key);
-				ASATOM_INCREF(params[1]);
-			}
-			else
-				params[1] = asAtomHandler::nullAtom;
-		}
-		else
+		char c = *p++;
+		if (uint8_t(c) < 0x20)
+			return false;
+		if (c != '\\')
 		{
-			params[0] = asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY);
-			params[1] = asAtomHandler::fromObject(*parent);
-			ASATOM_INCREF(params[1]);
+			scratch += c;
+			continue;
 		}
-
-		asAtom funcret=asAtomHandler::invalidAtom;
-		asAtom closure = asAtomHandler::getClosure(reviver) ? asAtomHandler::fromObject(asAtomHandler::getClosure(reviver)) : asAtomHandler::nullAtom;
-		
-		asAtomHandler::callFunction(reviver,funcret,closure, params, 2,true);
-		if(asAtomHandler::isValid(funcret))
+		if (p == stop)
+			return false;
+		c = *p++;
+		switch (c)
 		{
-			if (haskey)
+			case '"': scratch += '"'; break;
+			case '\\': scratch += '\\'; break;
+			case '/': scratch += '/'; break;
+			case 'b': scratch += '\b'; break;
+			case 'f': scratch += '\f'; break;
+			case 'n': scratch += '\n'; break;
+			case 'r': scratch += '\r'; break;
+			case 't': scratch += '\t'; break;
+			case 'u':
 			{
-				if (asAtomHandler::isUndefined(funcret))
-				{
-					(*parent)->deleteVariableByMultiname(key);
-					ASATOM_DECREF(funcret);
-				}
-				else
+				int32_t u = parseHex4(p,stop);
+				if (u < 0)
+					return false;
+				p += 4;
+				if (u >= 0xd800 && u < 0xdc00 && stop-p >= 6 && p[0] == '\\' && p[1] == 'u')
 				{
-					(*parent)->setVariableByMultiname(key,funcret,ASObject::CONST_NOT_ALLOWED);
+					int32_t low = parseHex4(p+2,stop);
+					if (low >= 0xdc00 && low < 0xe000)
+					{
+						u = 0x10000+((u-0xd800)<<10)+(low-0xdc00);
+						p += 6;
+					}
 				}
+				if (u < 0x20 && u != 0xf)
+					return false;
+				char utf8[6];
+				scratch.append(utf8,g_unichar_to_utf8(u,utf8));
+				break;
 			}
-			else 
-				*parent= asAtomHandler::toObject(funcret,getSys());
+			default:
+				return false;
 		}
 	}
-	return pos;
+	return true;
 }
-int JSON::parseTrue(const tiny_string &jsonstring, int pos, ASObject** parent, multiname &key)
+
+bool JSONTreeBuilder::parseNumber(const char*& p, asAtom& v)
 {
-	int len = jsonstring.numChars();
-	if (len >= pos+4)
+	const char* end = buf+len;
+	const char* start = p;
+	bool negative = false;
+	if (*p == '-')
 	{
-		if (jsonstring.charAt(pos) == 't' && 
-				jsonstring.charAt(pos + 1) == 'r' &&
-				jsonstring.charAt(pos + 2) == 'u' && 
-				jsonstring.charAt(pos + 3) == 'e')
-		{
-			pos += 4;
-			if (*parent == NULL)
-				*parent = abstract_b(getSys(),true);
-			else
-			{
-				asAtom v = asAtomHandler::fromBool(true);
-				(*parent)->setVariableByMultiname(key,v,ASObject::CONST_NOT_ALLOWED);
-			}
-		}
-		else
-			throwError<SyntaxError>(kJSONInvalidParseInput);
+		negative = true;
+		p++;
+	}
+	if (p == end)
+		return false;
+	if (*p == '0')
+		p++;
+	else if (*p >= '1' && *p <= '9')
+	{
+		while (p < end && *p >= '0' && *p <= '9')
+			p++;
 	}
 	else
-		throwError<SyntaxError>(kJSONInvalidParseInput);
-	return pos;
-}
-int JSON::parseFalse(const tiny_string &jsonstring, int pos, ASObject** parent, multiname &key)
-{
-	int len = jsonstring.numChars();
-	if (len >= pos+5)
-	{
-		if (jsonstring.charAt(pos) == 'f' && 
-				jsonstring.charAt(pos + 1) == 'a' &&
-				jsonstring.charAt(pos + 2) == 'l' && 
-				jsonstring.charAt(pos + 3) == 's' && 
-				jsonstring.charAt(pos + 4) == 'e')
-		{
-			pos += 5;
-			if (*parent == NULL)
-				*parent = abstract_b(getSys(),false);
-			else 
-			{
-				asAtom v = asAtomHandler::fromBool(false);
-				(*parent)->setVariableByMultiname(key,v,ASObject::CONST_NOT_ALLOWED);
-			}
-		}
+		return false;
+	const char* intEnd = p;
+	bool integral = true;
+	if (p < end && *p == '.')
+	{
+		integral = false;
+		p++;
+		if (p == end || *p < '0' || *p > '9')
+			return false;
+		while (p < end && *p >= '0' && *p <= '9')
+			p++;
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		integral = false;
+		p++;
+		if (p < end && (*p == '+' || *p == '-'))
+			p++;
+		if (p == end || *p < '0' || *p > '9')
+			return false;
+		while (p < end && *p >= '0' && *p <= '9')
+			p++;
+	}
+	const char* digits = negative ? start+1 : start;
+	if (integral && intEnd-digits <= 9)
+	{
+		int32_t i = 0;
+		for (const char* d = digits; d < intEnd; d++)
+			i = i*10 + (*d-'0');
+		if (negative && i == 0)
+			v = asAtomHandler::fromNumber(sys,-0.0,false);
 		else
-			throwError<SyntaxError>(kJSONInvalidParseInput);
+			v = asAtomHandler::fromInt(negative ? -i : i);
 	}
 	else
-		throwError<SyntaxError>(kJSONInvalidParseInput);
-	return pos;
+		v = asAtomHandler::fromNumber(sys,g_ascii_strtod(start,nullptr),false);
+	return true;
 }
-int JSON::parseNull(const tiny_string &jsonstring, int pos, ASObject** parent, multiname &key)
+
+bool JSONTreeBuilder::parseScalar(uint32_t pos, asAtom& v)
 {
-	int len = jsonstring.numChars();
-	if (len >= pos+4)
+	const char* p = buf+pos;
+	const char* end = buf+len;
+	switch (*p)
 	{
-		if (jsonstring.charAt(pos) == 'n' && 
-				jsonstring.charAt(pos + 1) == 'u' &&
-				jsonstring.charAt(pos + 2) == 'l' && 
-				jsonstring.charAt(pos + 3) == 'l')
+		case 't':
+			if (end-p < 4 || memcmp(p,"true",4) != 0)
+				return false;
+			v = asAtomHandler::fromBool(true);
+			p += 4;
+			break;
+		case 'f':
+			if (end-p < 5 || memcmp(p,"false",5) != 0)
+				return false;
+			v = asAtomHandler::fromBool(false);
+			p += 5;
+			break;
+		case 'n':
+			if (end-p < 4 || memcmp(p,"null",4) != 0)
+				return false;
+			v = asAtomHandler::nullAtom;
+			p += 4;
+			break;
+		default:
+			if (!parseNumber(p,v))
+				return false;
+			break;
+	}
+	// a scalar must end at whitespace, a structural character or a quote
+	if (p < end)
+	{
+		switch (*p)
 		{
-			pos += 4;
-			if (*parent == NULL)
-				*parent = getSys()->getNullRef();
-			else 
-				(*parent)->setVariableByMultiname(key,asAtomHandler::nullAtom,ASObject::CONST_NOT_ALLOWED);
+			case ' ': case '\t': case '\n': case '\r':
+			case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+				break;
+			default:
+				ASATOM_DECREF(v);
+				return false;
 		}
-		else
-			throwError<SyntaxError>(kJSONInvalidParseInput);
 	}
-	else
-		throwError<SyntaxError>(kJSONInvalidParseInput);
-	return pos;
+	return true;
 }
-int JSON::parseString(const tiny_string &jsonstring, int pos, ASObject** parent, multiname &key, tiny_string* result)
-{
-	pos++; // ignore starting quotes
-	int len = jsonstring.numChars();
-	if (pos >= len)
-		throwError<SyntaxError>(kJSONInvalidParseInput);
 
-	tiny_string sub = jsonstring.substr(pos,len-pos);
-	
-	tiny_string res;
-	bool done = false;
-	for (CharIterator it=sub.begin(); it!=sub.end(); it++)
+bool JSONTreeBuilder::build(asAtom& result)
+{
+parse_value:
 	{
-		pos++;
-		if (*it == '\"')
+		if (next >= index.size())
+			return false;
+		uint32_t pos = index[next++];
+		switch (buf[pos])
 		{
-			done = true;
-			break;
-		}
-		else if(*it == '\\')
-		{
-			it++;
-			pos++;
-			if(it == sub.end())
-				break;
-			if(*it == '\"')
-				res += '\"';
-			else if(*it == '\\')
-				res += '\\';
-			else if(*it == '/')
-				res += '/';
-			else if(*it == 'b')
-				res += '\b';
-			else if(*it == 'f')
-				res += '\f';
-			else if(*it == 'n')
-				res += '\n';
-			else if(*it == 'r')
-				res += '\r';
-			else if(*it == 't')
-				res += '\t';
-			else if(*it == 'u')
+			case '{':
 			{
-				tiny_string strhex;
-				for (int i = 0; i < 4; i++)
+				ASObject* o = Class<ASObject>::getInstanceS(sys);
+				attach(asAtomHandler::fromObject(o),result);
+				stack.push_back(Frame{o,0,false});
+				if (peek() == '}')
 				{
-					it++; pos++; 
-					if (it==sub.end()) 
-						throwError<SyntaxError>(kJSONInvalidParseInput);
-					switch(*it)
-					{
-						case '0':
-						case '1':
-						case '2':
-						case '3':
-						case '4':
-						case '5':
-						case '6':
-						case '7':
-						case '8':
-						case '9':
-						case 'a':
-						case 'b':
-						case 'c':
-						case 'd':
-						case 'e':
-						case 'f':
-						case 'A':
-						case 'B':
-						case 'C':
-						case 'D':
-						case 'E':
-						case 'F':
-							strhex += *it;
-							break;
-						default:
-							throwError<SyntaxError>(kJSONInvalidParseInput);
-					}
-					if (it==sub.end()) 
-						throwError<SyntaxError>(kJSONInvalidParseInput);
+					next++;
+					stack.pop_back();
+					goto value_done;
 				}
-				number_t hexnum;
-				if (Integer::fromStringFlashCompatible(strhex.raw_buf(),hexnum,16))
+				goto object_key;
+			}
+			case '[':
+			{
+				ASObject* a = Class<Array>::getInstanceSNoArgs(sys);
+				attach(asAtomHandler::fromObject(a),result);
+				stack.push_back(Frame{a,0,true});
+				if (peek() == ']')
 				{
-					if (hexnum < 0x20 && hexnum != 0xf)
-						throwError<SyntaxError>(kJSONInvalidParseInput);
-					res += tiny_string::fromChar(hexnum);
+					next++;
+					stack.pop_back();
+					goto value_done;
 				}
-				else
-					break;
+				goto parse_value;
+			}
+			case '"':
+			{
+				// quotes are always indexed in pairs, the next entry is the closing one
+				uint32_t end = index[next++];
+				if (!decodeString(pos+1,end))
+					return false;
+				attach(asAtomHandler::fromObject(abstract_s(sys,scratch.c_str(),scratch.size())),result);
+				goto value_done;
+			}
+			case '}':
+			case ']':
+			case ':':
+			case ',':
+				return false;
+			default:
+			{
+				asAtom v=asAtomHandler::invalidAtom;
+				if (!parseScalar(pos,v))
+					return false;
+				attach(v,result);
+				goto value_done;
 			}
-			else
-				throwError<SyntaxError>(kJSONInvalidParseInput);
-		}
-		else if (*it < 0x20)
-		{
-			throwError<SyntaxError>(kJSONInvalidParseInput);
 		}
-		else
+	}
+object_key:
+	{
+		if (peek() != '"')
+			return false;
+		uint32_t pos = index[next];
+		uint32_t end = index[next+1];
+		next += 2;
+		if (!decodeString(pos+1,end))
+			return false;
+		stack.back().key = sys->getUniqueStringId(tiny_string(scratch));
+		if (peek() != ':')
+			return false;
+		next++;
+		goto parse_value;
+	}
+value_done:
+	{
+		if (stack.empty())
+			return next == index.size();
+		char c = peek();
+		next++;
+		Frame& f = stack.back();
+		if (c == ',')
 		{
-			res += *it;
+			if (f.isArray)
+				goto parse_value;
+			goto object_key;
 		}
+		if (c != (f.isArray ? ']' : '}'))
+			return false;
+		stack.pop_back();
+		goto value_done;
 	}
-	if (!done)
+}
+
+void JSON::doParse(asAtom& ret, const tiny_string &jsonstring, asAtom reviver)
+{
+	SystemState* sys = getSys();
+	std::vector<uint32_t> index;
+	if (!buildStructuralIndex(jsonstring.raw_buf(),jsonstring.numBytes(),index))
 		throwError<SyntaxError>(kJSONInvalidParseInput);
-	
-	if (parent != NULL)
+	asAtom res=asAtomHandler::invalidAtom;
 	{
-		if (*parent == NULL)
-			*parent = abstract_s(getSys(),res);
-		else 
+		JSONTreeBuilder builder(sys,jsonstring.raw_buf(),jsonstring.numBytes(),index);
+		if (!builder.build(res))
 		{
-			asAtom v = asAtomHandler::fromObject(abstract_s(getSys(),res));
-			(*parent)->setVariableByMultiname(key,v,ASObject::CONST_NOT_ALLOWED);
+			ASATOM_DECREF(res);
+			throwError<SyntaxError>(kJSONInvalidParseInput);
 		}
 	}
-	if (result)
-		*result =res;
-	return pos;
+	if (asAtomHandler::isValid(reviver))
+	{
+		// the root is revived as the member "" of a new object
+		ASObject* holder = Class<ASObject>::getInstanceS(sys);
+		multiname key(NULL);
+		key.name_type=multiname::NAME_STRING;
+		key.name_s_id=BUILTIN_STRINGS::EMPTY;
+		key.ns.push_back(nsNameAndKind(sys,"",NAMESPACE));
+		key.isAttribute = false;
+		holder->setVariableByMultiname(key,res,ASObject::CONST_NOT_ALLOWED);
+		revive(sys,holder,key,reviver);
+		res=asAtomHandler::invalidAtom;
+		holder->getVariableByMultiname(res,key);
+		ASATOM_INCREF(res);
+		holder->decRef();
+		if (asAtomHandler::isInvalid(res))
+			asAtomHandler::setUndefined(res);
+	}
+	ret = res;
 }
-int JSON::parseNumber(const tiny_string &jsonstring, int pos, ASObject** parent, multiname &key)
+
+void JSON::revive(SystemState* sys, ASObject* holder, multiname& key, asAtom reviver)
 {
-	int len = jsonstring.numChars();
-	tiny_string res;
-	bool done = false;
-	while (!done && pos < len)
+	asAtom val=asAtomHandler::invalidAtom;
+	holder->getVariableByMultiname(val,key);
+	if (asAtomHandler::isObject(val))
 	{
-		char c = jsonstring.charAt(pos);
-		switch(c)
+		ASObject* o = asAtomHandler::getObjectNoCheck(val);
+		if (o->is<Array>())
 		{
-			case '0':
-			case '1':
-			case '2':
-			case '3':
-			case '4':
-			case '5':
-			case '6':
-			case '7':
-			case '8':
-			case '9':
-			case '-':
-			case '+':
-			case '.':
-			case 'E':
-			case 'e':
-				res += c;
-				pos++;
-				break;
-			default:
-				done = true;
-				break;
+			multiname name(NULL);
+			name.name_type=multiname::NAME_UINT;
+			name.ns.push_back(nsNameAndKind(sys,"",NAMESPACE));
+			name.isAttribute = false;
+			uint32_t size = o->as<Array>()->size();
+			for (uint32_t i = 0; i < size; i++)
+			{
+				name.name_ui = i;
+				revive(sys,o,name,reviver);
+			}
+		}
+		else if (!o->isPrimitive())
+		{
+			// the names are collected first as the reviver may delete members
+			std::vector<uint32_t> names;
+			uint32_t i = 0;
+			while ((i = o->nextNameIndex(i)) != 0)
+			{
+				asAtom n=asAtomHandler::invalidAtom;
+				o->nextName(n,i);
+				names.push_back(asAtomHandler::toStringId(n,sys));
+			}
+			multiname name(NULL);
+			name.name_type=multiname::NAME_STRING;
+			name.ns.push_back(nsNameAndKind(sys,"",NAMESPACE));
+			name.isAttribute = false;
+			for (auto it = names.begin(); it != names.end(); ++it)
+			{
+				name.name_s_id = *it;
+				revive(sys,o,name,reviver);
+			}
 		}
 	}
-	ASObject* numstr = abstract_s(getSys(),res);
-	number_t num = numstr->toNumber();
-
-	if (std::isnan(num))
-		throwError<SyntaxError>(kJSONInvalidParseInput);
 
-	if (*parent == NULL)
-		*parent = abstract_d(getSys(),num);
-	else 
+	asAtom params[2];
+	params[0] = asAtomHandler::fromObject(abstract_s(sys,key.normalizedName(sys)));
+	params[1] = val;
+	ASATOM_INCREF(params[1]);
+	if (asAtomHandler::isInvalid(params[1]))
+		params[1] = asAtomHandler::nullAtom;
+	asAtom funcret=asAtomHandler::invalidAtom;
+	asAtom closure = asAtomHandler::getClosureAtom(reviver);
+	asAtomHandler::callFunction(reviver,funcret,closure,params,2,true);
+	if (asAtomHandler::isValid(funcret))
 	{
-		asAtom v = asAtomHandler::fromNumber(getSys(),num,false);
-		(*parent)->setVariableByMultiname(key,v,ASObject::CONST_NOT_ALLOWED);
+		if (asAtomHandler::isUndefined(funcret))
+			holder->deleteVariableByMultiname(key);
+		else
+			holder->setVariableByMultiname(key,funcret,ASObject::CONST_NOT_ALLOWED);
 	}
-	return pos;
 }
-int JSON::parseObject(const tiny_string &jsonstring, int pos, ASObject** parent, multiname &key, asAtom reviver)
+
+ASFUNCTIONBODY_ATOM(JSON,_parse)
 {
-	int len = jsonstring.numChars();
-	pos++; // ignore '{' or ','
-	ASObject* subobj = Class<ASObject>::getInstanceS(getSys());
-	if (*parent == NULL)
-		*parent = subobj;
-	else 
-	{
-		asAtom v = asAtomHandler::fromObject(subobj);
-		(*parent)->setVariableByMultiname(key,v,ASObject::CONST_NOT_ALLOWED);
-	}
-	multiname name(NULL);
-	name.name_type=multiname::NAME_STRING;
-	name.ns.push_back(nsNameAndKind(getSys(),"",NAMESPACE));
-	name.isAttribute = false;
-	bool done = false;
-	bool bfirst = true;
-	bool needkey = true;
-	bool needvalue = false;
-
-	while (!done && pos < len)
-	{
-		while (jsonstring.charAt(pos) == ' ' ||
-			   jsonstring.charAt(pos) == '\t' ||
-			   jsonstring.charAt(pos) == '\n' ||
-			   jsonstring.charAt(pos) == '\r'
-			   )
-			pos++;
-		char c = jsonstring.charAt(pos);
-		switch(c)
-		{
-			case '}':
-				if (!bfirst && (needkey || needvalue))
-					throwError<SyntaxError>(kJSONInvalidParseInput);
-				done = true;
-				pos++;
-				break;
-			case '\"':
-				{
-					tiny_string keyname;
-					pos = parseString(jsonstring,pos,NULL,name,&keyname);
-					name.name_s_id=getSys()->getUniqueStringId(keyname);
-					needkey = false;
-					needvalue = true;
-				}
-				break;
-			case ',':
-				if (needkey || needvalue)
-					throwError<SyntaxError>(kJSONInvalidParseInput);
-				pos++;
-				name.name_s_id=0;
-				needkey = true;
-				break;
-			case ':':
-				pos++;
-				pos = parse(jsonstring,pos,&subobj,name,reviver);
-				needvalue = false;
-				break;
-			default:
-				throwError<SyntaxError>(kJSONInvalidParseInput);
-		}
-		bfirst=false;
-	}
-	if (!done)
-		throwError<SyntaxError>(kJSONInvalidParseInput);
+	tiny_string text;
+	asAtom reviver=asAtomHandler::invalidAtom;
 
-	return pos;
+	if (argslen > 0 && (asAtomHandler::is<Null>(args[0]) ||asAtomHandler::is<Undefined>(args[0])))
+		throwError<SyntaxError>(kJSONInvalidParseInput);
+	ARG_UNPACK_ATOM_MORE_ALLOWED(text);
+	if (argslen > 1)
+	{
+		if (!asAtomHandler::is<IFunction>(args[1]))
+			throwError<TypeError>(kCheckTypeFailedError);
+		reviver = args[1];
+	}
+	doParse(ret,text,reviver);
 }
 
-int JSON::parseArray(const tiny_string &jsonstring, int pos, ASObject** parent, multiname &key, asAtom reviver)
+ASFUNCTIONBODY_ATOM(JSON,_stringify)
 {
-	int len = jsonstring.numChars();
-	pos++; // ignore '['
-	ASObject* subobj = Class<Array>::getInstanceSNoArgs(getSys());
-	if (*parent == NULL)
-		*parent = subobj;
-	else 
-	{
-		asAtom v = asAtomHandler::fromObject(subobj);
-		(*parent)->setVariableByMultiname(key,v,ASObject::CONST_NOT_ALLOWED);
-	}
-	multiname name(NULL);
-	name.name_type=multiname::NAME_UINT;
-	name.name_ui = 0;
-	name.ns.push_back(nsNameAndKind(getSys(),"",NAMESPACE));
-	name.isAttribute = false;
-	bool done = false;
-	bool needdata = false;
-	while (!done && pos < len)
-	{
-		while (jsonstring.charAt(pos) == ' ' ||
-			   jsonstring.charAt(pos) == '\t' ||
-			   jsonstring.charAt(pos) == '\n' ||
-			   jsonstring.charAt(pos) == '\r'
-			   )
-			pos++;
-		char c = jsonstring.charAt(pos);
-		switch(c)
+	asAtom value = argslen > 0 ? args[0] : asAtomHandler::undefinedAtom;
+	asAtom replacer=asAtomHandler::invalidAtom;
+	Array* filter = nullptr;
+	if (argslen > 1 && !asAtomHandler::isNull(args[1]) && !asAtomHandler::isUndefined(args[1]))
+	{
+		if (asAtomHandler::isFunction(args[1]))
+			replacer = args[1];
+		else if (asAtomHandler::isArray(args[1]))
+			filter = asAtomHandler::as<Array>(args[1]);
+		else
+			throwError<TypeError>(kJSONInvalidReplacer);
+	}
+
+	tiny_string spaces = "";
+	if (argslen > 2)
+	{
+		asAtom space = args[2];
+		spaces = "          ";
+		if (asAtomHandler::is<Number>(space) || asAtomHandler::is<Integer>(space) || asAtomHandler::is<UInteger>(space))
 		{
-			case ']':
-				done = true;
-				pos++;
-				break;
-			case ',':
-				name.name_ui++;
-				needdata = true;
-				pos++;
-				break;
-			default:
-				pos = parse(jsonstring,pos,&subobj,name, reviver);
-				needdata = false;
-				break;
+			int32_t v = asAtomHandler::toInt(space);
+			if (v < 0) v = 0;
+			if (v > 10) v = 10;
+			spaces = spaces.substr_bytes(0,v);
+		}
+		else if (asAtomHandler::is<Boolean>(space) || asAtomHandler::is<Null>(space))
+		{
+			spaces = "";
+		}
+		else
+		{
+			if(asAtomHandler::getObject(space) && asAtomHandler::getObject(space)->has_toString())
+			{
+				asAtom ret=asAtomHandler::invalidAtom;
+				asAtomHandler::getObject(space)->call_toString(ret);
+				spaces = asAtomHandler::toString(ret,sys);
+			}
+			else
+				spaces = asAtomHandler::toString(space,sys);
+			if (spaces.numBytes() > 10)
+				spaces = spaces.substr_bytes(0,10);
 		}
 	}
-	if (!done || needdata)
-		throwError<SyntaxError>(kJSONInvalidParseInput);
-
-	return pos;
+	JSONStringifier s(sys,replacer,spaces);
+	if (filter)
+	{
+		for (uint64_t i = 0; i < filter->size(); i++)
+		{
+			asAtom a = filter->at(i);
+			s.addFilter(sys->getUniqueStringId(asAtomHandler::toString(a,sys)));
+		}
+	}
+	if (s.writeProperty(nullptr,asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY),value,""))
+		ret = asAtomHandler::fromObject(abstract_s(sys,s.out.c_str(),s.out.size()));
+	else
+		asAtomHandler::setUndefined(ret);
 }
 
-
-
-
-/***** 
-
-static QString sanitizeString(QString str)
+JSONStringifier::JSONStringifier(SystemState* s, asAtom r, const tiny_string& g)
+	:sys(s),hasFilter(false),replacer(r),gap(g),toJSONName(nullptr)
 {
-        str.replace(QLatin1String("\\"), QLatin1String("\\\\"));
-        str.replace(QLatin1String("\""), QLatin1String("\\\""));
-        str.replace(QLatin1String("\b"), QLatin1String("\\b"));
-        str.replace(QLatin1String("\f"), QLatin1String("\\f"));
-        str.replace(QLatin1String("\n"), QLatin1String("\\n"));
-        str.replace(QLatin1String("\r"), QLatin1String("\\r"));
-        str.replace(QLatin1String("\t"), QLatin1String("\\t"));
-        return QString(QLatin1String("\"%1\"")).arg(str);
+	toJSONName.name_type=multiname::NAME_STRING;
+	toJSONName.name_s_id=sys->getUniqueStringId("toJSON");
+	toJSONName.ns.emplace_back(sys,BUILTIN_STRINGS::EMPTY,NAMESPACE);
+	toJSONName.ns.emplace_back(sys,BUILTIN_STRINGS::STRING_AS3NS,NAMESPACE);
+	toJSONName.isAttribute = false;
 }
 
-static QByteArray join(const QList<QByteArray> &list, const QByteArray &sep)
+void JSONStringifier::addFilter(uint32_t nameId)
 {
-        QByteArray res;
-        Q_FOREACH(const QByteArray &i, list)
-        {
-                if(!res.isEmpty())
-                {
-                        res += sep;
-                }
-                res += i;
-        }
-        return res;
+	hasFilter = true;
+	filter.insert(nameId);
 }
 
-
-
-static DSVariantList parseArray(const QString &json, int &index, bool &success)
+bool JSONStringifier::callToJSON(asAtom& v, asAtom& key, asAtom& ret)
 {
-        DSVariantList list;
-
-        nextToken(json, index);
-
-        bool done = false;
-        while(!done)
-        {
-                int token = lookAhead(json, index);
-
-                if(token == JsonTokenNone)
-                {
-                        success = false;
-                        return DSVariantList();
-                }
-                else if(token == JsonTokenComma)
-                {
-                        nextToken(json, index);
-                }
-                else if(token == JsonTokenSquaredClose)
-                {
-                        nextToken(json, index);
-                        break;
-                }
-                else
-                {
-                        QVariant value = parseValue(json, index, success);
-
-                        if(!success)
-                        {
-                            return DSVariantList();
-                        }
-
-                        list.push_back(value);
-                }
-        }
-
-        return list;
+	ASObject* o = asAtomHandler::getObjectNoCheck(v);
+	// the non-virtual lookup does not fire the hasProperty trap of Proxy objects
+	if (!o->ASObject::hasPropertyByMultiname(toJSONName,true,true))
+		return false;
+	asAtom f=asAtomHandler::invalidAtom;
+	o->getVariableByMultiname(f,toJSONName,SKIP_IMPL);
+	if (!asAtomHandler::isFunction(f))
+		return false;
+	asAtomHandler::callFunction(f,ret,v,&key,1,false);
+	return true;
 }
 
-
-static QVariant parseNumber(const QString &json, int &index)
+bool JSONStringifier::writeProperty(ASObject* holder, asAtom key, asAtom value, const tiny_string& indent)
 {
-        eatWhitespace(json, index);
-
-        int lastIndex = lastIndexOfNumber(json, index);
-        int charLength = (lastIndex - index) + 1;
-        QString numberStr;
-
-        numberStr = json.mid(index, charLength);
-
-        index = lastIndex + 1;
+	asAtom v = value;
+	bool owned = false;
+	if (asAtomHandler::isObject(v) && !asAtomHandler::getObjectNoCheck(v)->isPrimitive())
+	{
+		asAtom res=asAtomHandler::invalidAtom;
+		if (callToJSON(v,key,res))
+		{
+			v = res;
+			owned = true;
+		}
+	}
+	if (asAtomHandler::isValid(replacer))
+	{
+		asAtom params[2];
+		params[0] = key;
+		params[1] = v;
+		asAtom res=asAtomHandler::invalidAtom;
+		asAtom closure = asAtomHandler::getClosureAtom(replacer,holder ? asAtomHandler::fromObject(holder) : asAtomHandler::nullAtom);
+		asAtomHandler::callFunction(replacer,res,closure,params,2,false);
+		if (owned)
+			ASATOM_DECREF(v);
+		v = res;
+		owned = true;
+	}
 
-        if (numberStr.contains('.')) {
-                return QVariant(numberStr.toDouble(NULL));
-        } else if (numberStr.startsWith('-')) {
-                return QVariant(numberStr.toLongLong(NULL));
-        } else {
-                return QVariant(numberStr.toULongLong(NULL));
-        }
+	bool written = true;
+	if (asAtomHandler::isInvalid(v) || asAtomHandler::isUndefined(v) || asAtomHandler::isFunction(v))
+		written = false;
+	else if (asAtomHandler::isNull(v))
+		out += "null";
+	else if (asAtomHandler::isBool(v))
+		out += asAtomHandler::Boolean_concrete(v) ? "true" : "false";
+	else if (asAtomHandler::isNumeric(v))
+		writeNumber(v);
+	else if (asAtomHandler::isString(v))
+	{
+		tiny_string str = asAtomHandler::toString(v,sys);
+		writeString(str.raw_buf(),str.numBytes());
+	}
+	else
+	{
+		ASObject* o = asAtomHandler::getObjectNoCheck(v);
+		switch (o->getObjectType())
+		{
+			case T_UNDEFINED:
+				written = false;
+				break;
+			case T_NULL:
+				out += "null";
+				break;
+			case T_BOOLEAN:
+				out += asAtomHandler::Boolean_concrete(v) ? "true" : "false";
+				break;
+			default:
+				if (!path.insert(o).second)
+					throwError<TypeError>(kJSONCyclicStructure);
+				o->toJSON(*this,indent);
+				path.erase(o);
+				break;
+		}
+	}
+	if (owned)
+		ASATOM_DECREF(v);
+	return written;
 }
 
-static int lastIndexOfNumber(const QString &json, int index)
+void JSONStringifier::writeNumber(asAtom& v)
 {
-        int lastIndex;
-
-        for(lastIndex = index; lastIndex < json.size(); lastIndex++)
-        {
-                if(QString("0123456789+-.eE").indexOf(json[lastIndex]) == -1)
-                {
-                        break;
-                }
-        }
-
-        return lastIndex -1;
+	char buf[32];
+	if (asAtomHandler::isInteger(v))
+	{
+		out.append(buf,snprintf(buf,sizeof(buf),"%d",asAtomHandler::toInt(v)));
+		return;
+	}
+	if (asAtomHandler::isUInteger(v))
+	{
+		out.append(buf,snprintf(buf,sizeof(buf),"%u",asAtomHandler::toUInt(v)));
+		return;
+	}
+	number_t d = asAtomHandler::toNumber(v);
+	if (!std::isfinite(d))
+		out += "null";
+	else if (d == std::floor(d) && std::fabs(d) < 1e15)
+		out.append(buf,snprintf(buf,sizeof(buf),"%lld",(long long)d));
+	else
+	{
+		tiny_string str = asAtomHandler::toString(v,sys);
+		out.append(str.raw_buf(),str.numBytes());
+	}
 }
 
+static const char hexDigits[] = "0123456789abcdef";
 
-
-static int lookAhead(const QString &json, int index)
+static inline void writeUnicodeEscape(std::string& out, uint32_t u)
 {
-        int saveIndex = index;
-        return nextToken(json, saveIndex);
+	char esc[6] = { '\\', 'u', hexDigits[(u>>12)&0xf], hexDigits[(u>>8)&0xf], hexDigits[(u>>4)&0xf], hexDigits[u&0xf] };
+	out.append(esc,6);
 }
 
-static int nextToken(const QString &json, int &index)
+void JSONStringifier::writeString(const char* s, uint32_t len)
 {
-        eatWhitespace(json, index);
-
-        if(index == json.size())
-        {
-                return JsonTokenNone;
-        }
-
-        QChar c = json[index];
-        index++;
-        switch(c.toLatin1())
-        {
-                case '{': return JsonTokenCurlyOpen;
-                case '}': return JsonTokenCurlyClose;
-                case '[': return JsonTokenSquaredOpen;
-                case ']': return JsonTokenSquaredClose;
-                case ',': return JsonTokenComma;
-                case '"': return JsonTokenString;
-                case '0': case '1': case '2': case '3': case '4':
-                case '5': case '6': case '7': case '8': case '9':
-                case '-': return JsonTokenNumber;
-                case ':': return JsonTokenColon;
-        }
-
-        index--;
-
-        int remainingLength = json.size() - index;
-
-        //True
-        if(remainingLength >= 4)
-        {
-                if (json[index] == 't' && json[index + 1] == 'r' &&
-                        json[index + 2] == 'u' && json[index + 3] == 'e')
-                {
-                        index += 4;
-                        return JsonTokenTrue;
-                }
-        }
-
-        //False
-        if (remainingLength >= 5)
-        {
-                if (json[index] == 'f' && json[index + 1] == 'a' &&
-                        json[index + 2] == 'l' && json[index + 3] == 's' &&
-                        json[index + 4] == 'e')
-                {
-                        index += 5;
-                        return JsonTokenFalse;
-                }
-        }
-
-        //Null
-        if (remainingLength >= 4)
-        {
-                if (json[index] == 'n' && json[index + 1] == 'u' &&
-                        json[index + 2] == 'l' && json[index + 3] == 'l')
-                {
-                        index += 4;
-                        return JsonTokenNull;
-                }
-        }
-
-        return JsonTokenNone;
+	out += '"';
+	uint32_t i = 0;
+	while (i < len)
+	{
+		// copy the run of bytes that need no escaping at once
+		uint32_t start = i;
+#ifdef __SSE2__
+		while (i+16 <= len)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(s+i));
+			// bytes >= 0x80 are negative, the signed compare finds them together with the control characters
+			__m128i special = _mm_or_si128(_mm_cmplt_epi8(v,_mm_set1_epi8(0x20)),
+						       _mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8('"')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\\'))));
+			int mask = _mm_movemask_epi8(special);
+			if (mask)
+			{
+				i += __builtin_ctz(mask);
+				break;
+			}
+			i += 16;
+		}
+#endif
+		while (i < len)
+		{
+			uint8_t c = s[i];
+			if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\')
+				break;
+			i++;
+		}
+		out.append(s+start,i-start);
+		if (i == len)
+			break;
+		uint8_t c = s[i];
+		switch (c)
+		{
+			case '\b': out += "\\b"; i++; break;
+			case '\f': out += "\\f"; i++; break;
+			case '\n': out += "\\n"; i++; break;
+			case '\r': out += "\\r"; i++; break;
+			case '\t': out += "\\t"; i++; break;
+			case '"': out += "\\\""; i++; break;
+			case '\\': out += "\\\\"; i++; break;
+			default:
+			{
+				if (c < 0x20)
+				{
+					writeUnicodeEscape(out,c);
+					i++;
+					break;
+				}
+				// characters above 0xff are written as escapes like the Flash player does
+				uint32_t seqlen = g_utf8_skip[c];
+				gunichar u = seqlen <= len-i ? g_utf8_get_char_validated(s+i,seqlen) : (gunichar)-1;
+				if (u >= 0x110000)
+				{
+					out += char(c);
+					i++;
+				}
+				else if (u > 0xffff)
+				{
+					writeUnicodeEscape(out,0xd800+((u-0x10000)>>10));
+					writeUnicodeEscape(out,0xdc00+((u-0x10000)&0x3ff));
+					i += seqlen;
+				}
+				else if (u > 0xff)
+				{
+					writeUnicodeEscape(out,u);
+					i += seqlen;
+				}
+				else
+				{
+					out.append(s+i,seqlen);
+					i += seqlen;
+				}
+				break;
+			}
+		}
+	}
+	out += '"';
 }
-*****/
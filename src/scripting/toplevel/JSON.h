@@ -21,6 +21,7 @@
 #define SCRIPTING_TOPLEVEL_JSON_H 1
 #include "compat.h"
 #include "asobject.h"
+#include <unordered_set>
 
 namespace lightspark
 {
@@ -35,17 +36,51 @@ public:
 	ASFUNCTION_ATOM(generator);
 	ASFUNCTION_ATOM(_parse);
 	ASFUNCTION_ATOM(_stringify);
-	static ASObject* doParse(const tiny_string &jsonstring, asAtom reviver);
+	static void doParse(asAtom& ret, const tiny_string &jsonstring, asAtom reviver);
 private:
-	static void parseAll(const tiny_string &jsonstring, ASObject** parent , multiname &key, asAtom reviver);
-	static int parse(const tiny_string &jsonstring, int pos, ASObject **parent, multiname &key, asAtom reviver);
-	static int parseTrue(const tiny_string &jsonstring, int pos, ASObject **parent, multiname &key);
-	static int parseFalse(const tiny_string &jsonstring, int pos, ASObject **parent, multiname &key);
-	static int parseNull(const tiny_string &jsonstring, int pos, ASObject **parent, multiname &key);
-	static int parseString(const tiny_string &jsonstring, int pos, ASObject **parent, multiname &key, tiny_string *result = nullptr);
-	static int parseNumber(const tiny_string &jsonstring, int pos, ASObject **parent, multiname &key);
-	static int parseObject(const tiny_string &jsonstring, int pos, ASObject **parent, multiname &key, asAtom reviver);
-	static int parseArray(const tiny_string &jsonstring, int pos, ASObject **parent, multiname &key, asAtom reviver);
+	// calls the reviver for every value of the parsed tree, children first
+	static void revive(SystemState* sys, ASObject* holder, multiname& key, asAtom reviver);
+};
+
+/*
+ * State of JSON.stringify. The text is appended to a single buffer, the objects currently
+ * being serialized are kept in a hash set to detect cyclic structures.
+ * Containers implement ASObject::toJSON and serialize their members with writeProperty().
+ */
+class JSONStringifier
+{
+private:
+	SystemState* sys;
+	std::unordered_set<ASObject*> path;
+	// names allowed by an array replacer
+	std::unordered_set<uint32_t> filter;
+	bool hasFilter;
+	asAtom replacer;
+	tiny_string gap;
+	multiname toJSONName;
+	// calls the toJSON method of v, returns false if it has none
+	bool callToJSON(asAtom& v, asAtom& key, asAtom& ret);
+	void writeNumber(asAtom& v);
+public:
+	std::string out;
+	JSONStringifier(SystemState* s, asAtom r, const tiny_string& g);
+	void addFilter(uint32_t nameId);
+	bool isFiltered(uint32_t nameId) const { return hasFilter && filter.find(nameId)==filter.end(); }
+	const tiny_string& getGap() const { return gap; }
+	/*
+	 * Writes the value of holder[key] after applying toJSON and the replacer.
+	 * Returns false and writes nothing if the value is not serializable (undefined, functions).
+	 */
+	bool writeProperty(ASObject* holder, asAtom key, asAtom value, const tiny_string& indent);
+	void writeString(const char* s, uint32_t len);
+	// starts a new line with the given indentation if a gap is used
+	void writeNewline(const tiny_string& indent)
+	{
+		if(gap.empty())
+			return;
+		out+='\n';
+		out.append(indent.raw_buf(),indent.numBytes());
+	}
 };
 
 }
@@ -19,10 +19,105 @@
 
 #include "scripting/argconv.h"
 #include "scripting/toplevel/RegExp.h"
+#include <list>
+#include <unordered_map>
 
 using namespace std;
 using namespace lightspark;
 
+// maximum number of compiled patterns kept in the pattern cache of each thread
+#define PATTERNCACHE_SIZE 64
+
+namespace
+{
+typedef std::pair<tiny_string,int> PatternKey;
+struct PatternKeyHash
+{
+	size_t operator()(const PatternKey& k) const
+	{
+		// FNV-1a over the bytes of the source, the string may contain '\0's
+		uint64_t h = 14695981039346656037ULL ^ uint64_t(k.second);
+		const char* buf = k.first.raw_buf();
+		for (uint32_t i = 0; i < k.first.numBytes(); i++)
+			h = (h ^ uint8_t(buf[i])) * 1099511628211ULL;
+		return std::hash<uint64_t>()(h);
+	}
+};
+/*
+ * LRU cache of compiled patterns with a hash index.
+ * Every thread has its own cache, so lookups don't need a lock
+ */
+class PatternCache
+{
+private:
+	typedef std::list<std::pair<PatternKey,_R<CompiledRegExp>>> lruList;
+	lruList lru;
+	std::unordered_map<PatternKey,lruList::iterator,PatternKeyHash> index;
+public:
+	_NR<CompiledRegExp> find(const PatternKey& key)
+	{
+		auto it = index.find(key);
+		if (it == index.end())
+			return NullRef;
+		// move to front, so the least recently used pattern is always at the end of the list
+		if (it->second != lru.begin())
+			lru.splice(lru.begin(),lru,it->second);
+		return lru.front().second;
+	}
+	void insert(const PatternKey& key, _R<CompiledRegExp> re)
+	{
+		lru.push_front(make_pair(key,re));
+		index[key] = lru.begin();
+		if (lru.size() > PATTERNCACHE_SIZE)
+		{
+			index.erase(lru.back().first);
+			lru.pop_back();
+		}
+	}
+};
+thread_local PatternCache patterncache;
+}
+
+CompiledRegExp::CompiledRegExp(pcre* _re):re(_re),extra(nullptr),capturingGroups(0)
+{
+	const char* error=nullptr;
+	int studyoptions=0;
+#ifdef PCRE_STUDY_JIT_COMPILE
+	studyoptions |= PCRE_STUDY_JIT_COMPILE;
+#endif
+	extra = pcre_study(re,studyoptions,&error);
+	if (error)
+		LOG(LOG_INFO,"RegExp: pcre_study failed:"<<error);
+	if (!extra)
+	{
+		// we always need an extra block for the recursion limit
+		extra = (pcre_extra*)pcre_malloc(sizeof(pcre_extra));
+		memset(extra,0,sizeof(pcre_extra));
+	}
+	extra->match_limit_recursion=200;
+	if(pcre_fullinfo(re, extra, PCRE_INFO_CAPTURECOUNT, &capturingGroups)!=0)
+		capturingGroups=-1;
+}
+
+CompiledRegExp::~CompiledRegExp()
+{
+#ifdef PCRE_STUDY_JIT_COMPILE
+	pcre_free_study(extra);
+#else
+	pcre_free(extra);
+#endif
+	pcre_free(re);
+}
+
+int CompiledRegExp::exec(const tiny_string& str, int offset, int* ovector, int ovectorsize, bool limitRecursion)
+{
+	// the compiled pattern may be shared between workers, so we use a local copy of the extra block
+	pcre_extra e = *extra;
+	if (limitRecursion)
+		e.flags |= PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+	return pcre_exec(re, &e, str.raw_buf(), str.numBytes(), offset, 0, ovector, ovectorsize);
+}
+
 RegExp::RegExp(Class_base* c):ASObject(c,T_OBJECT,SUBTYPE_REGEXP),dotall(false),global(false),ignoreCase(false),
 	extended(false),multiline(false),lastIndex(0)
 {
@@ -33,6 +128,24 @@ RegExp::RegExp(Class_base* c, const tiny_string& _re):ASObject(c,T_OBJECT,SUBTYP
 {
 }
 
+bool RegExp::destruct()
+{
+	compiledRE.reset();
+	dotall=false;
+	global=false;
+	ignoreCase=false;
+	extended=false;
+	multiline=false;
+	lastIndex=0;
+	source="";
+	return destructIntern();
+}
+
+void RegExp::finalize()
+{
+	compiledRE.reset();
+}
+
 void RegExp::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructor, CLASS_DYNAMIC_NOT_FINAL);
@@ -62,6 +175,7 @@ void RegExp::buildTraits(ASObject* o)
 ASFUNCTIONBODY_ATOM(RegExp,_constructor)
 {
 	RegExp* th=asAtomHandler::as<RegExp>(obj);
+	th->compiledRE.reset();
 	if(argslen > 0 && asAtomHandler::is<RegExp>(args[0]))
 	{
 		if(argslen > 1 && !asAtomHandler::is<Undefined>(args[1]))
@@ -146,55 +260,40 @@ ASFUNCTIONBODY_ATOM(RegExp,exec)
 
 ASObject *RegExp::match(const tiny_string& str)
 {
-	pcre* pcreRE = compile();
-	if (!pcreRE)
+	_NR<CompiledRegExp> pcreRE = compile();
+	if (pcreRE.isNull())
 		return getSystemState()->getNullRef();
-	int capturingGroups;
-	int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
+	int capturingGroups=pcreRE->capturingGroups;
+	if(capturingGroups<0)
 		return getSystemState()->getNullRef();
-	}
 	//Get information about named capturing groups
 	int namedGroups;
-	infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_NAMECOUNT, &namedGroups);
+	int infoOk=pcre_fullinfo(pcreRE->re, NULL, PCRE_INFO_NAMECOUNT, &namedGroups);
 	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
 		return getSystemState()->getNullRef();
-	}
 	//Get information about the size of named entries
 	int namedSize;
-	infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_NAMEENTRYSIZE, &namedSize);
+	infoOk=pcre_fullinfo(pcreRE->re, NULL, PCRE_INFO_NAMEENTRYSIZE, &namedSize);
 	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
 		return getSystemState()->getNullRef();
-	}
 	struct nameEntry
 	{
 		uint16_t number;
 		char name[0];
 	};
 	char* entries;
-	infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_NAMETABLE, &entries);
+	infoOk=pcre_fullinfo(pcreRE->re, NULL, PCRE_INFO_NAMETABLE, &entries);
 	if(infoOk!=0)
 	{
-		pcre_free(pcreRE);
 		lastIndex=0;
 		return getSystemState()->getNullRef();
 	}
-	pcre_extra extra;
-	extra.match_limit_recursion=200;
-	extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
 	int ovector[(capturingGroups+1)*3];
 	int offset=global?lastIndex:0;
-	int rc=pcre_exec(pcreRE,capturingGroups > 200 ? &extra : NULL, str.raw_buf(), str.numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+	int rc=pcreRE->exec(str, offset, ovector, (capturingGroups+1)*3,capturingGroups > 200);
 	if(rc<0)
 	{
 		//No matches or error
-		pcre_free(pcreRE);
 		lastIndex=0;
 		return getSystemState()->getNullRef();
 	}
@@ -224,7 +323,6 @@ ASObject *RegExp::match(const tiny_string& str)
 		entries+=namedSize;
 	}
 	lastIndex=ovector[1];
-	pcre_free(pcreRE);
 	return a;
 }
 
@@ -238,29 +336,18 @@ ASFUNCTIONBODY_ATOM(RegExp,test)
 	RegExp* th=asAtomHandler::as<RegExp>(obj);
 
 	const tiny_string& arg0 = asAtomHandler::toString(args[0],sys);
-	pcre* pcreRE = th->compile();
-	if (!pcreRE)
+	_NR<CompiledRegExp> pcreRE = th->compile();
+	if (pcreRE.isNull() || pcreRE->capturingGroups < 0)
 	{
 		asAtomHandler::setNull(ret);
 		return;
 	}
-	int capturingGroups;
-	int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		asAtomHandler::setNull(ret);
-		return;
-	}
+	int capturingGroups=pcreRE->capturingGroups;
 	int ovector[(capturingGroups+1)*3];
 	
 	int offset=(th->global)?th->lastIndex:0;
-	pcre_extra extra;
-	extra.match_limit_recursion=200;
-	extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
-	int rc = pcre_exec(pcreRE, &extra, arg0.raw_buf(), arg0.numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+	int rc = pcreRE->exec(arg0, offset, ovector, (capturingGroups+1)*3);
 	bool res = (rc >= 0);
-	pcre_free(pcreRE);
 	asAtomHandler::setBool(ret,res);
 }
 
@@ -290,7 +377,7 @@ ASFUNCTIONBODY_ATOM(RegExp,_toString)
 	ret = asAtomHandler::fromObject(abstract_s(sys,res));
 }
 
-pcre* RegExp::compile()
+int RegExp::getPCREOptions() const
 {
 	int options = PCRE_UTF8|PCRE_NEWLINE_ANY|PCRE_JAVASCRIPT_COMPAT;
 	if(ignoreCase)
@@ -301,6 +388,23 @@ pcre* RegExp::compile()
 		options |= PCRE_MULTILINE;
 	if(dotall)
 		options|=PCRE_DOTALL;
+	return options;
+}
+
+_NR<CompiledRegExp> RegExp::compile()
+{
+	// source and flags can only be changed by the constructor, so the compiled pattern stays valid for the lifetime of this object
+	if (compiledRE.isNull())
+		compiledRE = getCompiledPattern(source,getPCREOptions());
+	return compiledRE;
+}
+
+_NR<CompiledRegExp> RegExp::getCompiledPattern(const tiny_string& source, int options)
+{
+	PatternKey key(source,options);
+	_NR<CompiledRegExp> cached = patterncache.find(key);
+	if (!cached.isNull())
+		return cached;
 
 	const char * error;
 	int errorOffset;
@@ -308,13 +412,12 @@ pcre* RegExp::compile()
 	pcre* pcreRE=pcre_compile2(source.raw_buf(), options,&errorcode,  &error, &errorOffset,NULL);
 	if(error)
 	{
-		if (errorcode == 64) // invalid pattern in javascript compatibility mode (we try again in normal mode to match flash behaviour)
-		{
-			options &= ~PCRE_JAVASCRIPT_COMPAT;
-			pcreRE=pcre_compile2(source.raw_buf(), options,&errorcode,  &error, &errorOffset,NULL);
-		}
+		if (errorcode == 64 && (options & PCRE_JAVASCRIPT_COMPAT)) // invalid pattern in javascript compatibility mode (we try again in normal mode to match flash behaviour)
+			pcreRE=pcre_compile2(source.raw_buf(), options & ~PCRE_JAVASCRIPT_COMPAT,&errorcode,  &error, &errorOffset,NULL);
 		if (error)
-			return NULL;
+			return NullRef;
 	}
-	return pcreRE;
+	_R<CompiledRegExp> res = _MR(new CompiledRegExp(pcreRE));
+	patterncache.insert(key,res);
+	return res;
 }
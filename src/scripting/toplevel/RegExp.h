@@ -26,12 +26,35 @@
 namespace lightspark
 {
 
+/*
+ * A compiled (and, if available, JIT compiled) pcre pattern.
+ * Instances are shared between all RegExp objects with the same source and flags
+ */
+class CompiledRegExp: public RefCountable
+{
+public:
+	pcre* re;
+	pcre_extra* extra;
+	int capturingGroups;
+	CompiledRegExp(pcre* _re);
+	~CompiledRegExp();
+	// limitRecursion restricts the recursion depth of the (non JIT) matcher
+	int exec(const tiny_string& str, int offset, int* ovector, int ovectorsize, bool limitRecursion=true);
+};
+
 class RegExp: public ASObject
 {
+private:
+	_NR<CompiledRegExp> compiledRE;
 public:
 	RegExp(Class_base* c);
 	RegExp(Class_base* c, const tiny_string& _re);
-	pcre* compile();
+	bool destruct() override;
+	void finalize() override;
+	int getPCREOptions() const;
+	_NR<CompiledRegExp> compile();
+	// returns the compiled pattern from the cache of the calling thread, compiling and adding it if necessary
+	static _NR<CompiledRegExp> getCompiledPattern(const tiny_string& source, int options);
 	static void sinit(Class_base* c);
 	static void buildTraits(ASObject* o);
 	ASObject *match(const tiny_string& str);
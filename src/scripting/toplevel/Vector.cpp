@@ -22,13 +22,102 @@
 #include "scripting/class.h"
 #include "parsing/amf3_generator.h"
 #include "scripting/argconv.h"
+#include "scripting/toplevel/JSON.h"
 #include "scripting/toplevel/XML.h"
+#include "scripting/toplevel/Integer.h"
+#include "scripting/toplevel/UInteger.h"
+#include "scripting/toplevel/Number.h"
 #include <3rdparty/pugixml/src/pugixml.hpp>
 #include <algorithm>
+#include <functional>
 
 using namespace std;
 using namespace lightspark;
 
+// conversions for the unboxed element types of numeric Vectors
+template<class T> struct VectorElement;
+template<> struct VectorElement<int32_t>
+{
+	static int32_t fromAtom(asAtom& a) { return asAtomHandler::toInt(a); }
+	static tiny_string toString(int32_t v) { return Integer::toString(v); }
+};
+template<> struct VectorElement<uint32_t>
+{
+	static uint32_t fromAtom(asAtom& a) { return asAtomHandler::toUInt(a); }
+	static tiny_string toString(uint32_t v) { return UInteger::toString(v); }
+};
+template<> struct VectorElement<number_t>
+{
+	static number_t fromAtom(asAtom& a) { return asAtomHandler::toNumber(a); }
+	static tiny_string toString(number_t v) { return Number::toString(v); }
+};
+
+template<class T>
+static void typedInsert(std::vector<T, reporter_allocator<T>>& v, uint32_t pos, asAtom* args, uint32_t count)
+{
+	// convert all values first, as the conversion may call AS code
+	std::vector<T> tmp(count);
+	for (uint32_t i = 0; i < count; i++)
+		tmp[i] = VectorElement<T>::fromAtom(args[i]);
+	v.insert(v.begin()+pos,tmp.begin(),tmp.end());
+}
+
+template<class T>
+static int32_t typedIndexOf(const std::vector<T, reporter_allocator<T>>& v, number_t value, uint32_t from)
+{
+	for (uint32_t i = from; i < v.size(); i++)
+	{
+		if (number_t(v[i]) == value)
+			return i;
+	}
+	return -1;
+}
+
+template<class T>
+static int32_t typedLastIndexOf(const std::vector<T, reporter_allocator<T>>& v, number_t value, uint32_t from)
+{
+	uint32_t i = from;
+	do
+	{
+		if (number_t(v[i]) == value)
+			return i;
+	}
+	while(i--);
+	return -1;
+}
+
+template<class T>
+static tiny_string typedJoin(const std::vector<T, reporter_allocator<T>>& v, const tiny_string& del)
+{
+	tiny_string res;
+	for (uint32_t i = 0; i < v.size(); i++)
+	{
+		if (i)
+			res += del;
+		res += VectorElement<T>::toString(v[i]);
+	}
+	return res;
+}
+
+template<class T>
+static void typedSortNumeric(std::vector<T, reporter_allocator<T>>& v, bool isDescending)
+{
+	if (isDescending)
+		std::sort(v.begin(),v.end(),std::greater<T>());
+	else
+		std::sort(v.begin(),v.end());
+}
+
+// NaNs are valid elements of a Vector.<Number>, they are moved behind all other values
+static void typedSortNumeric(std::vector<number_t, reporter_allocator<number_t>>& v, bool isDescending)
+{
+	auto end = std::stable_partition(v.begin(),v.end(),[](number_t n) { return !std::isnan(n); });
+	if (isDescending)
+		std::sort(v.begin(),end,std::greater<number_t>());
+	else
+		std::sort(v.begin(),end);
+}
+
 void Vector::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructor, CLASS_FINAL);
@@ -100,7 +189,9 @@ void Vector::sinit(Class_base* c)
 	c->prototype->setVariableByQName("unshift",nsNameAndKind(c->getSystemState(),BUILTIN_STRINGS::STRING_AS3NS,NAMESPACE),Class<IFunction>::getFunction(c->getSystemState(),unshift),CONSTANT_TRAIT);
 }
 
-Vector::Vector(Class_base* c, const Type *vtype):ASObject(c,T_OBJECT,SUBTYPE_VECTOR),vec_type(vtype),fixed(false),vec(reporter_allocator<asAtom>(c->memoryAccount))
+Vector::Vector(Class_base* c, const Type *vtype):ASObject(c,T_OBJECT,SUBTYPE_VECTOR),vec_type(vtype),fixed(false),storage(VECTOR_STORAGE_ATOM),
+	vec(reporter_allocator<asAtom>(c->memoryAccount)),vec_int(reporter_allocator<int32_t>(c->memoryAccount)),
+	vec_uint(reporter_allocator<uint32_t>(c->memoryAccount)),vec_number(reporter_allocator<number_t>(c->memoryAccount))
 {
 }
 
@@ -110,12 +201,9 @@ Vector::~Vector()
 
 bool Vector::destruct()
 {
-	for(unsigned int i=0;i<size();i++)
-	{
-		ASATOM_DECREF(vec[i]);
-	}
-	vec.clear();
+	clearElements();
 	vec_type=nullptr;
+	storage=VECTOR_STORAGE_ATOM;
 	return destructIntern();
 }
 
@@ -124,6 +212,14 @@ void Vector::setTypes(const std::vector<const Type *> &types)
 	assert(vec_type == NULL);
 	if(types.size() == 1)
 		vec_type = types[0];
+	if (vec_type == Class<Integer>::getClass(getSystemState()))
+		storage = VECTOR_STORAGE_INT;
+	else if (vec_type == Class<UInteger>::getClass(getSystemState()))
+		storage = VECTOR_STORAGE_UINT;
+	else if (vec_type == Class<Number>::getClass(getSystemState()))
+		storage = VECTOR_STORAGE_NUMBER;
+	else
+		storage = VECTOR_STORAGE_ATOM;
 }
 bool Vector::sameType(const Class_base *cls) const
 {
@@ -133,6 +229,78 @@ bool Vector::sameType(const Class_base *cls) const
 	return (clsname.startsWith(cls->class_name.getQualifiedName(getSystemState()).raw_buf()));
 }
 
+void Vector::pushElement(asAtom& o)
+{
+	switch (storage)
+	{
+		case VECTOR_STORAGE_ATOM:
+			vec.push_back(o);
+			break;
+		case VECTOR_STORAGE_INT:
+			vec_int.push_back(asAtomHandler::toInt(o));
+			ASATOM_DECREF(o);
+			break;
+		case VECTOR_STORAGE_UINT:
+			vec_uint.push_back(asAtomHandler::toUInt(o));
+			ASATOM_DECREF(o);
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			vec_number.push_back(asAtomHandler::toNumber(o));
+			ASATOM_DECREF(o);
+			break;
+	}
+}
+
+void Vector::resizeElements(uint32_t len)
+{
+	switch (storage)
+	{
+		case VECTOR_STORAGE_ATOM:
+			for(size_t i=len; i< vec.size(); ++i)
+				ASATOM_DECREF(vec[i]);
+			vec.resize(len, getDefaultValue());
+			break;
+		case VECTOR_STORAGE_INT:
+			vec_int.resize(len,0);
+			break;
+		case VECTOR_STORAGE_UINT:
+			vec_uint.resize(len,0);
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			vec_number.resize(len,0);
+			break;
+	}
+}
+
+void Vector::eraseElements(uint32_t start, uint32_t count)
+{
+	switch (storage)
+	{
+		case VECTOR_STORAGE_ATOM:
+			vec.erase(vec.begin()+start,vec.begin()+start+count);
+			break;
+		case VECTOR_STORAGE_INT:
+			vec_int.erase(vec_int.begin()+start,vec_int.begin()+start+count);
+			break;
+		case VECTOR_STORAGE_UINT:
+			vec_uint.erase(vec_uint.begin()+start,vec_uint.begin()+start+count);
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			vec_number.erase(vec_number.begin()+start,vec_number.begin()+start+count);
+			break;
+	}
+}
+
+void Vector::clearElements()
+{
+	for(auto it = vec.begin(); it != vec.end(); ++it)
+		ASATOM_DECREF(*it);
+	vec.clear();
+	vec_int.clear();
+	vec_uint.clear();
+	vec_number.clear();
+}
+
 void Vector::generator(asAtom& ret,SystemState *sys, asAtom &o_class, asAtom* args, const unsigned int argslen)
 {
 	assert_and_throw(argslen == 1);
@@ -154,7 +322,7 @@ void Vector::generator(asAtom& ret,SystemState *sys, asAtom &o_class, asAtom* ar
 			//Convert the elements of the array to the type of this vector
 			if (!type->coerce(sys,obj))
 				ASATOM_INCREF(obj);
-			res->vec.push_back(obj);
+			res->pushElement(obj);
 		}
 		res->setIsInitialized(true);
 	}
@@ -175,12 +343,14 @@ void Vector::generator(asAtom& ret,SystemState *sys, asAtom &o_class, asAtom* ar
 			//create object without calling _constructor
 			asAtomHandler::as<TemplatedClass<Vector>>(o_class)->getInstance(ret,false,nullptr,0);
 			res = asAtomHandler::as<Vector>(ret);
-			for(auto i = arg->vec.begin(); i != arg->vec.end(); ++i)
+			for(uint32_t i = 0; i < arg->size(); ++i)
 			{
-				asAtom v = *i;
-				if (!type->coerce(sys,v))
-					ASATOM_INCREF(v);
-				res->vec.push_back(v);
+				asAtom o=asAtomHandler::invalidAtom;
+				arg->getElement(o,i);
+				asAtom v = o;
+				if (type->coerce(sys,v))
+					ASATOM_DECREF(o);
+				res->pushElement(v);
 			}
 		}
 	}
@@ -200,7 +370,7 @@ ASFUNCTIONBODY_ATOM(Vector,_constructor)
 	Vector* th=asAtomHandler::as<Vector>(obj);
 	assert(th->vec_type);
 	th->fixed = fixed;
-	th->vec.resize(len, th->getDefaultValue());
+	th->resizeElements(len);
 }
 
 ASFUNCTIONBODY_ATOM(Vector,_concat)
@@ -209,14 +379,22 @@ ASFUNCTIONBODY_ATOM(Vector,_concat)
 	th->getClass()->getInstance(ret,true,nullptr,0);
 	Vector* res = asAtomHandler::as<Vector>(ret);
 	// copy values into new Vector
-	res->vec.resize(th->size(), th->getDefaultValue());
-	auto it=th->vec.begin();
-	uint32_t index = 0;
-	for(;it != th->vec.end();++it)
+	switch (th->storage)
 	{
-		res->vec[index]=*it;
-		ASATOM_INCREF(res->vec[index]);
-		index++;
+		case VECTOR_STORAGE_ATOM:
+			res->vec.assign(th->vec.begin(),th->vec.end());
+			for(auto it=res->vec.begin();it != res->vec.end();++it)
+				ASATOM_INCREF(*it);
+			break;
+		case VECTOR_STORAGE_INT:
+			res->vec_int.assign(th->vec_int.begin(),th->vec_int.end());
+			break;
+		case VECTOR_STORAGE_UINT:
+			res->vec_uint.assign(th->vec_uint.begin(),th->vec_uint.end());
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			res->vec_number.assign(th->vec_number.begin(),th->vec_number.end());
+			break;
 	}
 	//Insert the arguments in the vector
 	int pos = sys->getSwfVersion() < 11 ? argslen-1 : 0;
@@ -225,17 +403,36 @@ ASFUNCTIONBODY_ATOM(Vector,_concat)
 		if (asAtomHandler::is<Vector>(args[pos]))
 		{
 			Vector* arg=asAtomHandler::as<Vector>(args[pos]);
-			res->vec.resize(index+arg->size(), th->getDefaultValue());
-			auto it=arg->vec.begin();
-			for(;it != arg->vec.end();++it)
+			if (arg->storage == res->storage && res->storage != VECTOR_STORAGE_ATOM)
 			{
-				if (asAtomHandler::isValid(*it))
+				// numeric Vectors of the same type can be copied directly
+				switch (res->storage)
 				{
-					res->vec[index]= *it;
-					th->vec_type->coerceForTemplate(sys,res->vec[index]);
-					ASATOM_INCREF(res->vec[index]);
+					case VECTOR_STORAGE_INT:
+						res->vec_int.insert(res->vec_int.end(),arg->vec_int.begin(),arg->vec_int.end());
+						break;
+					case VECTOR_STORAGE_UINT:
+						res->vec_uint.insert(res->vec_uint.end(),arg->vec_uint.begin(),arg->vec_uint.end());
+						break;
+					case VECTOR_STORAGE_NUMBER:
+						res->vec_number.insert(res->vec_number.end(),arg->vec_number.begin(),arg->vec_number.end());
+						break;
+					default:
+						break;
+				}
+			}
+			else
+			{
+				for(uint32_t j=0;j < arg->size();j++)
+				{
+					asAtom v=asAtomHandler::invalidAtom;
+					arg->getElement(v,j);
+					if (asAtomHandler::isValid(v))
+						th->vec_type->coerceForTemplate(sys,v);
+					else
+						v = th->getDefaultValue();
+					res->pushElement(v);
 				}
-				index++;
 			}
 		}
 		else
@@ -243,8 +440,7 @@ ASFUNCTIONBODY_ATOM(Vector,_concat)
 			asAtom v = args[pos];
 			if (!th->vec_type->coerce(sys,v))
 				ASATOM_INCREF(v);
-			res->vec[index] = v;
-			index++;
+			res->pushElement(v);
 		}
 		pos += (sys->getSwfVersion() < 11 ?-1 : 1);
 	}	
@@ -267,7 +463,7 @@ ASFUNCTIONBODY_ATOM(Vector,filter)
 
 	for(unsigned int i=0;i<th->size();i++)
 	{
-		params[0] = th->vec[i];
+		th->getElement(params[0],i);
 		params[1] = asAtomHandler::fromUInt(i);
 		params[2] = asAtomHandler::fromObject(th);
 
@@ -279,15 +475,11 @@ ASFUNCTIONBODY_ATOM(Vector,filter)
 		{
 			asAtomHandler::callFunction(f,funcRet,args[1], params, 3,false);
 		}
-		if(asAtomHandler::isValid(funcRet))
-		{
-			if(asAtomHandler::Boolean_concrete(funcRet))
-			{
-				ASATOM_INCREF(th->vec[i]);
-				res->vec.push_back(th->vec[i]);
-			}
-			ASATOM_DECREF(funcRet);
-		}
+		if(asAtomHandler::isValid(funcRet) && asAtomHandler::Boolean_concrete(funcRet))
+			res->pushElement(params[0]);
+		else
+			ASATOM_DECREF(params[0]);
+		ASATOM_DECREF(funcRet);
 	}
 }
 
@@ -304,7 +496,7 @@ ASFUNCTIONBODY_ATOM(Vector, some)
 
 	for(unsigned int i=0; i < th->size(); i++)
 	{
-		params[0] = th->vec[i];
+		th->getElement(params[0],i);
 		params[1] = asAtomHandler::fromUInt(i);
 		params[2] = asAtomHandler::fromObject(th);
 
@@ -316,6 +508,7 @@ ASFUNCTIONBODY_ATOM(Vector, some)
 		{
 			asAtomHandler::callFunction(f,ret,args[1], params, 3,false);
 		}
+		ASATOM_DECREF(params[0]);
 		if(asAtomHandler::isValid(ret))
 		{
 			if(asAtomHandler::Boolean_concrete(ret))
@@ -341,9 +534,8 @@ ASFUNCTIONBODY_ATOM(Vector, every)
 
 	for(unsigned int i=0; i < th->size(); i++)
 	{
-		if (asAtomHandler::isValid(th->vec[i]))
-			params[0] = th->vec[i];
-		else
+		th->getElement(params[0],i);
+		if (asAtomHandler::isInvalid(params[0]))
 			params[0] = asAtomHandler::nullAtom;
 		params[1] = asAtomHandler::fromUInt(i);
 		params[2] = asAtomHandler::fromObject(th);
@@ -356,6 +548,7 @@ ASFUNCTIONBODY_ATOM(Vector, every)
 		{
 			asAtomHandler::callFunction(f,ret,args[1], params, 3,false);
 		}
+		ASATOM_DECREF(params[0]);
 		if(asAtomHandler::isValid(ret))
 		{
 			if (asAtomHandler::isUndefined(ret) || asAtomHandler::isNull(ret))
@@ -377,10 +570,13 @@ void Vector::append(asAtom &o)
 		ASATOM_DECREF(o);
 		throwError<RangeError>(kVectorFixedError);
 	}
-	asAtom v = o;
-	if (vec_type->coerce(getSystemState(),v))
-		ASATOM_DECREF(v);
-	vec.push_back(o);
+	if (storage == VECTOR_STORAGE_ATOM)
+	{
+		asAtom v = o;
+		if (vec_type->coerce(getSystemState(),v))
+			ASATOM_DECREF(v);
+	}
+	pushElement(o);
 }
 
 void Vector::remove(ASObject *o)
@@ -428,16 +624,33 @@ ASFUNCTIONBODY_ATOM(Vector,push)
 	Vector* th=static_cast<Vector*>(asAtomHandler::getObject(obj));
 	if (th->fixed)
 		throwError<RangeError>(kVectorFixedError);
-	for(size_t i = 0; i < argslen; ++i)
+	switch (th->storage)
 	{
-		//The proprietary player violates the specification and allows elements of any type to be pushed;
-		//they are converted to the vec_type
-		asAtom v = args[i];
-		if (!th->vec_type->coerce(sys,v))
-			ASATOM_INCREF(v);
-		th->vec.push_back(v);
+		case VECTOR_STORAGE_INT:
+			for(size_t i = 0; i < argslen; ++i)
+				th->vec_int.push_back(asAtomHandler::toInt(args[i]));
+			break;
+		case VECTOR_STORAGE_UINT:
+			for(size_t i = 0; i < argslen; ++i)
+				th->vec_uint.push_back(asAtomHandler::toUInt(args[i]));
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			for(size_t i = 0; i < argslen; ++i)
+				th->vec_number.push_back(asAtomHandler::toNumber(args[i]));
+			break;
+		default:
+			for(size_t i = 0; i < argslen; ++i)
+			{
+				//The proprietary player violates the specification and allows elements of any type to be pushed;
+				//they are converted to the vec_type
+				asAtom v = args[i];
+				if (!th->vec_type->coerce(sys,v))
+					ASATOM_INCREF(v);
+				th->vec.push_back(v);
+			}
+			break;
 	}
-	asAtomHandler::setUInt(ret,sys,(uint32_t)th->vec.size());
+	asAtomHandler::setUInt(ret,sys,th->size());
 }
 
 ASFUNCTIONBODY_ATOM(Vector,_pop)
@@ -452,13 +665,16 @@ ASFUNCTIONBODY_ATOM(Vector,_pop)
 		th->vec_type->coerce(th->getSystemState(),ret);
 		return;
 	}
-	ret = th->vec[size-1];
-	th->vec.pop_back();
+	if (th->storage == VECTOR_STORAGE_ATOM)
+		ret = th->vec[size-1];
+	else
+		th->getElement(ret,size-1);
+	th->eraseElements(size-1,1);
 }
 
 ASFUNCTIONBODY_ATOM(Vector,getLength)
 {
-	asAtomHandler::setUInt(ret,sys,(uint32_t)asAtomHandler::as<Vector>(obj)->vec.size());
+	asAtomHandler::setUInt(ret,sys,asAtomHandler::as<Vector>(obj)->size());
 }
 
 ASFUNCTIONBODY_ATOM(Vector,setLength)
@@ -468,12 +684,7 @@ ASFUNCTIONBODY_ATOM(Vector,setLength)
 		throwError<RangeError>(kVectorFixedError);
 	uint32_t len;
 	ARG_UNPACK_ATOM (len);
-	if(len <= th->vec.size())
-	{
-		for(size_t i=len; i< th->vec.size(); ++i)
-			ASATOM_DECREF(th->vec[i]);
-	}
-	th->vec.resize(len, th->getDefaultValue());
+	th->resizeElements(len);
 }
 
 ASFUNCTIONBODY_ATOM(Vector,getFixed)
@@ -502,7 +713,7 @@ ASFUNCTIONBODY_ATOM(Vector,forEach)
 
 	for(unsigned int i=0; i < th->size(); i++)
 	{
-		params[0] = th->vec[i];
+		th->getElement(params[0],i);
 		params[1] = asAtomHandler::fromUInt(i);
 		params[2] = asAtomHandler::fromObject(th);
 
@@ -515,6 +726,7 @@ ASFUNCTIONBODY_ATOM(Vector,forEach)
 		{
 			asAtomHandler::callFunction(f,funcret,args[1], params, 3,false);
 		}
+		ASATOM_DECREF(params[0]);
 		ASATOM_DECREF(funcret);
 	}
 }
@@ -523,16 +735,20 @@ ASFUNCTIONBODY_ATOM(Vector, _reverse)
 {
 	Vector* th = asAtomHandler::as<Vector>(obj);
 
-	std::vector<asAtom> tmp = std::vector<asAtom>(th->vec.begin(),th->vec.end());
-	uint32_t size = th->size();
-	th->vec.clear();
-	th->vec.resize(size, th->getDefaultValue());
-	std::vector<asAtom>::iterator it=tmp.begin();
-	uint32_t index = size-1;
-	for(;it != tmp.end();++it)
- 	{
-		th->vec[index]=*it;
-		index--;
+	switch (th->storage)
+	{
+		case VECTOR_STORAGE_ATOM:
+			std::reverse(th->vec.begin(),th->vec.end());
+			break;
+		case VECTOR_STORAGE_INT:
+			std::reverse(th->vec_int.begin(),th->vec_int.end());
+			break;
+		case VECTOR_STORAGE_UINT:
+			std::reverse(th->vec_uint.begin(),th->vec_uint.end());
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			std::reverse(th->vec_number.begin(),th->vec_number.end());
+			break;
 	}
 	th->incRef();
 	ret = asAtomHandler::fromObject(th);
@@ -545,7 +761,7 @@ ASFUNCTIONBODY_ATOM(Vector,lastIndexOf)
 	int32_t res=-1;
 	asAtom arg0=args[0];
 
-	if(th->vec.size() == 0)
+	if(th->size() == 0)
 	{
 		asAtomHandler::setInt(ret,sys,(int32_t)-1);
 		return;
@@ -577,6 +793,28 @@ ASFUNCTIONBODY_ATOM(Vector,lastIndexOf)
 				i = j;
 		}
 	}
+	if (th->storage != VECTOR_STORAGE_ATOM)
+	{
+		// only numeric values can be strictly equal to an element of a numeric Vector
+		if (asAtomHandler::isNumeric(arg0))
+		{
+			number_t value = asAtomHandler::toNumber(arg0);
+			switch (th->storage)
+			{
+				case VECTOR_STORAGE_INT:
+					res = typedLastIndexOf(th->vec_int,value,i);
+					break;
+				case VECTOR_STORAGE_UINT:
+					res = typedLastIndexOf(th->vec_uint,value,i);
+					break;
+				default:
+					res = typedLastIndexOf(th->vec_number,value,i);
+					break;
+			}
+		}
+		asAtomHandler::setInt(ret,sys,res);
+		return;
+	}
 	do
 	{
 		if (asAtomHandler::isEqualStrict(th->vec[i],th->getSystemState(),arg0))
@@ -601,18 +839,16 @@ ASFUNCTIONBODY_ATOM(Vector,shift)
 		th->vec_type->coerce(th->getSystemState(),ret);
 		return;
 	}
-	if(asAtomHandler::isValid(th->vec[0]))
+	if (th->storage != VECTOR_STORAGE_ATOM)
+		th->getElement(ret,0);
+	else if(asAtomHandler::isValid(th->vec[0]))
 		ret=th->vec[0];
 	else
 	{
 		asAtomHandler::setNull(ret);
 		th->vec_type->coerce(th->getSystemState(),ret);
 	}
-	for(uint32_t i= 1;i< th->size();i++)
-	{
-		th->vec[i-1]=th->vec[i];
-	}
-	th->vec.resize(th->size()-1, th->getDefaultValue());
+	th->eraseElements(0,1);
 }
 
 int Vector::capIndex(int i) const
@@ -659,19 +895,34 @@ ASFUNCTIONBODY_ATOM(Vector,slice)
 
 	startIndex=th->capIndex(startIndex);
 	endIndex=th->capIndex(endIndex);
+	if (endIndex < startIndex)
+		endIndex = startIndex;
 	th->getClass()->getInstance(ret,true,NULL,0);
 	Vector* res= asAtomHandler::as<Vector>(ret);
-	res->vec.resize(endIndex-startIndex, th->getDefaultValue());
-	int j = 0;
-	for(int i=startIndex; i<endIndex; i++) 
+	switch (th->storage)
 	{
-		if (asAtomHandler::isValid(th->vec[i]))
-		{
-			res->vec[j] =th->vec[i];
-			if (!th->vec_type->coerce(th->getSystemState(),th->vec[j]))
-				ASATOM_INCREF(th->vec[j]);
-		}
-		j++;
+		case VECTOR_STORAGE_ATOM:
+			res->vec.reserve(endIndex-startIndex);
+			for(int i=startIndex; i<endIndex; i++)
+			{
+				if (asAtomHandler::isValid(th->vec[i]))
+				{
+					ASATOM_INCREF(th->vec[i]);
+					res->vec.push_back(th->vec[i]);
+				}
+				else
+					res->vec.push_back(th->getDefaultValue());
+			}
+			break;
+		case VECTOR_STORAGE_INT:
+			res->vec_int.assign(th->vec_int.begin()+startIndex,th->vec_int.begin()+endIndex);
+			break;
+		case VECTOR_STORAGE_UINT:
+			res->vec_uint.assign(th->vec_uint.begin()+startIndex,th->vec_uint.begin()+endIndex);
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			res->vec_number.assign(th->vec_number.begin()+startIndex,th->vec_number.begin()+endIndex);
+			break;
 	}
 }
 
@@ -692,48 +943,52 @@ ASFUNCTIONBODY_ATOM(Vector,splice)
 
 	startIndex=th->capIndex(startIndex);
 
-	if((startIndex+deleteCount)>totalSize)
+	if(deleteCount < 0 || (startIndex+deleteCount)>totalSize)
 		deleteCount=totalSize-startIndex;
 
-	res->vec.resize(deleteCount, th->getDefaultValue());
-	if(deleteCount)
-	{
-		// write deleted items to return array
-		for(int i=0;i<deleteCount;i++)
-		{
-			res->vec[i] = th->vec[startIndex+i];
-		}
-		// delete items from current array
-		for (int i = 0; i < deleteCount; i++)
-		{
-			th->vec[startIndex+i] = th->getDefaultValue();
-		}
-	}
-	// remember items in current array that have to be moved to new position
-	vector<asAtom> tmp = vector<asAtom>(totalSize- (startIndex+deleteCount));
-	tmp.resize(totalSize- (startIndex+deleteCount), th->getDefaultValue());
-	for (int i = startIndex+deleteCount; i < totalSize ; i++)
+	// move deleted items to the returned Vector
+	switch (th->storage)
 	{
-		if (asAtomHandler::isValid(th->vec[i]))
-		{
-			tmp[i-(startIndex+deleteCount)] = th->vec[i];
-			th->vec[i] = th->getDefaultValue();
-		}
+		case VECTOR_STORAGE_ATOM:
+			res->vec.assign(th->vec.begin()+startIndex,th->vec.begin()+startIndex+deleteCount);
+			for (auto it = res->vec.begin(); it != res->vec.end(); ++it)
+			{
+				if (asAtomHandler::isInvalid(*it))
+					*it = th->getDefaultValue();
+			}
+			break;
+		case VECTOR_STORAGE_INT:
+			res->vec_int.assign(th->vec_int.begin()+startIndex,th->vec_int.begin()+startIndex+deleteCount);
+			break;
+		case VECTOR_STORAGE_UINT:
+			res->vec_uint.assign(th->vec_uint.begin()+startIndex,th->vec_uint.begin()+startIndex+deleteCount);
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			res->vec_number.assign(th->vec_number.begin()+startIndex,th->vec_number.begin()+startIndex+deleteCount);
+			break;
 	}
-	th->vec.resize(startIndex, th->getDefaultValue());
+	th->eraseElements(startIndex,deleteCount);
 
-	
 	//Insert requested values starting at startIndex
-	for(unsigned int i=2;i<argslen;i++)
-	{
-		ASATOM_INCREF(args[i]);
-		th->vec.push_back(args[i]);
-	}
-	// move remembered items to new position
-	th->vec.resize((totalSize-deleteCount)+(argslen > 2 ? argslen-2 : 0), th->getDefaultValue());
-	for(int i=0;i<totalSize- (startIndex+deleteCount);i++)
+	if (argslen > 2)
 	{
-		th->vec[startIndex+i+(argslen > 2 ? argslen-2 : 0)] = tmp[i];
+		switch (th->storage)
+		{
+			case VECTOR_STORAGE_ATOM:
+				for(unsigned int i=2;i<argslen;i++)
+					ASATOM_INCREF(args[i]);
+				th->vec.insert(th->vec.begin()+startIndex,args+2,args+argslen);
+				break;
+			case VECTOR_STORAGE_INT:
+				typedInsert(th->vec_int,startIndex,args+2,argslen-2);
+				break;
+			case VECTOR_STORAGE_UINT:
+				typedInsert(th->vec_uint,startIndex,args+2,argslen-2);
+				break;
+			case VECTOR_STORAGE_NUMBER:
+				typedInsert(th->vec_number,startIndex,args+2,argslen-2);
+				break;
+		}
 	}
 }
 
@@ -744,6 +999,20 @@ ASFUNCTIONBODY_ATOM(Vector,join)
 	tiny_string del = ",";
 	if (argslen == 1)
 		  del=asAtomHandler::toString(args[0],sys);
+	switch (th->storage)
+	{
+		case VECTOR_STORAGE_INT:
+			ret = asAtomHandler::fromObject(abstract_s(sys,typedJoin(th->vec_int,del)));
+			return;
+		case VECTOR_STORAGE_UINT:
+			ret = asAtomHandler::fromObject(abstract_s(sys,typedJoin(th->vec_uint,del)));
+			return;
+		case VECTOR_STORAGE_NUMBER:
+			ret = asAtomHandler::fromObject(abstract_s(sys,typedJoin(th->vec_number,del)));
+			return;
+		default:
+			break;
+	}
 	string res;
 	for(uint32_t i=0;i<th->size();i++)
 	{
@@ -768,13 +1037,31 @@ ASFUNCTIONBODY_ATOM(Vector,indexOf)
 		i = asAtomHandler::toInt(args[1]);
 	}
 
-	for(;i<th->size();i++)
+	switch (th->storage)
 	{
-		if(asAtomHandler::isEqualStrict(th->vec[i],th->getSystemState(),arg0))
-		{
-			res=i;
+		case VECTOR_STORAGE_ATOM:
+			for(;i<th->size();i++)
+			{
+				if(asAtomHandler::isEqualStrict(th->vec[i],th->getSystemState(),arg0))
+				{
+					res=i;
+					break;
+				}
+			}
+			break;
+		case VECTOR_STORAGE_INT:
+			// only numeric values can be strictly equal to an element of a numeric Vector
+			if (asAtomHandler::isNumeric(arg0))
+				res = typedIndexOf(th->vec_int,asAtomHandler::toNumber(arg0),i);
+			break;
+		case VECTOR_STORAGE_UINT:
+			if (asAtomHandler::isNumeric(arg0))
+				res = typedIndexOf(th->vec_uint,asAtomHandler::toNumber(arg0),i);
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			if (asAtomHandler::isNumeric(arg0))
+				res = typedIndexOf(th->vec_number,asAtomHandler::toNumber(arg0),i);
 			break;
-		}
 	}
 	asAtomHandler::setInt(ret,sys,res);
 }
@@ -788,8 +1075,12 @@ bool Vector::sortComparatorDefault::operator()(const asAtom& d1, const asAtom& d
 
 		number_t b=asAtomHandler::toNumber(o2);
 
-		if(std::isnan(a) || std::isnan(b))
+		// same as Array: only values that are not numbers can't be sorted numerically
+		if((!asAtomHandler::isNumeric(o1) && std::isnan(a)) || (!asAtomHandler::isNumeric(o2) && std::isnan(b)))
 			throw RunTimeException("Cannot sort non number with Array.NUMERIC option");
+		// NaNs are sorted behind all other values
+		if(std::isnan(a) || std::isnan(b))
+			return !std::isnan(a) && std::isnan(b);
 		if(isDescending)
 			return b>a;
 		else
@@ -881,6 +1172,71 @@ void simplequicksortVector(std::vector<asAtom>& v, Vector::sortComparatorWrapper
 	}
 }
 
+void Vector::sortElements(const asAtom& comp, bool isNumeric, bool isCaseInsensitive, bool isDescending)
+{
+	if (storage != VECTOR_STORAGE_ATOM && asAtomHandler::isInvalid(comp) && isNumeric)
+	{
+		// numeric sort of a numeric Vector can be done on the unboxed values
+		switch (storage)
+		{
+			case VECTOR_STORAGE_INT:
+				typedSortNumeric(vec_int,isDescending);
+				break;
+			case VECTOR_STORAGE_UINT:
+				typedSortNumeric(vec_uint,isDescending);
+				break;
+			default:
+				typedSortNumeric(vec_number,isDescending);
+				break;
+		}
+		return;
+	}
+	std::vector<asAtom> tmp = vector<asAtom>(size());
+	if (storage == VECTOR_STORAGE_ATOM)
+		std::copy(vec.begin(),vec.end(),tmp.begin());
+	else
+	{
+		for (uint32_t i = 0; i < tmp.size(); i++)
+			getElement(tmp[i],i);
+	}
+	
+	if(asAtomHandler::isValid(comp))
+	{
+		sortComparatorWrapper c(comp);
+		simplequicksortVector(tmp,c,0,tmp.size()-1);
+	}
+	else
+		sort(tmp.begin(),tmp.end(),sortComparatorDefault(isNumeric,isCaseInsensitive,isDescending));
+
+	//The comparator may have changed the length, the sorted elements replace the contents like vec.assign does
+	switch (storage)
+	{
+		case VECTOR_STORAGE_ATOM:
+			vec.assign(tmp.begin(),tmp.end());
+			break;
+		case VECTOR_STORAGE_INT:
+			vec_int.resize(tmp.size());
+			for (uint32_t i = 0; i < tmp.size(); i++)
+				vec_int[i] = asAtomHandler::toInt(tmp[i]);
+			break;
+		case VECTOR_STORAGE_UINT:
+			vec_uint.resize(tmp.size());
+			for (uint32_t i = 0; i < tmp.size(); i++)
+				vec_uint[i] = asAtomHandler::toUInt(tmp[i]);
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			vec_number.resize(tmp.size());
+			for (uint32_t i = 0; i < tmp.size(); i++)
+				vec_number[i] = asAtomHandler::toNumber(tmp[i]);
+			break;
+	}
+	if (storage != VECTOR_STORAGE_ATOM)
+	{
+		for (auto it = tmp.begin(); it != tmp.end(); ++it)
+			ASATOM_DECREF(*it);
+	}
+}
+
 ASFUNCTIONBODY_ATOM(Vector,_sort)
 {
 	if (argslen != 1)
@@ -908,26 +1264,7 @@ ASFUNCTIONBODY_ATOM(Vector,_sort)
 		if(options&(~(Array::NUMERIC|Array::CASEINSENSITIVE|Array::DESCENDING)))
 			throw UnsupportedException("Vector::sort not completely implemented");
 	}
-	std::vector<asAtom> tmp = vector<asAtom>(th->vec.size());
-	int i = 0;
-	for(auto it=th->vec.begin();it != th->vec.end();++it)
-	{
-		tmp[i++]= *it;
-	}
-	
-	if(asAtomHandler::isValid(comp))
-	{
-		sortComparatorWrapper c(comp);
-		simplequicksortVector(tmp,c,0,tmp.size()-1);
-	}
-	else
-		sort(tmp.begin(),tmp.end(),sortComparatorDefault(isNumeric,isCaseInsensitive,isDescending));
-
-	th->vec.clear();
-	for(auto ittmp=tmp.begin();ittmp != tmp.end();++ittmp)
-	{
-		th->vec.push_back(*ittmp);
-	}
+	th->sortElements(comp,isNumeric,isCaseInsensitive,isDescending);
 	ASATOM_INCREF(obj);
 	ret = obj;
 }
@@ -939,19 +1276,28 @@ ASFUNCTIONBODY_ATOM(Vector,unshift)
 		throwError<RangeError>(kVectorFixedError);
 	if (argslen > 0)
 	{
-		uint32_t s = th->size();
-		th->vec.resize(th->size()+argslen, th->getDefaultValue());
-		for(uint32_t i=s;i> 0;i--)
+		switch (th->storage)
 		{
-			th->vec[(i-1)+argslen]=th->vec[i-1];
-			th->vec[i-1] = th->getDefaultValue();
-		}
-		
-		for(uint32_t i=0;i<argslen;i++)
-		{
-			th->vec[i] = args[i];
-			if (!th->vec_type->coerce(th->getSystemState(),th->vec[i]))
-				ASATOM_INCREF(th->vec[i]);
+			case VECTOR_STORAGE_ATOM:
+			{
+				std::vector<asAtom> tmp(args,args+argslen);
+				for(uint32_t i=0;i<argslen;i++)
+				{
+					if (!th->vec_type->coerce(th->getSystemState(),tmp[i]))
+						ASATOM_INCREF(tmp[i]);
+				}
+				th->vec.insert(th->vec.begin(),tmp.begin(),tmp.end());
+				break;
+			}
+			case VECTOR_STORAGE_INT:
+				typedInsert(th->vec_int,0,args,argslen);
+				break;
+			case VECTOR_STORAGE_UINT:
+				typedInsert(th->vec_uint,0,args,argslen);
+				break;
+			case VECTOR_STORAGE_NUMBER:
+				typedInsert(th->vec_number,0,args,argslen);
+				break;
 		}
 	}
 	asAtomHandler::setInt(ret,sys,(int32_t)th->size());
@@ -973,14 +1319,16 @@ ASFUNCTIONBODY_ATOM(Vector,_map)
 	for(uint32_t i=0;i<th->size();i++)
 	{
 		asAtom funcArgs[3];
-		funcArgs[0]=th->vec[i];
+		th->getElement(funcArgs[0],i);
 		funcArgs[1]=asAtomHandler::fromUInt(i);
 		funcArgs[2]=asAtomHandler::fromObject(th);
 		asAtom funcRet=asAtomHandler::invalidAtom;
 		asAtomHandler::callFunction(func,funcRet,thisObject, funcArgs, 3,false);
+		ASATOM_DECREF(funcArgs[0]);
 		assert_and_throw(asAtomHandler::isValid(funcRet));
-		ASATOM_INCREF(funcRet);
-		res->vec.push_back(funcRet);
+		if (res->storage == VECTOR_STORAGE_ATOM)
+			ASATOM_INCREF(funcRet);
+		res->pushElement(funcRet);
 	}
 
 	ret = asAtomHandler::fromObject(res);
@@ -990,6 +1338,11 @@ ASFUNCTIONBODY_ATOM(Vector,_toString)
 {
 	tiny_string res;
 	Vector* th = asAtomHandler::as<Vector>(obj);
+	if (th->storage != VECTOR_STORAGE_ATOM)
+	{
+		ret = asAtomHandler::fromObject(abstract_s(th->getSystemState(),th->toString()));
+		return;
+	}
 	for(size_t i=0; i < th->vec.size(); ++i)
 	{
 		if (asAtomHandler::isValid(th->vec[i]))
@@ -1017,19 +1370,27 @@ ASFUNCTIONBODY_ATOM(Vector,insertAt)
 	asAtom o=asAtomHandler::invalidAtom;
 	ARG_UNPACK_ATOM(index)(o);
 
-	if (index < 0 && th->vec.size() >= (uint32_t)(-index))
-		index = th->vec.size()+(index);
+	if (index < 0 && th->size() >= (uint32_t)(-index))
+		index = th->size()+(index);
 	if (index < 0)
 		index = 0;
-	if ((uint32_t)index >= th->vec.size())
+	if ((uint32_t)index > th->size())
+		index = th->size();
+	switch (th->storage)
 	{
-		ASATOM_INCREF(o);
-		th->vec.push_back(o);
-	}
-	else
-	{
-		ASATOM_INCREF(o);
-		th->vec.insert(th->vec.begin()+index,o);
+		case VECTOR_STORAGE_ATOM:
+			ASATOM_INCREF(o);
+			th->vec.insert(th->vec.begin()+index,o);
+			break;
+		case VECTOR_STORAGE_INT:
+			typedInsert(th->vec_int,index,&o,1);
+			break;
+		case VECTOR_STORAGE_UINT:
+			typedInsert(th->vec_uint,index,&o,1);
+			break;
+		case VECTOR_STORAGE_NUMBER:
+			typedInsert(th->vec_number,index,&o,1);
+			break;
 	}
 }
 
@@ -1041,13 +1402,16 @@ ASFUNCTIONBODY_ATOM(Vector,removeAt)
 	int32_t index;
 	ARG_UNPACK_ATOM(index);
 	if (index < 0)
-		index = th->vec.size()+index;
+		index = th->size()+index;
 	if (index < 0)
 		index = 0;
-	if ((uint32_t)index < th->vec.size())
+	if ((uint32_t)index < th->size())
 	{
-		ret = th->vec[index];
-		th->vec.erase(th->vec.begin()+index);
+		if (th->storage == VECTOR_STORAGE_ATOM)
+			ret = th->vec[index];
+		else
+			th->getElement(ret,index);
+		th->eraseElements(index,1);
 	}
 	else
 		throwError<RangeError>(kOutOfRangeError);
@@ -1065,7 +1429,7 @@ bool Vector::hasPropertyByMultiname(const multiname& name, bool considerDynamic,
 	if(!Vector::isValidMultiname(getSystemState(),name,index))
 		return ASObject::hasPropertyByMultiname(name, considerDynamic, considerPrototype);
 
-	if(index < vec.size())
+	if(index < size())
 		return true;
 	else
 		return false;
@@ -1087,32 +1451,32 @@ GET_VARIABLE_RESULT Vector::getVariableByMultiname(asAtom& ret, const multiname&
 
 	unsigned int index=0;
 	bool isNumber =false;
-	if(!Vector::isValidMultiname(getSystemState(),name,index,&isNumber) || index > vec.size())
+	if(!Vector::isValidMultiname(getSystemState(),name,index,&isNumber) || index > size())
 	{
 		switch(name.name_type) 
 		{
 			case multiname::NAME_NUMBER:
 				if (getSystemState()->getSwfVersion() >= 11 
 						|| (uint32_t(name.name_d) == name.name_d && name.name_d < UINT32_MAX))
-					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				else
 					throwError<ReferenceError>(kReadSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				break;
 			case multiname::NAME_INT:
 				if (getSystemState()->getSwfVersion() >= 11
-						|| name.name_i >= (int32_t)vec.size())
-					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+						|| name.name_i >= (int32_t)size())
+					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				else
 					throwError<ReferenceError>(kReadSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				break;
 			case multiname::NAME_UINT:
-				throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+				throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				break;
 			case multiname::NAME_STRING:
 				if (isNumber)
 				{
 					if (getSystemState()->getSwfVersion() >= 11 )
-						throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+						throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 					else
 						throwError<ReferenceError>(kReadSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				}
@@ -1126,8 +1490,14 @@ GET_VARIABLE_RESULT Vector::getVariableByMultiname(asAtom& ret, const multiname&
 			throwError<ReferenceError>(kReadSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 		return res;
 	}
-	if(index < vec.size())
+	if(index < size())
 	{
+		if (storage != VECTOR_STORAGE_ATOM)
+		{
+			// unboxed values are always returned as new atoms
+			getElement(ret,index);
+			return GET_VARIABLE_RESULT::GETVAR_ISNEWOBJECT;
+		}
 		ret = vec[index];
 		if (!(opt & NO_INCREF))
 			ASATOM_INCREF(ret);
@@ -1136,7 +1506,7 @@ GET_VARIABLE_RESULT Vector::getVariableByMultiname(asAtom& ret, const multiname&
 	{
 		throwError<RangeError>(kOutOfRangeError,
 				       Integer::toString(index),
-				       Integer::toString(vec.size()));
+				       Integer::toString(size()));
 	}
 	return GET_VARIABLE_RESULT::GETVAR_NORMAL;
 }
@@ -1144,6 +1514,11 @@ GET_VARIABLE_RESULT Vector::getVariableByInteger(asAtom &ret, int index, GET_VAR
 {
 	if (index >=0 && uint32_t(index) < size())
 	{
+		if (storage != VECTOR_STORAGE_ATOM)
+		{
+			getElement(ret,index);
+			return GET_VARIABLE_RESULT::GETVAR_ISNEWOBJECT;
+		}
 		ret = vec[index];
 		if (!(opt & NO_INCREF))
 			ASATOM_INCREF(ret);
@@ -1166,20 +1541,20 @@ multiname *Vector::setVariableByMultiname(multiname& name, asAtom& o, CONST_ALLO
 		{
 			case multiname::NAME_NUMBER:
 				if (getSystemState()->getSwfVersion() >= 11 
-						|| (this->fixed && ((int32_t(name.name_d) != name.name_d) || name.name_d >= (int32_t)vec.size() || name.name_d < 0)))
-					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+						|| (this->fixed && ((int32_t(name.name_d) != name.name_d) || name.name_d >= (int32_t)size() || name.name_d < 0)))
+					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				else
 					throwError<ReferenceError>(kWriteSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				break;
 			case multiname::NAME_INT:
 				if (getSystemState()->getSwfVersion() >= 11
-						|| (this->fixed && (name.name_i >= (int32_t)vec.size() || name.name_i < 0)))
-					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+						|| (this->fixed && (name.name_i >= (int32_t)size() || name.name_i < 0)))
+					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				else
 					throwError<ReferenceError>(kWriteSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				break;
 			case multiname::NAME_UINT:
-				throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+				throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				break;
 			default:
 				break;
@@ -1189,34 +1564,18 @@ multiname *Vector::setVariableByMultiname(multiname& name, asAtom& o, CONST_ALLO
 			throwError<ReferenceError>(kWriteSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 		return ASObject::setVariableByMultiname(name, o, allowConst,alreadyset);
 	}
-	asAtom v = o;
-	if (this->vec_type->coerce(getSystemState(), v))
-		ASATOM_DECREF(v);
-	if(index < vec.size())
+	if (storage == VECTOR_STORAGE_ATOM)
 	{
-		if (vec[index].uintval == o.uintval)
-		{
-			if (alreadyset)
-				*alreadyset = true;
-		}
-		else
+		asAtom v = o;
+		if (this->vec_type->coerce(getSystemState(), v))
+			ASATOM_DECREF(v);
+		if (alreadyset && index < vec.size() && vec[index].uintval == o.uintval)
 		{
-			ASATOM_DECREF(vec[index]);
-			vec[index] = o;
+			*alreadyset = true;
+			return nullptr;
 		}
 	}
-	else if(!fixed && index == vec.size())
-	{
-		vec.push_back( o );
-	}
-	else
-	{
-		/* Spec says: one may not set a value with an index more than
-		 * one beyond the current final index. */
-		throwError<RangeError>(kOutOfRangeError,
-				       Integer::toString(index),
-				       Integer::toString(vec.size()));
-	}
+	setElement(index,o);
 	return nullptr;
 }
 
@@ -1227,42 +1586,37 @@ void Vector::setVariableByInteger(int index, asAtom &o, ASObject::CONST_ALLOWED_
 		setVariableByInteger_intern(index,o,allowConst);
 		return;
 	}
-	asAtom v = o;
-	if (this->vec_type->coerce(getSystemState(), v))
-		ASATOM_DECREF(v);
-	if(size_t(index) < vec.size())
+	if (storage == VECTOR_STORAGE_ATOM)
 	{
-		if (vec[index].uintval != o.uintval)
-		{
-			ASATOM_DECREF(vec[index]);
-			vec[index] = o;
-		}
-	}
-	else if(!fixed && size_t(index) == vec.size())
-	{
-		vec.push_back( o );
-	}
-	else
-	{
-		/* Spec says: one may not set a value with an index more than
-		 * one beyond the current final index. */
-		throwError<RangeError>(kOutOfRangeError,
-				       Integer::toString(index),
-				       Integer::toString(vec.size()));
+		asAtom v = o;
+		if (this->vec_type->coerce(getSystemState(), v))
+			ASATOM_DECREF(v);
 	}
+	setElement(index,o);
 }
 
-void Vector::throwRangeError(int index)
+void Vector::throwRangeError(int index) const
 {
 	/* Spec says: one may not set a value with an index more than
 	 * one beyond the current final index. */
 	throwError<RangeError>(kOutOfRangeError,
 				   Integer::toString(index),
-				   Integer::toString(vec.size()));
+				   Integer::toString(size()));
 }
 
 tiny_string Vector::toString()
 {
+	switch (storage)
+	{
+		case VECTOR_STORAGE_INT:
+			return typedJoin(vec_int,",");
+		case VECTOR_STORAGE_UINT:
+			return typedJoin(vec_uint,",");
+		case VECTOR_STORAGE_NUMBER:
+			return typedJoin(vec_number,",");
+		default:
+			break;
+	}
 	//TODO: test
 	tiny_string t;
 	for(size_t i = 0; i < vec.size(); ++i)
@@ -1276,7 +1630,7 @@ tiny_string Vector::toString()
 
 uint32_t Vector::nextNameIndex(uint32_t cur_index)
 {
-	if(cur_index < vec.size())
+	if(cur_index < size())
 		return cur_index+1;
 	else
 		return 0;
@@ -1284,7 +1638,7 @@ uint32_t Vector::nextNameIndex(uint32_t cur_index)
 
 void Vector::nextName(asAtom& ret,uint32_t index)
 {
-	if(index<=vec.size())
+	if(index<=size())
 		asAtomHandler::setUInt(ret,this->getSystemState(),index-1);
 	else
 		throw RunTimeException("Vector::nextName out of bounds");
@@ -1292,11 +1646,8 @@ void Vector::nextName(asAtom& ret,uint32_t index)
 
 void Vector::nextValue(asAtom& ret,uint32_t index)
 {
-	if(index<=vec.size())
-	{
-		ASATOM_INCREF(vec[index-1]);
-		ret = vec[index-1];
-	}
+	if(index<=size())
+		getElement(ret,index-1);
 	else
 		throw RunTimeException("Vector::nextValue out of bounds");
 }
@@ -1314,65 +1665,111 @@ bool Vector::isValidMultiname(SystemState* sys,const multiname& name, uint32_t&
 	return validIndex;
 }
 
-tiny_string Vector::toJSON(std::vector<ASObject *> &path, asAtom replacer, const tiny_string &spaces, const tiny_string &filter)
+void Vector::toJSON(JSONStringifier& s, const tiny_string& indent)
 {
-	bool ok;
-	tiny_string res = call_toJSON(ok,path,replacer,spaces,filter);
-	if (ok)
-		return res;
-	// check for cylic reference
-	if (std::find(path.begin(),path.end(), this) != path.end())
-		throwError<TypeError>(kJSONCyclicStructure);
-
-	path.push_back(this);
-	res += "[";
-	bool bfirst = true;
-	tiny_string newline = (spaces.empty() ? "" : "\n");
-	asAtom closure = asAtomHandler::isValid(replacer) && asAtomHandler::getClosure(replacer) ? asAtomHandler::fromObject(asAtomHandler::getClosure(replacer)) : asAtomHandler::nullAtom;
-	for (unsigned int i =0;  i < vec.size(); i++)
-	{
-		tiny_string subres;
-		asAtom o = vec[i];
-		if (asAtomHandler::isValid(replacer))
-		{
-			asAtom params[2];
-			
-			params[0] = asAtomHandler::fromUInt(i);
-			params[1] = o;
-			asAtom funcret=asAtomHandler::invalidAtom;
-			asAtomHandler::callFunction(replacer,funcret,closure, params, 2,false);
-			if (asAtomHandler::isValid(funcret))
-				subres = asAtomHandler::toObject(funcret,getSystemState())->toJSON(path,asAtomHandler::invalidAtom,spaces,filter);
-		}
-		else
-		{
-			subres = asAtomHandler::toObject(o,getSystemState())->toJSON(path,replacer,spaces,filter);
-		}
-		if (!subres.empty())
-		{
-			if (!bfirst)
-				res += ",";
-			res += newline+spaces;
-			
-			bfirst = false;
-			res += subres;
-		}
+	tiny_string inner = s.getGap().empty() ? indent : indent+s.getGap();
+	s.out += '[';
+	uint32_t len = size();
+	for (uint32_t i =0;  i < len; i++)
+	{
+		asAtom o=asAtomHandler::invalidAtom;
+		getElement(o,i);
+		if (i > 0)
+			s.out += ',';
+		s.writeNewline(inner);
+		if (!s.writeProperty(this,asAtomHandler::fromUInt(i),o,inner))
+			s.out += "null";
+		ASATOM_DECREF(o);
 	}
-	if (!bfirst)
-		res += newline+spaces.substr_bytes(0,spaces.numBytes()/2);
-	res += "]";
-	path.pop_back();
-	return res;
+	if (len > 0)
+		s.writeNewline(indent);
+	s.out += ']';
 }
 
 asAtom Vector::at(unsigned int index, asAtom defaultValue) const
 {
+	assert(storage == VECTOR_STORAGE_ATOM);
 	if (index < vec.size())
 		return vec.at(index);
 	else
 		return defaultValue;
 }
 
+number_t Vector::getNumberAt(unsigned int index) const
+{
+	if (index >= size())
+		throwRangeError(index);
+	return getNumberAt(index,0);
+}
+
+int32_t Vector::getIntAt(unsigned int index) const
+{
+	if (index >= size())
+		throwRangeError(index);
+	return getIntAt(index,0);
+}
+
+uint32_t Vector::getUIntAt(unsigned int index) const
+{
+	if (index >= size())
+		throwRangeError(index);
+	return getUIntAt(index,0);
+}
+
+number_t Vector::getNumberAt(unsigned int index, number_t defaultValue) const
+{
+	if (index >= size())
+		return defaultValue;
+	switch (storage)
+	{
+		case VECTOR_STORAGE_INT:
+			return vec_int[index];
+		case VECTOR_STORAGE_UINT:
+			return vec_uint[index];
+		case VECTOR_STORAGE_NUMBER:
+			return vec_number[index];
+		default:
+			return asAtomHandler::toNumber(vec[index]);
+	}
+}
+
+int32_t Vector::getIntAt(unsigned int index, int32_t defaultValue) const
+{
+	if (index >= size())
+		return defaultValue;
+	switch (storage)
+	{
+		case VECTOR_STORAGE_INT:
+			return vec_int[index];
+		case VECTOR_STORAGE_UINT:
+			return vec_uint[index];
+		case VECTOR_STORAGE_NUMBER:
+			return Number::toInt(vec_number[index]);
+		default:
+			return asAtomHandler::toInt(vec[index]);
+	}
+}
+
+uint32_t Vector::getUIntAt(unsigned int index, uint32_t defaultValue) const
+{
+	if (index >= size())
+		return defaultValue;
+	switch (storage)
+	{
+		case VECTOR_STORAGE_INT:
+			return vec_int[index];
+		case VECTOR_STORAGE_UINT:
+			return vec_uint[index];
+		case VECTOR_STORAGE_NUMBER:
+			return (uint32_t)Number::toInt(vec_number[index]);
+		default:
+		{
+			asAtom a = vec[index];
+			return asAtomHandler::toUInt(a);
+		}
+	}
+}
+
 void Vector::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
 				std::map<const ASObject*, uint32_t>& objMap,
 				std::map<const Class_base*, uint32_t>& traitsMap)
@@ -1413,6 +1810,25 @@ void Vector::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMa
 		{
 			out->writeStringVR(stringMap,vec_type->getName());
 		}
+		if (storage != VECTOR_STORAGE_ATOM)
+		{
+			for(uint32_t i=0;i<count;i++)
+			{
+				switch (storage)
+				{
+					case VECTOR_STORAGE_INT:
+						out->writeUnsignedInt(out->endianIn((uint32_t)vec_int[i]));
+						break;
+					case VECTOR_STORAGE_UINT:
+						out->writeUnsignedInt(out->endianIn(vec_uint[i]));
+						break;
+					default:
+						out->serializeDouble(vec_number[i]);
+						break;
+				}
+			}
+			return;
+		}
 		for(uint32_t i=0;i<count;i++)
 		{
 			if (asAtomHandler::isInvalid(vec[i]))
@@ -28,9 +28,16 @@ namespace lightspark
 template<class T> class TemplatedClass;
 class Vector: public ASObject
 {
+	// Vectors of int, uint and Number store their elements unboxed in
+	// vec_int/vec_uint/vec_number, all other Vectors use vec
+	enum VECTOR_STORAGE { VECTOR_STORAGE_ATOM=0, VECTOR_STORAGE_INT, VECTOR_STORAGE_UINT, VECTOR_STORAGE_NUMBER };
 	const Type* vec_type;
 	bool fixed;
+	VECTOR_STORAGE storage;
 	std::vector<asAtom, reporter_allocator<asAtom>> vec;
+	std::vector<int32_t, reporter_allocator<int32_t>> vec_int;
+	std::vector<uint32_t, reporter_allocator<uint32_t>> vec_uint;
+	std::vector<number_t, reporter_allocator<number_t>> vec_number;
 	int capIndex(int i) const;
 	class sortComparatorDefault
 	{
@@ -43,6 +50,65 @@ class Vector: public ASObject
 		bool operator()(const asAtom& d1, const asAtom& d2);
 	};
 	asAtom getDefaultValue();
+	template<class T>
+	FORCE_INLINE void setTypedElement(std::vector<T, reporter_allocator<T>>& v, uint32_t index, T value)
+	{
+		if(index < v.size())
+			v[index] = value;
+		else if(!fixed && index == v.size())
+			v.push_back(value);
+		else
+			throwRangeError(index);
+	}
+	//Stores an already coerced value at index, takes ownership of o
+	FORCE_INLINE void setElement(uint32_t index, asAtom& o)
+	{
+		switch (storage)
+		{
+			case VECTOR_STORAGE_ATOM:
+				if(index < vec.size())
+				{
+					if (vec[index].uintval != o.uintval)
+					{
+						ASATOM_DECREF(vec[index]);
+						vec[index] = o;
+					}
+				}
+				else if(!fixed && index == vec.size())
+					vec.push_back(o);
+				else
+					throwRangeError(index);
+				break;
+			case VECTOR_STORAGE_INT:
+			{
+				int32_t v = asAtomHandler::toInt(o);
+				ASATOM_DECREF(o);
+				setTypedElement(vec_int,index,v);
+				break;
+			}
+			case VECTOR_STORAGE_UINT:
+			{
+				uint32_t v = asAtomHandler::toUInt(o);
+				ASATOM_DECREF(o);
+				setTypedElement(vec_uint,index,v);
+				break;
+			}
+			case VECTOR_STORAGE_NUMBER:
+			{
+				number_t v = asAtomHandler::toNumber(o);
+				ASATOM_DECREF(o);
+				setTypedElement(vec_number,index,v);
+				break;
+			}
+		}
+	}
+	//Appends an already coerced value, takes ownership of o
+	void pushElement(asAtom& o);
+	void resizeElements(uint32_t len);
+	//Removes count elements starting at start, without releasing them
+	void eraseElements(uint32_t start, uint32_t count);
+	void clearElements();
+	void sortElements(const asAtom& comp, bool isNumeric, bool isCaseInsensitive, bool isDescending);
 public:
 	class sortComparatorWrapper
 	{
@@ -75,38 +141,51 @@ public:
 			setVariableByInteger_intern(index,o,ASObject::CONST_ALLOWED);
 			return;
 		}
-		if(size_t(index) < vec.size())
-		{
-			if (vec[index].uintval != o.uintval)
-			{
-				ASATOM_DECREF(vec[index]);
-				vec[index] = o;
-			}
-		}
-		else if(!fixed && size_t(index) == vec.size())
-		{
-			vec.push_back( o );
-		}
-		else
-		{
-			throwRangeError(index);
-		}
+		setElement(index,o);
 	}
-	void throwRangeError(int index);
+	void throwRangeError(int index) const;
 	
 	bool hasPropertyByMultiname(const multiname& name, bool considerDynamic, bool considerPrototype) override;
 	GET_VARIABLE_RESULT getVariableByMultiname(asAtom& ret, const multiname& name, GET_VARIABLE_OPTION opt) override;
 	GET_VARIABLE_RESULT getVariableByInteger(asAtom& ret, int index, GET_VARIABLE_OPTION opt) override;
+	//ret is owned by the caller
 	FORCE_INLINE void getVariableByIntegerDirect(asAtom& ret, int index)
 	{
 		if (index >=0 && uint32_t(index) < size())
-			ret = vec[index];
+			getElement(ret,index);
 		else
 			getVariableByIntegerIntern(ret,index);
 	}
+	//Gets the element at index (which has to be valid), ret is owned by the caller
+	FORCE_INLINE void getElement(asAtom& ret, uint32_t index) const
+	{
+		switch (storage)
+		{
+			case VECTOR_STORAGE_ATOM:
+				ret = vec[index];
+				ASATOM_INCREF(ret);
+				break;
+			case VECTOR_STORAGE_INT:
+				asAtomHandler::setInt(ret,getSystemState(),vec_int[index]);
+				break;
+			case VECTOR_STORAGE_UINT:
+				asAtomHandler::setUInt(ret,getSystemState(),vec_uint[index]);
+				break;
+			case VECTOR_STORAGE_NUMBER:
+			{
+				number_t v = vec_number[index];
+				// integral values don't need a Number object
+				if (v >= INT32_MIN && v <= INT32_MAX && v == (int32_t)v && !(v == 0 && std::signbit(v)))
+					asAtomHandler::setInt(ret,getSystemState(),(int32_t)v);
+				else
+					asAtomHandler::setNumber(ret,getSystemState(),v);
+				break;
+			}
+		}
+	}
 	static bool isValidMultiname(SystemState* sys, const multiname& name, uint32_t& index, bool *isNumber = nullptr);
 
-	tiny_string toJSON(std::vector<ASObject *> &path, asAtom replacer, const tiny_string &spaces,const tiny_string& filter) override;
+	void toJSON(JSONStringifier& s, const tiny_string& indent) override;
 
 	uint32_t nextNameIndex(uint32_t cur_index) override;
 	void nextName(asAtom &ret, uint32_t index) override;
@@ -114,20 +193,43 @@ public:
 
 	uint32_t size() const
 	{
-		return vec.size();
+		switch (storage)
+		{
+			case VECTOR_STORAGE_INT:
+				return vec_int.size();
+			case VECTOR_STORAGE_UINT:
+				return vec_uint.size();
+			case VECTOR_STORAGE_NUMBER:
+				return vec_number.size();
+			default:
+				return vec.size();
+		}
 	}
+	//Only valid for Vectors of objects, use getNumberAt/getIntAt for numeric Vectors.
+	//Throws a RangeError if index is out-of-range
 	asAtom at(unsigned int index) const
 	{
-		return vec.at(index);
+		assert(storage == VECTOR_STORAGE_ATOM);
+		if (index >= vec.size())
+			throwRangeError(index);
+		return vec[index];
 	}
 	void set(uint32_t index, asAtom v)
 	{
 		if (index < size())
-			vec[index] = v;
+			setElement(index,v);
 	}
 	//Get value at index, or return defaultValue (a borrowed
 	//reference) if index is out-of-range
 	asAtom at(unsigned int index, asAtom defaultValue) const;
+	//Numeric value at index, throws a RangeError if index is out-of-range
+	number_t getNumberAt(unsigned int index) const;
+	int32_t getIntAt(unsigned int index) const;
+	uint32_t getUIntAt(unsigned int index) const;
+	//Numeric value at index, or defaultValue if index is out-of-range
+	number_t getNumberAt(unsigned int index, number_t defaultValue) const;
+	int32_t getIntAt(unsigned int index, int32_t defaultValue) const;
+	uint32_t getUIntAt(unsigned int index, uint32_t defaultValue) const;
 
 	//Appends an object to the Vector. o is coerced to vec_type.
 	//Takes ownership of o.
@@ -63,12 +63,16 @@ XML::XML(Class_base* c, const pugi::xml_node& _n, XML* parent, bool fromXMLList)
 
 bool XML::destruct()
 {
+	//Descendants that are not created yet resolve their prefixes through this node, which is about to be cleared
+	materializeSurvivingDescendants();
 	xmldoc.reset();
 	parentNode=nullptr;
 	nodetype =(pugi::xml_node_type)0;
 	isAttribute = false;
 	constructed = false;
 	childrenlist.reset();
+	lazynode=pugi::xml_node();
+	source.reset();
 	nodename.clear();
 	nodevalue.clear();
 	nodenamespace_uri=BUILTIN_STRINGS::EMPTY;
@@ -401,9 +405,9 @@ void XML::appendChild(_R<XML> newChild)
 			node = node->parentNode;
 		}
 		this->incRef();
-		newChild->parentNode = this;
+		newChild->setParentNode(this);
 		newChild->incRef();
-		childrenlist->append(newChild);
+		getChildNodes()->append(newChild);
 		handleNotification("nodeAdded",asAtomHandler::fromObject(newChild.getPtr()),asAtomHandler::nullAtom);
 	}
 }
@@ -424,9 +428,9 @@ ASFUNCTIONBODY_ATOM(XML,attribute)
 
 	XMLVector tmp;
 	XMLList* res = XMLList::create(sys,tmp,th->getChildrenlist(),multiname(nullptr));
-	if (!th->attributelist.isNull())
+	if (!th->getAttributeNodes().isNull())
 	{
-		for (XMLList::XMLListVector::const_iterator it = th->attributelist->nodes.begin(); it != th->attributelist->nodes.end(); it++)
+		for (XMLList::XMLListVector::const_iterator it = th->getAttributeNodes()->nodes.begin(); it != th->getAttributeNodes()->nodes.end(); it++)
 		{
 			_R<XML> attr = *it;
 			if (attr->nodenamespace_uri == tmpns && (attrname== "*" || attr->nodename == attrname))
@@ -446,8 +450,8 @@ ASFUNCTIONBODY_ATOM(XML,attributes)
 
 XMLList* XML::getAllAttributes()
 {
-	attributelist->incRef();
-	return attributelist.getPtr();
+	getAttributeNodes()->incRef();
+	return getAttributeNodes().getPtr();
 }
 
 const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefix, const char *indent,bool bfirst)
@@ -662,9 +666,9 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 					res += getVm(getSystemState())->getDefaultXMLNamespace();
 					res += "\"";
 				}
-				if (!attributelist.isNull())
+				if (!getAttributeNodes().isNull())
 				{
-					for (XMLList::XMLListVector::const_iterator it = attributelist->nodes.begin(); it != attributelist->nodes.end(); it++)
+					for (XMLList::XMLListVector::const_iterator it = getAttributeNodes()->nodes.begin(); it != getAttributeNodes()->nodes.end(); it++)
 					{
 						_R<XML> attr = *it;
 						res += " ";
@@ -679,7 +683,7 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 						res += "\"";
 					}
 				}
-				if (childrenlist.isNull() || childrenlist->nodes.size() == 0)
+				if (getChildNodes().isNull() || getChildNodes()->nodes.size() == 0)
 				{
 					res += "/>";
 					break;
@@ -687,10 +691,10 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 				res += ">";
 				tiny_string newindent;
 				bool bindent = (pretty && prettyPrinting && prettyIndent >=0 && 
-								!childrenlist.isNull() &&
-								(childrenlist->nodes.size() >1 || 
-								 (!childrenlist->nodes[0]->procinstlist.isNull()) ||
-								 (childrenlist->nodes[0]->nodetype != pugi::node_pcdata && childrenlist->nodes[0]->nodetype != pugi::node_cdata)));
+								!getChildNodes().isNull() &&
+								(getChildNodes()->nodes.size() >1 || 
+								 (!getChildNodes()->nodes[0]->procinstlist.isNull()) ||
+								 (getChildNodes()->nodes[0]->nodetype != pugi::node_pcdata && getChildNodes()->nodes[0]->nodetype != pugi::node_cdata)));
 				if (bindent)
 				{
 					newindent = indent;
@@ -699,11 +703,11 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 						newindent += " ";
 					}
 				}
-				if (!childrenlist.isNull())
+				if (!getChildNodes().isNull())
 				{
-					for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+					for (uint32_t i = 0; i < getChildNodes()->nodes.size(); i++)
 					{
-						_R<XML> child= childrenlist->nodes[i];
+						_R<XML> child= getChildNodes()->nodes[i];
 						tiny_string tmpres = child->toXMLString_internal(pretty,defaultnsprefix,newindent.raw_buf(),false);
 						if (bindent && !tmpres.empty())
 							res += "\n";
@@ -748,11 +752,11 @@ ASFUNCTIONBODY_ATOM(XML,toXMLString)
 
 void XML::childrenImpl(XMLVector& ret, const tiny_string& name)
 {
-	if (!childrenlist.isNull())
+	if (!getChildNodes().isNull())
 	{
-		for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+		for (uint32_t i = 0; i < getChildNodes()->nodes.size(); i++)
 		{
-			_R<XML> child= childrenlist->nodes[i];
+			_R<XML> child= getChildNodes()->nodes[i];
 			if(name!="*" && child->nodename != name)
 				continue;
 			ret.push_back(child);
@@ -762,9 +766,9 @@ void XML::childrenImpl(XMLVector& ret, const tiny_string& name)
 
 void XML::childrenImpl(XMLVector& ret, uint32_t index)
 {
-	if (constructed && !childrenlist.isNull() && index < childrenlist->nodes.size())
+	if (constructed && !getChildNodes().isNull() && index < getChildNodes()->nodes.size())
 	{
-		_R<XML> child= childrenlist->nodes[index];
+		_R<XML> child= getChildNodes()->nodes[index];
 		ret.push_back(child);
 	}
 }
@@ -806,12 +810,12 @@ ASFUNCTIONBODY_ATOM(XML,children)
 ASFUNCTIONBODY_ATOM(XML,childIndex)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
-	if (th->parentNode && !th->parentNode->childrenlist.isNull())
+	if (th->parentNode && !th->parentNode->getChildNodes().isNull())
 	{
 		XML* parent = th->parentNode;
-		for (uint32_t i = 0; i < parent->childrenlist->nodes.size(); i++)
+		for (uint32_t i = 0; i < parent->getChildNodes()->nodes.size(); i++)
 		{
-			ASObject* o= parent->childrenlist->nodes[i].getPtr();
+			ASObject* o= parent->getChildNodes()->nodes[i].getPtr();
 			if (o == th)
 			{
 				asAtomHandler::setUInt(ret,sys,i);
@@ -842,11 +846,11 @@ ASFUNCTIONBODY_ATOM(XML,valueOf)
 
 void XML::getText(XMLVector& ret)
 {
-	if (childrenlist.isNull())
+	if (getChildNodes().isNull())
 		return;
-	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+	for (uint32_t i = 0; i < getChildNodes()->nodes.size(); i++)
 	{
-		_R<XML> child= childrenlist->nodes[i];
+		_R<XML> child= getChildNodes()->nodes[i];
 		if (child->getNodeKind() == pugi::node_pcdata  ||
 			child->getNodeKind() == pugi::node_cdata)
 		{
@@ -879,11 +883,11 @@ ASFUNCTIONBODY_ATOM(XML,elements)
 
 void XML::getElementNodes(const tiny_string& name, XMLVector& foundElements)
 {
-	if (childrenlist.isNull())
+	if (getChildNodes().isNull())
 		return;
-	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+	for (uint32_t i = 0; i < getChildNodes()->nodes.size(); i++)
 	{
-		_R<XML> child= childrenlist->nodes[i];
+		_R<XML> child= getChildNodes()->nodes[i];
 		if(child->nodetype==pugi::node_element && (name.empty() || name == child->nodename))
 		{
 			foundElements.push_back( child );
@@ -941,6 +945,8 @@ ASFUNCTIONBODY_ATOM(XML,addNamespace)
 	}
 	else
 		ns_uri = th->getSystemState()->getUniqueStringId(newNamespace->toString());
+	//The namespaces of the descendants not created yet depend on the declarations of their ancestors
+	th->materializeTree();
 	if (th->nodenamespace_prefix == ns_prefix)
 		th->nodenamespace_prefix=BUILTIN_STRINGS::EMPTY;
 	for (uint32_t i = 0; i < th->namespacedefs.size(); i++)
@@ -1130,6 +1136,7 @@ ASFUNCTIONBODY_ATOM(XML,_setNamespace)
 	if (th->isAttribute && th->parentNode)
 	{
 		XML* tmp = th->parentNode;
+		tmp->materializeTree();
 		for (uint32_t i = 0; i < tmp->namespacedefs.size(); i++)
 		{
 			bool b;
@@ -1146,6 +1153,7 @@ ASFUNCTIONBODY_ATOM(XML,_setNamespace)
 
 void XML::setNamespace(uint32_t ns_uri, uint32_t ns_prefix)
 {
+	materializeTree();
 	this->nodenamespace_prefix = ns_prefix;
 	this->nodenamespace_uri = ns_uri;
 	handleNotification("namespaceSet",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
@@ -1168,7 +1176,7 @@ ASFUNCTIONBODY_ATOM(XML,_setChildren)
 	_NR<ASObject> newChildren;
 	ARG_UNPACK_ATOM(newChildren);
 
-	th->childrenlist->clear();
+	th->getChildNodes()->clear();
 
 	if (newChildren->is<XML>())
 	{
@@ -1209,7 +1217,7 @@ ASFUNCTIONBODY_ATOM(XML,_normalize)
 
 void XML::normalize()
 {
-	childrenlist->normalize();
+	getChildNodes()->normalize();
 }
 
 void XML::addTextContent(const tiny_string& str)
@@ -1237,11 +1245,11 @@ bool XML::hasSimpleContent() const
 	if (getNodeKind() == pugi::node_comment ||
 		getNodeKind() == pugi::node_pi)
 		return false;
-	if (childrenlist.isNull())
+	if (getChildNodes().isNull())
 		return true;
-	for(size_t i=0; i<childrenlist->nodes.size(); i++)
+	for(size_t i=0; i<getChildNodes()->nodes.size(); i++)
 	{
-		if (childrenlist->nodes[i]->getNodeKind() == pugi::node_element)
+		if (getChildNodes()->nodes[i]->getNodeKind() == pugi::node_element)
 			return false;
 	}
 	return true;
@@ -1262,23 +1270,23 @@ void XML::getDescendantsByQName(const tiny_string& name, uint32_t ns, bool bIsAt
 {
 	if (!constructed)
 		return;
-	if (bIsAttribute && !attributelist.isNull())
+	if (bIsAttribute && !getAttributeNodes().isNull())
 	{
-		for (uint32_t i = 0; i < attributelist->nodes.size(); i++)
+		for (uint32_t i = 0; i < getAttributeNodes()->nodes.size(); i++)
 		{
 			
-			_R<XML> child= attributelist->nodes[i];
+			_R<XML> child= getAttributeNodes()->nodes[i];
 			if(name=="" || name=="*" || (name == child->nodename && (ns == BUILTIN_STRINGS::STRING_WILDCARD || ns == child->nodenamespace_uri)))
 			{
 				ret.push_back(child);
 			}
 		}
 	}
-	if (childrenlist.isNull())
+	if (getChildNodes().isNull())
 		return;
-	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+	for (uint32_t i = 0; i < getChildNodes()->nodes.size(); i++)
 	{
-		_R<XML> child= childrenlist->nodes[i];
+		_R<XML> child= getChildNodes()->nodes[i];
 		if(!bIsAttribute && (name=="" || name=="*" || (name == child->nodename && (ns == BUILTIN_STRINGS::STRING_WILDCARD || ns == child->nodenamespace_uri))))
 		{
 			ret.push_back(child);
@@ -1299,7 +1307,7 @@ XML::XMLVector XML::getAttributes()
 XML::XMLVector XML::getAttributesByMultiname(const multiname& name, const tiny_string& normalizedName) const
 {
 	XMLVector ret;
-	if (attributelist.isNull())
+	if (getAttributeNodes().isNull())
 		return ret;
 	uint32_t defns = getVm(getSystemState())->getDefaultXMLNamespaceID();
 	std::unordered_set<uint32_t> namespace_uri;
@@ -1328,7 +1336,7 @@ XML::XMLVector XML::getAttributesByMultiname(const multiname& name, const tiny_s
 		}
 		++it;
 	}
-	const XMLList::XMLListVector nodes = attributelist->nodes;
+	const XMLList::XMLListVector nodes = getAttributeNodes()->nodes;
 	if (normalizedName.empty())
 	{
 		for (auto child = nodes.cbegin(); child != nodes.cend(); child++)
@@ -1508,7 +1516,7 @@ GET_VARIABLE_RESULT XML::getVariableByMultiname(asAtom& ret, const multiname& na
 	{
 		//Lookup attribute
 		const XMLVector& attributes=getAttributesByMultiname(name,normalizedName);
-		ret = asAtomHandler::fromObject(XMLList::create(getSystemState(),attributes,attributelist.getPtr(),name));
+		ret = asAtomHandler::fromObject(XMLList::create(getSystemState(),attributes,getAttributeNodes().getPtr(),name));
 		return GET_VARIABLE_RESULT::GETVAR_NORMAL;
 	}
 	else if(XML::isValidMultiname(getSystemState(),name,index))
@@ -1523,7 +1531,7 @@ GET_VARIABLE_RESULT XML::getVariableByMultiname(asAtom& ret, const multiname& na
 		else
 			ret = asAtomHandler::fromObject(getSystemState()->getUndefinedRef());
 	}
-	else if (!childrenlist.isNull())
+	else if (!getChildNodes().isNull())
 	{
 		if (normalizedName == "*")
 		{
@@ -1538,7 +1546,7 @@ GET_VARIABLE_RESULT XML::getVariableByMultiname(asAtom& ret, const multiname& na
 		}
 		else
 		{
-			const XMLVector& res=getValuesByMultiname(childrenlist,name);
+			const XMLVector& res=getValuesByMultiname(getChildNodes(),name);
 			
 			if(res.empty() && (opt & FROM_GETLEX)!=0)
 				return GET_VARIABLE_RESULT::GETVAR_NORMAL;
@@ -1573,7 +1581,7 @@ void XML::setVariableByInteger(int index, asAtom &o, ASObject::CONST_ALLOWED_FLA
 		setVariableByInteger_intern(index,o,allowConst);
 		return;
 	}
-	childrenlist->setVariableByInteger(index,o,allowConst);
+	getChildNodes()->setVariableByInteger(index,o,allowConst);
 }
 multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_ALLOWED_FLAG allowConst, bool replacetext)
 {
@@ -1606,7 +1614,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 		isAttr=true;
 		buf+=1;
 	}
-	if (childrenlist.isNull())
+	if (getChildNodes().isNull())
 		childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
 	
 	if(isAttr)
@@ -1627,8 +1635,8 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			nodeval = asAtomHandler::toString(o,getSystemState());
 		}
 		_NR<XML> a;
-		XMLList::XMLListVector::iterator it = attributelist->nodes.begin();
-		while (it != attributelist->nodes.end())
+		XMLList::XMLListVector::iterator it = getAttributeNodes()->nodes.begin();
+		while (it != getAttributeNodes()->nodes.end())
 		{
 			_R<XML> attr = *it;
 			XMLList::XMLListVector::iterator ittmp = it;
@@ -1636,7 +1644,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			if (attr->nodenamespace_uri == ns_uri && (attr->nodename == buf || (*buf=='*')|| (*buf==0)))
 			{
 				if (!a.isNull())
-					it=attributelist->nodes.erase(ittmp);
+					it=getAttributeNodes()->nodes.erase(ittmp);
 				a = *ittmp;
 				asAtom oldval = asAtomHandler::fromStringID(getSystemState()->getUniqueStringId(a->nodevalue));
 				a->nodevalue = nodeval;
@@ -1646,7 +1654,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 		if (a.isNull() && !((*buf=='*')|| (*buf==0)))
 		{
 			_NR<XML> tmp = _MR<XML>(Class<XML>::getInstanceSNoArgs(getSystemState()));
-			tmp->parentNode = this;
+			tmp->setParentNode(this);
 			tmp->nodetype = pugi::node_null;
 			tmp->isAttribute = true;
 			tmp->nodename = buf;
@@ -1654,20 +1662,20 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			tmp->nodenamespace_prefix = ns_prefix;
 			tmp->nodevalue = nodeval;
 			tmp->constructed = true;
-			attributelist->nodes.push_back(tmp);
+			getAttributeNodes()->nodes.push_back(tmp);
 			handleNotification("attributeAdded",asAtomHandler::fromStringID(getSystemState()->getUniqueStringId(tmp->nodename)),o);
 		}
 	}
 	else if(XML::isValidMultiname(getSystemState(),name,index))
 	{
-		childrenlist->setVariableByMultinameIntern(name,o,allowConst,replacetext);
+		getChildNodes()->setVariableByMultinameIntern(name,o,allowConst,replacetext);
 	}
 	else
 	{
 		bool notificationhandled = false;
 		bool found = false;
 		XMLVector tmpnodes;
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end();it++)
+		for (auto it = getChildNodes()->nodes.begin(); it != getChildNodes()->nodes.end();it++)
 		{
 			_R<XML> tmpnode = *it;
 			
@@ -1704,8 +1712,8 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 							tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 							tmp->nodevalue = asAtomHandler::toString(o,getSystemState());
 							tmp->constructed = true;
-							tmpnode->childrenlist->clear();
-							tmpnode->childrenlist->append(tmp);
+							tmpnode->getChildNodes()->clear();
+							tmpnode->getChildNodes()->append(tmp);
 						}
 						if (!found)
 							tmpnodes.push_back(tmpnode);
@@ -1715,7 +1723,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 					else
 					{
 						_NR<XML> tmp = _MR<XML>(asAtomHandler::getObject(o)->as<XML>());
-						tmp->parentNode = this;
+						tmp->setParentNode(this);
 						tmp->incRef();
 						if (!found)
 							tmpnodes.push_back(tmp);
@@ -1724,15 +1732,15 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 				}
 				else
 				{
-					if (tmpnode->childrenlist.isNull())
+					if (tmpnode->getChildNodes().isNull())
 						tmpnode->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
 					
-					if (tmpnode->childrenlist->nodes.size() == 1 && tmpnode->childrenlist->nodes[0]->nodetype == pugi::node_pcdata)
-						tmpnode->childrenlist->nodes[0]->nodevalue = asAtomHandler::toString(o,getSystemState());
+					if (tmpnode->getChildNodes()->nodes.size() == 1 && tmpnode->getChildNodes()->nodes[0]->nodetype == pugi::node_pcdata)
+						tmpnode->getChildNodes()->nodes[0]->nodevalue = asAtomHandler::toString(o,getSystemState());
 					else
 					{
 						XML* newnode = createFromString(this->getSystemState(),asAtomHandler::toString(o,getSystemState()));
-						tmpnode->childrenlist->clear();
+						tmpnode->getChildNodes()->clear();
 						asAtom v = asAtomHandler::fromObject(newnode);
 						tmpnode->setVariableByMultiname(name,v,allowConst);
 						if (newnode->getNodeKind() == pugi::node_pcdata)
@@ -1760,7 +1768,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			if(asAtomHandler::getObject(o) && asAtomHandler::getObject(o)->is<XML>())
 			{
 				_R<XML> tmp = _MR<XML>(asAtomHandler::getObject(o)->as<XML>());
-				tmp->parentNode = this;
+				tmp->setParentNode(this);
 				tmp->incRef();
 				tmpnodes.push_back(tmp);
 			}
@@ -1797,12 +1805,12 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 				tmpstr += normalizedName;
 				tmpstr +=">";
 				_NR<XML> tmp = _MR<XML>(createFromString(this->getSystemState(),tmpstr));
-				tmp->parentNode = this;
+				tmp->setParentNode(this);
 				tmpnodes.push_back(tmp);
 			}
 		}
-		childrenlist->nodes.clear();
-		childrenlist->nodes.assign(tmpnodes.begin(),tmpnodes.end());
+		getChildNodes()->nodes.clear();
+		getChildNodes()->nodes.assign(tmpnodes.begin(),tmpnodes.end());
 		if (!notificationhandled)
 			handleNotification("nodeChanged",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
 	}
@@ -1844,9 +1852,9 @@ bool XML::hasProperty(const multiname& name, bool checkXMLPropsOnly, bool consid
 	if(isAttr)
 	{
 		//Lookup attribute
-		if (!attributelist.isNull())
+		if (!getAttributeNodes().isNull())
 		{
-			for (XMLList::XMLListVector::const_iterator it = attributelist->nodes.begin(); it != attributelist->nodes.end(); it++)
+			for (XMLList::XMLListVector::const_iterator it = getAttributeNodes()->nodes.begin(); it != getAttributeNodes()->nodes.end(); it++)
 			{
 				_R<XML> attr = *it;
 				if (attr->nodenamespace_uri == ns_uri && attr->nodename == buf)
@@ -1860,12 +1868,12 @@ bool XML::hasProperty(const multiname& name, bool checkXMLPropsOnly, bool consid
 		// object is treated as a single-item XMLList.
 		return(index==0);
 	}
-	else if (!childrenlist.isNull())
+	else if (!getChildNodes().isNull())
 	{
 		//Lookup children
-		for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+		for (uint32_t i = 0; i < getChildNodes()->nodes.size(); i++)
 		{
-			_R<XML> child= childrenlist->nodes[i];
+			_R<XML> child= getChildNodes()->nodes[i];
 			bool name_match=(child->nodename == buf);
 			bool ns_match=ns_uri==BUILTIN_STRINGS::EMPTY || 
 				(child->nodenamespace_uri == ns_uri);
@@ -1900,10 +1908,10 @@ bool XML::deleteVariableByMultiname(const multiname& name)
 		{
 			ns_uri = getVm(getSystemState())->getDefaultXMLNamespaceID();
 		}
-		if (!attributelist.isNull() && attributelist->nodes.size() > 0)
+		if (!getAttributeNodes().isNull() && getAttributeNodes()->nodes.size() > 0)
 		{
-			XMLList::XMLListVector::iterator it = attributelist->nodes.end();
-			while (it != attributelist->nodes.begin())
+			XMLList::XMLListVector::iterator it = getAttributeNodes()->nodes.end();
+			while (it != getAttributeNodes()->nodes.begin())
 			{
 				it--;
 				_R<XML> attr = *it;
@@ -1912,7 +1920,7 @@ bool XML::deleteVariableByMultiname(const multiname& name)
 						(attr->nodenamespace_uri == ns_uri && name.normalizedName(getSystemState()) == "") ||
 						(attr->nodenamespace_uri == ns_uri && attr->nodename == name.normalizedName(getSystemState())))
 				{
-					attributelist->nodes.erase(it);
+					getAttributeNodes()->nodes.erase(it);
 					asAtom oldval = asAtomHandler::fromStringID(getSystemState()->getUniqueStringId(attr->nodevalue));
 					handleNotification("attributeRemoved",asAtomHandler::fromStringID(getSystemState()->getUniqueStringId(attr->nodename)),oldval);
 				}
@@ -1921,8 +1929,8 @@ bool XML::deleteVariableByMultiname(const multiname& name)
 	}
 	else if(XML::isValidMultiname(getSystemState(),name,index))
 	{
-		if (!childrenlist.isNull())
-			childrenlist->nodes.erase(childrenlist->nodes.begin() + index);
+		if (!getChildNodes().isNull())
+			getChildNodes()->nodes.erase(getChildNodes()->nodes.begin() + index);
 	}
 	else
 	{
@@ -1933,10 +1941,10 @@ bool XML::deleteVariableByMultiname(const multiname& name)
 			assert_and_throw(name.ns[0].kind==NAMESPACE);
 			ns_uri=name.ns[0].nsNameId;
 		}
-		if (!childrenlist.isNull() && childrenlist->nodes.size() > 0)
+		if (!getChildNodes().isNull() && getChildNodes()->nodes.size() > 0)
 		{
-			XMLList::XMLListVector::iterator it = childrenlist->nodes.end();
-			while (it != childrenlist->nodes.begin())
+			XMLList::XMLListVector::iterator it = getChildNodes()->nodes.end();
+			while (it != getChildNodes()->nodes.begin())
 			{
 				it--;
 				_R<XML> node = *it;
@@ -1945,7 +1953,7 @@ bool XML::deleteVariableByMultiname(const multiname& name)
 						(node->nodenamespace_uri == ns_uri && name.normalizedName(getSystemState()) == "") ||
 						(node->nodenamespace_uri == ns_uri && node->nodename == name.normalizedName(getSystemState())))
 				{
-					childrenlist->nodes.erase(it);
+					getChildNodes()->nodes.erase(it);
 					handleNotification("nodeRemoved",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
 				}
 			}
@@ -2002,7 +2010,7 @@ uint32_t XML::getNamespacePrefixByURI(uint32_t uri, bool create)
 ASFUNCTIONBODY_ATOM(XML,_toString)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
-	if (th->nodetype == pugi::node_element && th->hasSimpleContent() && (th->childrenlist.isNull() || th->childrenlist->nodes.empty()))
+	if (th->nodetype == pugi::node_element && th->hasSimpleContent() && (th->getChildNodes().isNull() || th->getChildNodes()->nodes.empty()))
 		ret = asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY);
 	else
 		ret = asAtomHandler::fromObject(abstract_s(sys,th->toString_priv()));
@@ -2171,9 +2179,9 @@ void XML::CheckCyclicReference(XML* node)
 	XML* tmp = node;
 	if (tmp == this)
 		throwError<TypeError>(kXMLIllegalCyclicalLoop);
-	if (!childrenlist.isNull())
+	if (!getChildNodes().isNull())
 	{
-		for (auto it = tmp->childrenlist->nodes.begin(); it != tmp->childrenlist->nodes.end(); it++)
+		for (auto it = tmp->getChildNodes()->nodes.begin(); it != tmp->getChildNodes()->nodes.end(); it++)
 		{
 			if ((*it).getPtr() == this)
 				throwError<TypeError>(kXMLIllegalCyclicalLoop);
@@ -2190,12 +2198,12 @@ XML *XML::createFromString(SystemState* sys, const tiny_string &s,bool usefirstc
 	return res;
 }
 
-XML *XML::createFromNode(const pugi::xml_node &_n, XML *parent, bool fromXMLList)
+XML *XML::createFromNode(const pugi::xml_node &_n, XML *parent, bool fromXMLList, std::shared_ptr<XMLSource> src)
 {
 	XML* res = Class<XML>::getInstanceSNoArgs(parent ? parent->getSystemState() : getSys());
 	if (parent)
 		res->parentNode = parent;
-	res->createTree(_n,fromXMLList);
+	res->createTree(_n,fromXMLList,src);
 	return res;
 }
 
@@ -2222,7 +2230,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 	}
 	else
 		child2 = _NR<XML>(createFromString(sys,child2->toString()));
-	if (th->childrenlist.isNull())
+	if (th->getChildNodes().isNull())
 		th->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(sys));
 	if (child1->is<Null>())
 	{
@@ -2230,17 +2238,17 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 		if (child2->is<XML>())
 		{
 			child2->incRef();
-			child2->as<XML>()->parentNode = th;
-			th->childrenlist->nodes.insert(th->childrenlist->nodes.begin(),_NR<XML>(child2->as<XML>()));
+			child2->as<XML>()->setParentNode(th);
+			th->getChildNodes()->nodes.insert(th->getChildNodes()->nodes.begin(),_NR<XML>(child2->as<XML>()));
 		}
 		else if (child2->is<XMLList>())
 		{
 			for (auto it2 = child2->as<XMLList>()->nodes.begin(); it2 < child2->as<XMLList>()->nodes.end(); it2++)
 			{
 				(*it2)->incRef();
-				(*it2)->parentNode = th;
+				(*it2)->setParentNode(th);
 			}
-			th->childrenlist->nodes.insert(th->childrenlist->nodes.begin(),child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
+			th->getChildNodes()->nodes.insert(th->getChildNodes()->nodes.begin(),child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
 		}
 		th->incRef();
 		ret = asAtomHandler::fromObject(th);
@@ -2255,7 +2263,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 		}
 		child1 = child1->as<XMLList>()->nodes[0];
 	}
-	for (auto it = th->childrenlist->nodes.begin(); it != th->childrenlist->nodes.end(); it++)
+	for (auto it = th->getChildNodes()->nodes.begin(); it != th->getChildNodes()->nodes.end(); it++)
 	{
 		if ((*it).getPtr() == child1.getPtr())
 		{
@@ -2263,17 +2271,17 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 			if (child2->is<XML>())
 			{
 				child2->incRef();
-				child2->as<XML>()->parentNode = th;
-				th->childrenlist->nodes.insert(it+1,_NR<XML>(child2->as<XML>()));
+				child2->as<XML>()->setParentNode(th);
+				th->getChildNodes()->nodes.insert(it+1,_NR<XML>(child2->as<XML>()));
 			}
 			else if (child2->is<XMLList>())
 			{
 				for (auto it2 = child2->as<XMLList>()->nodes.begin(); it2 < child2->as<XMLList>()->nodes.end(); it2++)
 				{
 					(*it2)->incRef();
-					(*it2)->parentNode = th;
+					(*it2)->setParentNode(th);
 				}
-				th->childrenlist->nodes.insert(it+1,child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
+				th->getChildNodes()->nodes.insert(it+1,child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
 			}
 			ret = asAtomHandler::fromObject(th);
 			return;
@@ -2304,7 +2312,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 	else
 		child2 = _NR<XML>(createFromString(sys,child2->toString()));
 
-	if (th->childrenlist.isNull())
+	if (th->getChildNodes().isNull())
 		th->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(sys));
 	if (child1->is<Null>())
 	{
@@ -2317,8 +2325,8 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 			for (auto it = child2->as<XMLList>()->nodes.begin(); it < child2->as<XMLList>()->nodes.end(); it++)
 			{
 				(*it)->incRef();
-				(*it)->parentNode = th;
-				th->childrenlist->nodes.push_back(_NR<XML>(*it));
+				(*it)->setParentNode(th);
+				th->getChildNodes()->nodes.push_back(_NR<XML>(*it));
 			}
 		}
 		th->incRef();
@@ -2334,7 +2342,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 		}
 		child1 = child1->as<XMLList>()->nodes[0];
 	}
-	for (auto it = th->childrenlist->nodes.begin(); it != th->childrenlist->nodes.end(); it++)
+	for (auto it = th->getChildNodes()->nodes.begin(); it != th->getChildNodes()->nodes.end(); it++)
 	{
 		if ((*it).getPtr() == child1.getPtr())
 		{
@@ -2342,17 +2350,17 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 			if (child2->is<XML>())
 			{
 				child2->incRef();
-				child2->as<XML>()->parentNode = th;
-				th->childrenlist->nodes.insert(it,_NR<XML>(child2->as<XML>()));
+				child2->as<XML>()->setParentNode(th);
+				th->getChildNodes()->nodes.insert(it,_NR<XML>(child2->as<XML>()));
 			}
 			else if (child2->is<XMLList>())
 			{
 				for (auto it2 = child2->as<XMLList>()->nodes.begin(); it2 < child2->as<XMLList>()->nodes.end(); it2++)
 				{
 					(*it2)->incRef();
-					(*it2)->parentNode = th;
+					(*it2)->setParentNode(th);
 				}
-				th->childrenlist->nodes.insert(it,child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
+				th->getChildNodes()->nodes.insert(it,child2->as<XMLList>()->nodes.begin(), child2->as<XMLList>()->nodes.end());
 			}
 			ret = asAtomHandler::fromObject(th);
 			return;
@@ -2395,6 +2403,7 @@ ASFUNCTIONBODY_ATOM(XML,removeNamespace)
 }
 void XML::RemoveNamespace(Namespace *ns)
 {
+	materializeTree();
 	if (this->nodenamespace_uri == ns->getURI())
 	{
 		this->nodenamespace_uri = BUILTIN_STRINGS::EMPTY;
@@ -2409,9 +2418,9 @@ void XML::RemoveNamespace(Namespace *ns)
 			break;
 		}
 	}
-	if (childrenlist)
+	if (getChildNodes())
 	{
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		for (auto it = getChildNodes()->nodes.begin(); it != getChildNodes()->nodes.end(); it++)
 		{
 			(*it)->RemoveNamespace(ns);
 		}
@@ -2430,9 +2439,9 @@ ASFUNCTIONBODY_ATOM(XML,comments)
 }
 void XML::getComments(XMLVector& ret)
 {
-	if (childrenlist)
+	if (getChildNodes())
 	{
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		for (auto it = getChildNodes()->nodes.begin(); it != getChildNodes()->nodes.end(); it++)
 		{
 			if ((*it)->getNodeKind() == pugi::node_comment)
 			{
@@ -2454,9 +2463,9 @@ ASFUNCTIONBODY_ATOM(XML,processingInstructions)
 }
 void XML::getprocessingInstructions(XMLVector& ret, tiny_string name)
 {
-	if (childrenlist)
+	if (getChildNodes())
 	{
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		for (auto it = getChildNodes()->nodes.begin(); it != getChildNodes()->nodes.end(); it++)
 		{
 			if ((*it)->getNodeKind() == pugi::node_pi && (name == "*" || name == (*it)->nodename))
 			{
@@ -2513,10 +2522,10 @@ tiny_string XML::toString_priv()
 	}
 	else if (hasSimpleContent())
 	{
-		if (!childrenlist.isNull() && !childrenlist->nodes.empty())
+		if (!getChildNodes().isNull() && !getChildNodes()->nodes.empty())
 		{
-			auto it = childrenlist->nodes.begin();
-			while(it != childrenlist->nodes.end())
+			auto it = getChildNodes()->nodes.begin();
+			while(it != getChildNodes()->nodes.end())
 			{
 				if ((*it)->getNodeKind() != pugi::node_comment &&
 						(*it)->getNodeKind() != pugi::node_pi)
@@ -2524,7 +2533,7 @@ tiny_string XML::toString_priv()
 				it++;
 			}
 		}
-		else if (getNodeKind() == pugi::node_element && !attributelist.isNull() && !attributelist->nodes.empty())
+		else if (getNodeKind() == pugi::node_element && !getAttributeNodes().isNull() && !getAttributeNodes()->nodes.empty())
 		{
 			ret=toXMLString_internal();
 		}
@@ -2541,6 +2550,11 @@ bool XML::getPrettyPrinting()
 	return prettyPrinting;
 }
 
+bool XML::getIgnoreWhitespace()
+{
+	return ignoreWhitespace;
+}
+
 unsigned int XML::getParseMode()
 {
 	unsigned int parsemode = pugi::parse_cdata | pugi::parse_escapes|pugi::parse_fragment | pugi::parse_doctype |pugi::parse_pi|pugi::parse_declaration;
@@ -2601,19 +2615,19 @@ bool XML::nodesEqual(XML *a, XML *b) const
 	if (a->nodevalue != b->nodevalue)
 		return false;
 	// attributes
-	if (a->attributelist.isNull())
-		return b->attributelist.isNull() || b->attributelist->nodes.size() == 0;
-	if (b->attributelist.isNull())
-		return a->attributelist.isNull() || a->attributelist->nodes.size() == 0;
-	if (a->attributelist->nodes.size() != b->attributelist->nodes.size())
+	if (a->getAttributeNodes().isNull())
+		return b->getAttributeNodes().isNull() || b->getAttributeNodes()->nodes.size() == 0;
+	if (b->getAttributeNodes().isNull())
+		return a->getAttributeNodes().isNull() || a->getAttributeNodes()->nodes.size() == 0;
+	if (a->getAttributeNodes()->nodes.size() != b->getAttributeNodes()->nodes.size())
 		return false;
-	for (int i = 0; i < (int)a->attributelist->nodes.size(); i++)
+	for (int i = 0; i < (int)a->getAttributeNodes()->nodes.size(); i++)
 	{
-		_R<XML> oa= a->attributelist->nodes[i];
+		_R<XML> oa= a->getAttributeNodes()->nodes[i];
 		bool bequal = false;
-		for (int j = 0; j < (int)b->attributelist->nodes.size(); j++)
+		for (int j = 0; j < (int)b->getAttributeNodes()->nodes.size(); j++)
 		{
-			_R<XML> ob= b->attributelist->nodes[j];
+			_R<XML> ob= b->getAttributeNodes()->nodes[j];
 			if (oa->isEqual(ob.getPtr()))
 			{
 				bequal = true;
@@ -2648,12 +2662,12 @@ bool XML::nodesEqual(XML *a, XML *b) const
 	}
 	
 	// children
-	if (a->childrenlist.isNull())
-		return b->childrenlist.isNull() || b->childrenlist->nodes.size() == 0;
-	if (b->childrenlist.isNull())
-		return a->childrenlist.isNull() || a->childrenlist->nodes.size() == 0;
+	if (a->getChildNodes().isNull())
+		return b->getChildNodes().isNull() || b->getChildNodes()->nodes.size() == 0;
+	if (b->getChildNodes().isNull())
+		return a->getChildNodes().isNull() || a->getChildNodes()->nodes.size() == 0;
 	
-	return a->childrenlist->isEqual(b->childrenlist.getPtr());
+	return a->getChildNodes()->isEqual(b->getChildNodes().getPtr());
 }
 
 uint32_t XML::nextNameIndex(uint32_t cur_index)
@@ -2715,27 +2729,32 @@ void XML::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
 
 void XML::dumpTreeObjects(int indent)
 {
-	LOG(LOG_INFO,""<<std::string(2*indent,' ')<<this->nodename<<" "<<this->toDebugString()<<" "<<this->attributelist->toDebugString()<<" "<<this->childrenlist->toDebugString());
-	for (auto it= this->attributelist->nodes.begin();it != this->attributelist->nodes.end(); it++)
+	LOG(LOG_INFO,""<<std::string(2*indent,' ')<<this->nodename<<" "<<this->toDebugString()<<" "<<this->getAttributeNodes()->toDebugString()<<" "<<this->getChildNodes()->toDebugString());
+	for (auto it= this->getAttributeNodes()->nodes.begin();it != this->getAttributeNodes()->nodes.end(); it++)
 	{
 		LOG(LOG_INFO,""<<std::string(2*indent,' ')<<" attribute: "<<(*it)->nodename<<" "<<(*it)->toDebugString());
 	}
 	indent++;
-	for (auto it= this->childrenlist->nodes.begin();it != this->childrenlist->nodes.end(); it++)
+	for (auto it= this->getChildNodes()->nodes.begin();it != this->getChildNodes()->nodes.end(); it++)
 	{
 		(*it)->dumpTreeObjects(indent);
 	}
 }
 
-void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
+void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList,std::shared_ptr<XMLSource> src)
 {
 	pugi::xml_node node = rootnode;
 	bool done = false;
-	if (this->childrenlist.isNull() || this->childrenlist->nodes.size() > 0)
+	if (!src)
 	{
-		this->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
-		this->childrenlist->incRef();
+		//Nodes parsed by buildFromString can share our document, others have to be created now
+		src = make_shared<XMLSource>(xmldoc,getVm(getSystemState())->getDefaultXMLNamespaceID(),ignoreWhitespace);
 	}
+	lazynode = pugi::xml_node();
+	source.reset();
+	//A new list is created by materialize()
+	if (!this->childrenlist.isNull() && this->childrenlist->nodes.size() > 0)
+		this->childrenlist.reset();
 	if (!parentNode && !fromXMLList)
 	{
 		while (true)
@@ -2744,17 +2763,17 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 			switch (node.type())
 			{
 				case pugi::node_null: // Empty (null) node handle
-					fillNode(this,node);
+					fillNode(this,node,src);
 					done = true;
 					break;
 				case pugi::node_document:// A document tree's absolute root
-					createTree(node.first_child(),fromXMLList);
+					createTree(node.first_child(),fromXMLList,src);
 					return;
 				case pugi::node_pi:	// Processing instruction, i.e. '<?name?>'
 				case pugi::node_declaration: // Document declaration, i.e. '<?xml version="1.0"?>'
 				{
 					_NR<XML> tmp = _MR<XML>(Class<XML>::getInstanceSNoArgs(getSystemState()));
-					fillNode(tmp.getPtr(),node);
+					fillNode(tmp.getPtr(),node,src);
 					if(this->procinstlist.isNull())
 						this->procinstlist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
 					this->procinstlist->incRef();
@@ -2762,29 +2781,21 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 					break;
 				}
 				case pugi::node_doctype:// Document type declaration, i.e. '<!DOCTYPE doc>'
-					fillNode(this,node);
+					fillNode(this,node,src);
 					break;
 				case pugi::node_pcdata: // Plain character data, i.e. 'text'
 				case pugi::node_cdata: // Character data, i.e. '<![CDATA[text]]>'
-					fillNode(this,node);
+					fillNode(this,node,src);
 					done = true;
 					break;
 				case pugi::node_comment: // Comment tag, i.e. '<!-- text -->'
-					fillNode(this,node);
+					fillNode(this,node,src);
 					break;
 				case pugi::node_element: // Element tag, i.e. '<node/>'
-				{
-					fillNode(this,node);
-					pugi::xml_node_iterator it=node.begin();
-					while(it!=node.end())
-					{
-						//LOG(LOG_INFO,"rootchildnode1:"<<it->name()<<" "<<it->value()<<" "<<it->type()<<" "<<parentNode);
-						this->childrenlist->append(_R<XML>(XML::createFromNode(*it,this)));
-						it++;
-					}
+					//The children are created by materialize()
+					fillNode(this,node,src);
 					done = true;
 					break;
-				}
 				default:
 					LOG(LOG_ERROR,"createTree:unhandled type:" <<node.type());
 					done=true;
@@ -2808,22 +2819,9 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 			case pugi::node_pcdata: // Plain character data, i.e. 'text'
 			case pugi::node_cdata: // Character data, i.e. '<![CDATA[text]]>'
 			case pugi::node_comment: // Comment tag, i.e. '<!-- text -->'
-				fillNode(this,node);
-				break;
 			case pugi::node_element: // Element tag, i.e. '<node/>'
-			{
-				fillNode(this,node);
-				pugi::xml_node_iterator it=node.begin();
-				{
-					while(it!=node.end())
-					{
-						_NR<XML> tmp = _MR<XML>(XML::createFromNode(*it,this));
-						this->childrenlist->append(_R<XML>(tmp));
-						it++;
-					}
-				}
+				fillNode(this,node,src);
 				break;
-			}
 			default:
 				LOG(LOG_ERROR,"createTree:subtree unhandled type:" <<node.type());
 				break;
@@ -2831,22 +2829,17 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 	}
 }
 
-void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
+void XML::fillNode(XML* node, const pugi::xml_node &srcnode, const std::shared_ptr<XMLSource>& src)
 {
-	if (node->childrenlist.isNull())
-	{
-		node->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(node->getSystemState()));
-	}
 	node->nodetype = srcnode.type();
 	node->nodename = srcnode.name();
 	node->nodevalue = srcnode.value();
 	if (node->parentNode && node->parentNode->nodenamespace_prefix == BUILTIN_STRINGS::EMPTY)
 		node->nodenamespace_uri = node->parentNode->nodenamespace_uri;
 	else
-		node->nodenamespace_uri = getVm(node->getSystemState())->getDefaultXMLNamespaceID();
-	if (ignoreWhitespace && node->nodetype == pugi::node_pcdata)
+		node->nodenamespace_uri = src->defaultns;
+	if (src->ignorewhitespace && node->nodetype == pugi::node_pcdata)
 		node->nodevalue = node->removeWhitespace(node->nodevalue);
-	node->attributelist = _MR(Class<XMLList>::getInstanceSNoArgs(node->getSystemState()));
 	pugi::xml_attribute_iterator itattr;
 	for(itattr = srcnode.attributes_begin();itattr!=srcnode.attributes_end();++itattr)
 	{
@@ -2898,6 +2891,28 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 			}
 		}
 	}
+	node->lazynode = srcnode;
+	node->source = src;
+	node->constructed=true;
+	if (!src->doc)
+		node->materialize();
+}
+
+void XML::materialize() const
+{
+	XML* node = const_cast<XML*>(this);
+	pugi::xml_node srcnode = lazynode;
+	std::shared_ptr<XMLSource> src = source;
+	lazynode = pugi::xml_node();
+	source.reset();
+	if (childrenlist.isNull())
+	{
+		childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
+		childrenlist->incRef();
+	}
+	attributelist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
+	pugi::xml_attribute_iterator itattr;
+	uint32_t pos;
 	for(itattr = srcnode.attributes_begin();itattr!=srcnode.attributes_end();++itattr)
 	{
 		tiny_string aname = tiny_string(itattr->name(),true);
@@ -2908,7 +2923,7 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 		tmp->nodetype = pugi::node_null;
 		tmp->isAttribute = true;
 		tmp->nodename = aname;
-		tmp->nodenamespace_uri = getVm(node->getSystemState())->getDefaultXMLNamespaceID();
+		tmp->nodenamespace_uri = src->defaultns;
 		pos = tmp->nodename.find(":");
 		if (pos != tiny_string::npos)
 		{
@@ -2944,7 +2959,31 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 		tmp->constructed = true;
 		node->attributelist->nodes.push_back(tmp);
 	}
-	node->constructed=true;
+	for (auto it = srcnode.begin(); it != srcnode.end(); ++it)
+		childrenlist->append(_R<XML>(XML::createFromNode(*it,node,false,src)));
+}
+
+void XML::materializeTree()
+{
+	if (getChildNodes().isNull())
+		return;
+	for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); ++it)
+		(*it)->materializeTree();
+}
+
+void XML::materializeSurvivingDescendants()
+{
+	//Children that are not created yet can't be referenced by anyone
+	if (source || childrenlist.isNull())
+		return;
+	bool listShared = !childrenlist->isLastRef();
+	for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); ++it)
+	{
+		if (listShared || !(*it)->isLastRef())
+			(*it)->materializeTree();
+		else
+			(*it)->materializeSurvivingDescendants();
+	}
 }
 
 ASFUNCTIONBODY_ATOM(XML,_prependChild)
@@ -3010,8 +3049,8 @@ void XML::prependChild(_R<XML> newChild)
 			node = node->parentNode;
 		}
 		this->incRef();
-		newChild->parentNode = this;
-		childrenlist->prepend(newChild);
+		newChild->setParentNode(this);
+		getChildNodes()->prepend(newChild);
 	}
 }
 
@@ -3033,21 +3072,21 @@ ASFUNCTIONBODY_ATOM(XML,_replace)
 	{
 		if (value->is<XMLList>())
 		{
-			th->childrenlist->decRef();
+			th->getChildNodes()->decRef();
 			value->incRef();
 			th->childrenlist = _NR<XMLList>(value->as<XMLList>());
 		}
 		else if (value->is<XML>())
 		{
-			th->childrenlist->clear();
+			th->getChildNodes()->clear();
 			value->incRef();
-			th->childrenlist->append(_R<XML>(value->as<XML>()));
+			th->getChildNodes()->append(_R<XML>(value->as<XML>()));
 		}
 		else
 		{
 			XML* x = createFromString(sys,value->toString());
-			th->childrenlist->clear();
-			th->childrenlist->append(_R<XML>(x));
+			th->getChildNodes()->clear();
+			th->getChildNodes()->append(_R<XML>(x));
 		}
 		th->incRef();
 		ret = asAtomHandler::fromObject(th);
@@ -3062,7 +3101,7 @@ ASFUNCTIONBODY_ATOM(XML,_replace)
 	asAtom v = asAtomHandler::fromObject(value.getPtr());
 	if(XML::isValidMultiname(sys,name,index))
 	{
-		th->childrenlist->setVariableByMultinameIntern(name,v,CONST_NOT_ALLOWED,true);
+		th->getChildNodes()->setVariableByMultinameIntern(name,v,CONST_NOT_ALLOWED,true);
 	}	
 	else if (th->hasPropertyByMultiname(name,true,false))
 	{
@@ -26,6 +26,21 @@ namespace lightspark
 {
 class Namespace;
 class XMLList;
+
+/*
+ * A parsed document shared by the XML objects created from it, together with the settings
+ * in effect when it was parsed. The objects for the children and attributes of a node
+ * are only created when they are first accessed.
+ */
+struct XMLSource
+{
+	// null if the document is owned by someone else, then all nodes are created immediately
+	std::shared_ptr<pugi::xml_document> doc;
+	uint32_t defaultns;
+	bool ignorewhitespace;
+	XMLSource(std::shared_ptr<pugi::xml_document> d, uint32_t ns, bool ws):doc(d),defaultns(ns),ignorewhitespace(ws) {}
+};
+
 class XML: public ASObject, public XMLBase
 {
 friend class XMLList;
@@ -33,7 +48,8 @@ public:
 	typedef std::vector<_R<XML>> XMLVector;
 	typedef std::vector<_R<Namespace>> NSVector;
 private:
-	_NR<XMLList> childrenlist;
+	// only access childrenlist and attributelist through getChildNodes() and getAttributeNodes()
+	mutable _NR<XMLList> childrenlist;
 	XML* parentNode;
 	pugi::xml_node_type nodetype;
 	bool isAttribute;
@@ -41,13 +57,39 @@ private:
 	tiny_string nodevalue;
 	uint32_t nodenamespace_uri;
 	uint32_t nodenamespace_prefix;
-	_NR<XMLList> attributelist;
+	mutable _NR<XMLList> attributelist;
 	_NR<XMLList> procinstlist;
+	// node of source whose children and attributes have not been created yet, source is null once they are
+	mutable pugi::xml_node lazynode;
+	mutable std::shared_ptr<XMLSource> source;
 	_NR<IFunction> notifierfunction;
 	NSVector namespacedefs;
 
-	void createTree(const pugi::xml_node &rootnode, bool fromXMLList);
-	static void fillNode(XML* node, const pugi::xml_node &srcnode);
+	void createTree(const pugi::xml_node &rootnode, bool fromXMLList, std::shared_ptr<XMLSource> src=std::shared_ptr<XMLSource>());
+	static void fillNode(XML* node, const pugi::xml_node &srcnode, const std::shared_ptr<XMLSource>& src);
+	void materialize() const;
+	// creates all descendants, needed before changes that affect how they would be created from the source
+	void materializeTree();
+	// creates all descendants of the created nodes that are still referenced elsewhere, needed before this node is destructed
+	void materializeSurvivingDescendants();
+	// prefixes of the descendants not created yet are resolved through the ancestors, so they are created first
+	void setParentNode(XML* parent)
+	{
+		materializeTree();
+		parentNode = parent;
+	}
+	_NR<XMLList>& getChildNodes() const
+	{
+		if (source)
+			materialize();
+		return childrenlist;
+	}
+	_NR<XMLList>& getAttributeNodes() const
+	{
+		if (source)
+			materialize();
+		return attributelist;
+	}
 	tiny_string toString_priv();
 	const char* nodekindString();
 	
@@ -147,13 +189,14 @@ public:
 	static void sinit(Class_base* c);
 	
 	static bool getPrettyPrinting();
+	static bool getIgnoreWhitespace();
 	static unsigned int getParseMode();
 	static XML* createFromString(SystemState *sys, const tiny_string& s, bool usefirstchild=false);
-	static XML* createFromNode(const pugi::xml_node& _n, XML* parent=NULL, bool fromXMLList=false);
+	static XML* createFromNode(const pugi::xml_node& _n, XML* parent=NULL, bool fromXMLList=false, std::shared_ptr<XMLSource> src=std::shared_ptr<XMLSource>());
 
 	const tiny_string getName() const { return nodename;}
 	uint32_t getNamespaceURI() const { return nodenamespace_uri;}
-	XMLList* getChildrenlist() { return childrenlist ? childrenlist.getPtr() : NULL; }
+	XMLList* getChildrenlist() { return getChildNodes() ? childrenlist.getPtr() : NULL; }
 	
 	
 	void getDescendantsByQName(const tiny_string& name, uint32_t ns, bool bIsAttribute, XMLVector& ret) const;
@@ -216,7 +216,10 @@ ASFUNCTIONBODY_ATOM(XMLList,_constructor)
 
 void XMLList::buildFromString(const tiny_string &str)
 {
-	pugi::xml_document xmldoc;
+	//The document is shared by the nodes, which create their children from it when they are accessed
+	std::shared_ptr<XMLSource> src = make_shared<XMLSource>(make_shared<pugi::xml_document>(),
+		getVm(getSystemState())->getDefaultXMLNamespaceID(),XML::getIgnoreWhitespace());
+	pugi::xml_document& xmldoc = *src->doc;
 
 	pugi::xml_parse_result res = xmldoc.load_buffer((void*)str.raw_buf(),str.numBytes(),XML::getParseMode());
 	switch (res.status)
@@ -252,7 +255,7 @@ void XMLList::buildFromString(const tiny_string &str)
 	pugi::xml_node_iterator it=xmldoc.begin();
 	for(;it!=xmldoc.end();++it)
 	{
-		_R<XML> tmp = _MR(XML::createFromNode(*it,(XML*)nullptr,true));
+		_R<XML> tmp = _MR(XML::createFromNode(*it,(XML*)nullptr,true,src));
 		if (tmp->constructed)
 			nodes.push_back(tmp);
 	}
@@ -684,7 +687,7 @@ void XMLList::removeNode(XML *node)
 		_R<XML> n = *it;
 		if (n.getPtr() == node)
 		{
-			node->parentNode = nullptr;
+			node->setParentNode(nullptr);
 			nodes.erase(it);
 			break;
 		}
@@ -724,8 +727,8 @@ void XMLList::getTargetVariables(const multiname& name,XML::XMLVector& retnodes)
 			{
 				retnodes.push_back(child);
 			}
-			if (child->childrenlist)
-				child->childrenlist->getTargetVariables(name,retnodes);
+			if (child->getChildNodes())
+				child->getChildNodes()->getTargetVariables(name,retnodes);
 		}
 	}
 }
@@ -974,19 +977,19 @@ bool XMLList::deleteVariableByMultiname(const multiname& name)
 	if(XML::isValidMultiname(getSystemState(),name,index))
 	{
 		_R<XML> node = nodes[index];
-		if (node->parentNode && node->parentNode->childrenlist.getPtr() != this)
+		if (node->parentNode && node->parentNode->getChildNodes().getPtr() != this)
 		{
 			// the node to remove is also added to another list, so it has to be deleted there, too
 			if (node->parentNode)
 			{
-				XMLList::XMLListVector::iterator it = node->parentNode->childrenlist->nodes.end();
-				while (it != node->parentNode->childrenlist->nodes.begin())
+				XMLList::XMLListVector::iterator it = node->parentNode->getChildNodes()->nodes.end();
+				while (it != node->parentNode->getChildNodes()->nodes.begin())
 				{
 					it--;
 					_R<XML> n = *it;
 					if (n.getPtr() == node.getPtr())
 					{
-						node->parentNode->childrenlist->nodes.erase(it);
+						node->parentNode->getChildNodes()->nodes.erase(it);
 						break;
 					}
 				}
@@ -1158,7 +1161,7 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 		{
 			if (replacetext)
 			{
-				nodes[idx]->childrenlist->clear();
+				nodes[idx]->getChildNodes()->clear();
 				nodes[idx]->nodetype = pugi::node_pcdata;
 				nodes[idx]->nodename = "text";
 				nodes[idx]->nodevalue = o->toString();
@@ -1167,7 +1170,7 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 			}
 			else
 			{
-				nodes[idx]->childrenlist->clear();
+				nodes[idx]->getChildNodes()->clear();
 				_R<XML> tmp = _MR<XML>(Class<XML>::getInstanceSNoArgs(getSystemState()));
 				tmp->parentNode = nodes[idx].getPtr();
 				tmp->nodetype = pugi::node_pcdata;
@@ -1176,7 +1179,7 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 				tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 				tmp->nodevalue = o->toString();
 				tmp->constructed = true;
-				nodes[idx]->childrenlist->append(tmp);
+				nodes[idx]->getChildNodes()->append(tmp);
 			}
 		}
 		else
@@ -1189,7 +1192,7 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 	{
 		if (replacetext)
 		{
-			nodes[idx]->childrenlist->clear();
+			nodes[idx]->getChildNodes()->clear();
 			nodes[idx]->nodetype = pugi::node_pcdata;
 			nodes[idx]->nodename = "text";
 			nodes[idx]->nodevalue = o->toString();
@@ -1202,7 +1205,7 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 				nodes[idx]->nodevalue = o->toString();
 			else 
 			{
-				nodes[idx]->childrenlist->clear();
+				nodes[idx]->getChildNodes()->clear();
 				_R<XML> tmp = _MR<XML>(Class<XML>::getInstanceSNoArgs(getSystemState()));
 				tmp->parentNode = nodes[idx].getPtr();
 				tmp->nodetype = pugi::node_pcdata;
@@ -1211,7 +1214,7 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 				tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 				tmp->nodevalue = o->toString();
 				tmp->constructed = true;
-				nodes[idx]->childrenlist->append(tmp);
+				nodes[idx]->getChildNodes()->append(tmp);
 			}
 		}
 	}
@@ -35,6 +35,7 @@
 #include <glib.h>
 
 #include "scripting/abc.h"
+#include "scripting/abc_jit.h"
 #include "scripting/toplevel/toplevel.h"
 #include "scripting/flash/events/flashevents.h"
 #include "swf.h"
@@ -324,6 +325,22 @@ std::string IFunction::toDebugString()
 	return ret;
 }
 
+void IFunction::getReferencedObjects(std::vector<ASObject*>& refs)
+{
+	ASObject::getReferencedObjects(refs);
+	if (closure_this)
+		refs.push_back(closure_this.getPtr());
+	if (prototype)
+		refs.push_back(prototype.getPtr());
+}
+
+void IFunction::unlinkReferencedObjects()
+{
+	closure_this.reset();
+	prototype.reset();
+	ASObject::unlinkReferencedObjects();
+}
+
 SyntheticFunction::SyntheticFunction(Class_base* c,method_info* m):IFunction(c,SUBTYPE_SYNTHETICFUNCTION),mi(m),val(nullptr),simpleGetterOrSetterName(nullptr),fromNewFunction(false),func_scope(NullRef)
 {
 	if(mi)
@@ -345,12 +362,17 @@ void SyntheticFunction::call(asAtom& ret, asAtom& obj, asAtom *args, uint32_t nu
 		// this is a call to this method during preloading, it can happen when constructing objects for optimization detection
 		return;
 	}
-	call_context* saved_cc = getVm(getSystemState())->incStack(obj,this->functionname);
+	call_context* saved_cc = getVm(getSystemState())->incStack(obj,this->functionname,inClass ? inClass->class_name.nameId : (uint32_t)BUILTIN_STRINGS::EMPTY);
 	if (codeStatus != method_body_info::PRELOADED && codeStatus != method_body_info::USED)
 	{
 		mi->body->codeStatus = method_body_info::PRELOADING;
 		ABCVm::preloadFunction(this);
 		mi->body->codeStatus = method_body_info::PRELOADED;
+#ifdef BASELINE_JIT_ENABLED
+		// without the jit the interpreter doesn't count the calls and instructions of the method
+		if(!getSystemState()->useJit)
+			mi->body->hit_count=JIT_CALL_THRESHOLD+1;
+#endif
 		mi->cc.exec_pos = mi->body->preloadedcode.data();
 		mi->cc.locals = new asAtom[mi->body->getReturnValuePos()+1+mi->body->localresultcount];
 		mi->cc.stack = new asAtom[mi->body->max_stack+1];
@@ -483,7 +505,12 @@ void SyntheticFunction::call(asAtom& ret, asAtom& obj, asAtom *args, uint32_t nu
 			cc->locals[i+1]=asAtomHandler::undefinedAtom;
 		}
 	}
+#ifdef LIGHTSPARK_NANBOXING
+	// the memset trick below would create inline Numbers
+	std::fill(cc->locals+args_len+1,cc->locals+args_len+1+(mi->body->getReturnValuePos()+mi->body->localresultcount-(args_len)),asAtomHandler::undefinedAtom);
+#else
 	memset(cc->locals+args_len+1,ATOMTYPE_UNDEFINED_BIT,(mi->body->getReturnValuePos()+mi->body->localresultcount-(args_len))*sizeof(asAtom));
+#endif
 	if(mi->needsArgs())
 	{
 		assert_and_throw(cc->mi->body->local_count>args_len);
@@ -655,6 +682,40 @@ void SyntheticFunction::call(asAtom& ret, asAtom& obj, asAtom *args, uint32_t nu
 		delete cc;
 }
 
+void SyntheticFunction::getReferencedObjects(std::vector<ASObject*>& refs)
+{
+	IFunction::getReferencedObjects(refs);
+	// the same scope objects destruct() releases, activation objects are never collected
+	if (!func_scope.isNull() && !inClass)
+	{
+		for (auto it = func_scope->scope.begin();it != func_scope->scope.end(); it++)
+		{
+			ASObject* o = asAtomHandler::getObject(it->object);
+			if (o && !o->is<Global>() && !o->is<Activation_object>())
+				refs.push_back(o);
+		}
+	}
+}
+
+void SyntheticFunction::unlinkReferencedObjects()
+{
+	if (!func_scope.isNull() && !inClass)
+	{
+		// the scope list may be shared with clones of this function, so it is replaced instead of modified
+		_NR<scope_entry_list> kept = _MNR(new scope_entry_list());
+		for (auto it = func_scope->scope.begin();it != func_scope->scope.end(); it++)
+		{
+			ASObject* o = asAtomHandler::getObject(it->object);
+			if (o && !o->is<Global>() && !o->is<Activation_object>())
+				o->decRef();
+			else
+				kept->scope.push_back(*it);
+		}
+		func_scope = kept;
+	}
+	IFunction::unlinkReferencedObjects();
+}
+
 bool SyntheticFunction::destruct()
 {
 	// the scope may contain objects that have pointers to this function
@@ -1072,7 +1133,8 @@ void Class_base::copyBorrowedTraitsFromSuper()
 		ASATOM_INCREF(v.var);
 		ASATOM_INCREF(v.getter);
 		ASATOM_INCREF(v.setter);
-		borrowedVariables.Variables.insert(make_pair(i->first,v));
+		auto inserted = borrowedVariables.Variables.insert(make_pair(i->first,v));
+		borrowedVariables.addToShape(&(inserted->second),i->first);
 	}
 }
 
@@ -3139,7 +3201,7 @@ ASFUNCTIONBODY_ATOM(lightspark,_isXMLName)
 		asAtomHandler::setBool(ret,isXMLName(sys,args[0]));
 }
 
-ObjectPrototype::ObjectPrototype(Class_base* c) : ASObject(c)
+ObjectPrototype::ObjectPrototype(Class_base* c) : ASObject(c,T_OBJECT,SUBTYPE_OBJECTPROTOTYPE)
 {
 	traitsInitialized = true;
 	constructIndicator = true;
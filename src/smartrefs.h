@@ -26,6 +26,8 @@
 namespace lightspark
 {
 
+class CycleCollector;
+
 class RefCountable {
 private:
 	ATOMIC_INT32(ref_count);
@@ -33,11 +35,25 @@ private:
 	bool isConstant:1;
 	bool inDestruction:1;
 	bool cached:1;
+	// only set in the constructor of objects the cycle collector knows about
+	bool cycleCollectable:1;
+	/*
+	 * Set the first time the reference count is decremented without reaching zero
+	 * on a thread owning a cycle collector, as the object may now only be kept alive
+	 * by a reference cycle. It is not a bitfield, as only the owning thread changes it.
+	 */
+	bool cycleCandidate;
+	// adds the object to the candidates of threadCycleCollector, defined in cyclecollector.cpp
+	void bufferCycleCandidate();
 protected:
-	RefCountable() : ref_count(1),activation_refcount(1),isConstant(false),inDestruction(false),cached(false) {}
+	RefCountable() : ref_count(1),activation_refcount(1),isConstant(false),inDestruction(false),cached(false),cycleCollectable(false),cycleCandidate(false) {}
+	inline void setCycleCollectable() { cycleCollectable=true; }
+	inline void resetCycleCandidate() { cycleCandidate=false; }
 
 public:
 	virtual ~RefCountable() {}
+	// the collector buffering the candidates found by decRef on this thread, only set on the vm thread
+	static DLL_PUBLIC thread_local CycleCollector* threadCycleCollector;
 
 	int getRefCount() const { return ref_count; }
 	inline bool isLastRef() const { return !isConstant && ref_count == activation_refcount; }
@@ -85,7 +101,12 @@ public:
 			if (ref_count == activation_refcount)
 				return handleDestruction();
 			else
+			{
+				// buffer before decrementing, another thread may release the last reference
+				if (cycleCollectable && !cycleCandidate && threadCycleCollector)
+					bufferCycleCandidate();
 				--ref_count;
+			}
 		}
 		return cached;
 	}
@@ -21,6 +21,7 @@
 #include <algorithm>
 #include "backends/security.h"
 #include "scripting/abc.h"
+#include "scripting/abc_jit.h"
 #include "scripting/flash/events/flashevents.h"
 #include "scripting/flash/utils/flashutils.h"
 #include "scripting/flash/media/flashmedia.h"
@@ -39,6 +40,10 @@
 #include "backends/input.h"
 #include "backends/locale.h"
 #include "memory_support.h"
+#include "cyclecollector.h"
+#include "backends/bitmapdecoder.h"
+#include "sampler.h"
+#include "tracing.h"
 
 #ifdef ENABLE_CURL
 #include <curl/curl.h>
@@ -220,7 +225,7 @@ SystemState::SystemState(uint32_t fileSize, FLASH_MODE mode):
 	invalidateQueueHead(NullRef),invalidateQueueTail(NullRef),lastUsedStringId(0),lastUsedNamespaceId(0x7fffffff),
 	showProfilingData(false),allowFullscreen(false),flashMode(mode),swffilesize(fileSize),avm1global(nullptr),
 	currentVm(nullptr),builtinClasses(nullptr),useInterpreter(true),useFastInterpreter(false),useJit(false),ignoreUnhandledExceptions(false),exitOnError(ERROR_NONE),singleworker(true),
-	downloadManager(nullptr),extScriptObject(nullptr),scaleMode(SHOW_ALL),unaccountedMemory(nullptr),tagsMemory(nullptr),stringMemory(nullptr),textTokenMemory(nullptr),shapeTokenMemory(nullptr),morphShapeTokenMemory(nullptr),bitmapTokenMemory(nullptr),spriteTokenMemory(nullptr),
+	downloadManager(nullptr),extScriptObject(nullptr),scaleMode(SHOW_ALL),unaccountedMemory(nullptr),tagsMemory(nullptr),stringMemory(nullptr),textTokenMemory(nullptr),shapeTokenMemory(nullptr),morphShapeTokenMemory(nullptr),bitmapTokenMemory(nullptr),spriteTokenMemory(nullptr),cycleCollector(nullptr),bitmapDecoder(nullptr),sampler(nullptr),
 	static_SoundMixer_bufferTime(0),isinitialized(false)
 {
 	//Forge the builtin strings
@@ -269,6 +274,8 @@ SystemState::SystemState(uint32_t fileSize, FLASH_MODE mode):
 	morphShapeTokenMemory = allocateMemoryAccount("Tokens.MorphShape");
 	bitmapTokenMemory = allocateMemoryAccount("Tokens.Bitmap");
 	spriteTokenMemory = allocateMemoryAccount("Tokens.Sprite");
+	cycleCollector = new CycleCollector(allocateMemoryAccount("CycleCollector"));
+	bitmapDecoder = new BitmapDecoder(this, Config::getConfig()->getDecodedBitmapsSize());
 
 	null=new (unaccountedMemory) Null;
 	null->setSystemState(this);
@@ -307,9 +314,22 @@ SystemState::SystemState(uint32_t fileSize, FLASH_MODE mode):
 	threadPool=new ThreadPool(this);
 	downloadThreadPool=new ThreadPool(this);
 
+	if(getenv("LIGHTSPARK_FAST_FORWARD"))
+		EngineClock::setVirtual(true);
 	timerThread=new TimerThread(this);
 	frameTimerThread=new TimerThread(this);
+	sampler=new Sampler(this);
+	char* samplerOutput = getenv("LIGHTSPARK_SAMPLER_OUTPUT");
+	if(samplerOutput)
+		sampler->setOutput(samplerOutput);
+	char* traceOutput = getenv("LIGHTSPARK_TRACE_OUTPUT");
+	if(traceOutput)
+		Tracer::setOutput(traceOutput);
 	audioManager=nullptr;
+	char* audioOutput = getenv("LIGHTSPARK_AUDIO_OUTPUT");
+	if(audioOutput)
+		audioOutputFile=audioOutput;
+	softwareContext3D=getenv("LIGHTSPARK_SOFTWARE_CONTEXT3D")!=nullptr;
 	intervalManager=new IntervalManager();
 	securityManager=new SecurityManager();
 	localeManager = new LocaleManager();
@@ -324,7 +344,7 @@ SystemState::SystemState(uint32_t fileSize, FLASH_MODE mode):
 	stage->setRefConstant();
 	stage->setRoot(_MR(mainClip));
 	//Get starting time
-	startTime=compat_msectiming();
+	startTime=EngineClock::getTime();
 	
 	renderThread=new RenderThread(this);
 	inputThread=new InputThread(this);
@@ -576,6 +596,13 @@ void SystemState::saveMemoryUsageInformation(ofstream& out, int snapshotCount) c
 		if(it->bytes>0)
 			out << " n0: " << it->bytes << " " << it->name << endl;
 	}
+	cycleCollector->dumpStatistics(out);
+	bitmapDecoder->dumpStatistics(out);
+	sampler->dumpStatistics(out);
+#ifdef BASELINE_JIT_ENABLED
+	if(currentVm && currentVm->jit)
+		currentVm->jit->dumpStatistics(out);
+#endif
 }
 #endif
 
@@ -607,6 +634,11 @@ SystemState::~SystemState()
 	{
 		delete (*it);
 	}
+	// 4) the cycle collector may be accessed by all ASObjects until now
+	delete cycleCollector;
+	// the bitmaps of the tags may be destroyed until now
+	delete bitmapDecoder;
+	delete sampler;
 }
 
 void SystemState::destroy()
@@ -614,6 +646,7 @@ void SystemState::destroy()
 #ifdef PROFILING_SUPPORT
 	saveProfilingInformation();
 #endif
+	sampler->stop();
 	terminated.wait();
 	//Acquire the mutex to sure that the engines are not being started right now
 	Locker l(rootMutex);
@@ -630,6 +663,9 @@ void SystemState::destroy()
 	}
 
 	l.release();
+	//All spans of the frame processing are closed now
+	Tracer::write(this);
+	EngineClock::report();
 
 	//Kill our child process if any
 	if(childPid)
@@ -646,6 +682,8 @@ void SystemState::destroy()
 	assert(shutdown);
 
 	renderThread->stop();
+	//No more bitmaps must be queued for the thread pool
+	bitmapDecoder->stop();
 	/*
 	   Stop the downloads so that the thread pool does not keep waiting for data.
 	   Standalone downloader does not really need this as the downloading threads will
@@ -659,6 +697,9 @@ void SystemState::destroy()
 	if(threadPool)
 		threadPool->forceStop();
 	stopEngines();
+	//The vm is stopped, so no collection can be running. Forget all candidates
+	//as the objects will be freed by the finalization below
+	cycleCollector->stop();
 
 	delete extScriptObject;
 	delete intervalManager;
@@ -826,7 +867,7 @@ void SystemState::EngineCreator::threadAbort()
  */
 void SystemState::delayedCreation(SystemState* sys)
 {
-	sys->audioManager=new AudioManager(sys->engineData);
+	sys->audioManager=new AudioManager(sys->engineData,sys->audioOutputFile);
 	sys->localstorageallowed =sys->getEngineData()->getLocalStorageAllowedMarker();
 	int32_t reqWidth=sys->mainClip->getFrameSize().Xmax/20;
 	int32_t reqHeight=sys->mainClip->getFrameSize().Ymax/20;
@@ -1189,6 +1230,7 @@ void SystemState::flushInvalidationQueue()
 {
 	if (isShuttingDown())
 		return;
+	LS_TRACE_SCOPE("render","flushInvalidationQueue");
 	Locker l(invalidateQueueLock);
 	_NR<DisplayObject> cur=invalidateQueueHead;
 	while(!cur.isNull())
@@ -1262,6 +1304,15 @@ void SystemState::swapAsyncDrawJobQueue()
 	drawjobLock.unlock();
 }
 
+void SystemState::setSamplerOutput(const tiny_string& t)
+{
+	sampler->setOutput(t);
+}
+
+void SystemState::setAudioOutput(const tiny_string& t)
+{
+	audioOutputFile=t;
+}
 
 #ifdef PROFILING_SUPPORT
 void SystemState::setProfilingOutput(const tiny_string& t)
@@ -1491,6 +1542,7 @@ void ParseThread::parseSWFHeader(RootMovieClip *root, UI8 ver)
 void ParseThread::execute()
 {
 	tls_set(parse_thread_tls,this);
+	LS_TRACE_SCOPE("parse","ParseThread");
 	try
 	{
 		UI8 Signature[4];
@@ -1675,6 +1727,7 @@ void ParseThread::parseSWF(UI8 ver)
 				{
 					// The whole frame has been parsed, now execute all queued SymbolClass tags,
 					// in the order in which they appeared in the file.
+					LS_TRACE_SCOPE("parse","commitFrame");
 					while(!queuedTags.empty())
 					{
 						const ControlTag* t=queuedTags.front();
@@ -2048,6 +2101,23 @@ void RootMovieClip::setVariableByString(const string& s, ASObject* o)
 }*/
 
 
+void SystemState::broadcastFrameEvent(const tiny_string& type)
+{
+	Locker l(mutexFrameListeners);
+	if(frameListeners.empty())
+		return;
+	_R<Event> e(Class<Event>::getInstanceS(this,type));
+	_R<BroadcastEvent> broadcast=_MR(new (unaccountedMemory) BroadcastEvent(e,frameListeners));
+	//Like addEvent does for every single event, the parents are kept alive until the event is handled
+	for(auto it=frameListeners.begin();it!=frameListeners.end();it++)
+		(*it)->onNewEvent(e.getPtr());
+	if(!currentVm->addEvent(NullRef,broadcast))
+	{
+		for(auto it=frameListeners.begin();it!=frameListeners.end();it++)
+			(*it)->afterHandleEvent(e.getPtr());
+	}
+}
+
 void SystemState::tick()
 {
 	if (showProfilingData)
@@ -2059,11 +2129,13 @@ void SystemState::tick()
 	}
 	if(currentVm==nullptr)
 		return;
+	LS_TRACE_SCOPE("frame","tick");
 	/* See http://www.senocular.com/flash/tutorials/orderofoperations/
 	 * for the description of steps.
 	 */
 
 	currentVm->setIdle(false);
+	EngineClock::countFrame();
 	if (firsttick)
 	{
 		// the first AdvanceFrame is done during the construction of the RootMovieClip,
@@ -2079,18 +2151,7 @@ void SystemState::tick()
 	}
 
 	/* Step 2: Send enterFrame events, if needed */
-	{
-		Locker l(mutexFrameListeners);
-		if(!frameListeners.empty())
-		{
-			_R<Event> e(Class<Event>::getInstanceS(this,"enterFrame"));
-			auto it=frameListeners.begin();
-			for(;it!=frameListeners.end();it++)
-			{
-				getVm(this)->addEvent(*it,e);
-			}
-		}
-	}
+	broadcastFrameEvent("enterFrame");
 
 	/* Step 3: create legacy objects, which are new in this frame (top-down),
 	 * run their constructors (bottom-up) */
@@ -2098,35 +2159,13 @@ void SystemState::tick()
 	currentVm->addEvent(NullRef, _MR(new (unaccountedMemory) InitFrameEvent(_MR(stage))));
 
 	/* Step 4: dispatch frameConstructed events */
-	{
-		Locker l(mutexFrameListeners);
-		if(!frameListeners.empty())
-		{
-			_R<Event> e(Class<Event>::getInstanceS(this,"frameConstructed"));
-			auto it=frameListeners.begin();
-			for(;it!=frameListeners.end();it++)
-			{
-				getVm(this)->addEvent(*it,e);
-			}
-		}
-	}
+	broadcastFrameEvent("frameConstructed");
 	/* Step 5: run all frameScripts (bottom-up) */
 	stage->incRef();
 	currentVm->addEvent(NullRef, _MR(new (unaccountedMemory) ExecuteFrameScriptEvent(_MR(stage))));
 
 	/* Step 6: dispatch exitFrame event */
-	{
-		Locker l(mutexFrameListeners);
-		if(!frameListeners.empty())
-		{
-			_R<Event> e(Class<Event>::getInstanceS(this,"exitFrame"));
-			auto it=frameListeners.begin();
-			for(;it!=frameListeners.end();it++)
-			{
-				getVm(this)->addEvent(*it,e);
-			}
-		}
-	}
+	broadcastFrameEvent("exitFrame");
 	/* TODO: Step 7: dispatch render event (Assuming stage.invalidate() has been called) */
 
 	/* Step 9: we are idle now, so we can handle all input events */
@@ -2139,6 +2178,15 @@ void SystemState::tickFence()
 {
 }
 
+void SystemState::waitUntilIdle()
+{
+	if(currentVm==nullptr)
+		return;
+	_R<SyncEvent> sync = _MR(new (unaccountedMemory) SyncEvent());
+	if (currentVm->addEvent(NullRef, sync))
+		sync->wait();
+}
+
 void SystemState::resizeCompleted()
 {
 	mainClip->resizeCompleted();
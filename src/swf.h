@@ -62,6 +62,9 @@ class SecurityDomain;
 class Class_inherit;
 class FontTag;
 class SoundTransform;
+class CycleCollector;
+class BitmapDecoder;
+class Sampler;
 
 class RootMovieClip: public MovieClip
 {
@@ -263,6 +266,8 @@ private:
 
 	Mutex mutexFrameListeners;
 	std::set<_R<DisplayObject>> frameListeners;
+	// queues one event dispatching type to all the frame listeners
+	void broadcastFrameEvent(const tiny_string& type);
 	/*
 	   The head of the invalidate queue
 	*/
@@ -345,6 +350,8 @@ public:
 	}
 	void tick() override;
 	void tickFence() override;
+	// blocks until the VM has handled the events queued until now
+	void waitUntilIdle();
 	RenderThread* getRenderThread() const { return renderThread; }
 	InputThread* getInputThread() const { return inputThread; }
 	void setParamsAndEngine(EngineData* e, bool s) DLL_PUBLIC;
@@ -401,6 +408,11 @@ public:
 	ABCVm* currentVm;
 
 	AudioManager* audioManager;
+	// the audio is mixed into this WAV file instead of the audio device if it is set
+	tiny_string audioOutputFile;
+	void setAudioOutput(const tiny_string& t) DLL_PUBLIC;
+	// every Context3D is created with the software renderer, as if renderMode "software" was requested
+	bool softwareContext3D;
 
 	//Application starting time in milliseconds
 	uint64_t startTime;
@@ -511,6 +523,11 @@ public:
 	MemoryAccount* morphShapeTokenMemory;
 	MemoryAccount* bitmapTokenMemory;
 	MemoryAccount* spriteTokenMemory;
+	CycleCollector* cycleCollector;
+	BitmapDecoder* bitmapDecoder;
+	Sampler* sampler;
+	// write the samples of the sampling profiler to the given file at shutdown
+	void setSamplerOutput(const tiny_string& t) DLL_PUBLIC;
 #ifdef MEMORY_USAGE_PROFILING
 	void saveMemoryUsageInformation(std::ofstream& out, int snapshotCount) const;
 #endif
@@ -1480,15 +1480,18 @@ std::istream& lightspark::operator>>(std::istream& s, CLIPACTIONRECORD& v)
 		s >> v.KeyCode;
 		len -= 1;
 	}
+	std::vector<uint8_t> actions;
+	uint32_t startactionpos=0;
 	if (v.datatag)
 	{
-		v.startactionpos=v.datatag->numbytes+v.dataskipbytes;
-		v.actions.resize(len+v.startactionpos);
-		memcpy(v.actions.data(),v.datatag->bytes,v.datatag->numbytes);
+		startactionpos=v.datatag->numbytes+v.dataskipbytes;
+		actions.resize(len+startactionpos);
+		memcpy(actions.data(),v.datatag->bytes,v.datatag->numbytes);
 	}
 	else
-		v.actions.resize(len);
-	s.read((char*)(v.actions.data()+v.startactionpos),len);
+		actions.resize(len);
+	s.read((char*)(actions.data()+startactionpos),len);
+	v.actions=_MR(new AVM1Code(getSys(),actions,startactionpos));
 	return s;
 }
 
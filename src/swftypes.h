@@ -64,7 +64,7 @@ enum CLASS_SUBTYPE { SUBTYPE_NOT_SET, SUBTYPE_PROXY, SUBTYPE_REGEXP, SUBTYPE_XML
 					 ,SUBTYPE_CONTEXT3D,SUBTYPE_TEXTUREBASE,SUBTYPE_TEXTURE,SUBTYPE_CUBETEXTURE,SUBTYPE_RECTANGLETEXTURE,SUBTYPE_VIDEOTEXTURE,SUBTYPE_VECTOR3D,SUBTYPE_NETSTREAM
 					 ,SUBTYPE_WORKER,SUBTYPE_WORKERDOMAIN,SUBTYPE_MUTEX,SUBTYPE_AVM1FUNCTION,SUBTYPE_SAMPLEDATA_EVENT
 					 ,SUBTYPE_BITMAPFILTER,SUBTYPE_GLOWFILTER,SUBTYPE_DROPSHADOWFILTER,SUBTYPE_GRADIENTGLOWFILTER,SUBTYPE_BEVELFILTER,SUBTYPE_COLORMATRIXFILTER,SUBTYPE_BLURFILTER,SUBTYPE_CONVOLUTIONFILTER,SUBTYPE_DISPLACEMENTFILTER,SUBTYPE_GRADIENTBEVELFILTER,SUBTYPE_SHADERFILTER
-					 ,SUBTYPE_THROTTLE_EVENT,SUBTYPE_CONTEXTMENUEVENT,SUBTYPE_GAMEINPUTEVENT, SUBTYPE_GAMEINPUTDEVICE, SUBTYPE_VIDEO
+					 ,SUBTYPE_THROTTLE_EVENT,SUBTYPE_CONTEXTMENUEVENT,SUBTYPE_GAMEINPUTEVENT, SUBTYPE_GAMEINPUTDEVICE, SUBTYPE_VIDEO, SUBTYPE_DICTIONARY, SUBTYPE_OBJECTPROTOTYPE
 				   };
  
 enum STACK_TYPE{STACK_NONE=0,STACK_OBJECT,STACK_INT,STACK_UINT,STACK_NUMBER,STACK_BOOLEAN};
@@ -991,6 +991,29 @@ enum FILL_STYLE_TYPE { SOLID_FILL=0x00, LINEAR_GRADIENT=0x10, RADIAL_GRADIENT=0x
 
 class BitmapContainer;
 
+/*
+ * Reference to a BitmapContainer that pins its pixels, so that they are not evicted
+ * while they may be read. Tag bitmaps are constant, so their reference count can not
+ * tell if they are used. The methods are defined in BitmapContainer.cpp
+ */
+class DLL_PUBLIC PinnedBitmap
+{
+private:
+	_NR<BitmapContainer> bitmap;
+public:
+	PinnedBitmap() {}
+	PinnedBitmap(_NR<BitmapContainer> b);
+	PinnedBitmap(const PinnedBitmap& r);
+	~PinnedBitmap();
+	PinnedBitmap& operator=(const PinnedBitmap& r);
+	PinnedBitmap& operator=(_NR<BitmapContainer> b);
+	BitmapContainer* operator->() const { return bitmap.getPtr(); }
+	BitmapContainer* getPtr() const { return bitmap.getPtr(); }
+	bool isNull() const { return bitmap.isNull(); }
+	void reset();
+	operator _NR<BitmapContainer>() const;
+};
+
 class FILLSTYLE
 {
 public:
@@ -1001,7 +1024,7 @@ public:
 	MATRIX Matrix;
 	GRADIENT Gradient;
 	FOCALGRADIENT FocalGradient;
-	_NR<BitmapContainer> bitmap;
+	PinnedBitmap bitmap;
 	RECT ShapeBounds;
 	RGBA Color;
 	FILL_STYLE_TYPE FillStyleType;
@@ -1429,16 +1452,85 @@ public:
 
 class AdditionalDataTag;
 class ACTIONRECORD;
+class SystemState;
+
+// index of the "instruction" following the last action of an AVM1Code
+#define AVM1_END_OF_CODE UINT32_MAX
+
+/*
+ * Action records decoded once into a compact instruction stream, so the interpreter does not
+ * parse the raw bytes on every execution. All actions reachable from the start position are
+ * decoded when the code is created: strings (including the constant pool) are resolved to
+ * unique string ids, branch targets to instruction indices and function bodies to their own AVM1Code.
+ * The raw bytes are not kept.
+ */
+class AVM1Code: public RefCountable
+{
+friend class ACTIONRECORD;
+public:
+	struct Instruction
+	{
+		// byte offset of the action, used for the end of ActionWith blocks and logging
+		uint32_t pos;
+		// index of the following instruction
+		uint32_t next;
+		// ActionJump/ActionIf: index of the branch target, ActionWith: byte offset of the end of the block
+		uint32_t target;
+		// operands, their meaning depends on the opcode
+		uint32_t arg1;
+		uint32_t arg2;
+		uint8_t opcode;
+	};
+	struct PushValue
+	{
+		uint8_t type;
+		union
+		{
+			uint32_t stringID;
+			uint32_t index;
+			int32_t intval;
+			number_t numberval;
+			bool boolval;
+		};
+	};
+	struct FunctionDefinition
+	{
+		tiny_string name;
+		std::vector<uint32_t> paramnames;
+		std::vector<uint8_t> registernumbers;
+		_NR<AVM1Code> body;
+		// flags of ActionDefineFunction2
+		uint8_t flags;
+		bool preloadGlobal;
+		bool isFunction2;
+	};
+private:
+	std::vector<Instruction> instructions;
+	std::vector<PushValue> pushvalues;
+	std::vector<uint32_t> constants;
+	std::vector<tiny_string> strings;
+	std::vector<FunctionDefinition> functions;
+	uint32_t startinstruction;
+	// number of registers accessed by the code
+	uint32_t registercount;
+	// decodes the actions from pos up to the next already decoded action, returns the index of the first one
+	uint32_t decodeFrom(SystemState* sys, const uint8_t* data, uint32_t size, uint32_t pos, std::vector<uint32_t>& instructionAt, std::vector<uint32_t>& branches);
+	void decode(SystemState* sys, const uint8_t* data, uint32_t size, uint32_t startpos);
+public:
+	AVM1Code(SystemState* sys, const std::vector<uint8_t>& actions, uint32_t startpos);
+	AVM1Code(SystemState* sys, const uint8_t* data, uint32_t size);
+	uint32_t getRegisterCount() const { return registercount; }
+};
+
 class CLIPACTIONRECORD
 {
 public:
-	CLIPACTIONRECORD(uint32_t v, uint32_t _dataskipbytes,AdditionalDataTag* _datatag):EventFlags(v),startactionpos(0),dataskipbytes(_dataskipbytes),datatag( _datatag) {}
+	CLIPACTIONRECORD(uint32_t v, uint32_t _dataskipbytes,AdditionalDataTag* _datatag):EventFlags(v),dataskipbytes(_dataskipbytes),datatag( _datatag) {}
 	CLIPEVENTFLAGS EventFlags;
 	UI32_SWF ActionRecordSize;
 	UI8 KeyCode;
-	std::vector<uint8_t> actions;
+	_NR<AVM1Code> actions;
 	bool isLast();
-	uint32_t startactionpos;
 	uint32_t dataskipbytes;
 	AdditionalDataTag* datatag;
 };
@@ -1501,13 +1593,14 @@ public:
 	}
 };
 class Activation_object;
+class AVM1Stack;
 class ACTIONRECORD
 {
 public:
-	static void PushStack(std::stack<asAtom>& stack,const asAtom& a);
-	static asAtom PopStack(std::stack<asAtom>& stack);
-	static asAtom PeekStack(std::stack<asAtom>& stack);
-	static void executeActions(DisplayObject* clip, AVM1context* context, const std::vector<uint8_t> &actionlist, uint32_t startactionpos, std::map<uint32_t, union asAtom> &scopevariables, asAtom *result = nullptr, asAtom* obj = nullptr, asAtom *args = nullptr, uint32_t num_args=0, const std::vector<uint32_t>& paramnames=std::vector<uint32_t>(), const std::vector<uint8_t>& paramregisternumbers=std::vector<uint8_t>(),
+	static void PushStack(AVM1Stack& stack,const asAtom& a);
+	static asAtom PopStack(AVM1Stack& stack);
+	static asAtom PeekStack(AVM1Stack& stack);
+	static void executeActions(DisplayObject* clip, AVM1context* context, const AVM1Code* code, std::map<uint32_t, union asAtom> &scopevariables, asAtom *result = nullptr, asAtom* obj = nullptr, asAtom *args = nullptr, uint32_t num_args=0, const std::vector<uint32_t>& paramnames=std::vector<uint32_t>(), const std::vector<uint8_t>& paramregisternumbers=std::vector<uint8_t>(),
 			bool preloadParent=false, bool preloadRoot=false, bool suppressSuper=true, bool preloadSuper=false, bool suppressArguments=false, bool preloadArguments=false, bool suppressThis=true, bool preloadThis=false, bool preloadGlobal=false, AVM1Function *caller = nullptr, AVM1Function *callee = nullptr, Activation_object *actobj=nullptr, asAtom* superobj=nullptr);
 };
 class BUTTONCONDACTION
@@ -1516,7 +1609,7 @@ friend std::istream& operator>>(std::istream& s, BUTTONCONDACTION& v);
 public:
 	BUTTONCONDACTION():CondActionSize(0)
 	  ,CondIdleToOverDown(false),CondOutDownToIdle(false),CondOutDownToOverDown(false),CondOverDownToOutDown(false)
-	  ,CondOverDownToOverUp(false),CondOverUpToOverDown(false),CondOverUpToIdle(false),CondIdleToOverUp(false),CondOverDownToIdle(false),startactionpos(0)
+	  ,CondOverDownToOverUp(false),CondOverUpToOverDown(false),CondOverUpToIdle(false),CondIdleToOverUp(false),CondOverDownToIdle(false)
 	{}
 	UI16_SWF CondActionSize;
 	bool CondIdleToOverDown;
@@ -1529,8 +1622,7 @@ public:
 	bool CondIdleToOverUp;
 	bool CondOverDownToIdle;
 	uint32_t CondKeyPress;
-	uint32_t startactionpos;
-	std::vector<uint8_t> actions;
+	_NR<AVM1Code> actions;
 };
 
 ASObject* abstract_i(SystemState *sys, int32_t i);
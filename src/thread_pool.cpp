@@ -16,6 +16,7 @@
     You should have received a copy of the GNU Lesser General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
+#include <algorithm>
 #include <cassert>
 
 #include "thread_pool.h"
@@ -23,19 +24,68 @@
 #include "compat.h"
 #include "logger.h"
 #include "swf.h"
+#include "tracing.h"
 
 using namespace lightspark;
 
-ThreadPool::ThreadPool(SystemState* s):num_jobs(0),stopFlag(false)
+//The worker the current thread belongs to, if any
+DEFINE_AND_INITIALIZE_TLS(tls_worker);
+
+ThreadPool::ThreadPool(SystemState* s):numSlots(0),numWorkers(0),idleWorkers(0),nextWorker(0),num_jobs(0),executedJobs(0),stolenJobs(0),m_sys(s),stopFlag(false)
 {
-	m_sys=s;
-	for(uint32_t i=0;i<NUM_THREADS;i++)
+	for(uint32_t i=0;i<JOB_PRIORITY_COUNT;i++)
+		queuedJobs[i]=0;
+	int cpus=SDL_GetCPUCount();
+	baseWorkers=std::max(cpus,THREADPOOL_MIN_THREADS);
+	if(baseWorkers>THREADPOOL_MAX_THREADS)
+		baseWorkers=THREADPOOL_MAX_THREADS;
+	maxWorkers=std::min(baseWorkers+THREADPOOL_BLOCKING_MARGIN,THREADPOOL_MAX_THREADS);
+	for(int i=0;i<baseWorkers;i++)
+		spawnWorker();
+}
+
+void ThreadPool::spawnWorker()
+{
+	Locker l(spawnMutex);
+	if(stopFlag || numWorkers>=maxWorkers)
+		return;
+	//Reuse the slot of a retired worker, its queues may already hold jobs
+	Worker* w=nullptr;
+	for(int32_t i=0;i<numSlots;i++)
+	{
+		if(!workers[i].running)
+		{
+			w=&workers[i];
+			break;
+		}
+	}
+	if(w==nullptr)
+	{
+		w=&workers[numSlots];
+		w->pool=this;
+		w->index=numSlots;
+		//The slot may receive jobs as soon as it is counted, the others will steal them until it runs
+		numSlots++;
+	}
+	else if(w->thread)
 	{
-		curJobs[i]=nullptr;
-		data[i].index=i;
-		data[i].pool = this;
-		threads[i] = SDL_CreateThread(job_worker,"ThreadPool",&data[i]);
+		//The retired thread has already left the pool, it only has to return
+		SDL_WaitThread(w->thread,nullptr);
+		w->thread=nullptr;
 	}
+	w->running=true;
+	numWorkers++;
+	w->thread=SDL_CreateThread(job_worker,"ThreadPool",w);
+}
+
+bool ThreadPool::retireWorker(Worker* w)
+{
+	Locker l(spawnMutex);
+	if(stopFlag || numWorkers<=baseWorkers)
+		return false;
+	w->running=false;
+	numWorkers--;
+	return true;
 }
 
 void ThreadPool::forceStop()
@@ -43,32 +93,43 @@ void ThreadPool::forceStop()
 	if(!stopFlag)
 	{
 		stopFlag=true;
+		//No worker can be created after this point
+		spawnMutex.lock();
+		uint32_t count=numSlots;
+		spawnMutex.unlock();
+
 		//Signal an event for all the threads
-		for(int i=0;i<NUM_THREADS;i++)
+		for(uint32_t i=0;i<count;i++)
 			num_jobs.signal();
 
+		for(uint32_t i=0;i<count;i++)
 		{
-			Locker l(mutex);
+			Worker* w=&workers[i];
+			Locker l(w->mutex);
 			//Now abort any job that is still executing
-			for(int i=0;i<NUM_THREADS;i++)
+			if(w->curJob)
 			{
-				if(curJobs[i])
-				{
-					curJobs[i]->threadAborting = true;
-					curJobs[i]->threadAbort();
-				}
+				w->curJob->threadAborting = true;
+				w->curJob->threadAbort();
 			}
 			//Fence all the non executed jobs
-			std::deque<IThreadJob*>::iterator it=jobs.begin();
-			for(;it!=jobs.end();++it)
-				(*it)->jobFence();
-			jobs.clear();
+			for(uint32_t p=0;p<JOB_PRIORITY_COUNT;p++)
+			{
+				std::deque<IThreadJob*>::iterator it=w->jobs[p].begin();
+				for(;it!=w->jobs[p].end();++it)
+					(*it)->jobFence();
+				queuedJobs[p]-=w->jobs[p].size();
+				w->jobs[p].clear();
+			}
 		}
 
-		for(int i=0;i<NUM_THREADS;i++)
+		for(uint32_t i=0;i<count;i++)
 		{
-			SDL_WaitThread(threads[i],nullptr);
+			if(workers[i].thread)
+				SDL_WaitThread(workers[i].thread,nullptr);
+			workers[i].thread=nullptr;
 		}
+		LOG(LOG_INFO,"ThreadPool: "<<executedJobs<<" jobs executed by "<<count<<" threads, "<<stolenJobs<<" stolen from other threads");
 	}
 }
 
@@ -77,35 +138,91 @@ ThreadPool::~ThreadPool()
 	forceStop();
 }
 
+IThreadJob* ThreadPool::popJobFrom(Worker* w, JOB_PRIORITY p, bool steal)
+{
+	Locker l(w->mutex);
+	if(w->jobs[p].empty())
+		return nullptr;
+	//Both the owner and the thieves take the oldest job, to keep the order in which jobs were added
+	IThreadJob* ret=w->jobs[p].front();
+	w->jobs[p].pop_front();
+	queuedJobs[p]--;
+	if(steal)
+		stolenJobs++;
+	return ret;
+}
+
+IThreadJob* ThreadPool::popJob(Worker* w)
+{
+	//The semaphore guarantees that a job is queued for us, but another worker
+	//may have taken the one we would find first, so just look again
+	while(!stopFlag)
+	{
+		for(uint32_t p=0;p<JOB_PRIORITY_COUNT;p++)
+		{
+			if(queuedJobs[p]<=0)
+				continue;
+			IThreadJob* job=popJobFrom(w,(JOB_PRIORITY)p,false);
+			if(job)
+				return job;
+			uint32_t count=numSlots;
+			for(uint32_t i=1;i<count;i++)
+			{
+				job=popJobFrom(&workers[(w->index+i)%count],(JOB_PRIORITY)p,true);
+				if(job)
+					return job;
+			}
+		}
+	}
+	return nullptr;
+}
+
 int ThreadPool::job_worker(void *d)
 {
-	ThreadPoolData* data = (ThreadPoolData*)d;
-	setTLSSys(data->pool->m_sys);
+	Worker* w = (Worker*)d;
+	ThreadPool* pool = w->pool;
+	setTLSSys(pool->m_sys);
+	tls_set(tls_worker,w);
+	Tracer::setThreadName("ThreadPool");
 
-	ThreadProfile* profile=data->pool->m_sys->allocateProfiler(RGB(200,200,0));
-	char buf[16];
-	snprintf(buf,16,"Thread %u",data->index);
-	profile->setTag(buf);
+	//A respawned worker keeps the profile of its slot
+	if(w->profile==nullptr)
+	{
+		w->profile=pool->m_sys->allocateProfiler(RGB(200,200,0));
+		char buf[16];
+		snprintf(buf,16,"Thread %u",w->index);
+		w->profile->setTag(buf);
+	}
+	ThreadProfile* profile=w->profile;
 
 	Chronometer chronometer;
 	while(1)
 	{
-		data->pool->num_jobs.wait();
-		if(data->pool->stopFlag)
+		pool->idleWorkers++;
+		bool signaled=pool->num_jobs.wait_timeout(THREADPOOL_IDLE_TIMEOUT);
+		pool->idleWorkers--;
+		if(pool->stopFlag)
+			return 0;
+		//Jobs queued to a retired slot are stolen by the other workers
+		if(!signaled)
+		{
+			if(pool->retireWorker(w))
+				return 0;
+			continue;
+		}
+		IThreadJob* myJob=pool->popJob(w);
+		if(!myJob)
 			return 0;
-		Locker l(data->pool->mutex);
-		IThreadJob* myJob=data->pool->jobs.front();
-		data->pool->jobs.pop_front();
-		data->pool->curJobs[data->index]=myJob;
-		l.release();
+		w->mutex.lock();
+		w->curJob=myJob;
+		w->mutex.unlock();
 
 		chronometer.checkpoint();
 		try
 		{
 			// it's possible that a job was added and will be executed while forcestop() has been called
-			if(data->pool->stopFlag)
-				return 0;
-			myJob->execute();
+			if(!pool->stopFlag)
+				myJob->execute();
 		}
 		catch(JobTerminationException& ex)
 		{
@@ -114,19 +231,20 @@ int ThreadPool::job_worker(void *d)
 		catch(LightsparkException& e)
 		{
 			LOG(LOG_ERROR,_("Exception in ThreadPool ") << e.what());
-			data->pool->m_sys->setError(e.cause);
+			pool->m_sys->setError(e.cause);
 		}
 		catch(std::exception& e)
 		{
 			LOG(LOG_ERROR,"std Exception in ThreadPool:"<<myJob<<" "<<e.what());
-			data->pool->m_sys->setError(e.what());
+			pool->m_sys->setError(e.what());
 		}
 		
 		profile->accountTime(chronometer.checkpoint());
+		pool->executedJobs++;
 
-		l.acquire();
-		data->pool->curJobs[data->index]=nullptr;
-		l.release();
+		w->mutex.lock();
+		w->curJob=nullptr;
+		w->mutex.unlock();
 
 		//jobFencing is allowed to happen outside the mutex
 		myJob->jobFence();
@@ -136,14 +254,28 @@ int ThreadPool::job_worker(void *d)
 
 void ThreadPool::addJob(IThreadJob* j)
 {
-	Locker l(mutex);
+	assert(j);
+	Worker* w=(Worker*)tls_get(tls_worker);
+	if(w==nullptr || w->pool!=this)
+		w=&workers[uint32_t(nextWorker++)%uint32_t(numSlots)];
+	JOB_PRIORITY p=j->getPriority();
+	w->mutex.lock();
 	if(stopFlag)
 	{
+		w->mutex.unlock();
 		j->jobFence();
 		return;
 	}
-	assert(j);
-	jobs.push_back(j);
+	w->jobs[p].push_back(j);
+	queuedJobs[p]++;
+	w->mutex.unlock();
 	num_jobs.signal();
-}
 
+	//Render jobs are short and cpu bound, so they can wait for a busy worker.
+	//Any other job may block for a long time, so it gets a new worker if it would have to wait
+	int32_t queued=0;
+	for(uint32_t i=0;i<JOB_PRIORITY_COUNT;i++)
+		queued+=queuedJobs[i];
+	if(idleWorkers==0 || (p!=JOB_PRIORITY_RENDER && queued>idleWorkers))
+		spawnWorker();
+}
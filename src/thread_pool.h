@@ -28,32 +28,81 @@
 namespace lightspark
 {
 
-#define NUM_THREADS 20
+/*
+ * The pool starts with one worker per cpu (but at least THREADPOOL_MIN_THREADS)
+ * and grows by up to THREADPOOL_BLOCKING_MARGIN workers when jobs are queued
+ * while all the workers are busy. Streams, sockets and loaders keep a worker for
+ * as long as they run, so the margin is as large as the fixed pool used to be,
+ * and the short jobs still find a worker while that many of them are running.
+ * The additional workers exit after THREADPOOL_IDLE_TIMEOUT ms without a job.
+ * THREADPOOL_MAX_THREADS is the number of worker slots.
+ */
+#define THREADPOOL_MIN_THREADS 4
+#define THREADPOOL_BLOCKING_MARGIN 20
+#define THREADPOOL_IDLE_TIMEOUT 10000
+#define THREADPOOL_MAX_THREADS 64
 
 class SystemState;
+class ThreadProfile;
 
 class ThreadPool
 {
 private:
-	struct ThreadPoolData
+	struct Worker
 	{
 		ThreadPool* pool;
-		int index;
+		uint32_t index;
+		SDL_Thread* thread;
+		ThreadProfile* profile;
+		IThreadJob* volatile curJob;
+		// protects the job queues of this worker and curJob
+		Mutex mutex;
+		std::deque<IThreadJob*> jobs[JOB_PRIORITY_COUNT];
+		// false once the thread has exited, the queues of the slot are still used until it is respawned
+		bool running;
+		Worker():pool(nullptr),index(0),thread(nullptr),profile(nullptr),curJob(nullptr),running(false) {}
 	};
-	Mutex mutex;
-	SDL_Thread* threads[NUM_THREADS];
-	ThreadPoolData data[NUM_THREADS];
-	IThreadJob* volatile curJobs[NUM_THREADS];
-	std::deque<IThreadJob*> jobs;
+	Worker workers[THREADPOOL_MAX_THREADS];
+	// number of slots that ever had a worker, the jobs are distributed and stolen among them
+	ATOMIC_INT32(numSlots);
+	// number of running workers
+	ATOMIC_INT32(numWorkers);
+	// the pool never shrinks below baseWorkers and never grows above maxWorkers
+	int32_t baseWorkers;
+	int32_t maxWorkers;
+	ATOMIC_INT32(idleWorkers);
+	// round robin counter for jobs added from outside the pool
+	ATOMIC_INT32(nextWorker);
+	// serializes the creation and retirement of workers against forceStop
+	Mutex spawnMutex;
+	// number of jobs in all the queues, a worker only looks for a job after taking one
 	Semaphore num_jobs;
+	// statistics
+	ATOMIC_INT32(queuedJobs[JOB_PRIORITY_COUNT]);
+	ATOMIC_INT32(executedJobs);
+	ATOMIC_INT32(stolenJobs);
 	static int job_worker(void* d);
+	void spawnWorker();
+	bool retireWorker(Worker* w);
+	IThreadJob* popJob(Worker* w);
+	IThreadJob* popJobFrom(Worker* w, JOB_PRIORITY p, bool steal);
 	SystemState* m_sys;
-	volatile bool stopFlag;
+	ACQUIRE_RELEASE_FLAG(stopFlag);
 public:
 	ThreadPool(SystemState* s);
 	~ThreadPool();
+	/*
+	 * Jobs added from a worker of this pool go to the queue of that worker,
+	 * the others are distributed round robin. Idle workers steal jobs from the
+	 * other queues, so a job is started as soon as any worker is free.
+	 */
 	void addJob(IThreadJob* j);
 	void forceStop();
+	uint32_t getThreadCount() const { return numWorkers; }
+	uint32_t getQueueDepth(JOB_PRIORITY p) const { return queuedJobs[p]; }
+	uint32_t getExecutedJobs() const { return executedJobs; }
+	// number of executed jobs that were taken from the queue of another worker
+	uint32_t getStolenJobs() const { return stolenJobs; }
 };
 
 }
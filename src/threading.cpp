@@ -56,6 +56,11 @@ bool Semaphore::try_wait()
 	return SDL_SemTryWait(sem)==0;
 }
 
+bool Semaphore::wait_timeout(uint32_t ms)
+{
+	return SDL_SemWaitTimeout(sem,ms)==0;
+}
+
 void Semaphore::signal()
 {
 	SDL_SemPost(sem);
@@ -122,6 +122,8 @@ public:
 	void signal();
 	void wait();
 	bool try_wait();
+	// returns false if the semaphore was not signaled within ms milliseconds
+	bool wait_timeout(uint32_t ms);
 };
 
 class SemaphoreLighter
@@ -144,6 +146,12 @@ public:
 	}
 };
 
+/*
+ * Scheduling class of a job. When several jobs are queued the ThreadPool
+ * always starts the ones with the lowest value first.
+ */
+enum JOB_PRIORITY { JOB_PRIORITY_RENDER=0, JOB_PRIORITY_DECODE, JOB_PRIORITY_NETWORK, JOB_PRIORITY_COUNT };
+
 class IThreadJob
 {
 friend class ThreadPool;
@@ -177,6 +185,12 @@ public:
 	 * 'delete this'.
 	 */
 	virtual void jobFence()=0;
+	/*
+	 * Used by the ThreadPool to order the queued jobs.
+	 * Jobs mostly waiting on the network should return JOB_PRIORITY_NETWORK,
+	 * jobs producing data needed for the next frame JOB_PRIORITY_RENDER.
+	 */
+	virtual JOB_PRIORITY getPriority() const { return JOB_PRIORITY_DECODE; }
 	IThreadJob() : threadAborting(false) {}
 	virtual ~IThreadJob() {}
 };
@@ -37,6 +37,7 @@ int main(int argc, char* argv[])
 	std::vector<char*> fileNames;
 	bool useInterpreter=true;
 	bool useJit=false;
+	bool fastForward=false;
 	LOG_LEVEL log_level=LOG_INFO;
 	bool error=false;
 
@@ -52,6 +53,11 @@ int main(int argc, char* argv[])
 		{
 			useJit=true;
 		}
+		else if(strcmp(argv[i],"-ff")==0 || 
+			strcmp(argv[i],"--fast-forward")==0)
+		{
+			fastForward=true;
+		}
 		else if(strcmp(argv[i],"-l")==0 || 
 			strcmp(argv[i],"--log-level")==0)
 		{
@@ -73,7 +79,7 @@ int main(int argc, char* argv[])
 
 	if(fileNames.empty() || error)
 	{
-		LOG(LOG_ERROR, "Usage: " << argv[0] << " [--disable-interpreter|-ni] [--enable-jit|-j] [--log-level|-l 0-4] <file.abc> [<file2.abc>]");
+		LOG(LOG_ERROR, "Usage: " << argv[0] << " [--disable-interpreter|-ni] [--enable-jit|-j] [--fast-forward|-ff] [--log-level|-l 0-4] <file.abc> [<file2.abc>]");
 		exit(-1);
 	}
 #ifdef HAVE_G_THREAD_INIT
@@ -81,6 +87,8 @@ int main(int argc, char* argv[])
 #endif
 	Log::setLogLevel(log_level);
 	SystemState::staticInit();
+	if(fastForward)
+		EngineClock::setVirtual(true);
 	//NOTE: see SystemState declaration
 	SystemState* sys=new SystemState(0, SystemState::FLASH);
 	setTLSSys(sys);
@@ -23,12 +23,116 @@
 
 #include "timer.h"
 #include "compat.h"
+#include "tracing.h"
 
 using namespace lightspark;
 using namespace std;
 
-TimerThread::TimerThread(SystemState* s):m_sys(s),stopped(false),joined(false)
+bool EngineClock::virtualClock=false;
+std::atomic<uint64_t> EngineClock::virtualTime(0);
+Mutex EngineClock::mutex;
+unordered_map<Cond*,uint64_t> EngineClock::waiting;
+uint32_t EngineClock::registeredThreads=0;
+bool EngineClock::vmWorking=false;
+uint64_t EngineClock::realStart=0;
+uint64_t EngineClock::virtualStart=0;
+std::atomic<uint32_t> EngineClock::frames(0);
+
+void EngineClock::setVirtual(bool v)
 {
+	virtualClock=v;
+	//The virtual clock starts at the current time, so both clocks can be compared at start
+	realStart=g_get_monotonic_time();
+	virtualStart=(realStart+G_TIME_SPAN_MILLISECOND/2)/G_TIME_SPAN_MILLISECOND;
+	virtualTime=virtualStart;
+}
+
+uint64_t EngineClock::getTime()
+{
+	if(virtualClock)
+		return virtualTime.load();
+	// round to full milliseconds, like CondTime
+	return (g_get_monotonic_time()+G_TIME_SPAN_MILLISECOND/2)/G_TIME_SPAN_MILLISECOND;
+}
+
+void EngineClock::registerThread(Cond* wakeUp)
+{
+	Locker l(mutex);
+	registeredThreads++;
+}
+
+void EngineClock::unregisterThread(Cond* wakeUp)
+{
+	Locker l(mutex);
+	registeredThreads--;
+	waiting.erase(wakeUp);
+}
+
+void EngineClock::idleUntil(Cond* wakeUp, uint64_t time)
+{
+	Locker l(mutex);
+	waiting[wakeUp]=time;
+	advance();
+}
+
+void EngineClock::advance()
+{
+	if(vmWorking || waiting.size()<registeredThreads)
+		return;
+	uint64_t next=UINT64_MAX;
+	for(auto it=waiting.begin();it!=waiting.end();++it)
+		next=min(next,it->second);
+	if(next==UINT64_MAX || next<=virtualTime.load())
+		return;
+	virtualTime=next;
+	//The threads whose events are due have to run them before the clock may advance again
+	for(auto it=waiting.begin();it!=waiting.end();)
+	{
+		if(it->second<=next)
+		{
+			it->first->signal();
+			it=waiting.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+void EngineClock::busy(Cond* wakeUp)
+{
+	Locker l(mutex);
+	waiting.erase(wakeUp);
+}
+
+void EngineClock::vmBusy()
+{
+	Locker l(mutex);
+	vmWorking=true;
+}
+
+void EngineClock::vmIdle()
+{
+	Locker l(mutex);
+	vmWorking=false;
+	//The threads may all be waiting already, events handled by the VM don't wake them up
+	advance();
+}
+
+void EngineClock::report()
+{
+	if(!virtualClock)
+		return;
+	double real=(g_get_monotonic_time()-realStart)/1000000.0;
+	double content=(virtualTime.load()-virtualStart)/1000.0;
+	uint32_t count=frames.load();
+	LOG(LOG_INFO,"Virtual clock: " << count << " frames, " << content << " s of content in " << real << " s, "
+		<< (real>0 ? count/real : 0) << " frames per second, " << (real>0 ? content/real : 0) << " times real time");
+}
+
+TimerThread::TimerThread(SystemState* s):wheelTime(getCurrentTime()),nextWakeUp(UINT64_MAX),changes(0),m_sys(s),stopped(false),joined(false)
+{
+	//Registered before the worker starts, so the virtual clock can't advance without it
+	EngineClock::registerThread(&newEvent);
 	t = SDL_CreateThread(&TimerThread::worker,"TimerThread",this);
 }
 
@@ -54,33 +158,150 @@ void TimerThread::wait()
 TimerThread::~TimerThread()
 {
 	stop();
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	for(;it!=pendingEvents.end();++it)
-		delete *it;
+	for(auto it=jobEvents.begin();it!=jobEvents.end();++it)
+		delete it->second;
 }
 
-void TimerThread::insertNewEvent_nolock(TimingEvent* e)
+void TimerThread::TimingEventList::append(TimingEvent* e)
+{
+	e->list=this;
+	e->next=nullptr;
+	e->prev=last;
+	if(last)
+		last->next=e;
+	else
+		first=e;
+	last=e;
+}
+
+void TimerThread::TimingEventList::remove(TimingEvent* e)
+{
+	if(e->prev)
+		e->prev->next=e->next;
+	else
+		first=e->next;
+	if(e->next)
+		e->next->prev=e->prev;
+	else
+		last=e->prev;
+	e->prev=nullptr;
+	e->next=nullptr;
+	e->list=nullptr;
+}
+
+uint64_t TimerThread::getCurrentTime()
+{
+	return EngineClock::getTime();
+}
+
+void TimerThread::insertInWheel(TimingEvent* e)
 {
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	//If there are no events pending, or this is earlier than the first, signal newEvent
-	if(pendingEvents.empty() || (*it)->wakeUpTime > e->wakeUpTime)
+	if(e->expires<=wheelTime)
 	{
-		pendingEvents.insert(it, e);
-		newEvent.signal();
+		dueEvents.append(e);
 		return;
 	}
-	++it;
+	uint64_t expires=e->expires;
+	uint64_t delta=expires-wheelTime;
+	//Events beyond the range of the wheel are put in the last slot, they are moved to the right one when cascading
+	if(delta>=(uint64_t(1)<<(TIMERWHEEL_BITS*TIMERWHEEL_LEVELS)))
+	{
+		delta=(uint64_t(1)<<(TIMERWHEEL_BITS*TIMERWHEEL_LEVELS))-1;
+		expires=wheelTime+delta;
+	}
+	uint32_t level=0;
+	while(level<TIMERWHEEL_LEVELS-1 && delta>=(uint64_t(1)<<(TIMERWHEEL_BITS*(level+1))))
+		level++;
+	wheel[level][(expires>>(TIMERWHEEL_BITS*level))&TIMERWHEEL_MASK].append(e);
+}
+
+void TimerThread::cascade(uint32_t level, uint32_t index)
+{
+	TimingEventList& slot=wheel[level][index];
+	while(!slot.empty())
+	{
+		TimingEvent* e=slot.first;
+		slot.remove(e);
+		insertInWheel(e);
+	}
+}
 
-	for(;it!=pendingEvents.end();++it)
+uint64_t TimerThread::getNextExpiration() const
+{
+	uint64_t ret=UINT64_MAX;
+	//Slots of level 0 never contain events that are TIMERWHEEL_SLOTS ms away
+	for(uint32_t i=1;i<TIMERWHEEL_SLOTS;i++)
 	{
-		if((*it)->wakeUpTime > e->wakeUpTime)
+		if(!wheel[0][(wheelTime+i)&TIMERWHEEL_MASK].empty())
 		{
-			pendingEvents.insert(it, e);
-			return;
+			ret=wheelTime+i;
+			break;
 		}
 	}
-	//Event has to be inserted after all the others
-	pendingEvents.insert(pendingEvents.end(), e);
+	//For the higher levels the time the slot is cascaded is relevant
+	for(uint32_t level=1;level<TIMERWHEEL_LEVELS;level++)
+	{
+		uint32_t shift=TIMERWHEEL_BITS*level;
+		uint64_t base=wheelTime>>shift;
+		for(uint32_t i=1;i<=TIMERWHEEL_SLOTS;i++)
+		{
+			if(((base+i)<<shift)>=ret)
+				break;
+			if(!wheel[level][(base+i)&TIMERWHEEL_MASK].empty())
+			{
+				ret=(base+i)<<shift;
+				break;
+			}
+		}
+	}
+	return ret;
+}
+
+void TimerThread::advance(uint64_t now)
+{
+	while(wheelTime<now)
+	{
+		uint64_t next=getNextExpiration();
+		if(next>now)
+		{
+			//Nothing to do until now
+			wheelTime=now;
+			break;
+		}
+		wheelTime=next;
+		if((wheelTime&TIMERWHEEL_MASK)==0)
+		{
+			//Cascade from the highest level whose slot was reached
+			uint32_t level=1;
+			while(level<TIMERWHEEL_LEVELS-1 && ((wheelTime>>(TIMERWHEEL_BITS*level))&TIMERWHEEL_MASK)==0)
+				level++;
+			for(;level>0;level--)
+				cascade(level,(wheelTime>>(TIMERWHEEL_BITS*level))&TIMERWHEEL_MASK);
+		}
+		TimingEventList& slot=wheel[0][wheelTime&TIMERWHEEL_MASK];
+		while(!slot.empty())
+		{
+			TimingEvent* e=slot.first;
+			slot.remove(e);
+			dueEvents.append(e);
+		}
+	}
+}
+
+void TimerThread::insertNewEvent_nolock(TimingEvent* e)
+{
+	jobEvents.insert(make_pair(e->job,e));
+	insertInWheel(e);
+	changes++;
+	//Wake up the worker if this event is earlier than the one it is waiting for
+	if(e->expires<nextWakeUp)
+	{
+		nextWakeUp=e->expires;
+		//The virtual clock may not pass the new event before the worker has seen it
+		if(EngineClock::isVirtual())
+			EngineClock::busy(&newEvent);
+		newEvent.signal();
+	}
 }
 
 void TimerThread::insertNewEvent(TimingEvent* e)
@@ -89,13 +310,41 @@ void TimerThread::insertNewEvent(TimingEvent* e)
 	insertNewEvent_nolock(e);
 }
 
+void TimerThread::unlinkEvent(TimingEvent* e)
+{
+	if(e->list)
+		e->list->remove(e);
+	auto range=jobEvents.equal_range(e->job);
+	for(auto it=range.first;it!=range.second;++it)
+	{
+		if(it->second==e)
+		{
+			jobEvents.erase(it);
+			break;
+		}
+	}
+}
+
 //Unsafe debugging routine
 void TimerThread::dumpJobs()
 {
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	//Find if the job is in the list
-	for(;it!=pendingEvents.end();++it)
-		LOG(LOG_INFO, (*it)->job );
+	for(auto it=jobEvents.begin();it!=jobEvents.end();++it)
+		LOG(LOG_INFO, it->first << " " << it->second->expires);
+}
+
+bool TimerThread::waitForVM(Locker& l, uint32_t& idleChanges)
+{
+	if(idleChanges==changes)
+		return false;
+	/* The jobs that ran may have queued events for the VM, which may
+	 * add earlier events, so the clock can't advance until it is idle
+	 */
+	uint32_t current=changes;
+	l.release();
+	m_sys->waitUntilIdle();
+	l.acquire();
+	idleChanges=current;
+	return true;
 }
 
 /*
@@ -103,80 +352,115 @@ void TimerThread::dumpJobs()
  *
  * It holds "mutex" all the time but
  *   1. when waiting for on newEvent or for the correct time to execute a job.
- *   2. while executing e->job->tick() (during this time inExectution == e->job)
- * The pendingEvents queue may be altered by another thread with "mutex"
- * An event may be deleted by another thread with "mutex" only if inExectution != jobToDelete
+ *   2. while executing e->job->tick()
+ * All events that are due at a tick are moved to runningEvents at once and executed one after the other.
+ * The wheel and the event lists may be altered by another thread with "mutex"
+ * An event may be deleted by another thread with "mutex" only if it is in the wheel or an event list
  */
 int TimerThread::worker(void *d)
 {
 	TimerThread* th = (TimerThread*)d;
 	setTLSSys(th->m_sys);
+	Tracer::setThreadName("Timer");
+	// value of changes when the VM was last found idle, used by the virtual clock
+	uint32_t idleChanges=UINT32_MAX;
 
 	Locker l(th->mutex);
 	while(1)
 	{
-		/* Wait until the first event appears */
-		while(th->pendingEvents.empty())
-		{
-			th->newEvent.wait(th->mutex);
-			if(th->stopped)
-				return 0;
-		}
-
-		/* Get expiration of first event */
-		CondTime timing=th->pendingEvents.front()->wakeUpTime;
-		/* Wait for the absolute time or a newEvent signal
-		 * this unlocks the mutex and relocks it before returing
-		 */
-		timing.wait(th->mutex,th->newEvent);
-
 		if(th->stopped)
+		{
+			EngineClock::unregisterThread(&th->newEvent);
 			return 0;
+		}
 
-		if(th->pendingEvents.empty())
-			continue;
-
-		TimingEvent* e=th->pendingEvents.front();
-
-		/* check if the top event is due now. It could be have been removed/inserted
-		 * while we slept */
-		if(e->wakeUpTime.isInTheFuture())
+		/* Wait until the first event appears */
+		if(th->jobEvents.empty())
+		{
+			th->nextWakeUp=UINT64_MAX;
+			if(EngineClock::isVirtual())
+			{
+				if(th->waitForVM(l,idleChanges))
+					continue;
+				EngineClock::idleUntil(&th->newEvent,UINT64_MAX);
+			}
+			th->newEvent.wait(th->mutex);
 			continue;
+		}
 
-		th->pendingEvents.pop_front();
-
-		if(e->job->stopMe)
+		uint64_t now=getCurrentTime();
+		th->advance(now);
+		if(th->dueEvents.empty())
 		{
-			e->job->tickFence();
-			delete e;
+			th->nextWakeUp=th->getNextExpiration();
+			if(EngineClock::isVirtual())
+			{
+				if(th->waitForVM(l,idleChanges))
+					continue;
+				EngineClock::idleUntil(&th->newEvent,th->nextWakeUp);
+				//The clock may be advanced by another thread without waking us up in time
+				th->newEvent.wait_until(th->mutex,1);
+				continue;
+			}
+			/* Wait for the next expiration or a newEvent signal
+			 * this unlocks the mutex and relocks it before returing
+			 */
+			uint64_t waitTime=th->nextWakeUp-now;
+			th->newEvent.wait_until(th->mutex,waitTime>UINT32_MAX ? UINT32_MAX : uint32_t(waitTime));
 			continue;
 		}
 
-		if(e->isTick)
+		/* New events don't have to wake us up until the due events are executed */
+		th->nextWakeUp=0;
+		th->changes++;
+		if(EngineClock::isVirtual())
+			EngineClock::busy(&th->newEvent);
+		while(!th->dueEvents.empty())
 		{
-			/* re-enqueue*/
-			e->wakeUpTime.addMilliseconds(e->tickTime);
-			th->insertNewEvent_nolock(e);
+			TimingEvent* e=th->dueEvents.first;
+			th->dueEvents.remove(e);
+			th->runningEvents.append(e);
 		}
-
-		/* If e->isTick == false, e is not in pendingQueue anymore and this function has the only reference to it.
-		 * If e->isTick == true, we just enqueued e another time. If removeJob() is called on e->job from
-		 * job->tick() or another thread, then this will remove e from pendingQueue and delete e after we release the mutex.
-		 * In that case we may not access e after 'l.release()'.
-		 */
-		ITickJob* job = e->job;
-		bool isTick = e->isTick;
-		l.release();
-
-		job->tick();
-
-		l.acquire();
-
-		/* Cleanup */
-		if(!isTick)
+		while(!th->runningEvents.empty() && !th->stopped)
 		{
-			e->job->tickFence();
-			delete e;
+			TimingEvent* e=th->runningEvents.first;
+			if(e->job->stopMe)
+			{
+				th->unlinkEvent(e);
+				e->job->tickFence();
+				delete e;
+				continue;
+			}
+
+			if(e->isTick)
+			{
+				/* re-enqueue, a late tick is due again immediately so the missed ticks are caught up */
+				th->runningEvents.remove(e);
+				e->expires+=e->tickTime;
+				th->insertInWheel(e);
+			}
+			else
+				th->unlinkEvent(e);
+
+			/* If e->isTick == false, e is not in the wheel anymore and this function has the only reference to it.
+			 * If e->isTick == true, we just enqueued e another time. If removeJob() is called on e->job from
+			 * job->tick() or another thread, then this will remove e from the wheel and delete e after we release the mutex.
+			 * In that case we may not access e after 'l.release()'.
+			 */
+			ITickJob* job = e->job;
+			bool isTick = e->isTick;
+			l.release();
+
+			job->tick();
+
+			l.acquire();
+
+			/* Cleanup */
+			if(!isTick)
+			{
+				job->tickFence();
+				delete e;
+			}
 		}
 	}
 	return 0;
@@ -184,20 +468,20 @@ int TimerThread::worker(void *d)
 
 void TimerThread::addTick(uint32_t tickTime, ITickJob* job)
 {
-	TimingEvent* e=new TimingEvent(job, true, tickTime, 0);
+	TimingEvent* e=new TimingEvent(job, true, tickTime, getCurrentTime()+tickTime);
 	insertNewEvent(e);
 }
 
 void TimerThread::addWait(uint32_t waitTime, ITickJob* job)
 {
-	TimingEvent* e=new TimingEvent(job, false, 0, waitTime);
+	TimingEvent* e=new TimingEvent(job, false, 0, getCurrentTime()+waitTime);
 	insertNewEvent(e);
 }
 
 /*
  * removeJob()
  *
- * Removes the given job from the pendingEvents queue
+ * Removes the earliest pending event of the given job
  */
 void TimerThread::removeJob(ITickJob* job)
 {
@@ -206,28 +490,17 @@ void TimerThread::removeJob(ITickJob* job)
 }
 void TimerThread::removeJob_noLock(ITickJob* job)
 {
-
-	/* See if that job is currently pending */
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	bool first=true;
-	//Find if the job is in the list
-	for(;it!=pendingEvents.end();++it)
+	auto range=jobEvents.equal_range(job);
+	if(range.first==range.second)
+		return;
+	TimingEvent* e=range.first->second;
+	for(auto it=range.first;it!=range.second;++it)
 	{
-		if((*it)->job==job)
-			break;
-		first=false;
+		if(it->second->expires<e->expires)
+			e=it->second;
 	}
-
-	if(it==pendingEvents.end())
-		return;
-
-	TimingEvent* e=*it;
-	pendingEvents.erase(it);
+	unlinkEvent(e);
 	delete e;
-
-	/* the worker is waiting on this job, wake him up */
-	if(first)
-		newEvent.signal();
 }
 
 Chronometer::Chronometer()
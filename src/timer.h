@@ -22,6 +22,7 @@
 
 #include "compat.h"
 #include <list>
+#include <unordered_map>
 #include <ctime>
 #include "threading.h"
 
@@ -49,29 +50,84 @@ public:
 	virtual void tickFence() = 0;
 };
 
+#define TIMERWHEEL_BITS 8
+#define TIMERWHEEL_SLOTS (1<<TIMERWHEEL_BITS)
+#define TIMERWHEEL_MASK (TIMERWHEEL_SLOTS-1)
+#define TIMERWHEEL_LEVELS 4
+
+/*
+ * The pending events are kept in a hierarchical timing wheel with millisecond resolution.
+ * Level 0 has one slot per millisecond, each higher level has slots that are TIMERWHEEL_SLOTS
+ * times longer and whose events are moved ("cascaded") to the lower levels when
+ * the slot is reached. Adding and removing an event is O(1).
+ */
 class TimerThread
 {
 private:
+	struct TimingEventList;
 	class TimingEvent
 	{
 	public:
-		TimingEvent(ITickJob* _job, bool _isTick, uint32_t _tickTime, uint32_t _waitTime) 
-			: job(_job),wakeUpTime(_isTick ? _tickTime : _waitTime),tickTime(_tickTime),isTick(_isTick) {}
+		TimingEvent(ITickJob* _job, bool _isTick, uint32_t _tickTime, uint64_t _expires)
+			: job(_job),expires(_expires),tickTime(_tickTime),isTick(_isTick),prev(nullptr),next(nullptr),list(nullptr) {}
 		ITickJob* job;
-		CondTime wakeUpTime;
+		// expiration time in milliseconds of the monotonic clock
+		uint64_t expires;
 		uint32_t tickTime;
 		bool isTick;
+		TimingEvent* prev;
+		TimingEvent* next;
+		// the wheel slot or list the event is in, nullptr while the event is executed
+		TimingEventList* list;
+	};
+	struct TimingEventList
+	{
+		TimingEvent* first;
+		TimingEvent* last;
+		TimingEventList():first(nullptr),last(nullptr) {}
+		inline bool empty() const { return first==nullptr; }
+		void append(TimingEvent* e);
+		void remove(TimingEvent* e);
 	};
 	Mutex mutex;
 	Cond newEvent;
 	SDL_Thread* t;
-	std::list<TimingEvent*> pendingEvents;
+	TimingEventList wheel[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+	// events that are already due
+	TimingEventList dueEvents;
+	// the due events that are currently executed by the worker
+	TimingEventList runningEvents;
+	// time up to which the wheel has been processed
+	uint64_t wheelTime;
+	// time the worker will wake up at, used to decide if a new event has to wake it up earlier
+	uint64_t nextWakeUp;
+	// incremented when events are added or executed, the virtual clock waits for the VM after changes
+	uint32_t changes;
+	// all pending events by job, needed to remove a job without searching the wheel
+	std::unordered_multimap<ITickJob*,TimingEvent*> jobEvents;
 	SystemState* m_sys;
 	volatile bool stopped;
 	bool joined;
 	static int worker(void* d);
+	/*
+	 * With the virtual clock, waits for the VM to handle the events queued since it was last
+	 * found idle, as they may add earlier events. Returns false if there were no changes.
+	 * The mutex is released while waiting.
+	 */
+	bool waitForVM(Locker& l, uint32_t& idleChanges);
+	static uint64_t getCurrentTime();
 	void insertNewEvent(TimingEvent* e);
 	void insertNewEvent_nolock(TimingEvent* e);
+	// puts the event in the slot matching its expiration time
+	void insertInWheel(TimingEvent* e);
+	// moves the events of a higher level slot to the lower levels
+	void cascade(uint32_t level, uint32_t index);
+	// earliest time after wheelTime the wheel has something to do, dueEvents are not considered
+	uint64_t getNextExpiration() const;
+	// advances the wheel to the given time and moves all events that expired to dueEvents
+	void advance(uint64_t now);
+	// unlinks the event from the wheel and the job map, the caller has to delete it
+	void unlinkEvent(TimingEvent* e);
 	void dumpJobs();
 public:
 	TimerThread(SystemState* s);
@@ -93,6 +149,49 @@ public:
 	void removeJob_noLock(ITickJob* job);
 };
 
+/*
+ * The clock driving frames, timers, getTimer() and the audio and video clocks, in milliseconds.
+ * It follows the monotonic clock unless it is virtual. The virtual clock only advances when all
+ * the registered threads (the TimerThreads and the audio mixer) are waiting and the VM has no
+ * queued events, then it jumps to the earliest pending event, so content runs as fast as the CPU
+ * allows and the order of frames and timers is reproducible.
+ */
+class DLL_PUBLIC EngineClock
+{
+private:
+	static bool virtualClock;
+	static std::atomic<uint64_t> virtualTime;
+	static Mutex mutex;
+	// time every registered TimerThread waits for, UINT64_MAX if it has no events
+	// the threads that are busy have no entry
+	static std::unordered_map<Cond*,uint64_t> waiting;
+	static uint32_t registeredThreads;
+	// the VM has queued events
+	static bool vmWorking;
+	static uint64_t realStart;
+	static uint64_t virtualStart;
+	static std::atomic<uint32_t> frames;
+	// jumps to the earliest time the threads wait for if nothing else is running, mutex must be held
+	static void advance();
+public:
+	// must be called before the engine is started
+	static void setVirtual(bool v);
+	static bool isVirtual() { return virtualClock; }
+	static uint64_t getTime();
+	static void registerThread(Cond* wakeUp);
+	static void unregisterThread(Cond* wakeUp);
+	// the thread has nothing to do until time, wakes up the waiting threads if the clock advances
+	static void idleUntil(Cond* wakeUp, uint64_t time);
+	// the thread has new events, the clock must not advance until it waits again
+	static void busy(Cond* wakeUp);
+	// called when events are queued for the VM and when it has handled all of them
+	static void vmBusy();
+	static void vmIdle();
+	static void countFrame() { frames++; }
+	// logs the frames per second reached with the virtual clock
+	static void report();
+};
+
 class Chronometer
 {
 private:
@@ -327,6 +327,7 @@ void tiny_string::makePrivateCopy(const char* s)
 void tiny_string::createBuffer(uint32_t s)
 {
 	type=DYNAMIC;
+	capacity=s;
 	reportMemoryChange(s);
 	buf=new char[s];
 }
@@ -334,19 +335,23 @@ void tiny_string::createBuffer(uint32_t s)
 void tiny_string::resizeBuffer(uint32_t s)
 {
 	assert(type==DYNAMIC);
-	char* oldBuf=buf;
-	reportMemoryChange(s-stringSize);
-	buf=new char[s];
 	assert(s >= stringSize);
+	if(s <= capacity)
+		return;
+	uint32_t newCapacity=std::max(s,capacity*2);
+	char* oldBuf=buf;
+	reportMemoryChange(newCapacity-capacity);
+	buf=new char[newCapacity];
 	memcpy(buf,oldBuf,stringSize);
 	delete[] oldBuf;
+	capacity=newCapacity;
 }
 
 void tiny_string::resetToStatic()
 {
 	if(type==DYNAMIC)
 	{
-		reportMemoryChange(-stringSize);
+		reportMemoryChange(-capacity);
 		delete[] buf;
 	}
 	stringSize=1;
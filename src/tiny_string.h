@@ -98,6 +98,10 @@ private:
 	*/
 	uint32_t stringSize;
 	uint32_t numchars;
+	/*
+	   size of the allocated buffer, only valid for DYNAMIC strings
+	*/
+	uint32_t capacity;
 	TYPE type;
 #ifdef MEMORY_USAGE_PROFILING
 	//Implemented in memory_support.cpp
@@ -109,6 +113,7 @@ private:
 	//TODO: use static buffer again if reassigning to short string
 	void makePrivateCopy(const char* s);
 	void createBuffer(uint32_t s);
+	/* grows the buffer geometrically, so that appending is amortized O(1) */
 	void resizeBuffer(uint32_t s);
 	void resetToStatic();
 	void init();
@@ -117,7 +122,7 @@ private:
 public:
 	static const uint32_t npos = (uint32_t)(-1);
 
-	tiny_string():_buf_static(),buf(_buf_static),stringSize(1),numchars(0),type(STATIC),isASCII(true),hasNull(false){buf[0]=0;}
+	tiny_string():_buf_static(),buf(_buf_static),stringSize(1),numchars(0),capacity(0),type(STATIC),isASCII(true),hasNull(false){buf[0]=0;}
 	/* construct from utf character */
 	static tiny_string fromChar(uint32_t c);
 	tiny_string(const char* s,bool copy=false);
@@ -0,0 +1,146 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <fstream>
+#include "tracing.h"
+#include "swf.h"
+#include "logger.h"
+
+using namespace lightspark;
+using namespace std;
+
+bool Tracer::enabled=false;
+thread_local Tracer::ThreadBuffer* Tracer::currentBuffer=nullptr;
+Mutex Tracer::mutex;
+vector<Tracer::ThreadBuffer*> Tracer::buffers;
+tiny_string Tracer::outputFile;
+
+static thread_local const char* currentThreadName=nullptr;
+
+void Tracer::setOutput(const tiny_string& file)
+{
+	Locker l(mutex);
+	outputFile=file;
+	enabled=!file.empty();
+}
+
+void Tracer::setThreadName(const char* name)
+{
+	currentThreadName=name;
+	if(currentBuffer)
+		currentBuffer->name=name;
+}
+
+Tracer::ThreadBuffer* Tracer::getThreadBuffer()
+{
+	if(USUALLY_TRUE(currentBuffer!=nullptr))
+		return currentBuffer;
+	//Buffers are only allocated by the threads that record events and never freed,
+	//events of threads that have terminated are still written
+	ThreadBuffer* b=new ThreadBuffer;
+	b->written=0;
+	b->name=currentThreadName;
+	Locker l(mutex);
+	b->tid=buffers.size()+1;
+	buffers.push_back(b);
+	currentBuffer=b;
+	return b;
+}
+
+void Tracer::record(const char* category, const char* name, uint64_t start, uint32_t duration, uint32_t detail)
+{
+	ThreadBuffer* b=getThreadBuffer();
+	//Only the owning thread writes, publishing the new count is enough for the readers
+	uint64_t index=b->written.load(std::memory_order_relaxed);
+	TraceEvent& e=b->events[index%TRACE_BUFFER_EVENTS];
+	e.category=category;
+	e.name=name;
+	e.start=start;
+	e.duration=duration;
+	e.detail=detail;
+	b->written.store(index+1,std::memory_order_release);
+}
+
+static void writeJSONString(ostream& out, const char* s)
+{
+	out << '"';
+	for(;*s;s++)
+	{
+		if(*s=='"' || *s=='\\')
+			out << '\\' << *s;
+		else if(uint8_t(*s)<0x20)
+			out << ' ';
+		else
+			out << *s;
+	}
+	out << '"';
+}
+
+void Tracer::write(SystemState* sys)
+{
+	Locker l(mutex);
+	if(outputFile.empty())
+		return;
+	ofstream out(outputFile.raw_buf(),ios_base::out|ios_base::trunc);
+	if(!out)
+	{
+		LOG(LOG_ERROR,"Tracer: unable to open " << outputFile);
+		return;
+	}
+	out << "{\"traceEvents\":[" << endl;
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"lightspark\"}}";
+	uint64_t count=0;
+	for(auto it=buffers.begin();it!=buffers.end();++it)
+	{
+		ThreadBuffer* b=*it;
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid << ",\"args\":{\"name\":";
+		if(b->name)
+			writeJSONString(out,b->name);
+		else
+			out << "\"thread " << b->tid << "\"";
+		out << "}}";
+		uint64_t end=b->written.load(std::memory_order_acquire);
+		uint64_t begin=0;
+		if(end>TRACE_BUFFER_EVENTS)
+			begin=end-TRACE_BUFFER_EVENTS+TRACE_BUFFER_MARGIN;
+		for(uint64_t i=begin;i<end;i++)
+		{
+			const TraceEvent& e=b->events[i%TRACE_BUFFER_EVENTS];
+			out << ",\n{\"name\":";
+			writeJSONString(out,e.name);
+			out << ",\"cat\":";
+			writeJSONString(out,e.category);
+			if(e.duration==UINT32_MAX)
+				out << ",\"ph\":\"i\",\"s\":\"t\"";
+			else
+				out << ",\"ph\":\"X\",\"dur\":" << e.duration;
+			out << ",\"ts\":" << e.start << ",\"pid\":1,\"tid\":" << b->tid;
+			if(e.detail && sys)
+			{
+				out << ",\"args\":{\"detail\":";
+				writeJSONString(out,sys->getStringFromUniqueId(e.detail).raw_buf());
+				out << "}";
+			}
+			out << "}";
+		}
+		count+=end-begin;
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+	LOG(LOG_INFO,"Tracer: " << count << " events written to " << outputFile);
+}
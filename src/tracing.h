@@ -0,0 +1,118 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef TRACING_H
+#define TRACING_H 1
+
+#include "compat.h"
+#include <vector>
+#include "threading.h"
+#include "tiny_string.h"
+
+namespace lightspark
+{
+
+//Number of events kept for every thread, older events are overwritten
+#define TRACE_BUFFER_EVENTS 32768
+//Oldest events of a buffer that are not written, as the owning thread may be overwriting them meanwhile
+#define TRACE_BUFFER_MARGIN 256
+
+class SystemState;
+
+struct TraceEvent
+{
+	// category and name must be string literals
+	const char* category;
+	const char* name;
+	// start time in microseconds of the monotonic clock
+	uint64_t start;
+	// duration in microseconds, UINT32_MAX for instant events
+	uint32_t duration;
+	// unique string id of the SystemState shown as detail, 0 if there is none
+	uint32_t detail;
+};
+
+/*
+ * Records timed spans of the engine (parsing, frame scripts, event dispatch, invalidation,
+ * rasterization, uploads, decoding) and writes them as a Chrome trace (chrome://tracing, Perfetto).
+ * Every thread writes into its own ring buffer without locking, the buffers are only read when
+ * the trace is written. Recording is disabled unless an output file is set, the span macros
+ * then only test a flag.
+ */
+class DLL_PUBLIC Tracer
+{
+private:
+	struct ThreadBuffer
+	{
+		TraceEvent events[TRACE_BUFFER_EVENTS];
+		// total number of events written by the owning thread
+		std::atomic<uint64_t> written;
+		uint32_t tid;
+		const char* name;
+	};
+	static bool enabled;
+	static thread_local ThreadBuffer* currentBuffer;
+	static Mutex mutex;
+	static std::vector<ThreadBuffer*> buffers;
+	static tiny_string outputFile;
+	static ThreadBuffer* getThreadBuffer();
+public:
+	static bool isEnabled() { return enabled; }
+	// starts recording, the trace is written to file by write()
+	static void setOutput(const tiny_string& file);
+	// names the calling thread in the trace, name must be a string literal
+	static void setThreadName(const char* name);
+	static void record(const char* category, const char* name, uint64_t start, uint32_t duration, uint32_t detail);
+	// writes the events recorded until now, sys resolves the details
+	static void write(SystemState* sys);
+};
+
+class TraceScope
+{
+private:
+	const char* category;
+	const char* name;
+	uint64_t start;
+	uint32_t detail;
+public:
+	TraceScope(const char* c, const char* n, uint32_t d=0):category(c),name(n),start(0),detail(d)
+	{
+		if(USUALLY_FALSE(Tracer::isEnabled()))
+			start=g_get_monotonic_time();
+	}
+	~TraceScope()
+	{
+		if(USUALLY_FALSE(start!=0))
+			Tracer::record(category,name,start,g_get_monotonic_time()-start,detail);
+	}
+};
+
+#define LS_TRACE_CONCAT2(a,b) a##b
+#define LS_TRACE_CONCAT(a,b) LS_TRACE_CONCAT2(a,b)
+//Records the time until the end of the enclosing scope
+#define LS_TRACE_SCOPE(category,name) \
+	TraceScope LS_TRACE_CONCAT(tracescope_,__LINE__)(category,name)
+//Like LS_TRACE_SCOPE, the detail expression (a unique string id) is only evaluated while tracing
+#define LS_TRACE_SCOPE_DETAIL(category,name,detail) \
+	TraceScope LS_TRACE_CONCAT(tracescope_,__LINE__)(category,name,Tracer::isEnabled() ? (uint32_t)(detail) : 0)
+#define LS_TRACE_INSTANT(category,name) \
+	do { if(USUALLY_FALSE(Tracer::isEnabled())) Tracer::record(category,name,g_get_monotonic_time(),UINT32_MAX,0); } while(0)
+
+}
+#endif /* TRACING_H */
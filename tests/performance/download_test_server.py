@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+# Stand-in HTTP server for Download_test.mxml and ContentCache_test.mxml
+# /crossdomain.xml allows every domain, every other path is served with "size" bytes of data, after waiting "latency" milliseconds.
+# The optional "cache" and "vary" parameters are sent back as the Cache-Control and Vary headers.
+# Usage: download_test_server.py [port]
+
+import sys
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlparse, parse_qs
+
+CHUNK = bytes(range(256))*256
+POLICY = b'<?xml version="1.0"?><cross-domain-policy><allow-access-from domain="*"/></cross-domain-policy>'
+
+class Handler(BaseHTTPRequestHandler):
+	protocol_version = "HTTP/1.1"
+
+	def do_GET(self):
+		url = urlparse(self.path)
+		if url.path == "/crossdomain.xml":
+			self.send_response(200)
+			self.send_header("Content-Type", "text/x-cross-domain-policy")
+			self.send_header("Content-Length", str(len(POLICY)))
+			self.end_headers()
+			self.wfile.write(POLICY)
+			return
+		query = parse_qs(url.query)
+		size = int(query.get("size", ["65536"])[0])
+		latency = int(query.get("latency", ["0"])[0])
+		time.sleep(latency/1000.0)
+		self.send_response(200)
+		self.send_header("Content-Type", "application/octet-stream")
+		self.send_header("Content-Length", str(size))
+		if "cache" in query:
+			self.send_header("Cache-Control", query["cache"][0])
+		if "vary" in query:
+			self.send_header("Vary", query["vary"][0])
+		self.end_headers()
+		while size > 0:
+			n = min(size, len(CHUNK))
+			self.wfile.write(CHUNK[:n])
+			size -= n
+
+	def log_message(self, format, *args):
+		pass
+
+port = int(sys.argv[1]) if len(sys.argv) > 1 else 8000
+ThreadingHTTPServer(("127.0.0.1", port), Handler).serve_forever()